@@ -1,42 +1,44 @@
 #include <ctype.h>
+#include <errno.h>
 #include <assert.h>
 #include <unistd.h>
 #include <setjmp.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "bcftools.pysam.h"
 
-FILE * bcftools_stderr = NULL;
-FILE * bcftools_stdout = NULL;
-const char * bcftools_stdout_fn = NULL;
+__thread FILE * bcftools_thread_stderr = NULL;
+__thread FILE * bcftools_thread_stdout = NULL;
+__thread const char * bcftools_stdout_fn = NULL;
 
 
 FILE * bcftools_set_stderr(int fd)
 {
-  if (bcftools_stderr != NULL)
-    fclose(bcftools_stderr);
-  bcftools_stderr = fdopen(fd, "w");
-  return bcftools_stderr;
+  if (bcftools_thread_stderr != NULL)
+    fclose(bcftools_thread_stderr);
+  bcftools_thread_stderr = fdopen(fd, "w");
+  return bcftools_thread_stderr;
 }
 
 void bcftools_close_stderr(void)
 {
-  fclose(bcftools_stderr);
-  bcftools_stderr = NULL;
+  fclose(bcftools_thread_stderr);
+  bcftools_thread_stderr = NULL;
 }
 
 FILE * bcftools_set_stdout(int fd)
 {
-  if (bcftools_stdout != NULL)
-    fclose(bcftools_stdout);
-  bcftools_stdout = fdopen(fd, "w");
-  if (bcftools_stdout == NULL)
+  if (bcftools_thread_stdout != NULL)
+    fclose(bcftools_thread_stdout);
+  bcftools_thread_stdout = fdopen(fd, "w");
+  if (bcftools_thread_stdout == NULL)
     {
       fprintf(bcftools_stderr, "could not set stdout to fd %i", fd);
     }
-  return bcftools_stdout;
+  return bcftools_thread_stdout;
 }
 
 void bcftools_set_stdout_fn(const char *fn)
@@ -46,8 +48,8 @@ void bcftools_set_stdout_fn(const char *fn)
 
 void bcftools_close_stdout(void)
 {
-  fclose(bcftools_stdout);
-  bcftools_stdout = NULL;
+  fclose(bcftools_thread_stdout);
+  bcftools_thread_stdout = NULL;
 }
 
 int bcftools_puts(const char *s)
@@ -57,8 +59,8 @@ int bcftools_puts(const char *s)
 }
 
 
-static jmp_buf bcftools_jmpbuf;
-static int bcftools_status = 0;
+static __thread jmp_buf bcftools_jmpbuf;
+static __thread int bcftools_status = 0;
 
 int bcftools_dispatch(int argc, char *argv[])
 {
@@ -74,16 +76,231 @@ void bcftools_exit(int status)
   longjmp(bcftools_jmpbuf, 1);
 }
 
+typedef struct {
+  void *(*start_routine)(void *);
+  void *arg;
+  FILE *err, *out;
+} bcftools_thread_t;
+
+static void *bcftools_thread_start(void *data)
+{
+  bcftools_thread_t t = *(bcftools_thread_t *)data;
+  free(data);
+  bcftools_thread_stderr = t.err;
+  bcftools_thread_stdout = t.out;
+  return t.start_routine(t.arg);
+}
+
+int bcftools_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                           void *(*start_routine)(void *), void *arg)
+{
+  int ret;
+  bcftools_thread_t *t = malloc(sizeof(bcftools_thread_t));
+  if (t == NULL)
+    return EAGAIN;
+  t->start_routine = start_routine;
+  t->arg = arg;
+  t->err = bcftools_thread_stderr;
+  t->out = bcftools_thread_stdout;
+  if ((ret = pthread_create(thread, attr, bcftools_thread_start, t)) != 0)
+    free(t);
+  return ret;
+}
+
+
+/* getopt and getopt_long with their state kept per thread.
+
+   Like the GNU versions, non-option arguments are moved behind the
+   options unless the option string starts with '+' or '-'.  Based on
+   the implementation in musl libc. */
+
+__thread char * bcftools_optarg = NULL;
+__thread int bcftools_optind = 1, bcftools_opterr = 1, bcftools_optopt = 0;
+
+// position within a group of short options such as -abc
+static __thread int bcftools_optpos = 0;
 
 void bcftools_set_optind(int val)
 {
-  // setting this in cython via 
-  // "from posix.unistd cimport optind"
-  // did not work.
-  //
   // setting to 0 forces a complete re-initialization
-  optind = val;
+  bcftools_optind = val;
+  bcftools_optpos = 0;
 }
 
+static void bcftools_getopt_msg(const char *cmd, const char *msg,
+                                const char *opt, size_t l)
+{
+  fprintf(bcftools_stderr, "%s%s%.*s\n", cmd, msg, (int)l, opt);
+}
+
+static int bcftools_getopt_short(int argc, char * const argv[], const char *optstring)
+{
+  int i;
+  char c, *optchar;
+
+  if (bcftools_optind >= argc || !argv[bcftools_optind])
+    return -1;
+
+  if (argv[bcftools_optind][0] != '-') {
+    if (optstring[0] == '-') {
+      bcftools_optarg = argv[bcftools_optind++];
+      return 1;
+    }
+    return -1;
+  }
+
+  if (!argv[bcftools_optind][1])
+    return -1;
+
+  if (argv[bcftools_optind][1] == '-' && !argv[bcftools_optind][2])
+    return bcftools_optind++, -1;
+
+  if (!bcftools_optpos) bcftools_optpos++;
+  optchar = argv[bcftools_optind] + bcftools_optpos;
+  c = *optchar;
+  bcftools_optpos++;
 
+  if (!argv[bcftools_optind][bcftools_optpos]) {
+    bcftools_optind++;
+    bcftools_optpos = 0;
+  }
 
+  if (optstring[0] == '-' || optstring[0] == '+')
+    optstring++;
+
+  for (i = 0; optstring[i] && optstring[i] != c; i++)
+    ;
+
+  if (optstring[i] != c || c == ':') {
+    bcftools_optopt = c;
+    if (optstring[0] != ':' && bcftools_opterr)
+      bcftools_getopt_msg(argv[0], ": unrecognized option: ", optchar, 1);
+    return '?';
+  }
+  if (optstring[i+1] == ':') {
+    bcftools_optarg = NULL;
+    if (optstring[i+2] != ':' || bcftools_optpos) {
+      bcftools_optarg = argv[bcftools_optind++] + bcftools_optpos;
+      bcftools_optpos = 0;
+    }
+    if (bcftools_optind > argc) {
+      bcftools_optopt = c;
+      if (optstring[0] == ':') return ':';
+      if (bcftools_opterr)
+        bcftools_getopt_msg(argv[0], ": option requires an argument: ", optchar, 1);
+      return '?';
+    }
+  }
+  return c;
+}
+
+static int bcftools_getopt_long_core(int argc, char * const argv[], const char *optstring,
+                                     const struct option *longopts, int *idx)
+{
+  bcftools_optarg = NULL;
+  if (longopts && argv[bcftools_optind][0] == '-' &&
+      argv[bcftools_optind][1] == '-' && argv[bcftools_optind][2]) {
+    int colon = optstring[optstring[0] == '+' || optstring[0] == '-'] == ':';
+    int i, cnt, match = 0;
+    char *arg = NULL, *opt, *start = argv[bcftools_optind] + 2;
+    for (cnt = i = 0; longopts[i].name; i++) {
+      const char *name = longopts[i].name;
+      opt = start;
+      while (*opt && *opt != '=' && *opt == *name)
+        name++, opt++;
+      if (*opt && *opt != '=') continue;
+      arg = opt;
+      match = i;
+      if (!*name) {
+        // exact match
+        cnt = 1;
+        break;
+      }
+      cnt++;
+    }
+    if (cnt == 1) {
+      i = match;
+      opt = arg;
+      bcftools_optind++;
+      if (*opt == '=') {
+        if (!longopts[i].has_arg) {
+          bcftools_optopt = longopts[i].val;
+          if (colon || !bcftools_opterr)
+            return '?';
+          bcftools_getopt_msg(argv[0], ": option does not take an argument: ",
+                             longopts[i].name, strlen(longopts[i].name));
+          return '?';
+        }
+        bcftools_optarg = opt + 1;
+      } else if (longopts[i].has_arg == required_argument) {
+        if (!(bcftools_optarg = argv[bcftools_optind])) {
+          bcftools_optopt = longopts[i].val;
+          if (colon) return ':';
+          if (!bcftools_opterr) return '?';
+          bcftools_getopt_msg(argv[0], ": option requires an argument: ",
+                             longopts[i].name, strlen(longopts[i].name));
+          return '?';
+        }
+        bcftools_optind++;
+      }
+      if (idx) *idx = i;
+      if (longopts[i].flag) {
+        *longopts[i].flag = longopts[i].val;
+        return 0;
+      }
+      return longopts[i].val;
+    }
+    bcftools_optopt = 0;
+    if (!colon && bcftools_opterr)
+      bcftools_getopt_msg(argv[0], cnt ? ": option is ambiguous: " : ": unrecognized option: ",
+                         start, strlen(start));
+    bcftools_optind++;
+    return '?';
+  }
+  return bcftools_getopt_short(argc, argv, optstring);
+}
+
+static void bcftools_permute(char * const argv[], int dest, int src)
+{
+  char **av = (char **)argv;
+  char *tmp = av[src];
+  int i;
+  for (i = src; i > dest; i--)
+    av[i] = av[i-1];
+  av[dest] = tmp;
+}
+
+int bcftools_getopt_long(int argc, char * const argv[], const char *optstring,
+                        const struct option *longopts, int *idx)
+{
+  int ret, skipped, resumed;
+  if (!bcftools_optind) {
+    bcftools_optpos = 0;
+    bcftools_optind = 1;
+  }
+  if (bcftools_optind >= argc || !argv[bcftools_optind]) return -1;
+  skipped = bcftools_optind;
+  if (optstring[0] != '+' && optstring[0] != '-') {
+    int i;
+    for (i = bcftools_optind; ; i++) {
+      if (i >= argc || !argv[i]) return -1;
+      if (argv[i][0] == '-' && argv[i][1]) break;
+    }
+    bcftools_optind = i;
+  }
+  resumed = bcftools_optind;
+  ret = bcftools_getopt_long_core(argc, argv, optstring, longopts, idx);
+  if (resumed > skipped) {
+    // move the options just read in front of the skipped arguments
+    int i, cnt = bcftools_optind - resumed;
+    for (i = 0; i < cnt; i++)
+      bcftools_permute(argv, skipped, bcftools_optind - 1);
+    bcftools_optind = skipped + cnt;
+  }
+  return ret;
+}
+
+int bcftools_getopt(int argc, char * const argv[], const char *optstring)
+{
+  return bcftools_getopt_long(argc, argv, optstring, NULL, NULL);
+}
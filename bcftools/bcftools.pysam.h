@@ -2,12 +2,24 @@
 #define bcftools_PYSAM_H
 
 #include <stdio.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
 
-extern FILE * bcftools_stderr;
+/* The state of a command is kept per thread, so that commands can
+   run concurrently in different threads.  Threads not started by a
+   command, such as those of an htslib thread pool, have no streams
+   of their own and write to the process stderr and stdout. */
 
-extern FILE * bcftools_stdout;
+extern __thread FILE * bcftools_thread_stderr;
 
-extern const char * bcftools_stdout_fn;
+extern __thread FILE * bcftools_thread_stdout;
+
+#define bcftools_stderr (bcftools_thread_stderr ? bcftools_thread_stderr : stderr)
+
+#define bcftools_stdout (bcftools_thread_stdout ? bcftools_thread_stdout : stdout)
+
+extern __thread const char * bcftools_stdout_fn;
 
 /*! set pysam standard error to point to file descriptor
 
@@ -42,8 +54,26 @@ int bcftools_dispatch(int argc, char *argv[]);
 
 void bcftools_exit(int status);
 
+/*! start a thread sharing the standard output and error of the
+  calling command.  The thread must return errors to the command
+  joining it, it cannot call exit().
+ */
+int bcftools_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                           void *(*start_routine)(void *), void *arg);
+
 void bcftools_set_optind(int);
 
 extern int bcftools_main(int argc, char *argv[]);
-  
+
+/* getopt keeps its state in globals, so commands call a copy
+   keeping it per thread instead. */
+
+extern __thread char * bcftools_optarg;
+extern __thread int bcftools_optind, bcftools_opterr, bcftools_optopt;
+
+int bcftools_getopt(int argc, char * const argv[], const char *optstring);
+
+int bcftools_getopt_long(int argc, char * const argv[], const char *optstring,
+                        const struct option *longopts, int *longindex);
+
 #endif
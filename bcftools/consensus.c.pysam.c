@@ -1106,68 +1106,68 @@ int main_consensus(int argc, char *argv[])
         {0,0,0,0}
     };
     int c;
-    while ((c = getopt_long(argc, argv, "h?s:1Ii:e:H:f:o:m:c:M:p:a:",loptions,NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "h?s:1Ii:e:H:f:o:m:c:M:p:a:",loptions,NULL)) >= 0)
     {
         switch (c) 
         {
-            case  1 : args->mark_del = optarg[0]; break;
+            case  1 : args->mark_del = bcftools_optarg[0]; break;
             case  2 :
-                if ( !strcasecmp(optarg,"uc") ) args->mark_ins = 'u';
-                else if ( !strcasecmp(optarg,"lc") ) args->mark_ins = 'l';
-                else error("The argument is not recognised: --mark-ins %s\n",optarg);
+                if ( !strcasecmp(bcftools_optarg,"uc") ) args->mark_ins = 'u';
+                else if ( !strcasecmp(bcftools_optarg,"lc") ) args->mark_ins = 'l';
+                else error("The argument is not recognised: --mark-ins %s\n",bcftools_optarg);
                 break;
             case  3 :
-                if ( !strcasecmp(optarg,"uc") ) args->mark_snv = 'u';
-                else if ( !strcasecmp(optarg,"lc") ) args->mark_snv = 'l';
-                else error("The argument is not recognised: --mark-snv %s\n",optarg);
+                if ( !strcasecmp(bcftools_optarg,"uc") ) args->mark_snv = 'u';
+                else if ( !strcasecmp(bcftools_optarg,"lc") ) args->mark_snv = 'l';
+                else error("The argument is not recognised: --mark-snv %s\n",bcftools_optarg);
                 break;
-            case 'p': args->chr_prefix = optarg; break;
-            case 's': args->sample = optarg; break;
-            case 'o': args->output_fname = optarg; break;
+            case 'p': args->chr_prefix = bcftools_optarg; break;
+            case 's': args->sample = bcftools_optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'I': args->output_iupac = 1; break;
             case 'e': 
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 'i': 
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
-            case 'f': args->ref_fname = optarg; break;
-            case 'm': add_mask(args,optarg); break;
-            case  4 : add_mask_with(args,optarg); break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
+            case 'f': args->ref_fname = bcftools_optarg; break;
+            case 'm': add_mask(args,bcftools_optarg); break;
+            case  4 : add_mask_with(args,bcftools_optarg); break;
             case 'a':
-                args->absent_allele = optarg[0];
-                if ( optarg[1]!=0 ) error("Expected single character with -a, got \"%s\"\n", optarg);
+                args->absent_allele = bcftools_optarg[0];
+                if ( bcftools_optarg[1]!=0 ) error("Expected single character with -a, got \"%s\"\n", bcftools_optarg);
                 break;
             case 'M': 
-                args->missing_allele = optarg[0]; 
-                if ( optarg[1]!=0 ) error("Expected single character with -M, got \"%s\"\n", optarg);
+                args->missing_allele = bcftools_optarg[0]; 
+                if ( bcftools_optarg[1]!=0 ) error("Expected single character with -M, got \"%s\"\n", bcftools_optarg);
                 break;
-            case 'c': args->chain_fname = optarg; break;
+            case 'c': args->chain_fname = bcftools_optarg; break;
             case 'H': 
-                if ( !strcasecmp(optarg,"R") ) args->allele |= PICK_REF;
-                else if ( !strcasecmp(optarg,"A") ) args->allele |= PICK_ALT;
-                else if ( !strcasecmp(optarg,"L") ) args->allele |= PICK_LONG|PICK_REF;
-                else if ( !strcasecmp(optarg,"S") ) args->allele |= PICK_SHORT|PICK_REF;
-                else if ( !strcasecmp(optarg,"LR") ) args->allele |= PICK_LONG|PICK_REF;
-                else if ( !strcasecmp(optarg,"LA") ) args->allele |= PICK_LONG|PICK_ALT;
-                else if ( !strcasecmp(optarg,"SR") ) args->allele |= PICK_SHORT|PICK_REF;
-                else if ( !strcasecmp(optarg,"SA") ) args->allele |= PICK_SHORT|PICK_ALT;
-                else if ( !strcasecmp(optarg,"I") ) args->allele |= PICK_IUPAC;
-                else if ( !strcasecmp(optarg,"1pIu") ) args->allele |= PICK_IUPAC, args->haplotype = 1;
-                else if ( !strcasecmp(optarg,"2pIu") ) args->allele |= PICK_IUPAC, args->haplotype = 2;
+                if ( !strcasecmp(bcftools_optarg,"R") ) args->allele |= PICK_REF;
+                else if ( !strcasecmp(bcftools_optarg,"A") ) args->allele |= PICK_ALT;
+                else if ( !strcasecmp(bcftools_optarg,"L") ) args->allele |= PICK_LONG|PICK_REF;
+                else if ( !strcasecmp(bcftools_optarg,"S") ) args->allele |= PICK_SHORT|PICK_REF;
+                else if ( !strcasecmp(bcftools_optarg,"LR") ) args->allele |= PICK_LONG|PICK_REF;
+                else if ( !strcasecmp(bcftools_optarg,"LA") ) args->allele |= PICK_LONG|PICK_ALT;
+                else if ( !strcasecmp(bcftools_optarg,"SR") ) args->allele |= PICK_SHORT|PICK_REF;
+                else if ( !strcasecmp(bcftools_optarg,"SA") ) args->allele |= PICK_SHORT|PICK_ALT;
+                else if ( !strcasecmp(bcftools_optarg,"I") ) args->allele |= PICK_IUPAC;
+                else if ( !strcasecmp(bcftools_optarg,"1pIu") ) args->allele |= PICK_IUPAC, args->haplotype = 1;
+                else if ( !strcasecmp(bcftools_optarg,"2pIu") ) args->allele |= PICK_IUPAC, args->haplotype = 2;
                 else
                 {
                     char *tmp;
-                    args->haplotype = strtol(optarg, &tmp, 10);
-                    if ( tmp==optarg || *tmp ) error("Error: Could not parse --haplotype %s, expected numeric argument\n", optarg);
+                    args->haplotype = strtol(bcftools_optarg, &tmp, 10);
+                    if ( tmp==bcftools_optarg || *tmp ) error("Error: Could not parse --haplotype %s, expected numeric argument\n", bcftools_optarg);
                     if ( args->haplotype <=0 ) error("Error: Expected positive integer with --haplotype\n");
                 }
                 break;
             default: usage(args); break;
         }
     }
-    if ( optind>=argc ) usage(args);
-    args->fname = argv[optind];
+    if ( bcftools_optind>=argc ) usage(args);
+    args->fname = argv[bcftools_optind];
 
     if ( !args->ref_fname && !isatty(fileno((FILE *)stdin)) ) args->ref_fname = "-";
     if ( !args->ref_fname ) usage(args);
@@ -4187,14 +4187,14 @@ int main_csq(int argc, char *argv[])
     };
     int c, targets_is_file = 0, regions_is_file = 0; 
     char *targets_list = NULL, *regions_list = NULL, *tmp;
-    while ((c = getopt_long(argc, argv, "?hr:R:t:T:i:e:f:o:O:g:s:S:p:qc:ln:bB:v:",loptions,NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "?hr:R:t:T:i:e:f:o:O:g:s:S:p:qc:ln:bB:v:",loptions,NULL)) >= 0)
     {
         switch (c) 
         {
             case  1 : args->force = 1; break;
             case  2 :
-                args->n_threads = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --threads  %s\n", optarg);
+                args->n_threads = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --threads  %s\n", bcftools_optarg);
                 break;
             case  3 : args->record_cmd_line = 0; break;
             case 'b':
@@ -4202,69 +4202,69 @@ int main_csq(int argc, char *argv[])
                     fprintf(bcftools_stderr,"Warning: the -b option will be removed in future versions. Please use -B 1 instead.\n");
                     break;
             case 'B': 
-                    args->brief_predictions = strtol(optarg,&tmp,10);
-                    if ( *tmp || args->brief_predictions<1 ) error("Could not parse argument: --trim-protein-seq %s\n", optarg);
+                    args->brief_predictions = strtol(bcftools_optarg,&tmp,10);
+                    if ( *tmp || args->brief_predictions<1 ) error("Could not parse argument: --trim-protein-seq %s\n", bcftools_optarg);
                     break;
             case 'l': args->local_csq = 1; break;
-            case 'c': args->bcsq_tag = optarg; break;
+            case 'c': args->bcsq_tag = bcftools_optarg; break;
             case 'q': error("Error: the -q option has been deprecated, use -v, --verbose instead.\n"); break;
             case 'v': 
-                args->verbosity = atoi(optarg);
+                args->verbosity = atoi(bcftools_optarg);
                 if ( args->verbosity<0 || args->verbosity>2 ) error("Error: expected integer 0-2 with -v, --verbose\n");
                 break;
             case 'p':
-                switch (optarg[0]) 
+                switch (bcftools_optarg[0]) 
                 {
                     case 'a': args->phase = PHASE_AS_IS; break;
                     case 'm': args->phase = PHASE_MERGE; break;
                     case 'r': args->phase = PHASE_REQUIRE; break;
                     case 'R': args->phase = PHASE_NON_REF; break;
                     case 's': args->phase = PHASE_SKIP; break;
-                    default: error("The -p code \"%s\" not recognised\n", optarg);
+                    default: error("The -p code \"%s\" not recognised\n", bcftools_optarg);
                 }
                 break;
-            case 'f': args->fa_fname = optarg; break;
-            case 'g': args->gff_fname = optarg; break;
+            case 'f': args->fa_fname = bcftools_optarg; break;
+            case 'g': args->gff_fname = bcftools_optarg; break;
             case 'n': 
-                args->ncsq2_max = 2 * atoi(optarg);
-                if ( args->ncsq2_max <= 0 ) error("Expected positive integer with -n, got %s\n", optarg);
+                args->ncsq2_max = 2 * atoi(bcftools_optarg);
+                if ( args->ncsq2_max <= 0 ) error("Expected positive integer with -n, got %s\n", bcftools_optarg);
                 break;
-            case 'o': args->output_fname = optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'O':
-                      switch (optarg[0]) {
+                      switch (bcftools_optarg[0]) {
                           case 't': args->output_type = FT_TAB_TEXT; break;
                           case 'b': args->output_type = FT_BCF_GZ; break;
                           case 'u': args->output_type = FT_BCF; break;
                           case 'z': args->output_type = FT_VCF_GZ; break;
                           case 'v': args->output_type = FT_VCF; break;
-                          default: error("The output type \"%s\" not recognised\n", optarg);
+                          default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                       }
                       break;
             case 'e':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 'i':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
-            case 'r': regions_list = optarg; break;
-            case 'R': regions_list = optarg; regions_is_file = 1; break;
-            case 's': args->sample_list = optarg; break;
-            case 'S': args->sample_list = optarg; args->sample_is_file = 1; break;
-            case 't': targets_list = optarg; break;
-            case 'T': targets_list = optarg; targets_is_file = 1; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
+            case 'r': regions_list = bcftools_optarg; break;
+            case 'R': regions_list = bcftools_optarg; regions_is_file = 1; break;
+            case 's': args->sample_list = bcftools_optarg; break;
+            case 'S': args->sample_list = bcftools_optarg; args->sample_is_file = 1; break;
+            case 't': targets_list = bcftools_optarg; break;
+            case 'T': targets_list = bcftools_optarg; targets_is_file = 1; break;
             case 'h':
             case '?': error("%s",usage());
-            default: error("The option not recognised: %s\n\n", optarg); break;
+            default: error("The option not recognised: %s\n\n", bcftools_optarg); break;
         }
     }
     char *fname = NULL;
-    if ( optind==argc )
+    if ( bcftools_optind==argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";  // reading from stdin
         else error("%s", usage());
     }
-    else fname = argv[optind];
-    if ( argc - optind>1 ) error("%s", usage());
+    else fname = argv[bcftools_optind];
+    if ( argc - bcftools_optind>1 ) error("%s", usage());
     if ( !args->fa_fname ) error("Missing the --fa-ref option\n");
     if ( !args->gff_fname ) error("Missing the --gff option\n");
     args->sr = bcf_sr_init();
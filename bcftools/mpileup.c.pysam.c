@@ -1277,66 +1277,66 @@ int main_mpileup(int argc, char *argv[])
         {"ar", required_argument, NULL, 14},
         {NULL, 0, NULL, 0}
     };
-    while ((c = getopt_long(argc, argv, "Ag:f:r:R:q:Q:C:BDd:L:b:P:po:e:h:Im:F:EG:6O:xa:s:S:t:T:M:X:U",lopts,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "Ag:f:r:R:q:Q:C:BDd:L:b:P:po:e:h:Im:F:EG:6O:xa:s:S:t:T:M:X:U",lopts,NULL)) >= 0) {
         switch (c) {
         case 'x': mplp.flag &= ~MPLP_SMART_OVERLAPS; break;
         case  1 :
-            mplp.rflag_require = bam_str2flag(optarg);
-            if ( mplp.rflag_require<0 ) { fprintf(bcftools_stderr,"Could not parse --rf %s\n", optarg); return 1; }
+            mplp.rflag_require = bam_str2flag(bcftools_optarg);
+            if ( mplp.rflag_require<0 ) { fprintf(bcftools_stderr,"Could not parse --rf %s\n", bcftools_optarg); return 1; }
             break;
         case  2 :
-            mplp.rflag_filter = bam_str2flag(optarg);
-            if ( mplp.rflag_filter<0 ) { fprintf(bcftools_stderr,"Could not parse --ff %s\n", optarg); return 1; }
+            mplp.rflag_filter = bam_str2flag(bcftools_optarg);
+            if ( mplp.rflag_filter<0 ) { fprintf(bcftools_stderr,"Could not parse --ff %s\n", bcftools_optarg); return 1; }
             break;
-        case  3 : mplp.output_fname = optarg; break;
-        case  4 : mplp.openQ = atoi(optarg); break;
+        case  3 : mplp.output_fname = bcftools_optarg; break;
+        case  4 : mplp.openQ = atoi(bcftools_optarg); break;
         case  5 : bam_smpl_ignore_readgroups(mplp.bsmpl); break;
         case 'g':
-            mplp.gvcf = gvcf_init(optarg);
-            if ( !mplp.gvcf ) error("Could not parse: --gvcf %s\n", optarg);
+            mplp.gvcf = gvcf_init(bcftools_optarg);
+            if ( !mplp.gvcf ) error("Could not parse: --gvcf %s\n", bcftools_optarg);
             break;
         case 'f':
-            mplp.fai = fai_load(optarg);
+            mplp.fai = fai_load(bcftools_optarg);
             if (mplp.fai == NULL) return 1;
-            mplp.fai_fname = optarg;
+            mplp.fai_fname = bcftools_optarg;
             break;
         case  7 : noref = 1; break;
         case  8 : mplp.record_cmd_line = 0; break;
-        case  9 : mplp.n_threads = strtol(optarg, 0, 0); break;
-        case 'd': mplp.max_depth = atoi(optarg); break;
-        case 'r': mplp.reg_fname = strdup(optarg); break;
-        case 'R': mplp.reg_fname = strdup(optarg); mplp.reg_is_file = 1; break;
+        case  9 : mplp.n_threads = strtol(bcftools_optarg, 0, 0); break;
+        case 'd': mplp.max_depth = atoi(bcftools_optarg); break;
+        case 'r': mplp.reg_fname = strdup(bcftools_optarg); break;
+        case 'R': mplp.reg_fname = strdup(bcftools_optarg); mplp.reg_is_file = 1; break;
         case 't':
                   // In the original version the whole BAM was streamed which is inefficient
                   //  with few BED intervals and big BAMs. Todo: devise a heuristic to determine
                   //  best strategy, that is streaming or jumping.
-                  if ( optarg[0]=='^' ) optarg++;
+                  if ( bcftools_optarg[0]=='^' ) bcftools_optarg++;
                   else mplp.bed_logic = 1;
                   mplp.bed = regidx_init(NULL,regidx_parse_reg,NULL,0,NULL);
                   mplp.bed_itr = regitr_init(mplp.bed);
-                  if ( regidx_insert_list(mplp.bed,optarg,',') !=0 )
+                  if ( regidx_insert_list(mplp.bed,bcftools_optarg,',') !=0 )
                   {
-                      fprintf(bcftools_stderr,"Could not parse the targets: %s\n", optarg);
+                      fprintf(bcftools_stderr,"Could not parse the targets: %s\n", bcftools_optarg);
                       bcftools_exit(EXIT_FAILURE);
                   }
                   break;
         case 'T':
-                  if ( optarg[0]=='^' ) optarg++;
+                  if ( bcftools_optarg[0]=='^' ) bcftools_optarg++;
                   else mplp.bed_logic = 1;
-                  mplp.bed = regidx_init(optarg,NULL,NULL,0,NULL);
-                  if (!mplp.bed) { fprintf(bcftools_stderr, "bcftools mpileup: Could not read file \"%s\"", optarg); return 1; }
+                  mplp.bed = regidx_init(bcftools_optarg,NULL,NULL,0,NULL);
+                  if (!mplp.bed) { fprintf(bcftools_stderr, "bcftools mpileup: Could not read file \"%s\"", bcftools_optarg); return 1; }
                   break;
-        case 'P': mplp.pl_list = strdup(optarg); break;
+        case 'P': mplp.pl_list = strdup(bcftools_optarg); break;
         case 'p': mplp.flag |= MPLP_PER_SAMPLE; break;
         case 'B': mplp.flag &= ~MPLP_REALN; break;
         case 'D': mplp.flag &= ~MPLP_REALN_PARTIAL; break;
         case 'I': mplp.flag |= MPLP_NO_INDEL; break;
         case 'E': mplp.flag |= MPLP_REDO_BAQ; break;
         case '6': mplp.flag |= MPLP_ILLUMINA13; break;
-        case 's': if ( bam_smpl_add_samples(mplp.bsmpl,optarg,0)<0 ) error("Could not read samples: %s\n",optarg); break;
-        case 'S': if ( bam_smpl_add_samples(mplp.bsmpl,optarg,1)<0 ) error("Could not read samples: %s\n",optarg); break;
+        case 's': if ( bam_smpl_add_samples(mplp.bsmpl,bcftools_optarg,0)<0 ) error("Could not read samples: %s\n",bcftools_optarg); break;
+        case 'S': if ( bam_smpl_add_samples(mplp.bsmpl,bcftools_optarg,1)<0 ) error("Could not read samples: %s\n",bcftools_optarg); break;
         case 'O':
-            switch (optarg[0]) {
+            switch (bcftools_optarg[0]) {
                 case 'b': mplp.output_type = FT_BCF_GZ; break;
                 case 'u': mplp.output_type = FT_BCF; break;
                 case 'z': mplp.output_type = FT_VCF_GZ; break;
@@ -1344,44 +1344,44 @@ int main_mpileup(int argc, char *argv[])
                 default: error("[error] The option \"-O\" changed meaning when mpileup moved to bcftools. Did you mean: \"bcftools mpileup --output-type\" or \"samtools mpileup --output-BP\"?\n");
             }
             break;
-        case 'C': mplp.capQ_thres = atoi(optarg); break;
-        case 'q': mplp.min_mq = atoi(optarg); break;
-        case 'Q': mplp.min_baseQ = atoi(optarg); break;
-        case  11: mplp.max_baseQ = atoi(optarg); break;
-        case  12: mplp.delta_baseQ = atoi(optarg); break;
-        case 'b': file_list = optarg; break;
+        case 'C': mplp.capQ_thres = atoi(bcftools_optarg); break;
+        case 'q': mplp.min_mq = atoi(bcftools_optarg); break;
+        case 'Q': mplp.min_baseQ = atoi(bcftools_optarg); break;
+        case  11: mplp.max_baseQ = atoi(bcftools_optarg); break;
+        case  12: mplp.delta_baseQ = atoi(bcftools_optarg); break;
+        case 'b': file_list = bcftools_optarg; break;
         case 'o': {
                 char *end;
-                long value = strtol(optarg, &end, 10);
+                long value = strtol(bcftools_optarg, &end, 10);
                 // Distinguish between -o INT and -o FILE (a bit of a hack!)
                 if (*end == '\0') mplp.openQ = value;
-                else mplp.output_fname = optarg;
+                else mplp.output_fname = bcftools_optarg;
             }
             break;
-        case 'e': mplp.extQ = atoi(optarg); break;
-        case 'h': mplp.tandemQ = atoi(optarg); break;
+        case 'e': mplp.extQ = atoi(bcftools_optarg); break;
+        case 'h': mplp.tandemQ = atoi(bcftools_optarg); break;
         case 10: // --indel-bias (inverted so higher => more indels called)
-            if (atof(optarg) < 1e-2)
+            if (atof(bcftools_optarg) < 1e-2)
                 mplp.indel_bias = 1/1e2;
             else
-                mplp.indel_bias = 1/atof(optarg);
+                mplp.indel_bias = 1/atof(bcftools_optarg);
             break;
         case 'A': use_orphan = 1; break;
-        case 'F': mplp.min_frac = atof(optarg); break;
-        case 'm': mplp.min_support = atoi(optarg); break;
-        case 'L': mplp.max_indel_depth = atoi(optarg); break;
-        case 'G': bam_smpl_add_readgroups(mplp.bsmpl, optarg, 1); break;
+        case 'F': mplp.min_frac = atof(bcftools_optarg); break;
+        case 'm': mplp.min_support = atoi(bcftools_optarg); break;
+        case 'L': mplp.max_indel_depth = atoi(bcftools_optarg); break;
+        case 'G': bam_smpl_add_readgroups(mplp.bsmpl, bcftools_optarg, 1); break;
         case 'a':
-            if (optarg[0]=='?') {
+            if (bcftools_optarg[0]=='?') {
                 list_annotations(bcftools_stderr);
                 return 1;
             }
-            mplp.fmt_flag |= parse_format_flag(optarg);
+            mplp.fmt_flag |= parse_format_flag(bcftools_optarg);
         break;
-        case 'M': mplp.max_read_len = atoi(optarg); break;
+        case 'M': mplp.max_read_len = atoi(bcftools_optarg); break;
         case 'U': mplp.fmt_flag &= ~B2B_INFO_ZSCORE; break;
         case 'X':
-            if (strcasecmp(optarg, "pacbio-ccs") == 0) {
+            if (strcasecmp(bcftools_optarg, "pacbio-ccs") == 0) {
                 mplp.min_frac = 0.1;
                 mplp.min_baseQ = 5;
                 mplp.max_baseQ = 50;
@@ -1390,14 +1390,14 @@ int main_mpileup(int argc, char *argv[])
                 mplp.extQ = 1;
                 mplp.flag |= MPLP_REALN_PARTIAL;
                 mplp.max_read_len = 99999;
-            } else if (strcasecmp(optarg, "ont") == 0) {
+            } else if (strcasecmp(bcftools_optarg, "ont") == 0) {
                 fprintf(bcftools_stderr, "For ONT it may be beneficial to also run bcftools call with "
                         "a higher -P, eg -P0.01 or -P 0.1\n");
                 mplp.min_baseQ = 5;
                 mplp.max_baseQ = 30;
                 mplp.flag &= ~MPLP_REALN;
                 mplp.flag |= MPLP_NO_INDEL;
-            } else if (strcasecmp(optarg, "1.12") == 0) {
+            } else if (strcasecmp(bcftools_optarg, "1.12") == 0) {
                 // 1.12 and earlier
                 mplp.min_frac = 0.002;
                 mplp.min_support = 1;
@@ -1405,21 +1405,21 @@ int main_mpileup(int argc, char *argv[])
                 mplp.tandemQ = 100;
                 mplp.flag &= ~MPLP_REALN_PARTIAL;
                 mplp.flag |= MPLP_REALN;
-            } else if (strcasecmp(optarg, "illumina") == 0) {
+            } else if (strcasecmp(bcftools_optarg, "illumina") == 0) {
                 mplp.flag |= MPLP_REALN_PARTIAL;
             } else {
                 fprintf(bcftools_stderr, "Unknown configuration name '%s'\n"
                         "Please choose from 1.12, illumina, pacbio-ccs or ont\n",
-                        optarg);
+                        bcftools_optarg);
                 return 1;
             }
             break;
-        case 13: hts_srand48(atoi(optarg)); break;
+        case 13: hts_srand48(atoi(bcftools_optarg)); break;
         case 14:
-            if ( !strcasecmp(optarg,"drop") ) mplp.ambig_reads = B2B_DROP;
-            else if ( !strcasecmp(optarg,"incAD") ) mplp.ambig_reads = B2B_INC_AD;
-            else if ( !strcasecmp(optarg,"incAD0") ) mplp.ambig_reads = B2B_INC_AD0;
-            else error("The option to --ambig-reads not recognised: %s\n",optarg);
+            if ( !strcasecmp(bcftools_optarg,"drop") ) mplp.ambig_reads = B2B_DROP;
+            else if ( !strcasecmp(bcftools_optarg,"incAD") ) mplp.ambig_reads = B2B_INC_AD;
+            else if ( !strcasecmp(bcftools_optarg,"incAD0") ) mplp.ambig_reads = B2B_INC_AD0;
+            else error("The option to --ambig-reads not recognised: %s\n",bcftools_optarg);
             break;
         default:
             fprintf(bcftools_stderr,"Invalid option: '%c'\n", c);
@@ -1469,9 +1469,9 @@ int main_mpileup(int argc, char *argv[])
     }
     else
     {
-        mplp.nfiles = argc - optind;
+        mplp.nfiles = argc - bcftools_optind;
         mplp.files  = (char**) malloc(mplp.nfiles*sizeof(char*));
-        for (i=0; i<mplp.nfiles; i++) mplp.files[i] = strdup(argv[optind+i]);
+        for (i=0; i<mplp.nfiles; i++) mplp.files[i] = strdup(argv[bcftools_optind+i]);
     }
     ret = mpileup(&mplp);
 
@@ -712,27 +712,27 @@ int main_reheader(int argc, char *argv[])
         {"threads",1,NULL,1},
         {0,0,0,0}
     };
-    while ((c = getopt_long(argc, argv, "s:h:o:f:T:",loptions,NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "s:h:o:f:T:",loptions,NULL)) >= 0)
     {
         switch (c)
         {
-            case  1 : args->n_threads = strtol(optarg, 0, 0); break;
-            case 'T': args->tmp_prefix = optarg; break;
-            case 'f': args->fai_fname = optarg; break;
-            case 'o': args->output_fname = optarg; break;
-            case 's': args->samples_fname = optarg; break;
-            case 'h': args->header_fname = optarg; break;
+            case  1 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
+            case 'T': args->tmp_prefix = bcftools_optarg; break;
+            case 'f': args->fai_fname = bcftools_optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
+            case 's': args->samples_fname = bcftools_optarg; break;
+            case 'h': args->header_fname = bcftools_optarg; break;
             case '?': usage(args); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) args->fname = "-";  // reading from stdin
         else usage(args);
     }
-    else args->fname = argv[optind];
+    else args->fname = argv[bcftools_optind];
 
     if ( args->fai_fname ) update_from_fai(args);
     if ( !args->samples_fname && !args->header_fname ) usage(args);
@@ -37,29 +37,29 @@ int main_tabix(int argc, char *argv[])
 {
     int c, min_shift = -1, is_force = 0, is_all = 0, detect = 1;
     tbx_conf_t conf = tbx_conf_gff;
-    while ((c = getopt(argc, argv, "0fap:s:b:e:S:c:m:")) >= 0)
+    while ((c = bcftools_getopt(argc, argv, "0fap:s:b:e:S:c:m:")) >= 0)
         if (c == '0') conf.preset |= TBX_UCSC;
         else if (c == 'f') is_force = 1;
         else if (c == 'a') is_all = 1;
-        else if (c == 'm') min_shift = atoi(optarg);
-        else if (c == 's') conf.sc = atoi(optarg);
-        else if (c == 'b') conf.bc = atoi(optarg);
-        else if (c == 'e') conf.ec = atoi(optarg);
-        else if (c == 'c') conf.meta_char = *optarg;
-        else if (c == 'S') conf.line_skip = atoi(optarg);
+        else if (c == 'm') min_shift = atoi(bcftools_optarg);
+        else if (c == 's') conf.sc = atoi(bcftools_optarg);
+        else if (c == 'b') conf.bc = atoi(bcftools_optarg);
+        else if (c == 'e') conf.ec = atoi(bcftools_optarg);
+        else if (c == 'c') conf.meta_char = *bcftools_optarg;
+        else if (c == 'S') conf.line_skip = atoi(bcftools_optarg);
         else if (c == 'p') {
-            if (strcmp(optarg, "gff") == 0) conf = tbx_conf_gff;
-            else if (strcmp(optarg, "bed") == 0) conf = tbx_conf_bed;
-            else if (strcmp(optarg, "sam") == 0) conf = tbx_conf_sam;
-            else if (strcmp(optarg, "vcf") == 0) conf = tbx_conf_vcf;
+            if (strcmp(bcftools_optarg, "gff") == 0) conf = tbx_conf_gff;
+            else if (strcmp(bcftools_optarg, "bed") == 0) conf = tbx_conf_bed;
+            else if (strcmp(bcftools_optarg, "sam") == 0) conf = tbx_conf_sam;
+            else if (strcmp(bcftools_optarg, "vcf") == 0) conf = tbx_conf_vcf;
             else {
-                fprintf(bcftools_stderr, "The type '%s' not recognised\n", optarg);
+                fprintf(bcftools_stderr, "The type '%s' not recognised\n", bcftools_optarg);
                 return 1;
             detect = 0;
             }
 
         }
-    if (optind == argc) {
+    if (bcftools_optind == argc) {
         fprintf(bcftools_stderr, "\nUsage: bcftools tabix [options] <in.gz> [reg1 [...]]\n\n");
         fprintf(bcftools_stderr, "Options: -p STR    preset: gff, bed, sam or vcf [gff]\n");
         fprintf(bcftools_stderr, "         -s INT    column number for sequence names (suppressed by -p) [1]\n");
@@ -78,26 +78,26 @@ int main_tabix(int argc, char *argv[])
         kstring_t s;
         BGZF *fp;
         s.l = s.m = 0; s.s = 0;
-        fp = bgzf_open(argv[optind], "r");
+        fp = bgzf_open(argv[bcftools_optind], "r");
         while (bgzf_getline(fp, '\n', &s) >= 0) bcftools_puts(s.s);
         bgzf_close(fp);
         free(s.s);
-    } else if (optind + 2 > argc) { // create index
+    } else if (bcftools_optind + 2 > argc) { // create index
         if ( detect )
         {
             // auto-detect file type by file name
-            int l = strlen(argv[optind]);
-            if (l>=7 && strcasecmp(argv[optind]+l-7, ".gff.gz") == 0) conf = tbx_conf_gff;
-            else if (l>=7 && strcasecmp(argv[optind]+l-7, ".bed.gz") == 0) conf = tbx_conf_bed;
-            else if (l>=7 && strcasecmp(argv[optind]+l-7, ".sam.gz") == 0) conf = tbx_conf_sam;
-            else if (l>=7 && strcasecmp(argv[optind]+l-7, ".vcf.gz") == 0) conf = tbx_conf_vcf;
+            int l = strlen(argv[bcftools_optind]);
+            if (l>=7 && strcasecmp(argv[bcftools_optind]+l-7, ".gff.gz") == 0) conf = tbx_conf_gff;
+            else if (l>=7 && strcasecmp(argv[bcftools_optind]+l-7, ".bed.gz") == 0) conf = tbx_conf_bed;
+            else if (l>=7 && strcasecmp(argv[bcftools_optind]+l-7, ".sam.gz") == 0) conf = tbx_conf_sam;
+            else if (l>=7 && strcasecmp(argv[bcftools_optind]+l-7, ".vcf.gz") == 0) conf = tbx_conf_vcf;
         }
 
         if (!is_force) {
             char *fn;
             FILE *fp;
-            fn = (char*)malloc(strlen(argv[optind]) + 5);
-            strcat(strcpy(fn, argv[optind]), min_shift <= 0? ".tbi" : ".csi");
+            fn = (char*)malloc(strlen(argv[bcftools_optind]) + 5);
+            strcat(strcpy(fn, argv[bcftools_optind]), min_shift <= 0? ".tbi" : ".csi");
             if ((fp = fopen(fn, "rb")) != 0) {
                 fclose(fp);
                 free(fn);
@@ -106,7 +106,7 @@ int main_tabix(int argc, char *argv[])
             }
             free(fn);
         }
-        if ( tbx_index_build(argv[optind], min_shift, &conf) )
+        if ( tbx_index_build(argv[bcftools_optind], min_shift, &conf) )
         {
             fprintf(bcftools_stderr,"tbx_index_build failed: Is the file bgzip-compressed? Was wrong -p [type] option used?\n");
             return 1;
@@ -116,10 +116,10 @@ int main_tabix(int argc, char *argv[])
         BGZF *fp;
         kstring_t s;
         int i;
-        if ((tbx = tbx_index_load(argv[optind])) == 0) return 1;
-        if ((fp = bgzf_open(argv[optind], "r")) == 0) return 1;
+        if ((tbx = tbx_index_load(argv[bcftools_optind])) == 0) return 1;
+        if ((fp = bgzf_open(argv[bcftools_optind], "r")) == 0) return 1;
         s.s = 0; s.l = s.m = 0;
-        for (i = optind + 1; i < argc; ++i) {
+        for (i = bcftools_optind + 1; i < argc; ++i) {
             hts_itr_t *itr;
             if ((itr = tbx_itr_querys(tbx, argv[i])) == 0) continue;
             while (tbx_bgzf_itr_next(fp, tbx, itr, &s) >= 0) bcftools_puts(s.s);
@@ -3111,74 +3111,74 @@ int main_vcfannotate(int argc, char *argv[])
         {"force",no_argument,NULL,'f'},
         {NULL,0,NULL,0}
     };
-    while ((c = getopt_long(argc, argv, "h:?o:O:r:R:a:x:c:C:i:e:S:s:I:m:kl:f",loptions,NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "h:?o:O:r:R:a:x:c:C:i:e:S:s:I:m:kl:f",loptions,NULL)) >= 0)
     {
         switch (c) {
             case 'f': args->force = 1; break;
             case 'k': args->keep_sites = 1; break;
             case 'm': 
                 args->mark_sites_logic = MARK_LISTED;
-                if ( optarg[0]=='+' ) args->mark_sites = optarg+1;
-                else if ( optarg[0]=='-' ) { args->mark_sites = optarg+1; args->mark_sites_logic = MARK_UNLISTED; }
-                else args->mark_sites = optarg; 
+                if ( bcftools_optarg[0]=='+' ) args->mark_sites = bcftools_optarg+1;
+                else if ( bcftools_optarg[0]=='-' ) { args->mark_sites = bcftools_optarg+1; args->mark_sites_logic = MARK_UNLISTED; }
+                else args->mark_sites = bcftools_optarg; 
                 break;
             case 'l': 
                 if ( args->merge_method_str.l ) kputc(',',&args->merge_method_str);
-                kputs(optarg,&args->merge_method_str);
+                kputs(bcftools_optarg,&args->merge_method_str);
                 break;
-            case 'I': args->set_ids_fmt = optarg; break;
-            case 's': args->sample_names = optarg; break;
-            case 'S': args->sample_names = optarg; args->sample_is_file = 1; break;
-            case 'c': args->columns = strdup(optarg); break;
-            case 'C': args->columns = strdup(optarg); args->columns_is_file = 1; break;
-            case 'o': args->output_fname = optarg; break;
+            case 'I': args->set_ids_fmt = bcftools_optarg; break;
+            case 's': args->sample_names = bcftools_optarg; break;
+            case 'S': args->sample_names = bcftools_optarg; args->sample_is_file = 1; break;
+            case 'c': args->columns = strdup(bcftools_optarg); break;
+            case 'C': args->columns = strdup(bcftools_optarg); args->columns_is_file = 1; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'O':
-                switch (optarg[0]) {
+                switch (bcftools_optarg[0]) {
                     case 'b': args->output_type = FT_BCF_GZ; break;
                     case 'u': args->output_type = FT_BCF; break;
                     case 'z': args->output_type = FT_VCF_GZ; break;
                     case 'v': args->output_type = FT_VCF; break;
-                    default: error("The output type \"%s\" not recognised\n", optarg);
+                    default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                 };
                 break;
             case 'e':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 'i':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
-            case 'x': args->remove_annots = optarg; break;
-            case 'a': args->targets_fname = optarg; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
-            case 'h': args->header_fname = optarg; break;
-            case  1 : args->rename_chrs = optarg; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
+            case 'x': args->remove_annots = bcftools_optarg; break;
+            case 'a': args->targets_fname = bcftools_optarg; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
+            case 'h': args->header_fname = bcftools_optarg; break;
+            case  1 : args->rename_chrs = bcftools_optarg; break;
             case  2 :
-                if ( !strcmp(optarg,"snps") ) collapse |= COLLAPSE_SNPS;
-                else if ( !strcmp(optarg,"indels") ) collapse |= COLLAPSE_INDELS;
-                else if ( !strcmp(optarg,"both") ) collapse |= COLLAPSE_SNPS | COLLAPSE_INDELS;
-                else if ( !strcmp(optarg,"any") ) collapse |= COLLAPSE_ANY;
-                else if ( !strcmp(optarg,"all") ) collapse |= COLLAPSE_ANY;
-                else if ( !strcmp(optarg,"some") ) collapse |= COLLAPSE_SOME;
-                else if ( !strcmp(optarg,"none") ) collapse = COLLAPSE_NONE;
-                else error("The --collapse string \"%s\" not recognised.\n", optarg);
+                if ( !strcmp(bcftools_optarg,"snps") ) collapse |= COLLAPSE_SNPS;
+                else if ( !strcmp(bcftools_optarg,"indels") ) collapse |= COLLAPSE_INDELS;
+                else if ( !strcmp(bcftools_optarg,"both") ) collapse |= COLLAPSE_SNPS | COLLAPSE_INDELS;
+                else if ( !strcmp(bcftools_optarg,"any") ) collapse |= COLLAPSE_ANY;
+                else if ( !strcmp(bcftools_optarg,"all") ) collapse |= COLLAPSE_ANY;
+                else if ( !strcmp(bcftools_optarg,"some") ) collapse |= COLLAPSE_SOME;
+                else if ( !strcmp(bcftools_optarg,"none") ) collapse = COLLAPSE_NONE;
+                else error("The --collapse string \"%s\" not recognised.\n", bcftools_optarg);
                 break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case  8 : args->record_cmd_line = 0; break;
             case 10 : args->single_overlaps = 1; break;
-            case 11 : args->rename_annots = optarg; break;
+            case 11 : args->rename_annots = bcftools_optarg; break;
             case '?': usage(args); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
     char *fname = NULL;
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";  // reading from stdin
         else usage(args);
     }
-    else fname = argv[optind];
+    else fname = argv[bcftools_optind];
 
     if ( args->regions_list )
     {
@@ -989,20 +989,20 @@ int main_vcfcall(int argc, char *argv[])
     };
 
     char *tmp = NULL;
-    while ((c = getopt_long(argc, argv, "h?o:O:r:R:s:S:t:T:ANMV:vcmp:C:n:P:f:a:ig:XYF:G:", loptions, NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "h?o:O:r:R:s:S:t:T:ANMV:vcmp:C:n:P:f:a:ig:XYF:G:", loptions, NULL)) >= 0)
     {
         switch (c)
         {
-            case  2 : ploidy_fname = optarg; break;
-            case  1 : ploidy = optarg; break;
+            case  2 : ploidy_fname = bcftools_optarg; break;
+            case  1 : ploidy = bcftools_optarg; break;
             case 'X': ploidy = "X"; fprintf(bcftools_stderr,"Warning: -X will be deprecated, please use --ploidy instead.\n"); break;
             case 'Y': ploidy = "Y"; fprintf(bcftools_stderr,"Warning: -Y will be deprecated, please use --ploidy instead.\n"); break;
-            case 'G': args.aux.sample_groups = optarg; break;
-            case  3 : args.aux.sample_groups_tag = optarg; break;
+            case 'G': args.aux.sample_groups = bcftools_optarg; break;
+            case  3 : args.aux.sample_groups_tag = bcftools_optarg; break;
             case 'f': fprintf(bcftools_stderr,"Warning: -f, --format-fields will be deprecated, please use -a, --annotate instead.\n");
             case 'a':
-                      if (optarg[0]=='?') { list_annotations(bcftools_stderr); return 1; }
-                      args.aux.output_tags |= parse_output_tags(optarg);
+                      if (bcftools_optarg[0]=='?') { list_annotations(bcftools_stderr); return 1; }
+                      args.aux.output_tags |= parse_output_tags(bcftools_optarg);
                       break;
             case 'M': args.flag &= ~CF_ACGT_ONLY; break;     // keep sites where REF is N
             case 'N': args.flag |= CF_ACGT_ONLY; break;      // omit sites where first base in REF is N (the new default)
@@ -1011,52 +1011,52 @@ int main_vcfcall(int argc, char *argv[])
             case 'i': args.flag |= CF_INS_MISSED; break;
             case 'v': args.aux.flag |= CALL_VARONLY; break;
             case 'F':
-                args.aux.prior_AN = optarg;
-                args.aux.prior_AC = strchr(optarg,',');
-                if ( !args.aux.prior_AC ) error("Expected two tags with -F (e.g. AN,AC), got \"%s\"\n",optarg);
+                args.aux.prior_AN = bcftools_optarg;
+                args.aux.prior_AC = strchr(bcftools_optarg,',');
+                if ( !args.aux.prior_AC ) error("Expected two tags with -F (e.g. AN,AC), got \"%s\"\n",bcftools_optarg);
                 *args.aux.prior_AC = 0;
                 args.aux.prior_AC++;
                 break;
             case 'g': 
-                args.gvcf = gvcf_init(optarg);
-                if ( !args.gvcf ) error("Could not parse: --gvcf %s\n", optarg);
+                args.gvcf = gvcf_init(bcftools_optarg);
+                if ( !args.gvcf ) error("Could not parse: --gvcf %s\n", bcftools_optarg);
                 break;
-            case 'o': args.output_fname = optarg; break;
+            case 'o': args.output_fname = bcftools_optarg; break;
             case 'O':
-                      switch (optarg[0]) {
+                      switch (bcftools_optarg[0]) {
                           case 'b': args.output_type = FT_BCF_GZ; break;
                           case 'u': args.output_type = FT_BCF; break;
                           case 'z': args.output_type = FT_VCF_GZ; break;
                           case 'v': args.output_type = FT_VCF; break;
-                          default: error("The output type \"%s\" not recognised\n", optarg);
+                          default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                       }
                       break;
             case 'C':
-                      if ( !strcasecmp(optarg,"alleles") ) args.aux.flag |= CALL_CONSTR_ALLELES;
-                      else if ( !strcasecmp(optarg,"trio") ) args.aux.flag |= CALL_CONSTR_TRIO;
-                      else error("Unknown argument to -C: \"%s\"\n", optarg);
+                      if ( !strcasecmp(bcftools_optarg,"alleles") ) args.aux.flag |= CALL_CONSTR_ALLELES;
+                      else if ( !strcasecmp(bcftools_optarg,"trio") ) args.aux.flag |= CALL_CONSTR_TRIO;
+                      else error("Unknown argument to -C: \"%s\"\n", bcftools_optarg);
                       break;
             case 'V':
-                      if ( !strcasecmp(optarg,"snps") ) args.flag |= CF_INDEL_ONLY;
-                      else if ( !strcasecmp(optarg,"indels") ) args.flag |= CF_NO_INDEL;
-                      else error("Unknown skip category \"%s\" (-S argument must be \"snps\" or \"indels\")\n", optarg);
+                      if ( !strcasecmp(bcftools_optarg,"snps") ) args.flag |= CF_INDEL_ONLY;
+                      else if ( !strcasecmp(bcftools_optarg,"indels") ) args.flag |= CF_NO_INDEL;
+                      else error("Unknown skip category \"%s\" (-S argument must be \"snps\" or \"indels\")\n", bcftools_optarg);
                       break;
             case 'm': args.flag |= CF_MCALL; break;         // multiallelic calling method
             case 'p':
-                args.aux.pref = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: --pval-threshold %s\n", optarg);
+                args.aux.pref = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: --pval-threshold %s\n", bcftools_optarg);
                 break;
-            case 'P': args.aux.theta = strtod(optarg,&tmp);
-                      if ( *tmp ) error("Could not parse, expected float argument: -P %s\n", optarg);
+            case 'P': args.aux.theta = strtod(bcftools_optarg,&tmp);
+                      if ( *tmp ) error("Could not parse, expected float argument: -P %s\n", bcftools_optarg);
                       break;
-            case 'n': parse_novel_rate(&args,optarg); break;
-            case 'r': args.regions = optarg; break;
-            case 'R': args.regions = optarg; args.regions_is_file = 1; break;
-            case 't': args.targets = optarg; break;
-            case 'T': args.targets = optarg; args.targets_is_file = 1; break;
-            case 's': args.samples_fname = optarg; break;
-            case 'S': args.samples_fname = optarg; args.samples_is_file = 1; break;
-            case  9 : args.n_threads = strtol(optarg, 0, 0); break;
+            case 'n': parse_novel_rate(&args,bcftools_optarg); break;
+            case 'r': args.regions = bcftools_optarg; break;
+            case 'R': args.regions = bcftools_optarg; args.regions_is_file = 1; break;
+            case 't': args.targets = bcftools_optarg; break;
+            case 'T': args.targets = bcftools_optarg; args.targets_is_file = 1; break;
+            case 's': args.samples_fname = bcftools_optarg; break;
+            case 'S': args.samples_fname = bcftools_optarg; args.samples_is_file = 1; break;
+            case  9 : args.n_threads = strtol(bcftools_optarg, 0, 0); break;
             case  8 : args.record_cmd_line = 0; break;
             default: usage(&args);
         }
@@ -1065,12 +1065,12 @@ int main_vcfcall(int argc, char *argv[])
     if ( ploidy_fname ) args.ploidy = ploidy_init(ploidy_fname, 2);
     else if ( ploidy ) args.ploidy = init_ploidy(ploidy);
 
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) args.bcf_fname = "-";  // reading from stdin
         else usage(&args);
     }
-    else args.bcf_fname = argv[optind++];
+    else args.bcf_fname = argv[bcftools_optind++];
 
     if ( !ploidy_fname && !ploidy )
     {
@@ -1292,24 +1292,24 @@ int main_vcfcnv(int argc, char *argv[])
         {0,0,0,0}
     };
     char *tmp = NULL;
-    while ((c = getopt_long(argc, argv, "h?r:R:t:T:s:o:p:l:T:c:b:P:x:e:O:W:f:a:L:d:k:",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "h?r:R:t:T:s:o:p:l:T:c:b:P:x:e:O:W:f:a:L:d:k:",loptions,NULL)) >= 0) {
         switch (c) {
             case 'L': 
-                args->lrr_smooth_win = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse: --LRR-smooth-win %s\n", optarg);
+                args->lrr_smooth_win = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse: --LRR-smooth-win %s\n", bcftools_optarg);
                 break;
-            case 'f': args->af_fname = optarg; break;
+            case 'f': args->af_fname = bcftools_optarg; break;
             case 'O': 
-                args->optimize_frac = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -O %s\n", optarg);
+                args->optimize_frac = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -O %s\n", bcftools_optarg);
                 break;
             case 'd':
-                args->query_sample.baf_dev2_dflt = strtod(optarg,&tmp);
+                args->query_sample.baf_dev2_dflt = strtod(bcftools_optarg,&tmp);
                 if ( *tmp )
                 {
-                    if ( *tmp!=',') error("Could not parse: -d %s\n", optarg);
+                    if ( *tmp!=',') error("Could not parse: -d %s\n", bcftools_optarg);
                     args->control_sample.baf_dev2_dflt = strtod(tmp+1,&tmp);
-                    if ( *tmp ) error("Could not parse: -d %s\n", optarg);
+                    if ( *tmp ) error("Could not parse: -d %s\n", bcftools_optarg);
                 }
                 else
                     args->control_sample.baf_dev2_dflt = args->query_sample.baf_dev2_dflt;
@@ -1317,12 +1317,12 @@ int main_vcfcnv(int argc, char *argv[])
                 args->control_sample.baf_dev2_dflt *= args->control_sample.baf_dev2_dflt;
                 break;
             case 'k':
-                args->query_sample.lrr_dev2 = strtod(optarg,&tmp);
+                args->query_sample.lrr_dev2 = strtod(bcftools_optarg,&tmp);
                 if ( *tmp )
                 {
-                    if ( *tmp!=',') error("Could not parse: -k %s\n", optarg);
+                    if ( *tmp!=',') error("Could not parse: -k %s\n", bcftools_optarg);
                     args->control_sample.lrr_dev2 = strtod(tmp+1,&tmp);
-                    if ( *tmp ) error("Could not parse: -d %s\n", optarg);
+                    if ( *tmp ) error("Could not parse: -d %s\n", bcftools_optarg);
                 }
                 else
                     args->control_sample.lrr_dev2 = args->query_sample.lrr_dev2;
@@ -1330,61 +1330,61 @@ int main_vcfcnv(int argc, char *argv[])
                 args->control_sample.lrr_dev2 *= args->control_sample.lrr_dev2;
                 break;
             case 'a':
-                args->query_sample.cell_frac_dflt = strtod(optarg,&tmp);
+                args->query_sample.cell_frac_dflt = strtod(bcftools_optarg,&tmp);
                 if ( *tmp )
                 {
-                    if ( *tmp!=',') error("Could not parse: -a %s\n", optarg);
+                    if ( *tmp!=',') error("Could not parse: -a %s\n", bcftools_optarg);
                     args->control_sample.cell_frac_dflt = strtod(tmp+1,&tmp);
-                    if ( *tmp ) error("Could not parse: -a %s\n", optarg);
+                    if ( *tmp ) error("Could not parse: -a %s\n", bcftools_optarg);
                 }
                 break;
             case 'W':
-                args->baum_welch_th = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -W %s\n", optarg);
+                args->baum_welch_th = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -W %s\n", bcftools_optarg);
                 break;
             case 'e': 
-                args->err_prob = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -e %s\n", optarg);
+                args->err_prob = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -e %s\n", bcftools_optarg);
                 break;
             case 'b': 
-                args->baf_bias = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -b %s\n", optarg);
+                args->baf_bias = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -b %s\n", bcftools_optarg);
                 break;
             case 'x': 
-                args->ij_prob = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -x %s\n", optarg);
+                args->ij_prob = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -x %s\n", bcftools_optarg);
                 break;
             case 'P': 
-                args->same_prob = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -P %s\n", optarg);
+                args->same_prob = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -P %s\n", bcftools_optarg);
                 break;
             case 'l': 
-                args->lrr_bias = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -l %s\n", optarg);
+                args->lrr_bias = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -l %s\n", bcftools_optarg);
                 break;
             case 'p': 
-                args->plot_th = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -p %s\n", optarg);
+                args->plot_th = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -p %s\n", bcftools_optarg);
                 break;
-            case 'o': args->output_dir = optarg; break;
-            case 's': args->query_sample.name = strdup(optarg); break;
-            case 'c': args->control_sample.name = optarg; break;
-            case 't': args->targets_list = optarg; break;
-            case 'T': args->targets_list = optarg; targets_is_file = 1; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
+            case 'o': args->output_dir = bcftools_optarg; break;
+            case 's': args->query_sample.name = strdup(bcftools_optarg); break;
+            case 'c': args->control_sample.name = bcftools_optarg; break;
+            case 't': args->targets_list = bcftools_optarg; break;
+            case 'T': args->targets_list = bcftools_optarg; targets_is_file = 1; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
             case 'h': 
             case '?': usage(args); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
     char *fname = NULL;
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";
     }
-    else fname = argv[optind];
+    else fname = argv[bcftools_optind];
     if ( !fname ) usage(args);
 
     if ( !args->output_dir ) error("Expected -o option\n");
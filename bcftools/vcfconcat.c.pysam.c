@@ -901,50 +901,50 @@ int main_vcfconcat(int argc, char *argv[])
         {NULL,0,NULL,0}
     };
     char *tmp;
-    while ((c = getopt_long(argc, argv, "h:?o:O:f:alq:Dd:r:R:cnv:",loptions,NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "h:?o:O:f:alq:Dd:r:R:cnv:",loptions,NULL)) >= 0)
     {
         switch (c) {
             case 'c': args->compact_PS = 1; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; args->regions_is_file = 1; break;
-            case 'd': args->remove_dups = optarg; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; args->regions_is_file = 1; break;
+            case 'd': args->remove_dups = bcftools_optarg; break;
             case 'D': args->remove_dups = "exact"; break;
             case 'q': 
-                args->min_PQ = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --min-PQ %s\n", optarg);
+                args->min_PQ = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --min-PQ %s\n", bcftools_optarg);
                 break;
             case 'n': args->naive_concat = 1; break;
             case 'a': args->allow_overlaps = 1; break;
             case 'l': args->phased_concat = 1; break;
-            case 'f': args->file_list = optarg; break;
-            case 'o': args->output_fname = optarg; break;
+            case 'f': args->file_list = bcftools_optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'O':
-                switch (optarg[0]) {
+                switch (bcftools_optarg[0]) {
                     case 'b': args->output_type = FT_BCF_GZ; break;
                     case 'u': args->output_type = FT_BCF; break;
                     case 'z': args->output_type = FT_VCF_GZ; break;
                     case 'v': args->output_type = FT_VCF; break;
-                    default: error("The output type \"%s\" not recognised\n", optarg);
+                    default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                 };
                 break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case  8 : args->record_cmd_line = 0; break;
             case  7 : args->naive_concat = 1; args->naive_concat_trust_headers = 1; break;
             case 'v':
-                      args->verbose = strtol(optarg, 0, 0);
+                      args->verbose = strtol(bcftools_optarg, 0, 0);
                       error("Error: currently only --verbose 0 or --verbose 1 is supported\n");
                       break;
             case 'h':
             case '?': usage(args); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
-    while ( optind<argc )
+    while ( bcftools_optind<argc )
     {
         args->nfnames++;
         args->fnames = (char **)realloc(args->fnames,sizeof(char*)*args->nfnames);
-        args->fnames[args->nfnames-1] = strdup(argv[optind]);
-        optind++;
+        args->fnames[args->nfnames-1] = strdup(argv[bcftools_optind]);
+        bcftools_optind++;
     }
     if ( args->allow_overlaps && args->phased_concat ) error("The options -a and -l should not be combined. Please run with -l only.\n");
     if ( args->compact_PS && !args->phased_concat ) error("The -c option is intended only with -l\n");
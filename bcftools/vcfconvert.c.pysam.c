@@ -1488,60 +1488,60 @@ int main_vcfconvert(int argc, char *argv[])
         {"keep-duplicates",no_argument,NULL,12},
         {NULL,0,NULL,0}
     };
-    while ((c = getopt_long(argc, argv, "?h:r:R:s:S:t:T:i:e:g:G:o:O:c:f:H:",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "?h:r:R:s:S:t:T:i:e:g:G:o:O:c:f:H:",loptions,NULL)) >= 0) {
         switch (c) {
             case 'e':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 'i':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; args->regions_is_file = 1; break;
-            case 't': args->targets_list = optarg; break;
-            case 'T': args->targets_list = optarg; args->targets_is_file = 1; break;
-            case 's': args->sample_list = optarg; break;
-            case 'S': args->sample_list = optarg; args->sample_is_file = 1; break;
-            case 'g': args->convert_func = vcf_to_gensample; args->outfname = optarg; break;
-            case 'G': args->convert_func = gensample_to_vcf; args->infname = optarg; break;
-            case  1 : args->tag = optarg; break;
-            case  2 : args->convert_func = tsv_to_vcf; args->infname = optarg; break;
-            case  3 : args->convert_func = hapsample_to_vcf; args->infname = optarg; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; args->regions_is_file = 1; break;
+            case 't': args->targets_list = bcftools_optarg; break;
+            case 'T': args->targets_list = bcftools_optarg; args->targets_is_file = 1; break;
+            case 's': args->sample_list = bcftools_optarg; break;
+            case 'S': args->sample_list = bcftools_optarg; args->sample_is_file = 1; break;
+            case 'g': args->convert_func = vcf_to_gensample; args->outfname = bcftools_optarg; break;
+            case 'G': args->convert_func = gensample_to_vcf; args->infname = bcftools_optarg; break;
+            case  1 : args->tag = bcftools_optarg; break;
+            case  2 : args->convert_func = tsv_to_vcf; args->infname = bcftools_optarg; break;
+            case  3 : args->convert_func = hapsample_to_vcf; args->infname = bcftools_optarg; break;
             case  4 : args->output_vcf_ids = 1; break;
             case  5 : args->hap2dip = 1; break;
             case  6 : args->convert_func = gvcf_to_vcf; break;
-            case  7 : args->convert_func = vcf_to_hapsample; args->outfname = optarg; break;
+            case  7 : args->convert_func = vcf_to_hapsample; args->outfname = bcftools_optarg; break;
             case  8 : args->output_chrom_first_col = 1; break;
-            case 'H': args->convert_func = haplegendsample_to_vcf; args->infname = optarg; break;
-            case 'f': args->ref_fname = optarg; break;
-            case 'c': args->columns = optarg; break;
-            case 'o': args->outfname = optarg; break;
+            case 'H': args->convert_func = haplegendsample_to_vcf; args->infname = bcftools_optarg; break;
+            case 'f': args->ref_fname = bcftools_optarg; break;
+            case 'c': args->columns = bcftools_optarg; break;
+            case 'o': args->outfname = bcftools_optarg; break;
             case 'O':
-                switch (optarg[0]) {
+                switch (bcftools_optarg[0]) {
                     case 'b': args->output_type = FT_BCF_GZ; break;
                     case 'u': args->output_type = FT_BCF; break;
                     case 'z': args->output_type = FT_VCF_GZ; break;
                     case 'v': args->output_type = FT_VCF; break;
-                    default: error("The output type \"%s\" not recognised\n", optarg);
+                    default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                 }
                 break;
-            case 'h': args->convert_func = vcf_to_haplegendsample; args->outfname = optarg; break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case 'h': args->convert_func = vcf_to_haplegendsample; args->outfname = bcftools_optarg; break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case 10 : args->record_cmd_line = 0; break;
-            case 11 : args->sex_fname = optarg; break;
+            case 11 : args->sex_fname = bcftools_optarg; break;
             case 12 : args->keep_duplicates = 1; break;
             case '?': usage(); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
     if ( !args->infname )
     {
-        if ( optind>=argc )
+        if ( bcftools_optind>=argc )
         {
             if ( !isatty(fileno((FILE *)stdin)) ) args->infname = "-";
         }
-        else args->infname = argv[optind];
+        else args->infname = argv[bcftools_optind];
     }
     if ( !args->infname ) usage();
     
@@ -461,11 +461,11 @@ int main_vcffilter(int argc, char *argv[])
         {NULL,0,NULL,0}
     };
     char *tmp;
-    while ((c = getopt_long(argc, argv, "e:i:t:T:r:R:h?s:m:o:O:g:G:S:",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "e:i:t:T:r:R:h?s:m:o:O:g:G:S:",loptions,NULL)) >= 0) {
         switch (c) {
             case 'g':
-                args->snp_gap = strtol(optarg,&tmp,10); 
-                if ( *tmp && *tmp!=':' ) error("Could not parse argument: --SnpGap %s\n", optarg);
+                args->snp_gap = strtol(bcftools_optarg,&tmp,10); 
+                if ( *tmp && *tmp!=':' ) error("Could not parse argument: --SnpGap %s\n", bcftools_optarg);
                 if ( *tmp==':' )
                 {
                     args->snp_gap_str = tmp+1;
@@ -478,7 +478,7 @@ int main_vcffilter(int argc, char *argv[])
                         else if ( !strcasecmp(keys[i],"bnd") ) args->snp_gap_type |= VCF_BND;
                         else if ( !strcasecmp(keys[i],"other") ) args->snp_gap_type |= VCF_OTHER;
                         else if ( !strcasecmp(keys[i],"overlap") ) args->snp_gap_type |= VCF_OVERLAP;
-                        else error("Could not parse \"%s\" in \"--SnpGap %s\"\n", keys[i], optarg);
+                        else error("Could not parse \"%s\" in \"--SnpGap %s\"\n", keys[i], bcftools_optarg);
                         free(keys[i]);
                     }
                     if ( n ) free(keys);
@@ -490,55 +490,55 @@ int main_vcffilter(int argc, char *argv[])
                 }
                 break;
             case 'G':
-                args->indel_gap = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --IndelGap %s\n", optarg);
+                args->indel_gap = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --IndelGap %s\n", bcftools_optarg);
                 break;
-            case 'o': args->output_fname = optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'O':
-                switch (optarg[0]) {
+                switch (bcftools_optarg[0]) {
                     case 'b': args->output_type = FT_BCF_GZ; break;
                     case 'u': args->output_type = FT_BCF; break;
                     case 'z': args->output_type = FT_VCF_GZ; break;
                     case 'v': args->output_type = FT_VCF; break;
-                    default: error("The output type \"%s\" not recognised\n", optarg);
+                    default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                 }
                 break;
-            case 's': args->soft_filter = optarg; break;
+            case 's': args->soft_filter = bcftools_optarg; break;
             case 'm':
-                if ( strchr(optarg,'x') ) args->annot_mode |= ANNOT_RESET;
-                if ( strchr(optarg,'+') ) args->annot_mode |= ANNOT_ADD;
+                if ( strchr(bcftools_optarg,'x') ) args->annot_mode |= ANNOT_RESET;
+                if ( strchr(bcftools_optarg,'+') ) args->annot_mode |= ANNOT_ADD;
                 break;
-            case 't': args->targets_list = optarg; break;
-            case 'T': args->targets_list = optarg; targets_is_file = 1; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
+            case 't': args->targets_list = bcftools_optarg; break;
+            case 'T': args->targets_list = bcftools_optarg; targets_is_file = 1; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
             case 'e':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 'i':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
             case 'S':
-                if ( !strcmp(".",optarg) ) args->set_gts = SET_GTS_MISSING;
-                else if ( !strcmp("0",optarg) ) args->set_gts = SET_GTS_REF;
-                else error("The argument to -S not recognised: %s\n", optarg);
+                if ( !strcmp(".",bcftools_optarg) ) args->set_gts = SET_GTS_MISSING;
+                else if ( !strcmp("0",bcftools_optarg) ) args->set_gts = SET_GTS_REF;
+                else error("The argument to -S not recognised: %s\n", bcftools_optarg);
                 break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case  8 : args->record_cmd_line = 0; break;
             case 'h':
             case '?': usage(args); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
     if ( args->filter_logic == (FLT_EXCLUDE|FLT_INCLUDE) ) error("Only one of -i or -e can be given.\n");
     char *fname = NULL;
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";  // reading from stdin
         else usage(args);
     }
-    else fname = argv[optind];
+    else fname = argv[bcftools_optind];
 
     // read in the regions from the command line
     if ( args->regions_list )
@@ -547,12 +547,12 @@ int main_vcffilter(int argc, char *argv[])
         if ( bcf_sr_set_regions(args->files, args->regions_list, regions_is_file)<0 )
             error("Failed to read the regions: %s\n", args->regions_list);
     }
-    else if ( optind+1 < argc )
+    else if ( bcftools_optind+1 < argc )
     {
         int i;
         kstring_t tmp = {0,0,0};
-        kputs(argv[optind+1],&tmp);
-        for (i=optind+2; i<argc; i++) { kputc(',',&tmp); kputs(argv[i],&tmp); }
+        kputs(argv[bcftools_optind+1],&tmp);
+        for (i=bcftools_optind+2; i<argc; i++) { kputc(',',&tmp); kputs(argv[i],&tmp); }
         args->files->require_index = 1;
         if ( bcf_sr_set_regions(args->files, tmp.s, regions_is_file)<0 )
             error("Failed to read the regions: %s\n", args->regions_list);
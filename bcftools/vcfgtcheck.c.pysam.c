@@ -1119,25 +1119,25 @@ int main_vcfgtcheck(int argc, char *argv[])
         {0,0,0,0}
     };
     char *tmp;
-    while ((c = getopt_long(argc, argv, "hg:p:s:S:p:P:Hr:R:at:T:G:c:u:e:",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "hg:p:s:S:p:P:Hr:R:at:T:G:c:u:e:",loptions,NULL)) >= 0) {
         switch (c) {
             case 'e':
-                args->use_PLs = strtol(optarg,&tmp,10);
-                if ( !tmp || *tmp ) error("Could not parse: --error-probability %s\n", optarg);
+                args->use_PLs = strtol(bcftools_optarg,&tmp,10);
+                if ( !tmp || *tmp ) error("Could not parse: --error-probability %s\n", bcftools_optarg);
                 break;
             case 'u':
                 {
                     int i,nlist;
-                    char **list = hts_readlist(optarg, 0, &nlist);
-                    if ( !list || nlist<=0 || nlist>2 ) error("Failed to parse --use %s\n", optarg);
+                    char **list = hts_readlist(bcftools_optarg, 0, &nlist);
+                    if ( !list || nlist<=0 || nlist>2 ) error("Failed to parse --use %s\n", bcftools_optarg);
                     if ( !strcasecmp("GT",list[0]) ) args->qry_use_GT = 1;
                     else if ( !strcasecmp("PL",list[0]) ) args->qry_use_GT = 0;
-                    else error("Failed to parse --use %s; only GT and PL are supported\n", optarg);
+                    else error("Failed to parse --use %s; only GT and PL are supported\n", bcftools_optarg);
                     if ( nlist==2 )
                     {
                         if ( !strcasecmp("GT",list[1]) ) args->gt_use_GT = 1;
                         else if ( !strcasecmp("PL",list[1]) ) args->gt_use_GT = 0;
-                        else error("Failed to parse --use %s; only GT and PL are supported\n", optarg);
+                        else error("Failed to parse --use %s; only GT and PL are supported\n", bcftools_optarg);
                     }
                     else args->gt_use_GT = args->qry_use_GT;
                     for (i=0; i<nlist; i++) free(list[i]);
@@ -1145,8 +1145,8 @@ int main_vcfgtcheck(int argc, char *argv[])
                 }
                 break;
             case 2 :
-                args->ntop = strtol(optarg,&tmp,10);
-                if ( !tmp || *tmp ) error("Could not parse: --n-matches %s\n", optarg);
+                args->ntop = strtol(bcftools_optarg,&tmp,10);
+                if ( !tmp || *tmp ) error("Could not parse: --n-matches %s\n", bcftools_optarg);
                 if ( args->ntop < 0 )
                 {
                     args->sort_by_hwe = 1;
@@ -1157,10 +1157,10 @@ int main_vcfgtcheck(int argc, char *argv[])
             case 4 : error("The option -S, --target-sample has been deprecated\n"); break;
             case 5 : args->dry_run = 1; break;
             case 6 : 
-                args->distinctive_sites = strtod(optarg,&tmp);
+                args->distinctive_sites = strtod(bcftools_optarg,&tmp);
                 if ( *tmp )
                 {
-                    if ( *tmp!=',' ) error("Could not parse: --distinctive-sites %s\n", optarg);
+                    if ( *tmp!=',' ) error("Could not parse: --distinctive-sites %s\n", bcftools_optarg);
                     tmp++;
                     free(args->es_max_mem);
                     args->es_max_mem = strdup(tmp);
@@ -1171,47 +1171,47 @@ int main_vcfgtcheck(int argc, char *argv[])
                 break;
             case 'c':
                 error("The -c option is to be implemented, please open an issue on github\n");
-                args->min_inter_err = strtod(optarg,&tmp);
+                args->min_inter_err = strtod(bcftools_optarg,&tmp);
                 if ( *tmp )
                 {
-                    if ( *tmp!=',') error("Could not parse: -c %s\n", optarg);
+                    if ( *tmp!=',') error("Could not parse: -c %s\n", bcftools_optarg);
                     args->max_intra_err = strtod(tmp+1,&tmp);
-                    if ( *tmp ) error("Could not parse: -c %s\n", optarg);
+                    if ( *tmp ) error("Could not parse: -c %s\n", bcftools_optarg);
                 }
                 break;
             case 'G': error("The option -G, --GTs-only has been deprecated\n"); break;
             case 'a': args->all_sites = 1; error("The -a option is to be implemented, please open an issue on github\n"); break;
             case 'H': args->hom_only = 1; break;
-            case 'g': args->gt_fname = optarg; break;
-//            case 'p': args->plot = optarg; break;
+            case 'g': args->gt_fname = bcftools_optarg; break;
+//            case 'p': args->plot = bcftools_optarg; break;
             case 's':
-                if ( !strncasecmp("gt:",optarg,3) ) args->gt_samples = optarg+3;
-                else if ( !strncasecmp("qry:",optarg,4) ) args->qry_samples = optarg+4;
-                else error("Which one? Query samples (qry:%s) or genotype samples (gt:%s)?\n",optarg,optarg);
+                if ( !strncasecmp("gt:",bcftools_optarg,3) ) args->gt_samples = bcftools_optarg+3;
+                else if ( !strncasecmp("qry:",bcftools_optarg,4) ) args->qry_samples = bcftools_optarg+4;
+                else error("Which one? Query samples (qry:%s) or genotype samples (gt:%s)?\n",bcftools_optarg,bcftools_optarg);
                 break;
             case 'S': 
-                if ( !strncasecmp("gt:",optarg,3) ) args->gt_samples = optarg+3, args->gt_samples_is_file = 1;
-                else if ( !strncasecmp("qry:",optarg,4) ) args->qry_samples = optarg+4, args->qry_samples_is_file = 1;
-                else error("Which one? Query samples (qry:%s) or genotype samples (gt:%s)?\n",optarg,optarg);
+                if ( !strncasecmp("gt:",bcftools_optarg,3) ) args->gt_samples = bcftools_optarg+3, args->gt_samples_is_file = 1;
+                else if ( !strncasecmp("qry:",bcftools_optarg,4) ) args->qry_samples = bcftools_optarg+4, args->qry_samples_is_file = 1;
+                else error("Which one? Query samples (qry:%s) or genotype samples (gt:%s)?\n",bcftools_optarg,bcftools_optarg);
                 break;
-            case 'p': args->pair_samples = optarg; break;
-            case 'P': args->pair_samples = optarg; args->pair_samples_is_file = 1; break;
-            case 'r': args->regions = optarg; break;
-            case 'R': args->regions = optarg; args->regions_is_file = 1; break;
-            case 't': args->targets = optarg; break;
-            case 'T': args->targets = optarg; args->targets_is_file = 1; break;
+            case 'p': args->pair_samples = bcftools_optarg; break;
+            case 'P': args->pair_samples = bcftools_optarg; args->pair_samples_is_file = 1; break;
+            case 'r': args->regions = bcftools_optarg; break;
+            case 'R': args->regions = bcftools_optarg; args->regions_is_file = 1; break;
+            case 't': args->targets = bcftools_optarg; break;
+            case 'T': args->targets = bcftools_optarg; args->targets_is_file = 1; break;
             case 'h':
             case '?': usage(); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
-    if ( optind==argc )
+    if ( bcftools_optind==argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) args->qry_fname = "-";  // reading from stdin
         else usage();   // no files given
     }
-    else args->qry_fname = argv[optind];
-    if ( argc>optind+1 ) error("Error: too many files given, run with -h for help\n");  // too many files given
+    else args->qry_fname = argv[bcftools_optind];
+    if ( argc>bcftools_optind+1 ) error("Error: too many files given, run with -h for help\n");  // too many files given
     if ( args->pair_samples )
     {
         if ( args->gt_samples || args->qry_samples ) error("The -p/-P option cannot be combined with -s/-S\n");
@@ -222,7 +222,7 @@ int main_vcfindex(int argc, char *argv[])
     };
 
     char *tmp;
-    while ((c = getopt_long(argc, argv, "ctfm:sno:", loptions, NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "ctfm:sno:", loptions, NULL)) >= 0)
     {
         switch (c)
         {
@@ -230,16 +230,16 @@ int main_vcfindex(int argc, char *argv[])
             case 't': tbi = 1; min_shift = 0; break;
             case 'f': force = 1; break;
             case 'm':
-                min_shift = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --min-shift %s\n", optarg);
+                min_shift = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --min-shift %s\n", bcftools_optarg);
                 break;
             case 's': stats |= per_contig; break;
             case 'n': stats |= total; break;
             case 9:
-                n_threads = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --threads %s\n", optarg);
+                n_threads = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --threads %s\n", bcftools_optarg);
                 break;
-            case 'o': outfn = optarg; break;
+            case 'o': outfn = bcftools_optarg; break;
             default: usage();
         }
     }
@@ -260,12 +260,12 @@ int main_vcfindex(int argc, char *argv[])
     }
 
     char *fname = NULL;
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";  // reading from stdin
         else usage();
     }
-    else fname = argv[optind];
+    else fname = argv[bcftools_optind];
     if (stats) return vcf_index_stats(fname, stats);
 
     kstring_t idx_fname = {0,0,0};
@@ -529,82 +529,82 @@ int main_vcfisec(int argc, char *argv[])
         {"no-version",no_argument,NULL,8},
         {NULL,0,NULL,0}
     };
-    while ((c = getopt_long(argc, argv, "hc:r:R:p:n:w:t:T:Cf:o:O:i:e:",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "hc:r:R:p:n:w:t:T:Cf:o:O:i:e:",loptions,NULL)) >= 0) {
         switch (c) {
-            case 'o': args->output_fname = optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'O':
-                switch (optarg[0]) {
+                switch (bcftools_optarg[0]) {
                     case 'b': args->output_type = FT_BCF_GZ; break;
                     case 'u': args->output_type = FT_BCF; break;
                     case 'z': args->output_type = FT_VCF_GZ; break;
                     case 'v': args->output_type = FT_VCF; break;
-                    default: error("The output type \"%s\" not recognised\n", optarg);
+                    default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                 }
                 break;
             case 'c':
-                if ( !strcmp(optarg,"snps") ) args->files->collapse |= COLLAPSE_SNPS;
-                else if ( !strcmp(optarg,"indels") ) args->files->collapse |= COLLAPSE_INDELS;
-                else if ( !strcmp(optarg,"both") ) args->files->collapse |= COLLAPSE_SNPS | COLLAPSE_INDELS;
-                else if ( !strcmp(optarg,"any") ) args->files->collapse |= COLLAPSE_ANY;
-                else if ( !strcmp(optarg,"all") ) args->files->collapse |= COLLAPSE_ANY;
-                else if ( !strcmp(optarg,"some") ) args->files->collapse |= COLLAPSE_SOME;
-                else if ( !strcmp(optarg,"none") ) args->files->collapse = COLLAPSE_NONE;
-                else error("The --collapse string \"%s\" not recognised.\n", optarg);
+                if ( !strcmp(bcftools_optarg,"snps") ) args->files->collapse |= COLLAPSE_SNPS;
+                else if ( !strcmp(bcftools_optarg,"indels") ) args->files->collapse |= COLLAPSE_INDELS;
+                else if ( !strcmp(bcftools_optarg,"both") ) args->files->collapse |= COLLAPSE_SNPS | COLLAPSE_INDELS;
+                else if ( !strcmp(bcftools_optarg,"any") ) args->files->collapse |= COLLAPSE_ANY;
+                else if ( !strcmp(bcftools_optarg,"all") ) args->files->collapse |= COLLAPSE_ANY;
+                else if ( !strcmp(bcftools_optarg,"some") ) args->files->collapse |= COLLAPSE_SOME;
+                else if ( !strcmp(bcftools_optarg,"none") ) args->files->collapse = COLLAPSE_NONE;
+                else error("The --collapse string \"%s\" not recognised.\n", bcftools_optarg);
                 break;
-            case 'f': args->files->apply_filters = optarg; break;
+            case 'f': args->files->apply_filters = bcftools_optarg; break;
             case 'C':
                 if ( args->isec_op!=0 && args->isec_op!=OP_COMPLEMENT ) error("Error: either -C or -n should be given, not both.\n");
                 args->isec_op = OP_COMPLEMENT; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
-            case 't': args->targets_list = optarg; break;
-            case 'T': args->targets_list = optarg; targets_is_file = 1; break;
-            case 'p': args->prefix = optarg; break;
-            case 'w': args->write_files = optarg; break;
-            case 'i': add_filter(args, optarg, FLT_INCLUDE); break;
-            case 'e': add_filter(args, optarg, FLT_EXCLUDE); break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
+            case 't': args->targets_list = bcftools_optarg; break;
+            case 'T': args->targets_list = bcftools_optarg; targets_is_file = 1; break;
+            case 'p': args->prefix = bcftools_optarg; break;
+            case 'w': args->write_files = bcftools_optarg; break;
+            case 'i': add_filter(args, bcftools_optarg, FLT_INCLUDE); break;
+            case 'e': add_filter(args, bcftools_optarg, FLT_EXCLUDE); break;
             case 'n':
                 {
                     if ( args->isec_op!=0 && args->isec_op==OP_COMPLEMENT ) error("Error: either -C or -n should be given, not both.\n");
                     if ( args->isec_op!=0 ) error("Error: -n should be given only once.\n");
-                    char *p = optarg;
+                    char *p = bcftools_optarg;
                     if ( *p=='-' ) { args->isec_op = OP_MINUS; p++; }
                     else if ( *p=='+' ) { args->isec_op = OP_PLUS; p++; }
                     else if ( *p=='=' ) { args->isec_op = OP_EQUAL; p++; }
                     else if ( *p=='~' ) { args->isec_op = OP_EXACT; p++; }
                     else if ( isdigit(*p) ) args->isec_op = OP_EQUAL;
-                    else error("Could not parse --nfiles %s\n", optarg);
+                    else error("Could not parse --nfiles %s\n", bcftools_optarg);
                     if ( args->isec_op == OP_EXACT ) args->isec_exact = p;
-                    else if ( sscanf(p,"%d",&args->isec_n)!=1 ) error("Could not parse --nfiles %s\n", optarg);
+                    else if ( sscanf(p,"%d",&args->isec_n)!=1 ) error("Could not parse --nfiles %s\n", bcftools_optarg);
                 }
                 break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case  8 : args->record_cmd_line = 0; break;
             case 'h':
             case '?': usage(); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
-    if ( argc-optind<1 ) usage();   // no file given
+    if ( argc-bcftools_optind<1 ) usage();   // no file given
     if ( args->targets_list && bcf_sr_set_targets(args->files, args->targets_list, targets_is_file,0)<0 )
         error("Failed to read the targets: %s\n", args->targets_list);
     if ( args->regions_list && bcf_sr_set_regions(args->files, args->regions_list, regions_is_file)<0 )
         error("Failed to read the regions: %s\n", args->regions_list);
-    if ( argc-optind==2 && !args->isec_op )
+    if ( argc-bcftools_optind==2 && !args->isec_op )
     {
         args->isec_op = OP_VENN;
         if ( !args->prefix ) error("Expected the -p option\n");
     }
     if ( !args->targets_list )
     {
-        if ( argc-optind<2  ) error("Expected multiple files or the --targets option\n");
+        if ( argc-bcftools_optind<2  ) error("Expected multiple files or the --targets option\n");
         if ( !args->isec_op ) error("One of the options --complement, --nfiles or --targets must be given with more than two files\n");
     }
     args->files->require_index = 1;
-    while (optind<argc)
+    while (bcftools_optind<argc)
     {
-        if ( !bcf_sr_add_reader(args->files, argv[optind]) ) error("Failed to open %s: %s\n", argv[optind],bcf_sr_strerror(args->files->errnum));
-        optind++;
+        if ( !bcf_sr_add_reader(args->files, argv[bcftools_optind]) ) error("Failed to open %s: %s\n", argv[bcftools_optind],bcf_sr_strerror(args->files->errnum));
+        bcftools_optind++;
     }
     init_data(args);
     isec_vcf(args);
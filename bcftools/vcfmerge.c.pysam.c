@@ -3144,67 +3144,67 @@ int main_vcfmerge(int argc, char *argv[])
         {NULL,0,NULL,0}
     };
     char *tmp;
-    while ((c = getopt_long(argc, argv, "hm:f:r:R:o:O:i:l:g:F:0L:",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "hm:f:r:R:o:O:i:l:g:F:0L:",loptions,NULL)) >= 0) {
         switch (c) {
             case 'L':
-                args->local_alleles = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --local-alleles %s\n", optarg);
+                args->local_alleles = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --local-alleles %s\n", bcftools_optarg);
                 if ( args->local_alleles < 1 )
-                    error("Error: \"--local-alleles %s\" makes no sense, expected value bigger or equal than 1\n", optarg);
+                    error("Error: \"--local-alleles %s\" makes no sense, expected value bigger or equal than 1\n", bcftools_optarg);
                 break;
             case 'F': 
-                if ( !strcmp(optarg,"+") ) args->filter_logic = FLT_LOGIC_ADD;
-                else if ( !strcmp(optarg,"x") ) args->filter_logic = FLT_LOGIC_REMOVE;
-                else error("Filter logic not recognised: %s\n", optarg);
+                if ( !strcmp(bcftools_optarg,"+") ) args->filter_logic = FLT_LOGIC_ADD;
+                else if ( !strcmp(bcftools_optarg,"x") ) args->filter_logic = FLT_LOGIC_REMOVE;
+                else error("Filter logic not recognised: %s\n", bcftools_optarg);
                 break;
             case '0': args->missing_to_ref = 1; break;
             case 'g':
                 args->do_gvcf = 1;
-                if ( strcmp("-",optarg) )
+                if ( strcmp("-",bcftools_optarg) )
                 {
-                    args->gvcf_fai = fai_load(optarg);
-                    if ( !args->gvcf_fai ) error("Failed to load the fai index: %s\n", optarg);
+                    args->gvcf_fai = fai_load(bcftools_optarg);
+                    if ( !args->gvcf_fai ) error("Failed to load the fai index: %s\n", bcftools_optarg);
                 }
                 break;
-            case 'l': args->file_list = optarg; break;
-            case 'i': args->info_rules = optarg; break;
-            case 'o': args->output_fname = optarg; break;
+            case 'l': args->file_list = bcftools_optarg; break;
+            case 'i': args->info_rules = bcftools_optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'O':
-                switch (optarg[0]) {
+                switch (bcftools_optarg[0]) {
                     case 'b': args->output_type = FT_BCF_GZ; break;
                     case 'u': args->output_type = FT_BCF; break;
                     case 'z': args->output_type = FT_VCF_GZ; break;
                     case 'v': args->output_type = FT_VCF; break;
-                    default: error("The output type \"%s\" not recognised\n", optarg);
+                    default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                 }
                 break;
             case 'm':
                 args->collapse = COLLAPSE_NONE;
-                if ( !strcmp(optarg,"snps") ) args->collapse |= COLLAPSE_SNPS;
-                else if ( !strcmp(optarg,"indels") ) args->collapse |= COLLAPSE_INDELS;
-                else if ( !strcmp(optarg,"both") ) args->collapse |= COLLAPSE_BOTH;
-                else if ( !strcmp(optarg,"any") ) args->collapse |= COLLAPSE_ANY;
-                else if ( !strcmp(optarg,"all") ) args->collapse |= COLLAPSE_ANY;
-                else if ( !strcmp(optarg,"none") ) args->collapse = COLLAPSE_NONE;
-                else if ( !strcmp(optarg,"id") ) { args->collapse = COLLAPSE_NONE; args->merge_by_id = 1; }
-                else error("The -m type \"%s\" is not recognised.\n", optarg);
+                if ( !strcmp(bcftools_optarg,"snps") ) args->collapse |= COLLAPSE_SNPS;
+                else if ( !strcmp(bcftools_optarg,"indels") ) args->collapse |= COLLAPSE_INDELS;
+                else if ( !strcmp(bcftools_optarg,"both") ) args->collapse |= COLLAPSE_BOTH;
+                else if ( !strcmp(bcftools_optarg,"any") ) args->collapse |= COLLAPSE_ANY;
+                else if ( !strcmp(bcftools_optarg,"all") ) args->collapse |= COLLAPSE_ANY;
+                else if ( !strcmp(bcftools_optarg,"none") ) args->collapse = COLLAPSE_NONE;
+                else if ( !strcmp(bcftools_optarg,"id") ) { args->collapse = COLLAPSE_NONE; args->merge_by_id = 1; }
+                else error("The -m type \"%s\" is not recognised.\n", bcftools_optarg);
                 break;
-            case 'f': args->files->apply_filters = optarg; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
-            case  1 : args->header_fname = optarg; break;
+            case 'f': args->files->apply_filters = bcftools_optarg; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
+            case  1 : args->header_fname = bcftools_optarg; break;
             case  2 : args->header_only = 1; break;
             case  3 : args->force_samples = 1; break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case  8 : args->record_cmd_line = 0; break;
             case 10 : args->no_index = 1; break;
             case 'h':
             case '?': usage(); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
-    if ( argc==optind && !args->file_list ) usage();
-    if ( argc-optind<2 && !args->file_list ) usage();
+    if ( argc==bcftools_optind && !args->file_list ) usage();
+    if ( argc-bcftools_optind<2 && !args->file_list ) usage();
 
     if ( args->no_index )
     {
@@ -3230,10 +3230,10 @@ int main_vcfmerge(int argc, char *argv[])
     }
 
     if ( bcf_sr_set_threads(args->files, args->n_threads)<0 ) error("Failed to create threads\n");
-    while (optind<argc)
+    while (bcftools_optind<argc)
     {
-        if ( !bcf_sr_add_reader(args->files, argv[optind]) ) error("Failed to open %s: %s\n", argv[optind],bcf_sr_strerror(args->files->errnum));
-        optind++;
+        if ( !bcf_sr_add_reader(args->files, argv[bcftools_optind]) ) error("Failed to open %s: %s\n", argv[bcftools_optind],bcf_sr_strerror(args->files->errnum));
+        bcftools_optind++;
     }
     if ( args->file_list )
     {
@@ -2151,91 +2151,91 @@ int main_vcfnorm(int argc, char *argv[])
         {NULL,0,NULL,0}
     };
     char *tmp;
-    while ((c = getopt_long(argc, argv, "hr:R:f:w:Dd:o:O:c:m:t:T:sNa",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "hr:R:f:w:Dd:o:O:c:m:t:T:sNa",loptions,NULL)) >= 0) {
         switch (c) {
             case  10:
                 // possibly generalize this also to INFO/AD and other tags
-                if ( strcasecmp("ad",optarg) )
+                if ( strcasecmp("ad",bcftools_optarg) )
                     error("Error: only --keep-sum AD is currently supported. See https://github.com/samtools/bcftools/issues/360 for more.\n");
                 args->keep_sum_ad = 1;  // this will be set to the header id or -1 in init_data
                 break;
             case 'a': args->atomize = SPLIT; break;
             case 11 :
-                if ( optarg[0]=='*' ) args->use_star_allele = 1;
-                else if ( optarg[0]=='.' ) args->use_star_allele = 0;
+                if ( bcftools_optarg[0]=='*' ) args->use_star_allele = 1;
+                else if ( bcftools_optarg[0]=='.' ) args->use_star_allele = 0;
                 else error("Invalid argument to --atom-overlaps. Perhaps you wanted: \"--atom-overlaps '*'\"?\n");
                 break;
-            case 12 : args->old_rec_tag = optarg; break;
+            case 12 : args->old_rec_tag = bcftools_optarg; break;
             case 'N': args->do_indels = 0; break;
             case 'd':
-                if ( !strcmp("snps",optarg) ) args->rmdup = BCF_SR_PAIR_SNPS;
-                else if ( !strcmp("indels",optarg) ) args->rmdup = BCF_SR_PAIR_INDELS;
-                else if ( !strcmp("both",optarg) ) args->rmdup = BCF_SR_PAIR_BOTH;
-                else if ( !strcmp("all",optarg) ) args->rmdup = BCF_SR_PAIR_ANY;
-                else if ( !strcmp("any",optarg) ) args->rmdup = BCF_SR_PAIR_ANY;
-                else if ( !strcmp("none",optarg) ) args->rmdup = BCF_SR_PAIR_EXACT;
-                else if ( !strcmp("exact",optarg) ) args->rmdup = BCF_SR_PAIR_EXACT;
-                else error("The argument to -d not recognised: %s\n", optarg);
+                if ( !strcmp("snps",bcftools_optarg) ) args->rmdup = BCF_SR_PAIR_SNPS;
+                else if ( !strcmp("indels",bcftools_optarg) ) args->rmdup = BCF_SR_PAIR_INDELS;
+                else if ( !strcmp("both",bcftools_optarg) ) args->rmdup = BCF_SR_PAIR_BOTH;
+                else if ( !strcmp("all",bcftools_optarg) ) args->rmdup = BCF_SR_PAIR_ANY;
+                else if ( !strcmp("any",bcftools_optarg) ) args->rmdup = BCF_SR_PAIR_ANY;
+                else if ( !strcmp("none",bcftools_optarg) ) args->rmdup = BCF_SR_PAIR_EXACT;
+                else if ( !strcmp("exact",bcftools_optarg) ) args->rmdup = BCF_SR_PAIR_EXACT;
+                else error("The argument to -d not recognised: %s\n", bcftools_optarg);
                 break;
             case 'm':
-                if ( optarg[0]=='-' ) args->mrows_op = MROWS_SPLIT;
-                else if ( optarg[0]=='+' ) args->mrows_op = MROWS_MERGE;
+                if ( bcftools_optarg[0]=='-' ) args->mrows_op = MROWS_SPLIT;
+                else if ( bcftools_optarg[0]=='+' ) args->mrows_op = MROWS_MERGE;
                 else error("Expected '+' or '-' with -m\n");
-                if ( optarg[1]!=0 )
+                if ( bcftools_optarg[1]!=0 )
                 {
-                    if ( !strcmp("snps",optarg+1) ) args->mrows_collapse = COLLAPSE_SNPS;
-                    else if ( !strcmp("indels",optarg+1) ) args->mrows_collapse = COLLAPSE_INDELS;
-                    else if ( !strcmp("both",optarg+1) ) args->mrows_collapse = COLLAPSE_BOTH;
-                    else if ( !strcmp("any",optarg+1) ) args->mrows_collapse = COLLAPSE_ANY;
-                    else error("The argument to -m not recognised: %s\n", optarg);
+                    if ( !strcmp("snps",bcftools_optarg+1) ) args->mrows_collapse = COLLAPSE_SNPS;
+                    else if ( !strcmp("indels",bcftools_optarg+1) ) args->mrows_collapse = COLLAPSE_INDELS;
+                    else if ( !strcmp("both",bcftools_optarg+1) ) args->mrows_collapse = COLLAPSE_BOTH;
+                    else if ( !strcmp("any",bcftools_optarg+1) ) args->mrows_collapse = COLLAPSE_ANY;
+                    else error("The argument to -m not recognised: %s\n", bcftools_optarg);
                 }
                 break;
             case 'c':
-                if ( strchr(optarg,'w') ) args->check_ref |= CHECK_REF_WARN;
-                if ( strchr(optarg,'x') ) args->check_ref |= CHECK_REF_SKIP;
-                if ( strchr(optarg,'s') ) args->check_ref |= CHECK_REF_FIX;
-                if ( strchr(optarg,'e') ) args->check_ref = CHECK_REF_EXIT; // overrides the above
+                if ( strchr(bcftools_optarg,'w') ) args->check_ref |= CHECK_REF_WARN;
+                if ( strchr(bcftools_optarg,'x') ) args->check_ref |= CHECK_REF_SKIP;
+                if ( strchr(bcftools_optarg,'s') ) args->check_ref |= CHECK_REF_FIX;
+                if ( strchr(bcftools_optarg,'e') ) args->check_ref = CHECK_REF_EXIT; // overrides the above
                 break;
             case 'O':
-                switch (optarg[0]) {
+                switch (bcftools_optarg[0]) {
                     case 'b': args->output_type = FT_BCF_GZ; break;
                     case 'u': args->output_type = FT_BCF; break;
                     case 'z': args->output_type = FT_VCF_GZ; break;
                     case 'v': args->output_type = FT_VCF; break;
-                    default: error("The output type \"%s\" not recognised\n", optarg);
+                    default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                 }
                 break;
-            case 'o': args->output_fname = optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'D':
                 fprintf(bcftools_stderr,"Warning: `-D` is functional but deprecated, replaced by and alias of `-d none`.\n"); 
                 args->rmdup = BCF_SR_PAIR_EXACT;
                 break;
             case 's': args->strict_filter = 1; break;
-            case 'f': args->ref_fname = optarg; break;
-            case 'r': args->region = optarg; break;
-            case 'R': args->region = optarg; region_is_file = 1; break;
-            case 't': args->targets = optarg; break;
-            case 'T': args->targets = optarg; targets_is_file = 1; break;
+            case 'f': args->ref_fname = bcftools_optarg; break;
+            case 'r': args->region = bcftools_optarg; break;
+            case 'R': args->region = bcftools_optarg; region_is_file = 1; break;
+            case 't': args->targets = bcftools_optarg; break;
+            case 'T': args->targets = bcftools_optarg; targets_is_file = 1; break;
             case 'w':
-                args->buf_win = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --site-win %s\n", optarg);
+                args->buf_win = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --site-win %s\n", bcftools_optarg);
                 break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case  8 : args->record_cmd_line = 0; break;
             case  7 : args->force = 1; break;
             case 'h':
             case '?': usage(); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
     char *fname = NULL;
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";  // reading from stdin
         else usage();
     }
-    else fname = argv[optind];
+    else fname = argv[bcftools_optind];
 
     if ( !args->ref_fname && !args->mrows_op && !args->rmdup && args->atomize==NONE ) error("Expected -a, -f, -m, -D or -d option\n");
     if ( !args->check_ref && args->ref_fname ) args->check_ref = CHECK_REF_EXIT;
@@ -582,14 +582,14 @@ static void usage(args_t *args)
 
 static int is_verbose(int argc, char *argv[])
 {
-    int c, verbose = 0, opterr_ori = opterr;
+    int c, verbose = 0, opterr_ori = bcftools_opterr;
     static struct option loptions[] =
     {
         {"verbose",no_argument,NULL,'v'},
         {NULL,0,NULL,0}
     };
-    opterr = 0;
-    while ((c = getopt_long(argc, argv, "-v",loptions,NULL)) >= 0)
+    bcftools_opterr = 0;
+    while ((c = bcftools_getopt_long(argc, argv, "-v",loptions,NULL)) >= 0)
     {
         switch (c) {
             case 'v': verbose++; break;
@@ -597,8 +597,8 @@ static int is_verbose(int argc, char *argv[])
             default: break;
         }
     }
-    opterr = opterr_ori;
-    optind = 0;
+    bcftools_opterr = opterr_ori;
+    bcftools_optind = 0;
     return verbose;
 }
 int main_plugin(int argc, char *argv[])
@@ -650,37 +650,37 @@ int main_plugin(int argc, char *argv[])
         {"no-version",no_argument,NULL,8},
         {NULL,0,NULL,0}
     };
-    while ((c = getopt_long(argc, argv, "h?o:O:r:R:t:T:li:e:vV",loptions,NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "h?o:O:r:R:t:T:li:e:vV",loptions,NULL)) >= 0)
     {
         switch (c) {
             case 'V': version_only = 1; break;
             case 'v': args->verbose++; break;
-            case 'o': args->output_fname = optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'O':
-                switch (optarg[0]) {
+                switch (bcftools_optarg[0]) {
                     case 'b': args->output_type = FT_BCF_GZ; break;
                     case 'u': args->output_type = FT_BCF; break;
                     case 'z': args->output_type = FT_VCF_GZ; break;
                     case 'v': args->output_type = FT_VCF; break;
-                    default: error("The output type \"%s\" not recognised\n", optarg);
+                    default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                 };
                 break;
             case 'e':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 'i':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
-            case 't': args->targets_list = optarg; break;
-            case 'T': args->targets_list = optarg; targets_is_file = 1; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
+            case 't': args->targets_list = bcftools_optarg; break;
+            case 'T': args->targets_list = bcftools_optarg; targets_is_file = 1; break;
             case 'l': args->plist_only = 1; break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case  8 : args->record_cmd_line = 0; break;
             case '?':
             case 'h': usage_only = 1; break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
     if ( args->plist_only )  return list_plugins(args);
@@ -705,26 +705,26 @@ int main_plugin(int argc, char *argv[])
     }
 
     char *fname = NULL;
-    if ( optind>=argc || (argv[optind][0]=='-' && argv[optind][1]) )
+    if ( bcftools_optind>=argc || (argv[bcftools_optind][0]=='-' && argv[bcftools_optind][1]) )
     {
-        args->plugin.argc = argc - optind + 1;
-        args->plugin.argv = argv + optind - 1;
+        args->plugin.argc = argc - bcftools_optind + 1;
+        args->plugin.argv = argv + bcftools_optind - 1;
 
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";  // reading from stdin
-        else if ( optind>=argc ) usage(args);
+        else if ( bcftools_optind>=argc ) usage(args);
         else
         {
-            optind = 1;
+            bcftools_optind = 1;
             init_plugin(args);
         }
     }
     else
     {
-        fname = argv[optind];
-        args->plugin.argc = argc - optind;
-        args->plugin.argv = argv + optind;
+        fname = argv[bcftools_optind];
+        args->plugin.argc = argc - bcftools_optind;
+        args->plugin.argv = argv + bcftools_optind;
     }
-    optind = 0;
+    bcftools_optind = 0;
 
     args->files = bcf_sr_init();
     if ( args->regions_list )
@@ -273,12 +273,12 @@ int main_vcfquery(int argc, char *argv[])
         {"allow-undef-tags",0,0,'u'},
         {0,0,0,0}
     };
-    while ((c = getopt_long(argc, argv, "hlr:R:f:a:s:S:Ht:T:c:v:i:e:o:u",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "hlr:R:f:a:s:S:Ht:T:c:v:i:e:o:u",loptions,NULL)) >= 0) {
         switch (c) {
-            case 'o': args->fn_out = optarg; break;
-            case 'f': args->format_str = strdup(optarg); break;
+            case 'o': args->fn_out = bcftools_optarg; break;
+            case 'f': args->format_str = strdup(bcftools_optarg); break;
             case 'H': args->print_header = 1; break;
-            case 'v': args->vcf_list = optarg; break;
+            case 'v': args->vcf_list = bcftools_optarg; break;
             case 'c': 
                 error("The --collapse option is obsolete, pipe through `bcftools norm -c` instead.\n");
                 break;
@@ -286,7 +286,7 @@ int main_vcfquery(int argc, char *argv[])
                 {
                     kstring_t str = {0,0,0};
                     kputs("%CHROM\t%POS\t%MASK\t%REF\t%ALT\t%", &str);
-                    char *p = optarg;
+                    char *p = bcftools_optarg;
                     while ( *p )
                     {
                         if ( *p==',' )
@@ -301,30 +301,30 @@ int main_vcfquery(int argc, char *argv[])
                 }
             case 'e':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 'i':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
-            case 't': args->targets_list = optarg; break;
-            case 'T': args->targets_list = optarg; targets_is_file = 1; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
+            case 't': args->targets_list = bcftools_optarg; break;
+            case 'T': args->targets_list = bcftools_optarg; targets_is_file = 1; break;
             case 'l': args->list_columns = 1; break;
             case 'u': args->allow_undef_tags = 1; break;
-            case 's': args->sample_list = optarg; break;
-            case 'S': args->sample_list = optarg; args->sample_is_file = 1; break;
+            case 's': args->sample_list = bcftools_optarg; break;
+            case 'S': args->sample_list = bcftools_optarg; args->sample_is_file = 1; break;
             case 'h':
             case '?': usage(); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
     char *fname = NULL;
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";
     }
-    else fname = argv[optind];
+    else fname = argv[bcftools_optind];
 
     if ( args->list_columns )
     {
@@ -349,7 +349,7 @@ int main_vcfquery(int argc, char *argv[])
     {
         if ( !fname ) usage();
         args->files = bcf_sr_init();
-        if ( optind+1 < argc ) args->files->require_index = 1;
+        if ( bcftools_optind+1 < argc ) args->files->require_index = 1;
         if ( args->regions_list && bcf_sr_set_regions(args->files, args->regions_list, regions_is_file)<0 )
             error("Failed to read the regions: %s\n", args->regions_list);
         if ( args->targets_list )
@@ -360,7 +360,7 @@ int main_vcfquery(int argc, char *argv[])
         while ( fname )
         {
             if ( !bcf_sr_add_reader(args->files, fname) ) error("Failed to read from %s: %s\n", !strcmp("-",fname)?"standard input":fname,bcf_sr_strerror(args->files->errnum));
-            fname = ++optind < argc ? argv[optind] : NULL;
+            fname = ++bcftools_optind < argc ? argv[bcftools_optind] : NULL;
         }
         init_data(args);
         query_vcf(args);
@@ -383,14 +383,14 @@ int main_vcfquery(int argc, char *argv[])
         args->files->collapse = collapse;
         if ( args->regions_list && bcf_sr_set_regions(args->files, args->regions_list, regions_is_file)<0 )
             error("Failed to read the regions: %s\n", args->regions_list);
-        if ( optind < argc ) args->files->require_index = 1;
+        if ( bcftools_optind < argc ) args->files->require_index = 1;
         if ( args->targets_list )
         {
             if ( bcf_sr_set_targets(args->files, args->targets_list,targets_is_file, 0)<0 )
                 error("Failed to read the targets: %s\n", args->targets_list);
         }
         if ( !bcf_sr_add_reader(args->files, fnames[i]) ) error("Failed to open %s: %s\n", fnames[i],bcf_sr_strerror(args->files->errnum));
-        for (k=optind; k<argc; k++)
+        for (k=bcftools_optind; k<argc; k++)
             if ( !bcf_sr_add_reader(args->files, argv[k]) ) error("Failed to open %s: %s\n", argv[k],bcf_sr_strerror(args->files->errnum));
         init_data(args);
         if ( i==0 )
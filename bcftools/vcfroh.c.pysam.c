@@ -1153,76 +1153,76 @@ int main_vcfroh(int argc, char *argv[])
 
     int naf_opts = 0;
     char *tmp;
-    while ((c = getopt_long(argc, argv, "h?r:R:t:T:H:a:s:S:m:M:G:Ia:e:V:b:O:o:i",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "h?r:R:t:T:H:a:s:S:m:M:G:Ia:e:V:b:O:o:i",loptions,NULL)) >= 0) {
         switch (c) {
-            case 0: args->af_tag = optarg; naf_opts++; break;
-            case 1: args->af_fname = optarg; naf_opts++; break;
+            case 0: args->af_tag = bcftools_optarg; naf_opts++; break;
+            case 1: args->af_fname = bcftools_optarg; naf_opts++; break;
             case 2: 
-                args->dflt_AF = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: --AF-dflt %s\n", optarg);
+                args->dflt_AF = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: --AF-dflt %s\n", bcftools_optarg);
                 break;
             case  3 :
                 if ( args->filter_str ) error("Error: only one --include or --exclude expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
             case  4 :
                 if ( args->filter_str ) error("Error: only one --include or --exclude expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 5: args->include_noalt_sites = 1; break;
-            case 'o': args->output_fname = optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'O': 
-                if ( strchr(optarg,'s') || strchr(optarg,'S') ) args->output_type |= OUTPUT_ST;
-                if ( strchr(optarg,'r') || strchr(optarg,'R') ) args->output_type |= OUTPUT_RG;
-                if ( strchr(optarg,'z') || strchr(optarg,'z') ) args->output_type |= OUTPUT_GZ;
+                if ( strchr(bcftools_optarg,'s') || strchr(bcftools_optarg,'S') ) args->output_type |= OUTPUT_ST;
+                if ( strchr(bcftools_optarg,'r') || strchr(bcftools_optarg,'R') ) args->output_type |= OUTPUT_RG;
+                if ( strchr(bcftools_optarg,'z') || strchr(bcftools_optarg,'z') ) args->output_type |= OUTPUT_GZ;
                 break;
-            case 'e': args->estimate_AF = optarg; naf_opts++; break;
-            case 'b': args->buffer_size = optarg; break;
+            case 'e': args->estimate_AF = bcftools_optarg; naf_opts++; break;
+            case 'b': args->buffer_size = bcftools_optarg; break;
             case 'i': args->skip_homref = 1; break;
             case 'I': args->snps_only = 1; break;
             case 'G':
                 args->fake_PLs = 1; 
-                args->unseen_PL = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -G %s\n", optarg);
+                args->unseen_PL = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -G %s\n", bcftools_optarg);
                 args->unseen_PL = pow(10,-args->unseen_PL/10.); 
                 break;
-            case 'm': args->genmap_fname = optarg; break;
+            case 'm': args->genmap_fname = bcftools_optarg; break;
             case 'M':
-                args->rec_rate = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -M %s\n", optarg);
+                args->rec_rate = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -M %s\n", bcftools_optarg);
                 break;
-            case 's': args->samples = strdup(optarg); break;
-            case 'S': args->samples = strdup(optarg); args->samples_is_file = 1; break;
+            case 's': args->samples = strdup(bcftools_optarg); break;
+            case 'S': args->samples = strdup(bcftools_optarg); args->samples_is_file = 1; break;
             case 'a':
-                args->t2AZ = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -a %s\n", optarg);
+                args->t2AZ = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -a %s\n", bcftools_optarg);
                 break;
             case 'H':
-                args->t2HW = strtod(optarg,&tmp);
-                if ( *tmp ) error("Could not parse: -H %s\n", optarg);
+                args->t2HW = strtod(bcftools_optarg,&tmp);
+                if ( *tmp ) error("Could not parse: -H %s\n", bcftools_optarg);
                 break;
-            case 't': args->targets_list = optarg; break;
-            case 'T': args->targets_list = optarg; targets_is_file = 1; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case 't': args->targets_list = bcftools_optarg; break;
+            case 'T': args->targets_list = bcftools_optarg; targets_is_file = 1; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case 'V': 
                 args->vi_training = 1; 
-                args->baum_welch_th = strtod(optarg,&tmp); 
-                if ( *tmp ) error("Could not parse: --viterbi-training %s\n", optarg);
+                args->baum_welch_th = strtod(bcftools_optarg,&tmp); 
+                if ( *tmp ) error("Could not parse: --viterbi-training %s\n", bcftools_optarg);
                 break;
             case 'h': 
             case '?': usage(args); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
     if ( !args->output_fname ) args->output_fname = "bcftools_stdout";
     if ( !args->output_type || args->output_type==OUTPUT_GZ ) args->output_type |= OUTPUT_ST|OUTPUT_RG;
     char *fname = NULL;
-    if ( optind==argc )
+    if ( bcftools_optind==argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";  // reading from stdin
         else usage(args);
     }
-    else fname = argv[optind];
+    else fname = argv[bcftools_optind];
 
     if ( args->vi_training && args->buffer_size ) error("Error: cannot use -b with -V\n");
     if ( args->t2AZ<0 || args->t2AZ>1 ) error("Error: The parameter --hw-to-az is not in [0,1] .. %e\n", args->t2AZ);
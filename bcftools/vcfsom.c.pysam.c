@@ -676,24 +676,24 @@ int main_vcfsom(int argc, char *argv[])
         {"classify",0,0,'c'},
         {0,0,0,0}
     };
-    while ((c = getopt_long(argc, argv, "htcp:n:r:b:l:s:f:d:m:e",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "htcp:n:r:b:l:s:f:d:m:e",loptions,NULL)) >= 0) {
         switch (c) {
             case 'e': args->train_bad = 0; break;
             case 'm':
-                if ( !strcmp(optarg,"min") ) args->merge = MERGE_MIN;
-                else if ( !strcmp(optarg,"max") ) args->merge = MERGE_MAX;
-                else if ( !strcmp(optarg,"avg") ) args->merge = MERGE_AVG;
-                else error("The -m method not recognised: %s\n", optarg);
+                if ( !strcmp(bcftools_optarg,"min") ) args->merge = MERGE_MIN;
+                else if ( !strcmp(bcftools_optarg,"max") ) args->merge = MERGE_MAX;
+                else if ( !strcmp(bcftools_optarg,"avg") ) args->merge = MERGE_AVG;
+                else error("The -m method not recognised: %s\n", bcftools_optarg);
                 break;
-            case 'p': args->prefix = optarg; break;
-            case 'n': args->ntrain = atoi(optarg); break;
-            case 'r': args->rand_seed = atoi(optarg); break;
-            case 'b': args->bmu_th = atof(optarg); break;
-            case 'l': args->learn = atof(optarg); break;
-            case 's': args->nbin = atoi(optarg); break;
-            case 'f': args->nfold = atoi(optarg); break;
+            case 'p': args->prefix = bcftools_optarg; break;
+            case 'n': args->ntrain = atoi(bcftools_optarg); break;
+            case 'r': args->rand_seed = atoi(bcftools_optarg); break;
+            case 'b': args->bmu_th = atof(bcftools_optarg); break;
+            case 'l': args->learn = atof(bcftools_optarg); break;
+            case 's': args->nbin = atoi(bcftools_optarg); break;
+            case 'f': args->nfold = atoi(bcftools_optarg); break;
             case 'd':
-                args->ndim = atoi(optarg);
+                args->ndim = atoi(bcftools_optarg);
                 if ( args->ndim<2 ) error("Expected -d >=2, got %d\n", args->ndim);
                 if ( args->ndim>3 ) fprintf(bcftools_stderr,"Warning: This will take a long time and is not going to make the results better: -d %d\n", args->ndim);
                 break;
@@ -701,13 +701,13 @@ int main_vcfsom(int argc, char *argv[])
             case 'c': args->action = SOM_CLASSIFY; break;
             case 'h':
             case '?': usage(); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
     if ( !args->rand_seed ) args->rand_seed = time(NULL);
-    if ( argc!=optind+1 ) usage();
-    args->fname = argv[optind];
+    if ( argc!=bcftools_optind+1 ) usage();
+    args->fname = argv[bcftools_optind];
     init_data(args);
 
     if ( args->action == SOM_TRAIN ) do_train(args);
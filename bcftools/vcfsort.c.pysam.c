@@ -319,34 +319,34 @@ int main_sort(int argc, char *argv[])
         {"help",no_argument,NULL,'h'},
         {0,0,0,0}
     };
-    while ((c = getopt_long(argc, argv, "m:T:O:o:h?",loptions,NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "m:T:O:o:h?",loptions,NULL)) >= 0)
     {
         switch (c)
         {
-            case 'm': args->max_mem = parse_mem_string(optarg); break;
-            case 'T': args->tmp_dir = optarg; break;
-            case 'o': args->output_fname = optarg; break;
+            case 'm': args->max_mem = parse_mem_string(bcftools_optarg); break;
+            case 'T': args->tmp_dir = bcftools_optarg; break;
+            case 'o': args->output_fname = bcftools_optarg; break;
             case 'O':
-                      switch (optarg[0]) {
+                      switch (bcftools_optarg[0]) {
                           case 'b': args->output_type = FT_BCF_GZ; break;
                           case 'u': args->output_type = FT_BCF; break;
                           case 'z': args->output_type = FT_VCF_GZ; break;
                           case 'v': args->output_type = FT_VCF; break;
-                          default: error("The output type \"%s\" not recognised\n", optarg);
+                          default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                       };
                       break;
             case 'h':
             case '?': usage(args); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) args->fname = "-";  // reading from stdin
         else usage(args);
     }
-    else args->fname = argv[optind];
+    else args->fname = argv[bcftools_optind];
 
     init(args);
     sort_blocks(args);
@@ -1807,61 +1807,61 @@ int main_vcfstats(int argc, char *argv[])
         {"threads",1,0,9},
         {0,0,0,0}
     };
-    while ((c = getopt_long(argc, argv, "hc:r:R:e:s:S:d:i:t:T:F:f:1u:vIE:",loptions,NULL)) >= 0) {
+    while ((c = bcftools_getopt_long(argc, argv, "hc:r:R:e:s:S:d:i:t:T:F:f:1u:vIE:",loptions,NULL)) >= 0) {
         switch (c) {
-            case  1 : args->af_bins_list = optarg; break;
-            case  2 : args->af_tag = optarg; break;
-            case 'u': add_user_stats(args,optarg); break;
+            case  1 : args->af_bins_list = bcftools_optarg; break;
+            case  2 : args->af_tag = bcftools_optarg; break;
+            case 'u': add_user_stats(args,bcftools_optarg); break;
             case '1': args->first_allele_only = 1; break;
-            case 'F': args->ref_fname = optarg; break;
-            case 't': args->targets_list = optarg; break;
-            case 'T': args->targets_list = optarg; targets_is_file = 1; break;
+            case 'F': args->ref_fname = bcftools_optarg; break;
+            case 't': args->targets_list = bcftools_optarg; break;
+            case 'T': args->targets_list = bcftools_optarg; targets_is_file = 1; break;
             case 'c':
-                if ( !strcmp(optarg,"snps") ) args->files->collapse |= COLLAPSE_SNPS;
-                else if ( !strcmp(optarg,"indels") ) args->files->collapse |= COLLAPSE_INDELS;
-                else if ( !strcmp(optarg,"both") ) args->files->collapse |= COLLAPSE_SNPS | COLLAPSE_INDELS;
-                else if ( !strcmp(optarg,"any") ) args->files->collapse |= COLLAPSE_ANY;
-                else if ( !strcmp(optarg,"all") ) args->files->collapse |= COLLAPSE_ANY;
-                else if ( !strcmp(optarg,"some") ) args->files->collapse |= COLLAPSE_SOME;
-                else if ( !strcmp(optarg,"none") ) args->files->collapse = COLLAPSE_NONE;
-                else error("The --collapse string \"%s\" not recognised.\n", optarg);
+                if ( !strcmp(bcftools_optarg,"snps") ) args->files->collapse |= COLLAPSE_SNPS;
+                else if ( !strcmp(bcftools_optarg,"indels") ) args->files->collapse |= COLLAPSE_INDELS;
+                else if ( !strcmp(bcftools_optarg,"both") ) args->files->collapse |= COLLAPSE_SNPS | COLLAPSE_INDELS;
+                else if ( !strcmp(bcftools_optarg,"any") ) args->files->collapse |= COLLAPSE_ANY;
+                else if ( !strcmp(bcftools_optarg,"all") ) args->files->collapse |= COLLAPSE_ANY;
+                else if ( !strcmp(bcftools_optarg,"some") ) args->files->collapse |= COLLAPSE_SOME;
+                else if ( !strcmp(bcftools_optarg,"none") ) args->files->collapse = COLLAPSE_NONE;
+                else error("The --collapse string \"%s\" not recognised.\n", bcftools_optarg);
                 break;
             case 'v': args->verbose_sites = 1; break;
             case 'd':
-                if ( sscanf(optarg,"%d,%d,%d",&args->dp_min,&args->dp_max,&args->dp_step)!=3 )
-                    error("Could not parse --depth %s\n", optarg);
+                if ( sscanf(bcftools_optarg,"%d,%d,%d",&args->dp_min,&args->dp_max,&args->dp_step)!=3 )
+                    error("Could not parse --depth %s\n", bcftools_optarg);
                 if ( args->dp_min<0 || args->dp_min >= args->dp_max || args->dp_step > args->dp_max - args->dp_min + 1 )
-                    error("Is this a typo? --depth %s\n", optarg);
+                    error("Is this a typo? --depth %s\n", bcftools_optarg);
                 break;
-            case 'f': args->files->apply_filters = optarg; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
-            case 'E': args->exons_fname = optarg; break;
-            case 's': args->samples_list = optarg; break;
-            case 'S': args->samples_list = optarg; args->samples_is_file = 1; break;
+            case 'f': args->files->apply_filters = bcftools_optarg; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
+            case 'E': args->exons_fname = bcftools_optarg; break;
+            case 's': args->samples_list = bcftools_optarg; break;
+            case 'S': args->samples_list = bcftools_optarg; args->samples_is_file = 1; break;
             case 'I': args->split_by_id = 1; break;
             case 'e':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 'i':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case 'h':
             case '?': usage(); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
     char *fname = NULL;
-    if ( optind==argc )
+    if ( bcftools_optind==argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";  // reading from stdin
         else usage();
     }
-    else fname = argv[optind];
+    else fname = argv[bcftools_optind];
 
-    if ( argc-optind>2 ) usage();
-    if ( argc-optind>1 )
+    if ( argc-bcftools_optind>2 ) usage();
+    if ( argc-bcftools_optind>1 )
     {
         args->files->require_index = 1;
         if ( args->split_by_id ) error("Only one file can be given with -i.\n");
@@ -1878,7 +1878,7 @@ int main_vcfstats(int argc, char *argv[])
     {
         if ( !bcf_sr_add_reader(args->files, fname) )
             error("Failed to read from %s: %s\n", !strcmp("-",fname)?"standard input":fname,bcf_sr_strerror(args->files->errnum));
-        fname = ++optind < argc ? argv[optind] : NULL;
+        fname = ++bcftools_optind < argc ? argv[bcftools_optind] : NULL;
     }
 
     init_stats(args);
@@ -592,65 +592,65 @@ int main_vcfview(int argc, char *argv[])
         {NULL,0,NULL,0}
     };
     char *tmp;
-    while ((c = getopt_long(argc, argv, "l:t:T:r:R:o:O:s:S:Gf:knv:V:m:M:auUhHc:C:Ii:e:xXpPq:Q:g:",loptions,NULL)) >= 0)
+    while ((c = bcftools_getopt_long(argc, argv, "l:t:T:r:R:o:O:s:S:Gf:knv:V:m:M:auUhHc:C:Ii:e:xXpPq:Q:g:",loptions,NULL)) >= 0)
     {
         char allele_type[9] = "nref";
         switch (c)
         {
             case 'O':
-                switch (optarg[0]) {
+                switch (bcftools_optarg[0]) {
                     case 'b': args->output_type = FT_BCF_GZ; break;
                     case 'u': args->output_type = FT_BCF; break;
                     case 'z': args->output_type = FT_VCF_GZ; break;
                     case 'v': args->output_type = FT_VCF; break;
-                    default: error("The output type \"%s\" not recognised\n", optarg);
+                    default: error("The output type \"%s\" not recognised\n", bcftools_optarg);
                 };
                 break;
             case 'l':
-                args->clevel = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --compression-level %s\n", optarg);
+                args->clevel = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --compression-level %s\n", bcftools_optarg);
                 args->output_type |= FT_GZ; 
                 break;
-            case 'o': args->fn_out = optarg; break;
+            case 'o': args->fn_out = bcftools_optarg; break;
             case 'H': args->print_header = 0; break;
             case 'h': args->header_only = 1; break;
 
-            case 't': args->targets_list = optarg; break;
-            case 'T': args->targets_list = optarg; targets_is_file = 1; break;
-            case 'r': args->regions_list = optarg; break;
-            case 'R': args->regions_list = optarg; regions_is_file = 1; break;
+            case 't': args->targets_list = bcftools_optarg; break;
+            case 'T': args->targets_list = bcftools_optarg; targets_is_file = 1; break;
+            case 'r': args->regions_list = bcftools_optarg; break;
+            case 'R': args->regions_list = bcftools_optarg; regions_is_file = 1; break;
 
-            case 's': args->sample_names = optarg; break;
-            case 'S': args->sample_names = optarg; args->sample_is_file = 1; break;
+            case 's': args->sample_names = bcftools_optarg; break;
+            case 'S': args->sample_names = bcftools_optarg; args->sample_is_file = 1; break;
             case  1 : args->force_samples = 1; break;
             case 'a': args->trim_alts = 1; args->calc_ac = 1; break;
             case 'I': args->update_info = 0; break;
             case 'G': args->sites_only = 1; break;
 
-            case 'f': args->files->apply_filters = optarg; break;
+            case 'f': args->files->apply_filters = bcftools_optarg; break;
             case 'k': args->known = 1; break;
             case 'n': args->novel = 1; break;
             case 'm':
-                args->min_alleles = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --min-alleles %s\n", optarg);
+                args->min_alleles = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --min-alleles %s\n", bcftools_optarg);
                 break;
             case 'M': 
-                args->max_alleles = strtol(optarg,&tmp,10);
-                if ( *tmp ) error("Could not parse argument: --max-alleles %s\n", optarg);
+                args->max_alleles = strtol(bcftools_optarg,&tmp,10);
+                if ( *tmp ) error("Could not parse argument: --max-alleles %s\n", bcftools_optarg);
                 break;
-            case 'v': args->include_types = optarg; break;
-            case 'V': args->exclude_types = optarg; break;
+            case 'v': args->include_types = bcftools_optarg; break;
+            case 'V': args->exclude_types = bcftools_optarg; break;
             case 'e':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_EXCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_EXCLUDE; break;
             case 'i':
                 if ( args->filter_str ) error("Error: only one -i or -e expression can be given, and they cannot be combined\n");
-                args->filter_str = optarg; args->filter_logic |= FLT_INCLUDE; break;
+                args->filter_str = bcftools_optarg; args->filter_logic |= FLT_INCLUDE; break;
             case 'c':
             {
                 args->min_ac_type = ALLELE_NONREF;
-                if ( sscanf(optarg,"%d:%8s",&args->min_ac, allele_type)!=2 && sscanf(optarg,"%d",&args->min_ac)!=1 )
-                    error("Error: Could not parse --min-ac %s\n", optarg);
+                if ( sscanf(bcftools_optarg,"%d:%8s",&args->min_ac, allele_type)!=2 && sscanf(bcftools_optarg,"%d",&args->min_ac)!=1 )
+                    error("Error: Could not parse --min-ac %s\n", bcftools_optarg);
                 set_allele_type(&args->min_ac_type, allele_type);
                 args->calc_ac = 1;
                 break;
@@ -658,8 +658,8 @@ int main_vcfview(int argc, char *argv[])
             case 'C':
             {
                 args->max_ac_type = ALLELE_NONREF;
-                if ( sscanf(optarg,"%d:%8s",&args->max_ac, allele_type)!=2 && sscanf(optarg,"%d",&args->max_ac)!=1 )
-                    error("Error: Could not parse --max-ac %s\n", optarg);
+                if ( sscanf(bcftools_optarg,"%d:%8s",&args->max_ac, allele_type)!=2 && sscanf(bcftools_optarg,"%d",&args->max_ac)!=1 )
+                    error("Error: Could not parse --max-ac %s\n", bcftools_optarg);
                 set_allele_type(&args->max_ac_type, allele_type);
                 args->calc_ac = 1;
                 break;
@@ -667,8 +667,8 @@ int main_vcfview(int argc, char *argv[])
             case 'q':
             {
                 args->min_af_type = ALLELE_NONREF;
-                if ( sscanf(optarg,"%f:%8s",&args->min_af, allele_type)!=2 && sscanf(optarg,"%f",&args->min_af)!=1 )
-                    error("Error: Could not parse --min-af %s\n", optarg);
+                if ( sscanf(bcftools_optarg,"%f:%8s",&args->min_af, allele_type)!=2 && sscanf(bcftools_optarg,"%f",&args->min_af)!=1 )
+                    error("Error: Could not parse --min-af %s\n", bcftools_optarg);
                 set_allele_type(&args->min_af_type, allele_type);
                 args->calc_ac = 1;
                 break;
@@ -676,8 +676,8 @@ int main_vcfview(int argc, char *argv[])
             case 'Q':
             {
                 args->max_af_type = ALLELE_NONREF;
-                if ( sscanf(optarg,"%f:%8s",&args->max_af, allele_type)!=2 && sscanf(optarg,"%f",&args->max_af)!=1 )
-                    error("Error: Could not parse --max-af %s\n", optarg);
+                if ( sscanf(bcftools_optarg,"%f:%8s",&args->max_af, allele_type)!=2 && sscanf(bcftools_optarg,"%f",&args->max_af)!=1 )
+                    error("Error: Could not parse --max-af %s\n", bcftools_optarg);
                 set_allele_type(&args->max_af_type, allele_type);
                 args->calc_ac = 1;
                 break;
@@ -691,19 +691,19 @@ int main_vcfview(int argc, char *argv[])
             case 'P': args->phased |= FLT_EXCLUDE; break; // exclude-phased
             case 'g':
             {
-                if ( !strcasecmp(optarg,"hom") ) args->gt_type = GT_NEED_HOM;
-                else if ( !strcasecmp(optarg,"het") ) args->gt_type = GT_NEED_HET;
-                else if ( !strcasecmp(optarg,"miss") ) args->gt_type = GT_NEED_MISSING;
-                else if ( !strcasecmp(optarg,"^hom") ) args->gt_type = GT_NO_HOM;
-                else if ( !strcasecmp(optarg,"^het") ) args->gt_type = GT_NO_HET;
-                else if ( !strcasecmp(optarg,"^miss") ) args->gt_type = GT_NO_MISSING;
-                else error("The argument to -g not recognised. Expected one of hom/het/miss/^hom/^het/^miss, got \"%s\".\n", optarg);
+                if ( !strcasecmp(bcftools_optarg,"hom") ) args->gt_type = GT_NEED_HOM;
+                else if ( !strcasecmp(bcftools_optarg,"het") ) args->gt_type = GT_NEED_HET;
+                else if ( !strcasecmp(bcftools_optarg,"miss") ) args->gt_type = GT_NEED_MISSING;
+                else if ( !strcasecmp(bcftools_optarg,"^hom") ) args->gt_type = GT_NO_HOM;
+                else if ( !strcasecmp(bcftools_optarg,"^het") ) args->gt_type = GT_NO_HET;
+                else if ( !strcasecmp(bcftools_optarg,"^miss") ) args->gt_type = GT_NO_MISSING;
+                else error("The argument to -g not recognised. Expected one of hom/het/miss/^hom/^het/^miss, got \"%s\".\n", bcftools_optarg);
                 break;
             }
-            case  9 : args->n_threads = strtol(optarg, 0, 0); break;
+            case  9 : args->n_threads = strtol(bcftools_optarg, 0, 0); break;
             case  8 : args->record_cmd_line = 0; break;
             case '?': usage(args); break;
-            default: error("Unknown argument: %s\n", optarg);
+            default: error("Unknown argument: %s\n", bcftools_optarg);
         }
     }
 
@@ -715,12 +715,12 @@ int main_vcfview(int argc, char *argv[])
     if ( args->sample_names && args->update_info) args->calc_ac = 1;
 
     char *fname = NULL;
-    if ( optind>=argc )
+    if ( bcftools_optind>=argc )
     {
         if ( !isatty(fileno((FILE *)stdin)) ) fname = "-";  // reading from stdin
         else usage(args);
     }
-    else fname = argv[optind];
+    else fname = argv[bcftools_optind];
 
     // read in the regions from the command line
     if ( args->regions_list )
@@ -728,12 +728,12 @@ int main_vcfview(int argc, char *argv[])
         if ( bcf_sr_set_regions(args->files, args->regions_list, regions_is_file)<0 )
             error("Failed to read the regions: %s\n", args->regions_list);
     }
-    else if ( optind+1 < argc )
+    else if ( bcftools_optind+1 < argc )
     {
         int i;
         kstring_t tmp = {0,0,0};
-        kputs(argv[optind+1],&tmp);
-        for (i=optind+2; i<argc; i++) { kputc(',',&tmp); kputs(argv[i],&tmp); }
+        kputs(argv[bcftools_optind+1],&tmp);
+        for (i=bcftools_optind+2; i<argc; i++) { kputc(',',&tmp); kputs(argv[i],&tmp); }
         if ( bcf_sr_set_regions(args->files, tmp.s, 0)<0 )
             error("Failed to read the regions: %s\n", tmp.s);
         free(tmp.s);
@@ -97,6 +97,9 @@ def _update_pysam_files(cf, destdir):
                     lines = re.sub(r"main_(reheader)\(",
                                    r"samtools_main_\1(", lines)
                 lines = re.sub(r"\bexit\(", "{}_exit(".format(basename), lines)
+                lines = re.sub(r"\bpthread_create\(", "{}_pthread_create(".format(basename), lines)
+                lines = re.sub(r"\b(getopt|getopt_long)\(", r"{}_\1(".format(basename), lines)
+                lines = re.sub(r"\b(optarg|optind|opterr|optopt)\b", r"{}_\1".format(basename), lines)
                 lines = re.sub("stderr", "{}_stderr".format(basename), lines)
                 lines = re.sub("stdout", "{}_stdout".format(basename), lines)
                 lines = re.sub(r" printf\(", " fprintf({}_stdout, ".format(basename), lines)
@@ -48,6 +48,7 @@
 #include "htslib/hts_endian.h"
 #include "cram/pooled_alloc.h"
 #include "hts_internal.h"
+#include "hfile_internal.h"
 
 #ifndef EFTYPE
 #define EFTYPE ENOEXEC
@@ -90,8 +91,202 @@ KHASH_MAP_INIT_INT64(cache, cache_t)
 struct bgzf_cache_t {
     khash_t(cache) *h;
     khint_t last_pos;
+    int shared;           // file has an identity usable by the shared cache
+    uint64_t file_id[4];  // see hfile_file_identity()
 };
 
+/*
+ * Process-wide cache of decompressed blocks, shared between all BGZF
+ * handles.  Entries are keyed by the identity of the underlying file
+ * and the compressed offset of the block, and kept on a doubly linked
+ * list in order of use so that the least recently used block is
+ * evicted first.  All access is serialised by a single mutex as the
+ * cache is used both by callers of bgzf_read_block() and by thread
+ * pool workers decoding blocks.
+ */
+typedef struct {
+    uint64_t file_id[4];
+    int64_t block_address;
+} shared_cache_key_t;
+
+typedef struct shared_cache_entry {
+    shared_cache_key_t key;
+    struct shared_cache_entry *prev, *next;
+    int size;         // uncompressed size
+    int clength;      // compressed size, used to skip the block on a hit
+    uint8_t block[];
+} shared_cache_entry_t;
+
+static inline khint_t shared_cache_hash(shared_cache_key_t key)
+{
+    uint64_t h = key.file_id[1] ^ (key.file_id[0] << 32);
+    h ^= (uint64_t) key.block_address * 0x9E3779B97F4A7C15ULL;
+    return kh_int64_hash_func(h);
+}
+
+static inline int shared_cache_equal(shared_cache_key_t a,
+                                     shared_cache_key_t b)
+{
+    return a.block_address == b.block_address
+        && memcmp(a.file_id, b.file_id, sizeof(a.file_id)) == 0;
+}
+
+KHASH_INIT(shared_cache, shared_cache_key_t, shared_cache_entry_t *, 1,
+           shared_cache_hash, shared_cache_equal)
+
+static struct {
+    pthread_mutex_t lock;
+    khash_t(shared_cache) *h;
+    shared_cache_entry_t *head, *tail; // most and least recently used
+    size_t capacity, size;
+    uint64_t hits, misses, evictions;
+} shared_cache = { PTHREAD_MUTEX_INITIALIZER };
+
+// Call with shared_cache.lock held
+static void shared_cache_unlink(shared_cache_entry_t *e)
+{
+    if (e->prev) e->prev->next = e->next;
+    else shared_cache.head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else shared_cache.tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+// Call with shared_cache.lock held
+static void shared_cache_push_front(shared_cache_entry_t *e)
+{
+    e->prev = NULL;
+    e->next = shared_cache.head;
+    if (shared_cache.head) shared_cache.head->prev = e;
+    shared_cache.head = e;
+    if (!shared_cache.tail) shared_cache.tail = e;
+}
+
+// Call with shared_cache.lock held
+static void shared_cache_evict(size_t needed)
+{
+    while (shared_cache.tail
+           && shared_cache.size + needed > shared_cache.capacity) {
+        shared_cache_entry_t *e = shared_cache.tail;
+        khint_t k = kh_get(shared_cache, shared_cache.h, e->key);
+        if (k != kh_end(shared_cache.h))
+            kh_del(shared_cache, shared_cache.h, k);
+        shared_cache_unlink(e);
+        shared_cache.size -= sizeof(*e) + e->size;
+        shared_cache.evictions++;
+        free(e);
+    }
+}
+
+int bgzf_set_shared_cache_size(size_t size)
+{
+    int ret = 0;
+    pthread_mutex_lock(&shared_cache.lock);
+    shared_cache.capacity = size;
+    shared_cache_evict(0);
+    if (size == 0) {
+        kh_destroy(shared_cache, shared_cache.h);
+        shared_cache.h = NULL;
+    } else if (!shared_cache.h) {
+        if (!(shared_cache.h = kh_init(shared_cache))) {
+            shared_cache.capacity = 0;
+            ret = -1;
+        }
+    }
+    pthread_mutex_unlock(&shared_cache.lock);
+    return ret;
+}
+
+void bgzf_shared_cache_stats(bgzf_shared_cache_stats_t *stats, int reset)
+{
+    pthread_mutex_lock(&shared_cache.lock);
+    stats->hits = shared_cache.hits;
+    stats->misses = shared_cache.misses;
+    stats->evictions = shared_cache.evictions;
+    stats->nblocks = shared_cache.h ? kh_size(shared_cache.h) : 0;
+    stats->size = shared_cache.size;
+    stats->capacity = shared_cache.capacity;
+    if (reset)
+        shared_cache.hits = shared_cache.misses = shared_cache.evictions = 0;
+    pthread_mutex_unlock(&shared_cache.lock);
+}
+
+/*
+ * Copies the block at block_address into dst (of size BGZF_MAX_BLOCK_SIZE).
+ *
+ * Returns the uncompressed size and sets *clength to the compressed size
+ * of the block on a hit, or -1 if the block is not cached.
+ */
+static int shared_cache_load(const BGZF *fp, int64_t block_address,
+                             uint8_t *dst, int *clength)
+{
+    shared_cache_key_t key;
+    int size = -1;
+
+    if (!fp->cache || !fp->cache->shared) return -1;
+
+    memcpy(key.file_id, fp->cache->file_id, sizeof(key.file_id));
+    key.block_address = block_address;
+
+    pthread_mutex_lock(&shared_cache.lock);
+    if (shared_cache.h) {
+        khint_t k = kh_get(shared_cache, shared_cache.h, key);
+        if (k != kh_end(shared_cache.h)) {
+            shared_cache_entry_t *e = kh_val(shared_cache.h, k);
+            memcpy(dst, e->block, e->size);
+            size = e->size;
+            *clength = e->clength;
+            shared_cache_unlink(e);
+            shared_cache_push_front(e);
+            shared_cache.hits++;
+        } else {
+            shared_cache.misses++;
+        }
+    }
+    pthread_mutex_unlock(&shared_cache.lock);
+    return size;
+}
+
+static void shared_cache_store(const BGZF *fp, int64_t block_address,
+                               const uint8_t *src, int size, int clength)
+{
+    shared_cache_key_t key;
+    shared_cache_entry_t *e;
+    khint_t k;
+    int ret;
+
+    if (!fp->cache || !fp->cache->shared || size <= 0) return;
+
+    memcpy(key.file_id, fp->cache->file_id, sizeof(key.file_id));
+    key.block_address = block_address;
+
+    pthread_mutex_lock(&shared_cache.lock);
+    if (!shared_cache.h || sizeof(*e) + size > shared_cache.capacity)
+        goto out;
+
+    // Another thread may have stored the block in the meantime
+    k = kh_get(shared_cache, shared_cache.h, key);
+    if (k != kh_end(shared_cache.h)) goto out;
+
+    shared_cache_evict(sizeof(*e) + size);
+    if (!(e = malloc(sizeof(*e) + size))) goto out;
+    k = kh_put(shared_cache, shared_cache.h, key, &ret);
+    if (ret <= 0) {
+        free(e);
+        goto out;
+    }
+    e->key = key;
+    e->size = size;
+    e->clength = clength;
+    memcpy(e->block, src, size);
+    kh_val(shared_cache.h, k) = e;
+    shared_cache_push_front(e);
+    shared_cache.size += sizeof(*e) + size;
+
+ out:
+    pthread_mutex_unlock(&shared_cache.lock);
+}
+
 #ifdef BGZF_MT
 
 typedef struct bgzf_job {
@@ -103,6 +298,7 @@ typedef struct bgzf_job {
     int errcode;
     int64_t block_address;
     int hit_eof;
+    int prefetch_end; // all ranges given to bgzf_mt_prefetch have been read
 } bgzf_job;
 
 enum mtaux_cmd {
@@ -156,6 +352,13 @@ typedef struct bgzf_mtaux_t {
     pthread_cond_t command_c;
     enum mtaux_cmd command;
 
+    // Compressed block ranges to restrict reading to; see bgzf_mt_prefetch.
+    // Stored as (first, last) block address pairs.  The pending list is
+    // handed over with the next SEEK, after which the reader thread owns
+    // ranges/n_ranges/i_range until the following SEEK.
+    int64_t *ranges, *pending_ranges;
+    int n_ranges, n_pending_ranges, i_range;
+
     // For multi-threaded on-the-fly indexing. See bgzf_idx_push below.
     pthread_mutex_t idx_m;
     hts_idx_t *hts_idx;
@@ -299,6 +502,8 @@ static int bgzf_idx_flush(BGZF *fp) {
 void bgzf_index_destroy(BGZF *fp);
 int bgzf_index_add_block(BGZF *fp);
 static int mt_destroy(mtaux_t *mt);
+static inline int64_t bgzf_seek_common(BGZF *fp, int64_t block_address,
+                                       int block_offset);
 
 static inline void packInt16(uint8_t *buffer, uint16_t value)
 {
@@ -424,6 +629,7 @@ static BGZF *bgzf_read_init(hFILE *hfpr, const char *filename)
         return NULL;
     }
     fp->cache->last_pos = 0;
+    fp->cache->shared = hfile_file_identity(hfpr, fp->cache->file_id) == 0;
 #endif
     return fp;
 }
@@ -782,13 +988,14 @@ static int bgzf_uncompress(uint8_t *dst, size_t *dlen,
 }
 #endif // HAVE_LIBDEFLATE
 
-// Inflate the block in fp->compressed_block into fp->uncompressed_block
-static int inflate_block(BGZF* fp, int block_length)
+// Inflate the compressed block (normally fp->compressed_block, but possibly
+// a memory mapped copy of the file) into fp->uncompressed_block
+static int inflate_block(BGZF* fp, const uint8_t *block, int block_length)
 {
     size_t dlen = BGZF_MAX_BLOCK_SIZE;
-    uint32_t crc = le_to_u32((uint8_t *)fp->compressed_block + block_length-8);
+    uint32_t crc = le_to_u32(block + block_length-8);
     int ret = bgzf_uncompress(fp->uncompressed_block, &dlen,
-                              (Bytef*)fp->compressed_block + 18,
+                              (const Bytef*)block + 18,
                               block_length - 18, crc);
     if (ret < 0) {
         if (ret == -2)
@@ -1019,6 +1226,20 @@ int bgzf_read_block(BGZF *fp)
             return -1;
         }
 
+        if (j->prefetch_end) {
+            // Everything requested by bgzf_mt_prefetch() has been
+            // consumed.  Resume ordinary read-ahead from where the
+            // reader stopped.
+            int64_t block_address = j->block_address;
+            pthread_mutex_lock(&fp->mt->job_pool_m);
+            pool_free(fp->mt->job_pool, j);
+            pthread_mutex_unlock(&fp->mt->job_pool_m);
+            hts_tpool_delete_result(r, 0);
+            if (bgzf_seek_common(fp, block_address, 0) < 0)
+                return -1;
+            goto again;
+        }
+
         if (j->hit_eof) {
             if (!fp->last_block_eof && !fp->no_eof_block) {
                 fp->no_eof_block = 1;
@@ -1069,6 +1290,7 @@ int bgzf_read_block(BGZF *fp)
     }
 
     uint8_t header[BLOCK_HEADER_LENGTH], *compressed_block;
+    const uint8_t *mapped_block;
     int count, size, block_length, remaining;
 
  single_threaded:
@@ -1117,6 +1339,27 @@ int bgzf_read_block(BGZF *fp)
     }
     if (fp->cache_size && load_block_from_cache(fp, block_address)) return 0;
 
+    int shared_clength;
+    count = shared_cache_load(fp, block_address, fp->uncompressed_block,
+                              &shared_clength);
+    if (count > 0) {
+        if (hseek(fp->fp, block_address + shared_clength, SEEK_SET) < 0) {
+            fp->errcode |= BGZF_ERR_IO;
+            return -1;
+        }
+        if (fp->block_length != 0) fp->block_offset = 0;
+        fp->block_address = block_address;
+        fp->block_clength = shared_clength;
+        fp->block_length = count;
+        fp->last_block_eof = 0;
+        if ( fp->idx_build_otf )
+        {
+            bgzf_index_add_block(fp);
+            fp->idx->ublock_addr += count;
+        }
+        return 0;
+    }
+
     // loop to skip empty bgzf blocks
     while (1)
     {
@@ -1179,19 +1422,29 @@ int bgzf_read_block(BGZF *fp)
             fp->errcode |= BGZF_ERR_HEADER;
             return -1;
         }
-        compressed_block = (uint8_t*)fp->compressed_block;
-        memcpy(compressed_block, header, BLOCK_HEADER_LENGTH);
         remaining = block_length - BLOCK_HEADER_LENGTH;
-        count = hread(fp->fp, &compressed_block[BLOCK_HEADER_LENGTH], remaining);
-        if (count != remaining) {
-            hts_log_error("Failed to read BGZF block data at offset %"PRId64
-                          " expected %d bytes; hread returned %d",
-                          block_address, remaining, count);
-            fp->errcode |= BGZF_ERR_IO;
-            return -1;
+        mapped_block = (const uint8_t *) hfile_mmap_read(fp->fp, remaining);
+        if (mapped_block) {
+            // Inflate straight from the mapping.  The header we have just
+            // read immediately precedes the rest of the block there.
+            mapped_block -= BLOCK_HEADER_LENGTH;
+            count = remaining;
+        } else {
+            compressed_block = (uint8_t*)fp->compressed_block;
+            memcpy(compressed_block, header, BLOCK_HEADER_LENGTH);
+            count = hread(fp->fp, &compressed_block[BLOCK_HEADER_LENGTH], remaining);
+            if (count != remaining) {
+                hts_log_error("Failed to read BGZF block data at offset %"PRId64
+                              " expected %d bytes; hread returned %d",
+                              block_address, remaining, count);
+                fp->errcode |= BGZF_ERR_IO;
+                return -1;
+            }
         }
         size += count;
-        if ((count = inflate_block(fp, block_length)) < 0) {
+        if ((count = inflate_block(fp, mapped_block ? mapped_block
+                                   : (uint8_t *) fp->compressed_block,
+                                   block_length)) < 0) {
             hts_log_debug("Inflate block operation failed for "
                           "block at offset %"PRId64": %s",
                           block_address, bgzf_zerr(count, NULL));
@@ -1211,6 +1464,7 @@ int bgzf_read_block(BGZF *fp)
         fp->idx->ublock_addr += count;
     }
     cache_block(fp, size);
+    shared_cache_store(fp, block_address, fp->uncompressed_block, count, size);
     return 0;
 }
 
@@ -1354,6 +1608,14 @@ static void *bgzf_encode_level0_func(void *arg) {
 // do the actual decompression step.
 static void *bgzf_decode_func(void *arg) {
     bgzf_job *j = (bgzf_job *)arg;
+    int clength, size;
+
+    size = shared_cache_load(j->fp, j->block_address, j->uncomp_data,
+                             &clength);
+    if (size > 0) {
+        j->uncomp_len = size;
+        return arg;
+    }
 
     j->uncomp_len = BGZF_MAX_BLOCK_SIZE;
     uint32_t crc = le_to_u32((uint8_t *)j->comp_data + j->comp_len-8);
@@ -1361,6 +1623,9 @@ static void *bgzf_decode_func(void *arg) {
                               j->comp_data+18, j->comp_len-18, crc);
     if (ret != 0)
         j->errcode |= BGZF_ERR_ZLIB;
+    else
+        shared_cache_store(j->fp, j->block_address, j->uncomp_data,
+                           j->uncomp_len, j->comp_len);
 
     return arg;
 }
@@ -1572,11 +1837,53 @@ static void bgzf_mt_seek(BGZF *fp) {
     if (hseek(fp->fp, mt->block_address, SEEK_SET) < 0)
         mt->errcode = BGZF_ERR_IO;
 
+    // Take over any range list from bgzf_mt_prefetch; a plain seek
+    // clears it.
+    free(mt->ranges);
+    mt->ranges = mt->pending_ranges;
+    mt->n_ranges = mt->n_pending_ranges;
+    mt->i_range = 0;
+    mt->pending_ranges = NULL;
+    mt->n_pending_ranges = 0;
+
     pthread_mutex_unlock(&mt->job_pool_m);
     mt->command = SEEK_DONE;
     pthread_cond_signal(&mt->command_c);
 }
 
+/*
+ * When reading a list of ranges (see bgzf_mt_prefetch), skips forward to
+ * the next range once the current one has been read.  Called by the
+ * reader thread before each block.
+ *
+ * Returns 0 to carry on reading,
+ *         1 when all ranges have been read (j->prefetch_end is set),
+ *        -1 on error.
+ */
+static int bgzf_mt_next_range(BGZF *fp, bgzf_job *j) {
+    mtaux_t *mt = fp->mt;
+    if (!mt->ranges)
+        return 0;
+
+    off_t pos = htell(fp->fp);
+    while (mt->i_range < mt->n_ranges && pos > mt->ranges[2*mt->i_range+1])
+        mt->i_range++;
+
+    if (mt->i_range == mt->n_ranges) {
+        j->prefetch_end = 1;
+        j->block_address = pos;
+        return 1;
+    }
+
+    if (pos < mt->ranges[2*mt->i_range]
+        && hseek(fp->fp, mt->ranges[2*mt->i_range], SEEK_SET) < 0) {
+        j->errcode |= BGZF_ERR_IO;
+        return -1;
+    }
+
+    return 0;
+}
+
 static void *bgzf_mt_reader(void *vp) {
     BGZF *fp = (BGZF *)vp;
     mtaux_t *mt = fp->mt;
@@ -1590,9 +1897,10 @@ restart:
     j->comp_len = 0;
     j->uncomp_len = 0;
     j->hit_eof = 0;
+    j->prefetch_end = 0;
     j->fp = fp;
 
-    while (bgzf_mt_read_block(fp, j) == 0) {
+    while (bgzf_mt_next_range(fp, j) == 0 && bgzf_mt_read_block(fp, j) == 0) {
         // Dispatch
         if (hts_tpool_dispatch3(mt->pool, mt->out_queue, bgzf_decode_func, j,
                                 job_cleanup, job_cleanup, 0) < 0) {
@@ -1640,9 +1948,23 @@ restart:
         j->comp_len = 0;
         j->uncomp_len = 0;
         j->hit_eof = 0;
+        j->prefetch_end = 0;
         j->fp = fp;
     }
 
+    if (j->prefetch_end) {
+        // The requested ranges are all queued.  Tell the consumer, so it
+        // can resume sequential reading if it wants more, and then wait
+        // for the next command.
+        if (hts_tpool_dispatch3(mt->pool, mt->out_queue, bgzf_nul_func, j,
+                                job_cleanup, job_cleanup, 0) < 0) {
+            job_cleanup(j);
+            hts_tpool_process_destroy(mt->out_queue);
+            return NULL;
+        }
+        goto idle;
+    }
+
     if (j->errcode == BGZF_ERR_MT) {
         // Attempt to multi-thread decode a raw gzip stream cannot be done.
         // We tear down the multi-threaded decoder and revert to the old code.
@@ -1677,6 +1999,7 @@ restart:
     //
     // To handle this we wait on a condition variable and then
     // monitor the command. (This could be either seek or close.)
+ idle:
     for (;;) {
         pthread_mutex_lock(&mt->command_m);
         if (mt->command == NONE)
@@ -1781,6 +2104,88 @@ int bgzf_mt(BGZF *fp, int n_threads, int n_sub_blks)
     return 0;
 }
 
+// Returns true if block_address lies within the ranges being prefetched
+static int bgzf_mt_prefetched(mtaux_t *mt, int64_t block_address)
+{
+    int lo = 0, hi = mt->n_ranges;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (mt->ranges[2*mid+1] < block_address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < mt->n_ranges && mt->ranges[2*lo] <= block_address;
+}
+
+/*
+ * Seeks forward within the prefetched ranges by consuming queued blocks
+ * rather than asking the reader thread to restart.
+ *
+ * Returns 0 on success, or -1 if the target is not reachable this way, in
+ * which case the caller should fall back to an ordinary seek.
+ */
+static int bgzf_mt_prefetch_seek(BGZF *fp, int64_t block_address,
+                                 int block_offset)
+{
+    mtaux_t *mt = fp->mt;
+
+    if (!mt->ranges || mt->pending_ranges
+        || fp->block_address > block_address
+        || !bgzf_mt_prefetched(mt, block_address))
+        return -1;
+
+    while (fp->block_length == 0 || fp->block_address < block_address) {
+        if (bgzf_read_block(fp) < 0 || !fp->mt || fp->block_length == 0)
+            return -1;
+    }
+    if (fp->block_address != block_address)
+        return -1;
+
+    fp->block_offset = block_offset;
+    return 0;
+}
+
+int bgzf_mt_prefetch(BGZF *fp, int n, const uint64_t *off)
+{
+    mtaux_t *mt = fp->mt;
+    int64_t *ranges;
+    int i, m;
+
+    if (n <= 0 || fp->is_write || fp->is_gzip) {
+        fp->errcode |= BGZF_ERR_MISUSE;
+        return -1;
+    }
+    if (!mt)
+        return bgzf_seek(fp, off[0], SEEK_SET) < 0 ? -1 : 0;
+
+    // Convert the chunks to inclusive (first, last) block addresses,
+    // merging any that share blocks.
+    if (!(ranges = malloc(2 * n * sizeof(*ranges))))
+        return -1;
+    for (i = m = 0; i < n; i++) {
+        int64_t beg = off[2*i] >> 16, end = off[2*i+1] >> 16;
+        if (end < beg)
+            end = beg;
+        if (m > 0 && beg <= ranges[2*m-1]) {
+            if (end > ranges[2*m-1])
+                ranges[2*m-1] = end;
+        } else {
+            ranges[2*m] = beg;
+            ranges[2*m+1] = end;
+            m++;
+        }
+    }
+
+    pthread_mutex_lock(&mt->command_m);
+    free(mt->pending_ranges);
+    mt->pending_ranges = ranges;
+    mt->n_pending_ranges = m;
+    pthread_mutex_unlock(&mt->command_m);
+
+    return bgzf_seek(fp, off[0], SEEK_SET) < 0 ? -1 : 0;
+}
+
 static int mt_destroy(mtaux_t *mt)
 {
     int ret = 0;
@@ -1822,6 +2227,9 @@ static int mt_destroy(mtaux_t *mt)
     if (mt->idx_cache.e)
         free(mt->idx_cache.e);
 
+    free(mt->ranges);
+    free(mt->pending_ranges);
+
     free(mt);
     fflush(stderr);
 
@@ -1918,6 +2326,15 @@ int bgzf_mt(BGZF *fp, int n_threads, int n_sub_blks)
     return 0;
 }
 
+int bgzf_mt_prefetch(BGZF *fp, int n, const uint64_t *off)
+{
+    if (n <= 0) {
+        fp->errcode |= BGZF_ERR_MISUSE;
+        return -1;
+    }
+    return bgzf_seek(fp, off[0], SEEK_SET) < 0 ? -1 : 0;
+}
+
 static inline int lazy_flush(BGZF *fp)
 {
     return bgzf_flush(fp);
@@ -2150,6 +2567,11 @@ static inline int64_t bgzf_seek_common(BGZF* fp,
                                        int64_t block_address, int block_offset)
 {
     if (fp->mt) {
+        // Within ranges set up by bgzf_mt_prefetch the block we want is
+        // normally already queued, so just read forward to it.
+        if (bgzf_mt_prefetch_seek(fp, block_address, block_offset) == 0)
+            return 0;
+
         // The reader runs asynchronous and does loops of:
         //    Read block
         //    Check & process command
@@ -190,6 +190,9 @@ static ssize_t refill_buffer(hFILE *fp)
     return n;
 }
 
+// Memory mapped files have an immobile buffer that must not be resized
+static const struct hFILE_backend mmap_backend;
+
 /*
  * Changes the buffer size for an hFILE.  Ideally this is done
  * immediately after opening.  If performed later, this function may
@@ -203,7 +206,7 @@ HTSLIB_EXPORT
 int hfile_set_blksize(hFILE *fp, size_t bufsiz) {
     char *buffer;
     ptrdiff_t curr_used;
-    if (!fp) return -1;
+    if (!fp || fp->backend == &mmap_backend) return -1;
     curr_used = (fp->begin > fp->end ? fp->begin : fp->end) - fp->buffer;
     if (bufsiz == 0) bufsiz = 32768;
 
@@ -615,6 +618,20 @@ static size_t blksize(int fd)
 #endif
 }
 
+int hfile_file_identity(hFILE *fp, uint64_t id[4])
+{
+    struct stat sbuf;
+    if (fp->backend != &fd_backend && fp->backend != &mmap_backend) return -1;
+    if (fstat(((hFILE_fd *) fp)->fd, &sbuf) != 0) return -1;
+    if (!S_ISREG(sbuf.st_mode)) return -1;
+
+    id[0] = sbuf.st_dev;
+    id[1] = sbuf.st_ino;
+    id[2] = sbuf.st_size;
+    id[3] = sbuf.st_mtime;
+    return 0;
+}
+
 static hFILE *hopen_fd(const char *filename, const char *mode)
 {
     hFILE_fd *fp = NULL;
@@ -870,6 +887,124 @@ int hfile_plugin_init_mem(struct hFILE_plugin *self)
     return 0;
 }
 
+/*******************************
+ * Memory mapped file backend  *
+ *******************************/
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+/* A mapped file keeps its hFILE_fd, but the whole mapping becomes a fixed
+   buffer, as for in-memory streams, so reads and seeks never reach the
+   backend.  The descriptor is retained for hfile_file_identity().  */
+
+static off_t mmap_seek(hFILE *fpv, off_t offset, int whence)
+{
+    errno = EINVAL;
+    return -1;
+}
+
+static int mmap_close(hFILE *fpv)
+{
+#ifdef HAVE_MMAP
+    if (fpv->buffer) munmap(fpv->buffer, fpv->limit - fpv->buffer);
+#endif
+    fpv->buffer = NULL; // Prevent hfile_destroy() from freeing the mapping
+    return fd_close(fpv);
+}
+
+static const struct hFILE_backend mmap_backend =
+{
+    NULL, NULL, mmap_seek, NULL, mmap_close
+};
+
+#ifdef HAVE_MMAP
+static int mmap_advise(hFILE *fp, int pattern)
+{
+#ifdef POSIX_MADV_NORMAL
+    int advice;
+    switch (pattern) {
+    case HTS_ACCESS_SEQUENTIAL: advice = POSIX_MADV_SEQUENTIAL; break;
+    case HTS_ACCESS_RANDOM:     advice = POSIX_MADV_RANDOM; break;
+    default:                    advice = POSIX_MADV_NORMAL; break;
+    }
+    // Only a hint, so failure is not an error
+    (void) posix_madvise(fp->buffer, fp->limit - fp->buffer, advice);
+#endif
+    return 0;
+}
+#endif
+
+int hfile_mmap(hFILE *fp, int pattern)
+{
+#ifdef HAVE_MMAP
+    hFILE_fd *fpfd = (hFILE_fd *) fp;
+    struct stat sbuf;
+    off_t pos;
+    char *map;
+
+    if (fp->backend == &mmap_backend) return mmap_advise(fp, pattern);
+
+    if (fp->backend != &fd_backend || !fp->readonly || fpfd->is_socket) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (fstat(fpfd->fd, &sbuf) != 0) return -1;
+    if (!S_ISREG(sbuf.st_mode) || sbuf.st_size == 0
+        || (uintmax_t) sbuf.st_size > SIZE_MAX) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    map = mmap(NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE, fpfd->fd, 0);
+    if (map == MAP_FAILED) return -1;
+
+    pos = htell(fp);
+    free(fp->buffer);
+    fp->buffer = map;
+    fp->end = fp->limit = &map[sbuf.st_size];
+    fp->begin = pos < sbuf.st_size ? &map[pos] : fp->end;
+    fp->offset = 0;
+    fp->at_eof = 1;
+    fp->mobile = 0;
+    fp->backend = &mmap_backend;
+
+    return mmap_advise(fp, pattern);
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+const char *hfile_mmap_read(hFILE *fp, size_t nbytes)
+{
+    const char *data = fp->begin;
+    if (fp->backend != &mmap_backend || fp->end - fp->begin < nbytes)
+        return NULL;
+
+    fp->begin += nbytes;
+    return data;
+}
+
+static hFILE *hopen_mmap(const char *url, const char *mode)
+{
+    hFILE *fp = hopen(url + 5, mode); // len("mmap:") = 5
+    if (fp == NULL) return NULL;
+
+    // Anything that cannot be mapped (pipes, writable files, ...) is
+    // quietly left as an ordinary stream.
+    if (fp->backend == &fd_backend && fp->readonly)
+        (void) hfile_mmap(fp, HTS_ACCESS_NORMAL);
+
+    return fp;
+}
+
+static int is_mmap_url_remote(const char *url)
+{
+    return hisremote(url + 5);
+}
+
 /**********************************************************************
  * Dummy crypt4gh plug-in.  Does nothing apart from advise how to get *
  * the real one.  It will be overridden by the actual plug-in.        *
@@ -1052,7 +1187,8 @@ static int load_hfile_plugins()
     static const struct hFILE_scheme_handler
         data = { hopen_mem, hfile_always_local, "built-in", 80 },
         file = { hopen_fd_fileuri, hfile_always_local, "built-in", 80 },
-        preload = { hopen_preload, is_preload_url_remote, "built-in", 80 };
+        preload = { hopen_preload, is_preload_url_remote, "built-in", 80 },
+        mapped = { hopen_mmap, is_mmap_url_remote, "built-in", 80 };
 
     schemes = kh_init(scheme_string);
     if (schemes == NULL)
@@ -1061,6 +1197,7 @@ static int load_hfile_plugins()
     hfile_add_scheme_handler("data", &data);
     hfile_add_scheme_handler("file", &file);
     hfile_add_scheme_handler("preload", &preload);
+    hfile_add_scheme_handler("mmap", &mapped);
     init_add_plugin(NULL, hfile_plugin_init_mem, "mem");
     init_add_plugin(NULL, hfile_plugin_init_crypt4gh_needed, "crypt4gh-needed");
 
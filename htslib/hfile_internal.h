@@ -26,6 +26,7 @@ DEALINGS IN THE SOFTWARE.  */
 #define HFILE_INTERNAL_H
 
 #include <stdarg.h>
+#include <stdint.h>
 
 #include "htslib/hts_defs.h"
 #include "htslib/hfile.h"
@@ -57,6 +58,43 @@ struct BGZF;
  */
 struct hFILE *bgzf_hfile(struct BGZF *fp);
 
+/*!
+  @abstract Return an identity for the file underlying an hFILE
+  @param fp   The file stream
+  @param id   Filled with device, inode, size and modification time
+  @return 0 on success, or -1 if the stream is not a regular local file
+
+  @notes  Used to share decompressed blocks between handles open on
+  the same file.  Streams without a stable identity, such as pipes and
+  remote files, return -1.
+*/
+int hfile_file_identity(hFILE *fp, uint64_t id[4]);
+
+/*!
+  @abstract  Serve a local file from a read-only memory mapping
+  @param fp       The file stream; must be open for reading only
+  @param pattern  Expected access pattern, as an enum hts_access_pattern
+  @return 0 on success, or -1 if fp is not a regular local file or the
+  mapping fails, in which case fp is left unchanged
+
+  @notes  The stream position is preserved.  Subsequent reads and seeks
+  are served from the mapping without system calls.  If fp is already
+  mapped, only the access pattern advice is updated.
+*/
+int hfile_mmap(hFILE *fp, int pattern);
+
+/*!
+  @abstract  Consume bytes from a memory mapped stream without copying
+  @param fp      The file stream
+  @param nbytes  Number of bytes wanted
+  @return Pointer to the next nbytes of the mapping, after which the stream
+  is positioned, or NULL (consuming nothing) if fp is not memory mapped
+  or fewer than nbytes remain
+
+  @notes  The pointer remains valid until the stream is closed.
+*/
+const char *hfile_mmap_read(hFILE *fp, size_t nbytes);
+
 /*!
   @abstract Closes all hFILE plugins that have been loaded
 */
@@ -40,12 +40,14 @@ DEALINGS IN THE SOFTWARE.  */
 #include <time.h>
 #include <sys/stat.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "htslib/hts.h"
 #include "htslib/bgzf.h"
 #include "cram/cram.h"
 #include "htslib/hfile.h"
 #include "htslib/hts_endian.h"
+#include "htslib/thread_pool.h"
 #include "version.h"
 #include "config_vars.h"
 #include "hts_internal.h"
@@ -1019,6 +1021,17 @@ int hts_opt_add(hts_opt **opts, const char *c_arg) {
              strcmp(o->arg, "FILTER") == 0)
         o->opt = HTS_OPT_FILTER, o->val.s = val;
 
+    else if (strcmp(o->arg, "mmap") == 0 ||
+             strcmp(o->arg, "MMAP") == 0) {
+        o->opt = HTS_OPT_MMAP;
+        if (strcmp(val, "random") == 0)
+            o->val.i = HTS_ACCESS_RANDOM;
+        else if (strcmp(val, "sequential") == 0)
+            o->val.i = HTS_ACCESS_SEQUENTIAL;
+        else
+            o->val.i = HTS_ACCESS_NORMAL;
+    }
+
     else if (strcmp(o->arg, "fastq_aux") == 0 ||
         strcmp(o->arg, "FASTQ_AUX") == 0)
         o->opt = FASTQ_OPT_AUX, o->val.s = val;
@@ -1557,6 +1570,29 @@ int hts_set_opt(htsFile *fp, enum hts_fmt_option opt, ...) {
         return 0;
     }
 
+    case HTS_OPT_MMAP: {
+        hFILE *hf = hts_hfile(fp);
+        int pattern;
+
+        va_start(args, opt);
+        pattern = va_arg(args, int);
+        va_end(args);
+
+        // Mapping swaps the hFILE buffer over in place, so must not
+        // happen under a BGZF reader thread.  Already mapped (immobile)
+        // streams only have their access pattern advice updated.
+        if (hf && hf->mobile && fp->is_bgzf && fp->fp.bgzf->mt) {
+            hts_log_warning("Memory mapping must be enabled before threads");
+            return -1;
+        }
+        if (!hf || hfile_mmap(hf, pattern) != 0) {
+            hts_log_warning("Cannot memory map \"%s\"; using ordinary reads",
+                            fp->fn ? fp->fn : "");
+            return -1;
+        }
+        return 0;
+    }
+
     case HTS_OPT_THREAD_POOL: {
         va_start(args, opt);
         htsThreadPool *p = va_arg(args, htsThreadPool *);
@@ -1963,6 +1999,20 @@ typedef struct {
     uint64_t *offset;
 } lidx_t;
 
+// State for indices loaded with HTS_IDX_LAZY.  Only the header is read
+// up front; the bins and linear index of a reference are read from the
+// still open file the first time they are used.  The file does not record
+// where each reference's data starts, so this is found by stepping over
+// the references before it, and remembered.
+typedef struct {
+    BGZF *fp;
+    uint64_t *off;   // virtual offset of each reference's data, then of n_no_coor
+    int32_t n_off;   // number of offsets found so far
+    uint8_t *loaded; // 0: not yet read, 1: bidx[i] and lidx[i] read, 2: failed
+    int no_coor_read;
+    pthread_mutex_t lock;
+} idx_lazy_t;
+
 struct hts_idx_t {
     int fmt, min_shift, n_lvls, n_bins;
     uint32_t l_meta;
@@ -1970,6 +2020,8 @@ struct hts_idx_t {
     uint64_t n_no_coor;
     bidx_t **bidx;
     lidx_t *lidx;
+    idx_lazy_t *lazy; // NULL unless loaded with HTS_IDX_LAZY
+    int n_shared; // additional owners, see hts_idx_share()
     uint8_t *meta; // MUST have a terminating NUL on the end
     int tbi_n, last_tbi_tid;
     struct {
@@ -1982,6 +2034,8 @@ struct hts_idx_t {
     } z; // keep internal states
 };
 
+static pthread_mutex_t idx_share_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static char * idx_format_name(int fmt) {
     switch (fmt) {
         case HTS_FMT_CSI: return "csi";
@@ -2362,6 +2416,310 @@ void hts_idx_amend_last(hts_idx_t *idx, uint64_t offset)
     idx->z.last_off = offset;
 }
 
+/*
+ * Parallel index building.
+ *
+ * The data after the header is split into partitions that start at BGZF
+ * block boundaries.  Worker threads find the first record starting in each
+ * partition and read records up to the start of the next one, noting what
+ * hts_idx_push() needs for each.  The calling thread replays the pushes in
+ * file order, so the index is identical to one built by a single thread.
+ * A partition whose first record was guessed wrongly, as shown by where
+ * the previous partition's last record ended, is read again from the
+ * correct offset.
+ */
+
+#define IDX_PART_MIN_SIZE (16 << 20)
+#define IDX_BGZF_MAX_BLOCK 65536
+#define IDX_BGZF_HDR_SIZE 18
+
+typedef struct {
+    uint64_t offset;
+    hts_pos_t beg, end;
+    int tid, is_mapped;
+} idx_rec_t;
+
+typedef struct {
+    const char *fn;
+    const hts_idx_build_ops *ops;
+    void *data;
+    uint64_t prev_block, block; // BGZF blocks before and at the start
+    uint64_t limit;             // start of the next partition
+    int64_t start;              // first record if known, otherwise -1
+    // results
+    int status, found, eof;
+    int err;                    // errno of a failure, set on its thread
+    uint64_t rec_start, end;    // first record and end of the last one
+    idx_rec_t *recs;
+    size_t n, m;
+    void *state;
+} idx_part_t;
+
+static inline int idx_is_bgzf_header(const uint8_t *p)
+{
+    return p[0] == 31 && p[1] == 139 && p[2] == 8 && p[3] == 4
+        && le_to_u16(p + 10) == 6 && p[12] == 'B' && p[13] == 'C'
+        && le_to_u16(p + 14) == 2;
+}
+
+// Find the first BGZF block at or after pos whose successor also has a
+// valid header.  Sets *prev to its address and *next to its successor's.
+// Returns 0 on success, -1 if there is none before EOF, < -1 on error.
+static int idx_find_block(hFILE *hf, off_t pos, uint8_t *buf,
+                          uint64_t *prev, uint64_t *next)
+{
+    const size_t size = 2 * IDX_BGZF_MAX_BLOCK + IDX_BGZF_HDR_SIZE;
+    ssize_t len, i;
+
+    if (hseek(hf, pos, SEEK_SET) < 0) return -2;
+    len = hread(hf, buf, size);
+    if (len < 0) return -2;
+    for (i = 0; i + IDX_BGZF_HDR_SIZE <= len && i < IDX_BGZF_MAX_BLOCK; i++) {
+        size_t bsize;
+        if (!idx_is_bgzf_header(buf + i)) continue;
+        bsize = le_to_u16(buf + i + 16) + 1;
+        if (i + bsize + IDX_BGZF_HDR_SIZE > len
+            || !idx_is_bgzf_header(buf + i + bsize))
+            continue;
+        *prev = pos + i;
+        *next = pos + i + bsize;
+        return 0;
+    }
+    return -1;
+}
+
+static void idx_part_free(idx_part_t *p)
+{
+    if (p->state) p->ops->destroy(p->state);
+    free(p->recs);
+    p->state = NULL;
+    p->recs = NULL;
+    p->n = p->m = 0;
+}
+
+static void *idx_build_part(void *arg)
+{
+    idx_part_t *p = (idx_part_t *) arg;
+    BGZF *fp = bgzf_open(p->fn, "r");
+    int64_t off;
+    int ret;
+
+    p->status = -1;
+    if (!fp) {
+        p->err = errno;
+        return p;
+    }
+    p->state = p->ops->init(p->data);
+    if (!p->state) goto out;
+
+    if (p->start >= 0) {
+        off = p->start;
+    } else {
+        off = p->ops->sync(p->state, fp, p->prev_block, p->block, p->limit);
+        if (off == -1) { // nothing starts in this partition
+            p->status = 0;
+            goto out;
+        }
+        if (off < 0) goto out;
+    }
+    if (bgzf_seek(fp, off, SEEK_SET) < 0) goto out;
+    p->found = 1;
+    p->rec_start = off;
+
+    for (;;) {
+        idx_rec_t *r;
+        p->end = bgzf_tell(fp);
+        if ((p->end >> 16) >= p->limit) break;
+        if (p->n == p->m) {
+            size_t new_m = p->m ? p->m * 2 : 1024;
+            idx_rec_t *new_recs = realloc(p->recs, new_m * sizeof(*new_recs));
+            if (!new_recs) goto out;
+            p->recs = new_recs;
+            p->m = new_m;
+        }
+        r = &p->recs[p->n];
+        ret = p->ops->next(p->state, fp, &r->tid, &r->beg, &r->end,
+                           &r->is_mapped);
+        if (ret == -1) {
+            p->eof = 1;
+            p->end = bgzf_tell(fp);
+            break;
+        }
+        if (ret < -1) goto out;
+        if (ret > 0) continue;
+        r->offset = bgzf_tell(fp);
+        p->n++;
+    }
+    p->status = 0;
+
+ out:
+    if (p->status < 0) p->err = errno;
+    bgzf_close(fp);
+    return p;
+}
+
+// Push the records of a partition, read from the expected offset.
+static int idx_replay_part(hts_idx_t *idx, idx_part_t *p)
+{
+    size_t i;
+    for (i = 0; i < p->n; i++) {
+        idx_rec_t *r = &p->recs[i];
+        int tid = r->tid;
+        if (p->ops->map_tid && tid >= 0) {
+            tid = p->ops->map_tid(p->data, p->state, tid);
+            if (tid < 0) return -1;
+        }
+        if (hts_idx_push(idx, tid, r->beg, r->end, r->offset,
+                         r->is_mapped) < 0) {
+            if (p->ops->push_error)
+                p->ops->push_error(p->data, i ? p->recs[i-1].offset
+                                               : p->rec_start);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Check the partition p started where the previous one ended, reading it
+// again if not, and push its records.  Returns 1 once EOF is reached.
+static int idx_merge_part(hts_idx_t *idx, idx_part_t *p, uint64_t *expect)
+{
+    if ((*expect >> 16) >= p->limit)
+        return 0; // the previous partition's last record spans this one
+
+    if (p->status < 0 || !p->found || p->rec_start != *expect) {
+        idx_part_free(p);
+        p->start = *expect;
+        p->found = p->eof = 0;
+        idx_build_part(p);
+        if (p->status < 0) {
+            errno = p->err;
+            return -1;
+        }
+    }
+    if (idx_replay_part(idx, p) < 0) return -1;
+    *expect = p->end;
+    return p->eof;
+}
+
+int hts_idx_build_parallel(hts_idx_t *idx, const char *fn, uint64_t start,
+                           int n_threads, const hts_idx_build_ops *ops,
+                           void *data, uint64_t *final_offset)
+{
+    hts_tpool *pool = NULL;
+    hts_tpool_process *q = NULL;
+    hts_tpool_result *res;
+    idx_part_t *parts = NULL;
+    uint8_t *buf = NULL;
+    hFILE *hf = NULL;
+    off_t size, part_size;
+    uint64_t expect = start;
+    int i, n_parts = 1, n_done = 0, eof = 0, ret = -1, save_errno;
+
+    if (n_threads < 1) n_threads = 1;
+    if (!(hf = hopen(fn, "r"))) return -1;
+    if ((size = hseek(hf, 0, SEEK_END)) < 0) goto out;
+
+    part_size = (size - (off_t) (start >> 16)) / (n_threads * 8);
+    if (part_size < IDX_PART_MIN_SIZE) part_size = IDX_PART_MIN_SIZE;
+    n_parts = (size - (off_t) (start >> 16)) / part_size + 1;
+    parts = calloc(n_parts, sizeof(*parts));
+    buf = malloc(2 * IDX_BGZF_MAX_BLOCK + IDX_BGZF_HDR_SIZE);
+    if (!parts || !buf) goto out;
+
+    // Partition boundaries, which must be strictly increasing
+    parts[0].start = start;
+    for (i = 1; i < n_parts; i++) {
+        off_t pos = (off_t) (start >> 16) + i * part_size;
+        uint64_t prev, next;
+        int r = idx_find_block(hf, pos, buf, &prev, &next);
+        if (r < -1) goto out;
+        if (r < 0 || next <= parts[i-1].block || next >= size) break;
+        parts[i].prev_block = prev;
+        parts[i].block = next;
+        parts[i].start = -1;
+        parts[i-1].limit = next;
+    }
+    n_parts = i;
+    parts[n_parts - 1].limit = UINT64_MAX;
+    for (i = 0; i < n_parts; i++) {
+        parts[i].fn = fn;
+        parts[i].ops = ops;
+        parts[i].data = data;
+    }
+
+    if (n_parts > 1) {
+        if (!(pool = hts_tpool_init(n_threads))) goto out;
+        if (!(q = hts_tpool_process_init(pool, n_threads * 2, 0))) goto out;
+    }
+
+    for (i = 0; i < n_parts || n_done < n_parts; ) {
+        idx_part_t *p;
+        if (i < n_parts && pool) {
+            if (hts_tpool_dispatch2(pool, q, idx_build_part, &parts[i], 1) == 0) {
+                i++;
+                continue;
+            }
+            if (errno != EAGAIN) goto out;
+        }
+        if (pool) {
+            if (!(res = hts_tpool_next_result_wait(q))) goto out;
+            p = (idx_part_t *) hts_tpool_result_data(res);
+            hts_tpool_delete_result(res, 0);
+        } else {
+            p = (idx_part_t *) idx_build_part(&parts[i++]);
+        }
+        n_done++;
+        if (!eof) {
+            int r = idx_merge_part(idx, p, &expect);
+            if (r < 0) goto out;
+            eof = r;
+        }
+        idx_part_free(p);
+    }
+
+    if (!eof) goto out; // the last partition is always read to EOF
+    *final_offset = expect;
+    ret = 0;
+
+ out:
+    // the cleanup below may change errno, the caller reports the failure
+    save_errno = errno;
+    if (q) {
+        hts_tpool_process_flush(q);
+        while ((res = hts_tpool_next_result(q))) {
+            idx_part_free((idx_part_t *) hts_tpool_result_data(res));
+            hts_tpool_delete_result(res, 0);
+        }
+        hts_tpool_process_destroy(q);
+    }
+    if (pool) hts_tpool_destroy(pool);
+    if (parts) {
+        for (i = 0; i < n_parts; i++) idx_part_free(&parts[i]);
+        free(parts);
+    }
+    free(buf);
+    if (hf) hclose_abruptly(hf);
+    if (ret < 0) errno = save_errno;
+    return ret;
+}
+
+int hts_idx_build_parallel_ok(const char *fn)
+{
+    struct stat st;
+    return !hisremote(fn) && stat(fn, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+hts_idx_t *hts_idx_share(hts_idx_t *idx)
+{
+    // CRAM indices are bound to the cram_fd they were loaded for
+    if (idx == NULL || idx->fmt == HTS_FMT_CRAI) return NULL;
+    pthread_mutex_lock(&idx_share_lock);
+    idx->n_shared++;
+    pthread_mutex_unlock(&idx_share_lock);
+    return idx;
+}
+
 void hts_idx_destroy(hts_idx_t *idx)
 {
     khint_t k;
@@ -2376,6 +2734,22 @@ void hts_idx_destroy(hts_idx_t *idx)
         return;
     }
 
+    pthread_mutex_lock(&idx_share_lock);
+    if (idx->n_shared > 0) {
+        idx->n_shared--;
+        pthread_mutex_unlock(&idx_share_lock);
+        return;
+    }
+    pthread_mutex_unlock(&idx_share_lock);
+
+    if (idx->lazy) {
+        if (idx->lazy->fp) bgzf_close(idx->lazy->fp);
+        pthread_mutex_destroy(&idx->lazy->lock);
+        free(idx->lazy->off);
+        free(idx->lazy->loaded);
+        free(idx->lazy);
+    }
+
     for (i = 0; i < idx->m; ++i) {
         bidx_t *bidx = idx->bidx[i];
         free(idx->lidx[i].offset);
@@ -2423,12 +2797,16 @@ static inline void swap_bins(bins_t *p)
     }
 }
 
+static int idx_load_all(const hts_idx_t *idx);
+
 static int idx_save_core(const hts_idx_t *idx, BGZF *fp, int fmt)
 {
     int32_t i, j;
 
     #define check(ret) if ((ret) < 0) return -1
 
+    check(idx_load_all(idx));
+
     // VCF TBI/CSI only writes IDs for non-empty bins (ie covered references)
     //
     // NOTE: CSI meta is undefined in spec, so this code has an assumption
@@ -2539,64 +2917,121 @@ fail:
     return -1;
 }
 
-static int idx_read_core(hts_idx_t *idx, BGZF *fp, int fmt)
+// Reads the bins and linear index of reference i
+static int idx_read_tid(hts_idx_t *idx, BGZF *fp, int fmt, int i)
 {
-    int32_t i, n, is_be;
+    int32_t n, is_be;
+    bidx_t *h;
+    lidx_t *l = &idx->lidx[i];
+    uint32_t key;
+    int j, absent;
+    bins_t *p;
     is_be = ed_is_big();
+    h = idx->bidx[i] = kh_init(bin);
+    if (h == NULL) return -2;
+    if (bgzf_read(fp, &n, 4) != 4) return -1;
+    if (is_be) ed_swap_4p(&n);
+    if (n < 0) return -3;
+    for (j = 0; j < n; ++j) {
+        khint_t k;
+        if (bgzf_read(fp, &key, 4) != 4) return -1;
+        if (is_be) ed_swap_4p(&key);
+        k = kh_put(bin, h, key, &absent);
+        if (absent <  0) return -2; // No memory
+        if (absent == 0) return -3; // Duplicate bin number
+        p = &kh_val(h, k);
+        if (fmt == HTS_FMT_CSI) {
+            if (bgzf_read(fp, &p->loff, 8) != 8) return -1;
+            if (is_be) ed_swap_8p(&p->loff);
+        } else p->loff = 0;
+        if (bgzf_read(fp, &p->n, 4) != 4) return -1;
+        if (is_be) ed_swap_4p(&p->n);
+        if (p->n < 0) return -3;
+        if ((size_t) p->n > SIZE_MAX / sizeof(hts_pair64_t)) return -2;
+        p->m = p->n;
+        p->list = (hts_pair64_t*)malloc(p->m * sizeof(hts_pair64_t));
+        if (p->list == NULL) return -2;
+        if (bgzf_read(fp, p->list, ((size_t) p->n)<<4) != ((size_t) p->n)<<4) return -1;
+        if (is_be) swap_bins(p);
+    }
+    if (fmt != HTS_FMT_CSI) { // load linear index
+        int j, k;
+        uint32_t x;
+        if (bgzf_read(fp, &x, 4) != 4) return -1;
+        if (is_be) ed_swap_4p(&x);
+        l->n = x;
+        if (l->n < 0) return -3;
+        if ((size_t) l->n > SIZE_MAX / sizeof(uint64_t)) return -2;
+        l->m = l->n;
+        l->offset = (uint64_t*)malloc(l->n * sizeof(uint64_t));
+        if (l->offset == NULL) return -2;
+        if (bgzf_read(fp, l->offset, l->n << 3) != l->n << 3) return -1;
+        if (is_be) for (j = 0; j < l->n; ++j) ed_swap_8p(&l->offset[j]);
+        for (k = j = 0; j < l->n && l->offset[j] == 0; k = ++j); // stop at the first non-zero entry
+        for (j = l->n-1; j > k; j--) // fill missing values; may happen given older samtools and tabix
+            if (l->offset[j-1] == 0) l->offset[j-1] = l->offset[j];
+        update_loff(idx, i, 0);
+    }
+    return 0;
+}
+
+// Discards n bytes of fp
+static int idx_skip(BGZF *fp, uint64_t n)
+{
+    uint8_t buf[8192];
+    while (n > 0) {
+        size_t len = n < sizeof(buf) ? n : sizeof(buf);
+        if (bgzf_read(fp, buf, len) != len) return -1;
+        n -= len;
+    }
+    return 0;
+}
+
+// Steps over the data for one reference without storing it
+static int idx_skip_tid(BGZF *fp, int fmt)
+{
+    int32_t n, n_chunk, j, is_be = ed_is_big();
+    uint32_t x;
+    if (bgzf_read(fp, &n, 4) != 4) return -1;
+    if (is_be) ed_swap_4p(&n);
+    if (n < 0) return -3;
+    for (j = 0; j < n; ++j) {
+        // bin number, then loff for CSI
+        if (idx_skip(fp, fmt == HTS_FMT_CSI ? 12 : 4) < 0) return -1;
+        if (bgzf_read(fp, &n_chunk, 4) != 4) return -1;
+        if (is_be) ed_swap_4p(&n_chunk);
+        if (n_chunk < 0) return -3;
+        if (idx_skip(fp, (uint64_t) n_chunk << 4) < 0) return -1;
+    }
+    if (fmt != HTS_FMT_CSI) {
+        if (bgzf_read(fp, &x, 4) != 4) return -1;
+        if (is_be) ed_swap_4p(&x);
+        if (idx_skip(fp, (uint64_t) x << 3) < 0) return -1;
+    }
+    return 0;
+}
+
+static int idx_read_core(hts_idx_t *idx, BGZF *fp, int fmt, int lazy)
+{
+    int32_t i;
+    int ret;
     if (idx == NULL) return -4;
+    if (lazy && idx->n > 0) {
+        if (!(idx->lazy = calloc(1, sizeof(*idx->lazy)))) return -2;
+        pthread_mutex_init(&idx->lazy->lock, NULL);
+        idx->lazy->off = malloc(((size_t) idx->n + 1) * sizeof(*idx->lazy->off));
+        idx->lazy->loaded = calloc(idx->n, 1);
+        if (!idx->lazy->off || !idx->lazy->loaded) return -2;
+        idx->lazy->off[0] = bgzf_tell(fp);
+        idx->lazy->n_off = 1;
+        return 0;
+    }
     for (i = 0; i < idx->n; ++i) {
-        bidx_t *h;
-        lidx_t *l = &idx->lidx[i];
-        uint32_t key;
-        int j, absent;
-        bins_t *p;
-        h = idx->bidx[i] = kh_init(bin);
-        if (bgzf_read(fp, &n, 4) != 4) return -1;
-        if (is_be) ed_swap_4p(&n);
-        if (n < 0) return -3;
-        for (j = 0; j < n; ++j) {
-            khint_t k;
-            if (bgzf_read(fp, &key, 4) != 4) return -1;
-            if (is_be) ed_swap_4p(&key);
-            k = kh_put(bin, h, key, &absent);
-            if (absent <  0) return -2; // No memory
-            if (absent == 0) return -3; // Duplicate bin number
-            p = &kh_val(h, k);
-            if (fmt == HTS_FMT_CSI) {
-                if (bgzf_read(fp, &p->loff, 8) != 8) return -1;
-                if (is_be) ed_swap_8p(&p->loff);
-            } else p->loff = 0;
-            if (bgzf_read(fp, &p->n, 4) != 4) return -1;
-            if (is_be) ed_swap_4p(&p->n);
-            if (p->n < 0) return -3;
-            if ((size_t) p->n > SIZE_MAX / sizeof(hts_pair64_t)) return -2;
-            p->m = p->n;
-            p->list = (hts_pair64_t*)malloc(p->m * sizeof(hts_pair64_t));
-            if (p->list == NULL) return -2;
-            if (bgzf_read(fp, p->list, ((size_t) p->n)<<4) != ((size_t) p->n)<<4) return -1;
-            if (is_be) swap_bins(p);
-        }
-        if (fmt != HTS_FMT_CSI) { // load linear index
-            int j, k;
-            uint32_t x;
-            if (bgzf_read(fp, &x, 4) != 4) return -1;
-            if (is_be) ed_swap_4p(&x);
-            l->n = x;
-            if (l->n < 0) return -3;
-            if ((size_t) l->n > SIZE_MAX / sizeof(uint64_t)) return -2;
-            l->m = l->n;
-            l->offset = (uint64_t*)malloc(l->n * sizeof(uint64_t));
-            if (l->offset == NULL) return -2;
-            if (bgzf_read(fp, l->offset, l->n << 3) != l->n << 3) return -1;
-            if (is_be) for (j = 0; j < l->n; ++j) ed_swap_8p(&l->offset[j]);
-            for (k = j = 0; j < l->n && l->offset[j] == 0; k = ++j); // stop at the first non-zero entry
-            for (j = l->n-1; j > k; j--) // fill missing values; may happen given older samtools and tabix
-                if (l->offset[j-1] == 0) l->offset[j-1] = l->offset[j];
-            update_loff(idx, i, 0);
-        }
+        ret = idx_read_tid(idx, fp, fmt, i);
+        if (ret < 0) return ret;
     }
     if (bgzf_read(fp, &idx->n_no_coor, 8) != 8) idx->n_no_coor = 0;
-    if (is_be) ed_swap_8p(&idx->n_no_coor);
+    if (ed_is_big()) ed_swap_8p(&idx->n_no_coor);
 #ifdef DEBUG_INDEX
     idx_dump(idx);
 #endif
@@ -2604,8 +3039,97 @@ static int idx_read_core(hts_idx_t *idx, BGZF *fp, int fmt)
     return 0;
 }
 
-static hts_idx_t *idx_read(const char *fn)
+// Moves the file of a lazily loaded index to where the data of reference
+// tid starts, or to n_no_coor for tid == idx->n.  Called with the lock held.
+static int idx_lazy_seek(hts_idx_t *idx, int tid)
 {
+    idx_lazy_t *lazy = idx->lazy;
+    while (lazy->n_off <= tid) {
+        int i = lazy->n_off - 1;
+        if (bgzf_tell(lazy->fp) != lazy->off[i]
+            && bgzf_seek(lazy->fp, lazy->off[i], SEEK_SET) < 0)
+            return -1;
+        if (idx_skip_tid(lazy->fp, idx->fmt) < 0) return -1;
+        lazy->off[lazy->n_off++] = bgzf_tell(lazy->fp);
+    }
+    if (bgzf_tell(lazy->fp) != lazy->off[tid]
+        && bgzf_seek(lazy->fp, lazy->off[tid], SEEK_SET) < 0)
+        return -1;
+    return 0;
+}
+
+/*
+ * Makes sure reference tid of a lazily loaded index has been read.
+ * The index is logically const; reading in its bins just fills a cache.
+ *
+ * Returns 0 on success (including when idx is not lazy),
+ *        -1 on failure, setting errno to EIO.
+ */
+static int idx_load_tid(const hts_idx_t *cidx, int tid)
+{
+    hts_idx_t *idx = (hts_idx_t *) cidx;
+    idx_lazy_t *lazy = idx->lazy;
+    int ret = 0;
+
+    if (!lazy || tid < 0 || tid >= idx->n) return 0;
+
+    pthread_mutex_lock(&lazy->lock);
+    if (!lazy->loaded[tid]) {
+        // Failures are remembered, so a partially read reference is
+        // never used or re-read.
+        if (idx_lazy_seek(idx, tid) < 0
+            || idx_read_tid(idx, lazy->fp, idx->fmt, tid) < 0) {
+            hts_log_error("Failed to read index data for reference %d", tid);
+            lazy->loaded[tid] = 2;
+        } else {
+            lazy->loaded[tid] = 1;
+            if (lazy->n_off == tid + 1)
+                lazy->off[lazy->n_off++] = bgzf_tell(lazy->fp);
+        }
+    }
+    if (lazy->loaded[tid] != 1) {
+        errno = EIO;
+        ret = -1;
+    }
+    pthread_mutex_unlock(&lazy->lock);
+
+    return ret;
+}
+
+// Reads n_no_coor, stored after the references, of a lazily loaded index
+static void idx_load_no_coor(const hts_idx_t *cidx)
+{
+    hts_idx_t *idx = (hts_idx_t *) cidx;
+    idx_lazy_t *lazy = idx->lazy;
+
+    if (!lazy) return;
+
+    pthread_mutex_lock(&lazy->lock);
+    if (!lazy->no_coor_read) {
+        // As when loading in full, a missing value counts as zero
+        if (idx_lazy_seek(idx, idx->n) < 0
+            || bgzf_read(lazy->fp, &idx->n_no_coor, 8) != 8)
+            idx->n_no_coor = 0;
+        if (ed_is_big()) ed_swap_8p(&idx->n_no_coor);
+        lazy->no_coor_read = 1;
+    }
+    pthread_mutex_unlock(&lazy->lock);
+}
+
+// Reads all remaining references of a lazily loaded index
+static int idx_load_all(const hts_idx_t *idx)
+{
+    int i;
+    if (!idx->lazy) return 0;
+    for (i = 0; i < idx->n; i++)
+        if (idx_load_tid(idx, i) < 0) return -1;
+    idx_load_no_coor(idx);
+    return 0;
+}
+
+static hts_idx_t *idx_read(const char *fn, int flags)
+{
+    int lazy = (flags & HTS_IDX_LAZY) != 0;
     uint8_t magic[4];
     int i, is_be;
     hts_idx_t *idx = NULL;
@@ -2633,7 +3157,7 @@ static hts_idx_t *idx_read(const char *fn)
         idx->l_meta = x[2];
         idx->meta = meta;
         meta = NULL;
-        if (idx_read_core(idx, fp, HTS_FMT_CSI) < 0) goto fail;
+        if (idx_read_core(idx, fp, HTS_FMT_CSI, lazy) < 0) goto fail;
     }
     else if (memcmp(magic, "TBI\1", 4) == 0) {
         uint8_t x[8 * 4];
@@ -2654,7 +3178,7 @@ static hts_idx_t *idx_read(const char *fn)
         if (bgzf_read(fp, idx->meta + 28, n) != n) goto fail;
         // Prevent possible strlen past the end in tbx_index_load2
         idx->meta[idx->l_meta] = '\0';
-        if (idx_read_core(idx, fp, HTS_FMT_TBI) < 0) goto fail;
+        if (idx_read_core(idx, fp, HTS_FMT_TBI, lazy) < 0) goto fail;
     }
     else if (memcmp(magic, "BAI\1", 4) == 0) {
         uint32_t n;
@@ -2662,10 +3186,15 @@ static hts_idx_t *idx_read(const char *fn)
         if (is_be) ed_swap_4p(&n);
         if (n > INT32_MAX) goto fail;
         if ((idx = hts_idx_init(n, HTS_FMT_BAI, 0, 14, 5)) == NULL) goto fail;
-        if (idx_read_core(idx, fp, HTS_FMT_BAI) < 0) goto fail;
+        if (idx_read_core(idx, fp, HTS_FMT_BAI, lazy) < 0) goto fail;
     }
     else { errno = EINVAL; goto fail; }
 
+    if (idx->lazy) {
+        // Keep the file open for reading references on demand
+        idx->lazy->fp = fp;
+        return idx;
+    }
     bgzf_close(fp);
     return idx;
 
@@ -2716,8 +3245,9 @@ const char **hts_idx_seqnames(const hts_idx_t *idx, int *n, hts_id2name_f getid,
     const char **names = (const char**) calloc(idx->n,sizeof(const char*));
     for (i=0; i<idx->n; i++)
     {
+        // As when loaded in full, every reference of a lazy index counts
         bidx_t *bidx = idx->bidx[i];
-        if ( !bidx ) continue;
+        if ( !bidx && !idx->lazy ) continue;
         names[tid++] = getid(hdr,i);
     }
     *n = tid;
@@ -2737,6 +3267,7 @@ int hts_idx_get_stat(const hts_idx_t* idx, int tid, uint64_t* mapped, uint64_t*
         return -1;
     }
 
+    if (idx_load_tid(idx, tid) < 0) return -1;
     bidx_t *h = idx->bidx[tid];
     if (!h) return -1;
     khint_t k = kh_get(bin, h, META_BIN(idx));
@@ -2752,6 +3283,7 @@ int hts_idx_get_stat(const hts_idx_t* idx, int tid, uint64_t* mapped, uint64_t*
 
 uint64_t hts_idx_get_n_no_coor(const hts_idx_t* idx)
 {
+    idx_load_no_coor(idx);
     return idx->n_no_coor;
 }
 
@@ -2864,6 +3396,8 @@ uint64_t hts_itr_off(const hts_idx_t* idx, int tid) {
     bidx_t* bidx;
     uint64_t off0 = (uint64_t) -1;
     khint_t k;
+    // Both HTS_IDX_START and HTS_IDX_NOCOOR look at every reference
+    if (tid != HTS_IDX_REST && idx_load_all(idx) < 0) return off0;
     switch (tid) {
     case HTS_IDX_START:
         // Find the smallest offset, note that sequence ids may not be ordered sequentially
@@ -2948,7 +3482,8 @@ hts_itr_t *hts_itr_query(const hts_idx_t *idx, int tid, hts_pos_t beg, hts_pos_t
               free(iter);
               return NULL;
             }
-            if (tid >= idx->n || (bidx = idx->bidx[tid]) == NULL) {
+            if (tid >= idx->n || idx_load_tid(idx, tid) < 0
+                || (bidx = idx->bidx[tid]) == NULL) {
               free(iter);
               return NULL;
             }
@@ -3115,7 +3650,8 @@ int hts_itr_multi_bam(const hts_idx_t *idx, hts_itr_t *iter)
                 }
             }
         } else {
-            if (tid >= idx->n || (bidx = idx->bidx[tid]) == NULL || !kh_size(bidx))
+            if (tid >= idx->n || idx_load_tid(idx, tid) < 0
+                || (bidx = idx->bidx[tid]) == NULL || !kh_size(bidx))
                 continue;
 
             k = kh_get(bin, bidx, META_BIN(idx));
@@ -3729,6 +4265,22 @@ hts_itr_t *hts_itr_regions(const hts_idx_t *idx, hts_reglist_t *reglist, int cou
     return itr;
 }
 
+// Seek to the first chunk of iter, letting a multi-threaded reader fetch
+// and decompress the blocks of all the chunks ahead of time.
+static int itr_prefetch(BGZF *fp, hts_itr_t *iter)
+{
+    uint64_t *off = malloc(2 * iter->n_off * sizeof(*off));
+    int i, ret;
+    if (!off) return -1;
+    for (i = 0; i < iter->n_off; i++) {
+        off[2*i]   = iter->off[i].u;
+        off[2*i+1] = iter->off[i].v;
+    }
+    ret = bgzf_mt_prefetch(fp, iter->n_off, off);
+    free(off);
+    return ret;
+}
+
 int hts_itr_next(BGZF *fp, hts_itr_t *iter, void *r, void *data)
 {
     int ret, tid;
@@ -3756,7 +4308,15 @@ int hts_itr_next(BGZF *fp, hts_itr_t *iter, void *r, void *data)
     for (;;) {
         if (iter->curr_off == 0 || iter->curr_off >= iter->off[iter->i].v) { // then jump to the next chunk
             if (iter->i == iter->n_off - 1) { ret = -1; break; } // no more chunks
-            if (iter->i < 0 || iter->off[iter->i].v != iter->off[iter->i+1].u) { // not adjacent chunks; then seek
+            if (iter->i < 0 && fp->mt) { // hand the whole chunk list to the reader thread
+                if (itr_prefetch(fp, iter) < 0) {
+                    hts_log_error("Failed to seek to offset %"PRIu64"%s%s",
+                                  iter->off[0].u,
+                                  errno ? ": " : "", strerror(errno));
+                    return -2;
+                }
+                iter->curr_off = bgzf_tell(fp);
+            } else if (iter->i < 0 || iter->off[iter->i].v != iter->off[iter->i+1].u) { // not adjacent chunks; then seek
                 if (bgzf_seek(fp, iter->off[iter->i+1].u, SEEK_SET) < 0) {
                     hts_log_error("Failed to seek to offset %"PRIu64"%s%s",
                                   iter->off[iter->i+1].u,
@@ -4408,7 +4968,7 @@ static hts_idx_t *idx_find_and_load(const char *fn, int fmt, int flags)
     if (flags & HTS_IDX_SAVE_REMOTE)
         idx = hts_idx_load3(fn, fnidx, fmt, flags);
     else
-        idx = idx_read(fnidx);
+        idx = idx_read(fnidx, flags);
     free(fnidx);
     return idx;
 }
@@ -4452,7 +5012,7 @@ hts_idx_t *hts_idx_load3(const char *fn, const char *fnidx, int fmt, int flags)
         }
     }
 
-    hts_idx_t *idx = idx_read(fnidx);
+    hts_idx_t *idx = idx_read(fnidx, flags);
     if (!idx && !(flags & HTS_IDX_SILENT_FAIL))
         hts_log_error("Could not load local index file '%s'", fnidx);
 
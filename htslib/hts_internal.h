@@ -127,6 +127,55 @@ int bgzf_idx_push(BGZF *fp, hts_idx_t *hidx, int tid, hts_pos_t beg, hts_pos_t e
  */
 void bgzf_idx_amend_last(BGZF *fp, hts_idx_t *hidx, uint64_t offset);
 
+/*
+ * Format specific parts of hts_idx_build_parallel().  Each partition of
+ * the file gets its own state, made by init() and freed by destroy().
+ *
+ * sync() finds the first record starting in BGZF block @block, or failing
+ * that in a later block before @limit.  @prev_block is the address of the
+ * block before @block.  Returns the virtual offset of the record, -1 if
+ * none starts before @limit, or < -1 on error.  A wrong guess is detected
+ * and corrected by the caller, it only costs time.
+ *
+ * next() reads the record at the current position of @fp, returning 0
+ * and its location, 1 if it should not be indexed, -1 at EOF or < -1 on
+ * error.
+ *
+ * map_tid(), if set, converts a tid returned by next() for @state into
+ * the tid to use in the index, or returns < 0 on error.  It is called
+ * in file order.  push_error(), if set, reports a record at virtual
+ * offset @offset that hts_idx_push() refused.
+ */
+typedef struct hts_idx_build_ops {
+    void *(*init)(void *data);
+    void (*destroy)(void *state);
+    int64_t (*sync)(void *state, BGZF *fp, uint64_t prev_block,
+                    uint64_t block, uint64_t limit);
+    int (*next)(void *state, BGZF *fp, int *tid, hts_pos_t *beg,
+                hts_pos_t *end, int *is_mapped);
+    int (*map_tid)(void *data, void *state, int tid);
+    void (*push_error)(void *data, uint64_t offset);
+} hts_idx_build_ops;
+
+/*
+ * Index the records of BGZF file @fn from virtual offset @start onwards
+ * with @n_threads threads, pushing them to @idx in file order.  The
+ * index is identical to one built by a single thread.  On success
+ * *final_offset is set to the offset to pass to hts_idx_finish().
+ *
+ * Returns 0 on success,
+ *        -1 on failure, with errno set by the call that failed
+ */
+int hts_idx_build_parallel(hts_idx_t *idx, const char *fn, uint64_t start,
+                           int n_threads, const hts_idx_build_ops *ops,
+                           void *data, uint64_t *final_offset);
+
+/*
+ * Returns whether hts_idx_build_parallel() can be used on @fn, which must
+ * be a local regular file as it is opened once per partition.
+ */
+int hts_idx_build_parallel_ok(const char *fn);
+
 static inline int find_file_extension(const char *fn, char ext_out[static HTS_MAX_EXT_LEN])
 {
     const char *delim = fn ? strstr(fn, HTS_IDX_DELIM) : NULL, *ext;
@@ -275,6 +275,41 @@ typedef struct BGZF BGZF;
     HTSLIB_EXPORT
     void bgzf_set_cache_size(BGZF *fp, int size);
 
+    /**
+     * Set the size of the process-wide cache of decompressed blocks.
+     *
+     * The shared cache is used by every BGZF handle reading a local
+     * file, so several handles open on the same file (for example
+     * independent iterators) reuse each other's inflated blocks.
+     * Blocks are keyed by file identity and compressed offset and
+     * the least recently used blocks are evicted first.  The cache
+     * is safe to use from multiple threads.
+     *
+     * @param size  size of cache in bytes; 0 to disable and free the
+     *              cache (default)
+     * @return      0 on success, -1 on failure
+     */
+    HTSLIB_EXPORT
+    int bgzf_set_shared_cache_size(size_t size);
+
+    typedef struct {
+        uint64_t hits;      // blocks served from the cache
+        uint64_t misses;    // blocks that had to be inflated
+        uint64_t evictions; // blocks removed to stay within capacity
+        size_t nblocks;     // number of blocks currently cached
+        size_t size;        // bytes currently used
+        size_t capacity;    // maximum number of bytes
+    } bgzf_shared_cache_stats_t;
+
+    /**
+     * Report usage statistics of the process-wide block cache.
+     *
+     * @param stats  filled with the current counters
+     * @param reset  if non-zero, reset the hit/miss/eviction counters
+     */
+    HTSLIB_EXPORT
+    void bgzf_shared_cache_stats(bgzf_shared_cache_stats_t *stats, int reset);
+
     /**
      * Flush the file if the remaining buffer size is smaller than _size_
      * @return      0 if flushing succeeded or was not needed; negative on error
@@ -329,6 +364,25 @@ typedef struct BGZF BGZF;
     HTSLIB_EXPORT
     int bgzf_mt(BGZF *fp, int n_threads, int n_sub_blks);
 
+    /**
+     * Seek to the start of a list of chunks and restrict read-ahead to them.
+     *
+     * @param fp     BGZF file handler; must be opened for reading
+     * @param n      number of chunks
+     * @param off    2*n virtual offsets, as (start, end) pairs sorted by start
+     * @return       0 on success and -1 on error
+     *
+     * Behaves like bgzf_seek(fp, off[0], SEEK_SET).  In addition, when a
+     * thread pool is attached the reader thread fetches only the blocks
+     * overlapping the chunks, back to back, and hands them all to the
+     * pool for decompression.  Subsequent bgzf_seek() calls to the start
+     * of a later chunk consume the already queued blocks instead of
+     * draining the queue.  Reading past the last chunk, or seeking
+     * elsewhere, reverts to normal sequential read-ahead.
+     */
+    HTSLIB_EXPORT
+    int bgzf_mt_prefetch(BGZF *fp, int n, const uint64_t *off) HTS_RESULT_USED;
+
     /**
      * Compress a single BGZF block.
      *
@@ -329,6 +329,7 @@ enum hts_fmt_option {
     HTS_OPT_BLOCK_SIZE,
     HTS_OPT_FILTER,
     HTS_OPT_PROFILE,
+    HTS_OPT_MMAP,        // int: enum hts_access_pattern; local files only
 
     // Fastq
 
@@ -370,6 +371,15 @@ enum hts_profile_option {
     HTS_PROFILE_ARCHIVE,
 };
 
+// Access pattern hints for memory mapped input (HTS_OPT_MMAP or the
+// "mmap:" URL prefix).  Random suits index-driven region queries,
+// sequential suits streaming through the whole file.
+enum hts_access_pattern {
+    HTS_ACCESS_NORMAL,
+    HTS_ACCESS_SEQUENTIAL,
+    HTS_ACCESS_RANDOM,
+};
+
 // For backwards compatibility
 #define cram_option hts_fmt_option
 
@@ -869,10 +879,24 @@ hts_idx_t *hts_idx_init(int n, int fmt, uint64_t offset0, int min_shift, int n_l
 
 /// Free a BAI/CSI/TBI type index
 /** @param idx   Index structure to free
+
+If the index has been shared via hts_idx_share(), this only releases one
+owner's reference and the index is freed when the last owner destroys it.
  */
 HTSLIB_EXPORT
 void hts_idx_destroy(hts_idx_t *idx);
 
+/// Take an additional reference to a BAI/CSI/TBI type index
+/** @param idx   Index structure to share
+    @return idx on success; NULL if idx is NULL or a CRAM index
+
+Each successful call must be matched by a call to hts_idx_destroy().
+The index must not be modified while it is shared; it may be used by
+several iterators at once, including from different threads.
+ */
+HTSLIB_EXPORT
+hts_idx_t *hts_idx_share(hts_idx_t *idx);
+
 /// Push an index entry
 /** @param idx        Index
     @param tid        Target id
@@ -996,6 +1020,14 @@ hts_idx_t *hts_idx_load2(const char *fn, const char *fnidx);
 
         HTS_IDX_SAVE_REMOTE   Save a local copy of any remote indexes
         HTS_IDX_SILENT_FAIL   Fail silently if the index is not present
+        HTS_IDX_LAZY          Only read the index header when loading,
+                              and read the bins of a reference the first
+                              time it is queried.  Locating a reference
+                              steps over the data of the references
+                              before it, once.  The index file stays open
+                              until hts_idx_destroy().  Reading on demand
+                              is thread safe, so such an index may be
+                              shared between handles on the same file.
 
     The index struct returned by a successful call should be freed
     via hts_idx_destroy() when it is no longer needed.
@@ -1006,6 +1038,7 @@ hts_idx_t *hts_idx_load3(const char *fn, const char *fnidx, int fmt, int flags);
 /// Flags for hts_idx_load3() ( and also sam_idx_load3(), tbx_idx_load3() )
 #define HTS_IDX_SAVE_REMOTE 1
 #define HTS_IDX_SILENT_FAIL 2
+#define HTS_IDX_LAZY        4
 
 ///////////////////////////////////////////////////////////
 // Functions for accessing meta-data stored in indexes
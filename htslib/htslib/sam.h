@@ -1196,6 +1196,7 @@ The @p flags parameter can be set to a combination of the following values:
 
         HTS_IDX_SAVE_REMOTE   Save a local copy of any remote indexes
         HTS_IDX_SILENT_FAIL   Fail silently if the index is not present
+        HTS_IDX_LAZY          Read each reference's bins when first queried
 
 Note that HTS_IDX_SAVE_REMOTE has no effect for remote CRAM indexes.  They
 are always downloaded and never cached locally.
@@ -1233,6 +1234,10 @@ int sam_index_build2(const char *fn, const char *fnidx, int min_shift) HTS_RESUL
     @param nthreads  Number of threads to use when building the index
     @return  0 if successful, or negative if an error occurred (see
              sam_index_build for error codes)
+
+When @p nthreads is greater than one and @p fn is a local BAM file, the
+file is split into ranges of BGZF blocks which are read in parallel.
+The index is identical to one built by a single thread.
 */
 HTSLIB_EXPORT
 int sam_index_build3(const char *fn, const char *fnidx, int min_shift, int nthreads) HTS_RESULT_USED;
@@ -78,6 +78,9 @@ extern const tbx_conf_t tbx_conf_gff, tbx_conf_bed, tbx_conf_psltbl, tbx_conf_sa
     tbx_t *tbx_index(BGZF *fp, int min_shift, const tbx_conf_t *conf);
 /*
  * All tbx_index_build* methods return: 0 (success), -1 (general failure) or -2 (compression not BGZF)
+ *
+ * With n_threads > 1, a local file is split into ranges of BGZF blocks
+ * which are read in parallel, giving the same index as a single thread.
  */
     HTSLIB_EXPORT
     int tbx_index_build(const char *fn, int min_shift, const tbx_conf_t *conf);
@@ -122,6 +125,7 @@ extern const tbx_conf_t tbx_conf_gff, tbx_conf_bed, tbx_conf_psltbl, tbx_conf_sa
 
         HTS_IDX_SAVE_REMOTE   Save a local copy of any remote indexes
         HTS_IDX_SILENT_FAIL   Fail silently if the index is not present
+        HTS_IDX_LAZY          Read each reference's bins when first queried
 
     The index struct returned by a successful call should be freed
     via tbx_destroy() when it is no longer needed.
@@ -135,6 +139,18 @@ extern const tbx_conf_t tbx_conf_gff, tbx_conf_bed, tbx_conf_psltbl, tbx_conf_sa
     HTSLIB_EXPORT
     void tbx_destroy(tbx_t *tbx);
 
+/// Make a new tbx_t that shares the index data of an existing one
+/** @param tbx  Index to share
+    @return A new index struct, or NULL if an error occurred
+
+    The returned struct has its own copy of the configuration and sequence
+    name dictionary, but uses the same underlying hts_idx_t (see
+    hts_idx_share()).  Each struct should be freed via tbx_destroy(); the
+    index data is freed along with the last of them.
+*/
+    HTSLIB_EXPORT
+    tbx_t *tbx_share(tbx_t *tbx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -922,7 +922,174 @@ int bam_set_qname(bam1_t *rec, const char *qname)
  *** BAM indexing ***
  ********************/
 
-static hts_idx_t *sam_index(htsFile *fp, int min_shift)
+static void sam_index_push_error(sam_hdr_t *h, bam1_t *b)
+{
+    hts_log_error("Read '%s' with ref_name='%s', ref_length=%"PRIhts_pos", flags=%d, pos=%"PRIhts_pos" cannot be indexed", bam_get_qname(b), sam_hdr_tid2name(h, b->core.tid), sam_hdr_tid2len(h, b->core.tid), b->core.flag, b->core.pos+1);
+}
+
+/*
+ * Parallel BAM indexing, see hts_idx_build_parallel().
+ *
+ * A partition starts at the first offset in its first BGZF block from
+ * which a chain of plausible BAM records can be read.
+ */
+
+#define BAM_SYNC_WINDOW (4 * BGZF_MAX_BLOCK_SIZE)
+#define BAM_SYNC_RECORDS 8
+
+typedef struct {
+    htsFile *fp;
+    sam_hdr_t *h;
+} bam_idx_build_t;
+
+typedef struct {
+    sam_hdr_t *h;
+    bam1_t *b;
+    uint8_t *buf;
+} bam_idx_part_t;
+
+// Whether the n bytes at p look like the start of a BAM record, followed
+// by more of them.  at_eof is set if the data ends at EOF.
+static int bam_sync_check(const sam_hdr_t *h, const uint8_t *p, size_t n,
+                          int at_eof)
+{
+    int n_checked;
+    for (n_checked = 0; n_checked < BAM_SYNC_RECORDS; n_checked++) {
+        int32_t block_len, tid, mtid, l_qseq;
+        uint32_t l_qname, n_cigar, flag, i;
+        uint64_t min_len;
+
+        if (n < 36) return n_checked > 0 && (!at_eof || n == 0);
+        block_len = le_to_i32(p);
+        tid = le_to_i32(p + 4);
+        l_qname = p[12];
+        n_cigar = le_to_u16(p + 16);
+        flag = le_to_u16(p + 18);
+        l_qseq = le_to_i32(p + 20);
+        mtid = le_to_i32(p + 24);
+        if (block_len < 32 || tid < -1 || tid >= h->n_targets
+            || mtid < -1 || mtid >= h->n_targets
+            || le_to_i32(p + 8) < -1 || le_to_i32(p + 28) < -1
+            || l_qname < 2 || l_qseq < 0)
+            return 0;
+        min_len = 32 + l_qname + 4 * (uint64_t) n_cigar
+            + (((uint64_t) l_qseq + 1) >> 1) + l_qseq;
+        if (min_len > (uint64_t) block_len) return 0;
+
+        // read name, as far as it is in the buffer
+        for (i = 0; i < l_qname && 36 + i < n; i++) {
+            uint8_t c = p[36 + i];
+            if (i == l_qname - 1 ? c != '\0' : (c < '!' || c > '~'))
+                return 0;
+        }
+        // CIGAR, checked as by bam_read1()
+        if (n_cigar > 0 && 36 + l_qname + 4 * (uint64_t) n_cigar <= n) {
+            hts_pos_t qlen = 0;
+            for (i = 0; i < n_cigar; i++) {
+                uint32_t c = le_to_u32(p + 36 + l_qname + 4 * i);
+                if (bam_cigar_op(c) > BAM_CBACK) return 0;
+                if (bam_cigar_type(bam_cigar_op(c)) & 1)
+                    qlen += bam_cigar_oplen(c);
+            }
+            if (l_qseq > 0 && !(flag & BAM_FUNMAP) && qlen != l_qseq)
+                return 0;
+        }
+
+        if ((uint64_t) block_len + 4 > n) return !at_eof;
+        p += block_len + 4;
+        n -= block_len + 4;
+    }
+    return 1;
+}
+
+static void *bam_idx_part_init(void *data)
+{
+    bam_idx_build_t *d = (bam_idx_build_t *) data;
+    bam_idx_part_t *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->h = d->h;
+    if (!(s->b = bam_init1())) {
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static void bam_idx_part_destroy(void *state)
+{
+    bam_idx_part_t *s = (bam_idx_part_t *) state;
+    bam_destroy1(s->b);
+    free(s->buf);
+    free(s);
+}
+
+static int64_t bam_idx_part_sync(void *state, BGZF *fp, uint64_t prev_block,
+                                 uint64_t block, uint64_t limit)
+{
+    bam_idx_part_t *s = (bam_idx_part_t *) state;
+    if (!s->buf && !(s->buf = malloc(BAM_SYNC_WINDOW))) return -2;
+
+    while (block < limit) {
+        int64_t addr, next;
+        ssize_t n;
+        int len, i;
+        if (bgzf_seek(fp, block << 16, SEEK_SET) < 0
+            || bgzf_read_block(fp) < 0)
+            return -2;
+        if (fp->block_length == 0) return -1; // EOF
+        addr = fp->block_address;
+        len = fp->block_length;
+        next = htell(fp->fp);
+        if (addr >= limit) return -1;
+
+        n = bgzf_read(fp, s->buf, BAM_SYNC_WINDOW);
+        if (n < 0) return -2;
+        for (i = 0; i < len; i++) {
+            if (bam_sync_check(s->h, s->buf + i, n - i, n < BAM_SYNC_WINDOW))
+                return addr << 16 | i;
+        }
+        block = next;
+    }
+    return -1;
+}
+
+static int bam_idx_part_next(void *state, BGZF *fp, int *tid, hts_pos_t *beg,
+                             hts_pos_t *end, int *is_mapped)
+{
+    bam_idx_part_t *s = (bam_idx_part_t *) state;
+    bam1_t *b = s->b;
+    int ret = bam_read1(fp, b);
+    if (ret < 0) return ret;
+    if (b->core.tid  >= s->h->n_targets || b->core.tid  < -1 ||
+        b->core.mtid >= s->h->n_targets || b->core.mtid < -1) {
+        errno = ERANGE;
+        return -3;
+    }
+    *tid = b->core.tid;
+    *beg = b->core.pos;
+    *end = bam_endpos(b);
+    *is_mapped = !(b->core.flag&BAM_FUNMAP);
+    return 0;
+}
+
+static void bam_idx_push_error(void *data, uint64_t offset)
+{
+    bam_idx_build_t *d = (bam_idx_build_t *) data;
+    bam1_t *b = bam_init1();
+    if (b && bgzf_seek(d->fp->fp.bgzf, offset, SEEK_SET) == 0
+        && bam_read1(d->fp->fp.bgzf, b) >= 0)
+        sam_index_push_error(d->h, b);
+    bam_destroy1(b);
+}
+
+static const hts_idx_build_ops bam_idx_build_ops = {
+    bam_idx_part_init, bam_idx_part_destroy, bam_idx_part_sync,
+    bam_idx_part_next, NULL, bam_idx_push_error
+};
+
+// When fn is set, BAM data is read by nthreads threads, see above
+static hts_idx_t *sam_index(htsFile *fp, int min_shift, const char *fn,
+                            int nthreads)
 {
     int n_lvls, i, fmt, ret;
     bam1_t *b;
@@ -942,10 +1109,21 @@ static hts_idx_t *sam_index(htsFile *fp, int min_shift)
     } else min_shift = 14, n_lvls = 5, fmt = HTS_FMT_BAI;
     idx = hts_idx_init(h->n_targets, fmt, bgzf_tell(fp->fp.bgzf), min_shift, n_lvls);
     b = bam_init1();
+    if (fn) {
+        bam_idx_build_t d = { fp, h };
+        uint64_t final_offset;
+        if (hts_idx_build_parallel(idx, fn, bgzf_tell(fp->fp.bgzf), nthreads,
+                                   &bam_idx_build_ops, &d, &final_offset) < 0)
+            goto err;
+        hts_idx_finish(idx, final_offset);
+        sam_hdr_destroy(h);
+        bam_destroy1(b);
+        return idx;
+    }
     while ((ret = sam_read1(fp, h, b)) >= 0) {
         ret = hts_idx_push(idx, b->core.tid, b->core.pos, bam_endpos(b), bgzf_tell(fp->fp.bgzf), !(b->core.flag&BAM_FUNMAP));
         if (ret < 0) { // unsorted or doesn't fit
-            hts_log_error("Read '%s' with ref_name='%s', ref_length=%"PRIhts_pos", flags=%d, pos=%"PRIhts_pos" cannot be indexed", bam_get_qname(b), sam_hdr_tid2name(h, b->core.tid), sam_hdr_tid2len(h, b->core.tid), b->core.flag, b->core.pos+1);
+            sam_index_push_error(h, b);
             goto err;
         }
     }
@@ -966,10 +1144,15 @@ int sam_index_build3(const char *fn, const char *fnidx, int min_shift, int nthre
 {
     hts_idx_t *idx;
     htsFile *fp;
-    int ret = 0;
+    int ret = 0, save_errno;
+
+    int parallel;
 
     if ((fp = hts_open(fn, "r")) == 0) return -2;
-    if (nthreads)
+    // BAM files on disk are split between the threads instead
+    parallel = nthreads > 1 && fp->format.format == bam
+        && fp->format.compression == bgzf && hts_idx_build_parallel_ok(fn);
+    if (nthreads && !parallel)
         hts_set_threads(fp, nthreads);
 
     switch (fp->format.format) {
@@ -986,7 +1169,7 @@ int sam_index_build3(const char *fn, const char *fnidx, int min_shift, int nthre
             ret = -1;
             break;
         }
-        idx = sam_index(fp, min_shift);
+        idx = sam_index(fp, min_shift, parallel ? fn : NULL, nthreads);
         if (idx) {
             ret = hts_idx_save_as(idx, fn, fnidx, (min_shift > 0)? HTS_FMT_CSI : HTS_FMT_BAI);
             if (ret < 0) ret = -4;
@@ -999,7 +1182,10 @@ int sam_index_build3(const char *fn, const char *fnidx, int min_shift, int nthre
         ret = -3;
         break;
     }
+    // keep the errno of a failure for the caller to report
+    save_errno = errno;
     hts_close(fp);
+    if (ret < 0) errno = save_errno;
 
     return ret;
 }
@@ -285,7 +285,117 @@ static int adjust_n_lvls(int min_shift, int n_lvls, int64_t max_len)
     return n_lvls;
 }
 
-tbx_t *tbx_index(BGZF *fp, int min_shift, const tbx_conf_t *conf)
+/*
+ * Parallel indexing, see hts_idx_build_parallel().
+ *
+ * Each partition starts at the first line beginning in its first BGZF
+ * block and gets its own sequence dictionary.  Its tids are mapped to the
+ * global ones as the records are replayed in file order, so the names
+ * are numbered in order of first appearance as usual.
+ */
+
+typedef struct {
+    tbx_t *tbx;     // local dictionary
+    kstring_t str;
+    const char **names;
+    int *map;       // local to global tid, or -1
+    int n_names, m_names;
+} tbx_idx_part_t;
+
+static void *tbx_idx_part_init(void *data)
+{
+    tbx_t *tbx = (tbx_t *) data;
+    tbx_idx_part_t *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    if (!(s->tbx = calloc(1, sizeof(tbx_t)))) {
+        free(s);
+        return NULL;
+    }
+    s->tbx->conf = tbx->conf;
+    return s;
+}
+
+static void tbx_idx_part_destroy(void *state)
+{
+    tbx_idx_part_t *s = (tbx_idx_part_t *) state;
+    tbx_destroy(s->tbx);
+    free(s->str.s);
+    free(s->names);
+    free(s->map);
+    free(s);
+}
+
+static int64_t tbx_idx_part_sync(void *state, BGZF *fp, uint64_t prev_block,
+                                 uint64_t block, uint64_t limit)
+{
+    tbx_idx_part_t *s = (tbx_idx_part_t *) state;
+    int64_t off;
+
+    // If the previous block ends a line, the first one starts here
+    if (bgzf_seek(fp, prev_block << 16, SEEK_SET) < 0
+        || bgzf_read_block(fp) < 0)
+        return -2;
+    if (fp->block_length > 0
+        && ((char *) fp->uncompressed_block)[fp->block_length - 1] == '\n')
+        return block << 16;
+
+    if (bgzf_seek(fp, block << 16, SEEK_SET) < 0) return -2;
+    if (bgzf_getline(fp, '\n', &s->str) < -1) return -2;
+    off = bgzf_tell(fp);
+    return (off >> 16) < limit ? off : -1;
+}
+
+static int tbx_idx_part_next(void *state, BGZF *fp, int *tid, hts_pos_t *beg,
+                             hts_pos_t *end, int *is_mapped)
+{
+    tbx_idx_part_t *s = (tbx_idx_part_t *) state;
+    tbx_intv_t intv;
+    int ret = bgzf_getline(fp, '\n', &s->str);
+    if (ret < 0) return ret;
+    if (s->str.s[0] == s->tbx->conf.meta_char) return 1;
+    ret = get_intv(s->tbx, &s->str, &intv, 1);
+    if (ret < -1) return ret;  // Out of memory
+    if (ret < 0) return 1;     // Skip unparsable lines
+    if (intv.tid == s->n_names) {
+        khash_t(s2i) *d = (khash_t(s2i)*)s->tbx->dict;
+        khint_t k;
+        int c = *intv.se;
+        if (s->n_names == s->m_names) {
+            int new_m = s->m_names ? s->m_names * 2 : 16;
+            const char **new_names = realloc(s->names, new_m * sizeof(*new_names));
+            int *new_map;
+            if (!new_names) return -2;
+            s->names = new_names;
+            new_map = realloc(s->map, new_m * sizeof(*new_map));
+            if (!new_map) return -2;
+            s->map = new_map;
+            s->m_names = new_m;
+        }
+        *intv.se = '\0'; k = kh_get(s2i, d, intv.ss); *intv.se = c;
+        s->names[s->n_names] = kh_key(d, k);
+        s->map[s->n_names++] = -1;
+    }
+    *tid = intv.tid; *beg = intv.beg; *end = intv.end;
+    *is_mapped = 1;
+    return 0;
+}
+
+static int tbx_idx_map_tid(void *data, void *state, int tid)
+{
+    tbx_idx_part_t *s = (tbx_idx_part_t *) state;
+    if (s->map[tid] < 0)
+        s->map[tid] = get_tid((tbx_t *) data, s->names[tid], 1);
+    return s->map[tid];
+}
+
+static const hts_idx_build_ops tbx_idx_build_ops = {
+    tbx_idx_part_init, tbx_idx_part_destroy, tbx_idx_part_sync,
+    tbx_idx_part_next, tbx_idx_map_tid, NULL
+};
+
+// When fn is set, the records are read by n_threads threads, see above
+static tbx_t *tbx_index_core(BGZF *fp, int min_shift, const tbx_conf_t *conf,
+                             const char *fn, int n_threads)
 {
     tbx_t *tbx;
     kstring_t str;
@@ -323,6 +433,13 @@ tbx_t *tbx_index(BGZF *fp, int min_shift, const tbx_conf_t *conf)
             tbx->idx = hts_idx_init(0, fmt, last_off, min_shift, n_lvls);
             if (!tbx->idx) goto fail;
             first = 1;
+            if (fn) {
+                if (hts_idx_build_parallel(tbx->idx, fn, last_off, n_threads,
+                                           &tbx_idx_build_ops, tbx,
+                                           &last_off) < 0)
+                    goto fail;
+                break;
+            }
         }
         ret = get_intv(tbx, &str, &intv, 1);
         if (ret < -1) goto fail;  // Out of memory
@@ -337,7 +454,7 @@ tbx_t *tbx_index(BGZF *fp, int min_shift, const tbx_conf_t *conf)
     if (!tbx->idx) goto fail;
     if ( !tbx->dict ) tbx->dict = kh_init(s2i);
     if (!tbx->dict) goto fail;
-    if (hts_idx_finish(tbx->idx, bgzf_tell(fp)) != 0) goto fail;
+    if (hts_idx_finish(tbx->idx, fn && first ? last_off : bgzf_tell(fp)) != 0) goto fail;
     if (tbx_set_meta(tbx) != 0) goto fail;
     free(str.s);
     return tbx;
@@ -348,6 +465,11 @@ tbx_t *tbx_index(BGZF *fp, int min_shift, const tbx_conf_t *conf)
     return NULL;
 }
 
+tbx_t *tbx_index(BGZF *fp, int min_shift, const tbx_conf_t *conf)
+{
+    return tbx_index_core(fp, min_shift, conf, NULL, 0);
+}
+
 void tbx_destroy(tbx_t *tbx)
 {
     khash_t(s2i) *d = (khash_t(s2i)*)tbx->dict;
@@ -362,15 +484,52 @@ void tbx_destroy(tbx_t *tbx)
     free(tbx);
 }
 
+tbx_t *tbx_share(tbx_t *tbx)
+{
+    khash_t(s2i) *d = (khash_t(s2i)*)tbx->dict, *dup_d;
+    tbx_t *dup = (tbx_t*)calloc(1, sizeof(tbx_t));
+    if (!dup) return NULL;
+    dup->conf = tbx->conf;
+
+    if (d) {
+        khint_t k, k2;
+        int absent;
+        dup->dict = dup_d = kh_init(s2i);
+        if (!dup_d) goto fail;
+        if (kh_resize(s2i, dup_d, kh_size(d)) < 0) goto fail;
+        for (k = kh_begin(d); k != kh_end(d); ++k) {
+            if (!kh_exist(d, k)) continue;
+            char *name = strdup(kh_key(d, k));
+            if (!name) goto fail;
+            k2 = kh_put(s2i, dup_d, name, &absent);
+            if (absent < 0) {
+                free(name);
+                goto fail;
+            }
+            kh_val(dup_d, k2) = kh_val(d, k);
+        }
+    }
+
+    dup->idx = hts_idx_share(tbx->idx);
+    if (!dup->idx) goto fail;
+    return dup;
+
+ fail:
+    tbx_destroy(dup);
+    return NULL;
+}
+
 int tbx_index_build3(const char *fn, const char *fnidx, int min_shift, int n_threads, const tbx_conf_t *conf)
 {
     tbx_t *tbx;
     BGZF *fp;
-    int ret;
+    int ret, parallel;
     if ((fp = bgzf_open(fn, "r")) == 0) return -1;
-    if ( n_threads ) bgzf_mt(fp, n_threads, 256);
+    // Files on disk are split between the threads instead
+    parallel = n_threads > 1 && hts_idx_build_parallel_ok(fn);
+    if ( n_threads && !parallel ) bgzf_mt(fp, n_threads, 256);
     if ( bgzf_compression(fp) != bgzf ) { bgzf_close(fp); return -2; }
-    tbx = tbx_index(fp, min_shift, conf);
+    tbx = tbx_index_core(fp, min_shift, conf, parallel ? fn : NULL, n_threads);
     bgzf_close(fp);
     if ( !tbx ) return -1;
     ret = hts_idx_save_as(tbx->idx, fn, fnidx, min_shift > 0? HTS_FMT_CSI : HTS_FMT_TBI);
@@ -1,42 +1,44 @@
 #include <ctype.h>
+#include <errno.h>
 #include <assert.h>
 #include <unistd.h>
 #include <setjmp.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "@pysam@.pysam.h"
 
-FILE * @pysam@_stderr = NULL;
-FILE * @pysam@_stdout = NULL;
-const char * @pysam@_stdout_fn = NULL;
+__thread FILE * @pysam@_thread_stderr = NULL;
+__thread FILE * @pysam@_thread_stdout = NULL;
+__thread const char * @pysam@_stdout_fn = NULL;
 
 
 FILE * @pysam@_set_stderr(int fd)
 {
-  if (@pysam@_stderr != NULL)
-    fclose(@pysam@_stderr);
-  @pysam@_stderr = fdopen(fd, "w");
-  return @pysam@_stderr;
+  if (@pysam@_thread_stderr != NULL)
+    fclose(@pysam@_thread_stderr);
+  @pysam@_thread_stderr = fdopen(fd, "w");
+  return @pysam@_thread_stderr;
 }
 
 void @pysam@_close_stderr(void)
 {
-  fclose(@pysam@_stderr);
-  @pysam@_stderr = NULL;
+  fclose(@pysam@_thread_stderr);
+  @pysam@_thread_stderr = NULL;
 }
 
 FILE * @pysam@_set_stdout(int fd)
 {
-  if (@pysam@_stdout != NULL)
-    fclose(@pysam@_stdout);
-  @pysam@_stdout = fdopen(fd, "w");
-  if (@pysam@_stdout == NULL)
+  if (@pysam@_thread_stdout != NULL)
+    fclose(@pysam@_thread_stdout);
+  @pysam@_thread_stdout = fdopen(fd, "w");
+  if (@pysam@_thread_stdout == NULL)
     {
       fprintf(@pysam@_stderr, "could not set stdout to fd %i", fd);
     }
-  return @pysam@_stdout;
+  return @pysam@_thread_stdout;
 }
 
 void @pysam@_set_stdout_fn(const char *fn)
@@ -46,8 +48,8 @@ void @pysam@_set_stdout_fn(const char *fn)
 
 void @pysam@_close_stdout(void)
 {
-  fclose(@pysam@_stdout);
-  @pysam@_stdout = NULL;
+  fclose(@pysam@_thread_stdout);
+  @pysam@_thread_stdout = NULL;
 }
 
 int @pysam@_puts(const char *s)
@@ -57,8 +59,8 @@ int @pysam@_puts(const char *s)
 }
 
 
-static jmp_buf @pysam@_jmpbuf;
-static int @pysam@_status = 0;
+static __thread jmp_buf @pysam@_jmpbuf;
+static __thread int @pysam@_status = 0;
 
 int @pysam@_dispatch(int argc, char *argv[])
 {
@@ -74,16 +76,231 @@ void @pysam@_exit(int status)
   longjmp(@pysam@_jmpbuf, 1);
 }
 
+typedef struct {
+  void *(*start_routine)(void *);
+  void *arg;
+  FILE *err, *out;
+} @pysam@_thread_t;
+
+static void *@pysam@_thread_start(void *data)
+{
+  @pysam@_thread_t t = *(@pysam@_thread_t *)data;
+  free(data);
+  @pysam@_thread_stderr = t.err;
+  @pysam@_thread_stdout = t.out;
+  return t.start_routine(t.arg);
+}
+
+int @pysam@_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                           void *(*start_routine)(void *), void *arg)
+{
+  int ret;
+  @pysam@_thread_t *t = malloc(sizeof(@pysam@_thread_t));
+  if (t == NULL)
+    return EAGAIN;
+  t->start_routine = start_routine;
+  t->arg = arg;
+  t->err = @pysam@_thread_stderr;
+  t->out = @pysam@_thread_stdout;
+  if ((ret = pthread_create(thread, attr, @pysam@_thread_start, t)) != 0)
+    free(t);
+  return ret;
+}
+
+
+/* getopt and getopt_long with their state kept per thread.
+
+   Like the GNU versions, non-option arguments are moved behind the
+   options unless the option string starts with '+' or '-'.  Based on
+   the implementation in musl libc. */
+
+__thread char * @pysam@_optarg = NULL;
+__thread int @pysam@_optind = 1, @pysam@_opterr = 1, @pysam@_optopt = 0;
+
+// position within a group of short options such as -abc
+static __thread int @pysam@_optpos = 0;
 
 void @pysam@_set_optind(int val)
 {
-  // setting this in cython via 
-  // "from posix.unistd cimport optind"
-  // did not work.
-  //
   // setting to 0 forces a complete re-initialization
-  optind = val;
+  @pysam@_optind = val;
+  @pysam@_optpos = 0;
 }
 
+static void @pysam@_getopt_msg(const char *cmd, const char *msg,
+                                const char *opt, size_t l)
+{
+  fprintf(@pysam@_stderr, "%s%s%.*s\n", cmd, msg, (int)l, opt);
+}
+
+static int @pysam@_getopt_short(int argc, char * const argv[], const char *optstring)
+{
+  int i;
+  char c, *optchar;
+
+  if (@pysam@_optind >= argc || !argv[@pysam@_optind])
+    return -1;
+
+  if (argv[@pysam@_optind][0] != '-') {
+    if (optstring[0] == '-') {
+      @pysam@_optarg = argv[@pysam@_optind++];
+      return 1;
+    }
+    return -1;
+  }
+
+  if (!argv[@pysam@_optind][1])
+    return -1;
+
+  if (argv[@pysam@_optind][1] == '-' && !argv[@pysam@_optind][2])
+    return @pysam@_optind++, -1;
+
+  if (!@pysam@_optpos) @pysam@_optpos++;
+  optchar = argv[@pysam@_optind] + @pysam@_optpos;
+  c = *optchar;
+  @pysam@_optpos++;
 
+  if (!argv[@pysam@_optind][@pysam@_optpos]) {
+    @pysam@_optind++;
+    @pysam@_optpos = 0;
+  }
 
+  if (optstring[0] == '-' || optstring[0] == '+')
+    optstring++;
+
+  for (i = 0; optstring[i] && optstring[i] != c; i++)
+    ;
+
+  if (optstring[i] != c || c == ':') {
+    @pysam@_optopt = c;
+    if (optstring[0] != ':' && @pysam@_opterr)
+      @pysam@_getopt_msg(argv[0], ": unrecognized option: ", optchar, 1);
+    return '?';
+  }
+  if (optstring[i+1] == ':') {
+    @pysam@_optarg = NULL;
+    if (optstring[i+2] != ':' || @pysam@_optpos) {
+      @pysam@_optarg = argv[@pysam@_optind++] + @pysam@_optpos;
+      @pysam@_optpos = 0;
+    }
+    if (@pysam@_optind > argc) {
+      @pysam@_optopt = c;
+      if (optstring[0] == ':') return ':';
+      if (@pysam@_opterr)
+        @pysam@_getopt_msg(argv[0], ": option requires an argument: ", optchar, 1);
+      return '?';
+    }
+  }
+  return c;
+}
+
+static int @pysam@_getopt_long_core(int argc, char * const argv[], const char *optstring,
+                                     const struct option *longopts, int *idx)
+{
+  @pysam@_optarg = NULL;
+  if (longopts && argv[@pysam@_optind][0] == '-' &&
+      argv[@pysam@_optind][1] == '-' && argv[@pysam@_optind][2]) {
+    int colon = optstring[optstring[0] == '+' || optstring[0] == '-'] == ':';
+    int i, cnt, match = 0;
+    char *arg = NULL, *opt, *start = argv[@pysam@_optind] + 2;
+    for (cnt = i = 0; longopts[i].name; i++) {
+      const char *name = longopts[i].name;
+      opt = start;
+      while (*opt && *opt != '=' && *opt == *name)
+        name++, opt++;
+      if (*opt && *opt != '=') continue;
+      arg = opt;
+      match = i;
+      if (!*name) {
+        // exact match
+        cnt = 1;
+        break;
+      }
+      cnt++;
+    }
+    if (cnt == 1) {
+      i = match;
+      opt = arg;
+      @pysam@_optind++;
+      if (*opt == '=') {
+        if (!longopts[i].has_arg) {
+          @pysam@_optopt = longopts[i].val;
+          if (colon || !@pysam@_opterr)
+            return '?';
+          @pysam@_getopt_msg(argv[0], ": option does not take an argument: ",
+                             longopts[i].name, strlen(longopts[i].name));
+          return '?';
+        }
+        @pysam@_optarg = opt + 1;
+      } else if (longopts[i].has_arg == required_argument) {
+        if (!(@pysam@_optarg = argv[@pysam@_optind])) {
+          @pysam@_optopt = longopts[i].val;
+          if (colon) return ':';
+          if (!@pysam@_opterr) return '?';
+          @pysam@_getopt_msg(argv[0], ": option requires an argument: ",
+                             longopts[i].name, strlen(longopts[i].name));
+          return '?';
+        }
+        @pysam@_optind++;
+      }
+      if (idx) *idx = i;
+      if (longopts[i].flag) {
+        *longopts[i].flag = longopts[i].val;
+        return 0;
+      }
+      return longopts[i].val;
+    }
+    @pysam@_optopt = 0;
+    if (!colon && @pysam@_opterr)
+      @pysam@_getopt_msg(argv[0], cnt ? ": option is ambiguous: " : ": unrecognized option: ",
+                         start, strlen(start));
+    @pysam@_optind++;
+    return '?';
+  }
+  return @pysam@_getopt_short(argc, argv, optstring);
+}
+
+static void @pysam@_permute(char * const argv[], int dest, int src)
+{
+  char **av = (char **)argv;
+  char *tmp = av[src];
+  int i;
+  for (i = src; i > dest; i--)
+    av[i] = av[i-1];
+  av[dest] = tmp;
+}
+
+int @pysam@_getopt_long(int argc, char * const argv[], const char *optstring,
+                        const struct option *longopts, int *idx)
+{
+  int ret, skipped, resumed;
+  if (!@pysam@_optind) {
+    @pysam@_optpos = 0;
+    @pysam@_optind = 1;
+  }
+  if (@pysam@_optind >= argc || !argv[@pysam@_optind]) return -1;
+  skipped = @pysam@_optind;
+  if (optstring[0] != '+' && optstring[0] != '-') {
+    int i;
+    for (i = @pysam@_optind; ; i++) {
+      if (i >= argc || !argv[i]) return -1;
+      if (argv[i][0] == '-' && argv[i][1]) break;
+    }
+    @pysam@_optind = i;
+  }
+  resumed = @pysam@_optind;
+  ret = @pysam@_getopt_long_core(argc, argv, optstring, longopts, idx);
+  if (resumed > skipped) {
+    // move the options just read in front of the skipped arguments
+    int i, cnt = @pysam@_optind - resumed;
+    for (i = 0; i < cnt; i++)
+      @pysam@_permute(argv, skipped, @pysam@_optind - 1);
+    @pysam@_optind = skipped + cnt;
+  }
+  return ret;
+}
+
+int @pysam@_getopt(int argc, char * const argv[], const char *optstring)
+{
+  return @pysam@_getopt_long(argc, argv, optstring, NULL, NULL);
+}
@@ -2,12 +2,24 @@
 #define @pysam@_PYSAM_H
 
 #include <stdio.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
 
-extern FILE * @pysam@_stderr;
+/* The state of a command is kept per thread, so that commands can
+   run concurrently in different threads.  Threads not started by a
+   command, such as those of an htslib thread pool, have no streams
+   of their own and write to the process stderr and stdout. */
 
-extern FILE * @pysam@_stdout;
+extern __thread FILE * @pysam@_thread_stderr;
 
-extern const char * @pysam@_stdout_fn;
+extern __thread FILE * @pysam@_thread_stdout;
+
+#define @pysam@_stderr (@pysam@_thread_stderr ? @pysam@_thread_stderr : stderr)
+
+#define @pysam@_stdout (@pysam@_thread_stdout ? @pysam@_thread_stdout : stdout)
+
+extern __thread const char * @pysam@_stdout_fn;
 
 /*! set pysam standard error to point to file descriptor
 
@@ -42,8 +54,26 @@ int @pysam@_dispatch(int argc, char *argv[]);
 
 void @pysam@_exit(int status);
 
+/*! start a thread sharing the standard output and error of the
+  calling command.  The thread must return errors to the command
+  joining it, it cannot call exit().
+ */
+int @pysam@_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                           void *(*start_routine)(void *), void *arg);
+
 void @pysam@_set_optind(int);
 
 extern int @pysam@_main(int argc, char *argv[]);
-  
+
+/* getopt keeps its state in globals, so commands call a copy
+   keeping it per thread instead. */
+
+extern __thread char * @pysam@_optarg;
+extern __thread int @pysam@_optind, @pysam@_opterr, @pysam@_optopt;
+
+int @pysam@_getopt(int argc, char * const argv[], const char *optstring);
+
+int @pysam@_getopt_long(int argc, char * const argv[], const char *optstring,
+                        const struct option *longopts, int *longindex);
+
 #endif
@@ -29,6 +29,7 @@ from pysam.utils import SamtoolsError
 import pysam.Pileup as Pileup
 from pysam.samtools import *
 import pysam.config
+import pysam.parallel
 
 
 # export all the symbols from separate modules
@@ -4,10 +4,15 @@
 #include "htslib/ksort.h"
 #include "htslib/sam.h"
 #include "htslib/hts.h"
+#include "htslib/bgzf.h"
 #include "htslib/knetfile.h"
-#include "htslib/kseq.h"
+#include "htslib/kstring.h"
 #include "htslib_util.h"
+#include "pysam_stream.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
 
 #ifndef inline
 #define inline __inline
@@ -157,3 +162,585 @@ int aux_type2size(uint8_t type)
 		return 0;
 	}
 }
+
+
+//////////////////////////////////////////////////////////////////
+// Background reading of records
+//
+// A reader thread fills a ring of size+1 slots, one of which may be
+// held by the caller.  Records are reused once the caller moves on.
+
+typedef struct {
+  void *rec;
+  int64_t offset;   // where the record was read from, or -1
+  int ret;          // result of reading it
+} prefetch_slot_t;
+
+struct pysam_prefetch_t {
+  int type, max_unpack;
+  htsFile *fp;
+  void *hdr;
+  hts_itr_t *itr;
+  tbx_t *tbx;
+  int track_offset;
+
+  prefetch_slot_t *slots;
+  int n_slots;
+  int head;         // next slot to read into
+  int tail;         // next slot to hand out
+  int n_ready;
+  // The caller claims all ready slots at once and steps through them
+  // without the lock, the reader only sees how many it holds
+  int n_held;
+  int current;      // slot returned last, or -1
+  int n_claimed;    // slots from current onwards not yet released
+  int status, err;  // result of the read that stopped the reader
+  int done, stop;
+  // Waiting sides are only woken once a batch of slots can be used, so
+  // that the threads do not hand over the lock for every record
+  int batch;
+  int reader_waiting, caller_waiting;
+
+  pthread_mutex_t lock;
+  pthread_cond_t ready_cv, free_cv;
+  pthread_t thread;
+};
+
+static void *prefetch_rec_init(pysam_prefetch_t *p)
+{
+  bcf1_t *v;
+  switch (p->type) {
+  case PYSAM_PREFETCH_SAM:
+    return bam_init1();
+  case PYSAM_PREFETCH_BCF:
+    if ((v = bcf_init1()) != NULL) {
+      v->pos = -1;
+      if (p->max_unpack)
+        v->max_unpack = p->max_unpack;
+    }
+    return v;
+  default:
+    return calloc(1, sizeof(kstring_t));
+  }
+}
+
+static void prefetch_rec_destroy(pysam_prefetch_t *p, void *rec)
+{
+  if (rec == NULL)
+    return;
+  switch (p->type) {
+  case PYSAM_PREFETCH_SAM:
+    bam_destroy1((bam1_t *)rec);
+    break;
+  case PYSAM_PREFETCH_BCF:
+    bcf_destroy1((bcf1_t *)rec);
+    break;
+  default:
+    free(((kstring_t *)rec)->s);
+    free(rec);
+  }
+}
+
+static int prefetch_read(pysam_prefetch_t *p, void *rec)
+{
+  switch (p->type) {
+  case PYSAM_PREFETCH_SAM:
+    return p->itr ? sam_itr_next(p->fp, p->itr, (bam1_t *)rec)
+      : sam_read1(p->fp, (sam_hdr_t *)p->hdr, (bam1_t *)rec);
+  case PYSAM_PREFETCH_BCF:
+    return p->itr ? bcf_itr_next(p->fp, p->itr, (bcf1_t *)rec)
+      : bcf_read1(p->fp, (bcf_hdr_t *)p->hdr, (bcf1_t *)rec);
+  default:
+    return p->itr ? tbx_itr_next(p->fp, p->tbx, p->itr, (kstring_t *)rec)
+      : hts_getline(p->fp, KS_SEP_LINE, (kstring_t *)rec);
+  }
+}
+
+static void *prefetch_worker(void *arg)
+{
+  pysam_prefetch_t *p = (pysam_prefetch_t *)arg;
+  prefetch_slot_t *slot;
+  int ret;
+
+  pthread_mutex_lock(&p->lock);
+  for (;;) {
+    while (!p->stop && p->n_ready + p->n_held >= p->n_slots) {
+      p->reader_waiting = 1;
+      pthread_cond_wait(&p->free_cv, &p->lock);
+      p->reader_waiting = 0;
+    }
+    if (p->stop)
+      break;
+    slot = &p->slots[p->head];
+    pthread_mutex_unlock(&p->lock);
+
+    slot->offset = p->track_offset ? bgzf_tell(hts_get_bgzfp(p->fp)) : -1;
+    errno = 0;
+    ret = prefetch_read(p, slot->rec);
+
+    pthread_mutex_lock(&p->lock);
+    // A failed read is handed out too, its record may say why
+    slot->ret = ret;
+    p->head = (p->head + 1) % p->n_slots;
+    p->n_ready++;
+    if (p->caller_waiting && (p->n_ready >= p->batch || ret < 0))
+      pthread_cond_signal(&p->ready_cv);
+    if (ret < 0) {
+      p->status = ret;
+      p->err = errno;
+      p->done = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+pysam_prefetch_t *pysam_prefetch_init(int type, int size, htsFile *fp,
+                                      void *hdr, hts_itr_t *itr, tbx_t *tbx,
+                                      int max_unpack)
+{
+  pysam_prefetch_t *p;
+  int i;
+
+  if (size < 1)
+    size = 1;
+  p = (pysam_prefetch_t *)calloc(1, sizeof(pysam_prefetch_t));
+  if (p == NULL)
+    return NULL;
+  p->type = type;
+  p->max_unpack = max_unpack;
+  p->fp = fp;
+  p->hdr = hdr;
+  p->itr = itr;
+  p->tbx = tbx;
+  p->current = -1;
+  // Reading the whole file can be resumed at the first record not
+  // handed out, see pysam_prefetch_destroy()
+  p->track_offset = itr == NULL && fp->format.compression == bgzf
+    && fp->format.format != sam;
+
+  p->n_slots = size + 1;
+  p->batch = (size + 1) / 2;
+  p->slots = (prefetch_slot_t *)calloc(p->n_slots, sizeof(prefetch_slot_t));
+  if (p->slots == NULL)
+    goto fail;
+  for (i = 0; i < p->n_slots; i++)
+    if ((p->slots[i].rec = prefetch_rec_init(p)) == NULL)
+      goto fail;
+
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->ready_cv, NULL);
+  pthread_cond_init(&p->free_cv, NULL);
+  if (pthread_create(&p->thread, NULL, prefetch_worker, p) != 0) {
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->ready_cv);
+    pthread_cond_destroy(&p->free_cv);
+    goto fail;
+  }
+  return p;
+
+ fail:
+  if (p->slots) {
+    for (i = 0; i < p->n_slots; i++)
+      prefetch_rec_destroy(p, p->slots[i].rec);
+    free(p->slots);
+  }
+  free(p);
+  return NULL;
+}
+
+int pysam_prefetch_next(pysam_prefetch_t *p, void **rec)
+{
+  int ret;
+
+  if (p->n_claimed > 1) {
+    p->current = (p->current + 1) % p->n_slots;
+    p->n_claimed--;
+  } else {
+    pthread_mutex_lock(&p->lock);
+    p->n_held = p->n_claimed = 0;
+    p->current = -1;
+    if (p->reader_waiting && p->n_slots - p->n_ready >= p->batch)
+      pthread_cond_signal(&p->free_cv);
+    while (p->n_ready == 0 && !p->done) {
+      p->caller_waiting = 1;
+      pthread_cond_wait(&p->ready_cv, &p->lock);
+      p->caller_waiting = 0;
+    }
+    if (p->n_ready == 0) {
+      *rec = NULL;
+      ret = p->status;
+      errno = p->err;
+      pthread_mutex_unlock(&p->lock);
+      return ret;
+    }
+    p->current = p->tail;
+    p->n_held = p->n_claimed = p->n_ready;
+    p->tail = (p->tail + p->n_ready) % p->n_slots;
+    p->n_ready = 0;
+    pthread_mutex_unlock(&p->lock);
+  }
+
+  *rec = p->slots[p->current].rec;
+  ret = p->slots[p->current].ret;
+  // Only the last record read can have failed, by then the reader has
+  // stored its errno and stopped
+  if (ret < 0)
+    errno = p->err;
+  return ret;
+}
+
+void *pysam_prefetch_take(pysam_prefetch_t *p)
+{
+  prefetch_slot_t *slot;
+  void *rec, *fresh;
+
+  if (p->current < 0)
+    return NULL;
+  if ((fresh = prefetch_rec_init(p)) == NULL)
+    return NULL;
+  // The reader does not touch the slot held by the caller
+  slot = &p->slots[p->current];
+  rec = slot->rec;
+  slot->rec = fresh;
+  return rec;
+}
+
+int pysam_prefetch_destroy(pysam_prefetch_t *p)
+{
+  int i, ret = 0;
+
+  if (p == NULL)
+    return 0;
+  pthread_mutex_lock(&p->lock);
+  p->stop = 1;
+  pthread_cond_signal(&p->free_cv);
+  pthread_mutex_unlock(&p->lock);
+  pthread_join(p->thread, NULL);
+
+  // Go back to the first record read ahead but not handed out.  Only
+  // the last slot read can hold a failed read, such as the end of file,
+  // which loses nothing.
+  if (p->n_claimed > 1 || p->n_ready > 0) {
+    i = p->n_claimed > 1 ? (p->current + 1) % p->n_slots : p->tail;
+    if (p->track_offset)
+      ret = bgzf_seek(hts_get_bgzfp(p->fp), p->slots[i].offset, SEEK_SET) < 0 ? -1 : 0;
+    else if (p->slots[i].ret >= 0)
+      ret = -2;
+  }
+
+  for (i = 0; i < p->n_slots; i++)
+    prefetch_rec_destroy(p, p->slots[i].rec);
+  free(p->slots);
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->ready_cv);
+  pthread_cond_destroy(&p->free_cv);
+  free(p);
+  return ret;
+}
+
+
+//-------------------------------------------------------
+// Splice junction counting
+
+typedef struct {
+  int64_t start, end;
+  int32_t tid, strand;
+} junction_key_t;
+
+static inline khint_t junction_hash(junction_key_t k)
+{
+  uint64_t h = (uint64_t)k.start * 0x9E3779B97F4A7C15ULL;
+  h ^= (uint64_t)k.end * 0xC2B2AE3D27D4EB4FULL;
+  h ^= (uint64_t)(uint32_t)k.tid << 2 | (uint32_t)(k.strand + 1);
+  return (khint_t)(h ^ (h >> 32));
+}
+
+#define junction_equal(a, b) ((a).start == (b).start && (a).end == (b).end \
+                              && (a).tid == (b).tid && (a).strand == (b).strand)
+
+typedef struct {
+  uint64_t unique, multi;
+} junction_count_t;
+
+KHASH_INIT(junction, junction_key_t, junction_count_t, 1,
+           junction_hash, junction_equal)
+
+struct pysam_junctions_t {
+  khash_t(junction) *h;
+};
+
+pysam_junctions_t *pysam_junctions_init(void)
+{
+  pysam_junctions_t *j = (pysam_junctions_t *)calloc(1, sizeof(pysam_junctions_t));
+  if (j == NULL)
+    return NULL;
+  if ((j->h = kh_init(junction)) == NULL) {
+    free(j);
+    return NULL;
+  }
+  return j;
+}
+
+// Strand of the transcript from XS (genome strand) or ts (read strand)
+static int junction_strand(const bam1_t *b)
+{
+  uint8_t *s = bam_aux_get(b, "XS");
+  if (s && *s == 'A') {
+    if (s[1] == '+') return 1;
+    if (s[1] == '-') return -1;
+  }
+  s = bam_aux_get(b, "ts");
+  if (s && *s == 'A') {
+    if (s[1] == '+') return bam_is_rev(b) ? -1 : 1;
+    if (s[1] == '-') return bam_is_rev(b) ? 1 : -1;
+  }
+  return 0;
+}
+
+int pysam_junctions_add(pysam_junctions_t *j, const bam1_t *b)
+{
+  const uint32_t *cigar = bam_get_cigar(b);
+  junction_key_t key;
+  uint8_t *nh;
+  int64_t pos = b->core.pos;
+  int i, ret, strand = 2, multi = -1;
+  khint_t k;
+
+  for (i = 0; i < b->core.n_cigar; i++) {
+    int op = bam_cigar_op(cigar[i]);
+    int64_t len = bam_cigar_oplen(cigar[i]);
+    if (op == BAM_CREF_SKIP) {
+      // tags are only looked up for spliced reads
+      if (strand == 2) {
+        strand = junction_strand(b);
+        nh = bam_aux_get(b, "NH");
+        multi = (b->core.flag & BAM_FSECONDARY) || (nh && bam_aux2i(nh) > 1);
+      }
+      key.start = pos;
+      key.end = pos + len;
+      key.tid = b->core.tid;
+      key.strand = strand;
+      k = kh_put(junction, j->h, key, &ret);
+      if (ret < 0)
+        return -1;
+      if (ret > 0)
+        kh_val(j->h, k).unique = kh_val(j->h, k).multi = 0;
+      if (multi)
+        kh_val(j->h, k).multi++;
+      else
+        kh_val(j->h, k).unique++;
+    }
+    if (bam_cigar_type(op) & 2)
+      pos += len;
+  }
+  return 0;
+}
+
+size_t pysam_junctions_size(const pysam_junctions_t *j)
+{
+  return kh_size(j->h);
+}
+
+static int junction_cmp(const void *pa, const void *pb)
+{
+  const junction_key_t *a = (const junction_key_t *)pa;
+  const junction_key_t *b = (const junction_key_t *)pb;
+  if (a->tid != b->tid) return a->tid < b->tid ? -1 : 1;
+  if (a->start != b->start) return a->start < b->start ? -1 : 1;
+  if (a->end != b->end) return a->end < b->end ? -1 : 1;
+  return a->strand < b->strand ? -1 : a->strand > b->strand;
+}
+
+int pysam_junctions_export(const pysam_junctions_t *j, int32_t *tid,
+                           int64_t *start, int64_t *end, int8_t *strand,
+                           uint64_t *unique, uint64_t *multi)
+{
+  size_t i, n = 0;
+  junction_key_t *keys;
+  khint_t k;
+
+  if (kh_size(j->h) == 0)
+    return 0;
+  keys = (junction_key_t *)malloc(kh_size(j->h) * sizeof(junction_key_t));
+  if (keys == NULL)
+    return -1;
+  for (k = kh_begin(j->h); k != kh_end(j->h); k++)
+    if (kh_exist(j->h, k))
+      keys[n++] = kh_key(j->h, k);
+  qsort(keys, n, sizeof(junction_key_t), junction_cmp);
+
+  for (i = 0; i < n; i++) {
+    k = kh_get(junction, j->h, keys[i]);
+    tid[i] = keys[i].tid;
+    start[i] = keys[i].start;
+    end[i] = keys[i].end;
+    strand[i] = (int8_t)keys[i].strand;
+    unique[i] = kh_val(j->h, k).unique;
+    multi[i] = kh_val(j->h, k).multi;
+  }
+  free(keys);
+  return 0;
+}
+
+void pysam_junctions_destroy(pysam_junctions_t *j)
+{
+  if (j == NULL)
+    return;
+  kh_destroy(junction, j->h);
+  free(j);
+}
+
+
+//-------------------------------------------------------
+// Buffer of reads waiting for their mate
+
+KHASH_MAP_INIT_STR(pairbuf, bam1_t *)
+
+struct pysam_pairbuf_t {
+  khash_t(pairbuf) *h;
+};
+
+pysam_pairbuf_t *pysam_pairbuf_init(void)
+{
+  pysam_pairbuf_t *buf = (pysam_pairbuf_t *)calloc(1, sizeof(pysam_pairbuf_t));
+  if (buf == NULL)
+    return NULL;
+  if ((buf->h = kh_init(pairbuf)) == NULL) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+bam1_t *pysam_pairbuf_match(pysam_pairbuf_t *buf, const bam1_t *b,
+                            int store, int *err)
+{
+  bam1_t *mate, *copy;
+  khint_t k;
+  int ret;
+
+  *err = 0;
+  k = kh_get(pairbuf, buf->h, bam_get_qname(b));
+  if (k != kh_end(buf->h)) {
+    mate = kh_val(buf->h, k);
+    kh_del(pairbuf, buf->h, k);
+    return mate;
+  }
+  if (!store)
+    return NULL;
+
+  // The key is the name within the copy, which lives as long as it
+  if ((copy = bam_dup1(b)) == NULL) {
+    *err = -1;
+    return NULL;
+  }
+  k = kh_put(pairbuf, buf->h, bam_get_qname(copy), &ret);
+  if (ret < 0) {
+    bam_destroy1(copy);
+    *err = -1;
+    return NULL;
+  }
+  kh_val(buf->h, k) = copy;
+  return NULL;
+}
+
+size_t pysam_pairbuf_size(const pysam_pairbuf_t *buf)
+{
+  return kh_size(buf->h);
+}
+
+void pysam_pairbuf_destroy(pysam_pairbuf_t *buf)
+{
+  khint_t k;
+  if (buf == NULL)
+    return;
+  for (k = kh_begin(buf->h); k != kh_end(buf->h); k++)
+    if (kh_exist(buf->h, k))
+      bam_destroy1(kh_val(buf->h, k));
+  kh_destroy(pairbuf, buf->h);
+  free(buf);
+}
+
+
+//-------------------------------------------------------
+// Batches of fastq records
+
+static int kseq_batch_put(pysam_kseq_batch_t *b, const kstring_t *field,
+                          size_t *off)
+{
+  *off = b->data.l;
+  if (kputsn(field->s ? field->s : "", field->l, &b->data) < 0
+      || kputc('\0', &b->data) < 0)
+    return -1;
+  return 0;
+}
+
+static int kseq_read_batch(kseq_t *ks, int n, pysam_kseq_batch_t *b)
+{
+  size_t *off;
+  int i, ret = 0;
+
+  b->n = 0;
+  b->ret = 0;
+  b->data.l = 0;
+  if (n > b->m) {
+    if ((off = (size_t *)realloc(b->off, 4 * sizeof(size_t) * n)) == NULL)
+      return -4;
+    b->off = off;
+    b->m = n;
+  }
+  for (i = 0; i < n; i++) {
+    if ((ret = kseq_read(ks)) < 0) {
+      b->ret = ret;
+      break;
+    }
+    off = b->off + 4 * i;
+    if (kseq_batch_put(b, &ks->name, off) < 0
+        || kseq_batch_put(b, &ks->comment, off + 1) < 0
+        || kseq_batch_put(b, &ks->seq, off + 2) < 0
+        || kseq_batch_put(b, &ks->qual, off + 3) < 0)
+      return -4;
+    b->n++;
+  }
+  return 0;
+}
+
+typedef struct {
+  kseq_t *ks;
+  int n, ret;
+  pysam_kseq_batch_t *b;
+} kseq_batch_job_t;
+
+static void *kseq_batch_worker(void *arg)
+{
+  kseq_batch_job_t *job = (kseq_batch_job_t *)arg;
+  job->ret = kseq_read_batch(job->ks, job->n, job->b);
+  return NULL;
+}
+
+int pysam_kseq_read_pairs(kseq_t *ks1, kseq_t *ks2, int n,
+                          pysam_kseq_batch_t *b1, pysam_kseq_batch_t *b2,
+                          int concurrent)
+{
+  kseq_batch_job_t job = { ks2, n, 0, b2 };
+  pthread_t thread;
+  int ret;
+
+  if (concurrent && pthread_create(&thread, NULL, kseq_batch_worker, &job) == 0) {
+    ret = kseq_read_batch(ks1, n, b1);
+    pthread_join(thread, NULL);
+  } else {
+    ret = kseq_read_batch(ks1, n, b1);
+    kseq_batch_worker(&job);
+  }
+  return ret < 0 ? ret : job.ret;
+}
+
+void pysam_kseq_batch_destroy(pysam_kseq_batch_t *batch)
+{
+  free(batch->data.s);
+  free(batch->off);
+  memset(batch, 0, sizeof(*batch));
+}
@@ -3,6 +3,7 @@
 
 #include "htslib/sam.h"
 #include "htslib/vcf.h"
+#include "htslib/tbx.h"
 #include "htslib/khash.h"
 
 int hts_set_verbosity(int verbosity);
@@ -46,6 +47,109 @@ unsigned char pysam_translate_sequence(const unsigned char s);
 int aux_type2size(uint8_t type);
 
 
+// record types read by pysam_prefetch_t
+enum {
+  PYSAM_PREFETCH_SAM,   // bam1_t
+  PYSAM_PREFETCH_BCF,   // bcf1_t
+  PYSAM_PREFETCH_VCF    // kstring_t holding a line of text
+};
+
+typedef struct pysam_prefetch_t pysam_prefetch_t;
+
+/*!
+  @abstract Start a thread reading up to size records ahead from fp
+
+  @discussion Records are read with itr if given, otherwise from the
+  current position of fp until EOF.  tbx is needed to read text through
+  itr.  max_unpack, if not 0, is set in BCF records.  fp must not be
+  used elsewhere until pysam_prefetch_destroy() is called.
+
+  Return NULL on error.
+*/
+pysam_prefetch_t *pysam_prefetch_init(int type, int size, htsFile *fp,
+				      void *hdr, hts_itr_t *itr, tbx_t *tbx,
+				      int max_unpack);
+
+/*!
+  @abstract Hand out the next record read by the thread
+
+  @discussion rec is set to the record, which stays valid until the
+  next call.  Return what reading it returned, with errno set as it
+  was if that failed.  Once reading has failed, rec is set to NULL and
+  the failure is returned again.
+*/
+int pysam_prefetch_next(pysam_prefetch_t *p, void **rec);
+
+/*!
+  @abstract Take ownership of the record last handed out
+
+  Return NULL on error.
+*/
+void *pysam_prefetch_take(pysam_prefetch_t *p);
+
+/*!
+  @abstract Stop the thread and free the records
+
+  @discussion When reading a BGZF compressed BAM, BCF or VCF file
+  without an iterator, fp is moved back to the first record not handed
+  out.  Return 0 on success, -1 if that fails and -2 if records read
+  ahead but not handed out are dropped as fp cannot be moved back.
+*/
+int pysam_prefetch_destroy(pysam_prefetch_t *p);
+
+typedef struct pysam_junctions_t pysam_junctions_t;
+
+/*!
+  @abstract Create an empty table of splice junctions
+  Return NULL on error.
+*/
+pysam_junctions_t *pysam_junctions_init(void);
+
+/*!
+  @abstract Count the introns (N operations) in the CIGAR of b
+
+  @discussion Junctions are keyed by tid, start, end and the transcript
+  strand from the XS tag, or the ts tag flipped for reverse reads, as
+  1, -1 or 0 if unknown.  Secondary alignments and reads with NH > 1
+  are counted as multi-mapped.  Return 0 on success, -1 on error.
+*/
+int pysam_junctions_add(pysam_junctions_t *j, const bam1_t *b);
+
+// Number of distinct junctions
+size_t pysam_junctions_size(const pysam_junctions_t *j);
+
+/*!
+  @abstract Copy the junctions, sorted by tid, start, end and strand,
+  into arrays of pysam_junctions_size() elements
+  Return 0 on success, -1 on error.
+*/
+int pysam_junctions_export(const pysam_junctions_t *j, int32_t *tid,
+			   int64_t *start, int64_t *end, int8_t *strand,
+			   uint64_t *unique, uint64_t *multi);
+
+void pysam_junctions_destroy(pysam_junctions_t *j);
+
+typedef struct pysam_pairbuf_t pysam_pairbuf_t;
+
+// Create an empty buffer of reads keyed by name. Return NULL on error.
+pysam_pairbuf_t *pysam_pairbuf_init(void);
+
+/*!
+  @abstract Find the buffered read named like b
+
+  @discussion The buffered read is removed from buf and returned, to be
+  freed by the caller.  If there is none, a copy of b is buffered if
+  store is set and NULL is returned.  err is set to -1 if copying b
+  failed, 0 otherwise.
+*/
+bam1_t *pysam_pairbuf_match(pysam_pairbuf_t *buf, const bam1_t *b,
+			    int store, int *err);
+
+// Number of buffered reads
+size_t pysam_pairbuf_size(const pysam_pairbuf_t *buf);
+
+void pysam_pairbuf_destroy(pysam_pairbuf_t *buf);
+
 //-------------------------------------------------------
 // Wrapping accessor macros in sam.h
 static inline int pysam_bam_is_rev(bam1_t * b) {
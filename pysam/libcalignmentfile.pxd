@@ -36,6 +36,12 @@ ctypedef struct __iterdata:
     bint redo_baq
     bint ignore_orphans
     int adjust_capq_threshold
+    hts_filter_t * filter
+
+
+# called for each read by IteratorRow.visit(), a negative return value
+# stops reading
+ctypedef int (*read_visitor_f)(bam1_t *b, void *data) nogil
 
 
 cdef class AlignmentHeader(object):
@@ -44,6 +50,7 @@ cdef class AlignmentHeader(object):
 cdef class AlignmentFile(HTSFile):
     cdef readonly object reference_filename
     cdef readonly AlignmentHeader header
+    cdef readonly object filter
 
     # pointer to index
     cdef hts_idx_t *index
@@ -53,6 +60,8 @@ cdef class AlignmentFile(HTSFile):
 
     cdef bam1_t * getCurrent(self)
     cdef int cnext(self)
+    cdef bam1_t *prefetch_next(self, int size, int *ret) except? NULL
+    cdef int64_t count_from_index(self, int tid, int until_eof) except -1
 
     # write an aligned read
     cpdef int write(self, AlignedSegment read) except -1
@@ -66,12 +75,21 @@ cdef class IteratorRow:
     cdef hts_idx_t * index
     cdef AlignmentHeader header
     cdef int owns_samfile
+    cdef hts_filter_t *filter
+    cdef int prefetch
+    cdef pysam_prefetch_t *reader
+    cdef bam1_t *prefetch_next(self, hts_itr_t *iter) except? NULL
+    cdef stop_prefetch(self)
+    cdef int visit(self, read_visitor_f func, void *data) except -1
+    cdef int visit_iter(self, hts_itr_t *iter, bint use_iter,
+                        read_visitor_f func, void *data) except -1
 
 
 cdef class IteratorRowRegion(IteratorRow):
     cdef hts_itr_t * iter
     cdef bam1_t * getCurrent(self)
     cdef int cnext(self)
+    cdef int visit(self, read_visitor_f func, void *data) except -1
 
 
 cdef class IteratorRowHead(IteratorRow):
@@ -84,11 +102,13 @@ cdef class IteratorRowHead(IteratorRow):
 cdef class IteratorRowAll(IteratorRow):
     cdef bam1_t * getCurrent(self)
     cdef int cnext(self)
+    cdef int visit(self, read_visitor_f func, void *data) except -1
 
 
 cdef class IteratorRowAllRefs(IteratorRow):
     cdef int         tid
     cdef IteratorRowRegion rowiter
+    cdef int visit(self, read_visitor_f func, void *data) except -1
 
 
 cdef class IteratorRowSelection(IteratorRow):
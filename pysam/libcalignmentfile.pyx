@@ -64,7 +64,7 @@ except ImportError:
 import re
 import warnings
 import array
-from libc.errno  cimport errno, EPIPE
+from libc.errno  cimport errno, EPIPE, EIO
 from libc.string cimport strcmp, strpbrk, strerror
 from libc.stdint cimport INT32_MAX
 
@@ -97,6 +97,16 @@ IndexStats = collections.namedtuple("IndexStats",
                                      "unmapped",
                                      "total"))
 
+JunctionTable = collections.namedtuple("JunctionTable",
+                                       ("tid",
+                                        "start",
+                                        "stop",
+                                        "strand",
+                                        "count",
+                                        "unique",
+                                        "multi",
+                                        "motif"))
+
 ########################################################
 ## global variables
 # maximum genomic coordinace
@@ -579,13 +589,176 @@ cdef class AlignmentHeader(object):
         return self.to_dict().__contains__(key)
 
 
+cdef int skip_header(AlignmentFile samfile, htsFile *fp) except -1:
+    '''position *fp*, a new handle on the file of *samfile*, at the
+    first record.
+
+    BAM files seek past the header that has already been parsed by
+    *samfile*, other formats read and discard it.
+    '''
+    cdef bam_hdr_t *hdr
+    cdef int64_t ret
+    if samfile.is_bam and not samfile.is_stream:
+        with nogil:
+            ret = bgzf_seek(hts_get_bgzfp(fp), samfile.start_offset, SEEK_SET)
+        if ret < 0:
+            raise IOError("unable to seek to first record")
+    else:
+        with nogil:
+            hdr = sam_hdr_read(fp)
+        if hdr == NULL:
+            raise IOError("unable to read header information")
+        bam_hdr_destroy(hdr)
+    return 0
+
+
+cdef hts_filter_t *compile_filter(expr, AlignmentHeader header) except NULL:
+    '''compile the htslib filter expression *expr* for reads described
+    by *header*.
+
+    htslib only parses an expression when it is evaluated, so it is
+    tried on an unmapped read to report errors here rather than while
+    reading.
+    '''
+    cdef hts_filter_t *filt = hts_filter_init(force_bytes(expr))
+    cdef bam1_t *b
+    cdef int ret = -1
+    if filt != NULL:
+        b = bam_init1()
+        if b != NULL and bam_set1(b, 1, "*", BAM_FUNMAP, -1, -1, 0, 0, NULL,
+                                  -1, -1, 0, 0, NULL, NULL, 0) >= 0:
+            ret = sam_passes_filter(header.ptr, b, filt)
+        bam_destroy1(b)
+    if ret < 0:
+        hts_filter_free(filt)
+        raise ValueError("invalid filter expression `{}`".format(force_str(expr)))
+    return filt
+
+
+cdef int set_filter(htsFile *fp, expr, AlignmentHeader header) except -1:
+    '''apply the htslib filter expression *expr* to all records read
+    from *fp*. The expression is compiled once for the handle.'''
+    if expr is None:
+        return 0
+    hts_filter_free(compile_filter(expr, header))
+    if hts_set_filter_expression(fp, force_bytes(expr)) < 0:
+        raise ValueError("invalid filter expression `{}`".format(force_str(expr)))
+    return 0
+
+
+cdef inline int read_passes(hts_filter_t *filt, bam_hdr_t *hdr, bam1_t *b) nogil:
+    '''return 1 if *b* is accepted by *filt*, 0 if not and -1 on
+    error. Without a filter, all reads are accepted.'''
+    if filt == NULL:
+        return 1
+    return sam_passes_filter(hdr, b, filt)
+
+
+cdef int visit_reads(htsFile *fp, bam_hdr_t *hdr, hts_itr_t *itr,
+                     bint use_iter, hts_filter_t *filt, bam1_t *b,
+                     read_visitor_f func, void *data) nogil:
+    '''call *func* for each read passing *filt*, read through *itr* if
+    *use_iter* is set or else from the current position of *fp*.
+
+    Returns 0 at the end of the reads, 1 if *func* failed or the
+    negative value returned by a failed read.
+    '''
+    cdef int ret, passes
+    while 1:
+        if use_iter:
+            ret = sam_itr_next(fp, itr, b)
+        else:
+            ret = sam_read1(fp, hdr, b)
+        if ret == -1:
+            return 0
+        if ret < 0:
+            return ret
+        passes = read_passes(filt, hdr, b)
+        if passes < 0:
+            return -2
+        if passes != 0 and func(b, data) < 0:
+            return 1
+
+
+ctypedef struct count_data_t:
+    int flag_require
+    int flag_filter
+    int min_mapping_quality
+    int64_t counter
+
+
+cdef int count_visitor(bam1_t *b, void *data) nogil:
+    cdef count_data_t *d = <count_data_t *>data
+    if b.core.flag & d.flag_filter:
+        return 0
+    if (b.core.flag & d.flag_require) != d.flag_require:
+        return 0
+    if b.core.qual < d.min_mapping_quality:
+        return 0
+    d.counter += 1
+    return 0
+
+
+cdef int junction_visitor(bam1_t *b, void *data) nogil:
+    return pysam_junctions_add(<pysam_junctions_t *>data, b)
+
+
+cdef inline int contig_order(int tid):
+    # unplaced reads come last in a coordinate sorted file
+    return tid if tid >= 0 else INT32_MAX
+
+
+def pair_reads(reads, AlignmentHeader header, bint sorted_input):
+    '''yield (read1, read2) tuples from an iterator over reads.
+
+    Reads are kept until their mate turns up. If `sorted_input` is
+    set, reads whose mate would have been seen already are not kept.
+    '''
+    cdef AlignedSegment read
+    cdef bam1_t *b
+    cdef bam1_t *m
+    cdef int store, err
+    cdef pysam_pairbuf_t *buf = pysam_pairbuf_init()
+    if buf == NULL:
+        raise MemoryError("could not allocate read buffer")
+
+    try:
+        for read in reads:
+            b = read._delegate
+            if b.core.flag & BAM_FPAIRED == 0 or \
+               b.core.flag & (BAM_FSECONDARY | BAM_FSUPPLEMENTARY):
+                continue
+            if sorted_input:
+                store = (contig_order(b.core.mtid) > contig_order(b.core.tid) or
+                         (b.core.mtid == b.core.tid and b.core.mpos >= b.core.pos))
+            else:
+                store = 1
+            m = pysam_pairbuf_match(buf, b, store, &err)
+            if err < 0:
+                raise MemoryError("could not copy read")
+            if m == NULL:
+                continue
+            mate = makeAlignedSegment(m, header)
+            bam_destroy1(m)
+            if mate.flag & BAM_FREAD1:
+                yield (mate, read)
+            else:
+                yield (read, mate)
+    finally:
+        pysam_pairbuf_destroy(buf)
+
+
+# passed by clone() to create an instance without opening a file
+cdef object _UNOPENED = object()
+
+
 cdef class AlignmentFile(HTSFile):
     """AlignmentFile(filepath_or_object, mode=None, template=None,
     reference_names=None, reference_lengths=None, text=NULL,
     header=None, add_sq_text=False, check_header=True, check_sq=True,
     reference_filename=None, filename=None, index_filename=None,
     filepath_index=None, require_index=False, duplicate_filehandle=True,
-    ignore_truncation=False, threads=1)
+    ignore_truncation=False, threads=1, filter=None)
 
     A :term:`SAM`/:term:`BAM`/:term:`CRAM` formatted file.
 
@@ -733,6 +906,40 @@ cdef class AlignmentFile(HTSFile):
         Number of threads to use for compressing/decompressing BAM/CRAM files.
         Setting threads to > 1 cannot be combined with `ignore_truncation`.
         (Default=1)
+
+    io: string
+        How to read a local file. ``None`` uses ordinary buffered reads;
+        ``'mmap'`` maps the file into memory, which avoids system calls
+        and copies for random access such as many small :meth:`fetch`
+        calls. The kernel is advised to expect random access when an
+        index is present and sequential access otherwise. Files that
+        cannot be mapped are read normally. Only valid when reading.
+        (Default=None)
+
+    lazy_index: bool
+        Only read the index header when the file is opened, and read
+        the entries of a reference the first time it is queried.  This
+        makes opening a file cheap when its index covers many
+        references but only a few are fetched.  The index file is kept
+        open while the AlignmentFile is.  Has no effect on CRAM indices.
+        (Default=False)
+
+    prefetch: integer
+        Number of records to read ahead in a background thread when
+        iterating over the file, so that decoding overlaps with the
+        processing of earlier records in Python. 0 reads each record
+        when it is requested. The value is also the default for
+        :meth:`fetch`. Only valid when reading. SAM and CRAM files
+        cannot be repositioned, so seeking, fetching or pileups on
+        the filehandle before the whole file has been read raise
+        IOError as the records read ahead would be lost. (Default=0)
+
+    filter: string
+        An htslib filter expression such as ``mapq >= 20 && !flag.dup``
+        (see the samtools documentation on filter expressions). Reads
+        not matching it are skipped by htslib before they reach Python,
+        in iteration, :meth:`fetch`, :meth:`count` and :meth:`pileup`
+        alike. Only valid when reading. (Default=None)
     """
 
     def __cinit__(self, *args, **kwargs):
@@ -743,6 +950,16 @@ cdef class AlignmentFile(HTSFile):
         self.is_stream = False
         self.is_remote = False
         self.index = NULL
+        self.filter = None
+
+        # allocate memory for iterator
+        self.b = <bam1_t*>calloc(1, sizeof(bam1_t))
+        if self.b == NULL:
+            raise MemoryError("could not allocate memory of size {}".format(sizeof(bam1_t)))
+
+        # clone() fills in the file itself
+        if args and args[0] is _UNOPENED:
+            return
 
         if "filename" in kwargs:
             args = [kwargs["filename"]]
@@ -750,11 +967,6 @@ cdef class AlignmentFile(HTSFile):
 
         self._open(*args, **kwargs)
 
-        # allocate memory for iterator
-        self.b = <bam1_t*>calloc(1, sizeof(bam1_t))
-        if self.b == NULL:
-            raise MemoryError("could not allocate memory of size {}".format(sizeof(bam1_t)))
-
     def has_index(self):
         """return true if htsfile has an existing (and opened) index.
         """
@@ -806,7 +1018,11 @@ cdef class AlignmentFile(HTSFile):
               duplicate_filehandle=True,
               ignore_truncation=False,
               format_options=None,
-              threads=1):
+              threads=1,
+              io=None,
+              lazy_index=False,
+              prefetch=0,
+              filter=None):
         '''open a sam, bam or cram formatted file.
 
         If _open is called on an existing file, the current file
@@ -818,6 +1034,7 @@ cdef class AlignmentFile(HTSFile):
         cdef char *cindexname = NULL
         cdef char *cmode = NULL
         cdef bam_hdr_t * hdr = NULL
+        cdef int index_flags
 
         if threads > 1 and ignore_truncation:
            # This won't raise errors if reaching a truncated alignment,
@@ -828,6 +1045,14 @@ cdef class AlignmentFile(HTSFile):
            raise ValueError('Cannot add extra threads when "ignore_truncation" is True')
         self.threads = threads
 
+        if io not in (None, "mmap"):
+            raise ValueError("io must be None or 'mmap', not {!r}".format(io))
+        self.io = io
+
+        if prefetch < 0:
+            raise ValueError("prefetch must not be negative")
+        self.prefetch = prefetch
+
         # for backwards compatibility:
         if referencenames is not None:
             reference_names = referencenames
@@ -850,6 +1075,14 @@ cdef class AlignmentFile(HTSFile):
                         "rc", "wc"), \
             "invalid file opening mode `%s`" % mode
 
+        if io == "mmap" and mode[0] != "r":
+            raise ValueError("io='mmap' is only valid when reading")
+        if prefetch and mode[0] != "r":
+            raise ValueError("prefetch is only valid when reading")
+        if filter is not None and mode[0] != "r":
+            raise ValueError("filter is only valid when reading")
+        self.filter = filter
+
         self.duplicate_filehandle = duplicate_filehandle
 
         # StringIO not supported
@@ -1002,14 +1235,20 @@ cdef class AlignmentFile(HTSFile):
                      "is it SAM/BAM format? Consider opening with "
                      "check_sq=False") % mode)
 
+            set_filter(self.htsfile, filter, self.header)
+
             if self.is_bam or self.is_cram:
                 self.index_filename = index_filename or filepath_index
                 if self.index_filename:
                     cindexname = bfile_name = encode_filename(self.index_filename)
 
                 if cfilename or cindexname:
+                    index_flags = HTS_IDX_SAVE_REMOTE
+                    if lazy_index:
+                        index_flags |= HTS_IDX_LAZY
                     with nogil:
-                        self.index = sam_index_load2(self.htsfile, cfilename, cindexname)
+                        self.index = sam_index_load3(self.htsfile, cfilename, cindexname,
+                                                     index_flags)
 
                     if not self.index and (cindexname or require_index):
                         if errno:
@@ -1020,10 +1259,87 @@ cdef class AlignmentFile(HTSFile):
                 elif require_index:
                     raise IOError('unable to open index file')
 
+                if self.io == "mmap":
+                    hts_set_opt(self.htsfile, HTS_OPT_MMAP,
+                                HTS_ACCESS_RANDOM if self.index != NULL
+                                else HTS_ACCESS_SEQUENTIAL)
+
                 # save start of data section
                 if not self.is_stream:
                     self.start_offset = self.tell()
 
+    def clone(self):
+        '''return a new :class:`AlignmentFile` on the same file.
+
+        The file is opened again and positioned at the first record,
+        but the header and index are shared with this object rather
+        than read again, which makes a clone much cheaper to create
+        than a newly opened file. Clones can be read independently of
+        each other, for example in different threads. CRAM indices
+        cannot be shared and are loaded again.
+
+        Only files opened for reading by name can be cloned.
+        '''
+        if not self.is_open:
+            raise ValueError("I/O operation on closed file")
+        if self.is_write:
+            raise ValueError("cannot clone a file opened for writing")
+        if self.is_stream:
+            raise ValueError("cannot clone a stream")
+
+        cdef AlignmentFile other = AlignmentFile.__new__(AlignmentFile, _UNOPENED)
+        cdef char *cfilename = self.filename
+        cdef char *cindexname = NULL
+        cdef char *creference_filename
+
+        other.filename = self.filename
+        other.mode = self.mode
+        other.threads = self.threads
+        other.io = self.io
+        other.prefetch = self.prefetch
+        other.filter = self.filter
+        other.index_filename = self.index_filename
+        other.is_remote = self.is_remote
+        other.duplicate_filehandle = self.duplicate_filehandle
+        other.reference_filename = self.reference_filename
+        other.start_offset = self.start_offset
+        other.header = self.header
+
+        other.htsfile = other._open_htsfile()
+        if other.htsfile == NULL:
+            if errno:
+                raise IOError(errno, "could not open alignment file `{}`: {}".format(
+                    force_str(self.filename), force_str(strerror(errno))))
+            raise ValueError("could not open alignment file `{}`".format(
+                force_str(self.filename)))
+
+        skip_header(self, other.htsfile)
+        set_filter(other.htsfile, self.filter, self.header)
+
+        if self.is_cram and self.reference_filename:
+            creference_filename = self.reference_filename
+            hts_set_opt(other.htsfile,
+                        CRAM_OPT_REFERENCE,
+                        creference_filename)
+
+        if self.index != NULL:
+            other.index = hts_idx_share(self.index)
+            if other.index == NULL:
+                if self.index_filename:
+                    cindexname = bindex_filename = encode_filename(self.index_filename)
+                with nogil:
+                    other.index = sam_index_load2(other.htsfile, cfilename, cindexname)
+                if other.index == NULL:
+                    raise IOError("unable to open index for `{}`".format(
+                        force_str(self.filename)))
+
+        if self.io == "mmap":
+            hts_set_opt(other.htsfile, HTS_OPT_MMAP,
+                        HTS_ACCESS_RANDOM if other.index != NULL
+                        else HTS_ACCESS_SEQUENTIAL)
+
+        return other
+
     def fetch(self,
               contig=None,
               start=None,
@@ -1033,7 +1349,9 @@ cdef class AlignmentFile(HTSFile):
               until_eof=False,
               multiple_iterators=False,
               reference=None,
-              end=None):
+              end=None,
+              prefetch=None,
+              filter=None):
         """fetch reads aligned in a :term:`region`.
 
         See :meth:`~pysam.HTSFile.parse_region` for more information
@@ -1070,6 +1388,21 @@ cdef class AlignmentFile(HTSFile):
            the file effectively re-opening the file. Re-opening a file
            creates some overhead, so beware.
 
+        prefetch : int
+
+           Number of reads to decode ahead in a background thread, see
+           :class:`AlignmentFile`. Defaults to the value the file was
+           opened with. Iterators over a region read ahead through
+           their own copy of the filehandle, as with
+           `multiple_iterators`.
+
+        filter : string
+
+           An htslib filter expression, see :class:`AlignmentFile`.
+           Reads not matching it are skipped before they reach
+           Python. It applies in addition to the filter the file was
+           opened with.
+
         Returns
         -------
 
@@ -1092,6 +1425,9 @@ cdef class AlignmentFile(HTSFile):
             contig, start, stop, region, tid,
             end=end, reference=reference)
 
+        if prefetch is None:
+            prefetch = self.prefetch
+
        # Turn of re-opening if htsfile is a stream
         if self.is_stream:
             multiple_iterators = False
@@ -1105,18 +1441,24 @@ cdef class AlignmentFile(HTSFile):
             if has_coord:
                 return IteratorRowRegion(
                     self, rtid, rstart, rstop,
-                    multiple_iterators=multiple_iterators)
+                    multiple_iterators=multiple_iterators,
+                    prefetch=prefetch,
+                    filter=filter)
             else:
                 if until_eof:
                     return IteratorRowAll(
                         self,
-                        multiple_iterators=multiple_iterators)
+                        multiple_iterators=multiple_iterators,
+                        prefetch=prefetch,
+                        filter=filter)
                 else:
                     # AH: check - reason why no multiple_iterators for
                     # AllRefs?
                     return IteratorRowAllRefs(
                         self,
-                        multiple_iterators=multiple_iterators)
+                        multiple_iterators=multiple_iterators,
+                        prefetch=prefetch,
+                        filter=filter)
         else:
             if has_coord:
                 raise ValueError(
@@ -1127,7 +1469,9 @@ cdef class AlignmentFile(HTSFile):
                     "multiple iterators not implemented for SAM files")
 
             return IteratorRowAll(self,
-                                  multiple_iterators=multiple_iterators)
+                                  multiple_iterators=multiple_iterators,
+                                  prefetch=prefetch,
+                                  filter=filter)
 
     def head(self, n, multiple_iterators=True):
         '''return an iterator over the first n alignments.
@@ -1210,6 +1554,153 @@ cdef class AlignmentFile(HTSFile):
 
         return mate
 
+    def mates(self, reads, int max_gap=10000):
+        '''return the mates of a collection of reads.
+
+        The mates are located with a single pass over the index: the
+        requests are sorted by mate position and positions closer
+        than `max_gap` bases are merged into a single region, which
+        is read once and matched against the requested read names.
+        This is much faster than calling :meth:`mate` for each read.
+
+        Only primary alignments are returned as mates. The file is
+        read through a clone, so the position of this file is not
+        changed.
+
+        Parameters
+        ----------
+
+        reads : iterable
+            :class:`~pysam.AlignedSegment` objects.
+
+        max_gap : int
+            merge mate positions at most this many bases apart into
+            the same region.
+
+        Returns
+        -------
+
+        list : the mates in the order of `reads`. The entry is None
+        if the read is unpaired, its mate is unmapped or the mate
+        could not be found.
+
+        '''
+        if not self.is_open:
+            raise ValueError("I/O operation on closed file")
+        if not self.has_index():
+            raise ValueError("mate lookup requires an index")
+
+        cdef AlignedSegment read
+        cdef bam1_t *src
+        cdef uint32_t flag
+        cdef int x = BAM_FREAD1 + BAM_FREAD2
+
+        reads = list(reads)
+        mates = [None] * len(reads)
+        wanted = {}
+        for i, read in enumerate(reads):
+            src = read._delegate
+            flag = src.core.flag
+            if flag & BAM_FPAIRED == 0 or flag & BAM_FMUNMAP or src.core.mtid < 0:
+                continue
+            key = (src.core.mtid, src.core.mpos, <bytes>bam_get_qname(src))
+            wanted.setdefault(key, []).append((i, (flag ^ x) & x))
+        if not wanted:
+            return mates
+
+        # merge nearby mate positions into regions
+        regions = []
+        cdef int tid = -1, beg = 0, end = 0
+        for mtid, mpos in sorted(set(k[:2] for k in wanted)):
+            if mtid == tid and mpos <= end + max_gap:
+                end = mpos + 1
+                positions.add(mpos)
+                continue
+            if tid >= 0:
+                regions.append((tid, beg, end, positions))
+            tid, beg, end = mtid, mpos, mpos + 1
+            positions = {mpos}
+        regions.append((tid, beg, end, positions))
+
+        cdef AlignmentFile other = self.clone()
+        cdef hts_itr_t *itr
+        cdef bam1_t *b = bam_init1()
+        cdef int ret
+        try:
+            for tid, beg, end, positions in regions:
+                with nogil:
+                    itr = sam_itr_queryi(other.index, tid, beg, end)
+                if itr == NULL:
+                    raise ValueError("could not query region {}:{}-{}".format(
+                        self.get_reference_name(tid), beg, end))
+                try:
+                    while 1:
+                        with nogil:
+                            ret = sam_itr_next(other.htsfile, itr, b)
+                        if ret < 0:
+                            break
+                        if b.core.pos not in positions or \
+                           b.core.flag & (BAM_FSECONDARY | BAM_FSUPPLEMENTARY):
+                            continue
+                        found = wanted.get((tid, b.core.pos, <bytes>bam_get_qname(b)))
+                        if found is None:
+                            continue
+                        mate = None
+                        for i, flag in found:
+                            if b.core.flag & flag and mates[i] is None:
+                                if mate is None:
+                                    mate = makeAlignedSegment(b, self.header)
+                                mates[i] = mate
+                finally:
+                    hts_itr_destroy(itr)
+                if ret < -1:
+                    raise IOError("error while reading file {}: {}".format(
+                        self.filename, ret))
+        finally:
+            bam_destroy1(b)
+            other.close()
+
+        return mates
+
+    def iter_pairs(self,
+                   contig=None,
+                   start=None,
+                   stop=None,
+                   region=None,
+                   until_eof=False,
+                   multiple_iterators=False,
+                   reference=None,
+                   end=None):
+        '''iterate over read pairs in a :term:`region`.
+
+        Reads are fetched as with :meth:`fetch` and kept until their
+        mate arrives, when the pair is returned as a tuple (read1,
+        read2). Only primary alignments are paired. Reads whose mate
+        lies outside the region are dropped, and in a coordinate
+        sorted file a read is not kept if its mate should have been
+        seen before it, so that memory stays bounded by the number of
+        pairs spanning the current position. Files in other orders,
+        for example sorted by read name, can be paired with
+        `until_eof`.
+
+        The parameters select reads as in :meth:`fetch`.
+
+        Returns
+        -------
+
+        an iterator over tuples (read1, read2) of
+        :class:`~pysam.AlignedSegment`.
+
+        '''
+        reads = self.fetch(contig, start, stop, region,
+                           until_eof=until_eof,
+                           multiple_iterators=multiple_iterators,
+                           reference=reference,
+                           end=end)
+        sorted_input = (not until_eof or
+                        self.header.get("HD", {}).get("SO") == "coordinate")
+        return pair_reads(reads, self.header, sorted_input)
+
     def pileup(self,
                contig=None,
                start=None,
@@ -1320,6 +1811,13 @@ cdef class AlignmentFile(HTSFile):
            existing base qualities. The default is False (use existing
            base qualities).
 
+        filter : string
+
+           only use reads matching an htslib filter expression, see
+           :class:`AlignmentFile`. It applies in addition to the filter
+           the file was opened with and before the stepper's own
+           filtering.
+
         Returns
         -------
 
@@ -1358,7 +1856,12 @@ cdef class AlignmentFile(HTSFile):
               until_eof=False,
               read_callback="nofilter",
               reference=None,
-              end=None):
+              end=None,
+              filter=None,
+              flag_require=0,
+              flag_filter=0,
+              min_mapping_quality=0,
+              method=None):
         '''count the number of reads in :term:`region`
 
         The region is specified by :term:`contig`, `start` and `stop`.
@@ -1412,6 +1915,31 @@ cdef class AlignmentFile(HTSFile):
         end : int
             backward compatible synonym for `stop`
 
+        filter : string
+            only count reads matching an htslib filter expression, see
+            :class:`AlignmentFile`. Unlike `read_callback`, it is
+            evaluated without creating :class:`AlignedSegment` objects.
+
+        flag_require : int
+            only count reads where all of the bits in the flag are set.
+
+        flag_filter : int
+            skip reads where any of the bits in the flag are set.
+
+        min_mapping_quality : int
+            only count reads with at least this mapping quality.
+
+        method : string
+            With ``index``, whole contigs are counted from the
+            statistics recorded in the index, as in
+            :meth:`get_index_statistics`, without reading any
+            alignments. The count includes the unmapped reads placed on
+            a contig, and with `until_eof` those without coordinates.
+            No read selection can be applied.
+
+        Unless `read_callback` is a function, reads are counted without
+        creating :class:`AlignedSegment` objects.
+
         Raises
         ------
 
@@ -1420,38 +1948,88 @@ cdef class AlignmentFile(HTSFile):
 
         '''
         cdef AlignedSegment read
-        cdef long counter = 0
+        cdef int64_t counter = 0
+        cdef int rtid, rstart, rstop, has_coord
 
         if not self.is_open:
             raise ValueError("I/O operation on closed file")
 
-        cdef int filter_method = 0
-        if read_callback == "all":
-            filter_method = 1
-        elif read_callback == "nofilter":
-            filter_method = 2
+        if method == "index":
+            if (read_callback != "nofilter" or filter is not None or
+                    self.filter is not None or flag_require or flag_filter or
+                    min_mapping_quality):
+                raise ValueError(
+                    "reads cannot be selected when counting from the index")
+            has_coord, rtid, rstart, rstop = self.parse_region(
+                contig, start, stop, region, reference=reference, end=end)
+            if has_coord and (rstart > 0 or (
+                    rstop != MAX_POS and
+                    rstop < self.header.get_reference_length(rtid))):
+                raise ValueError("the index only counts whole contigs")
+            return self.count_from_index(rtid if has_coord else -1, until_eof)
+        elif method is not None:
+            raise ValueError("unknown count method {!r}".format(method))
 
-        for read in self.fetch(contig=contig,
-                               start=start,
-                               stop=stop,
-                               reference=reference,
-                               end=end,
-                               region=region,
-                               until_eof=until_eof):
-            # apply filter
-            if filter_method == 1:
-                # filter = "all"
-                if (read.flag & (0x4 | 0x100 | 0x200 | 0x400)):
+        if read_callback == "all":
+            flag_filter |= BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP
+        elif read_callback != "nofilter":
+            for read in self.fetch(contig=contig,
+                                   start=start,
+                                   stop=stop,
+                                   reference=reference,
+                                   end=end,
+                                   region=region,
+                                   until_eof=until_eof,
+                                   filter=filter):
+                if read.flag & flag_filter:
+                    continue
+                if (read.flag & flag_require) != flag_require:
+                    continue
+                if read.mapping_quality < min_mapping_quality:
                     continue
-            elif filter_method == 2:
-                # filter = "nofilter"
-                pass
-            else:
                 if not read_callback(read):
                     continue
-            counter += 1
-
-        return counter
+                counter += 1
+            return counter
+
+        cdef IteratorRow iterator = self.fetch(contig=contig,
+                                               start=start,
+                                               stop=stop,
+                                               reference=reference,
+                                               end=end,
+                                               region=region,
+                                               until_eof=until_eof,
+                                               prefetch=0,
+                                               filter=filter)
+        cdef count_data_t counting
+        counting.flag_require = flag_require
+        counting.flag_filter = flag_filter
+        counting.min_mapping_quality = min_mapping_quality
+        counting.counter = 0
+        iterator.visit(count_visitor, &counting)
+        return counting.counter
+
+    cdef int64_t count_from_index(self, int tid, int until_eof) except -1:
+        '''return the number of reads on *tid*, or all contigs if *tid*
+        is -1, recorded in the index.'''
+        self.check_index()
+        if hts_idx_fmt(self.index) == HTS_FMT_CRAI:
+            raise ValueError("CRAM indices do not record read counts")
+        cdef uint64_t mapped, unmapped
+        cdef int64_t total = 0
+        cdef int i, ret
+        for i in range(self.nreferences):
+            if tid >= 0 and i != tid:
+                continue
+            with nogil:
+                ret = hts_idx_get_stat(self.index, i, &mapped, &unmapped)
+            if ret < 0:
+                # references without reads have no statistics
+                mapped = unmapped = 0
+            total += mapped + unmapped
+        if tid < 0 and until_eof:
+            total += hts_idx_get_n_no_coor(self.index)
+        return total
 
     @cython.boundscheck(False)  # we do manual bounds checking
     def count_coverage(self,
@@ -1637,28 +2215,116 @@ cdef class AlignmentFile(HTSFile):
         read_iterator can be the result of a .fetch(...) call.
         Or it can be a generator filtering such reads. Example
         samfile.find_introns((read for read in samfile.fetch(...) if read.is_reverse)
-        """
-        cdef:
-            uint32_t base_position, junc_start, nt
-            int op
-            AlignedSegment r
-            int BAM_CREF_SKIP = 3 #BAM_CREF_SKIP
 
+        See :meth:`find_junctions` for a table keeping contigs and
+        strands apart.
+        """
+        table = self.find_junctions(read_iterator)
         res = collections.Counter()
-
-        match_or_deletion = {0, 2, 7, 8} # only M/=/X (0/7/8) and D (2) are related to genome position
-        for r in read_iterator:
-            base_position = r.pos
-
-            for op, nt in r.cigartuples:
-                if op in match_or_deletion:
-                    base_position += nt
-                elif op == BAM_CREF_SKIP:
-                    junc_start = base_position
-                    base_position += nt
-                    res[(junc_start, base_position)] += 1
+        for start, stop, count in zip(table.start, table.stop, table.count):
+            res[(start, stop)] += count
         return res
 
+    def find_junctions(self, read_iterator, FastaFile fastafile=None):
+        """count the splice junctions, i.e. the 'N' operations in the
+        cigar strings, of the reads in `read_iterator`.
+
+        The CIGAR of each read is walked in C. If `read_iterator` is
+        the result of a :meth:`fetch` call, the reads are also read
+        without creating :class:`AlignedSegment` objects, so that
+        ``find_junctions(fetch(...))`` is much faster than iterating
+        over any other read iterator.
+
+        Junctions are distinguished by contig and by the strand of the
+        transcript, taken from the ``XS`` tag or else from the
+        ``ts`` tag as written by minimap2.
+
+        Parameters
+        ----------
+
+        read_iterator
+            an iterator returned by :meth:`fetch` or any iterable of
+            :class:`AlignedSegment` objects.
+
+        fastafile : :class:`~pysam.FastaFile`
+            if given, the dinucleotides at the donor and acceptor
+            ends of each intron are reported as ``motif``.
+
+        Returns
+        -------
+
+        JunctionTable
+            a named tuple of columns with one entry per junction,
+            sorted by `tid`, `start`, `stop` and `strand`:
+
+            ``tid``, ``start``, ``stop`` : array.array
+                contig and 0-based, half-open coordinates of the
+                intron.
+            ``strand`` : array.array
+                1 or -1 for the forward or reverse strand, 0 if
+                unknown.
+            ``count``, ``unique``, ``multi`` : array.array
+                number of reads supporting the junction, split into
+                uniquely and multi-mapped reads. Secondary alignments
+                and reads with an ``NH`` tag above 1 count as
+                multi-mapped.
+            ``motif`` : list
+                strings such as ``'GT-AG'`` on the forward strand of
+                the reference, or None without `fastafile`.
+        """
+        cdef AlignedSegment r
+        cdef size_t n, i
+        cdef c_array.array tid, start, stop, strand, count, unique, multi
+        cdef pysam_junctions_t *junctions = pysam_junctions_init()
+        if junctions == NULL:
+            raise MemoryError("could not allocate junction table")
+
+        try:
+            if isinstance(read_iterator, (IteratorRowRegion,
+                                          IteratorRowAll,
+                                          IteratorRowAllRefs)):
+                (<IteratorRow>read_iterator).visit(junction_visitor, junctions)
+            else:
+                for r in read_iterator:
+                    if pysam_junctions_add(junctions, r._delegate) < 0:
+                        raise MemoryError("could not count junctions")
+
+            n = pysam_junctions_size(junctions)
+            tid = c_array.clone(array.array('i', []), n, zero=False)
+            start = c_array.clone(array.array('q', []), n, zero=False)
+            stop = c_array.clone(array.array('q', []), n, zero=False)
+            strand = c_array.clone(array.array('b', []), n, zero=False)
+            count = c_array.clone(array.array('Q', []), n, zero=False)
+            unique = c_array.clone(array.array('Q', []), n, zero=False)
+            multi = c_array.clone(array.array('Q', []), n, zero=False)
+            if pysam_junctions_export(junctions,
+                                      <int32_t *>tid.data.as_ints,
+                                      <int64_t *>start.data.as_longlongs,
+                                      <int64_t *>stop.data.as_longlongs,
+                                      <int8_t *>strand.data.as_schars,
+                                      <uint64_t *>unique.data.as_ulonglongs,
+                                      <uint64_t *>multi.data.as_ulonglongs) < 0:
+                raise MemoryError("could not export junctions")
+        finally:
+            pysam_junctions_destroy(junctions)
+
+        for i in range(n):
+            count.data.as_ulonglongs[i] = (unique.data.as_ulonglongs[i] +
+                                           multi.data.as_ulonglongs[i])
+
+        motif = None
+        if fastafile is not None:
+            motif = []
+            for i in range(n):
+                contig = self.get_reference_name(tid.data.as_ints[i])
+                motif.append("{}-{}".format(
+                    fastafile.fetch(contig, start.data.as_longlongs[i],
+                                    start.data.as_longlongs[i] + 2).upper(),
+                    fastafile.fetch(contig, stop.data.as_longlongs[i] - 2,
+                                    stop.data.as_longlongs[i]).upper()))
+
+        return JunctionTable(tid, start, stop, strand, count, unique, multi, motif)
+
 
     def close(self):
         '''closes the :class:`pysam.AlignmentFile`.'''
@@ -1666,6 +2332,8 @@ cdef class AlignmentFile(HTSFile):
         if self.htsfile == NULL:
             return
 
+        pysam_prefetch_destroy(self.prefetch_reader)
+        self.prefetch_reader = NULL
         cdef int ret = hts_close(self.htsfile)
         self.htsfile = NULL
 
@@ -1685,6 +2353,9 @@ cdef class AlignmentFile(HTSFile):
     def __dealloc__(self):
         cdef int ret = 0
 
+        pysam_prefetch_destroy(self.prefetch_reader)
+        self.prefetch_reader = NULL
+
         if self.htsfile != NULL:
             ret = hts_close(self.htsfile)
             self.htsfile = NULL
@@ -1828,6 +2499,41 @@ cdef class AlignmentFile(HTSFile):
 
         return results
 
+    def partition(self, n):
+        """split the genome into `n` lists of regions with about the
+        same amount of data.
+
+        The size of each part is estimated from the file offsets
+        recorded in the index, so that regions dense in reads are cut
+        finer than sparse ones. Each list covers a contiguous part of
+        the file. Contigs without reads are left out, and for
+        :term:`CRAM` files, whose index records no offsets, regions
+        are weighted by their length.
+
+        Reads without coordinates are returned as an extra list
+        containing the single region ``("*", None, None)`` if the index
+        records any. For :term:`CRAM` files this list is always added.
+
+        Regions are tuples (contig, start, stop) which can be passed
+        to :meth:`fetch`. Note that reads overlapping the boundary of
+        two regions are fetched for both.
+
+        Returns
+        -------
+
+        list : `n` lists of regions, followed by the list of reads
+        without coordinates if present.
+
+        """
+        self.check_index()
+        contigs = [(tid, name, length) for tid, (name, length)
+                   in enumerate(zip(self.references, self.lengths))]
+        partitions = self.partition_index(self.index, contigs, n)
+        if hts_idx_fmt(self.index) == HTS_FMT_CRAI or \
+           hts_idx_get_n_no_coor(self.index) > 0:
+            partitions.append([("*", None, None)])
+        return partitions
+
     ###############################################################
     ## file-object like iterator access
     ## note: concurrent access will cause errors (see IteratorRow
@@ -1857,10 +2563,29 @@ cdef class AlignmentFile(HTSFile):
                             self.b)
         return ret
 
+    cdef bam1_t *prefetch_next(self, int size, int *ret) except? NULL:
+        '''return the next read decoded in the background from the
+        current file position, setting *ret* as :meth:`cnext` would.'''
+        cdef void *rec = NULL
+        if self.prefetch_reader == NULL:
+            self.prefetch_reader = pysam_prefetch_init(
+                PYSAM_PREFETCH_SAM, size, self.htsfile, self.header.ptr,
+                NULL, NULL, 0)
+            if self.prefetch_reader == NULL:
+                raise MemoryError("could not start reading ahead")
+        with nogil:
+            ret[0] = pysam_prefetch_next(self.prefetch_reader, &rec)
+        return <bam1_t *>rec
+
     def __next__(self):
-        cdef int ret = self.cnext()
+        cdef int ret
+        cdef bam1_t *b = self.b
+        if self.prefetch > 0:
+            b = self.prefetch_next(self.prefetch, &ret)
+        else:
+            ret = self.cnext()
         if ret >= 0:
-            return makeAlignedSegment(self.b, self.header)
+            return makeAlignedSegment(b, self.header)
         elif ret == -1:
             raise StopIteration
         else:
@@ -1979,7 +2704,8 @@ cdef class IteratorRow:
 
     '''
 
-    def __init__(self, AlignmentFile samfile, int multiple_iterators=False):
+    def __init__(self, AlignmentFile samfile, int multiple_iterators=False,
+                 int prefetch=0, filter=None):
         cdef char *cfilename
         cdef char *creference_filename
         cdef char *cindexname = NULL
@@ -1990,33 +2716,33 @@ cdef class IteratorRow:
         # makes sure that samfile stays alive as long as the
         # iterator is alive
         self.samfile = samfile
+        self.prefetch = prefetch
+        self.reader = NULL
 
-        # reopen the file - note that this makes the iterator
-        # slow and causes pileup to slow down significantly.
+        # reopen the file, sharing the index and header of samfile
         if multiple_iterators:
 
             cfilename = samfile.filename
             with nogil:
                 self.htsfile = hts_open(cfilename, 'r')
             assert self.htsfile != NULL
+            self.owns_samfile = True
 
             if samfile.has_index():
-                if samfile.index_filename:
-                    cindexname = bindex_filename = encode_filename(samfile.index_filename)
-                with nogil:
-                    self.index = sam_index_load2(self.htsfile, cfilename, cindexname)
+                # BAI/CSI indices can be shared, CRAM indices are tied
+                # to the file handle they were loaded for
+                self.index = hts_idx_share(samfile.index)
+                if self.index == NULL:
+                    if samfile.index_filename:
+                        cindexname = bindex_filename = encode_filename(samfile.index_filename)
+                    with nogil:
+                        self.index = sam_index_load2(self.htsfile, cfilename, cindexname)
             else:
                 self.index = NULL
 
-            # need to advance in newly opened file to position after header
-            # better: use seek/tell?
-            with nogil:
-                hdr = sam_hdr_read(self.htsfile)
-            if hdr is NULL:
-                raise IOError("unable to read header information")
-            self.header = makeAlignmentHeader(hdr)
-
-            self.owns_samfile = True
+            skip_header(samfile, self.htsfile)
+            set_filter(self.htsfile, samfile.filter, samfile.header)
+            self.header = samfile.header
 
             # options specific to CRAM files
             if samfile.is_cram and samfile.reference_filename:
@@ -2026,6 +2752,7 @@ cdef class IteratorRow:
                             creference_filename)
 
         else:
+            samfile.stop_prefetch()
             self.htsfile = samfile.htsfile
             self.index = samfile.index
             self.owns_samfile = False
@@ -2035,7 +2762,75 @@ cdef class IteratorRow:
 
         self.b = bam_init1()
 
+        # applied on top of the filter of the filehandle
+        if filter is not None:
+            self.filter = compile_filter(filter, samfile.header)
+
+    cdef bam1_t *prefetch_next(self, hts_itr_t *iter) except? NULL:
+        '''return the next read decoded in the background, setting
+        self.retval. Reads through the filehandle of samfile are shared
+        with it.'''
+        cdef void *rec = NULL
+        cdef int ret, passes
+        if self.htsfile != self.samfile.htsfile and self.reader == NULL:
+            self.reader = pysam_prefetch_init(
+                PYSAM_PREFETCH_SAM, self.prefetch, self.htsfile,
+                self.header.ptr, iter, NULL, 0)
+            if self.reader == NULL:
+                raise MemoryError("could not start reading ahead")
+
+        while True:
+            if self.reader == NULL:
+                rec = self.samfile.prefetch_next(self.prefetch, &ret)
+            else:
+                with nogil:
+                    ret = pysam_prefetch_next(self.reader, &rec)
+            if ret < 0:
+                break
+            passes = read_passes(self.filter, self.header.ptr, <bam1_t *>rec)
+            if passes < 0:
+                ret = -2
+            if passes != 0:
+                break
+        self.retval = ret
+        return <bam1_t *>rec
+
+    cdef stop_prefetch(self):
+        pysam_prefetch_destroy(self.reader)
+        self.reader = NULL
+
+    cdef int visit(self, read_visitor_f func, void *data) except -1:
+        '''call *func* on each remaining read without returning to
+        Python in between.'''
+        raise NotImplementedError(
+            "{} cannot be visited".format(self.__class__.__name__))
+
+    cdef int visit_iter(self, hts_itr_t *iter, bint use_iter,
+                        read_visitor_f func, void *data) except -1:
+        '''call *func* on each read passing the filter, read through
+        *iter* if *use_iter* is set or else from the current position.'''
+        cdef htsFile *fp = self.htsfile
+        cdef bam_hdr_t *hdr = self.header.ptr
+        cdef hts_filter_t *filt = self.filter
+        cdef bam1_t *b = self.b
+        cdef int ret
+
+        if self.reader != NULL:
+            raise ValueError("reads have already been read ahead")
+        if self.htsfile == self.samfile.htsfile:
+            self.samfile.stop_prefetch()
+
+        with nogil:
+            ret = visit_reads(fp, hdr, iter, use_iter, filt, b, func, data)
+        if ret == 1:
+            raise MemoryError("could not process read")
+        elif ret < 0:
+            raise IOError(read_failure_reason(ret))
+        return 0
+
     def __dealloc__(self):
+        self.stop_prefetch()
+        hts_filter_free(self.filter)
         bam_destroy1(self.b)
         if self.owns_samfile:
             hts_close(self.htsfile)
@@ -2058,19 +2853,35 @@ cdef class IteratorRowRegion(IteratorRow):
 
     def __init__(self, AlignmentFile samfile,
                  int tid, int beg, int stop,
-                 int multiple_iterators=False):
+                 int multiple_iterators=False,
+                 int prefetch=0,
+                 filter=None):
 
         if not samfile.has_index():
             raise ValueError("no index available for iteration")
 
+        # reading ahead needs a filehandle of its own
+        if prefetch > 0 and not samfile.is_stream:
+            multiple_iterators = True
+        else:
+            prefetch = 0
+
         IteratorRow.__init__(self, samfile,
-                             multiple_iterators=multiple_iterators)
+                             multiple_iterators=multiple_iterators,
+                             prefetch=prefetch,
+                             filter=filter)
+        global errno
+        errno = 0
         with nogil:
             self.iter = sam_itr_queryi(
                 self.index,
                 tid,
                 beg,
                 stop)
+        # a lazily loaded index reads the entries of tid only now
+        if self.iter == NULL and errno == EIO:
+            raise IOError("could not read the index entries of {}".format(
+                samfile.get_reference_name(tid)))
 
     def __iter__(self):
         return self
@@ -2080,16 +2891,31 @@ cdef class IteratorRowRegion(IteratorRow):
 
     cdef int cnext(self):
         '''cversion of iterator. Used by IteratorColumn'''
+        cdef hts_filter_t *filt = self.filter
+        cdef bam_hdr_t *hdr = self.header.ptr
+        cdef int passes
         with nogil:
-            self.retval = hts_itr_next(hts_get_bgzfp(self.htsfile),
-                                       self.iter,
-                                       self.b,
-                                       self.htsfile)
+            while 1:
+                self.retval = hts_itr_next(hts_get_bgzfp(self.htsfile),
+                                           self.iter,
+                                           self.b,
+                                           self.htsfile)
+                if self.retval < 0:
+                    break
+                passes = read_passes(filt, hdr, self.b)
+                if passes < 0:
+                    self.retval = -2
+                if passes != 0:
+                    break
 
     def __next__(self):
-        self.cnext()
+        cdef bam1_t *b = self.b
+        if self.prefetch > 0 and self.iter != NULL:
+            b = self.prefetch_next(self.iter)
+        else:
+            self.cnext()
         if self.retval >= 0:
-            return makeAlignedSegment(self.b, self.header)
+            return makeAlignedSegment(b, self.header)
         elif self.retval == -1:
             raise StopIteration
         elif self.retval == -2:
@@ -2100,7 +2926,12 @@ cdef class IteratorRowRegion(IteratorRow):
         else:
             raise IOError("error while reading file {}: {}".format(self.samfile.filename, self.retval))
 
+    cdef int visit(self, read_visitor_f func, void *data) except -1:
+        return self.visit_iter(self.iter, True, func, data)
+
     def __dealloc__(self):
+        # the reader must stop before its iterator goes away
+        self.stop_prefetch()
         hts_itr_destroy(self.iter)
 
 
@@ -2171,10 +3002,14 @@ cdef class IteratorRowAll(IteratorRow):
     """
 
     def __init__(self, AlignmentFile samfile,
-                 int multiple_iterators=False):
+                 int multiple_iterators=False,
+                 int prefetch=0,
+                 filter=None):
 
         IteratorRow.__init__(self, samfile,
-                             multiple_iterators=multiple_iterators)
+                             multiple_iterators=multiple_iterators,
+                             prefetch=prefetch,
+                             filter=filter)
 
     def __iter__(self):
         return self
@@ -2184,18 +3019,36 @@ cdef class IteratorRowAll(IteratorRow):
 
     cdef int cnext(self):
         '''cversion of iterator. Used by IteratorColumn'''
-        cdef int ret
+        cdef int ret, passes
         cdef bam_hdr_t * hdr = self.header.ptr
+        cdef hts_filter_t *filt = self.filter
         with nogil:
-            ret = sam_read1(self.htsfile,
-                            hdr,
-                            self.b)
+            while 1:
+                ret = sam_read1(self.htsfile,
+                                hdr,
+                                self.b)
+                if ret < 0:
+                    break
+                passes = read_passes(filt, hdr, self.b)
+                if passes < 0:
+                    ret = -2
+                if passes != 0:
+                    break
         return ret
 
+    cdef int visit(self, read_visitor_f func, void *data) except -1:
+        return self.visit_iter(NULL, False, func, data)
+
     def __next__(self):
-        cdef int ret = self.cnext()
+        cdef int ret
+        cdef bam1_t *b = self.b
+        if self.prefetch > 0:
+            b = self.prefetch_next(NULL)
+            ret = self.retval
+        else:
+            ret = self.cnext()
         if ret >= 0:
-            return makeAlignedSegment(self.b, self.header)
+            return makeAlignedSegment(b, self.header)
         elif ret == -1:
             raise StopIteration
         else:
@@ -2214,10 +3067,20 @@ cdef class IteratorRowAllRefs(IteratorRow):
     """
 
     def __init__(self, AlignmentFile samfile,
-                 multiple_iterators=False):
+                 multiple_iterators=False,
+                 int prefetch=0,
+                 filter=None):
+
+        # reading ahead needs a filehandle of its own
+        if prefetch > 0 and not samfile.is_stream:
+            multiple_iterators = True
+        else:
+            prefetch = 0
 
         IteratorRow.__init__(self, samfile,
-                             multiple_iterators=multiple_iterators)
+                             multiple_iterators=multiple_iterators,
+                             prefetch=prefetch,
+                             filter=filter)
 
         if not samfile.has_index():
             raise ValueError("no index available for fetch")
@@ -2239,6 +3102,7 @@ cdef class IteratorRowAllRefs(IteratorRow):
         # make sure the iterator understand that IteratorRowAllRefs
         # has ownership
         self.rowiter.owns_samfile = False
+        self.rowiter.prefetch = self.prefetch
 
     def __iter__(self):
         return self
@@ -2251,12 +3115,24 @@ cdef class IteratorRowAllRefs(IteratorRow):
             self.tid = 0
             self.nextiter()
 
+        cdef bam1_t *b
+        cdef int passes
         while 1:
-            self.rowiter.cnext()
+            b = self.rowiter.b
+            if self.prefetch > 0 and self.rowiter.iter != NULL:
+                b = self.rowiter.prefetch_next(self.rowiter.iter)
+            else:
+                self.rowiter.cnext()
 
             # If current iterator is not exhausted, return aligned read
             if self.rowiter.retval > 0:
-                return makeAlignedSegment(self.rowiter.b, self.header)
+                # the filter is compiled once here, not for each reference
+                passes = read_passes(self.filter, self.header.ptr, b)
+                if passes < 0:
+                    raise IOError("could not evaluate filter expression")
+                if passes == 0:
+                    continue
+                return makeAlignedSegment(b, self.header)
 
             self.tid += 1
 
@@ -2266,6 +3142,21 @@ cdef class IteratorRowAllRefs(IteratorRow):
             else:
                 raise StopIteration
 
+    cdef int visit(self, read_visitor_f func, void *data) except -1:
+        if self.rowiter is not None and self.rowiter.reader != NULL:
+            raise ValueError("reads have already been read ahead")
+        if self.tid == -1:
+            self.tid = 0
+            if self.tid < self.samfile.nreferences:
+                self.nextiter()
+        while self.tid < self.samfile.nreferences:
+            # the filter is that of this iterator, not of rowiter
+            self.visit_iter(self.rowiter.iter, True, func, data)
+            self.tid += 1
+            if self.tid < self.samfile.nreferences:
+                self.nextiter()
+        return 0
+
 
 cdef class IteratorRowSelection(IteratorRow):
     """*(AlignmentFile samfile)*
@@ -2320,13 +3211,32 @@ cdef class IteratorRowSelection(IteratorRow):
             raise IOError(read_failure_reason(ret))
 
 
+cdef int __read_next(__iterdata *d, bam1_t *b, bint use_iter) nogil:
+    '''read the next read matching the filter expression given to
+    pileup, through the iterator if *use_iter* is set.
+    '''
+    cdef int ret, passes
+    while 1:
+        if use_iter:
+            ret = sam_itr_next(d.htsfile, d.iter, b)
+        else:
+            ret = sam_read1(d.htsfile, d.header, b)
+        if ret < 0:
+            return ret
+        passes = read_passes(d.filter, d.header, b)
+        if passes < 0:
+            return -2
+        if passes != 0:
+            return ret
+
+
 cdef int __advance_nofilter(void *data, bam1_t *b):
     '''advance without any read filtering.
     '''
     cdef __iterdata * d = <__iterdata*>data
     cdef int ret
     with nogil:
-        ret = sam_itr_next(d.htsfile, d.iter, b)
+        ret = __read_next(d, b, True)
     return ret
 
 
@@ -2336,7 +3246,7 @@ cdef int __advance_raw_nofilter(void *data, bam1_t *b):
     cdef __iterdata * d = <__iterdata*>data
     cdef int ret
     with nogil:
-        ret = sam_read1(d.htsfile, d.header, b)
+        ret = __read_next(d, b, False)
     return ret
 
 
@@ -2351,7 +3261,7 @@ cdef int __advance_all(void *data, bam1_t *b):
     cdef int ret
     while 1:
         with nogil:
-            ret = sam_itr_next(d.htsfile, d.iter, b)
+            ret = __read_next(d, b, True)
         if ret < 0:
             break
         if b.core.flag & d.flag_filter:
@@ -2370,7 +3280,7 @@ cdef int __advance_raw_all(void *data, bam1_t *b):
     cdef int ret
     while 1:
         with nogil:
-            ret = sam_read1(d.htsfile, d.header, b)
+            ret = __read_next(d, b, False)
         if ret < 0:
             break
         if b.core.flag & d.flag_filter:
@@ -2389,7 +3299,7 @@ cdef int __advance_samtools(void * data, bam1_t * b):
 
     while 1:
         with nogil:
-            ret = sam_itr_next(d.htsfile, d.iter, b) if d.iter else sam_read1(d.htsfile, d.header, b)
+            ret = __read_next(d, b, d.iter != NULL)
         if ret < 0:
             break
         if b.core.flag & d.flag_filter:
@@ -2487,6 +3397,9 @@ cdef class IteratorColumn:
         self.iterdata.compute_baq = kwargs.get("compute_baq", True)
         self.iterdata.redo_baq = kwargs.get("redo_baq", False)
         self.iterdata.ignore_orphans = kwargs.get("ignore_orphans", True)
+        self.iterdata.filter = NULL
+        if kwargs.get("filter") is not None:
+            self.iterdata.filter = compile_filter(kwargs["filter"], samfile.header)
 
         self.tid = 0
         self.pos = 0
@@ -2540,6 +3453,7 @@ cdef class IteratorColumn:
         '''setup the iterator structure'''
 
         self.iter = IteratorRowRegion(self.samfile, tid, start, stop, multiple_iterators)
+        self.samfile.stop_prefetch()
         self.iterdata.htsfile = self.samfile.htsfile
         self.iterdata.iter = self.iter.iter
         self.iterdata.seq = NULL
@@ -2590,6 +3504,7 @@ cdef class IteratorColumn:
 
         self.iter = None
         self.iterdata.iter = NULL
+        self.samfile.stop_prefetch()
         self.iterdata.htsfile = self.samfile.htsfile
         self.iterdata.seq = NULL
         self.iterdata.tid = -1
@@ -2680,6 +3595,9 @@ cdef class IteratorColumn:
             free(self.iterdata.seq)
             self.iterdata.seq = NULL
 
+        hts_filter_free(self.iterdata.filter)
+        self.iterdata.filter = NULL
+
     # backwards compatibility
 
     def hasReference(self):
@@ -2911,16 +3829,13 @@ cdef class IndexedReads:
                 self.htsfile = hts_open(cfilename, 'r')
             if self.htsfile == NULL:
                 raise OSError("unable to reopen htsfile")
-
-            # need to advance in newly opened file to position after header
-            # better: use seek/tell?
-            with nogil:
-                hdr = sam_hdr_read(self.htsfile)
-            if hdr == NULL:
-                raise OSError("unable to read header information")
-            self.header = makeAlignmentHeader(hdr)
             self.owns_samfile = True
+
+            skip_header(samfile, self.htsfile)
+            set_filter(self.htsfile, samfile.filter, samfile.header)
+            self.header = samfile.header
         else:
+            self.samfile.stop_prefetch()
             self.htsfile = self.samfile.htsfile
             self.header = samfile.header
             self.owns_samfile = False
@@ -117,6 +117,10 @@ cdef class TabixIndex(BaseIndex):
 cdef class BaseIterator(object):
     cdef VariantFile bcf
     cdef hts_itr_t  *iter
+    cdef int prefetch
+    cdef pysam_prefetch_t *reader
+    cdef void *prefetch_next(self, int type, tbx_t *tbx, int *ret) except? NULL
+    cdef stop_prefetch(self)
 
 
 cdef class BCFIterator(BaseIterator):
@@ -138,4 +142,5 @@ cdef class VariantFile(HTSFile):
     cdef readonly bint       is_reading     # true if file has begun reading records
     cdef readonly bint       header_written # true if header has already been written
 
+    cdef bcf1_t *prefetch_next(self, int *ret) except? NULL
     cpdef int write(self, VariantRecord record) except -1
@@ -3709,8 +3709,8 @@ cdef class BCFIndex(object):
             hts_idx_destroy(self.ptr)
             self.ptr = NULL
 
-    def fetch(self, bcf, contig, start, stop, reopen):
-        return BCFIterator(bcf, contig, start, stop, reopen)
+    def fetch(self, bcf, contig, start, stop, reopen, prefetch=0):
+        return BCFIterator(bcf, contig, start, stop, reopen, prefetch)
 
 
 cdef BCFIndex makeBCFIndex(VariantHeader header, hts_idx_t *idx):
@@ -3748,8 +3748,8 @@ cdef class TabixIndex(BaseIndex):
             tbx_destroy(self.ptr)
             self.ptr = NULL
 
-    def fetch(self, bcf, contig, start, stop, reopen):
-        return TabixIterator(bcf, contig, start, stop, reopen)
+    def fetch(self, bcf, contig, start, stop, reopen, prefetch=0):
+        return TabixIterator(bcf, contig, start, stop, reopen, prefetch)
 
 
 cdef TabixIndex makeTabixIndex(tbx_t *idx):
@@ -3770,13 +3770,30 @@ cdef TabixIndex makeTabixIndex(tbx_t *idx):
 
 
 cdef class BaseIterator(object):
-    pass
+    cdef void *prefetch_next(self, int type, tbx_t *tbx, int *ret) except? NULL:
+        '''return the next record or line read through self.iter in the
+        background, setting *ret* as reading it did.'''
+        cdef void *rec = NULL
+        if self.reader == NULL:
+            self.reader = pysam_prefetch_init(
+                type, self.prefetch, self.bcf.htsfile, self.bcf.header.ptr,
+                self.iter, tbx, BCF_UN_SHR if self.bcf.drop_samples else 0)
+            if self.reader == NULL:
+                raise MemoryError('unable to start reading ahead')
+        with nogil:
+            ret[0] = pysam_prefetch_next(self.reader, &rec)
+        return rec
+
+    cdef stop_prefetch(self):
+        pysam_prefetch_destroy(self.reader)
+        self.reader = NULL
 
 
 # Internal function to clean up after iteration stop or failure.
 # This would be a nested function if it weren't a cdef function.
 cdef void _stop_BCFIterator(BCFIterator self, bcf1_t *record):
     bcf_destroy1(record)
+    self.stop_prefetch()
 
     # destroy iter so future calls to __next__ raise StopIteration
     bcf_itr_destroy(self.iter)
@@ -3784,7 +3801,7 @@ cdef void _stop_BCFIterator(BCFIterator self, bcf1_t *record):
 
 
 cdef class BCFIterator(BaseIterator):
-    def __init__(self, VariantFile bcf, contig=None, start=None, stop=None, reopen=True):
+    def __init__(self, VariantFile bcf, contig=None, start=None, stop=None, reopen=True, prefetch=0):
         if bcf is None:
             raise ValueError('bcf must not be None')
 
@@ -3798,6 +3815,7 @@ cdef class BCFIterator(BaseIterator):
 
         self.bcf = bcf
         self.index = index
+        self.prefetch = prefetch
 
         cdef int rid, cstart, cstop
 
@@ -3808,7 +3826,8 @@ cdef class BCFIterator(BaseIterator):
             self.iter = NULL
             return
 
-        if reopen:
+        # reading ahead needs a filehandle of its own
+        if reopen or prefetch > 0:
             self.bcf = self.bcf.copy()
 
         cstart = start if start is not None else 0
@@ -3824,6 +3843,7 @@ cdef class BCFIterator(BaseIterator):
                 raise IOError('unable to fetch {}:{}-{}'.format(contig, start+1, stop))
 
     def __dealloc__(self):
+        self.stop_prefetch()
         if self.iter:
             bcf_itr_destroy(self.iter)
             self.iter = NULL
@@ -3835,19 +3855,27 @@ cdef class BCFIterator(BaseIterator):
         if not self.iter:
             raise StopIteration
 
-        cdef bcf1_t *record = bcf_init1()
+        cdef bcf1_t *record
+        cdef int ret
 
-        if not record:
-            raise MemoryError('unable to allocate BCF record')
+        if self.prefetch > 0:
+            record = NULL
+            if self.prefetch_next(PYSAM_PREFETCH_BCF, NULL, &ret) != NULL:
+                record = <bcf1_t *>pysam_prefetch_take(self.reader)
+                if not record:
+                    raise MemoryError('unable to allocate BCF record')
+        else:
+            record = bcf_init1()
 
-        record.pos = -1
-        if self.bcf.drop_samples:
-            record.max_unpack = BCF_UN_SHR
+            if not record:
+                raise MemoryError('unable to allocate BCF record')
 
-        cdef int ret
+            record.pos = -1
+            if self.bcf.drop_samples:
+                record.max_unpack = BCF_UN_SHR
 
-        with nogil:
-            ret = bcf_itr_next(self.bcf.htsfile, self.iter, record)
+            with nogil:
+                ret = bcf_itr_next(self.bcf.htsfile, self.iter, record)
 
         if ret < 0:
             _stop_BCFIterator(self, record)
@@ -3875,7 +3903,7 @@ cdef class TabixIterator(BaseIterator):
         self.line_buffer.m = 0
         self.line_buffer.s = NULL
 
-    def __init__(self, VariantFile bcf, contig=None, start=None, stop=None, reopen=True):
+    def __init__(self, VariantFile bcf, contig=None, start=None, stop=None, reopen=True, prefetch=0):
         if bcf is None:
             raise ValueError('bcf must not be None')
 
@@ -3886,6 +3914,7 @@ cdef class TabixIterator(BaseIterator):
 
         self.bcf = bcf
         self.index = index
+        self.prefetch = prefetch
 
         cdef int rid, cstart, cstop
 
@@ -3896,7 +3925,8 @@ cdef class TabixIterator(BaseIterator):
             self.iter = NULL
             return
 
-        if reopen:
+        # reading ahead needs a filehandle of its own
+        if reopen or prefetch > 0:
             self.bcf = self.bcf.copy()
 
         cstart = start if start is not None else 0
@@ -3911,6 +3941,7 @@ cdef class TabixIterator(BaseIterator):
                 raise IOError('unable to fetch {}:{}-{}'.format(contig, start+1, stop))
 
     def __dealloc__(self):
+        self.stop_prefetch()
         if self.iter:
             tbx_itr_destroy(self.iter)
             self.iter = NULL
@@ -3930,11 +3961,16 @@ cdef class TabixIterator(BaseIterator):
             raise StopIteration
 
         cdef int ret
+        cdef kstring_t *line = &self.line_buffer
 
-        with nogil:
-            ret = tbx_itr_next(self.bcf.htsfile, self.index.ptr, self.iter, &self.line_buffer)
+        if self.prefetch > 0:
+            line = <kstring_t *>self.prefetch_next(PYSAM_PREFETCH_VCF, self.index.ptr, &ret)
+        else:
+            with nogil:
+                ret = tbx_itr_next(self.bcf.htsfile, self.index.ptr, self.iter, line)
 
         if ret < 0:
+            self.stop_prefetch()
             tbx_itr_destroy(self.iter)
             self.iter = NULL
             if ret == -1:
@@ -3955,7 +3991,7 @@ cdef class TabixIterator(BaseIterator):
         if self.bcf.drop_samples:
             record.max_unpack = BCF_UN_SHR
 
-        ret = vcf_parse1(&self.line_buffer, self.bcf.header.ptr, record)
+        ret = vcf_parse1(line, self.bcf.header.ptr, record)
 
         # FIXME: stop iteration on parse failure?
         if ret < 0:
@@ -3973,7 +4009,7 @@ cdef class TabixIterator(BaseIterator):
 
 cdef class VariantFile(HTSFile):
     """*(filename, mode=None, index_filename=None, header=None, drop_samples=False,
-    duplicate_filehandle=True, ignore_truncation=False, threads=1)*
+    duplicate_filehandle=True, ignore_truncation=False, threads=1, prefetch=0)*
 
     A :term:`VCF`/:term:`BCF` formatted file. The file is automatically
     opened.
@@ -4033,6 +4069,16 @@ cdef class VariantFile(HTSFile):
         Setting threads to > 1 cannot be combined with `ignore_truncation`.
         (Default=1)
 
+    prefetch: integer
+        Number of records to read ahead in a background thread when
+        iterating, so that decoding overlaps with the processing of
+        earlier records in Python. Region iterators returned by
+        :meth:`fetch` read ahead through their own copy of the
+        filehandle. 0 reads each record when it is requested.
+        Uncompressed VCF files cannot be repositioned, so seeking
+        or fetching before the whole file has been read raises
+        IOError as the records read ahead would be lost. (Default=0)
+
     """
     def __cinit__(self, *args, **kwargs):
         self.htsfile = NULL
@@ -4057,6 +4103,9 @@ cdef class VariantFile(HTSFile):
         if not self.htsfile or not self.header:
             return
 
+        pysam_prefetch_destroy(self.prefetch_reader)
+        self.prefetch_reader = NULL
+
         # Write header if no records were written
         if self.htsfile.is_write and not self.header_written:
             with nogil:
@@ -4078,6 +4127,9 @@ cdef class VariantFile(HTSFile):
         if not self.htsfile:
             return
 
+        pysam_prefetch_destroy(self.prefetch_reader)
+        self.prefetch_reader = NULL
+
         # Write header if no records were written
         if self.htsfile.is_write and not self.header_written:
             with nogil:
@@ -4104,11 +4156,36 @@ cdef class VariantFile(HTSFile):
         self.is_reading = 1
         return self
 
-    def __next__(self):
-        cdef int ret
-        cdef int errcode
-        cdef bcf1_t *record = bcf_init1()
+    cdef bcf1_t *prefetch_next(self, int *ret) except? NULL:
+        '''return the next record read in the background from the current
+        file position, setting *ret* as bcf_read1 would.'''
+        cdef void *rec = NULL
+        cdef bcf1_t *record
+        cdef int rtype = PYSAM_PREFETCH_BCF if self.htsfile.format.format == bcf else PYSAM_PREFETCH_VCF
+
+        if self.prefetch_reader == NULL:
+            self.prefetch_reader = pysam_prefetch_init(
+                rtype, self.prefetch, self.htsfile, self.header.ptr, NULL, NULL,
+                BCF_UN_SHR if self.drop_samples else 0)
+            if self.prefetch_reader == NULL:
+                raise MemoryError('unable to start reading ahead')
+
+        with nogil:
+            ret[0] = pysam_prefetch_next(self.prefetch_reader, &rec)
+        if rec == NULL:
+            return NULL
+
+        if rtype == PYSAM_PREFETCH_BCF:
+            record = <bcf1_t *>pysam_prefetch_take(self.prefetch_reader)
+            if not record:
+                raise MemoryError('unable to allocate BCF record')
+            return record
 
+        # VCF lines are parsed here as parsing may add to the header
+        if ret[0] < 0:
+            return NULL
+
+        record = bcf_init1()
         if not record:
             raise MemoryError('unable to allocate BCF record')
 
@@ -4116,11 +4193,31 @@ cdef class VariantFile(HTSFile):
         if self.drop_samples:
             record.max_unpack = BCF_UN_SHR
 
-        with nogil:
-            ret = bcf_read1(self.htsfile, self.header.ptr, record)
+        ret[0] = vcf_parse1(<kstring_t *>rec, self.header.ptr, record)
+        return record
+
+    def __next__(self):
+        cdef int ret
+        cdef int errcode
+        cdef bcf1_t *record
+
+        if self.prefetch > 0:
+            record = self.prefetch_next(&ret)
+        else:
+            record = bcf_init1()
+
+            if not record:
+                raise MemoryError('unable to allocate BCF record')
+
+            record.pos = -1
+            if self.drop_samples:
+                record.max_unpack = BCF_UN_SHR
+
+            with nogil:
+                ret = bcf_read1(self.htsfile, self.header.ptr, record)
 
         if ret < 0:
-            errcode = record.errcode
+            errcode = record.errcode if record else 0
             bcf_destroy1(record)
             if errcode:
                 raise IOError('unable to parse next record')
@@ -4156,6 +4253,7 @@ cdef class VariantFile(HTSFile):
         vars.filename       = self.filename
         vars.mode           = self.mode
         vars.threads        = self.threads
+        vars.prefetch       = self.prefetch
         vars.index_filename = self.index_filename
         vars.drop_samples   = self.drop_samples
         vars.is_stream      = self.is_stream
@@ -4166,6 +4264,12 @@ cdef class VariantFile(HTSFile):
 
         if self.htsfile.is_bin:
             vars.seek(self.tell())
+        elif (not self.is_stream and self.start_offset >= 0 and
+              self.htsfile.format.compression in (bgzf, no_compression)):
+            # start at the first record rather than parsing the header
+            # again, which also loads the tabix index to look for
+            # missing contigs
+            vars.seek(self.start_offset)
         else:
             with nogil:
                 hdr = bcf_hdr_read(vars.htsfile)
@@ -4179,7 +4283,8 @@ cdef class VariantFile(HTSFile):
              drop_samples=False,
              duplicate_filehandle=True,
              ignore_truncation=False,
-             threads=1):
+             threads=1,
+             prefetch=0):
         """open a vcf/bcf file.
 
         If open is called on an existing VariantFile, the current file will be
@@ -4206,6 +4311,10 @@ cdef class VariantFile(HTSFile):
         if self.is_open:
             self.close()
 
+        if prefetch < 0:
+            raise ValueError('prefetch must not be negative')
+        self.prefetch = prefetch
+
         if not mode or mode[0] not in 'rwa':
             raise ValueError('mode must begin with r, w or a')
 
@@ -4363,7 +4472,43 @@ cdef class VariantFile(HTSFile):
             raise ValueError('Invalid tid')
         return bcf_str_cache_get_charptr(bcf_hdr_id2name(hdr, rid))
 
-    def fetch(self, contig=None, start=None, stop=None, region=None, reopen=False, end=None, reference=None):
+    def partition(self, n):
+        """split the indexed contigs into *n* lists of regions with about
+        the same amount of data, estimated from the file offsets recorded
+        in the index.
+
+        Each list covers a contiguous part of the file and contains
+        (contig, start, stop) tuples that can be passed to :meth:`fetch`.
+        Contigs without a length in the header are not split, and
+        records overlapping the boundary of two regions are fetched for
+        both.
+        """
+        if not self.is_open:
+            raise ValueError('I/O operation on closed file')
+
+        if self.index is None:
+            raise ValueError('partition requires an index')
+
+        cdef hts_idx_t *idx
+        cdef tbx_t *tbx
+        contigs = []
+        if isinstance(self.index, BCFIndex):
+            idx = (<BCFIndex>self.index).ptr
+            for name in self.index:
+                contigs.append((self.get_tid(name), name))
+        else:
+            tbx = (<TabixIndex>self.index).ptr
+            idx = tbx.idx
+            for name in self.index:
+                contigs.append((tbx_name2id(tbx, force_bytes(name)), name))
+
+        header_contigs = self.header.contigs
+        contigs = [(tid, name, header_contigs[name].length if name in header_contigs else None)
+                   for tid, name in contigs]
+        return self.partition_index(idx, contigs, n)
+
+    def fetch(self, contig=None, start=None, stop=None, region=None, reopen=False, end=None, reference=None,
+              prefetch=None):
         """fetch records in a :term:`region`, specified either by
         :term:`contig`, *start*, and *end* (which are 0-based, half-open);
         or alternatively by a samtools :term:`region` string (which is
@@ -4381,6 +4526,12 @@ cdef class VariantFile(HTSFile):
         If only *contig* is set, all records on *contig* will be fetched.
         If both *region* and *contig* are given, an exception is raised.
 
+        *prefetch* sets the number of records read ahead in a background
+        thread, see :class:`VariantFile`, and defaults to the value the
+        file was opened with.  Region iterators read ahead through their
+        own copy of the filehandle.  Without a region, the file (or its
+        copy if *reopen* is set) is returned and keeps the new value.
+
         Note that a bgzipped :term:`VCF`.gz file without a tabix/CSI index
         (.tbi/.csi) or a :term:`BCF` file without a CSI index can only be
         read sequentially.
@@ -4391,10 +4542,16 @@ cdef class VariantFile(HTSFile):
         if self.htsfile.is_write:
             raise ValueError('cannot fetch from Variantfile opened for writing')
 
+        if prefetch is None:
+            prefetch = self.prefetch
+        elif prefetch < 0:
+            raise ValueError('prefetch must not be negative')
+
         if contig is None and region is None:
             self.is_reading = 1
             bcf = self.copy() if reopen else self
             bcf.seek(self.start_offset)
+            (<VariantFile>bcf).prefetch = prefetch
             return iter(bcf)
 
         if self.index is None:
@@ -4407,7 +4564,7 @@ cdef class VariantFile(HTSFile):
             contig = self.get_reference_name(tid)
 
         self.is_reading = 1
-        return self.index.fetch(self, contig, start, stop, reopen)
+        return self.index.fetch(self, contig, start, stop, reopen, prefetch)
 
     def new_record(self, *args, **kwargs):
         """Create a new empty :class:`VariantRecord`.
@@ -4471,6 +4628,7 @@ cdef class VariantFile(HTSFile):
         if self.is_reading:
             raise ValueError('cannot subset samples after fetching records')
 
+        self.stop_prefetch()
         self.header._subset_samples(include_samples)
 
         # potentially unnecessary optimization that also sets max_unpack
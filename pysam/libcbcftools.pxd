@@ -1,4 +1,4 @@
-cdef extern from "bcftools.pysam.h":
+cdef extern from "bcftools.pysam.h" nogil:
 
     int bcftools_dispatch(int argc, char *argv[])
     void bcftools_set_stderr(int fd)
@@ -6,7 +6,7 @@ from libc.stdio cimport FILE, printf
 cimport cython
 
 from cpython cimport array
-from pysam.libchtslib cimport faidx_t, kstring_t, BGZF
+from pysam.libchtslib cimport faidx_t, kstring_t, BGZF, hts_tpool
 
 # These functions are put here and not in chtslib.pxd in order
 # to avoid warnings for unused functions.
@@ -34,6 +34,17 @@ cdef extern from "pysam_stream.h" nogil:
                     kstring_t * str,
                     int * dret)
 
+    ctypedef struct pysam_kseq_batch_t:
+        kstring_t data
+        size_t *off
+        int n
+        int ret
+
+    int pysam_kseq_read_pairs(kseq_t *ks1, kseq_t *ks2, int n,
+                              pysam_kseq_batch_t *b1, pysam_kseq_batch_t *b2,
+                              int concurrent)
+    void pysam_kseq_batch_destroy(pysam_kseq_batch_t *batch)
+
 cdef class FastaFile:
     cdef bint is_remote
     cdef object _filename, _references, _lengths, reference2length
@@ -69,6 +80,34 @@ cdef class FastxFile:
     cdef int cnext(self)
 
 
+cdef class FastxWriter:
+    cdef object _filename
+    cdef BGZF * fastxfile
+    cdef kstring_t buffer
+
+    cdef int _write(self, const char * name, size_t name_l,
+                    const char * comment, size_t comment_l,
+                    const char * sequence, size_t sequence_l,
+                    const char * quality, size_t quality_l) except -1
+    cdef int _flush(self) except -1
+
+
+cdef class PairedFastxFile:
+    cdef object _filename1, _filename2
+    cdef BGZF * fastqfile1
+    cdef BGZF * fastqfile2
+    cdef kseq_t * entry1
+    cdef kseq_t * entry2
+    cdef hts_tpool * pool
+    cdef int threads
+    cdef pysam_kseq_batch_t batch1
+    cdef pysam_kseq_batch_t batch2
+    cdef bint persist
+    cdef bint check_names
+
+    cdef int _raise_read_error(self, int l1, int l2) except -1
+
+
 # Compatibility Layer for pysam 0.8.1
 cdef class FastqFile(FastxFile):
     pass
@@ -8,6 +8,8 @@
 #
 # class FastaFile   random read read/write access to faidx indexd files
 # class FastxFile   streamed read/write access to fasta/fastq files
+# class FastxWriter streamed write access to fasta/fastq files
+# class PairedFastxFile  streamed read access to paired fasta/fastq files
 #
 # Additionally this module defines several additional classes that are part
 # of the internal API. These are:
@@ -66,7 +68,9 @@ from pysam.libchtslib cimport \
     faidx_nseq, fai_load, fai_load3, fai_destroy, fai_fetch, \
     faidx_seq_len, faidx_iseq, faidx_seq_len, \
     faidx_fetch_seq, hisremote, \
-    bgzf_open, bgzf_close
+    bgzf_open, bgzf_close, bgzf_write, bgzf_flush, bgzf_mt, \
+    bgzf_thread_pool, hts_tpool_init, hts_tpool_destroy, \
+    kputc, kputsn
 
 from pysam.libcutils cimport force_bytes, force_str, charptr_to_str
 from pysam.libcutils cimport encode_filename, from_string_and_size
@@ -656,6 +660,653 @@ cdef class FastxFile:
             raise ValueError('unknown problem parsing {0}'
                              .format(self._filename))
 
+# size of the formatting buffer before it is handed to BGZF
+cdef size_t FASTX_WRITE_BUFFER_SIZE = 1 << 20
+
+
+cdef inline int fastx_format(kstring_t * buffer,
+                             const char * name, size_t name_l,
+                             const char * comment, size_t comment_l,
+                             const char * sequence, size_t sequence_l,
+                             const char * quality, size_t quality_l) nogil:
+    '''append a record to *buffer*, return -1 if out of memory.
+
+    *comment* and *quality* may be NULL.
+    '''
+    cdef int ret = 0
+    ret |= kputc(c'>' if quality == NULL else c'@', buffer)
+    ret |= kputsn(name, name_l, buffer)
+    if comment != NULL:
+        ret |= kputc(c' ', buffer)
+        ret |= kputsn(comment, comment_l, buffer)
+    ret |= kputc(c'\n', buffer)
+    ret |= kputsn(sequence, sequence_l, buffer)
+    ret |= kputc(c'\n', buffer)
+    if quality != NULL:
+        ret |= kputsn(b"+\n", 2, buffer)
+        ret |= kputsn(quality, quality_l, buffer)
+        ret |= kputc(c'\n', buffer)
+    return -1 if ret < 0 else 0
+
+
+cdef fastx_check(name, sequence, quality):
+    '''raise ValueError if a record can not be written.'''
+    if name is None:
+        raise ValueError("can not write record without name")
+    if sequence is None:
+        raise ValueError("can not write record without a sequence")
+    if quality is not None and len(quality) != len(sequence):
+        raise ValueError("sequence and quality length do not match: {} vs {}".format(
+            len(sequence), len(quality)))
+
+
+cdef class FastxWriter:
+    """Stream write access to :term:`fasta` or :term:`fastq` formatted files.
+
+    The file is automatically opened. Records are formatted into a
+    large buffer and written through htslib's BGZF layer. Compressed
+    output is BGZF and can be read by any gzip-compatible tool.
+
+    Records without quality scores are written in fasta format, records
+    with quality scores in fastq format.
+
+    Parameters
+    ----------
+
+    filename : string
+        Filename of fasta/fastq file to be written.
+
+    threads : int
+        Number of threads used for compression (default 1).
+
+    level : int
+        Compression level from 0 to 9. The default (-1) uses the
+        BGZF default level.
+
+    compress : bool
+        If True, compress the output. If None (default), compress if
+        `filename` ends in ``.gz``, ``.bgz`` or ``.bgzf``.
+
+    Raises
+    ------
+
+    IOError
+        if file could not be opened
+
+    ValueError
+        if the compression level is not in the range -1 to 9
+
+    Examples
+    --------
+    >>> with pysam.FastxWriter(out_filename, threads=4) as fout:
+    ...    for entry in pysam.FastxFile(filename):
+    ...        fout.write(entry)
+
+    Records held in separate lists of fields are written in one go by
+    :meth:`write_many`:
+
+    >>> with pysam.FastxWriter(out_filename) as fout:
+    ...    fout.write_many(names, sequences, qualities)
+
+    """
+    def __cinit__(self, *args, **kwargs):
+        self._filename = None
+        self.fastxfile = NULL
+        self.buffer.l = self.buffer.m = 0
+        self.buffer.s = NULL
+        self._open(*args, **kwargs)
+
+    def is_open(self):
+        '''return true if file has been opened.'''
+        return self.fastxfile != NULL
+
+    def _open(self, filename, threads=1, level=-1, compress=None):
+        '''open a fastq/fasta file in *filename* for writing.'''
+        if self.fastxfile != NULL:
+            self.close()
+
+        if level < -1 or level > 9:
+            raise ValueError("invalid compression level {}".format(level))
+
+        self._filename = encode_filename(filename)
+        if compress is None:
+            compress = self._filename.endswith((b".gz", b".bgz", b".bgzf"))
+
+        if not compress:
+            mode = b"wu"
+        elif level >= 0:
+            mode = b"w%d" % level
+        else:
+            mode = b"w"
+
+        cdef char *cfilename = self._filename
+        cdef char *cmode = mode
+        with nogil:
+            self.fastxfile = bgzf_open(cfilename, cmode)
+
+        if self.fastxfile == NULL:
+            raise IOError("error when opening file `%s` for writing" % filename)
+
+        if compress and threads > 1:
+            if bgzf_mt(self.fastxfile, threads, 256) < 0:
+                self.close()
+                raise IOError("could not enable multi-threaded compression")
+
+        self._filename = filename
+
+    cdef int _flush(self) except -1:
+        '''hand the formatting buffer to BGZF.'''
+        cdef ssize_t ret = 0
+        if self.buffer.l == 0:
+            return 0
+        with nogil:
+            ret = bgzf_write(self.fastxfile, self.buffer.s, self.buffer.l)
+        if ret < 0:
+            raise IOError("error while writing to `%s`" % self._filename)
+        self.buffer.l = 0
+        return 0
+
+    cdef int _write(self, const char * name, size_t name_l,
+                    const char * comment, size_t comment_l,
+                    const char * sequence, size_t sequence_l,
+                    const char * quality, size_t quality_l) except -1:
+        '''format a record into the buffer. *quality* may be NULL.'''
+        cdef int ret = 0
+        with nogil:
+            ret = fastx_format(&self.buffer,
+                               name, name_l,
+                               comment, comment_l,
+                               sequence, sequence_l,
+                               quality, quality_l)
+        if ret < 0:
+            raise MemoryError("could not format record")
+        if self.buffer.l >= FASTX_WRITE_BUFFER_SIZE:
+            self._flush()
+        return 0
+
+    def write(self, record):
+        '''write a single record.
+
+        *record* can be a :class:`FastxRecord`, a :class:`FastqProxy`
+        or a tuple of ``(name, sequence)``, ``(name, sequence,
+        quality)`` or ``(name, sequence, quality, comment)``.
+        '''
+        if self.fastxfile == NULL:
+            raise ValueError("I/O operation on closed file")
+
+        cdef kseq_t * entry
+        if isinstance(record, FastqProxy):
+            # copy directly from the parser buffers
+            entry = (<FastqProxy>record)._delegate
+            self._write(entry.name.s, entry.name.l,
+                        entry.comment.s if entry.comment.l else NULL,
+                        entry.comment.l,
+                        entry.seq.s, entry.seq.l,
+                        entry.qual.s if entry.qual.l else NULL,
+                        entry.qual.l)
+            return
+
+        if isinstance(record, FastxRecord):
+            name = record.name
+            sequence = record.sequence
+            quality = record.quality
+            comment = record.comment
+        else:
+            if not 2 <= len(record) <= 4:
+                raise ValueError("expected a tuple of 2 to 4 fields, got {}".format(len(record)))
+            name, sequence = record[0], record[1]
+            quality = record[2] if len(record) > 2 else None
+            comment = record[3] if len(record) > 3 else None
+
+        fastx_check(name, sequence, quality)
+
+        bname = force_bytes(name)
+        bsequence = force_bytes(sequence)
+        cdef const char * cquality = NULL
+        cdef const char * ccomment = NULL
+        if quality is not None:
+            bquality = force_bytes(quality)
+            cquality = bquality
+        else:
+            bquality = b""
+        if comment is not None:
+            bcomment = force_bytes(comment)
+            ccomment = bcomment
+        else:
+            bcomment = b""
+
+        self._write(bname, len(bname),
+                    ccomment, len(bcomment),
+                    bsequence, len(bsequence),
+                    cquality, len(bquality))
+
+    def writelines(self, records):
+        '''write an iterable of records, see :meth:`write`.'''
+        for record in records:
+            self.write(record)
+
+    def write_many(self, names, sequences, qualities=None, comments=None):
+        '''write records given as lists of their fields.
+
+        *names* and *sequences* are sequences of strings of equal
+        length, as are *qualities* and *comments* if given. Entries
+        of *qualities* or *comments* may be None. The records are
+        formatted and written without holding the GIL.
+        '''
+        if self.fastxfile == NULL:
+            raise ValueError("I/O operation on closed file")
+
+        cdef Py_ssize_t n = len(names)
+        cdef Py_ssize_t i
+        if len(sequences) != n or \
+           (qualities is not None and len(qualities) != n) or \
+           (comments is not None and len(comments) != n):
+            raise ValueError("fields must have the same number of entries")
+        if n == 0:
+            return
+
+        # name, comment, sequence and quality of each record
+        cdef const char ** fields = <const char **>calloc(4 * n, sizeof(char *))
+        cdef size_t * lengths = <size_t *>calloc(4 * n, sizeof(size_t))
+        cdef bytes field
+        cdef int ret = 0
+        # keeps the encoded fields alive until written
+        encoded = []
+        try:
+            if fields == NULL or lengths == NULL:
+                raise MemoryError("could not allocate memory for {} records".format(n))
+
+            for i in range(n):
+                quality = qualities[i] if qualities is not None else None
+                comment = comments[i] if comments is not None else None
+                fastx_check(names[i], sequences[i], quality)
+                for j, value in ((0, names[i]), (1, comment),
+                                 (2, sequences[i]), (3, quality)):
+                    if value is None:
+                        continue
+                    field = force_bytes(value)
+                    encoded.append(field)
+                    fields[4 * i + j] = field
+                    lengths[4 * i + j] = len(field)
+
+            with nogil:
+                for i in range(n):
+                    ret = fastx_format(&self.buffer,
+                                       fields[4 * i], lengths[4 * i],
+                                       fields[4 * i + 1], lengths[4 * i + 1],
+                                       fields[4 * i + 2], lengths[4 * i + 2],
+                                       fields[4 * i + 3], lengths[4 * i + 3])
+                    if ret < 0:
+                        break
+                    if self.buffer.l >= FASTX_WRITE_BUFFER_SIZE:
+                        if bgzf_write(self.fastxfile, self.buffer.s,
+                                      self.buffer.l) < 0:
+                            ret = -2
+                            break
+                        self.buffer.l = 0
+        finally:
+            free(fields)
+            free(lengths)
+
+        if ret == -2:
+            raise IOError("error while writing to `%s`" % self._filename)
+        elif ret < 0:
+            raise MemoryError("could not format record")
+
+    def flush(self):
+        '''flush buffered records to the file.'''
+        if self.fastxfile == NULL:
+            raise ValueError("I/O operation on closed file")
+        self._flush()
+        if bgzf_flush(self.fastxfile) < 0:
+            raise IOError("error while flushing `%s`" % self._filename)
+
+    def close(self):
+        '''flush buffered records and close the file.'''
+        cdef int ret = 0
+        if self.fastxfile != NULL:
+            try:
+                self._flush()
+            finally:
+                ret = bgzf_close(self.fastxfile)
+                self.fastxfile = NULL
+            if ret < 0:
+                raise IOError("error while closing `%s`" % self._filename)
+        if self.buffer.s != NULL:
+            free(self.buffer.s)
+            self.buffer.s = NULL
+            self.buffer.l = self.buffer.m = 0
+
+    def __dealloc__(self):
+        cdef ssize_t ret = 0
+        if self.fastxfile != NULL:
+            if self.buffer.l > 0:
+                ret = bgzf_write(self.fastxfile, self.buffer.s, self.buffer.l)
+            if bgzf_close(self.fastxfile) < 0:
+                ret = -1
+            self.fastxfile = NULL
+        if self.buffer.s != NULL:
+            free(self.buffer.s)
+            self.buffer.s = NULL
+
+        if ret < 0:
+            raise IOError("error while closing `%s`" % self._filename)
+
+    # context manager interface
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
+        return False
+
+    property closed:
+        """bool indicating the current state of the file object.
+        This is a read-only attribute; the close() method changes the value.
+        """
+        def __get__(self):
+            return not self.is_open()
+
+    property filename:
+        """string with the filename associated with this object."""
+        def __get__(self):
+            return self._filename
+
+
+cdef inline size_t fastx_name_length(const char * name, size_t l) nogil:
+    '''return length of name without a trailing /1 or /2 mate suffix.'''
+    if l >= 2 and name[l - 2] == b'/' and \
+       (name[l - 1] == b'1' or name[l - 1] == b'2'):
+        return l - 2
+    return l
+
+
+cdef inline bint fastx_names_match(const char * name1, size_t l1,
+                                   const char * name2, size_t l2) nogil:
+    '''return True if the read names of a pair agree.
+
+    Comments are not part of the name as kseq splits them off.
+    '''
+    l1 = fastx_name_length(name1, l1)
+    l2 = fastx_name_length(name2, l2)
+    return l1 == l2 and memcmp(name1, name2, l1) == 0
+
+
+cdef inline FastxRecord makeBatchRecord(pysam_kseq_batch_t * batch, int i):
+    '''return record i of a batch, fields not in the file are None.'''
+    cdef char * data = batch.data.s
+    cdef size_t * off = batch.off + 4 * i
+    cdef FastxRecord record = FastxRecord.__new__(FastxRecord)
+    record.name = charptr_to_str(data + off[0])
+    record.comment = charptr_to_str(data + off[1]) if data[off[1]] else None
+    record.sequence = charptr_to_str(data + off[2])
+    record.quality = charptr_to_str(data + off[3]) if data[off[3]] else None
+    return record
+
+
+cdef class PairedFastxFile:
+    """Stream access to a pair of :term:`fasta` or :term:`fastq`
+    formatted files such as the R1/R2 output of paired-end sequencing.
+
+    The files are read in lock-step and iteration returns a tuple
+    with one entry from each file. Both streams are decompressed by a
+    shared pool of threads if *threads* is larger than 1 and the
+    files are BGZF compressed. Iteration parses the two files one
+    after the other; :meth:`read` returns a batch of pairs and parses
+    both files at the same time if *threads* is larger than 1.
+
+    Parameters
+    ----------
+
+    filename1 : string
+        Filename of the first fasta/fastq file.
+
+    filename2 : string
+        Filename of the second fasta/fastq file.
+
+    threads : int
+        Number of threads used for decompressing the two streams
+        and, with :meth:`read`, for parsing them (default 1).
+
+    check_names : bool
+        If True (default), check that the names of each pair agree.
+        A trailing ``/1`` or ``/2`` and any comment are ignored.
+
+    persist : bool
+        If True (default) make a copy of the entries in the files
+        during iteration. See :class:`FastxFile`.
+
+    Raises
+    ------
+
+    IOError
+        if a file could not be opened
+
+    ValueError
+        if the names of a pair do not match or the files contain a
+        different number of entries.
+
+    Examples
+    --------
+    >>> with pysam.PairedFastxFile(filename1, filename2) as fh:
+    ...    for read1, read2 in fh:
+    ...        print(read1.name, read1.sequence, read2.sequence)
+
+    >>> with pysam.PairedFastxFile(filename1, filename2, threads=4) as fh:
+    ...    while True:
+    ...        pairs = fh.read(10000)
+    ...        if not pairs:
+    ...            break
+    ...        for read1, read2 in pairs:
+    ...            print(read1.name, read1.sequence, read2.sequence)
+
+    """
+    def __cinit__(self, *args, **kwargs):
+        self._filename1 = None
+        self._filename2 = None
+        self.entry1 = NULL
+        self.entry2 = NULL
+        self.pool = NULL
+        self._open(*args, **kwargs)
+
+    def is_open(self):
+        '''return true if files have been opened.'''
+        return self.entry1 != NULL and self.entry2 != NULL
+
+    def _open(self, filename1, filename2, threads=1, check_names=True,
+              persist=True):
+        '''open a pair of fastq/fasta files.'''
+        if self.fastqfile1 != NULL or self.fastqfile2 != NULL:
+            self.close()
+
+        self._filename1 = encode_filename(filename1)
+        self._filename2 = encode_filename(filename2)
+        cdef char *cfilename1 = self._filename1
+        cdef char *cfilename2 = self._filename2
+
+        for fn, bfn in ((filename1, self._filename1),
+                        (filename2, self._filename2)):
+            if (bfn != b"-"
+                and not hisremote(bfn)
+                and not os.path.exists(fn)):
+                raise IOError("file `%s` not found" % fn)
+
+        if self._filename1 == b"-" and self._filename2 == b"-":
+            raise ValueError("can not read both files from stdin")
+
+        self.persist = persist
+        self.check_names = check_names
+        self.threads = threads
+
+        with nogil:
+            self.fastqfile1 = bgzf_open(cfilename1, "r")
+            self.fastqfile2 = bgzf_open(cfilename2, "r")
+
+        if self.fastqfile1 == NULL or self.fastqfile2 == NULL:
+            self.close()
+            raise IOError("error when opening files `%s` and `%s`" %
+                          (filename1, filename2))
+
+        if threads > 1:
+            self.pool = hts_tpool_init(threads)
+            if self.pool == NULL:
+                self.close()
+                raise MemoryError("could not create thread pool")
+            if bgzf_thread_pool(self.fastqfile1, self.pool, 0) < 0 or \
+               bgzf_thread_pool(self.fastqfile2, self.pool, 0) < 0:
+                self.close()
+                raise IOError("could not attach thread pool")
+
+        with nogil:
+            self.entry1 = kseq_init(self.fastqfile1)
+            self.entry2 = kseq_init(self.fastqfile2)
+        self._filename1 = filename1
+        self._filename2 = filename2
+
+    def close(self):
+        '''close the files.'''
+        if self.fastqfile1 != NULL:
+            bgzf_close(self.fastqfile1)
+            self.fastqfile1 = NULL
+        if self.fastqfile2 != NULL:
+            bgzf_close(self.fastqfile2)
+            self.fastqfile2 = NULL
+        # the pool must outlive the BGZF handles using it
+        if self.pool != NULL:
+            hts_tpool_destroy(self.pool)
+            self.pool = NULL
+        if self.entry1 != NULL:
+            kseq_destroy(self.entry1)
+            self.entry1 = NULL
+        if self.entry2 != NULL:
+            kseq_destroy(self.entry2)
+            self.entry2 = NULL
+        pysam_kseq_batch_destroy(&self.batch1)
+        pysam_kseq_batch_destroy(&self.batch2)
+
+    def __dealloc__(self):
+        self.close()
+
+    # context manager interface
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
+        return False
+
+    property closed:
+        """bool indicating the current state of the file object.
+        This is a read-only attribute; the close() method changes the value.
+        """
+        def __get__(self):
+            return not self.is_open()
+
+    property filenames:
+        """tuple with the filenames associated with this object."""
+        def __get__(self):
+            return (self._filename1, self._filename2)
+
+    def __iter__(self):
+        if not self.is_open():
+            raise ValueError("I/O operation on closed file")
+        return self
+
+    def __next__(self):
+        """
+        python version of next().
+        """
+        cdef int l1, l2
+        cdef bint match = True
+        if not self.is_open():
+            raise ValueError("I/O operation on closed file")
+        with nogil:
+            l1 = kseq_read(self.entry1)
+            l2 = kseq_read(self.entry2)
+            if l1 >= 0 and l2 >= 0 and self.check_names:
+                match = fastx_names_match(self.entry1.name.s,
+                                          self.entry1.name.l,
+                                          self.entry2.name.s,
+                                          self.entry2.name.l)
+
+        if l1 >= 0 and l2 >= 0:
+            if not match:
+                raise ValueError(
+                    "read names do not match: '{}' != '{}'".format(
+                        charptr_to_str(self.entry1.name.s),
+                        charptr_to_str(self.entry2.name.s)))
+            if self.persist:
+                return (FastxRecord(proxy=makeFastqProxy(self.entry1)),
+                        FastxRecord(proxy=makeFastqProxy(self.entry2)))
+            return (makeFastqProxy(self.entry1),
+                    makeFastqProxy(self.entry2))
+        elif l1 == -1 and l2 == -1:
+            raise StopIteration
+        self._raise_read_error(l1, l2)
+
+    def read(self, int n):
+        '''read up to *n* pairs of entries.
+
+        Return a list of tuples of :class:`FastxRecord` objects, which
+        is shorter than *n* once the end of the files is reached and
+        empty thereafter. If the object was opened with more than one
+        thread, the two files are parsed at the same time.
+
+        Raises ValueError like iteration does, in which case the pairs
+        read in this call are lost.
+        '''
+        cdef int ret, i, m
+        cdef int l1, l2
+        cdef bint concurrent = self.threads > 1
+        cdef size_t * off1
+        cdef size_t * off2
+        if not self.is_open():
+            raise ValueError("I/O operation on closed file")
+        if n < 0:
+            raise ValueError("number of pairs must not be negative")
+
+        with nogil:
+            ret = pysam_kseq_read_pairs(self.entry1, self.entry2, n,
+                                        &self.batch1, &self.batch2,
+                                        concurrent)
+        if ret < 0:
+            raise MemoryError("could not allocate memory for {} pairs".format(n))
+
+        m = min(self.batch1.n, self.batch2.n)
+        # a file with more entries than the other did not stop early
+        l1 = self.batch1.ret if self.batch1.n == m else 0
+        l2 = self.batch2.ret if self.batch2.n == m else 0
+        if (l1 < 0 or l2 < 0) and not (l1 == -1 and l2 == -1):
+            self._raise_read_error(l1, l2)
+
+        result = []
+        for i in range(m):
+            off1 = self.batch1.off + 4 * i
+            off2 = self.batch2.off + 4 * i
+            if self.check_names and not fastx_names_match(
+                    self.batch1.data.s + off1[0], off1[1] - off1[0] - 1,
+                    self.batch2.data.s + off2[0], off2[1] - off2[0] - 1):
+                raise ValueError(
+                    "read names do not match: '{}' != '{}'".format(
+                        charptr_to_str(self.batch1.data.s + off1[0]),
+                        charptr_to_str(self.batch2.data.s + off2[0])))
+            result.append((makeBatchRecord(&self.batch1, i),
+                           makeBatchRecord(&self.batch2, i)))
+        return result
+
+    cdef int _raise_read_error(self, int l1, int l2) except -1:
+        '''raise the error for kseq_read() results *l1* and *l2*.'''
+        if l1 == -1 or l2 == -1:
+            raise ValueError('files {0} and {1} contain a different number of entries'
+                             .format(self._filename1, self._filename2))
+        elif l1 == -2 or l2 == -2:
+            raise ValueError('truncated quality string in {0}'
+                             .format(self._filename1 if l1 == -2 else self._filename2))
+        else:
+            raise ValueError('unknown problem parsing {0}'
+                             .format(self._filename1 if l1 < 0 else self._filename2))
+
+
 # Compatibility Layer for pysam 0.8.1
 cdef class FastqFile(FastxFile):
     """FastqFile is deprecated: use FastxFile instead"""
@@ -669,6 +1320,8 @@ cdef class Fastafile(FastaFile):
 __all__ = ["FastaFile",
            "FastqFile",
            "FastxFile",
+           "FastxWriter",
+           "PairedFastxFile",
            "Fastafile",
            "FastxRecord",
            "FastqProxy"]
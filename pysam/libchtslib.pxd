@@ -21,6 +21,7 @@ cdef extern from "htslib/kstring.h" nogil:
         char *s
 
     int kputc(int c, kstring_t *s)
+    int kputsn(const char *p, size_t l, kstring_t *s)
     int kputw(int c, kstring_t *s)
     int kputl(long c, kstring_t *s)
     int ksprintf(kstring_t *s, const char *fmt, ...)
@@ -177,6 +178,23 @@ cdef extern from "htslib/hfile.h" nogil:
     int hflush(hFILE *fp)
 
 
+cdef extern from "htslib/thread_pool.h" nogil:
+    ctypedef struct hts_tpool
+
+    # Creates a worker pool with n worker threads.
+    #
+    # Returns pool pointer on success; NULL on failure.
+    # The pool should be freed via hts_tpool_destroy().
+    hts_tpool *hts_tpool_init(int n)
+
+    # Returns the number of requested threads for a pool.
+    int hts_tpool_size(hts_tpool *p)
+
+    # Destroys a thread pool. The threads are joined into the main
+    # thread so they will finish their current work load.
+    void hts_tpool_destroy(hts_tpool *p)
+
+
 cdef extern from "htslib/bgzf.h" nogil:
     ctypedef struct bgzf_mtaux_t
     ctypedef struct bgzidx_t
@@ -314,6 +332,24 @@ cdef extern from "htslib/bgzf.h" nogil:
     #  @param size  size of cache in bytes; 0 to disable caching (default)
     void bgzf_set_cache_size(BGZF *fp, int size)
 
+    #  Set the size of the process-wide cache of decompressed blocks
+    #  shared by all BGZF handles reading local files.
+    #
+    #  @param size  size of cache in bytes; 0 to disable and free the cache
+    #  @return      0 on success, -1 on failure
+    int bgzf_set_shared_cache_size(size_t size)
+
+    ctypedef struct bgzf_shared_cache_stats_t:
+        uint64_t hits
+        uint64_t misses
+        uint64_t evictions
+        size_t nblocks
+        size_t size
+        size_t capacity
+
+    #  Report usage statistics of the process-wide block cache.
+    void bgzf_shared_cache_stats(bgzf_shared_cache_stats_t *stats, int reset)
+
     #  Flush the file if the remaining buffer size is smaller than _size_
     #  @return      0 if flushing succeeded or was not needed; negative on error
     int bgzf_flush_try(BGZF *fp, ssize_t size)
@@ -342,6 +378,14 @@ cdef extern from "htslib/bgzf.h" nogil:
     #  @param n_sub_blks  #blocks processed by each thread; a value 64-256 is recommended
     int bgzf_mt(BGZF *fp, int n_threads, int n_sub_blks)
 
+    #  Attach a shared thread pool to a BGZF file handle. Several
+    #  handles can share the same pool.
+    #
+    #  @param fp          BGZF file handler
+    #  @param pool        thread pool created by hts_tpool_init()
+    #  @param qsize       size of the output queue; 0 for the default
+    int bgzf_thread_pool(BGZF *fp, hts_tpool *pool, int qsize)
+
 
     # Compress a single BGZF block.
     #
@@ -451,6 +495,12 @@ cdef extern from "htslib/hts.h" nogil:
         CRAM_OPT_REQUIRED_FIELDS,
         HTS_OPT_COMPRESSION_LEVEL,
         HTS_OPT_NTHREADS,
+        HTS_OPT_MMAP,
+
+    cdef enum hts_access_pattern:
+        HTS_ACCESS_NORMAL,
+        HTS_ACCESS_SEQUENTIAL,
+        HTS_ACCESS_RANDOM,
 
     ctypedef struct htsVersion:
         short major, minor
@@ -621,11 +671,21 @@ cdef extern from "htslib/hts.h" nogil:
     #     used to provide a reference list if the htsFile contains no @SQ headers.
     int hts_set_fai_filename(htsFile *fp, const char *fn_aux)
 
+    # @abstract  Sets a filter expression applied when reading records
+    # @param fp  The file handle
+    # @param expr  The filter expression, or NULL to remove the filter
+    # @return    0 for success, negative if the expression does not parse
+    int hts_set_filter_expression(htsFile *fp, const char *expr)
+
     int8_t HTS_IDX_NOCOOR
     int8_t HTS_IDX_START
     int8_t HTS_IDX_REST
     int8_t HTS_IDX_NONE
 
+    int HTS_IDX_SAVE_REMOTE
+    int HTS_IDX_SILENT_FAIL
+    int HTS_IDX_LAZY
+
     int8_t HTS_FMT_CSI
     int8_t HTS_FMT_BAI
     int8_t HTS_FMT_TBI
@@ -656,6 +716,7 @@ cdef extern from "htslib/hts.h" nogil:
 
     hts_idx_t *hts_idx_init(int n, int fmt, uint64_t offset0, int min_shift, int n_lvls)
     void hts_idx_destroy(hts_idx_t *idx)
+    hts_idx_t *hts_idx_share(hts_idx_t *idx)
     int hts_idx_push(hts_idx_t *idx, int tid, int beg, int end, uint64_t offset, int is_mapped)
     void hts_idx_finish(hts_idx_t *idx, uint64_t final_offset)
 
@@ -695,6 +756,9 @@ cdef extern from "htslib/hts.h" nogil:
 
     uint64_t hts_idx_get_n_no_coor(const hts_idx_t* idx)
 
+    # Returns the format of the index, HTS_FMT_CSI, HTS_FMT_BAI, ...
+    int hts_idx_fmt(hts_idx_t *idx)
+
     int HTS_PARSE_THOUSANDS_SEP  # Ignore ',' separators within numbers
 
     # Parse a numeric string
@@ -844,6 +908,16 @@ cdef extern from "htslib/hts.h" nogil:
     void *ed_swap_8p(void *x)
 
 
+cdef extern from "htslib/hts_expr.h" nogil:
+    ctypedef struct hts_filter_t
+
+    # Parses a filter expression, returning NULL on error
+    hts_filter_t *hts_filter_init(const char *str)
+
+    # Frees an hts_filter_t created via hts_filter_init
+    void hts_filter_free(hts_filter_t *filt)
+
+
 cdef extern from "htslib/sam.h" nogil:
     #**********************
     #*** SAM/BAM header ***
@@ -1091,6 +1165,14 @@ cdef extern from "htslib/sam.h" nogil:
     # @return  The index, or NULL if an error occurred.
     hts_idx_t *sam_index_load2(htsFile *fp, const char *fn, const char *fnidx)
 
+    # Load or stream a BAM (.csi or .bai) or CRAM (.crai) index file
+    # @param fp     File handle of the data file whose index is being opened
+    # @param fn     BAM/CRAM/etc data file filename
+    # @param fnidx  Index filename, or NULL to search alongside @a fn
+    # @param flags  Flags to alter behaviour (see description)
+    # @return  The index, or NULL if an error occurred.
+    hts_idx_t *sam_index_load3(htsFile *fp, const char *fn, const char *fnidx, int flags)
+
     # Generate and save an index file
     # @param fn        Input BAM/etc filename, to which .csi/etc will be added
     # @param min_shift Positive to generate CSI, or 0 to generate BAI
@@ -1134,6 +1216,17 @@ cdef extern from "htslib/sam.h" nogil:
     int sam_read1(htsFile *fp, bam_hdr_t *h, bam1_t *b)
     int sam_write1(htsFile *fp, const bam_hdr_t *h, const bam1_t *b)
 
+    int bam_set1(bam1_t *bam,
+                 size_t l_qname, const char *qname,
+                 uint16_t flag, int32_t tid, int64_t pos, uint8_t mapq,
+                 size_t n_cigar, const uint32_t *cigar,
+                 int32_t mtid, int64_t mpos, int64_t isize,
+                 size_t l_seq, const char *seq, const char *qual,
+                 size_t l_aux)
+
+    # Returns 1 when b is accepted by filt, 0 if not and <0 on error
+    int sam_passes_filter(const bam_hdr_t *h, const bam1_t *b, hts_filter_t *filt)
+
     #*************************************
     #*** Manipulating auxiliary fields ***
     #*************************************
@@ -1383,9 +1476,14 @@ cdef extern from "htslib/tbx.h" nogil:
 
     int tbx_index_build(char *fn, int min_shift, tbx_conf_t *conf)
     int tbx_index_build2(const char *fn, const char *fnidx, int min_shift, const tbx_conf_t *conf)
+    int tbx_index_build3(const char *fn, const char *fnidx, int min_shift, int n_threads, const tbx_conf_t *conf)
 
     tbx_t * tbx_index_load(char *fn)
     tbx_t *tbx_index_load2(const char *fn, const char *fnidx)
+    tbx_t *tbx_index_load3(const char *fn, const char *fnidx, int flags)
+
+    # share the index data of tbx with a new tbx_t
+    tbx_t *tbx_share(tbx_t *tbx)
 
     # free the array but not the values
     char **tbx_seqnames(tbx_t *tbx, int *n)
@@ -2007,6 +2105,7 @@ cdef extern from "htslib/vcf.h" nogil:
     hts_idx_t *bcf_index_load2(const char *fn, const char *fnidx)
     int bcf_index_build(const char *fn, int min_shift)
     int bcf_index_build2(const char *fn, const char *fnidx, int min_shift)
+    int bcf_index_build3(const char *fn, const char *fnidx, int min_shift, int n_threads)
 
     #*******************
     # Typed value I/O *
@@ -2595,17 +2694,56 @@ cdef extern from "htslib/cram.h" nogil:
     refs_t *cram_get_refs(htsFile *fd)
 
 
+cdef extern from "htslib_util.h" nogil:
+    # background reading of records
+    enum:
+        PYSAM_PREFETCH_SAM
+        PYSAM_PREFETCH_BCF
+        PYSAM_PREFETCH_VCF
+
+    ctypedef struct pysam_prefetch_t:
+        pass
+
+    pysam_prefetch_t *pysam_prefetch_init(int type, int size, htsFile *fp,
+                                          void *hdr, hts_itr_t *itr, tbx_t *tbx,
+                                          int max_unpack)
+    int pysam_prefetch_next(pysam_prefetch_t *p, void **rec)
+    void *pysam_prefetch_take(pysam_prefetch_t *p)
+    int pysam_prefetch_destroy(pysam_prefetch_t *p)
+
+    ctypedef struct pysam_junctions_t
+    pysam_junctions_t *pysam_junctions_init()
+    int pysam_junctions_add(pysam_junctions_t *j, const bam1_t *b)
+    size_t pysam_junctions_size(const pysam_junctions_t *j)
+    int pysam_junctions_export(const pysam_junctions_t *j, int32_t *tid,
+                               int64_t *start, int64_t *end, int8_t *strand,
+                               uint64_t *unique, uint64_t *multi)
+    void pysam_junctions_destroy(pysam_junctions_t *j)
+
+    ctypedef struct pysam_pairbuf_t
+    pysam_pairbuf_t *pysam_pairbuf_init()
+    bam1_t *pysam_pairbuf_match(pysam_pairbuf_t *buf, const bam1_t *b,
+                                int store, int *err)
+    size_t pysam_pairbuf_size(const pysam_pairbuf_t *buf)
+    void pysam_pairbuf_destroy(pysam_pairbuf_t *buf)
+
+
 cdef class HTSFile(object):
     cdef          htsFile *htsfile       # pointer to htsFile structure
     cdef          int64_t start_offset   # BGZF offset of first record
+    cdef          pysam_prefetch_t *prefetch_reader  # reads records ahead, or NULL
 
     cdef readonly object  filename       # filename as supplied by user
     cdef readonly object  mode           # file opening mode
     cdef readonly object  threads        # number of threads to use
+    cdef readonly object  io             # I/O backend, None or 'mmap'
     cdef readonly object  index_filename # filename of index, if supplied by user
+    cdef readonly int     prefetch       # number of records to read ahead when iterating
 
     cdef readonly bint    is_stream      # Is htsfile a non-seekable stream
     cdef readonly bint    is_remote      # Is htsfile a remote stream
     cdef readonly bint	  duplicate_filehandle   # Duplicate filehandle when opening via fh
 
     cdef htsFile *_open_htsfile(self) except? NULL
+    cdef int stop_prefetch(self) except -1
+    cdef list partition_index(self, hts_idx_t *idx, contigs, int n)
@@ -32,7 +32,9 @@ from warnings import warn
 ## Constants
 ########################################################################
 
-__all__ = ['get_verbosity', 'set_verbosity', 'HFile', 'HTSFile']
+__all__ = ['get_verbosity', 'set_verbosity',
+           'set_block_cache', 'get_block_cache_stats',
+           'HFile', 'HTSFile']
 
 # defines imported from samtools
 DEF SEEK_SET = 0
@@ -63,6 +65,43 @@ cpdef get_verbosity():
     return hts_get_verbosity()
 
 
+########################################################################
+########################################################################
+## Block cache functions
+########################################################################
+
+
+cpdef set_block_cache(size_t size):
+    """Set the size in bytes of the process-wide cache of decompressed
+    BGZF blocks.
+
+    The cache is shared between all open files, so that iterators
+    and handles opened on the same local file reuse blocks that have
+    already been decompressed. Blocks are evicted in least recently
+    used order. A size of 0 disables the cache and frees its memory
+    (default).
+    """
+    if bgzf_set_shared_cache_size(size) < 0:
+        raise MemoryError("could not allocate block cache")
+
+
+def get_block_cache_stats(reset=False):
+    """Return a dictionary with usage statistics of the block cache
+    set up with :func:`set_block_cache`.
+
+    The counters ``hits``, ``misses`` and ``evictions`` are reset
+    if *reset* is True.
+    """
+    cdef bgzf_shared_cache_stats_t stats
+    bgzf_shared_cache_stats(&stats, reset)
+    return {"hits": stats.hits,
+            "misses": stats.misses,
+            "evictions": stats.evictions,
+            "blocks": stats.nblocks,
+            "size": stats.size,
+            "capacity": stats.capacity}
+
+
 ########################################################################
 ########################################################################
 ## HFile wrapper class
@@ -334,10 +373,13 @@ cdef class HTSFile(object):
 
     def close(self):
         if self.htsfile:
+            self.stop_prefetch()
             hts_close(self.htsfile)
             self.htsfile = NULL
 
     def __dealloc__(self):
+        pysam_prefetch_destroy(self.prefetch_reader)
+        self.prefetch_reader = NULL
         if self.htsfile:
             hts_close(self.htsfile)
             self.htsfile = NULL
@@ -485,6 +527,7 @@ cdef class HTSFile(object):
         if self.is_stream:
             raise IOError('seek not available in streams')
 
+        self.stop_prefetch()
         cdef int64_t ret
         if self.htsfile.format.compression == bgzf:
             with nogil:
@@ -503,6 +546,7 @@ cdef class HTSFile(object):
         if self.is_stream:
             raise IOError('tell not available in streams')
 
+        self.stop_prefetch()
         cdef int64_t ret
         if self.htsfile.format.compression == bgzf:
             with nogil:
@@ -518,17 +562,138 @@ cdef class HTSFile(object):
 
         return ret
 
+    cdef int stop_prefetch(self) except -1:
+        '''stop reading records ahead, moving back to the first record
+        not yet returned. Raises IOError if the format does not allow
+        this and records would be lost.'''
+        cdef pysam_prefetch_t *reader = self.prefetch_reader
+        cdef int ret
+        if reader == NULL:
+            return 0
+
+        self.prefetch_reader = NULL
+        with nogil:
+            ret = pysam_prefetch_destroy(reader)
+        if ret == -2:
+            raise IOError("records read ahead are lost as this file cannot "
+                          "be repositioned, read to the end or use prefetch=0")
+        elif ret < 0:
+            raise IOError("could not return to the first record read ahead")
+        return 0
+
+    cdef list partition_index(self, hts_idx_t *idx, contigs, int n):
+        '''split contigs into n lists of regions of about equal size.
+
+        *contigs* is a sequence of (tid, name, length) tuples, with
+        length None if unknown. The contigs are cut into windows and
+        the compressed bytes in each window are estimated from the
+        offsets the index gives for it. Windows are then assigned in
+        file order, so that each list covers a contiguous stretch of
+        the file. Contigs without records are left out.
+
+        If *idx* is NULL or a CRAM index, which records no offsets,
+        the windows are weighted by their length instead.
+        '''
+        if n < 1:
+            raise ValueError("number of partitions must be positive")
+
+        cdef bint use_offsets = idx != NULL and hts_idx_fmt(idx) != HTS_FMT_CRAI
+        cdef int64_t total_length = sum(length or 0 for _, _, length in contigs)
+        # aim at a few hundred windows per partition, at the
+        # resolution of the linear index
+        cdef int64_t step = max(1 << 14, total_length // (n * 256))
+        step = ((step + (1 << 14) - 1) >> 14) << 14
+
+        cdef hts_itr_t *itr
+        cdef int tid, beg, stop
+        cdef uint64_t off, end_off
+        cdef int64_t cost, total = 0
+        by_contig = []
+        for tid, name, length in contigs:
+            windows = []
+            beg = 0
+            while 1:
+                stop = min(beg + step, length) if length else MAX_POS
+                off = <uint64_t>-1
+                if use_offsets:
+                    with nogil:
+                        itr = hts_itr_query(idx, tid, beg, stop, NULL)
+                    if itr != NULL:
+                        if itr.n_off > 0:
+                            off = itr.off[0].u
+                        hts_itr_destroy(itr)
+                windows.append([off, name, beg, None if stop == MAX_POS else stop])
+                beg = stop
+                if beg >= (length or MAX_POS):
+                    break
+            if use_offsets:
+                offsets = [w[0] for w in windows if w[0] != <uint64_t>-1]
+                if not offsets:
+                    continue
+                by_contig.append((min(offsets), windows))
+            else:
+                by_contig.append((len(by_contig), windows))
+
+        # windows in file order
+        by_contig.sort(key=lambda x: x[0])
+        windows = [w for _, ws in by_contig for w in ws]
+
+        # a window extends to the first record of the next window with
+        # records, or to the end of the mapped records
+        if use_offsets and windows:
+            # the iterator over reads without coordinates starts there
+            end_off = <uint64_t>-1
+            with nogil:
+                itr = hts_itr_query(idx, HTS_IDX_NOCOOR, 0, 0, NULL)
+            if itr != NULL:
+                end_off = itr.curr_off
+                hts_itr_destroy(itr)
+            if end_off == <uint64_t>-1:
+                end_off = max(w[0] for w in windows if w[0] != <uint64_t>-1)
+            for w in reversed(windows):
+                if w[0] == <uint64_t>-1:
+                    w[0] = end_off
+                off = w[0]
+                cost = max(0, <int64_t>(end_off >> 16) - <int64_t>(off >> 16))
+                end_off = off
+                # a small weight per window splits data within a block
+                w[0] = cost + 1
+                total += cost + 1
+        else:
+            for w in windows:
+                w[0] = (w[3] if w[3] is not None else step) - w[2]
+                total += w[0]
+
+        partitions = [[] for _ in range(n)]
+        cdef int64_t done = 0
+        cdef int k
+        for weight, name, wbeg, wstop in windows:
+            # assign by the midpoint of the window
+            k = min(n - 1, ((2 * done + weight) * n) // (2 * total)) if total else 0
+            regions = partitions[k]
+            if regions and regions[-1][0] == name and regions[-1][2] == wbeg:
+                regions[-1] = (name, regions[-1][1], wstop)
+            else:
+                regions.append((name, wbeg, wstop))
+            done += weight
+        return partitions
+
     cdef htsFile *_open_htsfile(self) except? NULL:
         cdef char *cfilename
         cdef char *cmode = self.mode
         cdef int fd, dup_fd, threads
+        cdef bint use_mmap
 
         threads = self.threads - 1
+        use_mmap = self.io == "mmap"
         if isinstance(self.filename, bytes):
             cfilename = self.filename
             with nogil:
                 htsfile = hts_open(cfilename, cmode)
                 if htsfile != NULL:
+                    # must precede threads, see HTS_OPT_MMAP
+                    if use_mmap:
+                        hts_set_opt(htsfile, HTS_OPT_MMAP, HTS_ACCESS_NORMAL)
                     hts_set_threads(htsfile, threads)
                 return htsfile
         else:
@@ -565,6 +730,8 @@ cdef class HTSFile(object):
             with nogil:
                 htsfile = hts_hopen(hfile, cfilename, cmode)
                 if htsfile != NULL:
+                    if use_mmap:
+                        hts_set_opt(htsfile, HTS_OPT_MMAP, HTS_ACCESS_NORMAL)
                     hts_set_threads(htsfile, threads)
                 return htsfile
 
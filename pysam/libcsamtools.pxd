@@ -1,4 +1,4 @@
-cdef extern from "samtools.pysam.h":
+cdef extern from "samtools.pysam.h" nogil:
 
     int samtools_dispatch(int argc, char *argv[])
     void samtools_set_stderr(int fd)
@@ -62,6 +62,7 @@ cdef class TabixFile(HTSFile):
     cdef tbx_t * index
 
     cdef readonly object filename_index
+    cdef bint lazy_index
 
     cdef Parser parser
 
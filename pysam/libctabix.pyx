@@ -70,13 +70,14 @@ from cpython.version cimport PY_MAJOR_VERSION
 
 cimport pysam.libctabixproxies as ctabixproxies
 
-from pysam.libchtslib cimport htsFile, hts_open, hts_close, HTS_IDX_START,\
+from pysam.libchtslib cimport htsFile, hts_open, hts_close, HTS_IDX_START, \
+    HTS_IDX_SAVE_REMOTE, HTS_IDX_LAZY, \
     BGZF, bgzf_open, bgzf_dopen, bgzf_close, bgzf_write, \
-    tbx_index_build2, tbx_index_load2, tbx_itr_queryi, tbx_itr_querys, \
+    tbx_index_build3, tbx_index_load2, tbx_index_load3, tbx_itr_queryi, tbx_itr_querys, \
     tbx_conf_t, tbx_seqnames, tbx_itr_next, tbx_itr_destroy, \
-    tbx_destroy, hisremote, region_list, hts_getline, \
+    tbx_destroy, tbx_share, tbx_name2id, hisremote, region_list, hts_getline, \
     TBX_GENERIC, TBX_SAM, TBX_VCF, TBX_UCSC, htsExactFormat, bcf, \
-    bcf_index_build2
+    bcf_index_build3
 
 from pysam.libcutils cimport force_bytes, force_str, charptr_to_str
 from pysam.libcutils cimport encode_filename, from_string_and_size
@@ -286,6 +287,10 @@ cdef class asVCF(Parser):
         return r
 
 
+# passed by _dup() to create an instance without opening a file
+cdef object _UNOPENED = object()
+
+
 cdef class TabixFile:
     """Random access to bgzf formatted files that
     have been indexed by :term:`tabix`.
@@ -323,6 +328,11 @@ cdef class TabixFile:
         Number of threads to use for decompressing Tabix files.
         (Default=1)
 
+    lazy_index: bool
+        Read the index entries of each contig the first time that
+        contig is fetched rather than when the file is opened.  The
+        index file is kept open while the TabixFile is.
+        (Default=False)
 
     Raises
     ------
@@ -344,6 +354,12 @@ cdef class TabixFile:
                   **kwargs ):
 
         self.htsfile = NULL
+        self.index = NULL
+
+        # _dup() fills in the file itself
+        if filename is _UNOPENED:
+            return
+
         self.is_remote = False
         self.is_stream = False
         self.parser = parser
@@ -356,6 +372,7 @@ cdef class TabixFile:
                mode='r',
                index=None,
                threads=1,
+               lazy_index=False,
               ):
         '''open a :term:`tabix file` for reading.'''
 
@@ -366,6 +383,7 @@ cdef class TabixFile:
             self.close()
         self.htsfile = NULL
         self.threads=threads
+        self.lazy_index = lazy_index
 
         filename_index = index or (filename + ".tbi")
         # encode all the strings to pass to tabix
@@ -385,6 +403,9 @@ cdef class TabixFile:
         # open file
         cdef char *cfilename = self.filename
         cdef char *cfilename_index = self.filename_index
+        cdef int index_flags = HTS_IDX_SAVE_REMOTE
+        if lazy_index:
+            index_flags |= HTS_IDX_LAZY
         with nogil:
             self.htsfile = hts_open(cfilename, 'r')
 
@@ -395,7 +416,7 @@ cdef class TabixFile:
         #    raise ValueError("file does not contain region data")
 
         with nogil:
-            self.index = tbx_index_load2(cfilename, cfilename_index)
+            self.index = tbx_index_load3(cfilename, cfilename_index, index_flags)
 
         if self.index == NULL:
             raise IOError("could not open index for `%s`" % filename)
@@ -406,14 +427,32 @@ cdef class TabixFile:
     def _dup(self):
         '''return a copy of this tabix file.
         
-        The file is being re-opened.
+        The file is being re-opened, but the index is shared with
+        this file rather than loaded again.
         '''
-        return TabixFile(self.filename,
-                         mode="r",
-                         threads=self.threads,
-                         parser=self.parser,
-                         index=self.filename_index,
-                         encoding=self.encoding)
+        cdef TabixFile dup = TabixFile.__new__(TabixFile, _UNOPENED)
+        cdef char *cfilename = self.filename
+
+        dup.filename = self.filename
+        dup.filename_index = self.filename_index
+        dup.lazy_index = self.lazy_index
+        dup.is_remote = self.is_remote
+        dup.is_stream = self.is_stream
+        dup.parser = self.parser
+        dup.threads = self.threads
+        dup.encoding = self.encoding
+        dup.start_offset = self.start_offset
+
+        with nogil:
+            dup.htsfile = hts_open(cfilename, 'r')
+        if dup.htsfile == NULL:
+            raise IOError("could not open file `%s`" % force_str(self.filename))
+
+        dup.index = tbx_share(self.index)
+        if dup.index == NULL:
+            raise MemoryError("could not share index of `%s`" % force_str(self.filename))
+
+        return dup
 
     def fetch(self, 
               reference=None,
@@ -596,6 +635,21 @@ cdef class TabixFile:
             free(sequences)
 
             return result
+
+    def partition(self, n):
+        '''split the indexed contigs into *n* lists of regions with
+        about the same amount of data, estimated from the file offsets
+        recorded in the index.
+
+        The regions are tuples (contig, start, stop) that can be passed
+        to :meth:`fetch`. Tabix indices do not record contig lengths,
+        so contigs are not split.
+        '''
+        if self.index == NULL:
+            raise ValueError("I/O operation on closed file")
+        contigs = [(tbx_name2id(self.index, force_bytes(name)), name, None)
+                   for name in self.contigs]
+        return self.partition_index(self.index.idx, contigs, n)
             
     def close(self):
         '''
@@ -900,6 +954,7 @@ def tabix_index(filename,
                 index=None,
                 keep_original=False,
                 csi=False,
+                int threads=1,
                 ):
     '''index tab-separated *filename* using tabix.
 
@@ -938,6 +993,11 @@ def tabix_index(filename,
     When automatically compressing files, if *keep_original* is set the
     uncompressed file will not be deleted.
 
+    *threads* sets the number of threads used to read *filename*. With
+    more than one thread, a compressed file on disk is indexed in
+    parallel over ranges of its BGZF blocks. The index is the same as
+    with a single thread.
+
     returns the filename of the compressed data
 
     '''
@@ -1021,13 +1081,14 @@ def tabix_index(filename,
     
     cdef char *fnidx = fn_index
     cdef int retval = 0
+    cdef int n_threads = threads if threads > 1 else 0
 
     if csi and fmt == bcf:
         with nogil:
-            retval = bcf_index_build2(cfn, fnidx, min_shift)
+            retval = bcf_index_build3(cfn, fnidx, min_shift, n_threads)
     else:
         with nogil:
-            retval = tbx_index_build2(cfn, fnidx, min_shift, &conf)
+            retval = tbx_index_build3(cfn, fnidx, min_shift, n_threads, &conf)
             
     if retval != 0:
         raise OSError("building of index for {} failed".format(filename))
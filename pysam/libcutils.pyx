@@ -5,18 +5,29 @@ import re
 import tempfile
 import os
 import io
+import threading
 from contextlib import contextmanager
 from codecs import register_error
 
 from cpython.version cimport PY_MAJOR_VERSION, PY_MINOR_VERSION
 from cpython cimport PyBytes_Check, PyUnicode_Check
 from cpython cimport array as c_array
-from libc.stdlib cimport calloc, free
+from libc.stdlib cimport calloc, malloc, free
 from libc.string cimport strncpy
 from libc.stdint cimport INT32_MAX, int32_t
 from libc.stdio cimport fprintf, stderr, fflush
 from libc.stdio cimport stdout as c_stdout
-from posix.fcntl cimport open as c_open, O_WRONLY
+from libc.errno cimport errno, EINTR, EAGAIN
+from posix.fcntl cimport open as c_open, O_WRONLY, fcntl, F_GETFL, F_SETFL, O_NONBLOCK
+from posix.unistd cimport read, write
+
+cdef extern from "poll.h" nogil:
+    cdef struct pollfd:
+        int fd
+        short events
+        short revents
+    int poll(pollfd *fds, unsigned long nfds, int timeout)
+    enum: POLLIN, POLLOUT
 
 from libcsamtools cimport samtools_dispatch, samtools_set_stdout, samtools_set_stderr, \
     samtools_close_stdout, samtools_close_stderr, samtools_set_stdout_fn, samtools_set_optind
@@ -286,12 +297,78 @@ cpdef parse_region(contig=None,
     return contig, rstart, rstop
 
 
+cdef int wait_for(pollfd *fds, int fd, short events) nogil:
+    """wait until *fd* is ready, return 0 if the cancel descriptor
+    in fds[1] has become readable first and -1 on errors."""
+    fds[0].fd = fd
+    fds[0].events = events
+    while poll(fds, 2, -1) < 0:
+        if errno != EINTR:
+            return -1
+    if fds[1].revents:
+        return 0
+    return 1
+
+
+def _forward_output(int in_fd, int out_fd, int cancel_fd):
+    '''copy data from *in_fd* to *out_fd* until the end of the input
+    or until *cancel_fd* becomes readable, for example because its
+    other end has been closed.
+
+    Returns True if all data has been copied.
+    '''
+    cdef size_t bufsize = 65536
+    cdef char *buf = <char *>malloc(bufsize)
+    if buf == NULL:
+        raise MemoryError("could not allocate buffer of size {}".format(bufsize))
+    cdef pollfd fds[2]
+    cdef ssize_t n, w, offset
+    cdef int ready = 1
+    with nogil:
+        fcntl(out_fd, F_SETFL, fcntl(out_fd, F_GETFL) | O_NONBLOCK)
+        fds[1].fd = cancel_fd
+        fds[1].events = POLLIN
+        while True:
+            ready = wait_for(fds, in_fd, POLLIN)
+            if ready <= 0:
+                break
+            n = read(in_fd, buf, bufsize)
+            if n < 0 and (errno == EINTR or errno == EAGAIN):
+                continue
+            if n < 0:
+                ready = -1
+            if n <= 0:
+                break
+            offset = 0
+            while offset < n:
+                ready = wait_for(fds, out_fd, POLLOUT)
+                if ready <= 0:
+                    break
+                w = write(out_fd, buf + offset, n - offset)
+                if w >= 0:
+                    offset += w
+                elif errno != EINTR and errno != EAGAIN:
+                    ready = -1
+                    break
+            if ready <= 0:
+                break
+    free(buf)
+    return ready > 0
+
+
+# bcftools keeps command state, such as lookup tables and warnings
+# already given, in globals, so its commands run one at a time. Only
+# bcftools commands take this lock.
+_dispatch_lock = threading.Lock()
+
+
 def _pysam_dispatch(collection,
                     method,
                     args=None,
                     catch_stdout=True,
                     is_usage=False,
-                    save_stdout=None):
+                    save_stdout=None,
+                    stdout_fd=None):
     '''call ``method`` in samtools/bcftools providing arguments in args.
     
     By default, stdout is redirected to a temporary file using the patched
@@ -301,7 +378,18 @@ def _pysam_dispatch(collection,
     will not be used.
 
     Catching of stdout can be turned off by setting *catch_stdout* to
-    False.
+    False. If *stdout_fd* is given, output is written to this file
+    descriptor instead, which the caller remains responsible for
+    closing.
+
+    The command runs without the GIL. The redirected streams and the
+    option parser state are kept per thread, so several samtools
+    commands can run at the same time in different threads.
+
+    bcftools commands do not run concurrently: bcftools keeps command
+    state in globals, so a bcftools command waits until no other
+    bcftools command is running. samtools commands are not held up by
+    this.
     '''
 
     if method == "index" and args:
@@ -333,53 +421,61 @@ def _pysam_dispatch(collection,
     stderr_h, stderr_f = tempfile.mkstemp()
         
     # redirect stdout to file
-    if save_stdout:
+    MAP_STDOUT_OPTIONS = {
+        "samtools": {
+            "view": "-o {}",
+            "mpileup": "-o {}",
+            "depad": "-o {}",
+            "calmd": "",  # uses pysam_stdout_fn
+        },
+        "bcftools": {}
+    }
+
+    stdout_option = None
+    if collection == "bcftools":
+        # in bcftools, most methods accept -o, the exceptions
+        # are below:
+        if method not in ("index", "roh", "stats"):
+            stdout_option = "-o {}"
+    elif method in MAP_STDOUT_OPTIONS[collection]:
+        # special case - samtools view -c outputs on stdout
+        if not(method == "view" and "-c" in args):
+            stdout_option = MAP_STDOUT_OPTIONS[collection][method]
+
+    if stdout_fd is not None:
+        # commands opening their output by name open the descriptor
+        stdout_f = "/dev/fd/{}".format(stdout_fd)
+        if stdout_option is not None and not is_usage:
+            args.extend(stdout_option.format(stdout_f).split(" "))
+        stdout_h = os.dup(stdout_fd)
+
+    elif save_stdout:
         stdout_f = save_stdout
         stdout_h = c_open(force_bytes(stdout_f),
                           O_WRONLY)
         if stdout_h == -1:
             raise IOError("error while opening {} for writing".format(stdout_f))
 
-        samtools_set_stdout_fn(force_bytes(stdout_f))
-        bcftools_set_stdout_fn(force_bytes(stdout_f))
-            
     elif catch_stdout:
         stdout_h, stdout_f = tempfile.mkstemp()
-        MAP_STDOUT_OPTIONS = {
-        "samtools": {
-            "view": "-o {}",
-            "mpileup": "-o {}",
-            "depad": "-o {}",
-            "calmd": "",  # uses pysam_stdout_fn
-        },
-            "bcftools": {}
-        }
-        
-        stdout_option = None
-        if collection == "bcftools":
-            # in bcftools, most methods accept -o, the exceptions
-            # are below:
-            if method not in ("index", "roh", "stats"):
-                stdout_option = "-o {}"
-        elif method in MAP_STDOUT_OPTIONS[collection]:
-            # special case - samtools view -c outputs on stdout
-            if not(method == "view" and "-c" in args):
-                stdout_option = MAP_STDOUT_OPTIONS[collection][method]
-
         if stdout_option is not None and not is_usage:
             os.close(stdout_h)
-            samtools_set_stdout_fn(force_bytes(stdout_f))
-            bcftools_set_stdout_fn(force_bytes(stdout_f))
             args.extend(stdout_option.format(stdout_f).split(" "))
             stdout_h = c_open(b"/dev/null", O_WRONLY)
     else:
-        samtools_set_stdout_fn("-")
-        bcftools_set_stdout_fn("-")
+        stdout_f = "-"
         stdout_h = c_open(b"/dev/null", O_WRONLY)
 
+    # keep the name alive while the command runs
+    bstdout_f = force_bytes(stdout_f)
+    samtools_set_stdout_fn(bstdout_f)
+    bcftools_set_stdout_fn(bstdout_f)
+
     # setup the function call to samtools/bcftools main
     cdef char ** cargs
     cdef int i, n, retval, l
+    cdef int c_stdout_h = stdout_h
+    cdef int c_stderr_h = stderr_h
     n = len(args)
     method = force_bytes(method)
     collection = force_bytes(collection)
@@ -404,27 +500,30 @@ def _pysam_dispatch(collection,
     
     # reset getopt. On OsX there getopt reset is different
     # between getopt and getopt_long
+    cdef int optind = 0
     if method in [b'index', b'cat', b'quickcheck',
                   b'faidx', b'kprobaln']:
-        samtools_set_optind(1)
-        bcftools_set_optind(1)
-    else:
-        samtools_set_optind(0)
-        bcftools_set_optind(0)
+        optind = 1
 
     # call samtools/bcftools
+    retval = -1
     if collection == b"samtools":
-        samtools_set_stdout(stdout_h)
-        samtools_set_stderr(stderr_h)
-        retval = samtools_dispatch(n + 2, cargs)
-        samtools_close_stdout()
-        samtools_close_stderr()
+        with nogil:
+            samtools_set_optind(optind)
+            samtools_set_stdout(c_stdout_h)
+            samtools_set_stderr(c_stderr_h)
+            retval = samtools_dispatch(n + 2, cargs)
+            samtools_close_stdout()
+            samtools_close_stderr()
     elif collection == b"bcftools":
-        bcftools_set_stdout(stdout_h)
-        bcftools_set_stderr(stderr_h)
-        retval = bcftools_dispatch(n + 2, cargs)
-        bcftools_close_stdout()
-        bcftools_close_stderr()
+        with _dispatch_lock:
+            with nogil:
+                bcftools_set_optind(optind)
+                bcftools_set_stdout(c_stdout_h)
+                bcftools_set_stderr(c_stderr_h)
+                retval = bcftools_dispatch(n + 2, cargs)
+                bcftools_close_stdout()
+                bcftools_close_stderr()
 
     for i from 0 <= i < n:
         free(cargs[i + 2])
@@ -445,7 +544,7 @@ def _pysam_dispatch(collection,
         return out
 
     out_stderr = _collect(stderr_f)
-    if save_stdout:
+    if save_stdout or stdout_fd is not None:
         out_stdout = None
     elif catch_stdout:
         out_stdout = _collect(stdout_f)
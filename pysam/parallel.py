@@ -0,0 +1,164 @@
+'''Process regions of indexed files in several processes.
+
+pysam objects cannot be pickled and thus not be sent to other
+processes. The functions in this module open a file once in each
+worker process and send only regions and results between processes.
+'''
+import functools
+import multiprocessing
+import os
+
+import pysam
+
+__all__ = ["map_regions", "open_file"]
+
+
+def open_file(path, threads=1, reference_filename=None, index_filename=None):
+    '''open an indexed file with the class appropriate for its format.
+
+    Based on the file extension, :term:`SAM`, :term:`BAM` and
+    :term:`CRAM` files are opened as :class:`~pysam.AlignmentFile`,
+    :term:`VCF` and :term:`BCF` files as :class:`~pysam.VariantFile`
+    and other files as :class:`~pysam.TabixFile`.
+    '''
+    name = os.fspath(path)
+    if name.endswith((".bam", ".cram", ".sam")):
+        return pysam.AlignmentFile(path,
+                                   threads=threads,
+                                   reference_filename=reference_filename,
+                                   index_filename=index_filename)
+    if name.endswith((".bcf", ".vcf", ".vcf.gz")):
+        return pysam.VariantFile(path,
+                                 threads=threads,
+                                 index_filename=index_filename)
+    return pysam.TabixFile(path, threads=threads, index=index_filename)
+
+
+# state of a worker process
+_worker = {}
+
+
+def _init_worker(path, threads, reference_filename, index_filename, fasta_filename):
+    _worker["file"] = open_file(path, threads, reference_filename, index_filename)
+    _worker["fasta"] = pysam.FastaFile(fasta_filename) if fasta_filename else None
+
+
+def _run_chunk(func, regions):
+    args = (_worker["file"],)
+    if _worker["fasta"] is not None:
+        args += (_worker["fasta"],)
+    return [func(*(args + (region,))) for region in regions]
+
+
+def _results(path, func, chunks, processes, init_args):
+    if processes == 1:
+        _init_worker(path, *init_args)
+        try:
+            for chunk in chunks:
+                for result in _run_chunk(func, chunk):
+                    yield result
+        finally:
+            _worker["file"].close()
+            _worker.clear()
+        return
+
+    with multiprocessing.Pool(processes,
+                              initializer=_init_worker,
+                              initargs=(path,) + init_args) as pool:
+        for results in pool.imap(functools.partial(_run_chunk, func), chunks):
+            for result in results:
+                yield result
+
+
+def map_regions(path,
+                func,
+                regions=None,
+                n_partitions=None,
+                processes=None,
+                threads_per_worker=1,
+                reduce=None,
+                reference_filename=None,
+                index_filename=None,
+                fasta_filename=None):
+    '''apply `func` to regions of the indexed file `path` in several
+    processes.
+
+    Each worker process opens the file and its index once, see
+    :func:`open_file`, and calls ``func(file, region)`` for each
+    region it is given. If `fasta_filename` is set, the worker also
+    opens it as a :class:`~pysam.FastaFile` and calls ``func(file,
+    fastafile, region)``. `func` and its results need to be picklable,
+    so `func` has to be a module level function.
+
+    Parameters
+    ----------
+
+    path : string
+        filename of an indexed :term:`BAM`, :term:`CRAM`, :term:`BCF`
+        or tabix file.
+
+    func : callable
+        function applied to each region.
+
+    regions : list
+        regions passed to `func`, for example (contig, start, stop)
+        tuples or region strings. Each region is sent to a worker on
+        its own.
+
+    n_partitions : int
+        if `regions` is not given, split the file into this many parts
+        of about equal size with the `partition` method of the file.
+        Each part is sent to a worker as one chunk and `func` is called
+        for every region in it. Defaults to four parts per process.
+
+    processes : int
+        number of worker processes. Defaults to the number of CPUs.
+        With a single process, regions are processed in the calling
+        process.
+
+    threads_per_worker : int
+        number of threads each worker uses for decompression.
+
+    reduce : callable
+        if given, combine the results with this function of two
+        arguments and return the combined value.
+
+    reference_filename : string
+        reference of a :term:`CRAM` file.
+
+    index_filename : string
+        explicit path to the index of `path`.
+
+    fasta_filename : string
+        a :term:`fasta` file to be opened in each worker.
+
+    Returns
+    -------
+
+    an iterator over the results of `func` in the order of the
+    regions, or the combined result if `reduce` is given.
+
+    '''
+    if processes is None:
+        processes = os.cpu_count() or 1
+    if processes < 1:
+        raise ValueError("number of processes must be positive")
+
+    if regions is not None:
+        if n_partitions is not None:
+            raise ValueError("regions and n_partitions must not both be given")
+        chunks = [[region] for region in regions]
+    else:
+        if n_partitions is None:
+            n_partitions = 4 * processes
+        with open_file(path,
+                       reference_filename=reference_filename,
+                       index_filename=index_filename) as f:
+            chunks = [part for part in f.partition(n_partitions) if part]
+
+    results = _results(path, func, chunks, processes,
+                       (threads_per_worker, reference_filename,
+                        index_filename, fasta_filename))
+    if reduce is not None:
+        return functools.reduce(reduce, results)
+    return results
@@ -10,4 +10,30 @@ KSEQ_INIT(BGZF *, bgzf_read)
 
 //KSTREAM_INIT( gzFile, gzread, 16384)
 
+// #######################################################
+// batches of fastq records
+
+typedef struct {
+  // name, comment, sequence and quality of each record, each NUL
+  // terminated; fields not present in the file are empty
+  kstring_t data;
+  size_t *off;    // start of the fields of record i at off[4*i]
+  int n, m;       // number of records read, and allocated
+  int ret;        // kseq_read() result that ended the batch early, or 0
+} pysam_kseq_batch_t;
+
+/*!
+  @abstract Read up to n records of each file of a pair into b1 and b2
+
+  @discussion If concurrent is set, the second file is parsed in a
+  thread of its own while the first is parsed by the caller.  Return 0
+  on success, -4 if out of memory; reading errors are stored in the
+  ret field of each batch.
+*/
+int pysam_kseq_read_pairs(kseq_t *ks1, kseq_t *ks2, int n,
+                          pysam_kseq_batch_t *b1, pysam_kseq_batch_t *b2,
+                          int concurrent);
+
+void pysam_kseq_batch_destroy(pysam_kseq_batch_t *batch);
+
 #endif
@@ -1,4 +1,8 @@
-from pysam.libcutils import _pysam_dispatch
+import io
+import os
+import threading
+
+from pysam.libcutils import _pysam_dispatch, _forward_output
 
 
 class SamtoolsError(Exception):
@@ -52,7 +56,12 @@ class PysamDispatcher(object):
         raw -- ignore any parsers associated with this samtools command.
         split_lines -- return stdout (if catch_stdout is True and stderr
                        as a list of strings.
+        stream -- run the command in the background and return a
+                  :class:`DispatchStream` to read its output from.
         '''
+        if kwargs.get("stream", False):
+            return DispatchStream(self.collection, self.dispatch, args)
+
         retval, stderr, stdout = _pysam_dispatch(
             self.collection,
             self.dispatch,
@@ -104,6 +113,135 @@ class PysamDispatcher(object):
             return stdout
 
 
+class DispatchStream(object):
+    '''The output of a samtools/bcftools command, read while the
+    command runs.
+
+    The command runs in a background thread and writes its output
+    to a pipe, so that no temporary file is needed and output is
+    available before the command has finished. Iterating yields the
+    output line by line. Binary output can be read with :meth:`read`,
+    or the stream can be opened with :class:`pysam.AlignmentFile` or
+    :class:`pysam.VariantFile` directly.
+
+    Raises a :class:`pysam.SamtoolsError` exception at the end of the
+    output or in :meth:`close` if the command exits with an error.
+    No error is raised if the stream is closed before the command has
+    finished.
+
+    As bcftools keeps its state in globals, other bcftools commands
+    wait until a streaming bcftools command has finished.
+    '''
+
+    def __init__(self, collection, dispatch, args):
+        self.collection = collection
+        self.dispatch = dispatch
+        self.retval = None
+        self.stderr = None
+        self._error = None
+        self._done = threading.Event()
+        # the command writes to a pipe read only by the forwarding
+        # thread, as the caller can keep further descriptors of its
+        # own pipe open, for example in an AlignmentFile. Closing
+        # _cancel_fd stops the forwarding.
+        command_read_fd, command_write_fd = os.pipe()
+        cancel_read_fd, self._cancel_fd = os.pipe()
+        read_fd, write_fd = os.pipe()
+        self._file = io.open(read_fd, "rb")
+        self._thread = threading.Thread(target=self._run,
+                                        args=(list(args), command_write_fd))
+        self._thread.daemon = True
+        self._forward_thread = threading.Thread(
+            target=self._forward,
+            args=(command_read_fd, write_fd, cancel_read_fd))
+        self._forward_thread.daemon = True
+        self._thread.start()
+        self._forward_thread.start()
+
+    def _run(self, args, write_fd):
+        try:
+            self.retval, self.stderr, _ = _pysam_dispatch(
+                self.collection,
+                self.dispatch,
+                args,
+                stdout_fd=write_fd)
+        except BaseException as e:
+            self._error = e
+        finally:
+            self._done.set()
+            os.close(write_fd)
+
+    def _forward(self, command_fd, write_fd, cancel_fd):
+        # copies without the GIL until the end of the output, until
+        # the caller closes the stream or until cancelled
+        try:
+            _forward_output(command_fd, write_fd, cancel_fd)
+        finally:
+            os.close(cancel_fd)
+            # without a reader, further writes by the command fail
+            os.close(command_fd)
+            # the reader sees the end of the output once this is closed
+            os.close(write_fd)
+
+    @property
+    def closed(self):
+        return self._file.closed
+
+    def fileno(self):
+        return self._file.fileno()
+
+    def read(self, size=-1):
+        '''read up to *size* bytes, or all remaining output.'''
+        data = self._file.read(size)
+        if not data or size < 0:
+            self.wait()
+        return data
+
+    def __iter__(self):
+        for line in self._file:
+            yield line.decode()
+        self.wait()
+
+    def wait(self):
+        '''wait for the command to finish and return its exit code.'''
+        self._thread.join()
+        self._forward_thread.join()
+        self._stop_forwarding()
+        if self._error is not None:
+            raise self._error
+        if self.retval:
+            raise SamtoolsError(
+                "%s returned with error %i: stderr=%s" %
+                (self.collection, self.retval, self.stderr))
+        return self.retval
+
+    def _stop_forwarding(self):
+        if self._cancel_fd is not None:
+            os.close(self._cancel_fd)
+            self._cancel_fd = None
+
+    def close(self):
+        '''close the stream, stopping the command if it is still
+        running.'''
+        if self._file.closed:
+            return
+        finished = self._done.is_set()
+        # stop forwarding, which closes the pipe of the command
+        self._stop_forwarding()
+        self._file.close()
+        self._forward_thread.join()
+        self._thread.join()
+        if finished:
+            self.wait()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
+        return False
+
+
 class unquoted_str(str):
     '''Tag a value as an unquoted string. Meta-information in the VCF
     header takes the form of key=value pairs. By default, pysam will
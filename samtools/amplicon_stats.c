@@ -145,9 +145,9 @@ typedef struct {
 
 // Reinitialised for each new reference/chromosome.
 // Counts from 1 to namp, -1 for no match and 0 for ?.
-static int *pos2start = NULL;
-static int *pos2end = NULL;
-static int pos2size = 0; // allocated size of pos2start/end
+static __thread int *pos2start = NULL;
+static __thread int *pos2end = NULL;
+static __thread int pos2size = 0; // allocated size of pos2start/end
 
 // Lookup table to go from position to amplicon based on
 // read start / end.
@@ -1567,6 +1567,8 @@ static int amplicon_stats(astats_args_t *args,
     free(amps);
     free(pos2start);
     free(pos2end);
+    pos2start = pos2end = NULL;
+    pos2size = 0;
     if (ret) {
         if (sname && sname != sname_)
             free(sname);
@@ -147,9 +147,9 @@ typedef struct {
 
 // Reinitialised for each new reference/chromosome.
 // Counts from 1 to namp, -1 for no match and 0 for ?.
-static int *pos2start = NULL;
-static int *pos2end = NULL;
-static int pos2size = 0; // allocated size of pos2start/end
+static __thread int *pos2start = NULL;
+static __thread int *pos2end = NULL;
+static __thread int pos2size = 0; // allocated size of pos2start/end
 
 // Lookup table to go from position to amplicon based on
 // read start / end.
@@ -1569,6 +1569,8 @@ static int amplicon_stats(astats_args_t *args,
     free(amps);
     free(pos2start);
     free(pos2end);
+    pos2start = pos2end = NULL;
+    pos2size = 0;
     if (ret) {
         if (sname && sname != sname_)
             free(sname);
@@ -1654,19 +1656,19 @@ int main_ampliconstats(int argc, char **argv) {
     };
     int opt;
 
-    while ( (opt=getopt_long(argc,argv,"?hf:F:@:p:m:d:sa:l:t:o:c:b:D:S",loptions,NULL))>0 ) {
+    while ( (opt=samtools_getopt_long(argc,argv,"?hf:F:@:p:m:d:sa:l:t:o:c:b:D:S",loptions,NULL))>0 ) {
         switch (opt) {
-        case 'f': args.flag_require = bam_str2flag(optarg); break;
+        case 'f': args.flag_require = bam_str2flag(samtools_optarg); break;
         case 'F':
             if (args.flag_filter & 0x10000)
                 args.flag_filter = 0; // strip default on first -F usage
-            args.flag_filter |= bam_str2flag(optarg); break;
+            args.flag_filter |= bam_str2flag(samtools_optarg); break;
 
-        case 'm': args.max_delta = atoi(optarg); break; // margin
-        case 'D': args.depth_bin = atof(optarg); break; // depth bin fraction
+        case 'm': args.max_delta = atoi(samtools_optarg); break; // margin
+        case 'D': args.depth_bin = atof(samtools_optarg); break; // depth bin fraction
         case 'd': {
             int d = 0;
-            char *cp = optarg, *ep;
+            char *cp = samtools_optarg, *ep;
             do {
                 long n = strtol(cp, &ep, 10);
                 args.min_depth[d++] = n;
@@ -1677,23 +1679,23 @@ int main_ampliconstats(int argc, char **argv) {
             break;
         }
 
-        case 'a': args.max_amp = atoi(optarg)+1;break;
-        case 'l': args.max_amp_len = atoi(optarg)+1;break;
+        case 'a': args.max_amp = atoi(samtools_optarg)+1;break;
+        case 'l': args.max_amp_len = atoi(samtools_optarg)+1;break;
 
-        case 'c': args.tcoord_min_count = atoi(optarg);break;
+        case 'c': args.tcoord_min_count = atoi(samtools_optarg);break;
         case 'b':
-            args.tcoord_bin = atoi(optarg);
+            args.tcoord_bin = atoi(samtools_optarg);
             if (args.tcoord_bin < 1)
                 args.tcoord_bin = 1;
             break;
 
-        case 't': args.tlen_adj = atoi(optarg);break;
+        case 't': args.tlen_adj = atoi(samtools_optarg);break;
 
         case 's': args.use_sample_name = 1;break;
 
         case 'o':
-            if (!(args.out_fp = fopen(optarg, "w"))) {
-                perror(optarg);
+            if (!(args.out_fp = fopen(samtools_optarg, "w"))) {
+                perror(samtools_optarg);
                 return 1;
             }
             break;
@@ -1706,21 +1708,21 @@ int main_ampliconstats(int argc, char **argv) {
         case 'h': return usage(&oargs, samtools_stdout, EXIT_SUCCESS);
 
         default:
-            if (parse_sam_global_opt(opt, optarg, loptions, &args.ga) != 0)
+            if (parse_sam_global_opt(opt, samtools_optarg, loptions, &args.ga) != 0)
                 usage(&oargs,samtools_stderr, EXIT_FAILURE);
             break;
         }
     }
 
-    if (argc <= optind)
+    if (argc <= samtools_optind)
         return usage(&oargs, samtools_stdout, EXIT_SUCCESS);
-    if (argc <= optind+1 && isatty(STDIN_FILENO))
+    if (argc <= samtools_optind+1 && isatty(STDIN_FILENO))
         return usage(&oargs, samtools_stderr, EXIT_FAILURE);
 
     khash_t(bed_list_hash) *bed_hash = kh_init(bed_list_hash);
-    if (load_bed_file_multi_ref(argv[optind], 1, 0, bed_hash)) {
+    if (load_bed_file_multi_ref(argv[samtools_optind], 1, 0, bed_hash)) {
         print_error_errno("ampliconstats",
-                          "Could not read file \"%s\"", argv[optind]);
+                          "Could not read file \"%s\"", argv[samtools_optind]);
         return 1;
 
     }
@@ -1742,11 +1744,11 @@ int main_ampliconstats(int argc, char **argv) {
 
     args.argv = stringify_argv(argc, argv);
     int ret;
-    if (argc == ++optind) {
+    if (argc == ++samtools_optind) {
         char *av = "-";
         ret = amplicon_stats(&args, bed_hash, &av, 1);
     } else {
-        ret = amplicon_stats(&args, bed_hash, &argv[optind], argc-optind);
+        ret = amplicon_stats(&args, bed_hash, &argv[samtools_optind], argc-samtools_optind);
     }
 
     free(args.argv);
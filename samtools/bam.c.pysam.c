@@ -90,7 +90,7 @@ const char *bam_get_library(bam_header_t *h, const bam1_t *b)
     if (sam_hdr_find_tag_id(h, "RG", "ID", rg, "LB", &lib)  < 0)
         return NULL;
 
-    static char LB_text[1024];
+    static __thread char LB_text[1024];
     int len = lib.l < sizeof(LB_text) - 1 ? lib.l : sizeof(LB_text) - 1;
 
     memcpy(LB_text, lib.s, len);
@@ -41,6 +41,7 @@ DEALINGS IN THE SOFTWARE.  */
 #include <stdio.h>
 #include <limits.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "htslib/sam.h"
 #include "samtools.h"
 #include "bedidx.h"
@@ -69,6 +70,8 @@ typedef struct {
     kstring_t ks;
     hts_pos_t beg, end; // limit to region
     int tid;
+    kstring_t *out;     // buffer for the output instead of opt->out
+    int out_err;
 } depth_hist;
 
 typedef struct {
@@ -85,6 +88,14 @@ typedef struct {
     void *bed;
 } depth_opt;
 
+// Writes a line of output, to the buffer if there is one
+static inline void depth_samtools_puts(depth_opt *opt, depth_hist *dh, kstring_t *ks) {
+    if (!dh->out)
+        fputs(ks->s, opt->out);
+    else if (kputsn(ks->s, ks->l, dh->out) < 0)
+        dh->out_err = 1;
+}
+
 static void zero_region(depth_opt *opt, depth_hist *dh,
                         const char *name, hts_pos_t start, hts_pos_t end) {
     hts_pos_t i;
@@ -112,7 +123,7 @@ static void zero_region(depth_opt *opt, depth_hist *dh,
             kputc_('0',  ks);
         }
         kputc('\n',  ks);
-        fputs(ks->s, opt->out);
+        depth_samtools_puts(opt, dh, ks);
     }
     ks->l = cur_l;
 }
@@ -205,7 +216,7 @@ static int add_depth(depth_opt *opt, depth_hist *dh, sam_hdr_t *h, bam1_t *b,
                     kputuw(d, &dh->ks);
                 }
                 kputc('\n', &dh->ks);
-                fputs(dh->ks.s, opt->out);
+                depth_samtools_puts(opt, dh, &dh->ks);
             }
             if (opt->all_pos) {
                 // End of last ref
@@ -216,7 +227,7 @@ static int add_depth(depth_opt *opt, depth_hist *dh, sam_hdr_t *h, bam1_t *b,
             dh->ks.l = cur_l;
         }
 
-        if (opt->all_pos > 1 && !opt->reg) {
+        if (opt->all_pos > 1 && !opt->reg && !dh->out) {
             // Any previous unused refs
             int lr = dh->last_ref < 0 ? 0 : dh->last_ref+1;
             int rr = b ? b->core.tid : sam_hdr_nref(h), r;
@@ -276,7 +287,7 @@ static int add_depth(depth_opt *opt, depth_hist *dh, sam_hdr_t *h, bam1_t *b,
                     kputuw(d, &dh->ks);
                 }
                 kputc('\n', &dh->ks);
-                fputs(dh->ks.s, opt->out);
+                depth_samtools_puts(opt, dh, &dh->ks);
             }
             if (opt->all_pos && i < b->core.pos)
                 // Hole in middle of ref
@@ -497,8 +508,12 @@ static int add_depth(depth_opt *opt, depth_hist *dh, sam_hdr_t *h, bam1_t *b,
 KHASH_MAP_INIT_STR(olap_hash, hts_pos_t)
 typedef khash_t(olap_hash) olap_hash_t;
 
+// Computes the depth of the files, or of the region of the iterators if
+// itr is set.  The output goes to opt->out, or to the buffer "out" if set,
+// in which case has_reads tells whether any reads were used.
 static int fastdepth_core(depth_opt *opt, uint32_t nfiles, char **fn,
-                          samFile **fp, hts_itr_t **itr, sam_hdr_t **h) {
+                          samFile **fp, hts_itr_t **itr, sam_hdr_t **h,
+                          kstring_t *out, int *has_reads) {
     int ret = -1, err = 1, i;
     olap_hash_t **overlaps = NULL;
     depth_hist dh = {0};
@@ -530,6 +545,8 @@ static int fastdepth_core(depth_opt *opt, uint32_t nfiles, char **fn,
     dh.last_ref = -99;
     dh.end_pos = NULL;
     dh.last_output = itr && itr[0] ? itr[0]->beg : 0;
+    dh.out = out;
+    dh.out_err = 0;
     ks_initialize(&dh.ks);
 
     // Clip results to region if specified
@@ -542,7 +559,7 @@ static int fastdepth_core(depth_opt *opt, uint32_t nfiles, char **fn,
         dh.end = itr[0]->end;
     }
 
-    if (opt->header) {
+    if (opt->header && !out) {
         fprintf(opt->out, "#CHROM\tPOS");
         for (i = 0; i < nfiles; i++)
             fprintf(opt->out, "\t%s", fn[i]);
@@ -671,6 +688,10 @@ static int fastdepth_core(depth_opt *opt, uint32_t nfiles, char **fn,
 
     // Tidy up end.
     ret = add_depth(opt, &dh, h[0], NULL, 0, 0);
+    if (dh.out_err)
+        goto err;
+    if (has_reads)
+        *has_reads = dh.last_ref >= 0;
     err = 0;
 
  err:
@@ -704,6 +725,331 @@ static int fastdepth_core(depth_opt *opt, uint32_t nfiles, char **fn,
     return ret;
 }
 
+// Sets the CRAM options for the fields used by depth
+static int set_cram_opts(samFile *fp, depth_opt *opt) {
+    if (hts_set_opt(fp, CRAM_OPT_REQUIRED_FIELDS,
+                    SAM_FLAG | SAM_RNAME | SAM_POS | SAM_CIGAR
+                    | (opt->remove_overlaps ? SAM_QNAME|SAM_RNEXT|SAM_PNEXT
+                                            : 0)
+                    | (opt->min_mqual       ? SAM_MAPQ  : 0)
+                    | (opt->min_len         ? SAM_SEQ   : 0)
+                    | (opt->min_qual        ? SAM_QUAL  : 0))) {
+        fprintf(samtools_stderr, "Failed to set CRAM_OPT_REQUIRED_FIELDS value\n");
+        return -1;
+    }
+
+    if (hts_set_opt(fp, CRAM_OPT_DECODE_MD, 0)) {
+        fprintf(samtools_stderr, "Failed to set CRAM_OPT_DECODE_MD value\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Parallel depth, with -@ of two or more threads on indexed files and no
+ * region.  The contigs are cut into windows, which worker threads compute
+ * with fastdepth_core into text buffers, and the main thread writes the
+ * buffers out in order.  The zeros of windows without any reads are left
+ * to the main thread, as with -a they depend on whether the contig has
+ * reads elsewhere.
+ */
+
+// Depth values per window, so fewer bases when there are many files
+#define DEPTH_WINDOW_VALUES (1 << 20)
+#define DEPTH_WINDOW_MIN    (1 << 12)
+
+typedef struct {
+    int tid;
+    hts_pos_t beg, end;
+    kstring_t out;
+    int has_reads;
+    int status;         // 1 when done, -1 on failure
+} depth_window_t;
+
+typedef struct {
+    depth_opt *opt;
+    uint32_t nfiles;
+    char **fn, **fn_idx;
+    const htsFormat *in_fmt;
+    depth_window_t *win;
+    int n_win, next, n_written, max_ahead, stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} depth_parallel_t;
+
+typedef struct {
+    depth_parallel_t *par;
+    samFile **fp;       // the files open for this worker
+    sam_hdr_t **h;
+    hts_idx_t **idx;
+    int own;            // opened by the worker, rather than by main_depth
+    int failed;
+} depth_worker_t;
+
+static int depth_worker_open(depth_worker_t *w) {
+    depth_parallel_t *par = w->par;
+    uint32_t i;
+
+    w->own = 1;
+    w->fp = calloc(par->nfiles, sizeof(*w->fp));
+    w->h = calloc(par->nfiles, sizeof(*w->h));
+    w->idx = calloc(par->nfiles, sizeof(*w->idx));
+    if (!w->fp || !w->h || !w->idx)
+        return -1;
+
+    for (i = 0; i < par->nfiles; i++) {
+        if (!(w->fp[i] = sam_open_format(par->fn[i], "r", par->in_fmt))) {
+            print_error_errno("depth", "Cannot open input file \"%s\"",
+                              par->fn[i]);
+            return -1;
+        }
+        if (set_cram_opts(w->fp[i], par->opt) < 0)
+            return -1;
+        if (!(w->h[i] = sam_hdr_read(w->fp[i]))) {
+            fprintf(samtools_stderr, "Failed to read header for \"%s\"\n", par->fn[i]);
+            return -1;
+        }
+        w->idx[i] = par->fn_idx
+            ? sam_index_load2(w->fp[i], par->fn[i], par->fn_idx[i])
+            : sam_index_load(w->fp[i], par->fn[i]);
+        if (!w->idx[i]) {
+            print_error("depth", "cannot load index for \"%s\"", par->fn[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void depth_worker_close(depth_worker_t *w) {
+    uint32_t i;
+
+    if (!w->own)
+        return;
+
+    for (i = 0; i < w->par->nfiles; i++) {
+        if (w->idx && w->idx[i])
+            hts_idx_destroy(w->idx[i]);
+        if (w->h && w->h[i])
+            sam_hdr_destroy(w->h[i]);
+        if (w->fp && w->fp[i])
+            sam_close(w->fp[i]);
+    }
+    free(w->fp);
+    free(w->h);
+    free(w->idx);
+}
+
+static int depth_window_run(depth_worker_t *w, depth_window_t *win) {
+    depth_parallel_t *par = w->par;
+    depth_opt opt = *par->opt;
+    hts_itr_t **itr = calloc(par->nfiles, sizeof(*itr));
+    int ret = -1;
+    uint32_t i;
+
+    if (!itr)
+        return -1;
+
+    if (!w->fp && depth_worker_open(w) < 0)
+        w->failed = 1;
+    if (w->failed)
+        goto out;
+
+    for (i = 0; i < par->nfiles; i++) {
+        if (!(itr[i] = sam_itr_queryi(w->idx[i], win->tid, win->beg, win->end))) {
+            print_error("depth", "failed to query the index of \"%s\"",
+                        par->fn[i]);
+            goto out;
+        }
+    }
+
+    opt.header = 0;
+    ret = fastdepth_core(&opt, par->nfiles, par->fn, w->fp, itr, w->h,
+                         &win->out, &win->has_reads);
+
+ out:
+    for (i = 0; i < par->nfiles; i++)
+        if (itr[i])
+            hts_itr_destroy(itr[i]);
+    free(itr);
+    return ret;
+}
+
+static void *depth_worker(void *arg) {
+    depth_worker_t *w = (depth_worker_t *)arg;
+    depth_parallel_t *par = w->par;
+
+    for (;;) {
+        int k, ret;
+
+        // Keep at most max_ahead windows waiting to be written
+        pthread_mutex_lock(&par->lock);
+        while (!par->stop && par->next < par->n_win
+               && par->next >= par->n_written + par->max_ahead)
+            pthread_cond_wait(&par->cond, &par->lock);
+        if (par->stop || par->next >= par->n_win) {
+            pthread_mutex_unlock(&par->lock);
+            break;
+        }
+        k = par->next++;
+        pthread_mutex_unlock(&par->lock);
+
+        ret = depth_window_run(w, &par->win[k]);
+
+        pthread_mutex_lock(&par->lock);
+        par->win[k].status = ret < 0 ? -1 : 1;
+        pthread_cond_broadcast(&par->cond);
+        pthread_mutex_unlock(&par->lock);
+    }
+
+    depth_worker_close(w);
+    return NULL;
+}
+
+// Writes the zero depth rows of [beg, end) on tid
+static void depth_zeros(depth_opt *opt, depth_hist *dh, sam_hdr_t *h,
+                        int tid, hts_pos_t beg, hts_pos_t end) {
+    hts_pos_t len = sam_hdr_tid2len(h, tid);
+    zero_region(opt, dh, sam_hdr_tid2name(h, tid), beg, MIN(end, len));
+}
+
+/*
+ * Computes the depth of the whole files in windows on n_threads worker
+ * threads.  The first worker uses the open files, headers and indexes
+ * passed in.  Returns 0 on success and -1 on failure.
+ */
+static int fastdepth_parallel(depth_opt *opt, uint32_t nfiles, char **fn,
+                              char **fn_idx, const htsFormat *in_fmt,
+                              samFile **fp, sam_hdr_t **h, hts_idx_t **idx,
+                              int n_threads) {
+    depth_parallel_t par = { opt, nfiles, fn, fn_idx, in_fmt };
+    depth_worker_t *w = NULL;
+    pthread_t *tids = NULL;
+    depth_hist dh = {0};
+    int nref = sam_hdr_nref(h[0]), n_started = 0, m_win = 0, ret = -1, k, t;
+    int cur_tid = -1, tid_has_reads = 0;
+    hts_pos_t width, beg, pending = -1;
+
+    // Windows cut so that each has about DEPTH_WINDOW_VALUES depths
+    width = MAX(DEPTH_WINDOW_VALUES / nfiles, DEPTH_WINDOW_MIN);
+    for (t = 0; t < nref; t++) {
+        hts_pos_t len = sam_hdr_tid2len(h[0], t);
+        for (beg = 0; beg < len; beg += width) {
+            if (hts_resize(depth_window_t, par.n_win + 1, &m_win, &par.win,
+                           HTS_RESIZE_CLEAR) < 0) {
+                print_error_errno("depth", "Out of memory");
+                goto out;
+            }
+            depth_window_t *win = &par.win[par.n_win++];
+            win->tid = t;
+            win->beg = beg;
+            // the last window takes any reads past the end
+            win->end = len - beg > width ? beg + width : HTS_POS_MAX;
+        }
+    }
+
+    // For zero_region on the main thread
+    dh.nfiles = nfiles;
+    dh.beg = dh.end = -1;
+    ks_initialize(&dh.ks);
+
+    if (opt->header) {
+        fprintf(opt->out, "#CHROM\tPOS");
+        for (k = 0; k < nfiles; k++)
+            fprintf(opt->out, "\t%s", fn[k]);
+        fputc('\n', opt->out);
+    }
+
+    par.max_ahead = 2 * n_threads;
+    if (pthread_mutex_init(&par.lock, NULL) != 0
+        || pthread_cond_init(&par.cond, NULL) != 0) {
+        print_error("depth", "failed to initialise locks");
+        goto out;
+    }
+
+    w = calloc(n_threads, sizeof(*w));
+    tids = calloc(n_threads, sizeof(*tids));
+    if (!w || !tids) {
+        print_error_errno("depth", "Out of memory");
+        goto stop;
+    }
+
+    for (k = 0; k < n_threads; k++) {
+        w[k].par = &par;
+        if (k == 0) {
+            w[k].fp = fp;
+            w[k].h = h;
+            w[k].idx = idx;
+        }
+        if (samtools_pthread_create(&tids[k], NULL, depth_worker, &w[k]) != 0) {
+            print_error("depth", "failed to create thread");
+            goto stop;
+        }
+        n_started++;
+    }
+
+    // Write the windows in order as they are done
+    for (k = 0; k < par.n_win; k++) {
+        depth_window_t *win = &par.win[k];
+
+        pthread_mutex_lock(&par.lock);
+        while (!win->status)
+            pthread_cond_wait(&par.cond, &par.lock);
+        pthread_mutex_unlock(&par.lock);
+
+        if (win->status < 0)
+            goto stop;
+
+        if (win->tid != cur_tid) {
+            cur_tid = win->tid;
+            tid_has_reads = 0;
+            pending = -1;
+        }
+
+        if (win->has_reads) {
+            // -a: the contig has reads, so the windows before need zeros
+            if (pending >= 0)
+                depth_zeros(opt, &dh, h[0], win->tid, pending, win->beg);
+            pending = -1;
+            tid_has_reads = 1;
+            if (win->out.l)
+                fwrite(win->out.s, 1, win->out.l, opt->out);
+        } else if (opt->all_pos > 1 || (opt->all_pos && tid_has_reads)) {
+            depth_zeros(opt, &dh, h[0], win->tid, win->beg, win->end);
+        } else if (opt->all_pos && pending < 0) {
+            pending = win->beg;
+        }
+        ks_free(&win->out);
+
+        pthread_mutex_lock(&par.lock);
+        par.n_written++;
+        pthread_cond_broadcast(&par.cond);
+        pthread_mutex_unlock(&par.lock);
+    }
+
+    ret = 0;
+
+ stop:
+    pthread_mutex_lock(&par.lock);
+    par.stop = 1;
+    pthread_cond_broadcast(&par.cond);
+    pthread_mutex_unlock(&par.lock);
+    for (k = 0; k < n_started; k++)
+        pthread_join(tids[k], NULL);
+    pthread_cond_destroy(&par.cond);
+    pthread_mutex_destroy(&par.lock);
+
+ out:
+    for (k = 0; k < par.n_win; k++)
+        ks_free(&par.win[k].out);
+    free(par.win);
+    free(w);
+    free(tids);
+    ks_free(&dh.ks);
+    return ret;
+}
+
 static void usage_exit(FILE *fp, int exit_status)
 {
     fprintf(fp, "Usage: samtools depth [options] in.bam [in.bam ...]\n");
@@ -730,9 +1076,10 @@ static void usage_exit(FILE *fp, int exit_status)
 
 int main_depth(int argc, char *argv[])
 {
-    int nfiles, i;
+    int nfiles, i, first, parallel;
     samFile **fp;
     sam_hdr_t **header;
+    hts_idx_t **idxs;
     int c, has_index_file = 0;
     char *file_list = NULL, **fn = NULL;
     depth_opt opt = {
@@ -755,7 +1102,7 @@ int main_depth(int argc, char *argv[])
         {NULL, 0, NULL, 0}
     };
 
-    while ((c = getopt_long(argc, argv, "@:q:Q:JHd:m:l:g:G:o:ar:Xf:b:s",
+    while ((c = samtools_getopt_long(argc, argv, "@:q:Q:JHd:m:l:g:G:o:ar:Xf:b:s",
                             lopts, NULL)) >= 0) {
         switch (c) {
         case 'a':
@@ -763,16 +1110,16 @@ int main_depth(int argc, char *argv[])
             break;
 
         case 'b':
-            opt.bed = bed_read(optarg);
+            opt.bed = bed_read(samtools_optarg);
             if (!opt.bed) {
                 print_error_errno("depth", "Could not read file \"%s\"",
-                                  optarg);
+                                  samtools_optarg);
                 return 1;
             }
             break;
 
         case 'f':
-            file_list = optarg;
+            file_list = samtools_optarg;
             break;
 
         case 'd':
@@ -781,14 +1128,14 @@ int main_depth(int argc, char *argv[])
             break;
 
         case 'g':
-            opt.flag &= ~bam_str2flag(optarg);
+            opt.flag &= ~bam_str2flag(samtools_optarg);
             break;
         case 'G':
-            opt.flag |= bam_str2flag(optarg);
+            opt.flag |= bam_str2flag(samtools_optarg);
             break;
 
         case 'l':
-            opt.min_len = atoi(optarg);
+            opt.min_len = atoi(samtools_optarg);
             break;
 
         case 'H':
@@ -796,10 +1143,10 @@ int main_depth(int argc, char *argv[])
             break;
 
         case 'q':
-            opt.min_qual = atoi(optarg);
+            opt.min_qual = atoi(samtools_optarg);
             break;
         case 'Q':
-            opt.min_mqual = atoi(optarg);
+            opt.min_mqual = atoi(samtools_optarg);
             break;
 
         case 'J':
@@ -809,16 +1156,16 @@ int main_depth(int argc, char *argv[])
         case 'o':
             if (opt.out != samtools_stdout)
                 break;
-            opt.out = fopen(optarg, "w");
+            opt.out = fopen(samtools_optarg, "w");
             if (!opt.out) {
                 print_error_errno("depth", "Cannot open \"%s\" for writing.",
-                                  optarg);
+                                  samtools_optarg);
                 return EXIT_FAILURE;
             }
             break;
 
         case 'r':
-            opt.reg = optarg;
+            opt.reg = samtools_optarg;
             break;
 
         case 's':
@@ -829,15 +1176,15 @@ int main_depth(int argc, char *argv[])
             has_index_file = 1;
             break;
 
-        default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+        default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
             /* else fall-through */
         case '?':
             usage_exit(samtools_stderr, EXIT_FAILURE);
         }
     }
 
-    if (argc < optind+1 && !file_list) {
-        if (argc == optind)
+    if (argc < samtools_optind+1 && !file_list) {
+        if (argc == samtools_optind)
             usage_exit(samtools_stdout, EXIT_SUCCESS);
         else
             usage_exit(samtools_stderr, EXIT_FAILURE);
@@ -852,9 +1199,9 @@ int main_depth(int argc, char *argv[])
             return 1;
         argv = fn;
         argc = nfiles;
-        optind = 0;
+        samtools_optind = 0;
     } else {
-        nfiles = argc - optind;
+        nfiles = argc - samtools_optind;
     }
 
     if (has_index_file) {
@@ -866,7 +1213,8 @@ int main_depth(int argc, char *argv[])
     }
     fp = malloc(nfiles * sizeof(*fp));
     header = malloc(nfiles * sizeof(*header));
-    if (!fp || !header) {
+    idxs = calloc(nfiles, sizeof(*idxs));
+    if (!fp || !header || !idxs) {
         print_error_errno("depth", "Out of memory");
         return 1;
     }
@@ -878,48 +1226,35 @@ int main_depth(int argc, char *argv[])
             return 1;
     }
 
-    for (i = 0; i < nfiles; i++, optind++) {
-        fp[i] = sam_open_format(argv[optind], "r", &ga.in);
+    // Whole indexed files are done in windows with two or more threads
+    parallel = ga.nthreads >= 2 && !opt.reg;
+    first = samtools_optind;
+    for (i = 0; i < nfiles; i++, samtools_optind++) {
+        fp[i] = sam_open_format(argv[samtools_optind], "r", &ga.in);
         if (fp[i] == NULL) {
             print_error_errno("depth",
-                              "Cannot open input file \"%s\"", argv[optind]);
-            return 1;
-        }
-
-        if (ga.nthreads > 0)
-            hts_set_threads(fp[i], ga.nthreads);
-
-        if (hts_set_opt(fp[i], CRAM_OPT_REQUIRED_FIELDS,
-                        SAM_FLAG | SAM_RNAME | SAM_POS | SAM_CIGAR
-                        | (opt.remove_overlaps ? SAM_QNAME|SAM_RNEXT|SAM_PNEXT
-                                               : 0)
-                        | (opt.min_mqual       ? SAM_MAPQ  : 0)
-                        | (opt.min_len         ? SAM_SEQ   : 0)
-                        | (opt.min_qual        ? SAM_QUAL  : 0))) {
-            fprintf(samtools_stderr, "Failed to set CRAM_OPT_REQUIRED_FIELDS value\n");
+                              "Cannot open input file \"%s\"", argv[samtools_optind]);
             return 1;
         }
 
-        if (hts_set_opt(fp[i], CRAM_OPT_DECODE_MD, 0)) {
-            fprintf(samtools_stderr, "Failed to set CRAM_OPT_DECODE_MD value\n");
+        if (set_cram_opts(fp[i], &opt) < 0)
             return 1;
-        }
 
         // FIXME: what if headers differ?
         header[i] = sam_hdr_read(fp[i]);
         if (header == NULL) {
             fprintf(samtools_stderr, "Failed to read header for \"%s\"\n",
-                    argv[optind]);
+                    argv[samtools_optind]);
             return 1;
         }
 
         if (opt.reg) {
             hts_idx_t *idx = has_index_file
-                ? sam_index_load2(fp[i], argv[optind], argv[optind+nfiles])
-                : sam_index_load(fp[i], argv[optind]);
+                ? sam_index_load2(fp[i], argv[samtools_optind], argv[samtools_optind+nfiles])
+                : sam_index_load(fp[i], argv[samtools_optind]);
             if (!idx) {
                 print_error("depth", "cannot load index for \"%s\"",
-                            argv[optind]);
+                            argv[samtools_optind]);
                 return 1;
             }
             if (!(itr[i] = sam_itr_querys(idx, header[i], opt.reg))) {
@@ -928,20 +1263,46 @@ int main_depth(int argc, char *argv[])
             }
             hts_idx_destroy(idx);
         }
+
+        if (parallel) {
+            if (strcmp(argv[samtools_optind], "-") == 0)
+                parallel = 0;
+            else if (!(idxs[i] = sam_index_load3(fp[i], argv[samtools_optind],
+                                                has_index_file
+                                                ? argv[samtools_optind+nfiles] : NULL,
+                                                HTS_IDX_SILENT_FAIL)))
+                parallel = 0;
+        }
     }
 
-    int ret = fastdepth_core(&opt, nfiles, &argv[argc-nfiles], fp, itr, header)
-        ? 1 : 0;
+    int ret;
+    if (parallel) {
+        ret = fastdepth_parallel(&opt, nfiles, &argv[first],
+                                 has_index_file ? &argv[first+nfiles] : NULL,
+                                 &ga.in, fp, header, idxs, ga.nthreads)
+            ? 1 : 0;
+    } else {
+        if (ga.nthreads > 0)
+            for (i = 0; i < nfiles; i++)
+                hts_set_threads(fp[i], ga.nthreads);
+
+        ret = fastdepth_core(&opt, nfiles, &argv[argc-nfiles], fp, itr, header,
+                             NULL, NULL)
+            ? 1 : 0;
+    }
 
     for (i = 0; i < nfiles; i++) {
         sam_hdr_destroy(header[i]);
         sam_close(fp[i]);
         if (itr && itr[i])
             hts_itr_destroy(itr[i]);
+        if (idxs[i])
+            hts_idx_destroy(idxs[i]);
     }
     free(header);
     free(fp);
     free(itr);
+    free(idxs);
     if (file_list) {
         for (i=0; i<nfiles; i++)
             free(fn[i]);
@@ -204,26 +204,26 @@ static bool parse_args(int argc, char** argv, parsed_opts_t** opts)
     };
     kstring_t rg_line = {0,0,NULL};
 
-    while ((n = getopt_long(argc, argv, "r:R:m:o:O:h@:uw", lopts, NULL)) >= 0) {
+    while ((n = samtools_getopt_long(argc, argv, "r:R:m:o:O:h@:uw", lopts, NULL)) >= 0) {
         switch (n) {
             case 'r':
                 // Are we adding to existing rg line?
                 if (ks_len(&rg_line) == 0) {
-                    if (strlen(optarg)<3 || (optarg[0] != '@' && optarg[1] != 'R' && optarg[2] != 'G')) {
+                    if (strlen(samtools_optarg)<3 || (samtools_optarg[0] != '@' && samtools_optarg[1] != 'R' && samtools_optarg[2] != 'G')) {
                         kputs("@RG\t", &rg_line);
                     }
                 } else {
                     kputs("\t", &rg_line);
                 }
-                kputs(optarg, &rg_line);
+                kputs(samtools_optarg, &rg_line);
                 break;
             case 'R':
-                retval->rg_id = strdup(optarg);
+                retval->rg_id = strdup(samtools_optarg);
                 break;
             case 'm': {
-                if (strcmp(optarg, "overwrite_all") == 0) {
+                if (strcmp(samtools_optarg, "overwrite_all") == 0) {
                     retval->mode = overwrite_all;
-                } else if (strcmp(optarg, "orphan_only") == 0) {
+                } else if (strcmp(samtools_optarg, "orphan_only") == 0) {
                     retval->mode = orphan_only;
                 } else {
                     usage(samtools_stderr);
@@ -232,7 +232,7 @@ static bool parse_args(int argc, char** argv, parsed_opts_t** opts)
                 break;
             }
             case 'o':
-                retval->output_name = strdup(optarg);
+                retval->output_name = strdup(samtools_optarg);
                 break;
             case 'h':
                 usage(samtools_stdout);
@@ -253,7 +253,7 @@ static bool parse_args(int argc, char** argv, parsed_opts_t** opts)
                 return false;
             case 'O':
             default:
-                if (parse_sam_global_opt(n, optarg, lopts, &retval->ga) == 0) break;
+                if (parse_sam_global_opt(n, samtools_optarg, lopts, &retval->ga) == 0) break;
                 usage(samtools_stderr);
                 free(retval);
                 return false;
@@ -261,7 +261,7 @@ static bool parse_args(int argc, char** argv, parsed_opts_t** opts)
     }
     retval->rg_line = ks_release(&rg_line);
 
-    if (argc-optind < 1) {
+    if (argc-samtools_optind < 1) {
         fprintf(samtools_stderr, "You must specify an input file.\n");
         usage(samtools_stderr);
         cleanup_opts(retval);
@@ -286,7 +286,7 @@ static bool parse_args(int argc, char** argv, parsed_opts_t** opts)
         free(retval->rg_line);
         retval->rg_line = tmp;
     }
-    retval->input_name = strdup(argv[optind+0]);
+    retval->input_name = strdup(argv[samtools_optind+0]);
 
     if (retval->ga.nthreads > 0) {
         if (!(retval->p.pool = hts_tpool_init(retval->ga.nthreads))) {
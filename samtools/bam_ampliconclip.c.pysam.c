@@ -976,11 +976,11 @@ int amplicon_clip_main(int argc, char **argv) {
         {NULL, 0, NULL, 0}
     };
 
-    while ((c = getopt_long(argc, argv, "b:@:o:O:f:u", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "b:@:o:O:f:u", lopts, NULL)) >= 0) {
         switch (c) {
-            case 'b': bedfile = optarg; break;
-            case 'o': fnout = optarg; break;
-            case 'f': param.stats_file = optarg; break;
+            case 'b': bedfile = samtools_optarg; break;
+            case 'o': fnout = samtools_optarg; break;
+            case 'f': param.stats_file = samtools_optarg; break;
             case 'u': wmode[2] = '0'; break;
             case 1002: param.add_pg = 0; break;
             case 1003: clipping = soft_clip; break;
@@ -989,14 +989,14 @@ int amplicon_clip_main(int argc, char **argv) {
             case 1006: param.write_clipped = 1; break;
             case 1007: param.mark_fail = 1; break;
             case 1008: param.both = 1; break;
-            case 1009: param.filter_len = atoi(optarg); break;
-            case 1010: param.fail_len = atoi(optarg); break;
+            case 1009: param.filter_len = atoi(samtools_optarg); break;
+            case 1010: param.fail_len = atoi(samtools_optarg); break;
             case 1011: param.unmapped = 1; break;
-            case 1012: param.rejects_file = optarg; break;
+            case 1012: param.rejects_file = samtools_optarg; break;
             case 1013: param.oa_tag = 1; break;
             case 1014: param.del_tag = 0; break;
-            case 1015: param.tol = atoi(optarg); break;
-            default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+            case 1015: param.tol = atoi(samtools_optarg); break;
+            default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
                       /* else fall-through */
             case '?': usage(); samtools_exit(1);
         }
@@ -1007,7 +1007,7 @@ int amplicon_clip_main(int argc, char **argv) {
         return 1;
     }
 
-    if (optind + 1 > argc) {
+    if (samtools_optind + 1 > argc) {
         usage();
         return 1;
     }
@@ -1018,7 +1018,7 @@ int amplicon_clip_main(int argc, char **argv) {
         param.tol = 5;
     }
 
-    if ((in = sam_open_format(argv[optind], "rb", &ga.in)) == NULL) {
+    if ((in = sam_open_format(argv[samtools_optind], "rb", &ga.in)) == NULL) {
         print_error_errno("ampliconclip", "cannot open input file");
         return 1;
     }
@@ -1060,7 +1060,7 @@ int amplicon_clip_main(int argc, char **argv) {
     sam_close(in);
 
     if (sam_close(out) < 0) {
-        fprintf(samtools_stderr, "[ampliconclip] error: error while closing output file %s.\n", argv[optind+1]);
+        fprintf(samtools_stderr, "[ampliconclip] error: error while closing output file %s.\n", argv[samtools_optind+1]);
         ret = 1;
     }
 
@@ -475,30 +475,30 @@ int main_cat(int argc, char *argv[])
 
     sam_global_args_init(&ga);
 
-    while ((c = getopt_long(argc, argv, "h:o:b:@:", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "h:o:b:@:", lopts, NULL)) >= 0) {
         switch (c) {
             case 'h': {
-                samFile *fph = sam_open(optarg, "r");
+                samFile *fph = sam_open(samtools_optarg, "r");
                 if (fph == 0) {
-                    fprintf(samtools_stderr, "[%s] ERROR: fail to read the header from '%s'.\n", __func__, optarg);
+                    fprintf(samtools_stderr, "[%s] ERROR: fail to read the header from '%s'.\n", __func__, samtools_optarg);
                     return 1;
                 }
                 h = sam_hdr_read(fph);
                 if (h == NULL) {
                     fprintf(samtools_stderr,
                             "[%s] ERROR: failed to read the header from '%s'.\n",
-                            __func__, optarg);
+                            __func__, samtools_optarg);
                     return 1;
                 }
                 sam_close(fph);
                 break;
             }
-            case 'o': outfn = strdup(optarg); break;
+            case 'o': outfn = strdup(samtools_optarg); break;
             case 'b': {
-                // add file names in "optarg" to the list
+                // add file names in "samtools_optarg" to the list
                 // of files to concatenate
                 int nfns;
-                char **fns_read = hts_readlines(optarg, &nfns);
+                char **fns_read = hts_readlines(samtools_optarg, &nfns);
                 if (fns_read) {
                     infns = realloc(infns, (infns_size + nfns) * sizeof(char*));
                     if (infns == NULL) { ret = 1; goto end; }
@@ -506,7 +506,7 @@ int main_cat(int argc, char *argv[])
                     infns_size += nfns;
                     free(fns_read);
                 } else {
-                    print_error("cat", "Invalid file list \"%s\"", optarg);
+                    print_error("cat", "Invalid file list \"%s\"", samtools_optarg);
                     ret = 1;
                 }
                 break;
@@ -515,7 +515,7 @@ int main_cat(int argc, char *argv[])
                 no_pg = 1;
                 break;
             default:
-                if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+                if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
                 /* else fall-through */
             case '?': usage=1; break;
         }
@@ -527,11 +527,11 @@ int main_cat(int argc, char *argv[])
     }
 
     // Append files specified in argv to the list.
-    int nargv_fns = argc - optind;
+    int nargv_fns = argc - samtools_optind;
     if (nargv_fns > 0) {
         infns = realloc(infns, (infns_size + nargv_fns) * sizeof(char*));
         if (infns == NULL) { ret = 1; goto end; }
-        memcpy(infns + infns_size, argv + optind, nargv_fns * sizeof(char*));
+        memcpy(infns + infns_size, argv + samtools_optind, nargv_fns * sizeof(char*));
     }
 
     // Require at least one input file
@@ -38,6 +38,7 @@ DEALINGS IN THE SOFTWARE.  */
 #include "htslib/klist.h"
 #include "htslib/kstring.h"
 #include "htslib/bgzf.h"
+#include "htslib/hfile.h"
 #include "htslib/thread_pool.h"
 #include "samtools.h"
 #include "sam_opts.h"
@@ -144,6 +145,24 @@ typedef struct bam2fq_opts {
     char compression_level;
 } bam2fq_opts_t;
 
+/*
+ * With a thread pool the records to write are copied into batches, which
+ * are turned into text on the pool, one string per output file.  The
+ * batches are written in the order they were filled, so each file gets
+ * its records in the same order as without threads.
+ */
+#define BAM2FQ_BATCH 2048
+#define BAM2FQ_MAX_OUT 8
+
+typedef struct bam2fq_batch {
+    const struct bam2fq_state *state;
+    bam1_t *bams;
+    int out[BAM2FQ_BATCH];  // index into bam2fq_state.out for each record
+    int n, status;
+    kstring_t text[BAM2FQ_MAX_OUT];
+    struct bam2fq_batch *next;
+} bam2fq_batch_t;
+
 typedef struct bam2fq_state {
     samFile *fp;
     samFile *fpse;
@@ -158,6 +177,13 @@ typedef struct bam2fq_state {
     char *index_sequence;
     char compression_level;
     htsThreadPool p;
+    const char *barcode_tag;
+    kstring_t aux_tags;    // tags to copy to the header line
+    samFile *out[BAM2FQ_MAX_OUT];  // the distinct output files
+    int n_out;
+    hts_tpool_process *q;  // formatting batches, if threaded
+    bam2fq_batch_t *batch, *free_batches;
+    int in_flight, max_jobs;
 } bam2fq_state_t;
 
 static readpart which_readpart(const bam1_t *b)
@@ -349,17 +375,11 @@ void set_sam_opts(samFile *fp, bam2fq_state_t *state,
 
     hts_set_opt(fp, FASTQ_OPT_BARCODE, opts->barcode_tag);
 
-    kstring_t tag_list = {0,0};
-    if (state->copy_tags)
-        kputs("RG,BC,QT", &tag_list);
-    if (opts->extra_tags) {
-        if (tag_list.l)
-            kputc(',', &tag_list);
-        kputs(opts->extra_tags, &tag_list);
-    }
-    if (tag_list.l)
-        hts_set_opt(fp, FASTQ_OPT_AUX, tag_list.s);
-    ks_free(&tag_list);
+    if (state->aux_tags.l)
+        hts_set_opt(fp, FASTQ_OPT_AUX, state->aux_tags.s);
+
+    if (state->n_out < BAM2FQ_MAX_OUT)
+        state->out[state->n_out++] = fp;
 }
 
 // Open a file as normal or gzipped based on filename.
@@ -406,6 +426,14 @@ static bool init_state(const bam2fq_opts_t* opts, bam2fq_state_t** state_out)
     state->index_sequence = NULL;
     state->hstdout = NULL;
     state->compression_level = opts->compression_level;
+    state->barcode_tag = opts->barcode_tag;
+    if (state->copy_tags)
+        kputs("RG,BC,QT", &state->aux_tags);
+    if (opts->extra_tags) {
+        if (state->aux_tags.l)
+            kputc(',', &state->aux_tags);
+        kputs(opts->extra_tags, &state->aux_tags);
+    }
 
     state->fp = sam_open(opts->fn_input, "r");
     if (state->fp == NULL) {
@@ -519,13 +547,54 @@ static bool init_state(const bam2fq_opts_t* opts, bam2fq_state_t** state_out)
         return false;
     }
 
+    if (state->p.pool) {
+        state->max_jobs = hts_tpool_size(state->p.pool) + 2;
+        if (!(state->q = hts_tpool_process_init(state->p.pool,
+                                                state->max_jobs, 0))) {
+            fprintf(stderr, "Failed to create thread queue\n");
+            free(state);
+            return false;
+        }
+    }
+
     *state_out = state;
     return true;
 }
 
+static void bam2fq_batch_destroy(bam2fq_batch_t *batch)
+{
+    int i;
+    if (!batch)
+        return;
+    if (batch->bams) {
+        for (i = 0; i < BAM2FQ_BATCH; i++)
+            free(batch->bams[i].data);
+        free(batch->bams);
+    }
+    for (i = 0; i < BAM2FQ_MAX_OUT; i++)
+        ks_free(&batch->text[i]);
+    free(batch);
+}
+
 static bool destroy_state(const bam2fq_opts_t *opts, bam2fq_state_t *state, int* status)
 {
     bool valid = true;
+    if (state->q) {
+        hts_tpool_result *r;
+        while (state->in_flight-- > 0
+               && (r = hts_tpool_next_result_wait(state->q)) != NULL) {
+            bam2fq_batch_destroy(hts_tpool_result_data(r));
+            hts_tpool_delete_result(r, 0);
+        }
+        hts_tpool_process_destroy(state->q);
+    }
+    bam2fq_batch_destroy(state->batch);
+    while (state->free_batches) {
+        bam2fq_batch_t *next = state->free_batches->next;
+        bam2fq_batch_destroy(state->free_batches);
+        state->free_batches = next;
+    }
+    ks_free(&state->aux_tags);
     sam_hdr_destroy(state->h);
     check_sam_close("bam2fq", state->fp, opts->fn_input, "file", status);
     if (state->fpse && sam_close(state->fpse) < 0) {
@@ -578,6 +647,230 @@ static inline bool filter_it_out(const bam1_t *b, const bam2fq_state_t *state)
 
 }
 
+// Whether key is one of the tags to copy, checking the list as htslib's
+// FASTQ_OPT_AUX does
+static bool bam2fq_want_tag(const char *tags, const uint8_t *key)
+{
+    size_t i, tlen = strlen(tags);
+    if (strcmp(tags, "1") == 0)
+        return true;
+    for (i = 0; i+3 <= tlen+1; i += 3) {
+        if (tags[i+0] == ',' || tags[i+1] == ',' ||
+            !(tags[i+2] == ',' || tags[i+2] == '\0'))
+            break;
+        if (tags[i+0] == key[0] && tags[i+1] == key[1])
+            return true;
+    }
+    return false;
+}
+
+// Appends b to str as the FASTQ or FASTA text htslib writes for it with
+// the options of set_sam_opts
+static int bam2fq_format(const bam2fq_state_t *state, const bam1_t *b,
+                         kstring_t *str)
+{
+    unsigned flag = b->core.flag;
+    int i, e = 0, len = b->core.l_qseq;
+    uint8_t *seq, *qual;
+
+    if (len == 0) return 0;
+
+    // Name
+    e |= kputc(state->filetype == FASTQ ? '@' : '>', str) < 0;
+    e |= kputs(bam_get_qname(b), str) < 0;
+
+    // /1 or /2 suffix
+    if (state->has12 && (flag & BAM_FPAIRED)) {
+        int r12 = flag & (BAM_FREAD1 | BAM_FREAD2);
+        if (r12 == BAM_FREAD1)
+            e |= kputs("/1", str) < 0;
+        else if (r12 == BAM_FREAD2)
+            e |= kputs("/2", str) < 0;
+    }
+
+    // Illumina CASAVA tag, <rnum>:<Y/N qcfail>:<control-bits>:<barcode-or-zero>
+    if (state->illumina_tag) {
+        int rnum = (flag & BAM_FREAD1)? 1 : (flag & BAM_FREAD2)? 2 : 0;
+        char filtered = (flag & BAM_FQCFAIL)? 'Y' : 'N';
+        uint8_t *bc = bam_aux_get(b, state->barcode_tag);
+        if (ksprintf(str, " %d:%c:0:%s", rnum, filtered,
+                     bc ? (char *)bc+1 : "0") < 0)
+            return -1;
+
+        // Replace any non-alpha with '+'.  Ie seq-seq to seq+seq
+        if (bc) {
+            int l = strlen((char *)bc+1);
+            char *c = str->s + str->l - l;
+            for (i = 0; i < l; i++)
+                if (!isalpha((unsigned char) c[i]))
+                    c[i] = '+';
+        }
+    }
+
+    // Aux tags
+    if (state->aux_tags.l) {
+        const uint8_t *s = bam_get_aux(b), *end = b->data + b->l_data;
+        while (s && end - s >= 4) {
+            size_t l = str->l;
+            bool want = bam2fq_want_tag(state->aux_tags.s, s);
+            e |= kputc_('\t', str) < 0;
+            if (!(s = sam_format_aux1(s, s[2], s+3, end, str)))
+                return -1;
+            if (!want)
+                str->l = l;
+        }
+    }
+
+    if (ks_resize(str, str->l + 1 + len+1 + 2 + len+1 + 1) < 0) return -1;
+    e |= kputc_('\n', str) < 0;
+
+    // Seq line
+    seq = bam_get_seq(b);
+    if (flag & BAM_FREVERSE)
+        for (i = len-1; i >= 0; i--)
+            e |= kputc_("!TGKCYSBAWRDMHVN"[bam_seqi(seq, i)], str) < 0;
+    else
+        for (i = 0; i < len; i++)
+            e |= kputc_(seq_nt16_str[bam_seqi(seq, i)], str) < 0;
+
+    // Qual line
+    if (state->filetype == FASTQ) {
+        e |= kputsn("\n+\n", 3, str) < 0;
+        if (ks_resize(str, str->l + len + 2) < 0) return -1;
+        qual = bam_get_qual(b);
+        if (qual[0] == 0xff)
+            for (i = 0; i < len; i++)
+                e |= kputc_('B', str) < 0;
+        else if (flag & BAM_FREVERSE)
+            for (i = len-1; i >= 0; i--)
+                e |= kputc_(33 + qual[i], str) < 0;
+        else
+            for (i = 0; i < len; i++)
+                e |= kputc_(33 + qual[i], str) < 0;
+    }
+    e |= kputc('\n', str) < 0;
+
+    return e ? -1 : 0;
+}
+
+// Runs on the thread pool: turns a batch of records into text
+static void *bam2fq_format_worker(void *arg)
+{
+    bam2fq_batch_t *batch = (bam2fq_batch_t *)arg;
+    int i;
+
+    for (i = 0; i < batch->n && !batch->status; i++)
+        if (bam2fq_format(batch->state, &batch->bams[i],
+                          &batch->text[batch->out[i]]) < 0)
+            batch->status = -1;
+
+    return batch;
+}
+
+// Writes out the oldest batch sent to the thread pool, waiting for it if
+// wait is set.  Returns 1 if a batch was written, 0 if none was ready yet
+// and -1 on error.
+static int bam2fq_collect(bam2fq_state_t *state, int wait)
+{
+    hts_tpool_result *r;
+    bam2fq_batch_t *batch;
+    int i, ret = 1;
+
+    r = wait ? hts_tpool_next_result_wait(state->q)
+             : hts_tpool_next_result(state->q);
+    if (!r)
+        return wait ? -1 : 0;
+    batch = hts_tpool_result_data(r);
+    hts_tpool_delete_result(r, 0);
+    state->in_flight--;
+
+    if (batch->status < 0)
+        ret = -1;
+    for (i = 0; i < state->n_out; i++) {
+        samFile *fp = state->out[i];
+        kstring_t *ks = &batch->text[i];
+        if (ret > 0 && ks->l
+            && (fp->is_bgzf ? bgzf_write(fp->fp.bgzf, ks->s, ks->l)
+                            : hwrite(fp->fp.hfile, ks->s, ks->l)) != ks->l)
+            ret = -1;
+        ks->l = 0;
+    }
+
+    batch->n = 0;
+    batch->next = state->free_batches;
+    state->free_batches = batch;
+    return ret;
+}
+
+// Sends the current batch to the thread pool, first writing out the batches
+// already done
+static int bam2fq_dispatch(bam2fq_state_t *state)
+{
+    int ret;
+
+    while ((ret = bam2fq_collect(state, state->in_flight >= state->max_jobs)) > 0)
+        ;
+    if (ret < 0)
+        return -1;
+
+    if (hts_tpool_dispatch(state->p.pool, state->q, bam2fq_format_worker,
+                           state->batch) < 0)
+        return -1;
+    state->batch = NULL;
+    state->in_flight++;
+    return 0;
+}
+
+// Writes b to fp, through the formatting batches if there is a thread pool
+static int bam2fq_write(bam2fq_state_t *state, samFile *fp, const bam1_t *b)
+{
+    bam2fq_batch_t *batch;
+    int i;
+
+    if (!state->q)
+        return sam_write1(fp, state->h, b);
+
+    for (i = 0; i < state->n_out && state->out[i] != fp; i++)
+        ;
+    if (i == state->n_out)
+        return sam_write1(fp, state->h, b);
+
+    if (!(batch = state->batch)) {
+        if ((batch = state->free_batches) != NULL) {
+            state->free_batches = batch->next;
+        } else {
+            if (!(batch = calloc(1, sizeof(*batch))))
+                return -1;
+            if (!(batch->bams = calloc(BAM2FQ_BATCH, sizeof(bam1_t)))) {
+                free(batch);
+                return -1;
+            }
+            batch->state = state;
+        }
+        batch->next = NULL;
+        state->batch = batch;
+    }
+
+    if (!bam_copy1(&batch->bams[batch->n], b))
+        return -1;
+    batch->out[batch->n++] = i;
+
+    return batch->n == BAM2FQ_BATCH ? bam2fq_dispatch(state) : 0;
+}
+
+// Writes out everything still in the formatting batches
+static int bam2fq_flush(bam2fq_state_t *state)
+{
+    if (!state->q)
+        return 0;
+    if (state->batch && state->batch->n > 0 && bam2fq_dispatch(state) < 0)
+        return -1;
+    while (state->in_flight > 0)
+        if (bam2fq_collect(state, 1) < 0)
+            return -1;
+    return 0;
+}
+
 int write_index_rec(samFile *fp, bam1_t *b, bam2fq_state_t *state,
                     bam2fq_opts_t* opts, char *seq, int seq_len,
                     char *qual, int qual_len) {
@@ -610,7 +903,7 @@ int write_index_rec(samFile *fp, bam1_t *b, bam2fq_state_t *state,
 
     memcpy(bam_get_aux(b2), bam_get_aux(b), aux_len);
     b2->l_data += aux_len;
-    if (sam_write1(fp, state->h, b2) < 0)
+    if (bam2fq_write(state, fp, b2) < 0)
         goto err;
 
     ret = 0;
@@ -716,9 +1009,9 @@ static int flush_rec(bam2fq_state_t *state, bam2fq_opts_t* opts,
                     goto err;
 
         }
-        if (sam_write1(state->fpr[1], state->h, b[best[1]]) < 0)
+        if (bam2fq_write(state, state->fpr[1], b[best[1]]) < 0)
             goto err;
-        if (sam_write1(state->fpr[2], state->h, b[best[2]]) < 0)
+        if (bam2fq_write(state, state->fpr[2], b[best[2]]) < 0)
             goto err;
 
         if (output_index(b[best[1]], b[best[2]], state, opts) < 0)
@@ -727,19 +1020,19 @@ static int flush_rec(bam2fq_state_t *state, bam2fq_opts_t* opts,
         if (state->fpse) {
             // print whichever one exists to fpse
             if (score[1] > 0) {
-                if (sam_write1(state->fpse, state->h, b[best[1]]) < 0)
+                if (bam2fq_write(state, state->fpse, b[best[1]]) < 0)
                     goto err;
             } else {
-                if (sam_write1(state->fpse, state->h, b[best[2]]) < 0)
+                if (bam2fq_write(state, state->fpse, b[best[2]]) < 0)
                     goto err;
             }
             ++(*n_singletons);
         } else {
             if (score[1] > 0) {
-                if (sam_write1(state->fpr[1], state->h, b[best[1]]) < 0)
+                if (bam2fq_write(state, state->fpr[1], b[best[1]]) < 0)
                     goto err;
             } else {
-                if (sam_write1(state->fpr[2], state->h, b[best[2]]) < 0)
+                if (bam2fq_write(state, state->fpr[2], b[best[2]]) < 0)
                     goto err;
             }
         }
@@ -751,7 +1044,7 @@ static int flush_rec(bam2fq_state_t *state, bam2fq_opts_t* opts,
     }
 
     if (score[0]) { // single ended data (neither READ1 nor READ2)
-        if (sam_write1(state->fpr[0], state->h, b[best[0]]) < 0)
+        if (bam2fq_write(state, state->fpr[0], b[best[0]]) < 0)
             goto err;
 
         if (output_index(b[best[0]], NULL, state, opts) < 0)
@@ -839,6 +1132,9 @@ static bool bam2fq_mainloop(bam2fq_state_t *state, bam2fq_opts_t* opts)
         }
     }
 
+    if (bam2fq_flush(state) < 0)
+        goto err;
+
     valid = true;
  err:
     if (!valid)
@@ -430,39 +430,39 @@ int main_import(int argc, char *argv[]) {
         { NULL, 0, NULL, 0 }
     };
 
-    while ((c = getopt_long(argc, argv, "1:2:s:0:bhiT:r:R:o:O:u@:", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "1:2:s:0:bhiT:r:R:o:O:u@:", lopts, NULL)) >= 0) {
         switch (c) {
         case 'b': opts.idx_both = 1; break;
-        case '0': opts.fn[FQ_R0] = optarg; break;
-        case '1': opts.fn[FQ_R1] = optarg; break;
-        case '2': opts.fn[FQ_R2] = optarg; break;
-        case  1:  opts.fn[FQ_I1] = optarg; break;
-        case  2:  opts.fn[FQ_I2] = optarg; break;
-        case 's': opts.fn[FQ_SINGLE] = optarg; break;
-        case 'o': opts.fn_out = optarg; break;
+        case '0': opts.fn[FQ_R0] = samtools_optarg; break;
+        case '1': opts.fn[FQ_R1] = samtools_optarg; break;
+        case '2': opts.fn[FQ_R2] = samtools_optarg; break;
+        case  1:  opts.fn[FQ_I1] = samtools_optarg; break;
+        case  2:  opts.fn[FQ_I2] = samtools_optarg; break;
+        case 's': opts.fn[FQ_SINGLE] = samtools_optarg; break;
+        case 'o': opts.fn_out = samtools_optarg; break;
         case 'i': opts.casava = 1; break;
-        case  4:  opts.barcode_seq = optarg; break;
-        case  5:  opts.barcode_qual = optarg; break;
-        case 'T': opts.aux = optarg; break;
+        case  4:  opts.barcode_seq = samtools_optarg; break;
+        case  5:  opts.barcode_qual = samtools_optarg; break;
+        case 'T': opts.aux = samtools_optarg; break;
         case 'u': opts.compress_level = 0; break;
-        case 'R': opts.rg = optarg; break;
+        case 'R': opts.rg = samtools_optarg; break;
         case 'r':
-            if (*optarg != '@' && ks_len(&rg) == 0)
+            if (*samtools_optarg != '@' && ks_len(&rg) == 0)
                 kputs("@RG", &rg);
             if (ks_len(&rg))
                 kputc_('\t', &rg);
-            kputs(optarg, &rg);
+            kputs(samtools_optarg, &rg);
             opts.rg_line = rg.s;
             break;
 
         case 9: opts.no_pg = 1; break;
-        case 3: opts.order = optarg; break;
+        case 3: opts.order = samtools_optarg; break;
 
         case 'h': return usage(samtools_stdout, EXIT_SUCCESS);
         case '?': return usage(samtools_stderr, EXIT_FAILURE);
 
         default:
-            if (parse_sam_global_opt(c, optarg, lopts, &opts.ga) != 0)
+            if (parse_sam_global_opt(c, samtools_optarg, lopts, &opts.ga) != 0)
                 return usage(samtools_stderr, EXIT_FAILURE);
             break;
         }
@@ -477,7 +477,7 @@ int main_import(int argc, char *argv[]) {
         }
     }
 
-    int ret = import_fastq(argc-optind, argv+optind, &opts) ? 1 : 0;
+    int ret = import_fastq(argc-samtools_optind, argv+samtools_optind, &opts) ? 1 : 0;
 
     if (rg.s)
         free(rg.s);
@@ -61,44 +61,44 @@ int bam_index(int argc, char *argv[])
     int n_threads = 0;
     int c, ret;
 
-    while ((c = getopt(argc, argv, "bcm:@:")) >= 0)
+    while ((c = samtools_getopt(argc, argv, "bcm:@:")) >= 0)
         switch (c) {
         case 'b': csi = 0; break;
         case 'c': csi = 1; break;
-        case 'm': csi = 1; min_shift = atoi(optarg); break;
-        case '@': n_threads = atoi(optarg); break;
+        case 'm': csi = 1; min_shift = atoi(samtools_optarg); break;
+        case '@': n_threads = atoi(samtools_optarg); break;
         default:
             index_usage(samtools_stderr);
             return 1;
         }
 
-    if (optind == argc) {
+    if (samtools_optind == argc) {
         index_usage(samtools_stdout);
         return 1;
     }
 
-    ret = sam_index_build3(argv[optind], argv[optind+1], csi? min_shift : 0, n_threads);
+    ret = sam_index_build3(argv[samtools_optind], argv[samtools_optind+1], csi? min_shift : 0, n_threads);
     switch (ret) {
     case 0:
         return 0;
 
     case -2:
-        print_error_errno("index", "failed to open \"%s\"", argv[optind]);
+        print_error_errno("index", "failed to open \"%s\"", argv[samtools_optind]);
         break;
 
     case -3:
-        print_error("index", "\"%s\" is in a format that cannot be usefully indexed", argv[optind]);
+        print_error("index", "\"%s\" is in a format that cannot be usefully indexed", argv[samtools_optind]);
         break;
 
     case -4:
-        if (argv[optind+1])
-            print_error("index", "failed to create or write index \"%s\"", argv[optind+1]);
+        if (argv[samtools_optind+1])
+            print_error("index", "failed to create or write index \"%s\"", argv[samtools_optind+1]);
         else
             print_error("index", "failed to create or write index");
         break;
 
     default:
-        print_error_errno("index", "failed to create index for \"%s\"", argv[optind]);
+        print_error_errno("index", "failed to create index for \"%s\"", argv[samtools_optind]);
         break;
     }
 
@@ -186,28 +186,28 @@ int bam_idxstats(int argc, char *argv[])
         {NULL, 0, NULL, 0}
     };
 
-    while ((c = getopt_long(argc, argv, "@:", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "@:", lopts, NULL)) >= 0) {
         switch (c) {
-        default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+        default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
             /* else fall-through */
         case '?':
             usage_exit(samtools_stderr, EXIT_FAILURE);
         }
     }
 
-    if (argc != optind+1) {
-        if (argc == optind) usage_exit(samtools_stdout, EXIT_SUCCESS);
+    if (argc != samtools_optind+1) {
+        if (argc == samtools_optind) usage_exit(samtools_stdout, EXIT_SUCCESS);
         else usage_exit(samtools_stderr, EXIT_FAILURE);
     }
 
-    fp = sam_open_format(argv[optind], "r", &ga.in);
+    fp = sam_open_format(argv[samtools_optind], "r", &ga.in);
     if (fp == NULL) {
-        print_error_errno("idxstats", "failed to open \"%s\"", argv[optind]);
+        print_error_errno("idxstats", "failed to open \"%s\"", argv[samtools_optind]);
         return 1;
     }
     header = sam_hdr_read(fp);
     if (header == NULL) {
-        print_error("idxstats", "failed to read header for \"%s\"", argv[optind]);
+        print_error("idxstats", "failed to read header for \"%s\"", argv[samtools_optind]);
         return 1;
     }
 
@@ -217,14 +217,14 @@ int bam_idxstats(int argc, char *argv[])
             hts_set_threads(fp, ga.nthreads);
 
         if (slow_idxstats(fp, header) < 0) {
-            print_error("idxstats", "failed to process \"%s\"", argv[optind]);
+            print_error("idxstats", "failed to process \"%s\"", argv[samtools_optind]);
             return 1;
         }
     } else {
-        idx = sam_index_load(fp, argv[optind]);
+        idx = sam_index_load(fp, argv[samtools_optind]);
         if (idx == NULL) {
             print_error("idxstats", "fail to load index for \"%s\", "
-                        "reverting to slow method", argv[optind]);
+                        "reverting to slow method", argv[samtools_optind]);
             goto slow_method;
         }
 
@@ -39,6 +39,7 @@ Copyright (c) 2009,2018 The Broad Institute.  MIT license.
 #include <time.h>
 #include <sys/stat.h>
 #include <math.h>
+#include <stdarg.h>
 #include "htslib/thread_pool.h"
 #include "htslib/sam.h"
 #include "sam_opts.h"
@@ -68,6 +69,7 @@ typedef struct {
     char *stats_file;
     char *arg_list;
     char *out_fn;
+    hts_tpool *pool;
 } md_param_t;
 
 typedef struct {
@@ -87,6 +89,7 @@ typedef struct read_queue_s {
     struct read_queue_s *duplicate;
     hts_pos_t pos;
     int dup_checked;
+    int64_t idx;
 } read_queue_t;
 
 typedef struct {
@@ -96,6 +99,8 @@ typedef struct {
 typedef struct {
     char *name;
     char type;
+    char added;     // parallel marking, the name was added here
+    char retag;     // parallel marking, the type was changed to optical here
 } dup_map_t;
 
 typedef struct {
@@ -195,6 +200,42 @@ KHASH_INIT(reads, key_data_t, in_hash_t, 1, hash_key, key_equal) // read map has
 KLIST_INIT(read_queue, read_queue_t, __free_queue_element) // the reads buffer
 KHASH_MAP_INIT_STR(duplicates, dup_map_t) // map of duplicates for supplementary dup id
 
+typedef struct {
+    long reading;
+    long writing;
+    long excluded;
+    long duplicate;
+    long single;
+    long pair;
+    long single_dup;
+    long examined;
+    long optical;
+    long single_optical;
+    long opt_warnings;
+} md_stats_t;
+
+typedef struct md_job md_job_t;
+
+/* The reads that can still be duplicates of reads to come and the hashes
+   to find them by position. */
+typedef struct {
+    khash_t(reads) *pair_hash;
+    khash_t(reads) *single_hash;
+    klist_t(read_queue) *read_buffer;
+    khash_t(duplicates) *dup_hash;
+    check_list_t dup_list;
+    int32_t prev_tid;
+    hts_pos_t prev_coord;
+    int64_t n_read;
+    int exclude;
+    md_stats_t *stats;
+    samFile *out;
+    sam_hdr_t *header;
+    tmp_file_t *temp;
+    md_job_t *job;      // set when marking part of the input in parallel
+    int counting;       // the current read is one the job counts and writes
+} md_state_t;
+
 
 /* Calculate the mate's unclipped start based on position and cigar string from MC tag. */
 
@@ -331,6 +372,71 @@ static khint32_t do_hash(unsigned char *key, khint32_t len) {
 }
 
 
+/* The messages of a job marking part of the input on the thread pool,
+   they are printed by the main thread. */
+static __thread kstring_t *md_job_messages = NULL;
+
+/* Whether the job is at a read it counts, the warnings about the other
+   reads are left to the jobs they belong to. */
+static __thread int md_job_counting = 0;
+
+/* A job keeps all warnings about read names, each on a line starting with
+   MD_MSG_NAME, and a line of MD_MSG_LIMIT where a duplicate added to their
+   number.  The main thread counts them in input order to print the same
+   warnings as a single thread, see md_job_print_messages(). */
+#define MD_MSG_NAME  '\001'
+#define MD_MSG_LIMIT '\002'
+
+/* Print an error or warning, or keep it with the job running in this
+   thread. */
+static void md_error(const char *format, ...) {
+    va_list ap;
+
+    va_start(ap, format);
+
+    if (md_job_messages)
+        kvsprintf(md_job_messages, format, ap);
+    else
+        vfprintf(samtools_stderr, format, ap);
+
+    va_end(ap);
+}
+
+
+/* Count a read name that coordinates cannot be read from and warn about
+   the first BMD_WARNING_MAX of them. */
+static void md_name_warning(long *warnings, const char *format, const char *name) {
+    (*warnings)++;
+
+    if (md_job_messages) {
+        if (md_job_counting) {
+            kputc(MD_MSG_NAME, md_job_messages);
+            ksprintf(md_job_messages, format, name);
+        }
+    } else if (*warnings <= BMD_WARNING_MAX) {
+        fprintf(samtools_stderr, format, name);
+    }
+}
+
+
+/* Tell that no more warnings are printed once a duplicate has reached the
+   limit, called with the number before and after marking it. */
+static void md_name_warning_limit(long incoming, long warnings) {
+    if (incoming == warnings)
+        return;
+
+    if (md_job_messages) {
+        if (md_job_counting) {
+            kputc(MD_MSG_LIMIT, md_job_messages);
+            kputc('\n', md_job_messages);
+        }
+    } else if (warnings == BMD_WARNING_MAX) {
+        fprintf(samtools_stderr, "[markdup] warning: %ld decipher read name warnings.  New warnings will not be reported.\n",
+                        warnings);
+    }
+}
+
+
 /* Get mate score from tag. */
 
 static int64_t get_mate_score(bam1_t *b) {
@@ -340,7 +446,7 @@ static int64_t get_mate_score(bam1_t *b) {
     if ((data = bam_aux_get(b, "ms"))) {
         score = bam_aux2i(data);
     } else {
-        fprintf(samtools_stderr, "[markdup] error: no ms score tag. Please run samtools fixmate on file first.\n");
+        md_error("[markdup] error: no ms score tag. Please run samtools fixmate on file first.\n");
         return -1;
     }
 
@@ -384,14 +490,14 @@ static int make_pair_key_template(key_data_t *key, bam1_t *bam) {
 
     if ((data = bam_aux_get(bam, "MC"))) {
         if (!(cig = bam_aux2Z(data))) {
-            fprintf(samtools_stderr, "[markdup] error: MC tag wrong type. Please use the MC tag provided by samtools fixmate.\n");
+            md_error("[markdup] error: MC tag wrong type. Please use the MC tag provided by samtools fixmate.\n");
             return 1;
         }
 
         other_end   = unclipped_other_end(bam->core.mpos, cig);
         other_coord = unclipped_other_start(bam->core.mpos, cig);
     } else {
-        fprintf(samtools_stderr, "[markdup] error: no MC tag. Please run samtools fixmate on file first.\n");
+        md_error("[markdup] error: no MC tag. Please run samtools fixmate on file first.\n");
         return 1;
     }
 
@@ -501,14 +607,14 @@ static int make_pair_key_sequence(key_data_t *key, bam1_t *bam) {
 
     if ((data = bam_aux_get(bam, "MC"))) {
         if (!(cig = bam_aux2Z(data))) {
-            fprintf(samtools_stderr, "[markdup] error: MC tag wrong type. Please use the MC tag provided by samtools fixmate.\n");
+            md_error("[markdup] error: MC tag wrong type. Please use the MC tag provided by samtools fixmate.\n");
             return 1;
         }
 
         other_end   = unclipped_other_end(bam->core.mpos, cig);
         other_coord = unclipped_other_start(bam->core.mpos, cig);
     } else {
-        fprintf(samtools_stderr, "[markdup] error: no MC tag. Please run samtools fixmate on file first.\n");
+        md_error("[markdup] error: no MC tag. Please run samtools fixmate on file first.\n");
         return 1;
     }
 
@@ -665,7 +771,7 @@ static int add_duplicate(khash_t(duplicates) *d_hash, bam1_t *dupe, char *orig_n
                 kh_value(d_hash, d).name = strdup(orig_name);
 
                 if (kh_value(d_hash, d).name == NULL) {
-                    fprintf(samtools_stderr, "[markdup] error: unable to allocate memory for duplicate original name.\n");
+                    md_error("[markdup] error: unable to allocate memory for duplicate original name.\n");
                     return 1;
                 }
             } else {
@@ -673,8 +779,10 @@ static int add_duplicate(khash_t(duplicates) *d_hash, bam1_t *dupe, char *orig_n
             }
 
             kh_value(d_hash, d).type = type;
+            kh_value(d_hash, d).added = 1;
+            kh_value(d_hash, d).retag = 0;
         } else {
-            fprintf(samtools_stderr, "[markdup] error: unable to store supplementary duplicates.\n");
+            md_error("[markdup] error: unable to store supplementary duplicates.\n");
             free(name);
             return 1;
         }
@@ -684,6 +792,67 @@ static int add_duplicate(khash_t(duplicates) *d_hash, bam1_t *dupe, char *orig_n
 }
 
 
+/* Change the type of a duplicate in the hash to optical.  When marking part of
+   the input the name may have been added by an earlier part, so note the change
+   for when the parts are merged. */
+
+static int retag_duplicate(md_state_t *st, bam1_t *b) {
+    khash_t(duplicates) *d_hash = st->dup_hash;
+    khiter_t d;
+    int ret;
+
+    d = kh_get(duplicates, d_hash, bam_get_qname(b));
+
+    if (d == kh_end(d_hash)) {
+        char *name;
+
+        if (!st->job) {
+            // error, name should already be in dup hash
+            md_error("[markdup] error: duplicate name %s not found in hash.\n",
+                bam_get_qname(b));
+            return -1;
+        }
+
+        if ((name = strdup(bam_get_qname(b))) == NULL) {
+            ret = -1;
+        } else {
+            d = kh_put(duplicates, d_hash, name, &ret);
+        }
+
+        if (ret < 0) {
+            md_error("[markdup] error: unable to store supplementary duplicates.\n");
+            free(name);
+            return -1;
+        }
+
+        kh_value(d_hash, d).name = NULL;
+        kh_value(d_hash, d).added = 0;
+    }
+
+    kh_value(d_hash, d).type = 'O';
+    kh_value(d_hash, d).retag = 1;
+
+    return 0;
+}
+
+
+static void destroy_duplicates(khash_t(duplicates) *d_hash) {
+    khiter_t d;
+
+    if (!d_hash)
+        return;
+
+    for (d = kh_begin(d_hash); d != kh_end(d_hash); ++d) {
+        if (kh_exist(d_hash, d)) {
+            free(kh_val(d_hash, d).name);
+            free((char *)kh_key(d_hash, d));
+        }
+    }
+
+    kh_destroy(duplicates, d_hash);
+}
+
+
 /* Get the position of the coordinates from the read name. */
 static inline int get_coordinate_positions(const char *qname, int *xpos, int *ypos) {
     int sep = 0;
@@ -731,11 +900,7 @@ static int get_coordinates(const char *name, int *xpos_out, long *x_coord, long
     */
 
     if (!(seps == 3 || seps == 4 || seps == 6 || seps == 7)) {
-        (*warnings)++;
-
-        if (*warnings <= BMD_WARNING_MAX) {
-            fprintf(samtools_stderr, "[markdup] warning: cannot decipher read name %s for optical duplicate marking.\n", name);
-        }
+        md_name_warning(warnings, "[markdup] warning: cannot decipher read name %s for optical duplicate marking.\n", name);
 
         return ret;
     }
@@ -743,11 +908,7 @@ static int get_coordinates(const char *name, int *xpos_out, long *x_coord, long
     x = strtol(name + xpos, &end, 10);
 
     if ((name + xpos) == end) {
-        (*warnings)++;
-
-        if (*warnings <= BMD_WARNING_MAX) {
-            fprintf(samtools_stderr, "[markdup] warning: can not decipher X coordinate in %s .\n", name);
-        }
+        md_name_warning(warnings, "[markdup] warning: can not decipher X coordinate in %s .\n", name);
 
         return ret;
     }
@@ -755,11 +916,7 @@ static int get_coordinates(const char *name, int *xpos_out, long *x_coord, long
     y = strtol(name + ypos, &end, 10);
 
     if ((name + ypos) == end) {
-        (*warnings)++;
-
-        if (*warnings <= BMD_WARNING_MAX) {
-            fprintf(samtools_stderr, "[markdup] warning: can not decipher y coordinate in %s .\n", name);
-        }
+        md_name_warning(warnings, "[markdup] warning: can not decipher y coordinate in %s .\n", name);
 
         return ret;
     }
@@ -788,11 +945,7 @@ static int optical_duplicate(bam1_t *ori, bam1_t *dup, long max_dist, long *warn
     seps = get_coordinate_positions(original, &oxpos, &oypos);
 
     if (!(seps == 3 || seps == 4 || seps == 6 || seps == 7)) {
-        (*warnings)++;
-
-        if (*warnings <= BMD_WARNING_MAX) {
-            fprintf(samtools_stderr, "[markdup] warning: cannot decipher read name %s for optical duplicate marking.\n", original);
-        }
+        md_name_warning(warnings, "[markdup] warning: cannot decipher read name %s for optical duplicate marking.\n", original);
 
         return ret;
     }
@@ -801,11 +954,7 @@ static int optical_duplicate(bam1_t *ori, bam1_t *dup, long max_dist, long *warn
 
     if (!(seps == 3 || seps == 4 || seps == 6 || seps == 7)) {
 
-        (*warnings)++;
-
-        if (*warnings <= BMD_WARNING_MAX) {
-            fprintf(samtools_stderr, "[markdup] warning: cannot decipher read name %s for optical duplicate marking.\n", duplicate);
-        }
+        md_name_warning(warnings, "[markdup] warning: cannot decipher read name %s for optical duplicate marking.\n", duplicate);
 
         return ret;
     }
@@ -818,11 +967,7 @@ static int optical_duplicate(bam1_t *ori, bam1_t *dup, long max_dist, long *warn
         ox = strtol(original + oxpos, &end, 10);
 
         if ((original + oxpos) == end) {
-            (*warnings)++;
-
-            if (*warnings <= BMD_WARNING_MAX) {
-                fprintf(samtools_stderr, "[markdup] warning: can not decipher X coordinate in %s .\n", original);
-            }
+            md_name_warning(warnings, "[markdup] warning: can not decipher X coordinate in %s .\n", original);
 
             return ret;
         }
@@ -830,11 +975,7 @@ static int optical_duplicate(bam1_t *ori, bam1_t *dup, long max_dist, long *warn
         dx = strtol(duplicate + dxpos, &end, 10);
 
         if ((duplicate + dxpos) == end) {
-            (*warnings)++;
-
-            if (*warnings <= BMD_WARNING_MAX) {
-                fprintf(samtools_stderr, "[markdup] warning: can not decipher X coordinate in %s.\n", duplicate);
-            }
+            md_name_warning(warnings, "[markdup] warning: can not decipher X coordinate in %s.\n", duplicate);
 
             return ret;
         }
@@ -851,11 +992,7 @@ static int optical_duplicate(bam1_t *ori, bam1_t *dup, long max_dist, long *warn
             oy = strtol(original + oypos, &end, 10);
 
             if ((original + oypos) == end) {
-                (*warnings)++;
-
-                if (*warnings <= BMD_WARNING_MAX) {
-                    fprintf(samtools_stderr, "[markdup] warning: can not decipher Y coordinate in %s.\n", original);
-                }
+                md_name_warning(warnings, "[markdup] warning: can not decipher Y coordinate in %s.\n", original);
 
                 return ret;
             }
@@ -863,11 +1000,7 @@ static int optical_duplicate(bam1_t *ori, bam1_t *dup, long max_dist, long *warn
             dy = strtol(duplicate + dypos, &end, 10);
 
             if ((duplicate + dypos) == end) {
-                (*warnings)++;
-
-                if (*warnings <= BMD_WARNING_MAX) {
-                    fprintf(samtools_stderr, "[markdup] warning: can not decipher Y coordinate in %s.\n", duplicate);
-                }
+                md_name_warning(warnings, "[markdup] warning: can not decipher Y coordinate in %s.\n", duplicate);
 
                 return ret;
             }
@@ -939,7 +1072,7 @@ static int optical_duplicate_partial(const char *name, const int oxpos, const lo
 
 
 /* Mark the read as a duplicate and update the duplicate hash (if needed) */
-static int mark_duplicates(md_param_t *param, khash_t(duplicates) *dup_hash, bam1_t *ori, bam1_t *dup,
+static int mark_duplicates(md_param_t *param, md_state_t *st, bam1_t *ori, bam1_t *dup,
                            long *optical, long *warn) {
     char dup_type = 0;
     long incoming_warnings = *warn;
@@ -948,7 +1081,7 @@ static int mark_duplicates(md_param_t *param, khash_t(duplicates) *dup_hash, bam
 
     if (param->tag) {
         if (bam_aux_update_str(dup, "do", strlen(bam_get_qname(ori)) + 1, bam_get_qname(ori))) {
-            fprintf(samtools_stderr, "[markdup] error: unable to append 'do' tag.\n");
+            md_error("[markdup] error: unable to append 'do' tag.\n");
             return -1;
         }
     }
@@ -964,12 +1097,9 @@ static int mark_duplicates(md_param_t *param, khash_t(duplicates) *dup_hash, bam
         }
     }
 
-    if ((*warn == BMD_WARNING_MAX) && (incoming_warnings != *warn)) {
-        fprintf(samtools_stderr, "[markdup] warning: %ld decipher read name warnings.  New warnings will not be reported.\n",
-                        *warn);
-    }
+    md_name_warning_limit(incoming_warnings, *warn);
 
-    if (param->supp) {
+    if (param->supp && (!st->job || st->counting)) {
         if (bam_aux_get(dup, "SA") || (dup->core.flag & BAM_FMUNMAP) || bam_aux_get(dup, "XA")) {
             char *original = NULL;
 
@@ -977,7 +1107,7 @@ static int mark_duplicates(md_param_t *param, khash_t(duplicates) *dup_hash, bam
                 original = bam_get_qname(ori);
             }
 
-            if (add_duplicate(dup_hash, dup, original, dup_type))
+            if (add_duplicate(st->dup_hash, dup, original, dup_type))
                 return -1;
         }
     }
@@ -987,11 +1117,11 @@ static int mark_duplicates(md_param_t *param, khash_t(duplicates) *dup_hash, bam
 
 
 /* If the duplicate type has changed to optical then retag and duplicate hash. */
-static inline int optical_retag(md_param_t *param, khash_t(duplicates) *dup_hash, bam1_t *b, int paired, long *optical_single, long *optical_pair) {
+static inline int optical_retag(md_param_t *param, md_state_t *st, bam1_t *b, int paired, long *optical_single, long *optical_pair) {
     int ret = 0;
 
     if (bam_aux_update_str(b, "dt", 3, "SQ")) {
-        fprintf(samtools_stderr, "[markdup] error: unable to update 'dt' tag.\n");
+        md_error("[markdup] error: unable to update 'dt' tag.\n");
         ret = -1;
     }
 
@@ -1001,23 +1131,13 @@ static inline int optical_retag(md_param_t *param, khash_t(duplicates) *dup_hash
         (*optical_single)++;
     }
 
-    if (param->supp) {
+    if (param->supp && (!st->job || st->counting)) {
         // Change the duplicate type
 
         if (bam_aux_get(b, "SA") || (b->core.flag & BAM_FMUNMAP)
             || bam_aux_get(b, "XA")) {
-            khiter_t d;
-
-            d = kh_get(duplicates, dup_hash, bam_get_qname(b));
-
-            if (d == kh_end(dup_hash)) {
-                // error, name should already be in dup hash
-                fprintf(samtools_stderr, "[markdup] error: duplicate name %s not found in hash.\n",
-                    bam_get_qname(b));
+            if (retag_duplicate(st, b))
                 ret = -1;
-            } else {
-                kh_value(dup_hash, d).type = 'O';
-            }
         }
     }
 
@@ -1029,7 +1149,7 @@ static inline int optical_retag(md_param_t *param, khash_t(duplicates) *dup_hash
    pre-calculate any values for use in check_duplicate_chain later.
    Returns 0 on success, >0 on coordinate reading error (program can continue) or
    <0 on an error (program should not continue. */
-static int check_chain_against_original(md_param_t *param, khash_t(duplicates) *dup_hash, read_queue_t *ori,
+static int check_chain_against_original(md_param_t *param, md_state_t *st, read_queue_t *ori,
              check_list_t *list, long *warn, long *optical_single, long *optical_pair) {
 
     int ret = 0;
@@ -1055,7 +1175,7 @@ static int check_chain_against_original(md_param_t *param, khash_t(duplicates) *
             list->size *= 2;
 
             if (!(tmp = realloc(list->c, list->size * sizeof(check_t)))) {
-                fprintf(samtools_stderr, "[markdup] error: Unable to expand opt check list.\n");
+                md_error("[markdup] error: Unable to expand opt check list.\n");
                 return -1;
             }
 
@@ -1083,13 +1203,13 @@ static int check_chain_against_original(md_param_t *param, khash_t(duplicates) *
                 if (old_name) {
                     if (strcmp(old_name, ori_name) != 0) {
                         if (bam_aux_update_str(current->b, "do", strlen(ori_name) + 1, (const char *)ori_name)) {
-                            fprintf(samtools_stderr, "[markdup] error: unable to update 'do' tag.\n");
+                            md_error("[markdup] error: unable to update 'do' tag.\n");
                             ret =  -1;
                             break;
                         }
                     }
                 } else {
-                    fprintf(samtools_stderr, "[markdup] error: 'do' tag has wrong type for read %s.\n", bam_get_qname(current->b));
+                    md_error("[markdup] error: 'do' tag has wrong type for read %s.\n", bam_get_qname(current->b));
                     ret = -1;
                     break;
                 }
@@ -1114,7 +1234,7 @@ static int check_chain_against_original(md_param_t *param, khash_t(duplicates) *
             is_opt = optical_duplicate_partial(ori_name, xpos, x, y, current->b, c, param->opt_dist, warn);
 
             if (!c->opt && is_opt) {
-                if (optical_retag(param, dup_hash, current->b, current_paired, optical_single, optical_pair)) {
+                if (optical_retag(param, st, current->b, current_paired, optical_single, optical_pair)) {
                     ret = -1;
                     break;
                 }
@@ -1126,7 +1246,7 @@ static int check_chain_against_original(md_param_t *param, khash_t(duplicates) *
 
             if (current_paired) {
                 if ((c->mate_score = get_mate_score(current->b)) == -1) {
-                     fprintf(samtools_stderr, "[markdup] error: no ms score tag. Please run samtools fixmate on file first.\n");
+                     md_error("[markdup] error: no ms score tag. Please run samtools fixmate on file first.\n");
                      ret = -1;
                      break;
                 }
@@ -1150,7 +1270,7 @@ static int xcoord_sort(const void *a, const void *b) {
 
 
 /* Check all the duplicates against each other to see if they are optical duplicates. */
-static int check_duplicate_chain(md_param_t *param, khash_t(duplicates) *dup_hash, check_list_t *list,
+static int check_duplicate_chain(md_param_t *param, md_state_t *st, check_list_t *list,
              long *warn, long *optical_single, long *optical_pair) {
     int ret = 0;
     size_t curr = 0;
@@ -1235,7 +1355,7 @@ static int check_duplicate_chain(md_param_t *param, khash_t(duplicates) *dup_has
             if (chk_dup) {
                 // the duplicate is the optical duplicate
                 if (!chk->opt) { // only change if not already an optical duplicate
-                    if (optical_retag(param, dup_hash, chk->b, chk_paired, optical_single, optical_pair)) {
+                    if (optical_retag(param, st, chk->b, chk_paired, optical_single, optical_pair)) {
                         ret = -1;
                         goto fail;
                     }
@@ -1244,7 +1364,7 @@ static int check_duplicate_chain(md_param_t *param, khash_t(duplicates) *dup_has
                 }
             } else {
                 if (!current->opt) {
-                    if (optical_retag(param, dup_hash, current->b, current_paired, optical_single, optical_pair)) {
+                    if (optical_retag(param, st, current->b, current_paired, optical_single, optical_pair)) {
                         ret = -1;
                         goto fail;
                     }
@@ -1264,15 +1384,18 @@ static int check_duplicate_chain(md_param_t *param, khash_t(duplicates) *dup_has
 
 /* Where there is more than one duplicate go down the list and check for optical duplicates and change
    do tags (where used) to point to original (non-duplicate) read. */
-static int find_duplicate_chains(md_param_t *param, klist_t(read_queue) *read_buffer, khash_t(duplicates) *dup_hash, check_list_t *dup_list,
-                                const hts_pos_t prev_coord, const int32_t prev_tid, long *warn, long *optical_single,
-                                long *optical_pair, const int check_range) {
+static int find_duplicate_chains(md_param_t *param, md_state_t *st, const int check_range) {
     int ret = 0;
     kliter_t(read_queue) *rq;
+    hts_pos_t prev_coord = st->prev_coord;
+    int32_t prev_tid = st->prev_tid;
+    long *warn = &st->stats->opt_warnings;
+    long *optical_single = &st->stats->single_optical;
+    long *optical_pair = &st->stats->optical;
 
-    rq = kl_begin(read_buffer);
+    rq = kl_begin(st->read_buffer);
 
-    while (rq != kl_end(read_buffer)) {
+    while (rq != kl_end(st->read_buffer)) {
         read_queue_t *in_read = &kl_val(rq);
 
         if (check_range) {
@@ -1290,7 +1413,7 @@ static int find_duplicate_chains(md_param_t *param, klist_t(read_queue) *read_bu
         if (!(in_read->b->core.flag & BAM_FDUP) && in_read->duplicate) { // is the head of a duplicate chain
 
             // check against the original for tagging and optical duplication
-            if ((ret = check_chain_against_original(param, dup_hash, in_read, dup_list, warn, optical_single, optical_pair))) {
+            if ((ret = check_chain_against_original(param, st, in_read, &st->dup_list, warn, optical_single, optical_pair))) {
                 if (ret < 0) { // real error
                     ret = -1;
                     break;
@@ -1302,7 +1425,7 @@ static int find_duplicate_chains(md_param_t *param, klist_t(read_queue) *read_bu
             }
 
             // check the rest of the duplicates against each other for optical duplication
-            if (param->opt_dist && check_duplicate_chain(param, dup_hash, dup_list, warn, optical_single, optical_pair)) {
+            if (param->opt_dist && check_duplicate_chain(param, st, &st->dup_list, warn, optical_single, optical_pair)) {
                 ret = -1;
                 break;
             }
@@ -1357,7 +1480,7 @@ static unsigned long estimate_library_size(unsigned long paired_reads, unsigned
         int i;
 
         if (coverage_equation(m * (double)unique_pairs, (double)unique_pairs, (double)non_optical_pairs) < 0) {
-            fprintf(samtools_stderr, "[markdup] warning: unable to calculate estimated library size.\n");
+            md_error("[markdup] warning: unable to calculate estimated library size.\n");
             return  estimated_size;
         }
 
@@ -1380,7 +1503,7 @@ static unsigned long estimate_library_size(unsigned long paired_reads, unsigned
 
         estimated_size = (unsigned long)(unique_pairs * (m + M) / 2);
     } else {
-        fprintf(samtools_stderr, "[markdup] warning: unable to calculate estimated library size."
+        md_error("[markdup] warning: unable to calculate estimated library size."
                         " Read pairs %ld should be greater than duplicate pairs %ld,"
                         " which should both be non zero.\n",
                         non_optical_pairs, duplicate_pairs);
@@ -1390,500 +1513,1344 @@ static unsigned long estimate_library_size(unsigned long paired_reads, unsigned
 }
 
 
-/* Compare the reads near each other (coordinate sorted) and try to spot the duplicates.
-   Generally the highest quality scoring is chosen as the original and all others the duplicates.
-   The score is based on the sum of the quality values (<= 15) of the read and its mate (if any).
-   While single reads are compared to only one read of a pair, the pair will chosen as the original.
-   The comparison is done on position and orientation, see above for details.
-
-   Marking the supplementary reads of a duplicate as also duplicates takes an extra file read/write
-   step.  This is because the duplicate can occur before the primary read.*/
+static int md_state_init(md_param_t *param, md_state_t *st) {
+    memset(st, 0, sizeof(*st));
 
-static int bam_mark_duplicates(md_param_t *param) {
-    bam_hdr_t *header = NULL;
-    khiter_t k;
-    khash_t(reads) *pair_hash        = kh_init(reads);
-    khash_t(reads) *single_hash      = kh_init(reads);
-    klist_t(read_queue) *read_buffer = kl_init(read_queue);
-    kliter_t(read_queue) *rq;
-    khash_t(duplicates) *dup_hash    = kh_init(duplicates);
-    int32_t prev_tid;
-    hts_pos_t prev_coord;
-    read_queue_t *in_read;
-    int ret;
-    long reading, writing, excluded, duplicate, single, pair, single_dup, examined, optical, single_optical;
-    long np_duplicate, np_opt_duplicate;
-    long opt_warnings = 0;
-    tmp_file_t temp;
-    char *idx_fn = NULL;
-    int exclude = 0;
-    check_list_t dup_list = {NULL, 0, 0};
+    st->pair_hash   = kh_init(reads);
+    st->single_hash = kh_init(reads);
+    st->read_buffer = kl_init(read_queue);
+    st->dup_hash    = kh_init(duplicates);
 
-    if (!pair_hash || !single_hash || !read_buffer || !dup_hash) {
-        fprintf(samtools_stderr, "[markdup] out of memory\n");
-        goto fail;
+    if (!st->pair_hash || !st->single_hash || !st->read_buffer || !st->dup_hash) {
+        md_error("[markdup] out of memory\n");
+        return -1;
     }
 
-    if ((header = sam_hdr_read(param->in)) == NULL) {
-        fprintf(samtools_stderr, "[markdup] error reading header\n");
-        goto fail;
-    }
+    if (param->check_chain) {
+        st->dup_list.size = 128;
 
-    // accept unknown, unsorted or coordinate sort order, but error on queryname sorted.
-    // only really works on coordinate sorted files.
-    kstring_t str = KS_INITIALIZE;
-    if (!sam_hdr_find_tag_hd(header, "SO", &str) && str.s && !strcmp(str.s, "queryname")) {
-        fprintf(samtools_stderr, "[markdup] error: queryname sorted, must be sorted by coordinate.\n");
-        ks_free(&str);
-        goto fail;
+        if ((st->dup_list.c = malloc(st->dup_list.size * sizeof(check_t))) == NULL) {
+            md_error("[markdup] error: unable to allocate memory for dup_list.\n");
+            return -1;
+        }
     }
-    ks_free(&str);
 
-    if (!param->no_pg && sam_hdr_add_pg(header, "samtools", "VN", samtools_version(),
-                        param->arg_list ? "CL" : NULL,
-                        param->arg_list ? param->arg_list : NULL,
-                        NULL) != 0) {
-        fprintf(samtools_stderr, "[markdup] warning: unable to add @PG line to header.\n");
+    if (param->include_fails) {
+        st->exclude = (BAM_FSECONDARY | BAM_FSUPPLEMENTARY | BAM_FUNMAP);
+    } else {
+        st->exclude = (BAM_FSECONDARY | BAM_FSUPPLEMENTARY | BAM_FUNMAP | BAM_FQCFAIL);
     }
 
-    if (sam_hdr_write(param->out, header) < 0) {
-        fprintf(samtools_stderr, "[markdup] error writing header.\n");
-        goto fail;
-    }
-    if (param->write_index) {
-        if (!(idx_fn = auto_index(param->out, param->out_fn, header)))
-            goto fail;
-    }
+    return 0;
+}
 
-    // used for coordinate order checks
-    prev_tid = prev_coord = 0;
 
-    // get the buffer going
-    in_read = kl_pushp(read_queue, read_buffer);
-    if (!in_read) {
-        fprintf(samtools_stderr, "[markdup] out of memory\n");
-        goto fail;
+static void md_state_destroy(md_state_t *st) {
+    kliter_t(read_queue) *rq;
+
+    if (st->read_buffer) {
+        for (rq = kl_begin(st->read_buffer); rq != kl_end(st->read_buffer); rq = kl_next(rq))
+            bam_destroy1(kl_val(rq).b);
+
+        kl_destroy(read_queue, st->read_buffer);
     }
 
-    // handling supplementary reads needs a temporary file
-    if (param->supp) {
-        if (tmp_file_open_write(&temp, param->prefix, 1)) {
-            fprintf(samtools_stderr, "[markdup] error: unable to open tmp file %s.\n", param->prefix);
-            goto fail;
+    kh_destroy(reads, st->pair_hash);
+    kh_destroy(reads, st->single_hash);
+    destroy_duplicates(st->dup_hash);
+    free(st->dup_list.c);
+}
+
+
+/* Parallel marking.
+
+   The input is read in chunks and each chunk is marked by a job of its own.
+   A job starts with the reads at the end of the previous chunk that are close
+   enough to its first read to still be in the buffer (the lead-in) and reads
+   on into the next chunk until all the reads of its own chunk have left the
+   buffer.  Only the reads of its own chunk are written and counted.
+
+   A job keeps a copy of its buffer and hashes after the lead-in and after its
+   last read.  If the first does not match the second of the previous job, the
+   lead-in did not give the state the serial marking would have had and the
+   job is run again from the previous job's copy.  The output is always the
+   same as that of the serial marking. */
+
+#define MD_CHUNK_SIZE 10000
+
+typedef struct {
+    bam1_t *b;
+    const read_queue_t *node;   // the buffered read this is a copy of
+    int64_t idx;
+    int64_t duplicate;          // next read in the duplicate chain, -1 if none
+    int64_t pair_best;          // read stored under the pair key if the read added it
+    int64_t single_best;        // read stored under the single key if the read added it
+    key_data_t pair_key;
+    key_data_t single_key;
+    hts_pos_t pos;
+    int dup_checked;
+} md_snap_read_t;
+
+typedef struct {
+    md_snap_read_t *r;
+    size_t n;
+    size_t size;
+    int32_t prev_tid;
+    hts_pos_t prev_coord;
+} md_snap_t;
+
+typedef struct {
+    bam1_t **b;
+    int n;
+    int64_t first;      // index of b[0] in the input
+} md_chunk_t;
+
+typedef struct {
+    md_chunk_t *c;
+    int n;
+    int size;
+    int eof;
+    int64_t n_read;
+    int32_t prev_tid;   // used for coordinate order checks
+    hts_pos_t prev_coord;
+} md_chunks_t;
+
+struct md_job {
+    md_param_t *param;
+    int chunk;              // the chunk written by the job
+    int n_ahead;            // number of chunks after it in the input
+    bam1_t **in;            // the input, in[0] has index first
+    size_t n_in;
+    size_t in_size;
+    int64_t first;
+    int64_t beg;            // the reads written and counted are [beg, end)
+    int64_t end;
+    int at_eof;             // the input ends with the last read of the file
+    const md_snap_t *start; // state to start from instead of a lead-in
+    md_snap_t snap_in;      // state after the lead-in
+    md_snap_t snap_out;     // state after read end - 1
+    bam1_t **out;           // reads to be written
+    size_t n_out;
+    size_t out_size;
+    md_stats_t stats;
+    khash_t(duplicates) *dup_hash;
+    kstring_t messages;     // errors and warnings of the last run
+    int status;             // 0 done, 1 needs more input, -1 error
+};
+
+
+/* Keep a read leaving the buffer for writing if it belongs to the job. */
+static int md_job_keep(md_job_t *job, read_queue_t *in_read) {
+    if (in_read->idx < job->beg || in_read->idx >= job->end)
+        return 0;
+
+    if (job->n_out == job->out_size) {
+        size_t size = job->out_size ? job->out_size * 2 : 1024;
+        bam1_t **tmp = realloc(job->out, size * sizeof(*tmp));
+
+        if (!tmp) {
+            md_error("[markdup] out of memory\n");
+            return -1;
         }
-    }
 
-    if ((in_read->b = bam_init1()) == NULL) {
-        fprintf(samtools_stderr, "[markdup] error: unable to allocate memory for alignment.\n");
-        goto fail;
+        job->out = tmp;
+        job->out_size = size;
     }
 
-    if (param->check_chain && !(param->tag || param->opt_dist))
-        param->check_chain = 0;
+    job->out[job->n_out++] = in_read->b;
+    in_read->b = NULL;
 
-    if (param->check_chain) {
-        dup_list.size = 128;
-        dup_list.c = NULL;
+    return 0;
+}
 
-        if ((dup_list.c = malloc(dup_list.size * sizeof(check_t))) == NULL) {
-            fprintf(samtools_stderr, "[markdup] error: unable to allocate memory for dup_list.\n");
-            goto fail;
+
+/* Write a read that has left the buffer. */
+static int md_write_read(md_param_t *param, md_state_t *st, read_queue_t *in_read) {
+    if (param->remove_dups && (in_read->b->core.flag & BAM_FDUP))
+        return 0;
+
+    if (st->job)
+        return md_job_keep(st->job, in_read);
+
+    if (st->temp) {
+        if (tmp_file_write(st->temp, in_read->b)) {
+            md_error("[markdup] error: writing temp output failed.\n");
+            return -1;
+        }
+    } else {
+        if (sam_write1(st->out, st->header, in_read->b) < 0) {
+            md_error("[markdup] error: writing output failed.\n");
+            return -1;
         }
     }
 
-    reading = writing = excluded = single_dup = duplicate = examined = pair = single = optical = single_optical = 0;
-    np_duplicate = np_opt_duplicate = 0;
+    st->stats->writing++;
+
+    return 0;
+}
 
-    while ((ret = sam_read1(param->in, header, in_read->b)) >= 0) {
-        int dup_checked = 0;
 
-        // do some basic coordinate order checks
-        if (in_read->b->core.tid >= 0) { // -1 for unmapped reads
-            if (in_read->b->core.tid < prev_tid ||
-               ((in_read->b->core.tid == prev_tid) && (in_read->b->core.pos < prev_coord))) {
-                fprintf(samtools_stderr, "[markdup] error: not in coordinate sorted order.\n");
-                goto fail;
-            }
-        }
+/* Add the next read to the buffer and mark it or the read it duplicates. */
+static int md_add_read(md_param_t *param, md_state_t *st, read_queue_t *in_read) {
+    md_stats_t *stats = st->stats;
+    khiter_t k;
 
-        prev_coord = in_read->pos = in_read->b->core.pos;
-        prev_tid   =  in_read->b->core.tid;
-        in_read->pair_key.single   = 1;
-        in_read->single_key.single = 0;
-        in_read->duplicate = NULL;
-        in_read->dup_checked = 0;
+    // do some basic coordinate order checks
+    if (in_read->b->core.tid >= 0) { // -1 for unmapped reads
+        if (in_read->b->core.tid < st->prev_tid ||
+           ((in_read->b->core.tid == st->prev_tid) && (in_read->b->core.pos < st->prev_coord))) {
+            md_error("[markdup] error: not in coordinate sorted order.\n");
+            return -1;
+        }
+    }
 
-        reading++;
+    st->prev_coord = in_read->pos = in_read->b->core.pos;
+    st->prev_tid   =  in_read->b->core.tid;
+    in_read->pair_key.single   = 1;
+    in_read->single_key.single = 0;
+    in_read->duplicate = NULL;
+    in_read->dup_checked = 0;
+    in_read->idx = st->n_read++;
 
-        if (param->clear && (in_read->b->core.flag & BAM_FDUP)) {
-            uint8_t *data;
+    stats->reading++;
 
-            in_read->b->core.flag ^= BAM_FDUP;
+    if (param->clear && (in_read->b->core.flag & BAM_FDUP)) {
+        uint8_t *data;
 
-            if ((data = bam_aux_get(in_read->b, "dt")) != NULL) {
-                bam_aux_del(in_read->b, data);
-            }
+        in_read->b->core.flag ^= BAM_FDUP;
 
-            if ((data = bam_aux_get(in_read->b, "do")) != NULL) {
-                bam_aux_del(in_read->b, data);
-            }
+        if ((data = bam_aux_get(in_read->b, "dt")) != NULL) {
+            bam_aux_del(in_read->b, data);
         }
 
-        if (param->include_fails) {
-            exclude |= (BAM_FSECONDARY | BAM_FSUPPLEMENTARY | BAM_FUNMAP);
-        } else {
-            exclude |= (BAM_FSECONDARY | BAM_FSUPPLEMENTARY | BAM_FUNMAP | BAM_FQCFAIL);
+        if ((data = bam_aux_get(in_read->b, "do")) != NULL) {
+            bam_aux_del(in_read->b, data);
         }
+    }
 
-        // read must not be secondary, supplementary, unmapped or (possibly) failed QC
-        if (!(in_read->b->core.flag & exclude)) {
-            examined++;
+    // read must not be secondary, supplementary, unmapped or (possibly) failed QC
+    if (!(in_read->b->core.flag & st->exclude)) {
+        stats->examined++;
 
 
-            // look at the pairs first
-            if ((in_read->b->core.flag & BAM_FPAIRED) && !(in_read->b->core.flag & BAM_FMUNMAP)) {
-                int ret, mate_tmp;
-                key_data_t pair_key;
-                key_data_t single_key;
-                in_hash_t *bp;
+        // look at the pairs first
+        if ((in_read->b->core.flag & BAM_FPAIRED) && !(in_read->b->core.flag & BAM_FMUNMAP)) {
+            int ret, mate_tmp;
+            key_data_t pair_key;
+            key_data_t single_key;
+            in_hash_t *bp;
 
-                if (param->mode) {
-                    if (make_pair_key_sequence(&pair_key, in_read->b)) {
-                        fprintf(samtools_stderr, "[markdup] error: unable to assign pair hash key.\n");
-                        goto fail;
-                    }
-                } else {
-                    if (make_pair_key_template(&pair_key, in_read->b)) {
-                        fprintf(samtools_stderr, "[markdup] error: unable to assign pair hash key.\n");
-                        goto fail;
-                    }
+            if (param->mode) {
+                if (make_pair_key_sequence(&pair_key, in_read->b)) {
+                    md_error("[markdup] error: unable to assign pair hash key.\n");
+                    return -1;
+                }
+            } else {
+                if (make_pair_key_template(&pair_key, in_read->b)) {
+                    md_error("[markdup] error: unable to assign pair hash key.\n");
+                    return -1;
                 }
+            }
 
-                make_single_key(&single_key, in_read->b);
+            make_single_key(&single_key, in_read->b);
 
-                pair++;
-                in_read->pos = single_key.this_coord; // cigar/orientation modified pos
+            stats->pair++;
+            in_read->pos = single_key.this_coord; // cigar/orientation modified pos
 
-                // put in singles hash for checking against non paired reads
-                k = kh_put(reads, single_hash, single_key, &ret);
+            // put in singles hash for checking against non paired reads
+            k = kh_put(reads, st->single_hash, single_key, &ret);
 
-                if (ret > 0) { // new
-                    // add to single duplicate hash
-                    bp = &kh_val(single_hash, k);
-                    bp->p = in_read;
-                    in_read->single_key = single_key;
-                } else if (ret == 0) { // exists
-                    // look at singles only for duplication marking
-                    bp = &kh_val(single_hash, k);
+            if (ret > 0) { // new
+                // add to single duplicate hash
+                bp = &kh_val(st->single_hash, k);
+                bp->p = in_read;
+                in_read->single_key = single_key;
+            } else if (ret == 0) { // exists
+                // look at singles only for duplication marking
+                bp = &kh_val(st->single_hash, k);
 
-                    if (!(bp->p->b->core.flag & BAM_FPAIRED) || (bp->p->b->core.flag & BAM_FMUNMAP)) {
-                       // singleton will always be marked duplicate even if
-                       // scores more than one read of the pair
-                        bam1_t *dup = bp->p->b;
+                if (!(bp->p->b->core.flag & BAM_FPAIRED) || (bp->p->b->core.flag & BAM_FMUNMAP)) {
+                   // singleton will always be marked duplicate even if
+                   // scores more than one read of the pair
+                    bam1_t *dup = bp->p->b;
 
-                        if (param->check_chain)
-                            in_read->duplicate = bp->p;
+                    if (param->check_chain)
+                        in_read->duplicate = bp->p;
 
-                        bp->p = in_read;
+                    bp->p = in_read;
 
-                        if (mark_duplicates(param, dup_hash, bp->p->b, dup, &single_optical, &opt_warnings))
-                            goto fail;
+                    if (mark_duplicates(param, st, bp->p->b, dup, &stats->single_optical, &stats->opt_warnings))
+                        return -1;
 
-                        single_dup++;
-                    }
-                } else {
-                    fprintf(samtools_stderr, "[markdup] error: single hashing failure.\n");
-                    goto fail;
+                    stats->single_dup++;
                 }
+            } else {
+                md_error("[markdup] error: single hashing failure.\n");
+                return -1;
+            }
 
-                // now do the pair
-                k = kh_put(reads, pair_hash, pair_key, &ret);
+            // now do the pair
+            k = kh_put(reads, st->pair_hash, pair_key, &ret);
 
-                if (ret > 0) { // new
-                    // add to the pair hash
-                    bp = &kh_val(pair_hash, k);
-                    bp->p = in_read;
-                    in_read->pair_key = pair_key;
-                } else if (ret == 0) {
-                    int64_t old_score, new_score, tie_add = 0;
-                    bam1_t *dup = NULL;
+            if (ret > 0) { // new
+                // add to the pair hash
+                bp = &kh_val(st->pair_hash, k);
+                bp->p = in_read;
+                in_read->pair_key = pair_key;
+            } else if (ret == 0) {
+                int64_t old_score, new_score, tie_add = 0;
+                bam1_t *dup = NULL;
 
-                    bp = &kh_val(pair_hash, k);
+                bp = &kh_val(st->pair_hash, k);
 
-                    if ((bp->p->b->core.flag & BAM_FQCFAIL) != (in_read->b->core.flag & BAM_FQCFAIL)) {
-                        if (bp->p->b->core.flag & BAM_FQCFAIL) {
-                            old_score = 0;
-                            new_score = 1;
-                        } else {
-                            old_score = 1;
-                            new_score = 0;
-                        }
+                if ((bp->p->b->core.flag & BAM_FQCFAIL) != (in_read->b->core.flag & BAM_FQCFAIL)) {
+                    if (bp->p->b->core.flag & BAM_FQCFAIL) {
+                        old_score = 0;
+                        new_score = 1;
                     } else {
-                        if ((mate_tmp = get_mate_score(bp->p->b)) == -1) {
-                            fprintf(samtools_stderr, "[markdup] error: no ms score tag. Please run samtools fixmate on file first.\n");
-                            goto fail;
-                        } else {
-                            old_score = calc_score(bp->p->b) + mate_tmp;
-                        }
+                        old_score = 1;
+                        new_score = 0;
+                    }
+                } else {
+                    if ((mate_tmp = get_mate_score(bp->p->b)) == -1) {
+                        md_error("[markdup] error: no ms score tag. Please run samtools fixmate on file first.\n");
+                        return -1;
+                    } else {
+                        old_score = calc_score(bp->p->b) + mate_tmp;
+                    }
 
-                        if ((mate_tmp = get_mate_score(in_read->b)) == -1) {
-                            fprintf(samtools_stderr, "[markdup] error: no ms score tag. Please run samtools fixmate on file first.\n");
-                            goto fail;
-                        } else {
-                            new_score = calc_score(in_read->b) + mate_tmp;
-                        }
+                    if ((mate_tmp = get_mate_score(in_read->b)) == -1) {
+                        md_error("[markdup] error: no ms score tag. Please run samtools fixmate on file first.\n");
+                        return -1;
+                    } else {
+                        new_score = calc_score(in_read->b) + mate_tmp;
                     }
+                }
 
-                    // choose the highest score as the original
-                    // and add it to the pair hash, mark the other as duplicate
+                // choose the highest score as the original
+                // and add it to the pair hash, mark the other as duplicate
 
-                    if (new_score == old_score) {
-                        if (strcmp(bam_get_qname(in_read->b), bam_get_qname(bp->p->b)) < 0) {
-                            tie_add = 1;
-                        } else {
-                            tie_add = -1;
-                        }
+                if (new_score == old_score) {
+                    if (strcmp(bam_get_qname(in_read->b), bam_get_qname(bp->p->b)) < 0) {
+                        tie_add = 1;
+                    } else {
+                        tie_add = -1;
                     }
+                }
 
-                    if (new_score + tie_add > old_score) { // swap reads
-                        dup = bp->p->b;
-
-                        if (param->check_chain) {
+                if (new_score + tie_add > old_score) { // swap reads
+                    dup = bp->p->b;
 
-                            if (in_read->duplicate) {
-                                read_queue_t *current = in_read->duplicate;
+                    if (param->check_chain) {
 
-                                while (current->duplicate) {
-                                    current = current->duplicate;
-                                }
+                        if (in_read->duplicate) {
+                            read_queue_t *current = in_read->duplicate;
 
-                                current->duplicate = bp->p;
-                            } else {
-                                in_read->duplicate = bp->p;
+                            while (current->duplicate) {
+                                current = current->duplicate;
                             }
-                        }
 
-                        bp->p = in_read;
-                    } else {
-                        if (param->check_chain) {
-                            if (bp->p->duplicate) {
-                                if (in_read->duplicate) {
-                                    read_queue_t *current = bp->p->duplicate;
+                            current->duplicate = bp->p;
+                        } else {
+                            in_read->duplicate = bp->p;
+                        }
+                    }
 
-                                    while (current->duplicate) {
-                                        current = current->duplicate;
-                                    }
+                    bp->p = in_read;
+                } else {
+                    if (param->check_chain) {
+                        if (bp->p->duplicate) {
+                            if (in_read->duplicate) {
+                                read_queue_t *current = bp->p->duplicate;
 
-                                    current->duplicate = in_read->duplicate;
+                                while (current->duplicate) {
+                                    current = current->duplicate;
                                 }
 
-                                in_read->duplicate = bp->p->duplicate;
+                                current->duplicate = in_read->duplicate;
                             }
 
-                            bp->p->duplicate = in_read;
+                            in_read->duplicate = bp->p->duplicate;
                         }
 
-                        dup = in_read->b;
+                        bp->p->duplicate = in_read;
                     }
 
-                    if (mark_duplicates(param, dup_hash, bp->p->b, dup, &optical, &opt_warnings))
-                        goto fail;
-
-                    duplicate++;
-                } else {
-                    fprintf(samtools_stderr, "[markdup] error: pair hashing failure.\n");
-                    goto fail;
+                    dup = in_read->b;
                 }
-            } else { // do the single (or effectively single) reads
-                int ret;
-                key_data_t single_key;
-                in_hash_t *bp;
 
-                make_single_key(&single_key, in_read->b);
+                if (mark_duplicates(param, st, bp->p->b, dup, &stats->optical, &stats->opt_warnings))
+                    return -1;
 
-                single++;
-                in_read->pos = single_key.this_coord; // cigar/orientation modified pos
+                stats->duplicate++;
+            } else {
+                md_error("[markdup] error: pair hashing failure.\n");
+                return -1;
+            }
+        } else { // do the single (or effectively single) reads
+            int ret;
+            key_data_t single_key;
+            in_hash_t *bp;
 
-                k = kh_put(reads, single_hash, single_key, &ret);
+            make_single_key(&single_key, in_read->b);
 
-                if (ret > 0) { // new
-                    bp = &kh_val(single_hash, k);
-                    bp->p = in_read;
-                    in_read->single_key = single_key;
-                } else if (ret == 0) { // exists
-                    bp = &kh_val(single_hash, k);
+            stats->single++;
+            in_read->pos = single_key.this_coord; // cigar/orientation modified pos
 
-                    if ((bp->p->b->core.flag & BAM_FPAIRED) && !(bp->p->b->core.flag & BAM_FMUNMAP)) {
-                        // if matched against one of a pair just mark as duplicate
+            k = kh_put(reads, st->single_hash, single_key, &ret);
 
-                        if (param->check_chain) {
-                            if (bp->p->duplicate) {
-                                in_read->duplicate = bp->p->duplicate;
-                            }
+            if (ret > 0) { // new
+                bp = &kh_val(st->single_hash, k);
+                bp->p = in_read;
+                in_read->single_key = single_key;
+            } else if (ret == 0) { // exists
+                bp = &kh_val(st->single_hash, k);
 
-                            bp->p->duplicate = in_read;
+                if ((bp->p->b->core.flag & BAM_FPAIRED) && !(bp->p->b->core.flag & BAM_FMUNMAP)) {
+                    // if matched against one of a pair just mark as duplicate
+
+                    if (param->check_chain) {
+                        if (bp->p->duplicate) {
+                            in_read->duplicate = bp->p->duplicate;
                         }
 
-                        if (mark_duplicates(param, dup_hash, bp->p->b, in_read->b, &single_optical, &opt_warnings))
-                            goto fail;
+                        bp->p->duplicate = in_read;
+                    }
 
-                    } else {
-                        int64_t old_score, new_score;
-                        bam1_t *dup = NULL;
+                    if (mark_duplicates(param, st, bp->p->b, in_read->b, &stats->single_optical, &stats->opt_warnings))
+                        return -1;
 
-                        old_score = calc_score(bp->p->b);
-                        new_score = calc_score(in_read->b);
+                } else {
+                    int64_t old_score, new_score;
+                    bam1_t *dup = NULL;
 
-                        // choose the highest score as the original, add it
-                        // to the single hash and mark the other as duplicate
-                        if (new_score > old_score) { // swap reads
-                            dup = bp->p->b;
+                    old_score = calc_score(bp->p->b);
+                    new_score = calc_score(in_read->b);
 
-                            if (param->check_chain)
-                                in_read->duplicate = bp->p;
+                    // choose the highest score as the original, add it
+                    // to the single hash and mark the other as duplicate
+                    if (new_score > old_score) { // swap reads
+                        dup = bp->p->b;
 
-                            bp->p = in_read;
-                        } else {
-                            if (param->check_chain) {
-                                if (bp->p->duplicate) {
-                                    in_read->duplicate = bp->p->duplicate;
-                                }
+                        if (param->check_chain)
+                            in_read->duplicate = bp->p;
 
-                                bp->p->duplicate = in_read;
+                        bp->p = in_read;
+                    } else {
+                        if (param->check_chain) {
+                            if (bp->p->duplicate) {
+                                in_read->duplicate = bp->p->duplicate;
                             }
 
-                            dup = in_read->b;
+                            bp->p->duplicate = in_read;
                         }
 
-                        if (mark_duplicates(param, dup_hash, bp->p->b, dup, &single_optical, &opt_warnings))
-                            goto fail;
+                        dup = in_read->b;
                     }
 
-                    single_dup++;
-                } else {
-                    fprintf(samtools_stderr, "[markdup] error: single hashing failure.\n");
-                    goto fail;
+                    if (mark_duplicates(param, st, bp->p->b, dup, &stats->single_optical, &stats->opt_warnings))
+                        return -1;
                 }
+
+                stats->single_dup++;
+            } else {
+                md_error("[markdup] error: single hashing failure.\n");
+                return -1;
             }
-        } else {
-            excluded++;
         }
+    } else {
+        stats->excluded++;
+    }
 
-        // loop through the stored reads and write out those we
-        // no longer need
-        rq = kl_begin(read_buffer);
-        while (rq != kl_end(read_buffer)) {
-            in_read = &kl_val(rq);
+    return 0;
+}
 
-            /* keep a moving window of reads based on coordinates and max read length.  Any unaligned reads
-               should just be written as they cannot be matched as duplicates. */
-            if (in_read->pos + param->max_length > prev_coord && in_read->b->core.tid == prev_tid && (prev_tid != -1 || prev_coord != -1)) {
-                break;
+
+/* Loop through the stored reads and write out those we no longer need. */
+static int md_flush_reads(md_param_t *param, md_state_t *st) {
+    kliter_t(read_queue) *rq;
+    read_queue_t *in_read;
+    int dup_checked = 0;
+    khiter_t k;
+
+    rq = kl_begin(st->read_buffer);
+    while (rq != kl_end(st->read_buffer)) {
+        in_read = &kl_val(rq);
+
+        /* keep a moving window of reads based on coordinates and max read length.  Any unaligned reads
+           should just be written as they cannot be matched as duplicates. */
+        if (in_read->pos + param->max_length > st->prev_coord && in_read->b->core.tid == st->prev_tid && (st->prev_tid != -1 || st->prev_coord != -1)) {
+            break;
+        }
+
+        if (!dup_checked && param->check_chain) {
+            // check for multiple optical duplicates of the same original read
+
+            if (find_duplicate_chains(param, st, 1)) {
+                md_error("[markdup] error: duplicate checking failed.\n");
+                return -1;
             }
 
-            if (!dup_checked && param->check_chain) {
-                // check for multiple optical duplicates of the same original read
+            dup_checked = 1;
+        }
 
-                if (find_duplicate_chains(param, read_buffer, dup_hash, &dup_list, prev_coord, prev_tid, &opt_warnings, &single_optical, &optical, 1)) {
-                    fprintf(samtools_stderr, "[markdup] error: duplicate checking failed.\n");
-                    goto fail;
-                }
 
-                dup_checked = 1;
+        if (param->check_chain && (in_read->b->core.flag & BAM_FDUP) && !in_read->dup_checked && !(in_read->b->core.flag & st->exclude)) {
+            break;
+        }
+
+        if (md_write_read(param, st, in_read))
+            return -1;
+
+        // remove from hash
+        if (in_read->pair_key.single == 0) {
+            k = kh_get(reads, st->pair_hash, in_read->pair_key);
+            kh_del(reads, st->pair_hash, k);
+        }
+
+        if (in_read->single_key.single == 1) {
+            k = kh_get(reads, st->single_hash, in_read->single_key);
+            kh_del(reads, st->single_hash, k);
+        }
+
+        kl_shift(read_queue, st->read_buffer, NULL);
+        bam_destroy1(in_read->b);
+        rq = kl_begin(st->read_buffer);
+    }
+
+    return 0;
+}
+
+
+/* Check the remaining duplicate chains and write out the end of the list. */
+static int md_finish(md_param_t *param, md_state_t *st) {
+    kliter_t(read_queue) *rq;
+    read_queue_t *in_read;
+
+    // one last check
+    if (param->tag || param->opt_dist) {
+        if (find_duplicate_chains(param, st, 0)) {
+            md_error("[markdup] error: duplicate checking failed.\n");
+            return -1;
+        }
+    }
+
+    rq = kl_begin(st->read_buffer);
+    while (rq != kl_end(st->read_buffer)) {
+        in_read = &kl_val(rq);
+
+        if (bam_get_qname(in_read->b)) { // last entry will be blank
+            if (md_write_read(param, st, in_read))
+                return -1;
+        }
+
+        kl_shift(read_queue, st->read_buffer, NULL);
+        bam_destroy1(in_read->b);
+        rq = kl_begin(st->read_buffer);
+    }
+
+    return 0;
+}
+
+
+static void md_snap_clear(md_snap_t *snap) {
+    size_t i;
+
+    for (i = 0; i < snap->n; i++)
+        bam_destroy1(snap->r[i].b);
+
+    snap->n = 0;
+}
+
+
+static void md_snap_destroy(md_snap_t *snap) {
+    md_snap_clear(snap);
+    free(snap->r);
+    snap->r = NULL;
+    snap->size = 0;
+}
+
+
+/* The index of a read linked to from the buffer, or -1 if it is not in it. */
+static int64_t md_snap_index(const md_snap_t *snap, const read_queue_t *p) {
+    int64_t i;
+
+    if (!p || !snap->n)
+        return -1;
+
+    i = p->idx - snap->r[0].idx;
+
+    if (i < 0 || i >= (int64_t)snap->n || snap->r[i].node != p)
+        return -1;
+
+    return p->idx;
+}
+
+
+/* Copy the buffer and the hash entries of the buffered reads.  As reads only
+   leave from the front of the buffer, it holds a run of consecutive reads. */
+static int md_snap_take(md_state_t *st, md_snap_t *snap) {
+    kliter_t(read_queue) *rq;
+    size_t i;
+
+    md_snap_clear(snap);
+
+    for (rq = kl_begin(st->read_buffer); rq != kl_end(st->read_buffer); rq = kl_next(rq)) {
+        const read_queue_t *q = &kl_val(rq);
+        md_snap_read_t *r;
+
+        if (snap->n == snap->size) {
+            size_t size = snap->size ? snap->size * 2 : 256;
+            md_snap_read_t *tmp = realloc(snap->r, size * sizeof(*tmp));
+
+            if (!tmp)
+                goto mem_fail;
+
+            snap->r = tmp;
+            snap->size = size;
+        }
+
+        r = &snap->r[snap->n];
+
+        if ((r->b = bam_dup1(q->b)) == NULL)
+            goto mem_fail;
+
+        snap->n++;
+        r->node = q;
+        r->idx = q->idx;
+        r->pair_key = q->pair_key;
+        r->single_key = q->single_key;
+        r->pos = q->pos;
+        r->dup_checked = q->dup_checked;
+    }
+
+    for (i = 0; i < snap->n; i++) {
+        md_snap_read_t *r = &snap->r[i];
+        khiter_t k;
+
+        r->duplicate = md_snap_index(snap, r->node->duplicate);
+        r->pair_best = r->single_best = -1;
+
+        if (r->pair_key.single == 0) {
+            k = kh_get(reads, st->pair_hash, r->pair_key);
+
+            if (k != kh_end(st->pair_hash))
+                r->pair_best = md_snap_index(snap, kh_val(st->pair_hash, k).p);
+        }
+
+        if (r->single_key.single == 1) {
+            k = kh_get(reads, st->single_hash, r->single_key);
+
+            if (k != kh_end(st->single_hash))
+                r->single_best = md_snap_index(snap, kh_val(st->single_hash, k).p);
+        }
+    }
+
+    snap->prev_tid = st->prev_tid;
+    snap->prev_coord = st->prev_coord;
+
+    return 0;
+
+ mem_fail:
+    md_error("[markdup] out of memory\n");
+    return -1;
+}
+
+
+static int md_snap_equal(const md_snap_t *a, const md_snap_t *b) {
+    size_t i;
+
+    if (a->n != b->n || a->prev_tid != b->prev_tid || a->prev_coord != b->prev_coord)
+        return 0;
+
+    for (i = 0; i < a->n; i++) {
+        const md_snap_read_t *x = &a->r[i];
+        const md_snap_read_t *y = &b->r[i];
+
+        if (x->idx != y->idx || x->duplicate != y->duplicate
+            || x->pair_best != y->pair_best || x->single_best != y->single_best
+            || x->pos != y->pos || x->dup_checked != y->dup_checked
+            || x->pair_key.single != y->pair_key.single
+            || x->single_key.single != y->single_key.single)
+            return 0;
+
+        if (x->b->core.flag != y->b->core.flag || x->b->l_data != y->b->l_data
+            || memcmp(x->b->data, y->b->data, x->b->l_data) != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+
+/* Rebuild the buffer and hashes from a copy. */
+static int md_snap_restore(md_state_t *st, const md_snap_t *snap) {
+    read_queue_t **node = NULL;
+    int64_t front = snap->n ? snap->r[0].idx : 0;
+    size_t i;
+    int ret;
+
+    if (snap->n && (node = malloc(snap->n * sizeof(*node))) == NULL)
+        goto mem_fail;
+
+    for (i = 0; i < snap->n; i++) {
+        const md_snap_read_t *r = &snap->r[i];
+        read_queue_t *q = kl_pushp(read_queue, st->read_buffer);
+
+        if (!q)
+            goto mem_fail;
+
+        if ((q->b = bam_dup1(r->b)) == NULL)
+            goto mem_fail;
+
+        q->idx = r->idx;
+        q->pair_key = r->pair_key;
+        q->single_key = r->single_key;
+        q->pos = r->pos;
+        q->dup_checked = r->dup_checked;
+        node[i] = q;
+    }
+
+    for (i = 0; i < snap->n; i++) {
+        const md_snap_read_t *r = &snap->r[i];
+        read_queue_t *q = node[i];
+        khiter_t k;
+
+        q->duplicate = r->duplicate >= 0 ? node[r->duplicate - front] : NULL;
+
+        if (r->pair_key.single == 0 && r->pair_best >= 0) {
+            k = kh_put(reads, st->pair_hash, r->pair_key, &ret);
+
+            if (ret < 0)
+                goto mem_fail;
+
+            kh_val(st->pair_hash, k).p = node[r->pair_best - front];
+        }
+
+        if (r->single_key.single == 1 && r->single_best >= 0) {
+            k = kh_put(reads, st->single_hash, r->single_key, &ret);
+
+            if (ret < 0)
+                goto mem_fail;
+
+            kh_val(st->single_hash, k).p = node[r->single_best - front];
+        }
+    }
+
+    st->prev_tid = snap->prev_tid;
+    st->prev_coord = snap->prev_coord;
+    free(node);
+
+    return 0;
+
+ mem_fail:
+    md_error("[markdup] out of memory\n");
+    free(node);
+    return -1;
+}
+
+
+static int64_t md_buffer_front(md_state_t *st) {
+    kliter_t(read_queue) *rq = kl_begin(st->read_buffer);
+
+    return rq == kl_end(st->read_buffer) ? INT64_MAX : kl_val(rq).idx;
+}
+
+
+static void md_job_reset(md_job_t *job) {
+    size_t i;
+
+    for (i = 0; i < job->n_out; i++)
+        bam_destroy1(job->out[i]);
+
+    job->n_out = 0;
+    destroy_duplicates(job->dup_hash);
+    job->dup_hash = NULL;
+    memset(&job->stats, 0, sizeof(job->stats));
+    job->messages.l = 0;
+    job->status = -1;
+}
+
+
+static void md_job_destroy(md_job_t *job) {
+    if (!job)
+        return;
+
+    md_job_reset(job);
+    md_snap_destroy(&job->snap_in);
+    md_snap_destroy(&job->snap_out);
+    ks_free(&job->messages);
+    free(job->in);
+    free(job->out);
+    free(job);
+}
+
+
+/* Mark the input of a job.  Reads before beg (the lead-in) and from end on
+   only set up and complete the state, what they change is counted by the
+   jobs they belong to. */
+static void *md_job_run(void *arg) {
+    md_job_t *job = arg;
+    md_param_t *param = job->param;
+    md_stats_t scratch;
+    md_state_t st;
+    size_t i;
+
+    md_job_reset(job);
+    scratch = job->stats;
+    md_job_messages = &job->messages;
+
+    if (md_state_init(param, &st))
+        goto out;
+
+    st.job = job;
+    st.n_read = job->first;
+
+    if (job->start && md_snap_restore(&st, job->start))
+        goto out;
+
+    for (i = 0; i < job->n_in; i++) {
+        int64_t idx = st.n_read;
+        read_queue_t *in_read;
+
+        st.counting = md_job_counting = idx >= job->beg && idx < job->end;
+        st.stats = st.counting ? &job->stats : &scratch;
+
+        if ((in_read = kl_pushp(read_queue, st.read_buffer)) == NULL) {
+            md_error("[markdup] out of memory\n");
+            goto out;
+        }
+
+        if ((in_read->b = bam_dup1(job->in[i])) == NULL) {
+            md_error("[markdup] error: unable to allocate memory for alignment.\n");
+            goto out;
+        }
+
+        if (md_add_read(param, &st, in_read) || md_flush_reads(param, &st))
+            goto out;
+
+        if (idx == job->beg - 1 && md_snap_take(&st, &job->snap_in))
+            goto out;
+
+        if (idx == job->end - 1 && md_snap_take(&st, &job->snap_out))
+            goto out;
+
+        if (idx >= job->end - 1 && md_buffer_front(&st) >= job->end)
+            break;
+    }
+
+    if (i == job->n_in) {
+        if (!job->at_eof) {
+            job->status = 1;
+            goto out;
+        }
+
+        st.counting = md_job_counting = job->end == INT64_MAX;
+        st.stats = st.counting ? &job->stats : &scratch;
+
+        if (md_finish(param, &st))
+            goto out;
+    }
+
+    job->dup_hash = st.dup_hash;
+    st.dup_hash = NULL;
+    job->status = 0;
+
+ out:
+    md_state_destroy(&st);
+    md_job_messages = NULL;
+    md_job_counting = 0;
+    return job;
+}
+
+
+/* Read the next chunk of the input. */
+static int md_read_chunk(md_param_t *param, sam_hdr_t *header, md_chunks_t *cs) {
+    md_chunk_t *c;
+    int ret = 0;
+
+    if (cs->n == cs->size) {
+        int size = cs->size ? cs->size * 2 : 16;
+        md_chunk_t *tmp = realloc(cs->c, size * sizeof(*tmp));
+
+        if (!tmp)
+            goto mem_fail;
+
+        cs->c = tmp;
+        cs->size = size;
+    }
+
+    c = &cs->c[cs->n];
+    c->n = 0;
+    c->first = cs->n_read;
+
+    if ((c->b = malloc(MD_CHUNK_SIZE * sizeof(*c->b))) == NULL)
+        goto mem_fail;
+
+    cs->n++;
+
+    while (c->n < MD_CHUNK_SIZE) {
+        bam1_t *b;
+
+        if ((b = bam_init1()) == NULL) {
+            fprintf(samtools_stderr, "[markdup] error: unable to allocate memory for alignment.\n");
+            return -1;
+        }
+
+        if ((ret = sam_read1(param->in, header, b)) < 0) {
+            bam_destroy1(b);
+            break;
+        }
+
+        c->b[c->n++] = b;
+
+        // do some basic coordinate order checks
+        if (b->core.tid >= 0) { // -1 for unmapped reads
+            if (b->core.tid < cs->prev_tid ||
+               ((b->core.tid == cs->prev_tid) && (b->core.pos < cs->prev_coord))) {
+                fprintf(samtools_stderr, "[markdup] error: not in coordinate sorted order.\n");
+                return -1;
             }
+        }
+
+        cs->prev_coord = b->core.pos;
+        cs->prev_tid = b->core.tid;
+    }
+
+    if (ret < -1) {
+        fprintf(samtools_stderr, "[markdup] error: truncated input file.\n");
+        return -1;
+    }
+
+    cs->n_read += c->n;
+
+    if (c->n < MD_CHUNK_SIZE) {
+        cs->eof = 1;
+
+        if (c->n == 0) {
+            free(c->b);
+            cs->n--;
+        }
+    }
+
+    return 0;
+
+ mem_fail:
+    fprintf(samtools_stderr, "[markdup] out of memory\n");
+    return -1;
+}
+
+
+static void md_chunk_free(md_chunk_t *c) {
+    int i;
+
+    for (i = 0; i < c->n; i++)
+        bam_destroy1(c->b[i]);
+
+    free(c->b);
+    c->b = NULL;
+    c->n = 0;
+}
+
+
+/* Set up the input of a job: its chunk, the chunks it may look ahead into
+   and, unless it starts from a copied state, the lead-in. */
+static int md_job_input(md_job_t *job, md_chunks_t *cs) {
+    md_chunk_t *c = &cs->c[job->chunk];
+    int last = job->chunk + job->n_ahead, i;
+    size_t lead = 0, n;
 
+    if (last > cs->n - 1)
+        last = cs->n - 1;
 
-            if (param->check_chain && (in_read->b->core.flag & BAM_FDUP) && !in_read->dup_checked && !(in_read->b->core.flag & exclude)) {
+    if (!job->start && job->chunk > 0) {
+        md_chunk_t *p = &cs->c[job->chunk - 1];
+        bam1_t *b = p->b[p->n - 1];
+
+        // unplaced reads leave the buffer straight away
+        for (lead = 1; lead < (size_t)p->n && b->core.tid >= 0; lead++) {
+            bam1_t *a = p->b[p->n - 1 - lead];
+
+            if (a->core.tid != b->core.tid || a->core.pos + 2 * (hts_pos_t)job->param->max_length < b->core.pos)
                 break;
+        }
+    }
+
+    for (n = lead, i = job->chunk; i <= last; i++)
+        n += cs->c[i].n;
+
+    if (n > job->in_size) {
+        bam1_t **tmp = realloc(job->in, n * sizeof(*tmp));
+
+        if (!tmp) {
+            fprintf(samtools_stderr, "[markdup] out of memory\n");
+            return -1;
+        }
+
+        job->in = tmp;
+        job->in_size = n;
+    }
+
+    if (lead)
+        memcpy(job->in, cs->c[job->chunk - 1].b + cs->c[job->chunk - 1].n - lead, lead * sizeof(*job->in));
+
+    for (n = lead, i = job->chunk; i <= last; n += cs->c[i].n, i++)
+        memcpy(job->in + n, cs->c[i].b, cs->c[i].n * sizeof(*job->in));
+
+    job->n_in = n;
+    job->first = c->first - lead;
+    job->beg = c->first;
+    job->end = (job->chunk == cs->n - 1 && cs->eof) ? INT64_MAX : c->first + c->n;
+    job->at_eof = cs->eof && last == cs->n - 1;
+
+    return 0;
+}
+
+
+/* Add the duplicates found by a job to those of the whole file. */
+static int md_merge_duplicates(khash_t(duplicates) *d_hash, khash_t(duplicates) *part) {
+    khiter_t k, d;
+    int ret;
+
+    for (k = kh_begin(part); k != kh_end(part); ++k) {
+        dup_map_t *v;
+
+        if (!kh_exist(part, k))
+            continue;
+
+        v = &kh_val(part, k);
+        d = kh_get(duplicates, d_hash, kh_key(part, k));
+
+        if (d == kh_end(d_hash)) {
+            if (!v->added) {
+                fprintf(samtools_stderr, "[markdup] error: duplicate name %s not found in hash.\n", kh_key(part, k));
+                return -1;
             }
 
-            if (!param->remove_dups || !(in_read->b->core.flag & BAM_FDUP)) {
-                if (param->supp) {
-                    if (tmp_file_write(&temp, in_read->b)) {
-                        fprintf(samtools_stderr, "[markdup] error: writing temp output failed.\n");
-                        goto fail;
-                    }
-                } else {
-                    if (sam_write1(param->out, header, in_read->b) < 0) {
-                        fprintf(samtools_stderr, "[markdup] error: writing output failed.\n");
-                        goto fail;
-                    }
-                }
+            d = kh_put(duplicates, d_hash, kh_key(part, k), &ret);
 
-                writing++;
+            if (ret < 0) {
+                fprintf(samtools_stderr, "[markdup] error: unable to store supplementary duplicates.\n");
+                return -1;
             }
 
-            // remove from hash
-            if (in_read->pair_key.single == 0) {
-                k = kh_get(reads, pair_hash, in_read->pair_key);
-                kh_del(reads, pair_hash, k);
+            kh_val(d_hash, d) = *v;
+            kh_del(duplicates, part, k);
+        } else if (v->retag) {
+            kh_val(d_hash, d).type = 'O';
+        }
+    }
+
+    return 0;
+}
+
+
+static void md_stats_add(md_stats_t *to, const md_stats_t *from) {
+    to->reading        += from->reading;
+    to->writing        += from->writing;
+    to->excluded       += from->excluded;
+    to->duplicate      += from->duplicate;
+    to->single         += from->single;
+    to->pair           += from->pair;
+    to->single_dup     += from->single_dup;
+    to->examined       += from->examined;
+    to->optical        += from->optical;
+    to->single_optical += from->single_optical;
+    to->opt_warnings   += from->opt_warnings;
+}
+
+
+/* Print the messages of a job, counting its warnings about read names
+   as a single thread would have. */
+static void md_job_print_messages(md_job_t *job, md_stats_t *stats) {
+    const char *line = job->messages.s;
+    size_t len;
+
+    if (!job->messages.l)
+        return;
+
+    for (; *line; line += len) {
+        len = strcspn(line, "\n");
+        len += line[len] == '\n';
+
+        if (*line == MD_MSG_NAME) {
+            if (++stats->opt_warnings <= BMD_WARNING_MAX)
+                fwrite(line + 1, 1, len - 1, samtools_stderr);
+        } else if (*line == MD_MSG_LIMIT) {
+            if (stats->opt_warnings == BMD_WARNING_MAX)
+                fprintf(samtools_stderr, "[markdup] warning: %ld decipher read name warnings.  New warnings will not be reported.\n",
+                                stats->opt_warnings);
+        } else {
+            fwrite(line, 1, len, samtools_stderr);
+        }
+    }
+}
+
+
+/* Write the reads of a finished job and add its counts and duplicates. */
+static int md_job_write(md_param_t *param, md_state_t *st, md_job_t *job) {
+    size_t i;
+
+    for (i = 0; i < job->n_out; i++) {
+        if (st->temp) {
+            if (tmp_file_write(st->temp, job->out[i])) {
+                fprintf(samtools_stderr, "[markdup] error: writing temp output failed.\n");
+                return -1;
             }
+        } else {
+            if (sam_write1(st->out, st->header, job->out[i]) < 0) {
+                fprintf(samtools_stderr, "[markdup] error: writing output failed.\n");
+                return -1;
+            }
+        }
 
-            if (in_read->single_key.single == 1) {
-                k = kh_get(reads, single_hash, in_read->single_key);
-                kh_del(reads, single_hash, k);
+        bam_destroy1(job->out[i]);
+        job->out[i] = NULL;
+    }
+
+    job->stats.writing = job->n_out;
+    job->n_out = 0;
+    job->stats.opt_warnings = 0; // counted as the messages are printed
+    md_job_print_messages(job, st->stats);
+    md_stats_add(st->stats, &job->stats);
+
+    return md_merge_duplicates(st->dup_hash, job->dup_hash);
+}
+
+
+/* Mark the duplicates in jobs run on the thread pool, see above.  The jobs
+   are finished in input order and their reads written by this thread. */
+static int md_mark_parallel(md_param_t *param, md_state_t *st) {
+    md_chunks_t cs;
+    md_job_t *job = NULL, *prev = NULL;
+    hts_tpool_process *q;
+    hts_tpool_result *r;
+    int max_jobs = hts_tpool_size(param->pool) + 2;
+    int next = 0, in_flight = 0, ret = -1, i;
+
+    memset(&cs, 0, sizeof(cs));
+
+    if ((q = hts_tpool_process_init(param->pool, max_jobs, 0)) == NULL) {
+        fprintf(samtools_stderr, "[markdup] error creating thread queue\n");
+        return -1;
+    }
+
+    for (;;) {
+        // the next job needs the chunk after its own to look into
+        while (!cs.eof && cs.n < next + 2) {
+            if (md_read_chunk(param, st->header, &cs))
+                goto fail;
+        }
+
+        if (next < cs.n && in_flight < max_jobs) {
+            if ((job = calloc(1, sizeof(*job))) == NULL) {
+                fprintf(samtools_stderr, "[markdup] out of memory\n");
+                goto fail;
             }
 
-            kl_shift(read_queue, read_buffer, NULL);
-            bam_destroy1(in_read->b);
-            rq = kl_begin(read_buffer);
+            job->param = param;
+            job->chunk = next;
+            job->n_ahead = 1;
+
+            if (md_job_input(job, &cs) || hts_tpool_dispatch(param->pool, q, md_job_run, job) < 0)
+                goto fail;
+
+            job = NULL;
+            next++;
+            in_flight++;
+            continue;
         }
 
-        // set the next one up for reading
-        in_read = kl_pushp(read_queue, read_buffer);
-        if (!in_read) {
-            fprintf(samtools_stderr, "[markdup] out of memory\n");
+        if (!in_flight)
+            break;
+
+        if ((r = hts_tpool_next_result_wait(q)) == NULL)
             goto fail;
+
+        job = hts_tpool_result_data(r);
+        hts_tpool_delete_result(r, 0);
+        in_flight--;
+
+        for (;;) {
+            if (job->status < 0) {
+                md_job_print_messages(job, st->stats);
+                goto fail;
+            }
+
+            if (job->status == 1) {
+                // its reads are still in the buffer, look further ahead
+                job->n_ahead *= 2;
+
+                while (!cs.eof && job->chunk + job->n_ahead >= cs.n) {
+                    if (md_read_chunk(param, st->header, &cs))
+                        goto fail;
+                }
+            } else if (prev && !job->start && !md_snap_equal(&job->snap_in, &prev->snap_out)) {
+                // the lead-in was too short, start from where the last job ended
+                job->start = &prev->snap_out;
+            } else {
+                break;
+            }
+
+            if (md_job_input(job, &cs))
+                goto fail;
+
+            md_job_run(job);
         }
 
-        if ((in_read->b = bam_init1()) == NULL) {
-            fprintf(samtools_stderr, "[markdup] error: unable to allocate memory for alignment.\n");
+        if (md_job_write(param, st, job))
             goto fail;
-        }
+
+        // the previous chunk was only needed for the lead-in of this job
+        if (job->chunk > 0)
+            md_chunk_free(&cs.c[job->chunk - 1]);
+
+        md_job_destroy(prev);
+        prev = job;
+        job = NULL;
     }
 
-    if (ret < -1) {
-        fprintf(samtools_stderr, "[markdup] error: truncated input file.\n");
+    ret = 0;
+
+ fail:
+    while (in_flight-- > 0 && (r = hts_tpool_next_result_wait(q)) != NULL) {
+        md_job_destroy(hts_tpool_result_data(r));
+        hts_tpool_delete_result(r, 0);
+    }
+
+    hts_tpool_process_destroy(q);
+    md_job_destroy(job);
+    md_job_destroy(prev);
+
+    for (i = 0; i < cs.n; i++)
+        md_chunk_free(&cs.c[i]);
+
+    free(cs.c);
+
+    return ret;
+}
+
+
+/* Compare the reads near each other (coordinate sorted) and try to spot the duplicates.
+   Generally the highest quality scoring is chosen as the original and all others the duplicates.
+   The score is based on the sum of the quality values (<= 15) of the read and its mate (if any).
+   While single reads are compared to only one read of a pair, the pair will chosen as the original.
+   The comparison is done on position and orientation, see above for details.
+
+   Marking the supplementary reads of a duplicate as also duplicates takes an extra file read/write
+   step.  This is because the duplicate can occur before the primary read.*/
+
+static int bam_mark_duplicates(md_param_t *param) {
+    bam_hdr_t *header = NULL;
+    khiter_t k;
+    md_state_t st;
+    md_stats_t stats;
+    read_queue_t *in_read;
+    int ret;
+    long np_duplicate, np_opt_duplicate;
+    tmp_file_t temp;
+    char *idx_fn = NULL;
+
+    if (param->check_chain && !(param->tag || param->opt_dist))
+        param->check_chain = 0;
+
+    memset(&stats, 0, sizeof(stats));
+
+    if (md_state_init(param, &st))
+        goto fail;
+
+    st.stats = &stats;
+
+    if ((header = sam_hdr_read(param->in)) == NULL) {
+        fprintf(samtools_stderr, "[markdup] error reading header\n");
         goto fail;
     }
 
-    // one last check
-    if (param->tag || param->opt_dist) {
-        if (find_duplicate_chains(param, read_buffer, dup_hash, &dup_list, prev_coord, prev_tid, &opt_warnings, &single_optical, &optical, 0)) {
-            fprintf(samtools_stderr, "[markdup] error: duplicate checking failed.\n");
+    // accept unknown, unsorted or coordinate sort order, but error on queryname sorted.
+    // only really works on coordinate sorted files.
+    kstring_t str = KS_INITIALIZE;
+    if (!sam_hdr_find_tag_hd(header, "SO", &str) && str.s && !strcmp(str.s, "queryname")) {
+        fprintf(samtools_stderr, "[markdup] error: queryname sorted, must be sorted by coordinate.\n");
+        ks_free(&str);
+        goto fail;
+    }
+    ks_free(&str);
+
+    if (!param->no_pg && sam_hdr_add_pg(header, "samtools", "VN", samtools_version(),
+                        param->arg_list ? "CL" : NULL,
+                        param->arg_list ? param->arg_list : NULL,
+                        NULL) != 0) {
+        fprintf(samtools_stderr, "[markdup] warning: unable to add @PG line to header.\n");
+    }
+
+    if (sam_hdr_write(param->out, header) < 0) {
+        fprintf(samtools_stderr, "[markdup] error writing header.\n");
+        goto fail;
+    }
+    if (param->write_index) {
+        if (!(idx_fn = auto_index(param->out, param->out_fn, header)))
+            goto fail;
+    }
+
+    st.out = param->out;
+    st.header = header;
+
+    // handling supplementary reads needs a temporary file
+    if (param->supp) {
+        if (tmp_file_open_write(&temp, param->prefix, 1)) {
+            fprintf(samtools_stderr, "[markdup] error: unable to open tmp file %s.\n", param->prefix);
             goto fail;
         }
+
+        st.temp = &temp;
     }
 
-    // write out the end of the list
-    rq = kl_begin(read_buffer);
-    while (rq != kl_end(read_buffer)) {
-        in_read = &kl_val(rq);
+    np_duplicate = np_opt_duplicate = 0;
 
-        if (bam_get_qname(in_read->b)) { // last entry will be blank
-            if (!param->remove_dups || !(in_read->b->core.flag & BAM_FDUP)) {
-                if (param->supp) {
-                    if (tmp_file_write(&temp, in_read->b)) {
-                        fprintf(samtools_stderr, "[markdup] error: writing temp output failed.\n");
-                        goto fail;
-                    }
-                } else {
-                    if (sam_write1(param->out, header, in_read->b) < 0) {
-                        fprintf(samtools_stderr, "[markdup] error: writing output failed.\n");
-                        goto fail;
-                    }
-                }
+    if (param->pool) {
+        if (md_mark_parallel(param, &st))
+            goto fail;
+    } else {
+        // get the buffer going
+        in_read = kl_pushp(read_queue, st.read_buffer);
+        if (!in_read) {
+            fprintf(samtools_stderr, "[markdup] out of memory\n");
+            goto fail;
+        }
 
-                writing++;
+        if ((in_read->b = bam_init1()) == NULL) {
+            fprintf(samtools_stderr, "[markdup] error: unable to allocate memory for alignment.\n");
+            goto fail;
+        }
+
+        while ((ret = sam_read1(param->in, header, in_read->b)) >= 0) {
+            if (md_add_read(param, &st, in_read) || md_flush_reads(param, &st))
+                goto fail;
+
+            // set the next one up for reading
+            in_read = kl_pushp(read_queue, st.read_buffer);
+            if (!in_read) {
+                fprintf(samtools_stderr, "[markdup] out of memory\n");
+                goto fail;
+            }
+
+            if ((in_read->b = bam_init1()) == NULL) {
+                fprintf(samtools_stderr, "[markdup] error: unable to allocate memory for alignment.\n");
+                goto fail;
             }
         }
 
-        kl_shift(read_queue, read_buffer, NULL);
-        bam_destroy1(in_read->b);
-        rq = kl_begin(read_buffer);
+        if (ret < -1) {
+            fprintf(samtools_stderr, "[markdup] error: truncated input file.\n");
+            goto fail;
+        }
+
+        if (md_finish(param, &st))
+            goto fail;
     }
 
     if (param->supp) {
+        khash_t(duplicates) *dup_hash = st.dup_hash;
         bam1_t *b;
 
         if (tmp_file_end_write(&temp)) {
@@ -1941,21 +2908,13 @@ static int bam_mark_duplicates(md_param_t *param) {
             goto fail;
         }
 
-        for (k = kh_begin(dup_hash); k != kh_end(dup_hash); ++k) {
-            if (kh_exist(dup_hash, k)) {
-                free(kh_val(dup_hash, k).name);
-                free((char *)kh_key(dup_hash, k));
-                kh_key(dup_hash, k) = NULL;
-            }
-        }
-
         tmp_file_destroy(&temp);
         bam_destroy1(b);
     }
 
-    if (opt_warnings) {
+    if (stats.opt_warnings) {
         fprintf(samtools_stderr, "[markdup] warning: number of failed attempts to get coordinates from read names = %ld\n",
-                        opt_warnings);
+                        stats.opt_warnings);
     }
 
     if (param->do_stats) {
@@ -1974,7 +2933,7 @@ static int bam_mark_duplicates(md_param_t *param) {
             fp = samtools_stderr;
         }
 
-        els = estimate_library_size(pair, duplicate, optical);
+        els = estimate_library_size(stats.pair, stats.duplicate, stats.optical);
 
         fprintf(fp,
                 "COMMAND: %s\n"
@@ -1992,9 +2951,10 @@ static int bam_mark_duplicates(md_param_t *param) {
                 "DUPLICATE NON PRIMARY OPTICAL: %ld\n"
                 "DUPLICATE PRIMARY TOTAL: %ld\n"
                 "DUPLICATE TOTAL: %ld\n"
-                "ESTIMATED_LIBRARY_SIZE: %ld\n", param->arg_list, reading, writing, excluded, examined, pair, single,
-                                duplicate, single_dup, optical, single_optical, np_duplicate, np_opt_duplicate,
-                                single_dup + duplicate, single_dup + duplicate + np_duplicate, els);
+                "ESTIMATED_LIBRARY_SIZE: %ld\n", param->arg_list, stats.reading, stats.writing, stats.excluded,
+                                stats.examined, stats.pair, stats.single, stats.duplicate, stats.single_dup,
+                                stats.optical, stats.single_optical, np_duplicate, np_opt_duplicate,
+                                stats.single_dup + stats.duplicate, stats.single_dup + stats.duplicate + np_duplicate, els);
 
         if (file_open) {
             fclose(fp);
@@ -2008,34 +2968,13 @@ static int bam_mark_duplicates(md_param_t *param) {
         }
     }
 
-    if (param->check_chain && (param->tag || param->opt_dist))
-        free(dup_list.c);
-
-    kh_destroy(reads, pair_hash);
-    kh_destroy(reads, single_hash);
-    kl_destroy(read_queue, read_buffer);
-    kh_destroy(duplicates, dup_hash);
+    md_state_destroy(&st);
     sam_hdr_destroy(header);
 
     return 0;
 
  fail:
-    for (rq = kl_begin(read_buffer); rq != kl_end(read_buffer); rq = kl_next(rq))
-        bam_destroy1(kl_val(rq).b);
-    kl_destroy(read_queue, read_buffer);
-
-    for (k = kh_begin(dup_hash); k != kh_end(dup_hash); ++k) {
-        if (kh_exist(dup_hash, k)) {
-            free((char *)kh_key(dup_hash, k));
-        }
-    }
-    kh_destroy(duplicates, dup_hash);
-
-    if (param->check_chain && (param->tag || param->opt_dist))
-        free(dup_list.c);
-
-    kh_destroy(reads, pair_hash);
-    kh_destroy(reads, single_hash);
+    md_state_destroy(&st);
     sam_hdr_destroy(header);
     return 1;
 }
@@ -2081,7 +3020,7 @@ int bam_markdup(int argc, char **argv) {
     kstring_t tmpprefix = {0, 0, NULL};
     struct stat st;
     unsigned int t;
-    md_param_t param = {NULL, NULL, NULL, 0, 300, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, NULL, NULL, NULL};
+    md_param_t param = {NULL, NULL, NULL, 0, 300, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, NULL, NULL, NULL, NULL};
 
     static const struct option lopts[] = {
         SAM_OPT_GLOBAL_OPTIONS('-', 0, 'O', 0, 0, '@'),
@@ -2092,24 +3031,24 @@ int bam_markdup(int argc, char **argv) {
         {NULL, 0, NULL, 0}
     };
 
-    while ((c = getopt_long(argc, argv, "rsl:StT:O:@:f:d:cm:u", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "rsl:StT:O:@:f:d:cm:u", lopts, NULL)) >= 0) {
         switch (c) {
             case 'r': param.remove_dups = 1; break;
-            case 'l': param.max_length = atoi(optarg); break;
+            case 'l': param.max_length = atoi(samtools_optarg); break;
             case 's': param.do_stats = 1; break;
-            case 'T': kputs(optarg, &tmpprefix); break;
+            case 'T': kputs(samtools_optarg, &tmpprefix); break;
             case 'S': param.supp = 1; break;
             case 't': param.tag = 1; break;
-            case 'f': param.stats_file = optarg; param.do_stats = 1; break;
-            case 'd': param.opt_dist = atoi(optarg); break;
+            case 'f': param.stats_file = samtools_optarg; param.do_stats = 1; break;
+            case 'd': param.opt_dist = atoi(samtools_optarg); break;
             case 'c': param.clear = 1; break;
             case 'm':
-                if (strcmp(optarg, "t") == 0) {
+                if (strcmp(samtools_optarg, "t") == 0) {
                     param.mode = MD_MODE_TEMPLATE;
-                } else if (strcmp(optarg, "s") == 0) {
+                } else if (strcmp(samtools_optarg, "s") == 0) {
                     param.mode = MD_MODE_SEQUENCE;
                 } else {
-                    fprintf(samtools_stderr, "[markdup] error: unknown mode '%s'.\n", optarg);
+                    fprintf(samtools_stderr, "[markdup] error: unknown mode '%s'.\n", samtools_optarg);
                     return markdup_usage();
                 }
 
@@ -2118,30 +3057,30 @@ int bam_markdup(int argc, char **argv) {
             case 1001: param.include_fails = 1; break;
             case 1002: param.no_pg = 1; break;
             case 1003: param.check_chain = 0; break;
-            default: if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+            default: if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
             /* else fall-through */
             case '?': return markdup_usage();
         }
     }
 
-    if (optind + 2 > argc)
+    if (samtools_optind + 2 > argc)
         return markdup_usage();
 
     if (param.opt_dist < 0) param.opt_dist = 0;
     if (param.max_length < 0) param.max_length = 300;
 
-    param.in = sam_open_format(argv[optind], "r", &ga.in);
+    param.in = sam_open_format(argv[samtools_optind], "r", &ga.in);
 
     if (!param.in) {
-        print_error_errno("markdup", "failed to open \"%s\" for input", argv[optind]);
+        print_error_errno("markdup", "failed to open \"%s\" for input", argv[samtools_optind]);
         return 1;
     }
 
-    sam_open_mode(wmode + 1, argv[optind + 1], NULL);
-    param.out = sam_open_format(argv[optind + 1], wmode, &ga.out);
+    sam_open_mode(wmode + 1, argv[samtools_optind + 1], NULL);
+    param.out = sam_open_format(argv[samtools_optind + 1], wmode, &ga.out);
 
     if (!param.out) {
-        print_error_errno("markdup", "failed to open \"%s\" for output", argv[optind + 1]);
+        print_error_errno("markdup", "failed to open \"%s\" for output", argv[samtools_optind + 1]);
         return 1;
     }
 
@@ -2153,6 +3092,10 @@ int bam_markdup(int argc, char **argv) {
 
         hts_set_opt(param.in,  HTS_OPT_THREAD_POOL, &p);
         hts_set_opt(param.out, HTS_OPT_THREAD_POOL, &p);
+
+        // mark chunks of the input in parallel
+        if (ga.nthreads > 1)
+            param.pool = p.pool;
     }
 
     // actual stuff happens here
@@ -2160,8 +3103,8 @@ int bam_markdup(int argc, char **argv) {
     // we need temp files so fix up the name here
     if (tmpprefix.l == 0) {
 
-        if (strcmp(argv[optind + 1], "-") != 0)
-            ksprintf(&tmpprefix, "%s.", argv[optind + 1]);
+        if (strcmp(argv[samtools_optind + 1], "-") != 0)
+            ksprintf(&tmpprefix, "%s.", argv[samtools_optind + 1]);
         else
             kputc('.', &tmpprefix);
     }
@@ -2176,7 +3119,7 @@ int bam_markdup(int argc, char **argv) {
 
     param.arg_list = stringify_argv(argc + 1, argv - 1);
     param.write_index = ga.write_index;
-    param.out_fn = argv[optind + 1];
+    param.out_fn = argv[samtools_optind + 1];
 
     ret = bam_mark_duplicates(&param);
 
@@ -444,7 +444,7 @@ int bam_mating(int argc, char *argv[])
 
     // parse args
     if (argc == 1) { usage(samtools_stdout); return 0; }
-    while ((c = getopt_long(argc, argv, "rpcmO:@:u", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "rpcmO:@:u", lopts, NULL)) >= 0) {
         switch (c) {
             case 'r': remove_reads = 1; break;
             case 'p': proper_pair_check = 0; break;
@@ -452,23 +452,23 @@ int bam_mating(int argc, char *argv[])
             case 'm': mate_score = 1; break;
             case 'u': wmode[2] = '0'; break;
             case 1: no_pg = 1; break;
-            default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+            default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
                       /* else fall-through */
             case '?': usage(samtools_stderr); goto fail;
         }
     }
-    if (optind+1 >= argc) { usage(samtools_stderr); goto fail; }
+    if (samtools_optind+1 >= argc) { usage(samtools_stderr); goto fail; }
 
     if (!no_pg && !(arg_list =  stringify_argv(argc+1, argv-1)))
         goto fail;
 
     // init
-    if ((in = sam_open_format(argv[optind], "rb", &ga.in)) == NULL) {
+    if ((in = sam_open_format(argv[samtools_optind], "rb", &ga.in)) == NULL) {
         print_error_errno("fixmate", "cannot open input file");
         goto fail;
     }
-    sam_open_mode(wmode+1, argv[optind+1], NULL);
-    if ((out = sam_open_format(argv[optind+1], wmode, &ga.out)) == NULL) {
+    sam_open_mode(wmode+1, argv[samtools_optind+1], NULL);
+    if ((out = sam_open_format(argv[samtools_optind+1], wmode, &ga.out)) == NULL) {
         print_error_errno("fixmate", "cannot open output file");
         goto fail;
     }
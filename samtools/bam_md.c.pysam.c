@@ -257,7 +257,7 @@ int bam_fillmd(int argc, char *argv[])
     flt_flag = UPDATE_NM | UPDATE_MD;
     is_bam_out = is_uncompressed = is_realn = max_nm = capQ = baq_flag = quiet_mode = 0;
     strcpy(mode_w, "w");
-    while ((c = getopt_long(argc, argv, "EqQreuNhbSC:n:Ad@:", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "EqQreuNhbSC:n:Ad@:", lopts, NULL)) >= 0) {
         switch (c) {
         case 'r': is_realn = 1; break;
         case 'e': flt_flag |= USE_EQUAL; break;
@@ -268,13 +268,13 @@ int bam_fillmd(int argc, char *argv[])
         case 'b': is_bam_out = 1; break;
         case 'u': is_uncompressed = is_bam_out = 1; break;
         case 'S': break;
-        case 'n': max_nm = atoi(optarg); break;
-        case 'C': capQ = atoi(optarg); break;
+        case 'n': max_nm = atoi(samtools_optarg); break;
+        case 'C': capQ = atoi(samtools_optarg); break;
         case 'A': baq_flag |= 1; break;
         case 'E': baq_flag |= 2; break;
         case 'Q': quiet_mode = 1; break;
         case 1: no_pg = 1; break;
-        default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+        default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
             fprintf(samtools_stderr, "[bam_fillmd] unrecognized option '-%c'\n\n", c);
             /* else fall-through */
         case '?': return calmd_usage();
@@ -283,11 +283,11 @@ int bam_fillmd(int argc, char *argv[])
     if (is_bam_out) strcat(mode_w, "b");
     else strcat(mode_w, "h");
     if (is_uncompressed) strcat(mode_w, "0");
-    if (optind + (ga.reference == NULL) >= argc)
+    if (samtools_optind + (ga.reference == NULL) >= argc)
         return calmd_usage();
-    fp = sam_open_format(argv[optind], "r", &ga.in);
+    fp = sam_open_format(argv[samtools_optind], "r", &ga.in);
     if (fp == NULL) {
-        print_error_errno("calmd", "Failed to open input file '%s'", argv[optind]);
+        print_error_errno("calmd", "Failed to open input file '%s'", argv[samtools_optind]);
         return 1;
     }
 
@@ -329,7 +329,7 @@ int bam_fillmd(int argc, char *argv[])
         hts_set_opt(fpout, HTS_OPT_THREAD_POOL, &p);
     }
 
-    ref_file = argc > optind + 1 ? argv[optind+1] : ga.reference;
+    ref_file = argc > samtools_optind + 1 ? argv[samtools_optind+1] : ga.reference;
     fai = fai_load(ref_file);
 
     if (!fai) {
@@ -1226,44 +1226,44 @@ int bam_mpileup(int argc, char *argv[])
         {NULL, 0, NULL, 0}
     };
 
-    while ((c = getopt_long(argc, argv, "Agf:r:l:q:Q:uRC:BDSd:L:b:P:po:e:h:Im:F:EG:6OsVvxXt:a",lopts,NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "Agf:r:l:q:Q:uRC:BDSd:L:b:P:po:e:h:Im:F:EG:6OsVvxXt:a",lopts,NULL)) >= 0) {
         switch (c) {
         case 'x': mplp.flag &= ~MPLP_SMART_OVERLAPS; break;
         case  1 :
-            mplp.rflag_require = bam_str2flag(optarg);
-            if ( mplp.rflag_require<0 ) { fprintf(samtools_stderr,"Could not parse --rf %s\n", optarg); return 1; }
+            mplp.rflag_require = bam_str2flag(samtools_optarg);
+            if ( mplp.rflag_require<0 ) { fprintf(samtools_stderr,"Could not parse --rf %s\n", samtools_optarg); return 1; }
             break;
         case  2 :
-            mplp.rflag_filter = bam_str2flag(optarg);
-            if ( mplp.rflag_filter<0 ) { fprintf(samtools_stderr,"Could not parse --ff %s\n", optarg); return 1; }
+            mplp.rflag_filter = bam_str2flag(samtools_optarg);
+            if ( mplp.rflag_filter<0 ) { fprintf(samtools_stderr,"Could not parse --ff %s\n", samtools_optarg); return 1; }
             break;
-        case  3 : mplp.output_fname = optarg; break;
-        case  4 : mplp.openQ = atoi(optarg); break;
+        case  3 : mplp.output_fname = samtools_optarg; break;
+        case  4 : mplp.openQ = atoi(samtools_optarg); break;
         case  5 : mplp.flag |= MPLP_PRINT_QNAME; break;
         case  6 : mplp.rev_del = 1; break;
         case  7 :
-            if (build_auxlist(&mplp, optarg) != 0) {
-                fprintf(samtools_stderr,"Could not build aux list using '%s'\n", optarg);
+            if (build_auxlist(&mplp, samtools_optarg) != 0) {
+                fprintf(samtools_stderr,"Could not build aux list using '%s'\n", samtools_optarg);
                 return 1;
             }
             break;
-        case 8: mplp.sep = optarg[0]; break;
-        case 9: mplp.empty = optarg[0]; break;
+        case 8: mplp.sep = samtools_optarg[0]; break;
+        case 9: mplp.empty = samtools_optarg[0]; break;
         case 'f':
-            mplp.fai = fai_load(optarg);
+            mplp.fai = fai_load(samtools_optarg);
             if (mplp.fai == NULL) return 1;
-            mplp.fai_fname = optarg;
+            mplp.fai_fname = samtools_optarg;
             break;
-        case 'd': mplp.max_depth = atoi(optarg); break;
-        case 'r': mplp.reg = strdup(optarg); break;
+        case 'd': mplp.max_depth = atoi(samtools_optarg); break;
+        case 'r': mplp.reg = strdup(samtools_optarg); break;
         case 'l':
                   // In the original version the whole BAM was streamed which is inefficient
                   //  with few BED intervals and big BAMs. Todo: devise a heuristic to determine
                   //  best strategy, that is streaming or jumping.
-                  mplp.bed = bed_read(optarg);
-                  if (!mplp.bed) { print_error_errno("mpileup", "Could not read file \"%s\"", optarg); return 1; }
+                  mplp.bed = bed_read(samtools_optarg);
+                  if (!mplp.bed) { print_error_errno("mpileup", "Could not read file \"%s\"", samtools_optarg); return 1; }
                   break;
-        case 'P': mplp.pl_list = strdup(optarg); deprecated(c); break;
+        case 'P': mplp.pl_list = strdup(samtools_optarg); deprecated(c); break;
         case 'p': mplp.flag |= MPLP_PER_SAMPLE; deprecated(c); break;
         case 'g': mplp.flag |= MPLP_BCF; deprecated(c); break;
         case 'v': mplp.flag |= MPLP_BCF | MPLP_VCF; deprecated(c); break;
@@ -1279,13 +1279,13 @@ int bam_mpileup(int argc, char *argv[])
         case 'R': mplp.flag |= MPLP_IGNORE_RG; break;
         case 's': mplp.flag |= MPLP_PRINT_MAPQ_CHAR; break;
         case 'O': mplp.flag |= MPLP_PRINT_QPOS; break;
-        case 'C': mplp.capQ_thres = atoi(optarg); break;
-        case 'q': mplp.min_mq = atoi(optarg); break;
-        case 'Q': mplp.min_baseQ = atoi(optarg); break;
-        case 'b': file_list = optarg; break;
+        case 'C': mplp.capQ_thres = atoi(samtools_optarg); break;
+        case 'q': mplp.min_mq = atoi(samtools_optarg); break;
+        case 'Q': mplp.min_baseQ = atoi(samtools_optarg); break;
+        case 'b': file_list = samtools_optarg; break;
         case 'o': {
                 char *end;
-                long value = strtol(optarg, &end, 10);
+                long value = strtol(samtools_optarg, &end, 10);
                 // Distinguish between -o INT and -o FILE (a bit of a hack!)
                 if (*end == '\0') {
                     mplp.openQ = value;
@@ -1293,31 +1293,31 @@ int bam_mpileup(int argc, char *argv[])
                             "'--open-prob INT' is functional, but deprecated. "
                             "Please switch to using bcftools mpileup in future.\n");
                 } else {
-                    mplp.output_fname = optarg;
+                    mplp.output_fname = samtools_optarg;
                 }
             }
             break;
-        case 'e': mplp.extQ = atoi(optarg); deprecated(c); break;
-        case 'h': mplp.tandemQ = atoi(optarg); deprecated(c); break;
+        case 'e': mplp.extQ = atoi(samtools_optarg); deprecated(c); break;
+        case 'h': mplp.tandemQ = atoi(samtools_optarg); deprecated(c); break;
         case 'A': use_orphan = 1; break;
-        case 'F': mplp.min_frac = atof(optarg); deprecated(c); break;
-        case 'm': mplp.min_support = atoi(optarg); deprecated(c); break;
-        case 'L': mplp.max_indel_depth = atoi(optarg); deprecated(c); break;
+        case 'F': mplp.min_frac = atof(samtools_optarg); deprecated(c); break;
+        case 'm': mplp.min_support = atoi(samtools_optarg); deprecated(c); break;
+        case 'L': mplp.max_indel_depth = atoi(samtools_optarg); deprecated(c); break;
         case 'G': {
                 FILE *fp_rg;
                 char buf[1024];
                 mplp.rghash = khash_str2int_init();
-                if ((fp_rg = fopen(optarg, "r")) == NULL)
-                    fprintf(samtools_stderr, "[%s] Fail to open file %s. Continue anyway.\n", __func__, optarg);
+                if ((fp_rg = fopen(samtools_optarg, "r")) == NULL)
+                    fprintf(samtools_stderr, "[%s] Fail to open file %s. Continue anyway.\n", __func__, samtools_optarg);
                 while (!feof(fp_rg) && fscanf(fp_rg, "%s", buf) > 0) // this is not a good style, but forgive me...
                     khash_str2int_inc(mplp.rghash, strdup(buf));
                 fclose(fp_rg);
             }
             break;
-        case 't': mplp.fmt_flag |= parse_format_flag(optarg); deprecated(c); break;
+        case 't': mplp.fmt_flag |= parse_format_flag(samtools_optarg); deprecated(c); break;
         case 'a': mplp.all++; break;
         default:
-            if (parse_sam_global_opt(c, optarg, lopts, &mplp.ga) == 0) break;
+            if (parse_sam_global_opt(c, samtools_optarg, lopts, &mplp.ga) == 0) break;
             /* else fall-through */
         case '?':
             print_usage(samtools_stderr, &mplp);
@@ -1354,15 +1354,15 @@ int bam_mpileup(int argc, char *argv[])
     }
     else {
         if (has_index_file) {
-            if ((argc - optind)%2 !=0) { // Calculate # of input BAM files
+            if ((argc - samtools_optind)%2 !=0) { // Calculate # of input BAM files
                 fprintf(samtools_stderr, "Odd number of filenames detected! Each BAM file should have an index file\n");
                 return 1;
             }
-            nfiles = (argc - optind)/2;
-            ret = mpileup(&mplp, nfiles, argv + optind, argv + nfiles + optind);
+            nfiles = (argc - samtools_optind)/2;
+            ret = mpileup(&mplp, nfiles, argv + samtools_optind, argv + nfiles + samtools_optind);
         } else {
-            nfiles = argc - optind;
-            ret = mpileup(&mplp, nfiles, argv + optind, NULL);
+            nfiles = argc - samtools_optind;
+            ret = mpileup(&mplp, nfiles, argv + samtools_optind, NULL);
         }
     }
     if (mplp.rghash) khash_str2int_destroy_free(mplp.rghash);
@@ -85,7 +85,7 @@ int main_quickcheck(int argc, char** argv)
 
     const char* optstring = "vqu";
     int opt;
-    while ((opt = getopt(argc, argv, optstring)) != -1) {
+    while ((opt = samtools_getopt(argc, argv, optstring)) != -1) {
         switch (opt) {
         case 'u':
             unmapped = 1;
@@ -102,8 +102,8 @@ int main_quickcheck(int argc, char** argv)
         }
     }
 
-    argc -= optind;
-    argv += optind;
+    argc -= samtools_optind;
+    argv += samtools_optind;
 
     if (argc < 1) {
         usage_quickcheck(samtools_stdout);
@@ -548,11 +548,11 @@ int samtools_main_reheader(int argc, char *argv[])
         {NULL, 0, NULL, 0}
     };
 
-    while ((c = getopt_long(argc, argv, "hiPc:", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "hiPc:", lopts, NULL)) >= 0) {
         switch (c) {
         case 'P': no_pg = 1; break;
         case 'i': inplace = 1; break;
-        case 'c': external = optarg; break;
+        case 'c': external = samtools_optarg; break;
         case 'h': usage(samtools_stdout, 0); break;
         default:
             fprintf(samtools_stderr, "Invalid option '%c'\n", c);
@@ -560,7 +560,7 @@ int samtools_main_reheader(int argc, char *argv[])
         }
     }
 
-    if ((argc - optind != 2 || external) && (argc - optind != 1 || !external))
+    if ((argc - samtools_optind != 2 || external) && (argc - samtools_optind != 1 || !external))
         usage(samtools_stderr, 1);
 
     if (!no_pg && !(arg_list = stringify_argv(argc+1, argv-1))) {
@@ -570,9 +570,9 @@ int samtools_main_reheader(int argc, char *argv[])
 
     if (external) {
         skip_header = 1;
-        in = sam_open(argv[optind], inplace?"r+":"r");
+        in = sam_open(argv[samtools_optind], inplace?"r+":"r");
         if (in == 0) {
-            print_error_errno("reheader", "fail to open file '%s'", argv[optind]);
+            print_error_errno("reheader", "fail to open file '%s'", argv[samtools_optind]);
             return 1;
         }
 
@@ -583,9 +583,9 @@ int samtools_main_reheader(int argc, char *argv[])
             return 1;
         }
     } else { // read the header from a separate file
-        samFile *fph = sam_open(argv[optind], "r");
+        samFile *fph = sam_open(argv[samtools_optind], "r");
         if (fph == 0) {
-            print_error_errno("reheader", "fail to read the header from '%s'", argv[optind]);
+            print_error_errno("reheader", "fail to read the header from '%s'", argv[samtools_optind]);
             return 1;
         }
         h = sam_hdr_read(fph);
@@ -595,16 +595,16 @@ int samtools_main_reheader(int argc, char *argv[])
                     __func__, argv[1]);
             return 1;
         }
-        in = sam_open(argv[optind+1], inplace?"r+":"r");
+        in = sam_open(argv[samtools_optind+1], inplace?"r+":"r");
         if (in == 0) {
-            print_error_errno("reheader", "fail to open file '%s'", argv[optind+1]);
+            print_error_errno("reheader", "fail to open file '%s'", argv[samtools_optind+1]);
             return 1;
         }
     }
 
     if (hts_get_format(in)->format == bam) {
         if (inplace) {
-            print_error("reheader", "cannot reheader BAM '%s' in-place", argv[optind+1]);
+            print_error("reheader", "cannot reheader BAM '%s' in-place", argv[samtools_optind+1]);
             r = -1;
         } else {
             r = bam_reheader(in->fp.bgzf, h, fileno(samtools_stdout), arg_list, no_pg, skip_header);
@@ -615,7 +615,7 @@ int samtools_main_reheader(int argc, char *argv[])
         else
             r = cram_reheader(in->fp.cram, h, arg_list, no_pg);
     } else {
-        print_error("reheader", "input file '%s' must be BAM or CRAM", argv[optind+1]);
+        print_error("reheader", "input file '%s' must be BAM or CRAM", argv[samtools_optind+1]);
         r = -1;
     }
 
@@ -280,21 +280,21 @@ int bam_rmdup(int argc, char *argv[])
         { NULL, 0, NULL, 0 }
     };
 
-    while ((c = getopt_long(argc, argv, "sS", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "sS", lopts, NULL)) >= 0) {
         switch (c) {
         case 's': is_se = 1; break;
         case 'S': force_se = is_se = 1; break;
-        default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+        default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
             /* else fall-through */
         case '?': return rmdup_usage();
         }
     }
-    if (optind + 2 > argc)
+    if (samtools_optind + 2 > argc)
         return rmdup_usage();
 
-    in = sam_open_format(argv[optind], "r", &ga.in);
+    in = sam_open_format(argv[samtools_optind], "r", &ga.in);
     if (!in) {
-        print_error_errno("rmdup", "failed to open \"%s\" for input", argv[optind]);
+        print_error_errno("rmdup", "failed to open \"%s\" for input", argv[samtools_optind]);
         return 1;
     }
     header = sam_hdr_read(in);
@@ -303,10 +303,10 @@ int bam_rmdup(int argc, char *argv[])
         return 1;
     }
 
-    sam_open_mode(wmode+1, argv[optind+1], NULL);
-    out = sam_open_format(argv[optind+1], wmode, &ga.out);
+    sam_open_mode(wmode+1, argv[samtools_optind+1], NULL);
+    out = sam_open_format(argv[samtools_optind+1], wmode, &ga.out);
     if (!out) {
-        print_error_errno("rmdup", "failed to open \"%s\" for output", argv[optind+1]);
+        print_error_errno("rmdup", "failed to open \"%s\" for output", argv[samtools_optind+1]);
         return 1;
     }
     if (sam_hdr_write(out, header) < 0) {
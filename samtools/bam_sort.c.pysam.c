@@ -38,12 +38,14 @@ DEALINGS IN THE SOFTWARE.  */
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <assert.h>
 #include <pthread.h>
 #include <inttypes.h>
 #include "htslib/ksort.h"
 #include "htslib/hts_os.h"
+#include "htslib/bgzf.h"
 #include "htslib/khash.h"
 #include "htslib/klist.h"
 #include "htslib/kstring.h"
@@ -52,6 +54,7 @@ DEALINGS IN THE SOFTWARE.  */
 #include "sam_opts.h"
 #include "samtools.h"
 #include "bedidx.h"
+#include "tmp_file.h"
 
 
 // Struct which contains the a record, and the pointer to the sort tag (if any) or
@@ -100,10 +103,12 @@ KHASH_MAP_INIT_STR(c2i, int)
 #define hdrln_free_char(p)
 KLIST_INIT(hdrln, char*, hdrln_free_char)
 
-static int g_is_by_qname = 0;
-static int g_is_by_tag = 0;
-static int g_is_by_minhash = 0;
-static char g_sort_tag[2] = {0,0};
+// Thread-local so that several sorts can run at once in one process;
+// sort_blocks() hands the values on to its worker threads.
+static __thread int g_is_by_qname = 0;
+static __thread int g_is_by_tag = 0;
+static __thread int g_is_by_minhash = 0;
+static __thread char g_sort_tag[2] = {0,0};
 
 static int strnum_cmp(const char *_a, const char *_b)
 {
@@ -953,6 +958,14 @@ static hts_reglist_t *duplicate_reglist(const hts_reglist_t *rl, int rn) {
     return new_rl;
 }
 
+static int bam_merge_contigs(const char *out, const char *mode,
+                             sam_hdr_t *hout, int n, char * const *fn,
+                             char * const *fn_idx, samFile **fp,
+                             trans_tbl_t *tbl, char **RG, int *RG_len,
+                             int flag, int n_threads, const char *cmd,
+                             const htsFormat *in_fmt, const htsFormat *out_fmt,
+                             int write_index, char *arg_list, int no_pg);
+
 /*
  * How merging is handled
  *
@@ -1007,7 +1020,7 @@ int bam_merge_core2(int by_qname, char* sort_tag, const char *out, const char *m
     heap1_t *heap = NULL;
     sam_hdr_t *hout = NULL;
     sam_hdr_t *hin  = NULL;
-    int i, j, *RG_len = NULL;
+    int i, j, ret = 0, *RG_len = NULL;
     uint64_t idx = 0;
     char **RG = NULL;
     hts_itr_t **iter = NULL;
@@ -1036,8 +1049,8 @@ int bam_merge_core2(int by_qname, char* sort_tag, const char *out, const char *m
     }
 
     g_is_by_qname = by_qname;
+    g_is_by_tag = sort_tag != NULL;
     if (sort_tag) {
-        g_is_by_tag = 1;
         g_sort_tag[0] = sort_tag[0];
         g_sort_tag[1] = sort_tag[0] ? sort_tag[1] : '\0';
     }
@@ -1227,6 +1240,17 @@ int bam_merge_core2(int by_qname, char* sort_tag, const char *out, const char *m
         rtrans = NULL;
     }
 
+    // Merge contigs in parallel when the inputs are indexed
+    if (n_threads > 1 && !by_qname && !sort_tag && !reg && !fn_bed
+        && (ret = bam_merge_contigs(out, mode, hout, n, fn, fn_idx, fp,
+                                    translation_tbl, RG, RG_len, flag,
+                                    n_threads, cmd, in_fmt, out_fmt,
+                                    write_index, arg_list, no_pg)) <= 0) {
+        fpout = NULL;
+        goto clean_up;
+    }
+    ret = 0;
+
     // Load the first read from each file into the heap
     for (i = 0; i < n; ++i) {
         heap1_t *h = heap + i;
@@ -1333,6 +1357,7 @@ int bam_merge_core2(int by_qname, char* sort_tag, const char *out, const char *m
     free(out_idx_fn);
 
     // Clean up and close
+ clean_up:
     if (flag & MERGE_RG) {
         for (i = 0; i != n; ++i) free(RG[i]);
         free(RG_len);
@@ -1349,11 +1374,11 @@ int bam_merge_core2(int by_qname, char* sort_tag, const char *out, const char *m
     hts_reglist_free(lreg, nreg);
     bed_destroy(hreg);
     free(RG); free(translation_tbl); free(fp); free(heap); free(iter); free(hdr);
-    if (sam_close(fpout) < 0) {
+    if (fpout && sam_close(fpout) < 0) {
         print_error(cmd, "error closing output file");
         return -1;
     }
-    return 0;
+    return ret;
 
  mem_fail:
     print_error(cmd, "Out of memory");
@@ -1446,23 +1471,23 @@ int bam_merge(int argc, char *argv[])
         return 0;
     }
 
-    while ((c = getopt_long(argc, argv, "h:nru1R:o:f@:l:cps:b:O:t:XL:", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "h:nru1R:o:f@:l:cps:b:O:t:XL:", lopts, NULL)) >= 0) {
         switch (c) {
         case 'r': flag |= MERGE_RG; break;
         case 'f': flag |= MERGE_FORCE; break;
-        case 'h': fn_headers = optarg; break;
+        case 'h': fn_headers = samtools_optarg; break;
         case 'n': is_by_qname = 1; break;
-        case 'o': fnout = optarg; break;
-        case 't': sort_tag = optarg; break;
+        case 'o': fnout = samtools_optarg; break;
+        case 't': sort_tag = samtools_optarg; break;
         case '1': flag |= MERGE_LEVEL1; level = 1; break;
         case 'u': flag |= MERGE_UNCOMP; level = 0; break;
-        case 'R': reg = strdup(optarg); break;
-        case 'l': level = atoi(optarg); break;
+        case 'R': reg = strdup(samtools_optarg); break;
+        case 'l': level = atoi(samtools_optarg); break;
         case 'c': flag |= MERGE_COMBINE_RG; break;
         case 'p': flag |= MERGE_COMBINE_PG; break;
-        case 's': random_seed = atol(optarg); break;
+        case 's': random_seed = atol(samtools_optarg); break;
         case 'X': has_index_file = 1; break; // -X flag for index filename
-        case 'L': fn_bed = optarg; break;
+        case 'L': fn_bed = samtools_optarg; break;
         case 'b': {
             // load the list of files to read
             if (has_index_file) {
@@ -1470,7 +1495,7 @@ int bam_merge(int argc, char *argv[])
                 ret = 1; goto end;
             }
             int nfiles;
-            char **fn_read = hts_readlines(optarg, &nfiles);
+            char **fn_read = hts_readlines(samtools_optarg, &nfiles);
             if (fn_read) {
                 // Append to end of array
                 fn = realloc(fn, (fn_size+nfiles) * sizeof(char*));
@@ -1480,21 +1505,21 @@ int bam_merge(int argc, char *argv[])
                 free(fn_read);
             }
             else {
-                print_error("merge", "Invalid file list \"%s\"", optarg);
+                print_error("merge", "Invalid file list \"%s\"", samtools_optarg);
                 ret = 1;
             }
             break;
         }
         case 1: no_pg = 1; break;
-        default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+        default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
                   /* else fall-through */
         case '?': merge_usage(samtools_stderr); return 1;
         }
     }
 
-    if (fnout == NULL && argc - optind >= 1) {
-        fnout = argv[optind];
-        optind++;
+    if (fnout == NULL && argc - samtools_optind >= 1) {
+        fnout = argv[samtools_optind];
+        samtools_optind++;
     }
     if (fnout == NULL) {
         print_error("merge", "You must at least specify the output file");
@@ -1519,26 +1544,26 @@ int bam_merge(int argc, char *argv[])
 
     int nargcfiles = 0;
     if (has_index_file) { // Calculate # of input BAM files
-        if ((argc - optind) % 2 != 0) {
+        if ((argc - samtools_optind) % 2 != 0) {
             fprintf(samtools_stderr, "Odd number of filenames detected! Each BAM file should have an index file\n");
             ret = 1;
             goto end;
         }
-        nargcfiles = (argc - optind) / 2;
+        nargcfiles = (argc - samtools_optind) / 2;
     } else {
-        nargcfiles = argc - optind;
+        nargcfiles = argc - samtools_optind;
     }
 
     if (nargcfiles > 0) {
         // Add argc files to end of array
         fn = realloc(fn, (fn_size+nargcfiles) * sizeof(char*));
         if (fn == NULL) { ret = 1; goto end; }
-        memcpy(fn+fn_size, argv + optind, nargcfiles * sizeof(char*));
+        memcpy(fn+fn_size, argv + samtools_optind, nargcfiles * sizeof(char*));
 
         if(has_index_file) {
             fn_idx = realloc(fn_idx, nargcfiles * sizeof(char*));
             if (fn_idx == NULL) { ret = 1; goto end; }
-            memcpy(fn_idx+fn_size, argv + nargcfiles + optind, nargcfiles * sizeof(char*));
+            memcpy(fn_idx+fn_size, argv + nargcfiles + samtools_optind, nargcfiles * sizeof(char*));
         }
     }
     if (fn_size+nargcfiles < 1) {
@@ -1588,10 +1613,14 @@ typedef struct {
    it just needs to read data into the heap and push it out again. */
 
 static inline int heap_add_read(heap1_t *heap, int nfiles, samFile **fp,
-                                int num_in_mem, buf_region *in_mem,
-                                bam1_tag *buf, uint64_t *idx, sam_hdr_t *hout) {
+                                tmp_file_t *tmp, int num_in_mem,
+                                buf_region *in_mem, bam1_tag *buf,
+                                uint64_t *idx, sam_hdr_t *hout) {
     int i = heap->i, res;
-    if (i < nfiles) { // read from file
+    if (i < nfiles && tmp) { // read from LZ4 temporary file
+        res = tmp_file_read(&tmp[i], heap->entry.bam_record);
+        res = res > 0 ? 0 : (res == 0 ? -1 : -2);
+    } else if (i < nfiles) { // read from file
         res = sam_read1(fp[i], hout, heap->entry.bam_record);
     } else { // read from memory
         if (in_mem[i - nfiles].from < in_mem[i - nfiles].to) {
@@ -1624,7 +1653,8 @@ static inline int heap_add_read(heap1_t *heap, int nfiles, samFile **fp,
 
 static int bam_merge_simple(int by_qname, char *sort_tag, const char *out,
                             const char *mode, sam_hdr_t *hout,
-                            int n, char * const *fn, int num_in_mem,
+                            int n, char * const *fn, tmp_file_t *tmp,
+                            int num_in_mem,
                             buf_region *in_mem, bam1_tag *buf, int n_threads,
                             const char *cmd, const htsFormat *in_fmt,
                             const htsFormat *out_fmt, char *arg_list, int no_pg,
@@ -1636,12 +1666,12 @@ static int bam_merge_simple(int by_qname, char *sort_tag, const char *out,
     char *out_idx_fn = NULL;
 
     g_is_by_qname = by_qname;
+    g_is_by_tag = sort_tag != NULL;
     if (sort_tag) {
-        g_is_by_tag = 1;
         g_sort_tag[0] = sort_tag[0];
         g_sort_tag[1] = sort_tag[0] ? sort_tag[1] : '\0';
     }
-    if (n > 0) {
+    if (n > 0 && !tmp) {
         fp = (samFile**)calloc(n, sizeof(samFile*));
         if (!fp) goto mem_fail;
     }
@@ -1653,7 +1683,12 @@ static int bam_merge_simple(int by_qname, char *sort_tag, const char *out,
         sam_hdr_t *hin;
         heap1_t *h = &heap[i];
 
-        if (i < n) {
+        if (i < n && tmp) {
+            if (tmp_file_begin_read(&tmp[i]) != TMP_SAM_OK) {
+                print_error(cmd, "failed to read temporary file \"%s\"", fn[i]);
+                goto fail;
+            }
+        } else if (i < n) {
             fp[i] = sam_open_format(fn[i], "r", in_fmt);
             if (fp[i] == NULL) {
                 print_error_errno(cmd, "fail to open \"%s\"", fn[i]);
@@ -1677,7 +1712,7 @@ static int bam_merge_simple(int by_qname, char *sort_tag, const char *out,
             h->entry.bam_record = bam_init1();
             if (!h->entry.bam_record) goto mem_fail;
         }
-        if (heap_add_read(h, n, fp, num_in_mem, in_mem, buf, &idx, hout) < 0) {
+        if (heap_add_read(h, n, fp, tmp, num_in_mem, in_mem, buf, &idx, hout) < 0) {
             assert(i < n);
             print_error(cmd, "failed to read first record from \"%s\"", fn[i]);
             goto fail;
@@ -1729,7 +1764,7 @@ static int bam_merge_simple(int by_qname, char *sort_tag, const char *out,
             print_error_errno(cmd, "failed writing to \"%s\"", out);
             goto fail;
         }
-        if (heap_add_read(heap, n, fp, num_in_mem, in_mem, buf, &idx, hout) < 0) {
+        if (heap_add_read(heap, n, fp, tmp, num_in_mem, in_mem, buf, &idx, hout) < 0) {
             assert(heap->i < n);
             print_error(cmd, "Error reading \"%s\" : %s",
                         fn[heap->i], strerror(errno));
@@ -1738,7 +1773,7 @@ static int bam_merge_simple(int by_qname, char *sort_tag, const char *out,
         ks_heapadjust(heap, 0, heap_size, heap);
     }
     // Clean up and close
-    for (i = 0; i < n; i++) {
+    for (i = 0; i < n && fp; i++) {
         if (sam_close(fp[i]) != 0) {
             print_error(cmd, "Error on closing \"%s\" : %s",
                         fn[i], strerror(errno));
@@ -1931,6 +1966,46 @@ static inline int bam1_lt(const bam1_tag a, const bam1_tag b)
 
 KSORT_INIT(sort, bam1_tag, bam1_lt)
 
+// Sorted runs record a mark every RUN_MARK_INTERVAL records: a copy of
+// the record and the place in the file from where reading can start.
+// The marks are used to split the final merge between threads.
+#define RUN_MARK_INTERVAL 16384
+
+typedef struct {
+    size_t n, m;
+    bam1_tag *key;
+    int64_t *off;    // tmp_file offset or BGZF virtual offset
+} run_marks_t;
+
+static int run_marks_add(run_marks_t *marks, const bam1_t *b, int64_t off)
+{
+    if (marks->n == marks->m) {
+        size_t m = marks->m ? marks->m * 2 : 16;
+        bam1_tag *key = realloc(marks->key, m * sizeof(*key));
+        if (!key) return -1;
+        marks->key = key;
+        int64_t *o = realloc(marks->off, m * sizeof(*o));
+        if (!o) return -1;
+        marks->off = o;
+        marks->m = m;
+    }
+    bam1_tag *k = &marks->key[marks->n];
+    if (!(k->bam_record = bam_dup1(b))) return -1;
+    k->u.tag = g_is_by_tag ? bam_aux_get(k->bam_record, g_sort_tag) : NULL;
+    marks->off[marks->n++] = off;
+    return 0;
+}
+
+static void run_marks_destroy(run_marks_t *marks)
+{
+    size_t i;
+    for (i = 0; i < marks->n; i++)
+        bam_destroy1(marks->key[i].bam_record);
+    free(marks->key);
+    free(marks->off);
+    memset(marks, 0, sizeof(*marks));
+}
+
 typedef struct {
     size_t buf_len;
     const char *prefix;
@@ -1939,13 +2014,18 @@ typedef struct {
     int index;
     int error;
     int no_save;
+    int is_by_qname, is_by_tag, is_by_minhash;
+    char sort_tag[2];
+    tmp_file_t *tmp; // if set, write the run here instead of to a BAM file
+    run_marks_t *marks; // if set, record marks while writing the run
 } worker_t;
 
 // Returns 0 for success
 //        -1 for failure
 static int write_buffer(const char *fn, const char *mode, size_t l, bam1_tag *buf,
                         const sam_hdr_t *h, int n_threads, const htsFormat *fmt,
-                        int clear_minhash, char *arg_list, int no_pg, int write_index)
+                        int clear_minhash, char *arg_list, int no_pg, int write_index,
+                        run_marks_t *marks)
 {
     size_t i;
     samFile* fp;
@@ -1973,6 +2053,8 @@ static int write_buffer(const char *fn, const char *mode, size_t l, bam1_tag *bu
             b->core.mpos = -1;
             b->core.isize = 0;
         }
+        if (marks && i % RUN_MARK_INTERVAL == 0
+            && run_marks_add(marks, b, bgzf_tell(fp->fp.bgzf)) < 0) goto fail;
         if (sam_write1(fp, h, b) < 0) goto fail;
     }
 
@@ -2247,6 +2329,11 @@ static void *worker(void *data)
     worker_t *w = (worker_t*)data;
     char *name;
     w->error = 0;
+    g_is_by_qname = w->is_by_qname;
+    g_is_by_tag = w->is_by_tag;
+    g_is_by_minhash = w->is_by_minhash;
+    g_sort_tag[0] = w->sort_tag[0];
+    g_sort_tag[1] = w->sort_tag[1];
 
     if (!g_is_by_qname && !g_is_by_tag && !g_is_by_minhash) {
         if (ks_radixsort(w->buf_len, w->buf, w->h) < 0) {
@@ -2284,6 +2371,37 @@ static void *worker(void *data)
 
     name = (char*)calloc(strlen(w->prefix) + 20, 1);
     if (!name) { w->error = errno; return 0; }
+
+    if (w->tmp) {
+        // Records are stored as they are, so unlike BAM there is no
+        // limit on the number of CIGAR operations.
+        size_t i;
+        int res;
+        sprintf(name, "%s.%.4d", w->prefix, w->index);
+        res = tmp_file_open_write_named(w->tmp, name, 1);
+        for (i = 0; res == TMP_SAM_OK && i < w->buf_len; i++) {
+            if (w->marks && i % RUN_MARK_INTERVAL == 0) {
+                off_t off;
+                res = tmp_file_mark(w->tmp, &off);
+                if (res == TMP_SAM_OK
+                    && run_marks_add(w->marks, w->buf[i].bam_record, off) < 0)
+                    res = TMP_SAM_MEM_ERROR;
+                if (res != TMP_SAM_OK) break;
+            }
+            res = tmp_file_write(w->tmp, w->buf[i].bam_record);
+        }
+        if (res == TMP_SAM_OK)
+            res = tmp_file_end_write(w->tmp);
+        // closed until the merge, so that runs do not hold buffers
+        // or file descriptors while sorting continues
+        if (res == TMP_SAM_OK)
+            res = tmp_file_close_write(w->tmp);
+        if (res != TMP_SAM_OK)
+            w->error = errno ? errno : EIO;
+        free(name);
+        return 0;
+    }
+
     sprintf(name, "%s.%.4d.bam", w->prefix, w->index);
 
     uint32_t max_ncigar = 0;
@@ -2303,10 +2421,11 @@ static void *worker(void *data)
             return 0;
         }
 
-        if (write_buffer(name, "wcx1", w->buf_len, w->buf, w->h, 0, &fmt, 0, NULL, 1, 0) < 0)
+        // CRAM runs cannot be split for a parallel merge, so no marks
+        if (write_buffer(name, "wcx1", w->buf_len, w->buf, w->h, 0, &fmt, 0, NULL, 1, 0, NULL) < 0)
             w->error = errno;
     } else {
-        if (write_buffer(name, "wbx1", w->buf_len, w->buf, w->h, 0, NULL, 0, NULL, 1, 0) < 0)
+        if (write_buffer(name, "wbx1", w->buf_len, w->buf, w->h, 0, NULL, 0, NULL, 1, 0, w->marks) < 0)
             w->error = errno;
     }
 
@@ -2315,7 +2434,8 @@ static void *worker(void *data)
 }
 
 static int sort_blocks(int n_files, size_t k, bam1_tag *buf, const char *prefix,
-                       const sam_hdr_t *h, int n_threads, buf_region *in_mem)
+                       const sam_hdr_t *h, int n_threads, buf_region *in_mem,
+                       tmp_file_t *tmp_files, run_marks_t *marks)
 {
     int i;
     size_t pos, rest;
@@ -2339,6 +2459,13 @@ static int sort_blocks(int n_files, size_t k, bam1_tag *buf, const char *prefix,
         w[i].prefix = prefix;
         w[i].h = h;
         w[i].index = n_files + i;
+        w[i].is_by_qname = g_is_by_qname;
+        w[i].is_by_tag = g_is_by_tag;
+        w[i].is_by_minhash = g_is_by_minhash;
+        w[i].sort_tag[0] = g_sort_tag[0];
+        w[i].sort_tag[1] = g_sort_tag[1];
+        w[i].tmp = tmp_files ? &tmp_files[n_files + i] : NULL;
+        w[i].marks = marks ? &marks[n_files + i] : NULL;
         if (in_mem) {
             w[i].no_save = 1;
             in_mem[i].from = pos;
@@ -2347,13 +2474,13 @@ static int sort_blocks(int n_files, size_t k, bam1_tag *buf, const char *prefix,
             w[i].no_save = 0;
         }
         pos += w[i].buf_len; rest -= w[i].buf_len;
-        pthread_create(&tid[i], &attr, worker, &w[i]);
+        samtools_pthread_create(&tid[i], &attr, worker, &w[i]);
     }
     for (i = 0; i < n_threads; ++i) {
         pthread_join(tid[i], 0);
         if (w[i].error != 0) {
             errno = w[i].error;
-            print_error_errno("sort", "failed to create temporary file \"%s.%.4d.bam\"", prefix, w[i].index);
+            print_error_errno("sort", "failed to create temporary file \"%s.%.4d%s\"", prefix, w[i].index, tmp_files ? "" : ".bam");
             n_failed++;
         }
     }
@@ -2364,6 +2491,721 @@ static int sort_blocks(int n_files, size_t k, bam1_tag *buf, const char *prefix,
 }
 
 
+/*
+ * Parallel final merge.  The sort order is split into n_threads key
+ * ranges, using the run marks and samples of the in-memory blocks.
+ * Each thread merges one range from all runs into its own BGZF
+ * segment, and the segments are then concatenated.
+ */
+
+static const uint8_t bgzf_eof_block[28] = "\037\213\010\4\0\0\0\0\0\377\6\0\102\103\2\0\033\0\3\0\0\0\0\0\0\0\0\0";
+
+static inline int sort_key_cmp(const bam1_tag a, const bam1_tag b)
+{
+    if (g_is_by_tag)
+        return bam1_cmp_by_tag(a, b);
+    else if (g_is_by_minhash)
+        return bam1_cmp_by_minhash(a, b);
+    else
+        return bam1_cmp_core(a, b);
+}
+
+// Returns the index of the first record in [from, to) that is not
+// less than key.
+static size_t sort_lower_bound(const bam1_tag *buf, size_t from, size_t to,
+                               const bam1_tag *key)
+{
+    while (from < to) {
+        size_t mid = from + (to - from) / 2;
+        if (sort_key_cmp(buf[mid], *key) < 0)
+            from = mid + 1;
+        else
+            to = mid;
+    }
+    return from;
+}
+
+typedef struct {
+    const bam1_tag *lo, *hi; // key range [lo, hi) or NULL for no limit
+    samFile *fpout;          // output, opened by the caller for part 0
+    char *out;
+    const char *mode;
+    const htsFormat *in_fmt, *out_fmt;
+    sam_hdr_t *hout;
+    int n;                   // runs, as in bam_merge_simple()
+    char * const *fn;
+    tmp_file_t *tmp;
+    const run_marks_t *marks;
+    int num_in_mem;
+    buf_region *in_mem;      // the part of each in-memory block to merge
+    bam1_tag *buf;
+    int is_by_qname, is_by_tag, is_by_minhash;
+    char sort_tag[2];
+    // samtools merge: contigs [tid_beg, tid_end) of the output and,
+    // if no_coor is set, the unplaced reads
+    int tid_beg, tid_end, no_coor;
+    const uint64_t *start;   // where to start reading each file
+    trans_tbl_t *tbl;
+    char **RG;
+    const int *RG_len;
+    int flag;
+    int eof_block;           // set if the output ends with a BGZF EOF block
+    int error;
+} merge_part_t;
+
+// As heap_add_read(), but skips records of the runs that are outside
+// of the key range of the part.
+static int part_add_read(merge_part_t *p, heap1_t *heap, samFile **fp,
+                         tmp_file_t *rd, buf_region *in_mem, uint64_t *idx)
+{
+    for (;;) {
+        if (heap_add_read(heap, p->n, fp, rd, p->num_in_mem, in_mem, p->buf,
+                          idx, p->hout) < 0)
+            return -1;
+        if (heap->i >= p->n || !heap->entry.bam_record)
+            return 0;
+        if (p->lo && sort_key_cmp(heap->entry, *p->lo) < 0)
+            continue;
+        if (p->hi && sort_key_cmp(heap->entry, *p->hi) >= 0) {
+            heap->pos = HEAP_EMPTY;
+            bam_destroy1(heap->entry.bam_record);
+            heap->entry.bam_record = NULL;
+            heap->entry.u.tag = NULL;
+        }
+        return 0;
+    }
+}
+
+static void *merge_part_worker(void *data)
+{
+    merge_part_t *p = (merge_part_t *)data;
+    samFile **fp = NULL;
+    tmp_file_t *rd = NULL;
+    heap1_t *heap = NULL;
+    uint64_t idx = 0;
+    int i, heap_size = p->n + p->num_in_mem;
+
+    g_is_by_qname = p->is_by_qname;
+    g_is_by_tag = p->is_by_tag;
+    g_is_by_minhash = p->is_by_minhash;
+    g_sort_tag[0] = p->sort_tag[0];
+    g_sort_tag[1] = p->sort_tag[1];
+    p->error = 1;
+
+    heap = (heap1_t*)calloc(heap_size, sizeof(heap1_t));
+    if (p->tmp)
+        rd = (tmp_file_t*)calloc(p->n + 1, sizeof(tmp_file_t));
+    else
+        fp = (samFile**)calloc(p->n + 1, sizeof(samFile*));
+    if (!heap || (!rd && !fp)) goto fail;
+
+    for (i = 0; i < heap_size; i++) {
+        heap1_t *h = &heap[i];
+
+        if (i < p->n) {
+            // start at the last mark before the range
+            const run_marks_t *m = &p->marks[i];
+            size_t k = p->lo ? sort_lower_bound(m->key, 0, m->n, p->lo) : 0;
+            int64_t off = m->off[k ? k - 1 : 0];
+
+            if (rd) {
+                if (tmp_file_begin_read_at(&rd[i], &p->tmp[i], off) != TMP_SAM_OK)
+                    goto fail;
+            } else {
+                sam_hdr_t *hin;
+                if (!(fp[i] = sam_open_format(p->fn[i], "r", p->in_fmt)))
+                    goto fail;
+                if (!(hin = sam_hdr_read(fp[i])))
+                    goto fail;
+                sam_hdr_destroy(hin);
+                if (bgzf_seek(fp[i]->fp.bgzf, off, SEEK_SET) < 0)
+                    goto fail;
+            }
+            h->entry.bam_record = bam_init1();
+            if (!h->entry.bam_record) goto fail;
+        }
+        h->i = i;
+        h->entry.u.tag = NULL;
+        if (part_add_read(p, h, fp, rd, p->in_mem, &idx) < 0)
+            goto fail;
+    }
+
+    if (!p->fpout && !(p->fpout = sam_open_format(p->out, p->mode, p->out_fmt)))
+        goto fail;
+
+    ks_heapmake(heap, heap_size, heap);
+    while (heap->pos != HEAP_EMPTY) {
+        bam1_t *b = heap->entry.bam_record;
+        if (g_is_by_minhash && b->core.tid == -1) {
+            // Remove the cached minhash value
+            b->core.pos = -1;
+            b->core.mpos = -1;
+            b->core.isize = 0;
+        }
+        if (sam_write1(p->fpout, p->hout, b) < 0)
+            goto fail;
+        if (part_add_read(p, heap, fp, rd, p->in_mem, &idx) < 0)
+            goto fail;
+        ks_heapadjust(heap, 0, heap_size, heap);
+    }
+
+    p->eof_block = p->fpout->fp.bgzf->is_compressed;
+    p->error = 0;
+
+ fail:
+    for (i = 0; i < p->n; i++) {
+        if (rd) tmp_file_destroy(&rd[i]);
+        if (fp && fp[i]) sam_close(fp[i]);
+    }
+    for (i = 0; heap && i < heap_size; i++) {
+        if (heap[i].i < p->n && heap[i].entry.bam_record)
+            bam_destroy1(heap[i].entry.bam_record);
+    }
+    free(rd);
+    free(fp);
+    free(heap);
+    return NULL;
+}
+
+/*
+ * Appends the segments to the file out, which has been written by the
+ * first part.  Only the EOF block of the last segment is kept.  The
+ * segment files are removed.
+ */
+static int concat_segments(const char *out, int n, char **seg_fn,
+                           const merge_part_t *parts)
+{
+    int fd, i, ret = -1;
+    off_t end;
+    char *buf = malloc(1 << 20);
+
+    if (!buf) return -1;
+    if ((fd = open(out, O_WRONLY)) < 0) {
+        free(buf);
+        return -1;
+    }
+    if ((end = lseek(fd, 0, SEEK_END)) < 0) goto fail;
+    if (parts[0].eof_block) {
+        end -= sizeof(bgzf_eof_block);
+        if (ftruncate(fd, end) < 0 || lseek(fd, end, SEEK_SET) < 0)
+            goto fail;
+    }
+
+    for (i = 1; i < n; i++) {
+        int in = open(seg_fn[i], O_RDONLY);
+        off_t len;
+        if (in < 0) goto fail;
+        len = lseek(in, 0, SEEK_END);
+        if (len >= 0 && i < n - 1 && parts[i].eof_block)
+            len -= sizeof(bgzf_eof_block);
+        if (len < 0 || lseek(in, 0, SEEK_SET) < 0) {
+            close(in);
+            goto fail;
+        }
+        while (len > 0) {
+            ssize_t l = read(in, buf, len < (1 << 20) ? len : (1 << 20));
+            if (l <= 0 || write(fd, buf, l) != l) {
+                close(in);
+                goto fail;
+            }
+            len -= l;
+        }
+        close(in);
+        unlink(seg_fn[i]);
+    }
+    ret = 0;
+
+ fail:
+    if (close(fd) < 0) ret = -1;
+    free(buf);
+    return ret;
+}
+
+/*
+ * Runs worker on each part in its own thread and concatenates the
+ * results into out.  The first part writes to out, after the header,
+ * the others to prefix.pNNNN.bam.
+ */
+static int run_merge_parts(merge_part_t *parts, int n_parts,
+                           void *(*worker)(void *), const char *out,
+                           const char *mode, const htsFormat *out_fmt,
+                           sam_hdr_t *hout, const char *prefix,
+                           const char *cmd, char *arg_list, int no_pg)
+{
+    pthread_t *tid = NULL;
+    char **seg_fn = NULL;
+    int i, n_started = 0, ret = -1;
+
+    tid = (pthread_t*)calloc(n_parts, sizeof(pthread_t));
+    seg_fn = (char**)calloc(n_parts, sizeof(char*));
+    if (!tid || !seg_fn) {
+        print_error(cmd, "Out of memory");
+        goto cleanup;
+    }
+    for (i = 0; i < n_parts; i++) {
+        merge_part_t *p = &parts[i];
+        p->mode = mode;
+        p->out_fmt = out_fmt;
+        p->hout = hout;
+        p->error = 1;
+        if (i > 0) {
+            if (!(seg_fn[i] = (char*)calloc(strlen(prefix) + 20, 1))) {
+                print_error(cmd, "Out of memory");
+                goto cleanup;
+            }
+            sprintf(seg_fn[i], "%s.p%.4d.bam", prefix, i);
+            p->out = seg_fn[i];
+        }
+    }
+
+    if ((parts[0].fpout = sam_open_format(out, mode, out_fmt)) == NULL) {
+        print_error_errno(cmd, "failed to create \"%s\"", out);
+        goto cleanup;
+    }
+    if (!no_pg && sam_hdr_add_pg(hout, "samtools",
+                                 "VN", samtools_version(),
+                                 arg_list ? "CL": NULL,
+                                 arg_list ? arg_list : NULL,
+                                 NULL)) {
+        print_error(cmd, "failed to add PG line to the header of \"%s\"", out);
+        goto cleanup;
+    }
+    if (sam_hdr_write(parts[0].fpout, hout) != 0) {
+        print_error_errno(cmd, "failed to write header to \"%s\"", out);
+        goto cleanup;
+    }
+
+    for (n_started = 0; n_started < n_parts; n_started++) {
+        if (samtools_pthread_create(&tid[n_started], NULL, worker,
+                           &parts[n_started]) != 0) {
+            print_error_errno(cmd, "failed to start merge thread");
+            break;
+        }
+    }
+    ret = n_started == n_parts ? 0 : -1;
+    for (i = 0; i < n_started; i++) {
+        pthread_join(tid[i], NULL);
+        if (parts[i].error) {
+            print_error(cmd, "failed to merge part %d into \"%s\"", i,
+                        i ? seg_fn[i] : out);
+            ret = -1;
+        }
+    }
+    for (i = 0; i < n_parts; i++) {
+        if (parts[i].fpout && sam_close(parts[i].fpout) < 0) {
+            print_error(cmd, "error closing output file");
+            ret = -1;
+        }
+        parts[i].fpout = NULL;
+    }
+    if (ret == 0 && concat_segments(out, n_parts, seg_fn, parts) < 0) {
+        print_error_errno(cmd, "failed to concatenate merged parts into \"%s\"", out);
+        ret = -1;
+    }
+
+ cleanup:
+    for (i = 0; i < n_parts; i++) {
+        if (parts[i].fpout) sam_close(parts[i].fpout);
+        parts[i].fpout = NULL;
+        if (seg_fn && seg_fn[i]) {
+            unlink(seg_fn[i]);
+            free(seg_fn[i]);
+        }
+    }
+    free(seg_fn);
+    free(tid);
+    return ret;
+}
+
+/*
+ * Checks whether the output can be merged in parts: it needs to be a
+ * regular BAM file.
+ */
+static int can_write_parts(const char *out, const char *mode,
+                           const htsFormat *out_fmt, int n_threads,
+                           int write_index)
+{
+    struct stat st;
+
+    if (n_threads < 2 || write_index || strcmp(out, "-") == 0)
+        return 0;
+    if (stat(out, &st) == 0 && !S_ISREG(st.st_mode))
+        return 0;
+    if (out_fmt && out_fmt->format != unknown_format
+        ? out_fmt->format != bam : !strchr(mode, 'b'))
+        return 0;
+    return 1;
+}
+
+// For samtools sort, all runs also need marks
+static int can_merge_parts(const char *out, const char *mode,
+                           const htsFormat *out_fmt, int n,
+                           const run_marks_t *marks, int n_threads,
+                           int write_index)
+{
+    int i;
+
+    if (!can_write_parts(out, mode, out_fmt, n_threads, write_index))
+        return 0;
+    for (i = 0; i < n; i++) {
+        if (!marks || marks[i].n == 0) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Version of bam_merge_simple() that merges in n_threads parts, see
+ * above.  Segments other than the first are written to
+ * prefix.pNNNN.bam.
+ */
+static int bam_merge_parts(const char *out, const char *mode, sam_hdr_t *hout,
+                           int n, char * const *fn, tmp_file_t *tmp,
+                           const run_marks_t *marks, int num_in_mem,
+                           buf_region *in_mem, bam1_tag *buf, int n_threads,
+                           const char *prefix, const char *cmd,
+                           const htsFormat *in_fmt, const htsFormat *out_fmt,
+                           char *arg_list, int no_pg)
+{
+    bam1_tag *samples = NULL;
+    bam1_t **copies = NULL;
+    size_t n_samples = 0, n_copies = 0, j;
+    merge_part_t *parts = NULL;
+    int i, n_parts = n_threads, ret = -1;
+
+    // Samples, each standing for about RUN_MARK_INTERVAL records
+    for (i = 0; i < n; i++) n_samples += marks[i].n;
+    for (i = 0; i < num_in_mem; i++)
+        n_copies += (in_mem[i].to - in_mem[i].from + RUN_MARK_INTERVAL - 1) / RUN_MARK_INTERVAL;
+    samples = (bam1_tag*)malloc((n_samples + n_copies + 1) * sizeof(bam1_tag));
+    copies = (bam1_t**)calloc(n_copies + 1, sizeof(bam1_t*));
+    if (!samples || !copies) goto mem_fail;
+    n_samples = n_copies = 0;
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < marks[i].n; j++)
+            samples[n_samples++] = marks[i].key[j];
+    }
+    // In-memory records are copied, as they get modified when written
+    for (i = 0; i < num_in_mem; i++) {
+        for (j = in_mem[i].from; j < in_mem[i].to; j += RUN_MARK_INTERVAL) {
+            bam1_tag *k = &samples[n_samples++];
+            if (!(k->bam_record = copies[n_copies++] = bam_dup1(buf[j].bam_record)))
+                goto mem_fail;
+            k->u.tag = g_is_by_tag ? bam_aux_get(k->bam_record, g_sort_tag) : NULL;
+        }
+    }
+    ks_mergesort(sort, n_samples, samples, 0);
+    if (n_parts > n_samples) n_parts = n_samples > 0 ? n_samples : 1;
+
+    parts = (merge_part_t*)calloc(n_parts, sizeof(merge_part_t));
+    if (!parts) goto mem_fail;
+
+    for (i = 0; i < n_parts; i++) {
+        merge_part_t *p = &parts[i];
+        p->lo = i > 0 ? &samples[(size_t)i * n_samples / n_parts] : NULL;
+        p->hi = i < n_parts - 1 ? &samples[(size_t)(i + 1) * n_samples / n_parts] : NULL;
+        p->in_fmt = in_fmt;
+        p->n = n;
+        p->fn = fn;
+        p->tmp = tmp;
+        p->marks = marks;
+        p->num_in_mem = num_in_mem;
+        p->buf = buf;
+        p->is_by_qname = g_is_by_qname;
+        p->is_by_tag = g_is_by_tag;
+        p->is_by_minhash = g_is_by_minhash;
+        p->sort_tag[0] = g_sort_tag[0];
+        p->sort_tag[1] = g_sort_tag[1];
+        p->in_mem = (buf_region*)calloc(num_in_mem + 1, sizeof(buf_region));
+        if (!p->in_mem) goto mem_fail;
+        for (j = 0; j < num_in_mem; j++) {
+            size_t from = in_mem[j].from, to = in_mem[j].to;
+            p->in_mem[j].from = p->lo ? sort_lower_bound(buf, from, to, p->lo) : from;
+            p->in_mem[j].to = p->hi ? sort_lower_bound(buf, from, to, p->hi) : to;
+        }
+    }
+
+    ret = run_merge_parts(parts, n_parts, merge_part_worker, out, mode,
+                          out_fmt, hout, prefix, cmd, arg_list, no_pg);
+    goto cleanup;
+
+ mem_fail:
+    print_error(cmd, "Out of memory");
+    ret = -1;
+
+ cleanup:
+    for (i = 0; parts && i < n_parts; i++)
+        free(parts[i].in_mem);
+    free(parts);
+    free(samples);
+    for (j = 0; copies && j < n_copies; j++)
+        bam_destroy1(copies[j]);
+    free(copies);
+    return ret;
+}
+
+/*
+ * Parallel samtools merge of coordinate sorted, indexed BAM files.  Each
+ * thread merges a range of contigs, reading every file from the end of
+ * the contig before the range, and the last one also the unplaced reads.
+ */
+
+static int contig_add_read(merge_part_t *p, heap1_t *heap, samFile **fp,
+                           sam_hdr_t **hdr, uint64_t *idx)
+{
+    bam1_t *b = heap->entry.bam_record;
+    int res;
+
+    do {
+        res = sam_read1(fp[heap->i], hdr[heap->i], b);
+        if (res < 0) break;
+        bam_translate(b, p->tbl + heap->i);
+    } while ((uint32_t)b->core.tid < (uint32_t)p->tid_beg);
+
+    if (res >= 0 && (p->no_coor || (uint32_t)b->core.tid < (uint32_t)p->tid_end)) {
+        heap->tid = b->core.tid;
+        heap->pos = (uint64_t)(b->core.pos + 1);
+        heap->rev = bam_is_rev(b);
+        heap->idx = (*idx)++;
+        heap->entry.u.tag = NULL;
+    } else if (res >= -1) {
+        heap->pos = HEAP_EMPTY;
+        bam_destroy1(b);
+        heap->entry.bam_record = NULL;
+        heap->entry.u.tag = NULL;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static void *merge_contigs_worker(void *data)
+{
+    merge_part_t *p = (merge_part_t *)data;
+    samFile **fp = NULL;
+    sam_hdr_t **hdr = NULL;
+    heap1_t *heap = NULL;
+    uint64_t n_read = 0;
+    int i, n = p->n;
+
+    g_is_by_qname = g_is_by_tag = g_is_by_minhash = 0;
+
+    fp = (samFile**)calloc(n, sizeof(samFile*));
+    hdr = (sam_hdr_t**)calloc(n, sizeof(sam_hdr_t*));
+    heap = (heap1_t*)calloc(n, sizeof(heap1_t));
+    if (!fp || !hdr || !heap) goto fail;
+    if (!p->fpout && !(p->fpout = sam_open_format(p->out, p->mode, p->out_fmt)))
+        goto fail;
+
+    for (i = 0; i < n; i++) {
+        heap[i].i = i;
+        heap[i].pos = HEAP_EMPTY;
+        if (p->start[i] == UINT64_MAX) continue;
+
+        if (!(fp[i] = sam_open_format(p->fn[i], "r", p->in_fmt)))
+            goto fail;
+        if (!(hdr[i] = sam_hdr_read(fp[i])))
+            goto fail;
+        if (p->start[i] != 0
+            && bgzf_seek(fp[i]->fp.bgzf, p->start[i], SEEK_SET) < 0)
+            goto fail;
+        if (!(heap[i].entry.bam_record = bam_init1()))
+            goto fail;
+        if (contig_add_read(p, &heap[i], fp, hdr, &n_read) < 0)
+            goto fail;
+    }
+
+    ks_heapmake(heap, n, heap);
+    while (heap->pos != HEAP_EMPTY) {
+        bam1_t *b = heap->entry.bam_record;
+        if (p->flag & MERGE_RG) {
+            uint8_t *rg = bam_aux_get(b, "RG");
+            if (rg) bam_aux_del(b, rg);
+            bam_aux_append(b, "RG", 'Z', p->RG_len[heap->i] + 1, (uint8_t*)p->RG[heap->i]);
+        }
+        if (sam_write1(p->fpout, p->hout, b) < 0)
+            goto fail;
+        if (contig_add_read(p, heap, fp, hdr, &n_read) < 0)
+            goto fail;
+        ks_heapadjust(heap, 0, n, heap);
+    }
+
+    p->eof_block = p->fpout->fp.bgzf->is_compressed;
+    p->error = 0;
+
+ fail:
+    for (i = 0; i < n; i++) {
+        if (heap && heap[i].entry.bam_record) bam_destroy1(heap[i].entry.bam_record);
+        if (hdr && hdr[i]) sam_hdr_destroy(hdr[i]);
+        if (fp && fp[i]) sam_close(fp[i]);
+    }
+    free(heap);
+    free(hdr);
+    free(fp);
+    return NULL;
+}
+
+static int contig_has_reads(hts_idx_t *idx, int tid)
+{
+    uint64_t mapped, unmapped;
+    return hts_idx_get_stat(idx, tid, &mapped, &unmapped) < 0
+        || mapped + unmapped > 0;
+}
+
+// Sets start to the offset in file i to read contigs [tid_beg, tid_end)
+// from, or the unplaced reads if no_coor is set.  This is the end of the
+// contig before, as iterators skip unmapped reads at the start of a
+// contig; 0 for the start of the file and UINT64_MAX if there are no
+// reads to merge.  Returns 0 on success, -1 on failure.
+static int contig_start(hts_idx_t *idx, const int *rtrans, int nref, int i,
+                        int tid_beg, int tid_end, int no_coor,
+                        uint64_t *start)
+{
+    hts_itr_t *iter;
+    int t, itid;
+
+    for (t = tid_beg; t < tid_end; t++) {
+        itid = rtrans[i * nref + t];
+        if (itid != INT32_MIN && contig_has_reads(idx, itid))
+            break;
+    }
+    *start = t == tid_end && !no_coor ? UINT64_MAX : 0;
+    if (*start == UINT64_MAX)
+        return 0;
+
+    for (t = tid_beg - 1; t >= 0; t--) {
+        itid = rtrans[i * nref + t];
+        if (itid != INT32_MIN && contig_has_reads(idx, itid))
+            break;
+    }
+    if (t < 0)
+        return 0;
+    if (!(iter = sam_itr_queryi(idx, itid, 0, HTS_POS_MAX)))
+        return -1;
+    if (!iter->finished && iter->n_off > 0)
+        *start = iter->off[iter->n_off - 1].v;
+    hts_itr_destroy(iter);
+    return 0;
+}
+
+/*
+ * Merges the files in n_threads parts of about the same number of reads
+ * if that is possible: the merge has to be by coordinate, over the whole
+ * files, from indexed BAM files into a BAM file.
+ * Returns 1 if the files were not merged, otherwise 0 for success or
+ * negative on errors.
+ */
+static int bam_merge_contigs(const char *out, const char *mode,
+                             sam_hdr_t *hout, int n, char * const *fn,
+                             char * const *fn_idx, samFile **fp,
+                             trans_tbl_t *tbl, char **RG, int *RG_len,
+                             int flag, int n_threads, const char *cmd,
+                             const htsFormat *in_fmt, const htsFormat *out_fmt,
+                             int write_index, char *arg_list, int no_pg)
+{
+    int i, k, t, nref = sam_hdr_nref(hout), n_parts, ret = 1, use_len = 0;
+    int *rtrans = NULL;
+    uint64_t *weight = NULL, *start = NULL, total = 0, done = 0;
+    hts_idx_t **idx = NULL;
+    merge_part_t *parts = NULL;
+    char *prefix = NULL;
+
+    if (nref == 0 || !can_write_parts(out, mode, out_fmt, n_threads, write_index))
+        return 1;
+    for (i = 0; i < n; i++) {
+        if (tbl[i].lost_coord_sort || hts_get_format(fp[i])->format != bam)
+            return 1;
+    }
+
+    rtrans = rtrans_build(n, nref, tbl);
+    weight = (uint64_t*)calloc(nref + 1, sizeof(uint64_t));
+    idx = (hts_idx_t**)calloc(n, sizeof(hts_idx_t*));
+    if (!rtrans || !weight || !idx) goto mem_fail;
+
+    // Reads per contig from the indices, or lengths if there are no counts
+    for (i = 0; i < n; i++) {
+        uint64_t mapped, unmapped;
+        idx[i] = fn_idx ? sam_index_load2(fp[i], fn[i], fn_idx[i])
+            : sam_index_load(fp[i], fn[i]);
+        if (!idx[i]) goto done;
+        for (t = 0; t < nref; t++) {
+            int itid = rtrans[i * nref + t];
+            if (itid == INT32_MIN) continue;
+            if (hts_idx_get_stat(idx[i], itid, &mapped, &unmapped) < 0)
+                use_len = 1;
+            else
+                weight[t] += mapped + unmapped;
+        }
+        weight[nref] += hts_idx_get_n_no_coor(idx[i]);
+    }
+    for (t = 0; t <= nref; t++) {
+        if (use_len && t < nref)
+            weight[t] = sam_hdr_tid2len(hout, t);
+        total += weight[t];
+    }
+
+    n_parts = n_threads < nref + 1 ? n_threads : nref + 1;
+    parts = (merge_part_t*)calloc(n_parts, sizeof(merge_part_t));
+    start = (uint64_t*)malloc(n_parts * n * sizeof(uint64_t));
+    prefix = (char*)malloc(strlen(out) + 5);
+    if (!parts || !start || !prefix) goto mem_fail;
+    sprintf(prefix, "%s.tmp", out);
+
+    // Contigs go to the part that holds the middle of their reads
+    for (k = 0; k < n_parts; k++)
+        parts[k].tid_beg = parts[k].tid_end = -1;
+    for (t = 0; t < nref; t++) {
+        k = total ? (int)(((2 * done + weight[t]) * n_parts) / (2 * total)) : 0;
+        if (k >= n_parts) k = n_parts - 1;
+        if (parts[k].tid_beg < 0) parts[k].tid_beg = t;
+        parts[k].tid_end = t + 1;
+        done += weight[t];
+    }
+    for (k = 0; k < n_parts; k++) {
+        merge_part_t *p = &parts[k];
+        if (p->tid_beg < 0) // empty, but keep the contigs in order
+            p->tid_beg = p->tid_end = k > 0 ? parts[k - 1].tid_end : 0;
+        p->no_coor = k == n_parts - 1;
+        p->start = start + k * n;
+        for (i = 0; i < n; i++) {
+            if (contig_start(idx[i], rtrans, nref, i, p->tid_beg,
+                             p->tid_end, p->no_coor, &start[k * n + i]) < 0) {
+                print_error(cmd, "failed to query the index of \"%s\"", fn[i]);
+                ret = -1;
+                goto done;
+            }
+        }
+        p->in_fmt = in_fmt;
+        p->n = n;
+        p->fn = fn;
+        p->tbl = tbl;
+        p->RG = RG;
+        p->RG_len = RG_len;
+        p->flag = flag;
+    }
+
+    ret = run_merge_parts(parts, n_parts, merge_contigs_worker, out, mode,
+                          out_fmt, hout, prefix, cmd, arg_list, no_pg);
+    goto done;
+
+ mem_fail:
+    print_error(cmd, "Out of memory");
+    ret = -1;
+
+ done:
+    if (idx) {
+        for (i = 0; i < n; i++) {
+            if (idx[i]) hts_idx_destroy(idx[i]);
+        }
+    }
+    free(idx);
+    free(prefix);
+    free(start);
+    free(parts);
+    free(weight);
+    free(rtrans);
+    return ret;
+}
+
 /*!
   @abstract Sort an unsorted BAM file based on the chromosome order
   and the leftmost position of an alignment
@@ -2371,7 +3213,8 @@ static int sort_blocks(int n_files, size_t k, bam1_tag *buf, const char *prefix,
   @param  is_by_qname whether to sort by query name
   @param  sort_by_tag if non-null, sort by the given tag
   @param  fn       name of the file to be sorted
-  @param  prefix   prefix of the temporary files (prefix.NNNN.bam are written)
+  @param  prefix   prefix of the temporary files (prefix.NNNN, or
+                   prefix.NNNN.bam if not tmp_lz4, are written)
   @param  fnout    name of the final output file to be written
   @param  modeout  sam_open() mode to be used to create the final output file
   @param  max_mem  approxiate maximum memory (very inaccurate)
@@ -2380,6 +3223,8 @@ static int sort_blocks(int n_files, size_t k, bam1_tag *buf, const char *prefix,
   @param  arg_list    command string for PG line
   @param  no_pg       if 1, do not add a new PG line
   @paran  write_index create index for the output file
+  @param  tmp_lz4     if 1, write temporary files with tmp_file_t (LZ4)
+                      instead of as BGZF compressed BAM
   @return 0 for successful sorting, negative on errors
 
   @discussion It may create multiple temporary subalignment files
@@ -2390,9 +3235,9 @@ int bam_sort_core_ext(int is_by_qname, char* sort_by_tag, const char *fn, const
                       const char *fnout, const char *modeout,
                       size_t _max_mem, int by_minimiser, int n_threads,
                       const htsFormat *in_fmt, const htsFormat *out_fmt,
-                      char *arg_list, int no_pg, int write_index)
+                      char *arg_list, int no_pg, int write_index, int tmp_lz4)
 {
-    int ret = -1, res, i, n_files = 0;
+    int ret = -1, res, i, n_files = 0, n_tmp_files = 0;
     size_t max_k, k, max_mem, bam_mem_offset;
     sam_hdr_t *header = NULL;
     samFile *fp;
@@ -2403,6 +3248,8 @@ int bam_sort_core_ext(int is_by_qname, char* sort_by_tag, const char *fn, const
     const char *new_so;
     buf_region *in_mem = NULL;
     int num_in_mem = 0;
+    tmp_file_t *tmp_files = NULL;
+    run_marks_t *marks = NULL;
 
     if (!b) {
         print_error("sort", "couldn't allocate memory for bam record");
@@ -2412,8 +3259,8 @@ int bam_sort_core_ext(int is_by_qname, char* sort_by_tag, const char *fn, const
     if (n_threads < 2) n_threads = 1;
     g_is_by_qname = is_by_qname;
     g_is_by_minhash = by_minimiser;
+    g_is_by_tag = sort_by_tag != NULL;
     if (sort_by_tag) {
-        g_is_by_tag = 1;
         g_sort_tag[0] = sort_by_tag[0];
         g_sort_tag[1] = sort_by_tag[0] ? sort_by_tag[1] : '\0';
     }
@@ -2514,8 +3361,30 @@ int bam_sort_core_ext(int is_by_qname, char* sort_by_tag, const char *fn, const
         ++k;
 
         if (mem_full) {
+            if (tmp_lz4) {
+                tmp_file_t *new_tmp;
+                new_tmp = realloc(tmp_files, (n_files + n_threads) * sizeof(*tmp_files));
+                if (!new_tmp) {
+                    print_error("sort", "couldn't allocate memory for temporary files");
+                    goto err;
+                }
+                tmp_files = new_tmp;
+                memset(&tmp_files[n_files], 0, n_threads * sizeof(*tmp_files));
+            }
+            if (n_threads > 1) {
+                // marks for a parallel merge
+                run_marks_t *new_marks;
+                new_marks = realloc(marks, (n_files + n_threads) * sizeof(*marks));
+                if (!new_marks) {
+                    print_error("sort", "couldn't allocate memory for temporary files");
+                    goto err;
+                }
+                marks = new_marks;
+                memset(&marks[n_files], 0, n_threads * sizeof(*marks));
+            }
+            n_tmp_files = n_files + n_threads;
             n_files = sort_blocks(n_files, k, buf, prefix, header, n_threads,
-                                  NULL);
+                                  NULL, tmp_files, marks);
             if (n_files < 0) {
                 goto err;
             }
@@ -2533,7 +3402,7 @@ int bam_sort_core_ext(int is_by_qname, char* sort_by_tag, const char *fn, const
         in_mem = calloc(n_threads > 0 ? n_threads : 1, sizeof(in_mem[0]));
         if (!in_mem) goto err;
         num_in_mem = sort_blocks(n_files, k, buf, prefix, header, n_threads,
-                                 in_mem);
+                                 in_mem, NULL, NULL);
         if (num_in_mem < 0) goto err;
     } else {
         num_in_mem = 0;
@@ -2542,7 +3411,7 @@ int bam_sort_core_ext(int is_by_qname, char* sort_by_tag, const char *fn, const
     // write the final output
     if (n_files == 0 && num_in_mem < 2) { // a single block
         if (write_buffer(fnout, modeout, k, buf, header, n_threads, out_fmt,
-                         g_is_by_minhash, arg_list, no_pg, write_index) != 0) {
+                         g_is_by_minhash, arg_list, no_pg, write_index, NULL) != 0) {
             print_error_errno("sort", "failed to create \"%s\"", fnout);
             goto err;
         }
@@ -2555,10 +3424,21 @@ int bam_sort_core_ext(int is_by_qname, char* sort_by_tag, const char *fn, const
         for (i = 0; i < n_files; ++i) {
             fns[i] = (char*)calloc(strlen(prefix) + 20, 1);
             if (!fns[i]) goto err;
-            sprintf(fns[i], "%s.%.4d.bam", prefix, i);
+            sprintf(fns[i], tmp_lz4 ? "%s.%.4d" : "%s.%.4d.bam", prefix, i);
+            if (tmp_lz4 && tmp_file_reopen(&tmp_files[i]) != TMP_SAM_OK) {
+                print_error("sort", "failed to read temporary file \"%s\"", fns[i]);
+                goto err;
+            }
         }
-        if (bam_merge_simple(is_by_qname, sort_by_tag, fnout, modeout, header,
-                             n_files, fns, num_in_mem, in_mem, buf,
+        if (can_merge_parts(fnout, modeout, out_fmt, n_files, marks,
+                            n_threads, write_index)) {
+            if (bam_merge_parts(fnout, modeout, header, n_files, fns,
+                                tmp_files, marks, num_in_mem, in_mem, buf,
+                                n_threads, prefix, "sort", in_fmt, out_fmt,
+                                arg_list, no_pg) < 0)
+                goto err;
+        } else if (bam_merge_simple(is_by_qname, sort_by_tag, fnout, modeout, header,
+                             n_files, fns, tmp_files, num_in_mem, in_mem, buf,
                              n_threads, "sort", in_fmt, out_fmt, arg_list,
                              no_pg, write_index) < 0) {
             // Propagate bam_merge_simple() failure; it has already emitted a
@@ -2574,12 +3454,19 @@ int bam_sort_core_ext(int is_by_qname, char* sort_by_tag, const char *fn, const
     if (fns) {
         for (i = 0; i < n_files; ++i) {
             if (fns[i]) {
-                unlink(fns[i]);
+                if (!tmp_lz4) unlink(fns[i]);
                 free(fns[i]);
             }
         }
         free(fns);
     }
+    // LZ4 temporary files are deleted by tmp_file_destroy()
+    for (i = 0; i < n_tmp_files; ++i) {
+        if (tmp_files) tmp_file_destroy(&tmp_files[i]);
+        if (marks) run_marks_destroy(&marks[i]);
+    }
+    free(tmp_files);
+    free(marks);
     bam_destroy1(b);
     free(buf);
     free(bam_mem);
@@ -2596,7 +3483,7 @@ int bam_sort_core(int is_by_qname, const char *fn, const char *prefix, size_t ma
     char *fnout = calloc(strlen(prefix) + 4 + 1, 1);
     if (!fnout) return -1;
     sprintf(fnout, "%s.bam", prefix);
-    ret = bam_sort_core_ext(is_by_qname, NULL, fn, prefix, fnout, "wb", max_mem, 0, 0, NULL, NULL, NULL, 1, 0);
+    ret = bam_sort_core_ext(is_by_qname, NULL, fn, prefix, fnout, "wb", max_mem, 0, 0, NULL, NULL, NULL, 1, 0, 1);
     free(fnout);
     return ret;
 }
@@ -2614,7 +3501,10 @@ static void sort_usage(FILE *fp)
 "  -n         Sort by read name (not compatible with samtools index command)\n"
 "  -t TAG     Sort by value of TAG. Uses position as secondary index (or read name if -n is set)\n"
 "  -o FILE    Write final output to FILE rather than standard output\n"
-"  -T PREFIX  Write temporary files to PREFIX.nnnn.bam\n"
+"  -T PREFIX  Write temporary files to PREFIX.nnnn (PREFIX.nnnn.bam with\n"
+"             --tmp-format bam)\n"
+"  --tmp-format lz4|bam\n"
+"             Format of temporary files; bam is slower but smaller [lz4]\n"
 "  --no-PG    do not add a PG line\n");
     sam_global_opt_help(fp, "-.O..@..");
 }
@@ -2640,7 +3530,7 @@ int bam_sort(int argc, char *argv[])
 {
     size_t max_mem = SORT_DEFAULT_MEGS_PER_THREAD << 20;
     int c, nargs, is_by_qname = 0, ret, o_seen = 0, level = -1, no_pg = 0;
-    int by_minimiser = 0, minimiser_kmer = 20;
+    int by_minimiser = 0, minimiser_kmer = 20, tmp_lz4 = 1;
     char* sort_tag = NULL, *arg_list = NULL;
     char *fnout = "-", modeout[12];
     kstring_t tmpprefix = { 0, 0, NULL };
@@ -2651,42 +3541,52 @@ int bam_sort(int argc, char *argv[])
         SAM_OPT_GLOBAL_OPTIONS('-', 0, 'O', 0, 0, '@'),
         { "threads", required_argument, NULL, '@' },
         {"no-PG", no_argument, NULL, 1},
+        {"tmp-format", required_argument, NULL, 2},
         { NULL, 0, NULL, 0 }
     };
 
-    while ((c = getopt_long(argc, argv, "l:m:no:O:T:@:t:MK:u", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "l:m:no:O:T:@:t:MK:u", lopts, NULL)) >= 0) {
         switch (c) {
-        case 'o': fnout = optarg; o_seen = 1; break;
+        case 'o': fnout = samtools_optarg; o_seen = 1; break;
         case 'n': is_by_qname = 1; break;
-        case 't': sort_tag = optarg; break;
+        case 't': sort_tag = samtools_optarg; break;
         case 'm': {
                 char *q;
-                max_mem = strtol(optarg, &q, 0);
+                max_mem = strtol(samtools_optarg, &q, 0);
                 if (*q == 'k' || *q == 'K') max_mem <<= 10;
                 else if (*q == 'm' || *q == 'M') max_mem <<= 20;
                 else if (*q == 'g' || *q == 'G') max_mem <<= 30;
                 break;
             }
-        case 'T': kputs(optarg, &tmpprefix); break;
-        case 'l': level = atoi(optarg); break;
+        case 'T': kputs(samtools_optarg, &tmpprefix); break;
+        case 'l': level = atoi(samtools_optarg); break;
         case 'u': level = 0; break;
         case   1: no_pg = 1; break;
+        case   2:
+            if (strcmp(samtools_optarg, "lz4") == 0) tmp_lz4 = 1;
+            else if (strcmp(samtools_optarg, "bam") == 0) tmp_lz4 = 0;
+            else {
+                fprintf(samtools_stderr, "[bam_sort] Unknown temporary file format \"%s\"\n", samtools_optarg);
+                ret = EXIT_FAILURE;
+                goto sort_end;
+            }
+            break;
         case 'M': by_minimiser = 1; break;
         case 'K':
-            minimiser_kmer = atoi(optarg);
+            minimiser_kmer = atoi(samtools_optarg);
             if (minimiser_kmer < 1)
                 minimiser_kmer = 1;
             else if (minimiser_kmer > 31)
                 minimiser_kmer = 31;
             break;
 
-        default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+        default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
                   /* else fall-through */
         case '?': sort_usage(samtools_stderr); ret = EXIT_FAILURE; goto sort_end;
         }
     }
 
-    nargs = argc - optind;
+    nargs = argc - samtools_optind;
     if (nargs == 0 && isatty(STDIN_FILENO)) {
         sort_usage(samtools_stdout);
         ret = EXIT_SUCCESS;
@@ -2732,17 +3632,18 @@ int bam_sort(int argc, char *argv[])
         ksprintf(&tmpprefix, "samtools.%d.%u.tmp", (int) getpid(), t % 10000);
     }
 
-    ret = bam_sort_core_ext(is_by_qname, sort_tag, (nargs > 0)? argv[optind] : "-",
+    ret = bam_sort_core_ext(is_by_qname, sort_tag, (nargs > 0)? argv[samtools_optind] : "-",
                             tmpprefix.s, fnout, modeout, max_mem,
                             by_minimiser * minimiser_kmer, ga.nthreads,
-                            &ga.in, &ga.out, arg_list, no_pg, ga.write_index);
+                            &ga.in, &ga.out, arg_list, no_pg, ga.write_index,
+                            tmp_lz4);
     if (ret >= 0)
         ret = EXIT_SUCCESS;
     else {
         char dummy[4];
         // If we failed on opening the input file & it has no .bam/.cram/etc
         // extension, the user probably tried legacy -o <infile> <out.prefix>
-        if (ret == -2 && o_seen && nargs > 0 && sam_open_mode(dummy, argv[optind], NULL) < 0)
+        if (ret == -2 && o_seen && nargs > 0 && sam_open_mode(dummy, argv[samtools_optind], NULL) < 0)
             fprintf(samtools_stderr, "[bam_sort] Note the <out.prefix> argument has been replaced by -T/-o options\n");
 
         ret = EXIT_FAILURE;
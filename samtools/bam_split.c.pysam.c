@@ -120,25 +120,25 @@ static parsed_opts_t* parse_args(int argc, char** argv)
     sam_global_args_init(&retval->ga);
 
     int opt;
-    while ((opt = getopt_long(argc, argv, optstring, lopts, NULL)) != -1) {
+    while ((opt = samtools_getopt_long(argc, argv, optstring, lopts, NULL)) != -1) {
         switch (opt) {
         case 'f':
-            retval->output_format_string = optarg;
+            retval->output_format_string = samtools_optarg;
             break;
         case 'h':
-            retval->unaccounted_header_name = optarg;
+            retval->unaccounted_header_name = samtools_optarg;
             break;
         case 'v':
             retval->verbose = true;
             break;
         case 'u':
-            retval->unaccounted_name = optarg;
+            retval->unaccounted_name = samtools_optarg;
             break;
         case 1:
             retval->no_pg = 1;
             break;
         default:
-            if (parse_sam_global_opt(opt, optarg, lopts, &retval->ga) == 0) break;
+            if (parse_sam_global_opt(opt, samtools_optarg, lopts, &retval->ga) == 0) break;
             /* else fall-through */
         case '?':
             usage(samtools_stdout);
@@ -149,8 +149,8 @@ static parsed_opts_t* parse_args(int argc, char** argv)
 
     if (retval->output_format_string == NULL) retval->output_format_string = "%*_%#.%.";
 
-    argc -= optind;
-    argv += optind;
+    argc -= samtools_optind;
+    argv += samtools_optind;
 
     if (argc != 1) {
         print_error("split", "Invalid number of arguments: %d", argc);
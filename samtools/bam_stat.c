@@ -31,8 +31,13 @@ DEALINGS IN THE SOFTWARE.  */
 #include <stdio.h>
 #include <limits.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "htslib/sam.h"
+#include "htslib/bgzf.h"
+#include "htslib/hfile.h"
+#include "htslib/hts_endian.h"
 #include "samtools.h"
 #include "sam_opts.h"
 
@@ -97,6 +102,292 @@ bam_flagstat_t *bam_flagstat_core(samFile *fp, sam_hdr_t *h)
     return s;
 }
 
+static void flagstat_add(bam_flagstat_t *s, const bam_flagstat_t *t)
+{
+    long long *a = (long long *)s;
+    const long long *b = (const long long *)t;
+    size_t i;
+    for (i = 0; i < sizeof(*s) / sizeof(*a); i++)
+        a[i] += b[i];
+}
+
+/*
+ * Parallel counting of a local BAM file, without needing an index.  The
+ * file is cut into byte ranges starting at BGZF blocks, and each range is
+ * counted by a worker from the first record it can find in it, up to the
+ * first record starting in the next range.  The first record of a range is
+ * found by checking that a run of valid records follows.  That guess is
+ * only used when the previous range ended exactly there; otherwise the main
+ * thread counts the range again from where the previous one ended, so the
+ * totals are always those of a single pass.
+ */
+#define FLAGSTAT_RANGE_MIN  (1 << 18)  // compressed bytes per range
+#define FLAGSTAT_GUESS_LEN  (1 << 20)  // uncompressed bytes searched for a record
+#define FLAGSTAT_GUESS_RECS 8
+
+typedef struct {
+    int64_t cbeg, cend;  // blocks starting this range and the next, cend -1 at EOF
+    int64_t beg, end;    // virtual offsets of the first record and the next range's
+    bam_flagstat_t s;
+    int status;          // 1 once counted
+} flagstat_range_t;
+
+typedef struct {
+    const char *fn;
+    const htsFormat *in_fmt;
+    flagstat_range_t *ranges;
+    int n_ranges, next;
+    pthread_mutex_t lock;
+} flagstat_parallel_t;
+
+// Counts the records from the current position up to the first one
+// starting in a block at or after cend, or to EOF if cend < 0.  Returns the
+// virtual offset the counting stopped at, or -1 on error.
+static int64_t flagstat_count_range(samFile *fp, sam_hdr_t *h, bam1_t *b,
+                                    int64_t cend, bam_flagstat_t *s)
+{
+    int64_t off;
+    int ret;
+    for (;;) {
+        off = bgzf_tell(fp->fp.bgzf);
+        if (cend >= 0 && (off >> 16) >= cend)
+            return off;
+        if ((ret = sam_read1(fp, h, b)) < 0)
+            break;
+        flagstat_loop(s, &b->core);
+    }
+    return ret == -1 ? off : -1;
+}
+
+static int flagstat_bgzf_magic(const uint8_t *p)
+{
+    return p[0] == 31 && p[1] == 139 && p[2] == 8 && p[3] == 4;
+}
+
+// Finds the first BGZF block header at or after offset which is followed by
+// another block or the end of the file, or returns -1
+static int64_t flagstat_block_start(hFILE *hf, int64_t offset, int64_t size,
+                                    uint8_t *buf)
+{
+    ssize_t n, p;
+
+    if (hseek(hf, offset, SEEK_SET) < 0
+        || (n = hread(hf, buf, 2 * BGZF_MAX_BLOCK_SIZE + 4)) < 18)
+        return -1;
+
+    for (p = 0; p + 18 <= n; p++) {
+        ssize_t next;
+        if (!flagstat_bgzf_magic(buf + p) || buf[p+10] != 6 || buf[p+11] != 0
+            || buf[p+12] != 'B' || buf[p+13] != 'C' || buf[p+14] != 2
+            || buf[p+15] != 0)
+            continue;
+        next = p + (buf[p+16] | buf[p+17] << 8) + 1;
+        if (offset + next == size
+            || (next + 4 <= n && flagstat_bgzf_magic(buf + next)))
+            return offset + p;
+    }
+    return -1;
+}
+
+// Whether a run of plausible BAM records starts at buf: FLAGSTAT_GUESS_RECS
+// of them, or at least one and as many as fit in len
+static int flagstat_records_ok(const uint8_t *buf, size_t len, int nref)
+{
+    size_t p = 0;
+    int n;
+
+    for (n = 0; n < FLAGSTAT_GUESS_RECS; n++) {
+        const uint8_t *q = buf + p;
+        int64_t block_len, ref, pos, mref, mpos, l_qname, n_cigar, l_seq;
+
+        if (p + 36 > len)
+            return n > 0;
+        block_len = le_to_u32(q);
+        ref = le_to_i32(q + 4);
+        pos = le_to_i32(q + 8);
+        l_qname = q[12];
+        n_cigar = le_to_u16(q + 16);
+        l_seq = le_to_i32(q + 20);
+        mref = le_to_i32(q + 24);
+        mpos = le_to_i32(q + 28);
+        if (ref < -1 || ref >= nref || mref < -1 || mref >= nref
+            || pos < -1 || mpos < -1 || l_qname < 1 || l_seq < 0
+            || 32 + l_qname + 4 * n_cigar + (l_seq + 1) / 2 + l_seq > block_len)
+            return 0;
+        if (p + 4 + block_len > len)
+            return n > 0;
+        if (q[36 + l_qname - 1] != 0)
+            return 0;
+        p += 4 + block_len;
+    }
+    return 1;
+}
+
+// Returns the virtual offset of the first record found from the block at
+// cbeg, or -1
+static int64_t flagstat_guess_start(BGZF *bgzf, int64_t cbeg, int nref,
+                                    uint8_t *buf)
+{
+    ssize_t len, o;
+
+    if (bgzf_seek(bgzf, cbeg << 16, SEEK_SET) < 0
+        || (len = bgzf_read(bgzf, buf, FLAGSTAT_GUESS_LEN)) <= 0)
+        return -1;
+
+    for (o = 0; o < len; o++) {
+        if (flagstat_records_ok(buf + o, len - o, nref)) {
+            if (bgzf_seek(bgzf, cbeg << 16, SEEK_SET) < 0
+                || bgzf_read(bgzf, buf, o) != o)
+                return -1;
+            return bgzf_tell(bgzf);
+        }
+    }
+    return -1;
+}
+
+static void *flagstat_worker(void *arg)
+{
+    flagstat_parallel_t *par = (flagstat_parallel_t *)arg;
+    samFile *fp = sam_open_format(par->fn, "r", par->in_fmt);
+    sam_hdr_t *h = fp ? sam_hdr_read(fp) : NULL;
+    bam1_t *b = bam_init1();
+    uint8_t *buf = malloc(FLAGSTAT_GUESS_LEN);
+
+    for (;;) {
+        flagstat_range_t *r;
+        int k;
+
+        pthread_mutex_lock(&par->lock);
+        k = par->next < par->n_ranges ? par->next++ : -1;
+        pthread_mutex_unlock(&par->lock);
+        if (k < 0)
+            break;
+
+        // Any range not counted here is counted by the main thread
+        r = &par->ranges[k];
+        if (!h || !b || !buf)
+            continue;
+        if (r->beg < 0)
+            r->beg = flagstat_guess_start(fp->fp.bgzf, r->cbeg,
+                                          sam_hdr_nref(h), buf);
+        if (r->beg < 0 || bgzf_seek(fp->fp.bgzf, r->beg, SEEK_SET) < 0)
+            continue;
+        if ((r->end = flagstat_count_range(fp, h, b, r->cend, &r->s)) >= 0)
+            r->status = 1;
+    }
+
+    free(buf);
+    bam_destroy1(b);
+    if (h) sam_hdr_destroy(h);
+    if (fp) sam_close(fp);
+    return NULL;
+}
+
+// The number of ranges to cut fp into, or 0 if it is not a local BAM file
+// large enough to be worth it
+static int flagstat_n_ranges(samFile *fp, const char *fn, int n_threads,
+                             int64_t *size)
+{
+    struct stat st;
+    int64_t n;
+
+    if (hts_get_format(fp)->format != bam
+        || hts_get_format(fp)->compression != bgzf
+        || strcmp(fn, "-") == 0 || stat(fn, &st) < 0 || !S_ISREG(st.st_mode))
+        return 0;
+    *size = st.st_size;
+    n = *size / FLAGSTAT_RANGE_MIN;
+    if (n > (int64_t) n_threads * 8)
+        n = (int64_t) n_threads * 8;
+    return n >= 2 ? n : 0;
+}
+
+// Counts fp, positioned after the header, in up to max_ranges parallel
+// ranges.  Returns NULL on failure.
+static bam_flagstat_t *bam_flagstat_parallel(samFile *fp, sam_hdr_t *h,
+                                             const char *fn,
+                                             const htsFormat *in_fmt,
+                                             int n_threads, int max_ranges,
+                                             int64_t size)
+{
+    flagstat_parallel_t par = { fn, in_fmt, NULL, 0, 0 };
+    bam_flagstat_t *s = NULL;
+    pthread_t *threads = NULL;
+    uint8_t *buf = NULL;
+    bam1_t *b = NULL;
+    hFILE *hf = NULL;
+    int64_t off;
+    int i, k, n_started = 0;
+
+    pthread_mutex_init(&par.lock, NULL);
+    par.ranges = calloc(max_ranges, sizeof(*par.ranges));
+    threads = calloc(n_threads, sizeof(*threads));
+    buf = malloc(2 * BGZF_MAX_BLOCK_SIZE + 4);
+    s = calloc(1, sizeof(*s));
+    b = bam_init1();
+    if (!par.ranges || !threads || !buf || !s || !b)
+        goto fail;
+    if (!(hf = hopen(fn, "r"))) {
+        print_error_errno("flagstat", "Cannot open input file \"%s\"", fn);
+        goto fail;
+    }
+
+    // The first range starts after the header, the others at the first
+    // block found after an even share of the file
+    par.ranges[0].beg = bgzf_tell(fp->fp.bgzf);
+    par.ranges[0].cbeg = par.ranges[0].beg >> 16;
+    par.n_ranges = 1;
+    for (k = 1; k < max_ranges; k++) {
+        off = flagstat_block_start(hf, size * k / max_ranges, size, buf);
+        if (off <= par.ranges[par.n_ranges-1].cbeg)
+            continue;
+        par.ranges[par.n_ranges-1].cend = off;
+        par.ranges[par.n_ranges].cbeg = off;
+        par.ranges[par.n_ranges].beg = -1;
+        par.n_ranges++;
+    }
+    par.ranges[par.n_ranges-1].cend = -1;
+    hclose_abruptly(hf);
+
+    for (i = 0; i < n_threads && i < par.n_ranges; i++) {
+        if (pthread_create(&threads[i], NULL, flagstat_worker, &par) != 0)
+            break;
+        n_started++;
+    }
+    for (i = 0; i < n_started; i++)
+        pthread_join(threads[i], NULL);
+
+    // Add up the ranges which started where the one before ended
+    off = par.ranges[0].beg;
+    for (k = 0; k < par.n_ranges; k++) {
+        flagstat_range_t *r = &par.ranges[k];
+        if (r->status == 1 && r->beg == off) {
+            flagstat_add(s, &r->s);
+            off = r->end;
+            continue;
+        }
+        if (bgzf_seek(fp->fp.bgzf, off, SEEK_SET) < 0
+            || (off = flagstat_count_range(fp, h, b, r->cend, s)) < 0)
+            goto fail;
+    }
+
+    free(par.ranges);
+    free(threads);
+    free(buf);
+    bam_destroy1(b);
+    pthread_mutex_destroy(&par.lock);
+    return s;
+
+ fail:
+    free(par.ranges);
+    free(threads);
+    free(buf);
+    free(s);
+    if (b) bam_destroy1(b);
+    pthread_mutex_destroy(&par.lock);
+    return NULL;
+}
+
 static const char *percent(char *buffer, long long n, long long total)
 {
     if (total != 0) sprintf(buffer, "%.2f%%", (float)n / total * 100.0);
@@ -118,6 +409,8 @@ static void usage_exit(FILE *fp, int exit_status)
     fprintf(fp, "  -O, --");
     fprintf(fp, "output-fmt FORMAT[,OPT[=VAL]]...\n"
             "               Specify output format (json, tsv)\n");
+    fprintf(fp, "      --index-only\n"
+            "               Only count mapped and unmapped reads, from the index\n");
     exit(exit_status);
 }
 
@@ -256,6 +549,67 @@ static void out_fmt_tsv(bam_flagstat_t *s) {
     printf("%lld\t%lld\twith mate mapped to a different chr (mapQ>=5)\n", s->n_diffhigh[0], s->n_diffhigh[1]);
 }
 
+/*
+ * The mapped and unmapped totals recorded in the index, all QC states
+ * together.  Unmapped reads include those without a position.
+ */
+static int idx_flagstat(samFile *fp, sam_hdr_t *h, const char *fn,
+                        const char *out_fmt)
+{
+    hts_idx_t *idx;
+    uint64_t mapped = 0, unmapped = 0, m, u;
+    char b0[16];
+    int tid;
+
+    // only BAM indices (.bai or .csi) keep read counts
+    if (hts_get_format(fp)->format != bam) {
+        print_error("flagstat", "--index-only needs an indexed BAM file, \"%s\" is not BAM", fn);
+        return -1;
+    }
+    if (!(idx = sam_index_load(fp, fn))) {
+        print_error("flagstat", "cannot load index for \"%s\"", fn);
+        return -1;
+    }
+    for (tid = 0; tid < sam_hdr_nref(h); tid++) {
+        if (hts_idx_get_stat(idx, tid, &m, &u) < 0) {
+            // no counts are fine for a reference without reads
+            hts_itr_t *iter = sam_itr_queryi(idx, tid, 0, HTS_POS_MAX);
+            int has_reads = !iter || (!iter->finished && iter->n_off > 0);
+            hts_itr_destroy(iter);
+            if (has_reads) {
+                print_error("flagstat", "the index of \"%s\" has no read counts", fn);
+                hts_idx_destroy(idx);
+                return -1;
+            }
+            continue;
+        }
+        mapped += m;
+        unmapped += u;
+    }
+    unmapped += hts_idx_get_n_no_coor(idx);
+    hts_idx_destroy(idx);
+
+    if (strcmp(out_fmt, "json") == 0 || strcmp(out_fmt, "JSON") == 0) {
+        printf("{\n \"total\": %"PRIu64", \n"
+               " \"mapped\": %"PRIu64", \n"
+               " \"mapped %%\": %s, \n"
+               " \"unmapped\": %"PRIu64" \n"
+               "}\n", mapped + unmapped, mapped,
+               percent_json(b0, mapped, mapped + unmapped), unmapped);
+    } else if (strcmp(out_fmt, "tsv") == 0 || strcmp(out_fmt, "TSV") == 0) {
+        printf("%"PRIu64"\ttotal (from the index)\n", mapped + unmapped);
+        printf("%"PRIu64"\tmapped\n", mapped);
+        printf("%s\tmapped %%\n", percent(b0, mapped, mapped + unmapped));
+        printf("%"PRIu64"\tunmapped\n", unmapped);
+    } else {
+        printf("%"PRIu64" in total (from the index)\n", mapped + unmapped);
+        printf("%"PRIu64" mapped (%s)\n", mapped,
+               percent(b0, mapped, mapped + unmapped));
+        printf("%"PRIu64" unmapped\n", unmapped);
+    }
+    return 0;
+}
+
 /*
  * Select flagstats output format to print.
  */
@@ -276,15 +630,18 @@ int bam_flagstat(int argc, char *argv[])
     sam_hdr_t *header;
     bam_flagstat_t *s;
     const char *out_fmt = "default";
-    int c, status = EXIT_SUCCESS;
+    int c, status = EXIT_SUCCESS, index_only = 0, n_ranges = 0;
+    int64_t size = 0;
 
     enum {
         INPUT_FMT_OPTION = CHAR_MAX+1,
+        INDEX_ONLY_OPTION,
     };
 
     sam_global_args ga = SAM_GLOBAL_ARGS_INIT;
     static const struct option lopts[] = {
         SAM_OPT_GLOBAL_OPTIONS('-', 0, 'O', '-', '-', '@'),
+        {"index-only", no_argument, NULL, INDEX_ONLY_OPTION},
         {NULL, 0, NULL, 0}
     };
 
@@ -293,6 +650,9 @@ int bam_flagstat(int argc, char *argv[])
         case 'O':
           out_fmt = optarg;
           break;
+        case INDEX_ONLY_OPTION:
+          index_only = 1;
+          break;
         default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
             /* else fall-through */
         case '?':
@@ -309,7 +669,9 @@ int bam_flagstat(int argc, char *argv[])
         print_error_errno("flagstat", "Cannot open input file \"%s\"", argv[optind]);
         return 1;
     }
-    if (ga.nthreads > 0)
+    if (ga.nthreads >= 2 && !index_only)
+        n_ranges = flagstat_n_ranges(fp, argv[optind], ga.nthreads, &size);
+    if (ga.nthreads > 0 && !n_ranges)
         hts_set_threads(fp, ga.nthreads);
 
     if (hts_set_opt(fp, CRAM_OPT_REQUIRED_FIELDS,
@@ -329,7 +691,17 @@ int bam_flagstat(int argc, char *argv[])
         return 1;
     }
 
-    s = bam_flagstat_core(fp, header);
+    if (index_only) {
+        if (idx_flagstat(fp, header, argv[optind], out_fmt) < 0)
+            status = EXIT_FAILURE;
+        goto out;
+    }
+
+    if (n_ranges)
+        s = bam_flagstat_parallel(fp, header, argv[optind], &ga.in,
+                                  ga.nthreads, n_ranges, size);
+    else
+        s = bam_flagstat_core(fp, header);
     if (s) {
         output_fmt(s, out_fmt);
         free(s);
@@ -339,6 +711,7 @@ int bam_flagstat(int argc, char *argv[])
         status = EXIT_FAILURE;
     }
 
+ out:
     sam_hdr_destroy(header);
     sam_close(fp);
     sam_global_args_free(&ga);
@@ -592,23 +592,23 @@ int main_bamshuf(int argc, char *argv[])
         { NULL, 0, NULL, 0 }
     };
 
-    while ((c = getopt_long(argc, argv, "n:l:uOo:@:fr:", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "n:l:uOo:@:fr:", lopts, NULL)) >= 0) {
         switch (c) {
-        case 'n': n_files = atoi(optarg); break;
-        case 'l': clevel = atoi(optarg); break;
+        case 'n': n_files = atoi(samtools_optarg); break;
+        case 'l': clevel = atoi(samtools_optarg); break;
         case 'u': is_un = 1; break;
         case 'O': is_samtools_stdout = 1; break;
-        case 'o': output_file = optarg; break;
+        case 'o': output_file = samtools_optarg; break;
         case 'f': fast_coll = 1; break;
-        case 'r': reads_store = atoi(optarg); break;
+        case 'r': reads_store = atoi(samtools_optarg); break;
         case 1: no_pg = 1; break;
-        default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+        default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
                   /* else fall-through */
         case '?': return usage(samtools_stderr, n_files, reads_store);
         }
     }
     if (is_un) clevel = 0;
-    if (argc >= optind + 2) prefix = argv[optind+1];
+    if (argc >= samtools_optind + 2) prefix = argv[samtools_optind+1];
     if (!(prefix || is_samtools_stdout || output_file))
         return usage(samtools_stderr, n_files, reads_store);
     if (is_samtools_stdout && output_file) {
@@ -627,7 +627,7 @@ int main_bamshuf(int argc, char *argv[])
         return 1;
     }
 
-    ret = bamshuf(argv[optind], n_files, prefix, clevel, is_samtools_stdout,
+    ret = bamshuf(argv[samtools_optind], n_files, prefix, clevel, is_samtools_stdout,
                    output_file, fast_coll, reads_store, &ga, arg_list, no_pg);
 
     if (pre_mem) free(prefix);
@@ -28,9 +28,11 @@ DEALINGS IN THE SOFTWARE.  */
 #include <zlib.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "htslib/kstring.h"
 #include "htslib/sam.h"
 #include "htslib/thread_pool.h"
@@ -65,6 +67,629 @@ static int read_bam(void *data, bam1_t *b)
     return ret;
 }
 
+/* Parse a BED line into tid, beg and end.  Returns 0 on success, 1 for
+   lines to be skipped and -1 for bad lines. */
+static int bed_line_parse(kstring_t *str, sam_hdr_t *h, int *tid,
+                          int64_t *beg, int64_t *end)
+{
+    char *p, *q, c;
+    int num;
+
+    if (str->l == 0 || *str->s == '#') return 1; /* empty or comment line */
+    /* Track and browser lines.  Also look for a trailing *space* in
+       case someone has badly-chosen a chromosome name (it would
+       be followed by a tab in that case). */
+    if (strncmp(str->s, "track ", 6) == 0) return 1;
+    if (strncmp(str->s, "browser ", 8) == 0) return 1;
+    for (p = q = str->s; *p && !isspace(*p); ++p);
+    if (*p == 0) return -1;
+    c = *p;
+    *p = 0; *tid = bam_name2id(h, q); *p = c;
+    if (*tid < 0) return -1;
+    num = sscanf(p + 1, "%"SCNd64" %"SCNd64, beg, end);
+    if (num < 2 || *end < *beg) return -1;
+    return 0;
+}
+
+/*
+ * Sweep mode (-S).  Rather than running a pileup over every base, the
+ * aligned blocks of each read are added to a sweep along the contig that
+ * keeps the running sums of the depth, so the counts of a region are the
+ * differences of the sums at its two ends.
+ *
+ * The BED lines are cut into regions of at most SWEEP_REG_LEN bases and the
+ * regions are grouped into chunks.  A job counts one chunk in one input
+ * file, reading it with a multi-region iterator, so the jobs can run on the
+ * thread pool.  Each job takes an idle reader of its file or opens a new one.
+ */
+
+#define SWEEP_REG_LEN    (1 << 20)
+#define SWEEP_CHUNK_REGS 1024
+#define SWEEP_CHUNK_LEN  (1 << 22)
+
+typedef struct {
+    int tid, line;
+    hts_pos_t beg, end;
+} sweep_reg_t;
+
+typedef struct {
+    int tid;
+    hts_pos_t pos;
+    int k;   // 2 * region index in the chunk, + 1 for the end of the region
+} sweep_point_t;
+
+typedef struct {
+    int64_t cnt, pcov;
+} sweep_sum_t;
+
+typedef struct {
+    htsFile *fp;
+    sam_hdr_t *header;
+    hts_idx_t *idx;
+} sweep_reader_t;
+
+typedef struct {
+    const char *fn, *fnidx;
+    pthread_mutex_t lock;
+    sweep_reader_t **idle;
+    int n_idle, m_idle;
+} sweep_file_t;
+
+typedef struct {
+    const sweep_reg_t *reg;
+    int n_reg;
+    sweep_point_t *pt;   // region ends, sorted by position
+    hts_reglist_t *rl;   // the merged regions by contig
+    int n_rl;
+    int refs;            // jobs not yet destroyed, one for each file
+} sweep_chunk_t;
+
+typedef struct {
+    sweep_file_t *files;
+    int n;
+    const htsFormat *in_fmt;
+    uint32_t flags;
+    int min_mapQ, min_depth, count_DN;
+} sweep_opt_t;
+
+enum { SWEEP_OK = 0, SWEEP_ENOMEM = -1, SWEEP_EOPEN = -2, SWEEP_EREAD = -3 };
+
+typedef struct {
+    const sweep_opt_t *opt;
+    sweep_chunk_t *chunk;
+    sweep_file_t *file;
+    sweep_sum_t *sum;    // by region of the chunk
+    int status;
+} sweep_job_t;
+
+/* Position x of the sweep on contig tid, with the depth at x and the sums
+   of the depths (c) and of the bases of at least the minimum depth (p)
+   before x.  Block starts and ends ahead are kept in a heap as
+   pos << 1 | is_end. */
+typedef struct {
+    int tid, i_pt;
+    hts_pos_t x;
+    int64_t depth, c, p;
+    uint64_t *heap;
+    size_t n_heap, m_heap;
+} sweep_state_t;
+
+static int sweep_push(sweep_state_t *s, hts_pos_t pos, int is_end)
+{
+    uint64_t v = (uint64_t)pos << 1 | is_end;
+    size_t i, j;
+
+    if (hts_resize(uint64_t, s->n_heap + 1, &s->m_heap, &s->heap, 0) < 0)
+        return -1;
+
+    for (i = s->n_heap++; i > 0 && s->heap[j = (i - 1) / 2] > v; i = j)
+        s->heap[i] = s->heap[j];
+
+    s->heap[i] = v;
+    return 0;
+}
+
+static uint64_t sweep_pop(sweep_state_t *s)
+{
+    uint64_t top = s->heap[0], v = s->heap[--s->n_heap];
+    size_t i = 0, j;
+
+    while ((j = 2 * i + 1) < s->n_heap) {
+        if (j + 1 < s->n_heap && s->heap[j + 1] < s->heap[j]) j++;
+        if (v <= s->heap[j]) break;
+        s->heap[i] = s->heap[j];
+        i = j;
+    }
+
+    s->heap[i] = v;
+    return top;
+}
+
+/* Move the sweep up to pos on contig tid, finishing the contigs before it
+   and adding the sums at the region ends passed to sum. */
+static void sweep_to(sweep_state_t *s, const sweep_chunk_t *ch,
+                     int min_depth, sweep_sum_t *sum, int tid, hts_pos_t pos)
+{
+    for (;;) {
+        const sweep_point_t *pt = s->i_pt < 2 * ch->n_reg ? &ch->pt[s->i_pt] : NULL;
+        hts_pos_t limit = s->tid < tid ? HTS_POS_MAX - 1 : pos;
+        hts_pos_t e = s->n_heap ? (hts_pos_t)(s->heap[0] >> 1) : HTS_POS_MAX;
+        hts_pos_t q = pt && pt->tid == s->tid ? pt->pos : HTS_POS_MAX;
+        hts_pos_t t = e < q ? e : q;
+
+        if (t > limit) {
+            if (s->tid >= tid) break;
+
+            // on to the next contig with regions, or to tid
+            s->tid = pt && pt->tid < tid ? pt->tid : tid;
+            s->x = 0;
+            s->depth = s->c = s->p = 0;
+            continue;
+        }
+
+        s->c += s->depth * (t - s->x);
+        if (s->depth >= min_depth) s->p += t - s->x;
+        s->x = t;
+
+        if (q == t) {
+            sweep_sum_t *r = &sum[pt->k >> 1];
+            if (pt->k & 1) {
+                r->cnt += s->c;
+                r->pcov += s->p;
+            } else {
+                r->cnt -= s->c;
+                r->pcov -= s->p;
+            }
+            s->i_pt++;
+        } else {
+            s->depth += (sweep_pop(s) & 1) ? -1 : 1;
+        }
+    }
+}
+
+/* Add the aligned blocks of b, plus its deletions and reference skips if
+   count_DN is set, to the sweep. */
+static int sweep_read(sweep_state_t *s, const bam1_t *b, int count_DN)
+{
+    const uint32_t *cigar = bam_get_cigar(b);
+    hts_pos_t pos = b->core.pos, beg = -1;
+    uint32_t k;
+
+    for (k = 0; k < b->core.n_cigar; k++) {
+        int type = bam_cigar_type(bam_cigar_op(cigar[k]));
+
+        if (!(type & 2)) continue;
+
+        if ((type & 1) || count_DN) {
+            if (beg < 0) beg = pos;
+        } else if (beg >= 0) {
+            if (pos > beg && (sweep_push(s, beg, 0) < 0 || sweep_push(s, pos, 1) < 0))
+                return -1;
+            beg = -1;
+        }
+
+        pos += bam_cigar_oplen(cigar[k]);
+    }
+
+    if (beg >= 0 && pos > beg && (sweep_push(s, beg, 0) < 0 || sweep_push(s, pos, 1) < 0))
+        return -1;
+
+    return 0;
+}
+
+static void sweep_reader_close(sweep_reader_t *rd)
+{
+    if (!rd) return;
+    if (rd->idx) hts_idx_destroy(rd->idx);
+    if (rd->header) sam_hdr_destroy(rd->header);
+    if (rd->fp) sam_close(rd->fp);
+    free(rd);
+}
+
+static sweep_reader_t *sweep_reader_get(sweep_file_t *f, const htsFormat *fmt)
+{
+    sweep_reader_t *rd = NULL;
+
+    pthread_mutex_lock(&f->lock);
+    if (f->n_idle) rd = f->idle[--f->n_idle];
+    pthread_mutex_unlock(&f->lock);
+
+    if (rd || !(rd = calloc(1, sizeof(*rd))))
+        return rd;
+
+    if (!(rd->fp = sam_open_format(f->fn, "r", fmt))
+        || !(rd->idx = f->fnidx ? sam_index_load2(rd->fp, f->fn, f->fnidx)
+                                : sam_index_load(rd->fp, f->fn))
+        || !(rd->header = sam_hdr_read(rd->fp))) {
+        sweep_reader_close(rd);
+        return NULL;
+    }
+
+    return rd;
+}
+
+static int sweep_reader_put(sweep_file_t *f, sweep_reader_t *rd)
+{
+    int ret;
+
+    pthread_mutex_lock(&f->lock);
+    ret = hts_resize(sweep_reader_t *, f->n_idle + 1, &f->m_idle, &f->idle, 0);
+    if (ret == 0) f->idle[f->n_idle++] = rd;
+    pthread_mutex_unlock(&f->lock);
+
+    if (ret < 0) sweep_reader_close(rd);
+    return ret;
+}
+
+static int sweep_point_cmp(const void *av, const void *bv)
+{
+    const sweep_point_t *a = av, *b = bv;
+    if (a->tid != b->tid) return a->tid < b->tid ? -1 : 1;
+    if (a->pos != b->pos) return a->pos < b->pos ? -1 : 1;
+    return a->k - b->k;
+}
+
+static void sweep_chunk_destroy(sweep_chunk_t *ch)
+{
+    if (!ch) return;
+    hts_reglist_free(ch->rl, ch->n_rl);
+    free(ch->pt);
+    free(ch);
+}
+
+/* Make the chunk of regions from reg[0] on, filling in the sorted region
+   ends and the merged non-empty regions of each contig. */
+static sweep_chunk_t *sweep_chunk_init(const sweep_reg_t *reg, size_t n_reg)
+{
+    sweep_chunk_t *ch = calloc(1, sizeof(*ch));
+    hts_pos_t len = 0;
+    int i, n_rl = 0;
+
+    if (!ch) return NULL;
+
+    ch->reg = reg;
+    while (ch->n_reg < n_reg && ch->n_reg < SWEEP_CHUNK_REGS && len < SWEEP_CHUNK_LEN) {
+        len += reg[ch->n_reg].end - reg[ch->n_reg].beg;
+        ch->n_reg++;
+    }
+
+    if (!(ch->pt = malloc(2 * ch->n_reg * sizeof(*ch->pt))))
+        goto fail;
+
+    for (i = 0; i < ch->n_reg; i++) {
+        ch->pt[2 * i].tid = ch->pt[2 * i + 1].tid = reg[i].tid;
+        ch->pt[2 * i].pos = reg[i].beg;
+        ch->pt[2 * i].k = 2 * i;
+        ch->pt[2 * i + 1].pos = reg[i].end;
+        ch->pt[2 * i + 1].k = 2 * i + 1;
+    }
+
+    qsort(ch->pt, 2 * ch->n_reg, sizeof(*ch->pt), sweep_point_cmp);
+
+    // the region starts come in order of position with their ends in between
+    for (i = 0; i < 2 * ch->n_reg; i++) {
+        const sweep_reg_t *r = &reg[ch->pt[i].k >> 1];
+        hts_reglist_t *rl;
+
+        if ((ch->pt[i].k & 1) || r->beg == r->end) continue;
+
+        if (!ch->n_rl || ch->rl[ch->n_rl - 1].tid != r->tid) {
+            if (hts_resize(hts_reglist_t, ch->n_rl + 1, &n_rl, &ch->rl, HTS_RESIZE_CLEAR) < 0)
+                goto fail;
+            rl = &ch->rl[ch->n_rl++];
+            rl->tid = r->tid;
+            rl->min_beg = r->beg;
+            rl->max_end = r->end;
+        } else {
+            rl = &ch->rl[ch->n_rl - 1];
+            if (r->beg <= rl->max_end) {
+                if (r->end > rl->intervals[rl->count - 1].end)
+                    rl->intervals[rl->count - 1].end = rl->max_end = r->end;
+                continue;
+            }
+            rl->max_end = r->end;
+        }
+
+        hts_pair_pos_t *iv = realloc(rl->intervals, (rl->count + 1) * sizeof(*iv));
+        if (!iv) goto fail;
+        iv[rl->count].beg = r->beg;
+        iv[rl->count].end = r->end;
+        rl->intervals = iv;
+        rl->count++;
+    }
+
+    return ch;
+
+ fail:
+    sweep_chunk_destroy(ch);
+    return NULL;
+}
+
+static hts_reglist_t *sweep_reglist_dup(const hts_reglist_t *rl, int n)
+{
+    hts_reglist_t *dup = calloc(n, sizeof(*dup));
+    int i;
+
+    if (!dup) return NULL;
+
+    for (i = 0; i < n; i++) {
+        dup[i] = rl[i];
+        if (!(dup[i].intervals = malloc(rl[i].count * sizeof(*rl[i].intervals)))) {
+            hts_reglist_free(dup, i);
+            return NULL;
+        }
+        memcpy(dup[i].intervals, rl[i].intervals, rl[i].count * sizeof(*rl[i].intervals));
+    }
+
+    return dup;
+}
+
+/* Count the chunk of the job in its file */
+static void *sweep_job_run(void *arg)
+{
+    sweep_job_t *job = (sweep_job_t *)arg;
+    const sweep_opt_t *opt = job->opt;
+    const sweep_chunk_t *ch = job->chunk;
+    sweep_state_t s;
+    sweep_reader_t *rd = NULL;
+    hts_reglist_t *rl = NULL;
+    hts_itr_t *iter = NULL;
+    bam1_t *b = NULL;
+    int ret;
+
+    memset(&s, 0, sizeof(s));
+    s.tid = -1;
+    job->status = SWEEP_ENOMEM;
+
+    if (!(job->sum = calloc(ch->n_reg, sizeof(*job->sum))))
+        goto fail;
+
+    if (ch->n_rl) {
+        if (!(rd = sweep_reader_get(job->file, opt->in_fmt))) {
+            job->status = SWEEP_EOPEN;
+            goto fail;
+        }
+
+        if (!(b = bam_init1()) || !(rl = sweep_reglist_dup(ch->rl, ch->n_rl)))
+            goto fail;
+
+        // the iterator owns the list, also when it fails
+        iter = sam_itr_regions(rd->idx, rd->header, rl, ch->n_rl);
+        rl = NULL;
+
+        if (!iter) {
+            job->status = SWEEP_EREAD;
+            goto fail;
+        }
+
+        while ((ret = sam_itr_next(rd->fp, iter, b)) >= 0) {
+            if ((b->core.flag & (opt->flags | BAM_FUNMAP)) || b->core.tid < 0) continue;
+            if ((int)b->core.qual < opt->min_mapQ) continue;
+
+            sweep_to(&s, ch, opt->min_depth, job->sum, b->core.tid, b->core.pos);
+            if (sweep_read(&s, b, opt->count_DN) < 0)
+                goto fail;
+        }
+
+        if (ret < -1) {
+            job->status = SWEEP_EREAD;
+            goto fail;
+        }
+    }
+
+    sweep_to(&s, ch, opt->min_depth, job->sum, INT_MAX, 0);
+    job->status = SWEEP_OK;
+
+ fail:
+    hts_itr_destroy(iter);
+    bam_destroy1(b);
+    free(s.heap);
+
+    if (rd) {
+        if (job->status == SWEEP_OK)
+            sweep_reader_put(job->file, rd);
+        else
+            sweep_reader_close(rd);
+    }
+
+    return job;
+}
+
+static void sweep_chunk_unref(sweep_chunk_t *ch, int n)
+{
+    if ((ch->refs -= n) == 0)
+        sweep_chunk_destroy(ch);
+}
+
+static void sweep_job_destroy(sweep_job_t *job)
+{
+    if (!job) return;
+    sweep_chunk_unref(job->chunk, 1);
+    free(job->sum);
+    free(job);
+}
+
+/* Print the BED lines of the finished chunk with their counts in each
+   file.  The counts of a line cut into several regions are added up in
+   line_sum, which carries over to the next chunk. */
+static void sweep_output(const sweep_opt_t *opt, sweep_job_t **done,
+                         const sweep_reg_t *reg_end, char **line,
+                         sweep_sum_t *line_sum, kstring_t *str)
+{
+    const sweep_chunk_t *ch = done[0]->chunk;
+    int i, j;
+
+    for (i = 0; i < ch->n_reg; i++) {
+        const sweep_reg_t *r = &ch->reg[i];
+
+        for (j = 0; j < opt->n; j++) {
+            line_sum[j].cnt += done[j]->sum[i].cnt;
+            line_sum[j].pcov += done[j]->sum[i].pcov;
+        }
+
+        if (r + 1 < reg_end && r[1].line == r->line) continue;
+
+        str->l = 0;
+        kputs(line[r->line], str);
+        for (j = 0; j < opt->n; j++) {
+            kputc('\t', str);
+            kputl(line_sum[j].cnt, str);
+        }
+        if (opt->min_depth >= 0) {
+            for (j = 0; j < opt->n; j++) {
+                kputc('\t', str);
+                kputl(line_sum[j].pcov, str);
+            }
+        }
+        puts(str->s);
+
+        free(line[r->line]);
+        line[r->line] = NULL;
+        memset(line_sum, 0, opt->n * sizeof(*line_sum));
+    }
+}
+
+/* Read the BED lines and count their regions in chunks, on the thread pool
+   if there is one. */
+static int bedcov_sweep(kstream_t *ks, kstring_t *str, sam_hdr_t *h,
+                        const sweep_opt_t *opt, hts_tpool *pool)
+{
+    char **line = NULL;
+    sweep_reg_t *reg = NULL;
+    size_t n_reg = 0, m_reg = 0, next = 0;
+    int n_line = 0, m_line = 0, dret, tid, status = 0, i;
+    int64_t beg, end;
+    sweep_chunk_t *chunk = NULL;
+    sweep_job_t *job = NULL, **done = NULL;
+    sweep_sum_t *line_sum = NULL;
+    hts_tpool_process *q = NULL;
+    hts_tpool_result *res;
+    int max_jobs = pool ? hts_tpool_size(pool) + 2 : 1;
+    int n_next = opt->n, n_done = 0, in_flight = 0;
+
+    while (ks_getuntil(ks, KS_SEP_LINE, str, &dret) >= 0) {
+        int ret = bed_line_parse(str, h, &tid, &beg, &end);
+        if (ret > 0) continue;
+        if (ret < 0) {
+            fprintf(stderr, "Errors in BED line '%s'\n", str->s);
+            status = 2;
+            continue;
+        }
+
+        if (hts_resize(char *, n_line + 1, &m_line, &line, 0) < 0
+            || !(line[n_line] = strdup(str->s)))
+            goto nomem;
+
+        do {
+            if (hts_resize(sweep_reg_t, n_reg + 1, &m_reg, &reg, 0) < 0)
+                goto nomem;
+            reg[n_reg].tid = tid;
+            reg[n_reg].line = n_line;
+            reg[n_reg].beg = beg;
+            reg[n_reg].end = beg = end - beg > SWEEP_REG_LEN ? beg + SWEEP_REG_LEN : end;
+            n_reg++;
+        } while (beg < end);
+
+        n_line++;
+    }
+
+    if (!(done = calloc(opt->n, sizeof(*done)))
+        || !(line_sum = calloc(opt->n, sizeof(*line_sum))))
+        goto nomem;
+
+    if (pool && !(q = hts_tpool_process_init(pool, max_jobs, 0))) {
+        print_error("bedcov", "error creating thread queue");
+        goto fail;
+    }
+
+    for (;;) {
+        if ((n_next < opt->n || next < n_reg) && in_flight < max_jobs) {
+            if (n_next == opt->n) {
+                if (!(chunk = sweep_chunk_init(reg + next, n_reg - next)))
+                    goto nomem;
+                chunk->refs = opt->n;
+                next += chunk->n_reg;
+                n_next = 0;
+            }
+
+            if (!(job = calloc(1, sizeof(*job))))
+                goto nomem;
+
+            job->opt = opt;
+            job->chunk = chunk;
+            job->file = &opt->files[n_next++];
+
+            if (pool) {
+                if (hts_tpool_dispatch(pool, q, sweep_job_run, job) < 0)
+                    goto fail;
+                job = NULL;
+                in_flight++;
+                continue;
+            }
+
+            sweep_job_run(job);
+        } else {
+            if (!in_flight)
+                break;
+
+            if ((res = hts_tpool_next_result_wait(q)) == NULL)
+                goto fail;
+
+            job = hts_tpool_result_data(res);
+            hts_tpool_delete_result(res, 0);
+            in_flight--;
+        }
+
+        if (job->status == SWEEP_EOPEN) {
+            print_error("bedcov", "failed to open '%s'", job->file->fn);
+            goto fail;
+        } else if (job->status == SWEEP_EREAD) {
+            print_error("bedcov", "error reading from input file");
+            goto fail;
+        } else if (job->status < 0) {
+            goto nomem;
+        }
+
+        done[n_done++] = job;
+        job = NULL;
+
+        if (n_done == opt->n) {
+            sweep_output(opt, done, reg + n_reg, line, line_sum, str);
+            for (i = 0; i < n_done; i++)
+                sweep_job_destroy(done[i]);
+            n_done = 0;
+        }
+    }
+
+    goto out;
+
+ nomem:
+    print_error("bedcov", "out of memory");
+ fail:
+    status = 2;
+ out:
+    while (in_flight-- > 0 && (res = hts_tpool_next_result_wait(q)) != NULL) {
+        sweep_job_destroy(hts_tpool_result_data(res));
+        hts_tpool_delete_result(res, 0);
+    }
+    if (q) hts_tpool_process_destroy(q);
+
+    for (i = 0; i < n_done; i++)
+        sweep_job_destroy(done[i]);
+    sweep_job_destroy(job);
+    // the jobs never made for the last chunk
+    if (chunk && n_next < opt->n)
+        sweep_chunk_unref(chunk, opt->n - n_next);
+
+    free(done);
+    free(line_sum);
+    for (i = 0; i < n_line; i++)
+        free(line[i]);
+    free(line);
+    free(reg);
+    return status;
+}
+
 int main_bedcov(int argc, char *argv[])
 {
     gzFile fp;
@@ -75,17 +700,18 @@ int main_bedcov(int argc, char *argv[])
     int *n_plp, dret, i, j, m, n, c, ret, status = 0, min_mapQ = 0, skip_DN = 0;
     int64_t *cnt, *pcov = NULL;;
     const bam_pileup1_t **plp;
-    int usage = 0, has_index_file = 0;
+    int usage = 0, has_index_file = 0, sweep = 0;
     uint32_t flags = (BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP);
     int tflags = 0, min_depth = -1;
+    htsThreadPool p = {NULL, 0};
 
     sam_global_args ga = SAM_GLOBAL_ARGS_INIT;
     static const struct option lopts[] = {
-        SAM_OPT_GLOBAL_OPTIONS('-', 0, '-', '-', 0, '-'),
+        SAM_OPT_GLOBAL_OPTIONS('-', 0, '-', '-', 0, '@'),
         { NULL, 0, NULL, 0 }
     };
 
-    while ((c = getopt_long(argc, argv, "Q:Xg:G:jd:", lopts, NULL)) >= 0) {
+    while ((c = getopt_long(argc, argv, "@:Q:Xg:G:jd:S", lopts, NULL)) >= 0) {
         switch (c) {
         case 'Q': min_mapQ = atoi(optarg); break;
         case 'X': has_index_file = 1; break;
@@ -107,6 +733,7 @@ int main_bedcov(int argc, char *argv[])
             break;
         case 'j': skip_DN = 1; break;
         case 'd': min_depth = atoi(optarg); break;
+        case 'S': sweep = 1; break;
         default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
                   /* else fall-through */
         case '?': usage = 1; break;
@@ -124,7 +751,9 @@ int main_bedcov(int argc, char *argv[])
         fprintf(stderr, "      -j                  do not include deletions (D) and ref skips (N) in bedcov computation\n");
         fprintf(stderr, "      -d <int>            depth threshold. Number of reference bases with coverage above and"
                         "                          including this value will be displayed in a separate column\n");
-        sam_global_opt_help(stderr, "-.--.--.");
+        fprintf(stderr, "      -S                  sum the depths from the aligned blocks of the reads instead of a\n"
+                        "                          pileup, without its depth limit (faster for large regions)\n");
+        sam_global_opt_help(stderr, "-.--.@-.");
         return 1;
     }
     if (has_index_file) {
@@ -165,6 +794,15 @@ int main_bedcov(int argc, char *argv[])
         }
         aux[i]->flags = flags;
     }
+    if (ga.nthreads > 0) {
+        if (!(p.pool = hts_tpool_init(ga.nthreads))) {
+            fprintf(stderr, "ERROR: failed to create thread pool\n");
+            return 2;
+        }
+        // the sweep runs its jobs on the pool instead
+        for (i = 0; i < n && !sweep; ++i)
+            hts_set_opt(aux[i]->fp, HTS_OPT_THREAD_POOL, &p);
+    }
     cnt = calloc(n, sizeof(*cnt));
     if (min_depth >= 0) pcov = calloc(n, sizeof(*pcov));
     if (!cnt || (min_depth >= 0 && !pcov)) return 2;
@@ -177,25 +815,45 @@ int main_bedcov(int argc, char *argv[])
     ks = ks_init(fp);
     n_plp = calloc(n, sizeof(int));
     plp = calloc(n, sizeof(bam_pileup1_t*));
-    while (ks_getuntil(ks, KS_SEP_LINE, &str, &dret) >= 0) {
-        char *p, *q;
-        int tid, pos, num = 0;
+    if (sweep) {
+        sweep_opt_t opt = { NULL, n, &ga.in, flags, min_mapQ, min_depth,
+                            !(skip_DN || min_depth >= 0) };
+        sweep_reader_t *rd;
+
+        if (!(opt.files = calloc(n, sizeof(*opt.files)))) return 2;
+        for (i = 0; i < n; ++i) {
+            opt.files[i].fn = argv[i+optind+1];
+            opt.files[i].fnidx = has_index_file ? argv[i+optind+n+1] : NULL;
+            pthread_mutex_init(&opt.files[i].lock, NULL);
+            // the files opened above are the first readers
+            if (!(rd = calloc(1, sizeof(*rd)))) return 2;
+            rd->fp = aux[i]->fp;
+            rd->header = aux[i]->header;
+            rd->idx = idx[i];
+            aux[i]->fp = NULL;
+            idx[i] = NULL;
+            if (sweep_reader_put(&opt.files[i], rd) < 0) return 2;
+        }
+
+        status = bedcov_sweep(ks, &str, opt.files[0].idle[0]->header, &opt, p.pool);
+
+        for (i = 0; i < n; ++i) {
+            for (j = 0; j < opt.files[i].n_idle; ++j)
+                sweep_reader_close(opt.files[i].idle[j]);
+            free(opt.files[i].idle);
+            pthread_mutex_destroy(&opt.files[i].lock);
+            aux[i]->header = NULL;
+        }
+        free(opt.files);
+    }
+    while (!sweep && ks_getuntil(ks, KS_SEP_LINE, &str, &dret) >= 0) {
+        int tid, pos;
         int64_t beg = 0, end = 0;
         bam_mplp_t mplp;
 
-        if (str.l == 0 || *str.s == '#') continue; /* empty or comment line */
-        /* Track and browser lines.  Also look for a trailing *space* in
-           case someone has badly-chosen a chromosome name (it would
-           be followed by a tab in that case). */
-        if (strncmp(str.s, "track ", 6) == 0) continue;
-        if (strncmp(str.s, "browser ", 8) == 0) continue;
-        for (p = q = str.s; *p && !isspace(*p); ++p);
-        if (*p == 0) goto bed_error;
-        char c = *p;
-        *p = 0; tid = bam_name2id(aux[0]->header, q); *p = c;
-        if (tid < 0) goto bed_error;
-        num = sscanf(p + 1, "%"SCNd64" %"SCNd64, &beg, &end);
-        if (num < 2 || end < beg) goto bed_error;
+        ret = bed_line_parse(&str, aux[0]->header, &tid, &beg, &end);
+        if (ret > 0) continue;
+        if (ret < 0) goto bed_error;
 
         for (i = 0; i < n; ++i) {
             if (aux[i]->iter) hts_itr_destroy(aux[i]->iter);
@@ -262,11 +920,12 @@ bed_error:
         if (aux[i]->iter) hts_itr_destroy(aux[i]->iter);
         hts_idx_destroy(idx[i]);
         sam_hdr_destroy(aux[i]->header);
-        sam_close(aux[i]->fp);
+        if (aux[i]->fp) sam_close(aux[i]->fp);
         free(aux[i]);
     }
     free(aux); free(idx);
     free(str.s);
+    if (p.pool) hts_tpool_destroy(p.pool);
     sam_global_args_free(&ga);
     return status;
 }
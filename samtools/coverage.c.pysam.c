@@ -45,6 +45,7 @@ DEALINGS IN THE SOFTWARE.  */
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
+#include <pthread.h>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -81,6 +82,10 @@ typedef struct {  // auxiliary data structure to hold a BAM file
     int fail_flags;
     int required_flags;
     stats_aux_t *stats;
+    hts_idx_t *idx;  // index for the parallel windows
+    bool window;     // stats only of the reads starting in the window below
+    int win_tid;
+    hts_pos_t win_beg, win_end;
 } bam_aux_t;
 
 #if __STDC_VERSION__ >= 199901L
@@ -132,7 +137,7 @@ static int usage() {
             "  -h, --help              help (this page)\n");
 
     fprintf(samtools_stdout, "\nGeneric options:\n");
-    sam_global_opt_help(samtools_stdout, "-.--.--.");
+    sam_global_opt_help(samtools_stdout, "-.--.@-.");
 
     fprintf(samtools_stdout,
             "\nSee manpage for additional details.\n"
@@ -174,29 +179,93 @@ static char* readable_bps(double base_pairs, char *buf) {
     return buf;
 }
 
+// the stats to count a read in, if any
+static stats_aux_t *read_stats(bam_aux_t *aux, const bam1_t *b) {
+    if (aux->window)
+        return b->core.tid == aux->win_tid && b->core.pos >= aux->win_beg
+            && b->core.pos < aux->win_end ? aux->stats : NULL;
+
+    return b->core.tid >= 0 && b->core.tid < sam_hdr_nref(aux->hdr)
+        ? &aux->stats[b->core.tid] : NULL;
+}
+
 // read one alignment from one BAM file
 static int read_bam(void *data, bam1_t *b) {
     bam_aux_t *aux = (bam_aux_t*)data; // data in fact is a pointer to an auxiliary structure
-    int nref = sam_hdr_nref(aux->hdr);
+    stats_aux_t *stats;
     int ret;
     while (1) {
         if((ret = aux->iter? sam_itr_next(aux->fp, aux->iter, b) : sam_read1(aux->fp, aux->hdr, b)) < 0) break;
-        if (b->core.tid >= 0 && b->core.tid < nref)
-            aux->stats[b->core.tid].n_reads++;
+        if ((stats = read_stats(aux, b)) != NULL)
+            stats->n_reads++;
 
         if ( aux->fail_flags && (b->core.flag & aux->fail_flags) ) continue;
         if ( aux->required_flags && !(b->core.flag & aux->required_flags) ) continue;
         if ( b->core.qual < aux->min_mapQ ) continue;
         if ( aux->min_len && bam_cigar2qlen(b->core.n_cigar, bam_get_cigar(b)) < aux->min_len ) continue;
-        if (b->core.tid >= 0 && b->core.tid < nref) {
-            aux->stats[b->core.tid].n_selected_reads++;
-            aux->stats[b->core.tid].summed_mapQ += b->core.qual;
+        if (stats) {
+            stats->n_selected_reads++;
+            stats->summed_mapQ += b->core.qual;
         }
         break;
     }
     return ret;
 }
 
+// add the pileup at pos to the stats, and to its bin in hist if not NULL
+static void count_position(stats_aux_t *stats, uint32_t *hist, int64_t n_bins,
+                           hts_pos_t pos, int n_bam_files, const int *n_plp,
+                           const bam_pileup1_t **plp, int min_baseQ) {
+    int i, j;
+    int64_t current_bin = 0;
+
+    if (hist) {
+        current_bin = (pos - stats->beg) / stats->bin_width;
+    }
+
+    bool count_base = false;
+    for (i = 0; i < n_bam_files; ++i) { // base level filters have to go here
+        int depth_at_pos = n_plp[i];
+        for (j = 0; j < n_plp[i]; ++j) {
+            const bam_pileup1_t *p = plp[i] + j; // DON'T modify plp[][] unless you really know
+
+            if (p->is_del || p->is_refskip) --depth_at_pos; // having dels or refskips at tid:pos
+            else if (p->qpos < p->b->core.l_qseq &&
+                    bam_get_qual(p->b)[p->qpos] < min_baseQ) --depth_at_pos; // low base quality
+            else
+                stats->summed_baseQ += bam_get_qual(p->b)[p->qpos];
+        }
+        if (depth_at_pos > 0) {
+            count_base = true;
+            stats->summed_coverage += depth_at_pos;
+        }
+        // hist[current_bin] += depth_at_pos;  // Add counts to the histogram here to have one based on coverage
+        //fprintf(file_out, "\t%d", n_plp[i] - m); // this the depth to output
+    }
+    if (count_base) {
+        stats->n_covered_bases++;
+        if (hist && current_bin < n_bins)
+            ++(hist[current_bin]); // Histogram based on breadth of coverage
+    }
+}
+
+// set the CRAM options for the fields used
+static int set_cram_opts(samFile *fp, int min_baseQ) {
+    int rf = SAM_FLAG | SAM_RNAME | SAM_POS | SAM_MAPQ | SAM_CIGAR | SAM_SEQ;
+    if (min_baseQ) rf |= SAM_QUAL;
+
+    // Set CRAM options on file handle - returns 0 on success
+    if (hts_set_opt(fp, CRAM_OPT_REQUIRED_FIELDS, rf)) {
+        print_error("coverage", "Failed to set CRAM_OPT_REQUIRED_FIELDS value");
+        return -1;
+    }
+    if (hts_set_opt(fp, CRAM_OPT_DECODE_MD, 0)) {
+        print_error("coverage", "Failed to set CRAM_OPT_DECODE_MD value");
+        return -1;
+    }
+    return 0;
+}
+
 void print_tabular_line(FILE *file_out, const sam_hdr_t *h, const stats_aux_t *stats, int tid) {
     fputs(sam_hdr_tid2name(h, tid), file_out);
     double region_len = (double) stats[tid].end - stats[tid].beg;
@@ -287,10 +356,316 @@ void print_hist(FILE *file_out, const sam_hdr_t *h, const stats_aux_t *stats, in
     fprintf(file_out, "\n");
 }
 
+/*
+ * With two or more threads, indexed inputs and no region, the contigs are
+ * cut into windows which worker threads run their own pileups over.  Each
+ * read is counted in the window it starts in, and the covered positions in
+ * the windows they lie in, so adding up the windows of a contig gives the
+ * same stats as the single pileup.
+ */
+#define COVERAGE_WINDOW_BASES (1 << 22) // shared between the input files
+#define COVERAGE_WINDOW_MIN   (1 << 14)
+
+typedef struct {
+    int tid;
+    hts_pos_t beg, end;
+    stats_aux_t stats;
+    uint32_t *hist;  // NULL unless a histogram with covered bases
+    int status;
+} coverage_window_t;
+
+typedef struct {
+    bam_aux_t **data;  // the inputs opened by main_coverage
+    char **fn;
+    const htsFormat *in_fmt;
+    int n_files;
+    const stats_aux_t *stats;  // per contig bin geometry
+    int opt_n_bins;
+    int max_depth;
+    int min_baseQ;
+    bool histogram;
+    coverage_window_t *win;
+    int n_win, next;
+    pthread_mutex_t lock;
+} coverage_parallel_t;
+
+typedef struct {
+    coverage_parallel_t *par;
+    bam_aux_t *aux;
+    bool own;
+    bool failed;
+} coverage_worker_t;
+
+static int coverage_worker_open(coverage_worker_t *w, bool own) {
+    coverage_parallel_t *par = w->par;
+    int i;
+
+    if (!(w->aux = calloc(par->n_files, sizeof(*w->aux))))
+        return -1;
+
+    for (i = 0; i < par->n_files; i++) {
+        w->aux[i] = *par->data[i];
+        if (own) {
+            w->aux[i].fp = NULL;
+            w->aux[i].hdr = NULL;
+            w->aux[i].idx = NULL;
+        }
+    }
+    if (!(w->own = own))
+        return 0;
+
+    for (i = 0; i < par->n_files; i++) {
+        bam_aux_t *aux = &w->aux[i];
+        if (!(aux->fp = sam_open_format(par->fn[i], "r", par->in_fmt))) {
+            print_error_errno("coverage", "Could not open \"%s\"", par->fn[i]);
+            return -1;
+        }
+        if (set_cram_opts(aux->fp, par->min_baseQ) < 0)
+            return -1;
+        if (!(aux->hdr = sam_hdr_read(aux->fp))) {
+            print_error_errno("coverage", "Could not read header for \"%s\"", par->fn[i]);
+            return -1;
+        }
+        if (!(aux->idx = sam_index_load(aux->fp, par->fn[i]))) {
+            print_error_errno("coverage", "Failed to load index for \"%s\"", par->fn[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void coverage_worker_close(coverage_worker_t *w) {
+    int i;
+
+    if (w->aux && w->own) {
+        for (i = 0; i < w->par->n_files; i++) {
+            if (w->aux[i].idx) hts_idx_destroy(w->aux[i].idx);
+            if (w->aux[i].hdr) sam_hdr_destroy(w->aux[i].hdr);
+            if (w->aux[i].fp) sam_close(w->aux[i].fp);
+        }
+    }
+    free(w->aux);
+}
+
+static int coverage_window_run(coverage_worker_t *w, coverage_window_t *win) {
+    coverage_parallel_t *par = w->par;
+    const stats_aux_t *contig = &par->stats[win->tid];
+    int64_t n_bins = par->opt_n_bins < contig->end ? par->opt_n_bins : contig->end;
+    bam_aux_t **data = calloc(par->n_files, sizeof(*data));
+    int *n_plp = calloc(par->n_files, sizeof(*n_plp));
+    const bam_pileup1_t **plp = calloc(par->n_files, sizeof(*plp));
+    bam_mplp_t mplp = NULL;
+    int i, ret = -1, tid;
+    hts_pos_t pos;
+
+    win->stats.beg = contig->beg;
+    win->stats.end = contig->end;
+    win->stats.bin_width = contig->bin_width;
+    if (!data || !n_plp || !plp
+        || (par->histogram && n_bins > 0
+            && !(win->hist = calloc(n_bins, sizeof(uint32_t))))) {
+        print_error_errno("coverage", "Failed to allocate memory");
+        goto out;
+    }
+
+    for (i = 0; i < par->n_files; i++) {
+        bam_aux_t *aux = &w->aux[i];
+        if (!(aux->iter = sam_itr_queryi(aux->idx, win->tid, win->beg, win->end))) {
+            print_error("coverage", "Failed to query the index of \"%s\"", par->fn[i]);
+            goto out;
+        }
+        aux->stats = &win->stats;
+        aux->window = true;
+        aux->win_tid = win->tid;
+        aux->win_beg = win->beg;
+        aux->win_end = win->end;
+        data[i] = aux;
+    }
+
+    if (!(mplp = bam_mplp_init(par->n_files, read_bam, (void**)data)))
+        goto out;
+    if (par->max_depth > 0)
+        bam_mplp_set_maxcnt(mplp, par->max_depth);
+    else if (!par->max_depth)
+        bam_mplp_set_maxcnt(mplp, INT_MAX);
+
+    while ((ret = bam_mplp64_auto(mplp, &tid, &pos, n_plp, plp)) > 0) {
+        win->stats.covered = true;
+        if (pos < win->beg || pos >= win->end) continue; // another window's
+        if (pos < contig->beg || pos >= contig->end) continue;
+
+        count_position(&win->stats, win->hist, n_bins, pos, par->n_files,
+                       n_plp, plp, par->min_baseQ);
+    }
+    if (ret < 0)
+        print_error("coverage", "Failed to read alignments in the window %s:%"PRIhts_pos"-%"PRIhts_pos,
+                    sam_hdr_tid2name(w->aux[0].hdr, win->tid), win->beg + 1, win->end);
+
+ out:
+    if (mplp) bam_mplp_destroy(mplp);
+    for (i = 0; i < par->n_files; i++) {
+        hts_itr_destroy(w->aux[i].iter);
+        w->aux[i].iter = NULL;
+    }
+    if (win->hist && !win->stats.n_covered_bases) {
+        free(win->hist);
+        win->hist = NULL;
+    }
+    free(data);
+    free(n_plp);
+    free(plp);
+    return ret;
+}
+
+static void *coverage_worker(void *arg) {
+    coverage_worker_t *w = (coverage_worker_t *)arg;
+    coverage_parallel_t *par = w->par;
+
+    for (;;) {
+        int k;
+
+        pthread_mutex_lock(&par->lock);
+        k = par->next < par->n_win ? par->next++ : -1;
+        pthread_mutex_unlock(&par->lock);
+        if (k < 0)
+            break;
+
+        if (w->failed || coverage_window_run(w, &par->win[k]) < 0) {
+            // Give up on the remaining windows too
+            pthread_mutex_lock(&par->lock);
+            par->next = par->n_win;
+            pthread_mutex_unlock(&par->lock);
+            w->failed = true;
+            break;
+        }
+        par->win[k].status = 1;
+    }
+
+    return NULL;
+}
+
+// Runs the windows on n_threads threads, and prints the contig stats.
+static int coverage_parallel(coverage_parallel_t *par, int n_threads,
+                             FILE *file_out, const sam_hdr_t *h, stats_aux_t *stats,
+                             bool print_histogram, bool print_tabular, bool full_utf) {
+    int n_targets = sam_hdr_nref(h);
+    hts_pos_t width = COVERAGE_WINDOW_BASES / par->n_files;
+    coverage_worker_t *workers = NULL;
+    pthread_t *threads = NULL;
+    uint32_t *hist = NULL;
+    int i, k, t, n_started = 0, n_printed = 0, status = -1;
+
+    if (width < COVERAGE_WINDOW_MIN)
+        width = COVERAGE_WINDOW_MIN;
+    pthread_mutex_init(&par->lock, NULL);
+
+    for (t = 0; t < n_targets; t++) {
+        hts_pos_t len = sam_hdr_tid2len(h, t), beg = 0;
+        do {
+            coverage_window_t *win;
+            if (!(par->n_win & (par->n_win - 1))) {
+                win = realloc(par->win, (par->n_win ? 2 * par->n_win : 64) * sizeof(*win));
+                if (!win) {
+                    print_error_errno("coverage", "Failed to allocate memory");
+                    goto out;
+                }
+                par->win = win;
+            }
+            win = memset(&par->win[par->n_win++], 0, sizeof(*win));
+            win->tid = t;
+            win->beg = beg;
+            win->end = len - beg > width ? beg + width : HTS_POS_MAX;
+            beg += width;
+        } while (beg < len);
+    }
+
+    par->next = 0;
+    workers = calloc(n_threads, sizeof(*workers));
+    threads = calloc(n_threads, sizeof(*threads));
+    hist = calloc(par->opt_n_bins, sizeof(uint32_t));
+    if (!workers || !threads || !hist) {
+        print_error_errno("coverage", "Failed to allocate memory");
+        goto out;
+    }
+
+    for (i = 0; i < n_threads; i++) {
+        workers[i].par = par;
+        if (coverage_worker_open(&workers[i], i > 0) < 0)
+            workers[i].failed = true;
+        if (samtools_pthread_create(&threads[i], NULL, coverage_worker, &workers[i]) != 0)
+            break;
+        n_started++;
+    }
+    if (!n_started) {
+        print_error_errno("coverage", "Failed to start the worker threads");
+        goto out;
+    }
+    for (i = 0; i < n_started; i++)
+        pthread_join(threads[i], NULL);
+
+    for (k = 0; k < par->n_win; k++)
+        if (par->win[k].status != 1)
+            goto out;
+
+    // Add up the windows of each contig, and print the covered ones
+    for (k = 0; k < par->n_win; k = i) {
+        int64_t n_bins;
+        t = par->win[k].tid;
+        n_bins = par->opt_n_bins < stats[t].end ? par->opt_n_bins : stats[t].end;
+        memset(hist, 0, par->opt_n_bins * sizeof(uint32_t));
+        for (i = k; i < par->n_win && par->win[i].tid == t; i++) {
+            const stats_aux_t *s = &par->win[i].stats;
+            int j;
+            stats[t].n_covered_bases += s->n_covered_bases;
+            stats[t].summed_coverage += s->summed_coverage;
+            stats[t].summed_baseQ += s->summed_baseQ;
+            stats[t].summed_mapQ += s->summed_mapQ;
+            stats[t].n_reads += s->n_reads;
+            stats[t].n_selected_reads += s->n_selected_reads;
+            stats[t].covered |= s->covered;
+            if (par->win[i].hist)
+                for (j = 0; j < n_bins; j++)
+                    hist[j] += par->win[i].hist[j];
+        }
+        if (!stats[t].covered)
+            continue;
+
+        if (print_histogram) {
+            if (n_printed++)
+                fputc('\n', file_out);
+            print_hist(file_out, h, stats, t, hist, n_bins, full_utf);
+        } else if (print_tabular) {
+            print_tabular_line(file_out, h, stats, t);
+        }
+    }
+
+    if (print_tabular) {
+        for (t = 0; t < n_targets; ++t) {
+            if (!stats[t].covered)
+                print_tabular_line(file_out, h, stats, t);
+        }
+    }
+    status = 0;
+
+ out:
+    if (workers) {
+        for (i = 0; i < n_threads; i++)
+            coverage_worker_close(&workers[i]);
+    }
+    for (k = 0; k < par->n_win; k++)
+        free(par->win[k].hist);
+    free(par->win);
+    free(workers);
+    free(threads);
+    free(hist);
+    pthread_mutex_destroy(&par->lock);
+    return status;
+}
+
 int main_coverage(int argc, char *argv[]) {
     int status = EXIT_SUCCESS;
 
-    int ret, tid = -1, old_tid = -1, pos, i, j;
+    int ret, tid = -1, old_tid = -1, pos, i;
 
     int max_depth = 1000000;
     int opt_min_baseQ = 0;
@@ -318,12 +693,13 @@ int main_coverage(int argc, char *argv[]) {
     bool opt_print_tabular = true;
     bool opt_print_histogram = false;
     bool opt_full_utf = true;
+    bool parallel = false;
 
     FILE *file_out = samtools_stdout;
 
     sam_global_args ga = SAM_GLOBAL_ARGS_INIT;
     static const struct option lopts[] = {
-        SAM_OPT_GLOBAL_OPTIONS('-', 0, '-', '-', 0, '-'),
+        SAM_OPT_GLOBAL_OPTIONS('-', 0, '-', '-', 0, '@'),
         {"rf", required_argument, NULL, 1}, // require flag
         {"ff", required_argument, NULL, 2}, // filter flag
         {"incl-flags", required_argument, NULL, 1}, // require flag
@@ -347,53 +723,53 @@ int main_coverage(int argc, char *argv[]) {
 
     // parse the command line
     int c;
-    opterr = 0;
-    while ((c = getopt_long(argc, argv, "Ao:l:q:Q:hHw:r:b:md:", lopts, NULL)) != -1) {
+    samtools_opterr = 0;
+    while ((c = samtools_getopt_long(argc, argv, "Ao:l:q:Q:hHw:r:b:md:@:", lopts, NULL)) != -1) {
         switch (c) {
             case 1:
-                if ((required_flags = bam_str2flag(optarg)) < 0) {
-                    fprintf(samtools_stderr,"Could not parse --rf %s\n", optarg); return EXIT_FAILURE;
+                if ((required_flags = bam_str2flag(samtools_optarg)) < 0) {
+                    fprintf(samtools_stderr,"Could not parse --rf %s\n", samtools_optarg); return EXIT_FAILURE;
                 }; break;
             case 2:
-                if ((fail_flags = bam_str2flag(optarg)) < 0) {
-                    fprintf(samtools_stderr,"Could not parse --ff %s\n", optarg); return EXIT_FAILURE;
+                if ((fail_flags = bam_str2flag(samtools_optarg)) < 0) {
+                    fprintf(samtools_stderr,"Could not parse --ff %s\n", samtools_optarg); return EXIT_FAILURE;
                 }; break;
-            case 'o': opt_output_file = optarg; opt_full_width = false; break;
-            case 'l': opt_min_len = atoi(optarg); break;
-            case 'q': opt_min_mapQ = atoi(optarg); break;
-            case 'Q': opt_min_baseQ = atoi(optarg); break;
-            case 'd': max_depth = atoi(optarg); break; // maximum coverage depth
-            case 'w': opt_n_bins = atoi(optarg); opt_full_width = false;
+            case 'o': opt_output_file = samtools_optarg; opt_full_width = false; break;
+            case 'l': opt_min_len = atoi(samtools_optarg); break;
+            case 'q': opt_min_mapQ = atoi(samtools_optarg); break;
+            case 'Q': opt_min_baseQ = atoi(samtools_optarg); break;
+            case 'd': max_depth = atoi(samtools_optarg); break; // maximum coverage depth
+            case 'w': opt_n_bins = atoi(samtools_optarg); opt_full_width = false;
                       opt_print_histogram = true; opt_print_tabular = false;
                       break;
-            case 'r': opt_reg = optarg; break;   // parsing a region requires a BAM header (strdup unnecessary)
-            case 'b': opt_file_list = optarg; break;
+            case 'r': opt_reg = samtools_optarg; break;   // parsing a region requires a BAM header (strdup unnecessary)
+            case 'b': opt_file_list = samtools_optarg; break;
             case 'm': opt_print_histogram = true; opt_print_tabular = false; break;
             case 'A': opt_full_utf = false;
                       opt_print_histogram = true; opt_print_tabular = false;
                       break;
             case 'H': opt_print_header = false; break;
             case 'h': return usage();
-            default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+            default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
                           /* else fall-through */
             case '?':
-                if (optopt != '?') {  // '-?' appeared on command line
-                    if (optopt) { // Bad short option
-                        print_error("coverage", "invalid option -- '%c'", optopt);
+                if (samtools_optopt != '?') {  // '-?' appeared on command line
+                    if (samtools_optopt) { // Bad short option
+                        print_error("coverage", "invalid option -- '%c'", samtools_optopt);
                     } else { // Bad long option
                         // Do our best.  There is no good solution to finding
                         // out what the bad option was.
                         // See, e.g. https://stackoverflow.com/questions/2723888/where-does-getopt-long-store-an-unrecognized-option
-                        if (optind > 0 && strncmp(argv[optind - 1], "--", 2) == 0) {
+                        if (samtools_optind > 0 && strncmp(argv[samtools_optind - 1], "--", 2) == 0) {
                             print_error("coverage", "unrecognised option '%s'",
-                                        argv[optind - 1]);
+                                        argv[samtools_optind - 1]);
                         }
                     }
                 }
                 return usage();
         }
     }
-    if (optind == argc && !opt_file_list)
+    if (samtools_optind == argc && !opt_file_list)
         return usage();
 
     // output file provided by user
@@ -441,11 +817,14 @@ int main_coverage(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
         argv = fn;
-        optind = 0;
+        samtools_optind = 0;
     } else {
-        n_bam_files = argc - optind; // the number of BAMs on the command line
+        n_bam_files = argc - samtools_optind; // the number of BAMs on the command line
     }
 
+    // Windows run in parallel need an index for each input
+    parallel = ga.nthreads >= 2 && !opt_reg;
+
     data = (bam_aux_t **)calloc(n_bam_files, sizeof(bam_aux_t*)); // data[i] for the i-th BAM file
     if (!data) {
         print_error_errno("coverage", "Failed to allocate memory");
@@ -454,31 +833,20 @@ int main_coverage(int argc, char *argv[]) {
     }
 
     for (i = 0; i < n_bam_files; ++i) {
-        int rf;
         data[i] = (bam_aux_t *) calloc(1, sizeof(bam_aux_t));
         if (!data[i]) {
             print_error_errno("coverage", "Failed to allocate memory");
             status = EXIT_FAILURE;
             goto coverage_end;
         }
-        data[i]->fp = sam_open_format(argv[optind+i], "r", &ga.in); // open BAM
+        data[i]->fp = sam_open_format(argv[samtools_optind+i], "r", &ga.in); // open BAM
 
         if (data[i]->fp == NULL) {
-            print_error_errno("coverage", "Could not open \"%s\"", argv[optind+i]);
-            status = EXIT_FAILURE;
-            goto coverage_end;
-        }
-        rf = SAM_FLAG | SAM_RNAME | SAM_POS | SAM_MAPQ | SAM_CIGAR | SAM_SEQ;
-        if (opt_min_baseQ) rf |= SAM_QUAL;
-
-        // Set CRAM options on file handle - returns 0 on success
-        if (hts_set_opt(data[i]->fp, CRAM_OPT_REQUIRED_FIELDS, rf)) {
-            print_error("coverage", "Failed to set CRAM_OPT_REQUIRED_FIELDS value");
+            print_error_errno("coverage", "Could not open \"%s\"", argv[samtools_optind+i]);
             status = EXIT_FAILURE;
             goto coverage_end;
         }
-        if (hts_set_opt(data[i]->fp, CRAM_OPT_DECODE_MD, 0)) {
-            print_error("coverage", "Failed to set CRAM_OPT_DECODE_MD value");
+        if (set_cram_opts(data[i]->fp, opt_min_baseQ) < 0) {
             status = EXIT_FAILURE;
             goto coverage_end;
         }
@@ -488,29 +856,37 @@ int main_coverage(int argc, char *argv[]) {
         data[i]->fail_flags = fail_flags;
         data[i]->required_flags = required_flags;
         if (data[i]->hdr == NULL) {
-            print_error_errno("coverage", "Could not read header for \"%s\"", argv[optind+i]);
+            print_error_errno("coverage", "Could not read header for \"%s\"", argv[samtools_optind+i]);
             status = EXIT_FAILURE;
             goto coverage_end;
         }
+        if (parallel && (strcmp(argv[samtools_optind+i], "-") == 0
+                         || !(data[i]->idx = sam_index_load3(data[i]->fp, argv[samtools_optind+i], NULL, HTS_IDX_SILENT_FAIL))))
+            parallel = false;
 
         // Lookup region if specified
         if (opt_reg) { // if a region is specified
-            hts_idx_t *idx = sam_index_load(data[i]->fp, argv[optind+i]);  // load the index
+            hts_idx_t *idx = sam_index_load(data[i]->fp, argv[samtools_optind+i]);  // load the index
             if (idx == NULL) {
-                print_error_errno("coverage", "Failed to load index for \"%s\"", argv[optind+i]);
+                print_error_errno("coverage", "Failed to load index for \"%s\"", argv[samtools_optind+i]);
                 status = EXIT_FAILURE;
                 goto coverage_end;
             }
             data[i]->iter = sam_itr_querys(idx, data[i]->hdr, opt_reg); // set the iterator
             hts_idx_destroy(idx); // the index is not needed any more; free the memory
             if (data[i]->iter == NULL) {
-                print_error("coverage", "Failed to parse region \"%s\". Check the region format or region name presence in the file \"%s\"", opt_reg, argv[optind+i]);
+                print_error("coverage", "Failed to parse region \"%s\". Check the region format or region name presence in the file \"%s\"", opt_reg, argv[samtools_optind+i]);
                 status = EXIT_FAILURE;
                 goto coverage_end;
             }
         }
     }
 
+    if (!parallel && ga.nthreads > 0) {
+        for (i = 0; i < n_bam_files; ++i)
+            hts_set_threads(data[i]->fp, ga.nthreads);
+    }
+
     if (opt_print_tabular && opt_print_header)
         fputs("#rname\tstartpos\tendpos\tnumreads\tcovbases\tcoverage\tmeandepth\tmeanbaseq\tmeanmapq\n", file_out);
 
@@ -540,7 +916,23 @@ int main_coverage(int argc, char *argv[]) {
     for (i=0; i<n_bam_files; i++)
         data[i]->stats = stats;
 
-    int64_t current_bin = 0;
+    if (parallel) {
+        coverage_parallel_t par = {
+            .data = data, .fn = &argv[samtools_optind], .in_fmt = &ga.in,
+            .n_files = n_bam_files, .stats = stats, .opt_n_bins = opt_n_bins,
+            .max_depth = max_depth, .min_baseQ = opt_min_baseQ,
+            .histogram = opt_print_histogram
+        };
+        for (i = 0; i < n_targets; ++i) {
+            stats[i].end = sam_hdr_tid2len(h, i);
+            n_bins = opt_n_bins > stats[i].end ? stats[i].end : opt_n_bins;
+            stats[i].bin_width = stats[i].end / (n_bins > 0 ? n_bins : 1);
+        }
+        if (coverage_parallel(&par, ga.nthreads, file_out, h, stats,
+                              opt_print_histogram, opt_print_tabular, opt_full_utf) < 0)
+            status = EXIT_FAILURE;
+        goto coverage_end;
+    }
 
     // the core multi-pileup loop
     mplp = bam_mplp_init(n_bam_files, read_bam, (void**)data); // initialization
@@ -588,34 +980,8 @@ int main_coverage(int argc, char *argv[]) {
         if (pos < stats[tid].beg || pos >= stats[tid].end) continue; // out of range; skip
         if (tid >= n_targets) continue;     // diff number of @SQ lines per file?
 
-        if (opt_print_histogram) {
-            current_bin = (pos - stats[tid].beg) / stats[tid].bin_width;
-        }
-
-        bool count_base = false;
-        for (i = 0; i < n_bam_files; ++i) { // base level filters have to go here
-            int depth_at_pos = n_plp[i];
-            for (j = 0; j < n_plp[i]; ++j) {
-                const bam_pileup1_t *p = plp[i] + j; // DON'T modify plp[][] unless you really know
-
-                if (p->is_del || p->is_refskip) --depth_at_pos; // having dels or refskips at tid:pos
-                else if (p->qpos < p->b->core.l_qseq &&
-                        bam_get_qual(p->b)[p->qpos] < opt_min_baseQ) --depth_at_pos; // low base quality
-                else
-                    stats[tid].summed_baseQ += bam_get_qual(p->b)[p->qpos];
-            }
-            if (depth_at_pos > 0) {
-                count_base = true;
-                stats[tid].summed_coverage += depth_at_pos;
-            }
-            // hist[current_bin] += depth_at_pos;  // Add counts to the histogram here to have one based on coverage
-            //fprintf(file_out, "\t%d", n_plp[i] - m); // this the depth to output
-        }
-        if (count_base) {
-            stats[tid].n_covered_bases++;
-            if (opt_print_histogram && current_bin < n_bins)
-                ++(hist[current_bin]); // Histogram based on breadth of coverage
-        }
+        count_position(&stats[tid], opt_print_histogram ? hist : NULL, n_bins,
+                       pos, n_bam_files, n_plp, plp, opt_min_baseQ);
     }
 
     if (tid == -1 && opt_reg && *opt_reg != '*')
@@ -665,6 +1031,7 @@ coverage_end:
             sam_hdr_destroy(data[i]->hdr);
             if (data[i]->fp) sam_close(data[i]->fp);
             hts_itr_destroy(data[i]->iter);
+            if (data[i]->idx) hts_idx_destroy(data[i]->idx);
             free(data[i]);
         }
         free(data);
@@ -43,7 +43,7 @@ typedef struct {
 /* Note that although the two matrics have 10 parameters in total, only 4
  * (probably 3) are free.  Changing the scoring matrices in a sort of symmetric
  * way will not change the result. */
-static score_param_t g_param = { {{0,0,0},{-4,1,6}}, {{0,-14000}, {0,0}} };
+static __thread score_param_t g_param = { {{0,0,0},{-4,1,6}}, {{0,-14000}, {0,0}} };
 
 typedef struct {
     int min_baseQ, tid, max_bases;
@@ -45,7 +45,7 @@ typedef struct {
 /* Note that although the two matrics have 10 parameters in total, only 4
  * (probably 3) are free.  Changing the scoring matrices in a sort of symmetric
  * way will not change the result. */
-static score_param_t g_param = { {{0,0,0},{-4,1,6}}, {{0,-14000}, {0,0}} };
+static __thread score_param_t g_param = { {{0,0,0},{-4,1,6}}, {{0,-14000}, {0,0}} };
 
 typedef struct {
     int min_baseQ, tid, max_bases;
@@ -187,14 +187,14 @@ int main_cut_target(int argc, char *argv[])
 
     memset(&g, 0, sizeof(ct_t));
     g.min_baseQ = 13; g.tid = -1;
-    while ((c = getopt_long(argc, argv, "f:Q:i:o:0:1:2:", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "f:Q:i:o:0:1:2:", lopts, NULL)) >= 0) {
         switch (c) {
-            case 'Q': g.min_baseQ = atoi(optarg); break; // quality cutoff
-            case 'i': g_param.p[0][1] = -atoi(optarg); break; // 0->1 transition (in) PENALTY
-            case '0': g_param.e[1][0] = atoi(optarg); break; // emission SCORE
-            case '1': g_param.e[1][1] = atoi(optarg); break;
-            case '2': g_param.e[1][2] = atoi(optarg); break;
-            default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+            case 'Q': g.min_baseQ = atoi(samtools_optarg); break; // quality cutoff
+            case 'i': g_param.p[0][1] = -atoi(samtools_optarg); break; // 0->1 transition (in) PENALTY
+            case '0': g_param.e[1][0] = atoi(samtools_optarg); break; // emission SCORE
+            case '1': g_param.e[1][1] = atoi(samtools_optarg); break;
+            case '2': g_param.e[1][2] = atoi(samtools_optarg); break;
+            default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
                       /* else fall-through */
             case '?': usage=1; break;
         }
@@ -203,21 +203,21 @@ int main_cut_target(int argc, char *argv[])
         g.fai = fai_load(ga.reference);
         if (g.fai == 0) fprintf(samtools_stderr, "[%s] fail to load the fasta index.\n", __func__);
     }
-    if (usage || argc == optind) {
+    if (usage || argc == samtools_optind) {
         fprintf(samtools_stderr, "Usage: samtools targetcut [-Q minQ] [-i inPen] [-0 em0] [-1 em1] [-2 em2] <in.bam>\n");
         sam_global_opt_help(samtools_stderr, "-.--f--.");
         return 1;
     }
     l = max_l = 0; cns = 0;
-    g.fp = sam_open_format(argv[optind], "r", &ga.in);
+    g.fp = sam_open_format(argv[samtools_optind], "r", &ga.in);
     if (g.fp == NULL) {
-        print_error_errno("targetcut", "can't open \"%s\"", argv[optind]);
+        print_error_errno("targetcut", "can't open \"%s\"", argv[samtools_optind]);
         return 1;
     }
 
     g.h = sam_hdr_read(g.fp);
     if (g.h == NULL) {
-        print_error("targetcut", "couldn't read header for \"%s\"", argv[optind]);
+        print_error("targetcut", "couldn't read header for \"%s\"", argv[samtools_optind]);
         sam_close(g.fp);
         return 1;
     }
@@ -241,7 +241,7 @@ int main_cut_target(int argc, char *argv[])
     process_cns(g.h, lasttid, l, cns);
 
     if (n < 0) {
-        print_error("targetcut", "error reading from \"%s\"", argv[optind]);
+        print_error("targetcut", "error reading from \"%s\"", argv[samtools_optind]);
         status = EXIT_FAILURE;
     }
 
@@ -152,15 +152,15 @@ int dict_main(int argc, char *argv[])
         {NULL, 0, NULL, 0}
     };
     int c;
-    while ( (c=getopt_long(argc,argv,"?AhHa:s:u:o:",loptions,NULL))>0 )
+    while ( (c=samtools_getopt_long(argc,argv,"?AhHa:s:u:o:",loptions,NULL))>0 )
     {
         switch (c)
         {
             case 'A': args->alias = 1; break;
-            case 'a': args->assembly = optarg; break;
-            case 's': args->species = optarg; break;
-            case 'u': args->uri = optarg; break;
-            case 'o': args->output_fname = optarg; break;
+            case 'a': args->assembly = samtools_optarg; break;
+            case 's': args->species = samtools_optarg; break;
+            case 'u': args->uri = samtools_optarg; break;
+            case 'o': args->output_fname = samtools_optarg; break;
             case 'H': args->header = 0; break;
             case 'h': return dict_usage();
             default: return dict_usage();
@@ -168,12 +168,12 @@ int dict_main(int argc, char *argv[])
     }
 
     char *fname = NULL;
-    if ( optind>=argc )
+    if ( samtools_optind>=argc )
     {
         if ( !isatty(STDIN_FILENO) ) fname = "-";  // reading from stdin
         else return dict_usage();
     }
-    else fname = argv[optind];
+    else fname = argv[samtools_optind];
 
     write_dict(fname, args);
     free(args);
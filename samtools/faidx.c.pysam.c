@@ -265,33 +265,33 @@ int faidx_core(int argc, char *argv[], enum fai_format_options format)
         { NULL, 0, NULL, 0 }
     };
 
-    while ((c = getopt_long(argc, argv, "ho:n:cr:fi", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "ho:n:cr:fi", lopts, NULL)) >= 0) {
         switch (c) {
-            case 'o': output_file = optarg; break;
-            case 'n': line_len = atoi(optarg);
+            case 'o': output_file = samtools_optarg; break;
+            case 'n': line_len = atoi(samtools_optarg);
                       if(line_len<1) {
-                        fprintf(samtools_stderr,"[faidx] bad line length '%s', using default:%d\n",optarg,DEFAULT_FASTA_LINE_LEN);
+                        fprintf(samtools_stderr,"[faidx] bad line length '%s', using default:%d\n",samtools_optarg,DEFAULT_FASTA_LINE_LEN);
                         line_len= DEFAULT_FASTA_LINE_LEN ;
                         }
                       break;
             case 'c': ignore_error = 1; break;
-            case 'r': region_file = optarg; break;
+            case 'r': region_file = samtools_optarg; break;
             case 'f': format = FAI_FASTQ; break;
             case 'i': rev = 1; break;
             case '?': return usage(samtools_stderr, format, EXIT_FAILURE);
             case 'h': return usage(samtools_stdout, format, EXIT_SUCCESS);
             case 1000:
-                if (strcmp(optarg, "no") == 0) {
+                if (strcmp(samtools_optarg, "no") == 0) {
                     pos_strand_name = neg_strand_name = "";
-                } else if (strcmp(optarg, "sign") == 0) {
+                } else if (strcmp(samtools_optarg, "sign") == 0) {
                     pos_strand_name = "(+)";
                     neg_strand_name = "(-)";
-                } else if (strcmp(optarg, "rc") == 0) {
+                } else if (strcmp(samtools_optarg, "rc") == 0) {
                     pos_strand_name = "";
                     neg_strand_name = "/rc";
-                } else if (strncmp(optarg, "custom,", 7) == 0) {
-                    size_t len = strlen(optarg + 7);
-                    size_t comma = strcspn(optarg + 7, ",");
+                } else if (strncmp(samtools_optarg, "custom,", 7) == 0) {
+                    size_t len = strlen(samtools_optarg + 7);
+                    size_t comma = strcspn(samtools_optarg + 7, ",");
                     free(strand_names);
                     strand_names = pos_strand_name = malloc(len + 2);
                     if (!strand_names) {
@@ -299,35 +299,35 @@ int faidx_core(int argc, char *argv[], enum fai_format_options format)
                         return EXIT_FAILURE;
                     }
                     neg_strand_name = pos_strand_name + comma + 1;
-                    memcpy(pos_strand_name, optarg + 7, comma);
+                    memcpy(pos_strand_name, samtools_optarg + 7, comma);
                     pos_strand_name[comma] = '\0';
                     if (comma < len)
-                        memcpy(neg_strand_name, optarg + 7 + comma + 1,
+                        memcpy(neg_strand_name, samtools_optarg + 7 + comma + 1,
                                len - comma);
                     neg_strand_name[len - comma] = '\0';
                 } else {
-                    fprintf(samtools_stderr, "[faidx] Unknown --mark-strand option \"%s\"\n", optarg);
+                    fprintf(samtools_stderr, "[faidx] Unknown --mark-strand option \"%s\"\n", samtools_optarg);
                     return usage(samtools_stderr, format, EXIT_FAILURE);
                 }
                 break;
-            case 1001: fai_name = optarg; break;
-            case 1002: gzi_name = optarg; break;
+            case 1001: fai_name = samtools_optarg; break;
+            case 1002: gzi_name = samtools_optarg; break;
             default:  break;
         }
     }
 
-    if ( argc==optind )
+    if ( argc==samtools_optind )
         return usage(samtools_stdout, format, EXIT_SUCCESS);
 
-    if (optind+1 == argc && !region_file) {
+    if (samtools_optind+1 == argc && !region_file) {
         if (output_file && !fai_name)
             fai_name = output_file;
 
-        if (fai_build3(argv[optind], fai_name, gzi_name) != 0) {
+        if (fai_build3(argv[samtools_optind], fai_name, gzi_name) != 0) {
             if (fai_name)
                 fprintf(samtools_stderr, "[faidx] Could not build fai index %s", fai_name);
             else
-                fprintf(samtools_stderr, "[faidx] Could not build fai index %s.fai", argv[optind]);
+                fprintf(samtools_stderr, "[faidx] Could not build fai index %s.fai", argv[samtools_optind]);
 
             if (gzi_name)
                 fprintf(samtools_stderr, " or compressed index %s\n", gzi_name);
@@ -340,13 +340,13 @@ int faidx_core(int argc, char *argv[], enum fai_format_options format)
         return 0;
     }
 
-    faidx_t *fai = fai_load3_format(argv[optind], fai_name, gzi_name, FAI_CREATE, format);
+    faidx_t *fai = fai_load3_format(argv[samtools_optind], fai_name, gzi_name, FAI_CREATE, format);
 
     if (!fai) {
         if (fai_name)
             fprintf(samtools_stderr, "[faidx] Could not load fai index %s", fai_name);
         else
-            fprintf(samtools_stderr, "[faidx] Could not build fai index %s.fai", argv[optind]);
+            fprintf(samtools_stderr, "[faidx] Could not build fai index %s.fai", argv[samtools_optind]);
 
         if (gzi_name)
             fprintf(samtools_stderr, " or compressed index %s\n", gzi_name);
@@ -358,7 +358,7 @@ int faidx_core(int argc, char *argv[], enum fai_format_options format)
 
     /** output file provided by user */
     if( output_file != NULL ) {
-        if( strcmp( output_file, argv[optind] ) == 0 ) {
+        if( strcmp( output_file, argv[samtools_optind] ) == 0 ) {
             fprintf(samtools_stderr,"[faidx] Same input/output : %s\n", output_file);
             return EXIT_FAILURE;
         }
@@ -388,8 +388,8 @@ int faidx_core(int argc, char *argv[], enum fai_format_options format)
         }
     }
 
-    while ( ++optind<argc && exit_status == EXIT_SUCCESS) {
-        exit_status = write_output(fai, file_out, argv[optind], ignore_error, line_len, rev, pos_strand_name, neg_strand_name, format);
+    while ( ++samtools_optind<argc && exit_status == EXIT_SUCCESS) {
+        exit_status = write_output(fai, file_out, argv[samtools_optind], ignore_error, line_len, rev, pos_strand_name, neg_strand_name, format);
     }
 
     fai_destroy(fai);
@@ -462,12 +462,12 @@ int main_pad2unpad(int argc, char *argv[])
 
     /* parse command-line options */
     strcpy(in_mode, "r"); strcpy(out_mode, "w");
-    while ((c = getopt_long(argc, argv, "SCso:u1T:?", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "SCso:u1T:?", lopts, NULL)) >= 0) {
         switch (c) {
         case 'S': break;
         case 'C': hts_parse_format(&ga.out, "cram"); break;
         case 's': assert(compress_level == -1); hts_parse_format(&ga.out, "sam"); break;
-        case 'o': fn_out = strdup(optarg); break;
+        case 'o': fn_out = strdup(samtools_optarg); break;
         case 'u':
             compress_level = 0;
             if (ga.out.format == unknown_format)
@@ -480,12 +480,12 @@ int main_pad2unpad(int argc, char *argv[])
             break;
         case 1: no_pg = 1; break;
         case '?': is_long_help = 1; break;
-        default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+        default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
             fprintf(samtools_stderr, "[bam_fillmd] unrecognized option '-%c'\n\n", c);
             return usage(is_long_help);
         }
     }
-    if (argc == optind) return usage(is_long_help);
+    if (argc == samtools_optind) return usage(is_long_help);
 
     strcat(out_mode, "h");
     if (compress_level >= 0) {
@@ -500,8 +500,8 @@ int main_pad2unpad(int argc, char *argv[])
         fai = fai_load3(ga.reference, fn_fai, NULL, FAI_CREATE);
     }
     // open file handlers
-    if ((in = sam_open_format(argv[optind], in_mode, &ga.in)) == 0) {
-        print_error_errno("depad", "failed to open \"%s\" for reading", argv[optind]);
+    if ((in = sam_open_format(argv[samtools_optind], in_mode, &ga.in)) == 0) {
+        print_error_errno("depad", "failed to open \"%s\" for reading", argv[samtools_optind]);
         ret = 1;
         goto depad_end;
     }
@@ -511,7 +511,7 @@ int main_pad2unpad(int argc, char *argv[])
         goto depad_end;
     }
     if ((h = sam_hdr_read(in)) == 0) {
-        fprintf(samtools_stderr, "[depad] failed to read the header from \"%s\".\n", argv[optind]);
+        fprintf(samtools_stderr, "[depad] failed to read the header from \"%s\".\n", argv[samtools_optind]);
         ret = 1;
         goto depad_end;
     }
@@ -608,25 +608,25 @@ int main_phase(int argc, char *argv[])
     memset(&g, 0, sizeof(phaseg_t));
     g.flag = FLAG_FIX_CHIMERA;
     g.min_varLOD = 37; g.k = 13; g.min_baseQ = 13; g.max_depth = 256;
-    while ((c = getopt_long(argc, argv, "Q:eFq:k:b:l:D:A", lopts, NULL)) >= 0) {
+    while ((c = samtools_getopt_long(argc, argv, "Q:eFq:k:b:l:D:A", lopts, NULL)) >= 0) {
         switch (c) {
-            case 'D': g.max_depth = atoi(optarg); break;
-            case 'q': g.min_varLOD = atoi(optarg); break;
-            case 'Q': g.min_baseQ = atoi(optarg); break;
-            case 'k': g.k = atoi(optarg); break;
+            case 'D': g.max_depth = atoi(samtools_optarg); break;
+            case 'q': g.min_varLOD = atoi(samtools_optarg); break;
+            case 'Q': g.min_baseQ = atoi(samtools_optarg); break;
+            case 'k': g.k = atoi(samtools_optarg); break;
             case 'F': g.flag &= ~FLAG_FIX_CHIMERA; break;
             case 'e': g.flag |= FLAG_LIST_EXCL; break;
             case 'A': g.flag |= FLAG_DROP_AMBI; break;
-            case 'b': g.pre = strdup(optarg); break;
-            case 'l': fn_list = strdup(optarg); break;
+            case 'b': g.pre = strdup(samtools_optarg); break;
+            case 'l': fn_list = strdup(samtools_optarg); break;
             case 1: g.no_pg = 1; break;
-            default:  if (parse_sam_global_opt(c, optarg, lopts, &ga) == 0) break;
+            default:  if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) == 0) break;
                       /* else fall-through */
             case '?': usage=1; break;
         }
         if (usage) break;
     }
-    if (usage || argc == optind) {
+    if (usage || argc == samtools_optind) {
         fprintf(samtools_stderr, "\n");
         fprintf(samtools_stderr, "Usage:   samtools phase [options] <in.bam>\n\n");
         fprintf(samtools_stderr, "Options: -k INT    block length [%d]\n", g.k);
@@ -645,15 +645,15 @@ int main_phase(int argc, char *argv[])
 
         return 1;
     }
-    g.fp = sam_open_format(argv[optind], "r", &ga.in);
+    g.fp = sam_open_format(argv[samtools_optind], "r", &ga.in);
     if (!g.fp) {
-        print_error_errno("phase", "Couldn't open '%s'", argv[optind]);
+        print_error_errno("phase", "Couldn't open '%s'", argv[samtools_optind]);
         return 1;
     }
     g.fp_hdr = sam_hdr_read(g.fp);
     if (g.fp_hdr == NULL) {
         fprintf(samtools_stderr, "[%s] Failed to read header for '%s'\n",
-                __func__, argv[optind]);
+                __func__, argv[samtools_optind]);
         return 1;
     }
     if (!g.no_pg && !(g.arg_list = stringify_argv(argc+1, argv-1))) {
@@ -790,7 +790,7 @@ int main_phase(int argc, char *argv[])
     }
 
     if (n < 0) {
-        print_error("phase", "error reading from '%s'", argv[optind]);
+        print_error("phase", "error reading from '%s'", argv[samtools_optind]);
         status = EXIT_FAILURE;
     }
 
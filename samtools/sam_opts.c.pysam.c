@@ -34,7 +34,7 @@ DEALINGS IN THE SOFTWARE.  */
 /*
  * Processes a standard "global" samtools long option.
  *
- * The 'c' value is the return value from a getopt_long() call.  It is checked
+ * The 'c' value is the return value from a samtools_getopt_long() call.  It is checked
  * against the lopt[] array to find the corresponding value as this may have
  * been reassigned by the individual subcommand.
  *
@@ -44,7 +44,7 @@ DEALINGS IN THE SOFTWARE.  */
  * Returns 0 on success,
  *        -1 on failure.
  */
-int parse_sam_global_opt(int c, const char *optarg, const struct option *lopt,
+int parse_sam_global_opt(int c, const char *samtools_optarg, const struct option *lopt,
                          sam_global_args *ga) {
     int r = 0;
 
@@ -55,19 +55,19 @@ int parse_sam_global_opt(int c, const char *optarg, const struct option *lopt,
         }
 
         if (strcmp(lopt->name, "input-fmt") == 0) {
-            r = hts_parse_format(&ga->in, optarg);
+            r = hts_parse_format(&ga->in, samtools_optarg);
             break;
         } else if (strcmp(lopt->name, "input-fmt-option") == 0) {
-            r = hts_opt_add((hts_opt **)&ga->in.specific, optarg);
+            r = hts_opt_add((hts_opt **)&ga->in.specific, samtools_optarg);
             break;
         } else if (strcmp(lopt->name, "output-fmt") == 0) {
-            r = hts_parse_format(&ga->out, optarg);
+            r = hts_parse_format(&ga->out, samtools_optarg);
             break;
         } else if (strcmp(lopt->name, "output-fmt-option") == 0) {
-            r = hts_opt_add((hts_opt **)&ga->out.specific, optarg);
+            r = hts_opt_add((hts_opt **)&ga->out.specific, samtools_optarg);
             break;
         } else if (strcmp(lopt->name, "reference") == 0) {
-            char *ref = malloc(10 + strlen(optarg) + 1);
+            char *ref = malloc(10 + strlen(samtools_optarg) + 1);
 
             if (!ref) {
                 fprintf(samtools_stderr, "Unable to allocate memory in "
@@ -76,9 +76,9 @@ int parse_sam_global_opt(int c, const char *optarg, const struct option *lopt,
                 return -1;
             }
 
-            sprintf(ref, "reference=%s", optarg);
+            sprintf(ref, "reference=%s", samtools_optarg);
 
-            if (!(ga->reference = strdup(optarg))) {
+            if (!(ga->reference = strdup(samtools_optarg))) {
                 fprintf(samtools_stderr, "Unable to allocate memory in "
                                 "parse_sam_global_opt.\n");
 
@@ -90,13 +90,13 @@ int parse_sam_global_opt(int c, const char *optarg, const struct option *lopt,
             free(ref);
             break;
         } else if (strcmp(lopt->name, "threads") == 0) {
-            ga->nthreads = atoi(optarg);
+            ga->nthreads = atoi(samtools_optarg);
             break;
         } else if (strcmp(lopt->name, "write-index") == 0) {
             ga->write_index = 1;
             break;
         } else if (strcmp(lopt->name, "verbosity") == 0) {
-            hts_verbose = atoi(optarg);
+            hts_verbose = atoi(samtools_optarg);
             break;
         }
     }
@@ -385,15 +385,15 @@ int main_samview(int argc, char *argv[])
     // Suppress complaints about '?' being an unrecognised option.  Without
     // this we have to put '?' in the options list, which makes it hard to
     // tell a bad long option from the use of '-?' (both return '?' and
-    // set optopt to '\0').
-    opterr = 0;
+    // set samtools_optopt to '\0').
+    samtools_opterr = 0;
 
-    while ((c = getopt_long(argc, argv,
+    while ((c = samtools_getopt_long(argc, argv,
                             "SbBcCt:h1Ho:O:q:f:F:G:ul:r:T:R:N:d:D:L:s:@:m:x:U:MXe:",
                             lopts, NULL)) >= 0) {
         switch (c) {
         case 's':
-            settings.subsam_seed = strtol(optarg, &q, 10);
+            settings.subsam_seed = strtol(samtools_optarg, &q, 10);
             if (q && *q == '.') {
                 settings.subsam_frac = strtod(q, &q);
                 if (*q) ret = 1;
@@ -402,89 +402,89 @@ int main_samview(int argc, char *argv[])
             }
 
             if (ret == 1) {
-                print_error("view", "Incorrect sampling argument \"%s\"", optarg);
+                print_error("view", "Incorrect sampling argument \"%s\"", samtools_optarg);
                 goto view_end;
             }
             break;
         case LONGOPT('s'):
-            settings.subsam_frac = strtod(optarg, &q);
+            settings.subsam_frac = strtod(samtools_optarg, &q);
             if (*q || settings.subsam_frac < 0.0 || settings.subsam_frac > 1.0) {
-                print_error("view", "Incorrect sampling argument \"%s\"", optarg);
+                print_error("view", "Incorrect sampling argument \"%s\"", samtools_optarg);
                 goto view_end;
             }
             break;
-        case LONGOPT('S'): settings.subsam_seed = atoi(optarg); break;
-        case 'm': settings.min_qlen = atoi(optarg); break;
+        case LONGOPT('S'): settings.subsam_seed = atoi(samtools_optarg); break;
+        case 'm': settings.min_qlen = atoi(samtools_optarg); break;
         case 'c': is_count = 1; break;
         case 'S': break;
         case 'b': out_format = "b"; break;
         case 'C': out_format = "c"; break;
-        case 't': fn_fai = strdup(optarg); break;
+        case 't': fn_fai = strdup(samtools_optarg); break;
         case 'h': is_header = 1; break;
         case 'H': is_header_only = 1; break;
         case LONGOPT('H'): is_header = is_header_only = 0; break;
-        case 'o': fn_out = strdup(optarg); break;
-        case 'U': fn_un_out = strdup(optarg); break;
+        case 'o': fn_out = strdup(samtools_optarg); break;
+        case 'U': fn_un_out = strdup(samtools_optarg); break;
         case 'X': has_index_file = 1; break;
-        case 'f': settings.flag_on |= bam_str2flag(optarg); break;
-        case 'F': settings.flag_off |= bam_str2flag(optarg); break;
-        case 'G': settings.flag_alloff |= bam_str2flag(optarg); break;
-        case 'q': settings.min_mapQ = atoi(optarg); break;
+        case 'f': settings.flag_on |= bam_str2flag(samtools_optarg); break;
+        case 'F': settings.flag_off |= bam_str2flag(samtools_optarg); break;
+        case 'G': settings.flag_alloff |= bam_str2flag(samtools_optarg); break;
+        case 'q': settings.min_mapQ = atoi(samtools_optarg); break;
         case 'u': compress_level = 0; break;
         case '1': compress_level = 1; break;
-        case 'l': settings.library = strdup(optarg); break;
+        case 'l': settings.library = strdup(samtools_optarg); break;
         case LONGOPT('L'):
             settings.multi_region = 1;
             // fall through
         case 'L':
-            if ((settings.bed = bed_read(optarg)) == NULL) {
-                print_error_errno("view", "Could not read file \"%s\"", optarg);
+            if ((settings.bed = bed_read(samtools_optarg)) == NULL) {
+                print_error_errno("view", "Could not read file \"%s\"", samtools_optarg);
                 ret = 1;
                 goto view_end;
             }
             break;
         case 'r':
-            if (add_read_group_single("view", &settings, optarg) != 0) {
+            if (add_read_group_single("view", &settings, samtools_optarg) != 0) {
                 ret = 1;
                 goto view_end;
             }
             break;
         case 'R':
-            if (add_read_groups_file("view", &settings, optarg) != 0) {
+            if (add_read_groups_file("view", &settings, samtools_optarg) != 0) {
                 ret = 1;
                 goto view_end;
             }
             break;
         case 'N':
-            if (add_read_names_file("view", &settings, optarg) != 0) {
+            if (add_read_names_file("view", &settings, samtools_optarg) != 0) {
                 ret = 1;
                 goto view_end;
             }
             break;
         case 'd':
-            if (strlen(optarg) < 2 || (strlen(optarg) > 2 && optarg[2] != ':')) {
-                print_error_errno("view", "Invalid \"tag:value\" option: \"%s\"", optarg);
+            if (strlen(samtools_optarg) < 2 || (strlen(samtools_optarg) > 2 && samtools_optarg[2] != ':')) {
+                print_error_errno("view", "Invalid \"tag:value\" option: \"%s\"", samtools_optarg);
                 ret = 1;
                 goto view_end;
             }
 
             if (settings.tag) {
-                if (settings.tag[0] != optarg[0] || settings.tag[1] != optarg[1]) {
-                    print_error("view", "Different tag \"%s\" was specified before: \"%s\"", settings.tag, optarg);
+                if (settings.tag[0] != samtools_optarg[0] || settings.tag[1] != samtools_optarg[1]) {
+                    print_error("view", "Different tag \"%s\" was specified before: \"%s\"", settings.tag, samtools_optarg);
                     ret = 1;
                     goto view_end;
                 }
             } else {
                 if (!(settings.tag = calloc(3, 1))) {
-                    print_error("view", "Could not allocate memory for tag: \"%s\"", optarg);
+                    print_error("view", "Could not allocate memory for tag: \"%s\"", samtools_optarg);
                     ret = 1;
                     goto view_end;
                 }
-                memcpy(settings.tag, optarg, 2);
+                memcpy(settings.tag, samtools_optarg, 2);
             }
 
-            if (strlen(optarg) > 3 && add_tag_value_single("view", &settings, optarg+3) != 0) {
-                print_error("view", "Could not add tag:value \"%s\"", optarg);
+            if (strlen(samtools_optarg) > 3 && add_tag_value_single("view", &settings, samtools_optarg+3) != 0) {
+                print_error("view", "Could not add tag:value \"%s\"", samtools_optarg);
                 ret = 1;
                 goto view_end;
             }
@@ -493,28 +493,28 @@ int main_samview(int argc, char *argv[])
             // Allow ";" as delimiter besides ":" to support MinGW CLI POSIX
             // path translation as described at:
             // http://www.mingw.org/wiki/Posix_path_conversion
-            if (strlen(optarg) < 4 || (optarg[2] != ':' && optarg[2] != ';')) {
-                print_error_errno("view", "Invalid \"tag:file\" option: \"%s\"", optarg);
+            if (strlen(samtools_optarg) < 4 || (samtools_optarg[2] != ':' && samtools_optarg[2] != ';')) {
+                print_error_errno("view", "Invalid \"tag:file\" option: \"%s\"", samtools_optarg);
                 ret = 1;
                 goto view_end;
             }
 
             if (settings.tag) {
-                if (settings.tag[0] != optarg[0] || settings.tag[1] != optarg[1]) {
-                    print_error("view", "Different tag \"%s\" was specified before: \"%s\"", settings.tag, optarg);
+                if (settings.tag[0] != samtools_optarg[0] || settings.tag[1] != samtools_optarg[1]) {
+                    print_error("view", "Different tag \"%s\" was specified before: \"%s\"", settings.tag, samtools_optarg);
                     ret = 1;
                     goto view_end;
                 }
             } else {
                 if (!(settings.tag = calloc(3, 1))) {
-                    print_error("view", "Could not allocate memory for tag: \"%s\"", optarg);
+                    print_error("view", "Could not allocate memory for tag: \"%s\"", samtools_optarg);
                     ret = 1;
                     goto view_end;
                 }
-                memcpy(settings.tag, optarg, 2);
+                memcpy(settings.tag, samtools_optarg, 2);
             }
 
-            if (add_tag_values_file("view", &settings, optarg+3) != 0) {
+            if (add_tag_values_file("view", &settings, samtools_optarg+3) != 0) {
                 ret = 1;
                 goto view_end;
             }
@@ -526,18 +526,18 @@ int main_samview(int argc, char *argv[])
         case LONGOPT('?'):
             return usage(samtools_stdout, EXIT_SUCCESS, 1);
         case '?':
-            if (optopt == '?') {  // '-?' appeared on command line
+            if (samtools_optopt == '?') {  // '-?' appeared on command line
                 return usage(samtools_stdout, EXIT_SUCCESS, 1);
             } else {
-                if (optopt) { // Bad short option
-                    print_error("view", "invalid option -- '%c'", optopt);
+                if (samtools_optopt) { // Bad short option
+                    print_error("view", "invalid option -- '%c'", samtools_optopt);
                 } else { // Bad long option
                     // Do our best.  There is no good solution to finding
                     // out what the bad option was.
                     // See, e.g. https://stackoverflow.com/questions/2723888/where-does-getopt-long-store-an-unrecognized-option
-                    if (optind > 0 && strncmp(argv[optind - 1], "--", 2) == 0) {
+                    if (samtools_optind > 0 && strncmp(argv[samtools_optind - 1], "--", 2) == 0) {
                         print_error("view", "unrecognised option '%s'",
-                                    argv[optind - 1]);
+                                    argv[samtools_optind - 1]);
                     }
                 }
                 return usage(samtools_stderr, EXIT_FAILURE, 0);
@@ -545,26 +545,26 @@ int main_samview(int argc, char *argv[])
         case 'B': settings.remove_B = 1; break;
         case 'x':
             {
-                if (strlen(optarg) != 2) {
+                if (strlen(samtools_optarg) != 2) {
                     print_error("main_samview", "Error parsing -x auxiliary tags should be exactly two characters long.");
                     return usage(samtools_stderr, EXIT_FAILURE, 0);
                 }
                 settings.remove_aux = (char**)realloc(settings.remove_aux, sizeof(char*) * (++settings.remove_aux_len));
-                settings.remove_aux[settings.remove_aux_len-1] = optarg;
+                settings.remove_aux[settings.remove_aux_len-1] = samtools_optarg;
             }
             break;
         case 'M': settings.multi_region = 1; break;
         case LONGOPT('P'): no_pg = 1; break;
         case 'e':
-            if (!(settings.filter = hts_filter_init(optarg))) {
+            if (!(settings.filter = hts_filter_init(samtools_optarg))) {
                 print_error("main_samview", "Couldn't initialise filter");
                 return 1;
             }
             break;
-        case LONGOPT('r'): settings.remove_flag |= bam_str2flag(optarg); break;
-        case LONGOPT('a'): settings.add_flag |= bam_str2flag(optarg); break;
+        case LONGOPT('r'): settings.remove_flag |= bam_str2flag(samtools_optarg); break;
+        case LONGOPT('a'): settings.add_flag |= bam_str2flag(samtools_optarg); break;
         default:
-            if (parse_sam_global_opt(c, optarg, lopts, &ga) != 0)
+            if (parse_sam_global_opt(c, samtools_optarg, lopts, &ga) != 0)
                 return usage(samtools_stderr, EXIT_FAILURE, 0);
             break;
         }
@@ -585,7 +585,7 @@ int main_samview(int argc, char *argv[])
         strcat(out_mode, tmp);
         strcat(out_un_mode, tmp);
     }
-    if (argc == optind && isatty(STDIN_FILENO)) {
+    if (argc == samtools_optind && isatty(STDIN_FILENO)) {
         print_error("view", "No input provided or missing option argument.");
         return usage(samtools_stderr, EXIT_FAILURE, 0); // potential memory leak...
     }
@@ -596,7 +596,7 @@ int main_samview(int argc, char *argv[])
         settings.subsam_seed = rand();
     }
 
-    fn_in = (optind < argc)? argv[optind] : "-";
+    fn_in = (samtools_optind < argc)? argv[samtools_optind] : "-";
     if ((in = sam_open_format(fn_in, "r", &ga.in)) == 0) {
         print_error_errno("view", "failed to open \"%s\" for reading", fn_in);
         ret = 1;
@@ -718,7 +718,7 @@ int main_samview(int argc, char *argv[])
     if (is_header_only) goto view_end; // no need to print alignments
 
     if (has_index_file) {
-        fn_idx_in = (optind+1 < argc)? argv[optind+1] : 0;
+        fn_idx_in = (samtools_optind+1 < argc)? argv[samtools_optind+1] : 0;
         if (fn_idx_in == 0) {
             fprintf(samtools_stderr, "[main_samview] incorrect number of arguments for -X option. Aborting.\n");
             return 1;
@@ -726,12 +726,12 @@ int main_samview(int argc, char *argv[])
     }
 
     if (settings.multi_region) {
-        if (!has_index_file && optind < argc - 1) { //regions have been specified in the command line
-            settings.bed = bed_hash_regions(settings.bed, argv, optind+1, argc, &filter_op); //insert(1) or filter out(0) the regions from the command line in the same hash table as the bed file
+        if (!has_index_file && samtools_optind < argc - 1) { //regions have been specified in the command line
+            settings.bed = bed_hash_regions(settings.bed, argv, samtools_optind+1, argc, &filter_op); //insert(1) or filter out(0) the regions from the command line in the same hash table as the bed file
             if (!filter_op)
                 filter_state = FILTERED;
-        } else if (has_index_file && optind < argc - 2) {
-            settings.bed = bed_hash_regions(settings.bed, argv, optind+2, argc, &filter_op); //insert(1) or filter out(0) the regions from the command line in the same hash table as the bed file
+        } else if (has_index_file && samtools_optind < argc - 2) {
+            settings.bed = bed_hash_regions(settings.bed, argv, samtools_optind+2, argc, &filter_op); //insert(1) or filter out(0) the regions from the command line in the same hash table as the bed file
             if (!filter_op)
                 filter_state = FILTERED;
         } else {
@@ -788,7 +788,7 @@ int main_samview(int argc, char *argv[])
         }
         bam_destroy1(b);
     } else {
-        if ((has_index_file && optind >= argc - 2) || (!has_index_file && optind >= argc - 1)) { // convert/print the entire file
+        if ((has_index_file && samtools_optind >= argc - 2) || (!has_index_file && samtools_optind >= argc - 1)) { // convert/print the entire file
             bam1_t *b = bam_init1();
             int r;
             errno = 0;
@@ -825,7 +825,7 @@ int main_samview(int argc, char *argv[])
             }
             b = bam_init1();
 
-            for (i = (has_index_file)? optind+2 : optind+1; i < argc; ++i) {
+            for (i = (has_index_file)? samtools_optind+2 : samtools_optind+1; i < argc; ++i) {
                 int result;
                 hts_itr_t *iter = sam_itr_querys(idx, header, argv[i]); // parse a region in the format like `chr2:100-200'
                 if (iter == NULL) { // region invalid or reference name not found
@@ -1,42 +1,44 @@
 #include <ctype.h>
+#include <errno.h>
 #include <assert.h>
 #include <unistd.h>
 #include <setjmp.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "samtools.pysam.h"
 
-FILE * samtools_stderr = NULL;
-FILE * samtools_stdout = NULL;
-const char * samtools_stdout_fn = NULL;
+__thread FILE * samtools_thread_stderr = NULL;
+__thread FILE * samtools_thread_stdout = NULL;
+__thread const char * samtools_stdout_fn = NULL;
 
 
 FILE * samtools_set_stderr(int fd)
 {
-  if (samtools_stderr != NULL)
-    fclose(samtools_stderr);
-  samtools_stderr = fdopen(fd, "w");
-  return samtools_stderr;
+  if (samtools_thread_stderr != NULL)
+    fclose(samtools_thread_stderr);
+  samtools_thread_stderr = fdopen(fd, "w");
+  return samtools_thread_stderr;
 }
 
 void samtools_close_stderr(void)
 {
-  fclose(samtools_stderr);
-  samtools_stderr = NULL;
+  fclose(samtools_thread_stderr);
+  samtools_thread_stderr = NULL;
 }
 
 FILE * samtools_set_stdout(int fd)
 {
-  if (samtools_stdout != NULL)
-    fclose(samtools_stdout);
-  samtools_stdout = fdopen(fd, "w");
-  if (samtools_stdout == NULL)
+  if (samtools_thread_stdout != NULL)
+    fclose(samtools_thread_stdout);
+  samtools_thread_stdout = fdopen(fd, "w");
+  if (samtools_thread_stdout == NULL)
     {
       fprintf(samtools_stderr, "could not set stdout to fd %i", fd);
     }
-  return samtools_stdout;
+  return samtools_thread_stdout;
 }
 
 void samtools_set_stdout_fn(const char *fn)
@@ -46,8 +48,8 @@ void samtools_set_stdout_fn(const char *fn)
 
 void samtools_close_stdout(void)
 {
-  fclose(samtools_stdout);
-  samtools_stdout = NULL;
+  fclose(samtools_thread_stdout);
+  samtools_thread_stdout = NULL;
 }
 
 int samtools_puts(const char *s)
@@ -57,8 +59,8 @@ int samtools_puts(const char *s)
 }
 
 
-static jmp_buf samtools_jmpbuf;
-static int samtools_status = 0;
+static __thread jmp_buf samtools_jmpbuf;
+static __thread int samtools_status = 0;
 
 int samtools_dispatch(int argc, char *argv[])
 {
@@ -74,16 +76,231 @@ void samtools_exit(int status)
   longjmp(samtools_jmpbuf, 1);
 }
 
+typedef struct {
+  void *(*start_routine)(void *);
+  void *arg;
+  FILE *err, *out;
+} samtools_thread_t;
+
+static void *samtools_thread_start(void *data)
+{
+  samtools_thread_t t = *(samtools_thread_t *)data;
+  free(data);
+  samtools_thread_stderr = t.err;
+  samtools_thread_stdout = t.out;
+  return t.start_routine(t.arg);
+}
+
+int samtools_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                           void *(*start_routine)(void *), void *arg)
+{
+  int ret;
+  samtools_thread_t *t = malloc(sizeof(samtools_thread_t));
+  if (t == NULL)
+    return EAGAIN;
+  t->start_routine = start_routine;
+  t->arg = arg;
+  t->err = samtools_thread_stderr;
+  t->out = samtools_thread_stdout;
+  if ((ret = pthread_create(thread, attr, samtools_thread_start, t)) != 0)
+    free(t);
+  return ret;
+}
+
+
+/* getopt and getopt_long with their state kept per thread.
+
+   Like the GNU versions, non-option arguments are moved behind the
+   options unless the option string starts with '+' or '-'.  Based on
+   the implementation in musl libc. */
+
+__thread char * samtools_optarg = NULL;
+__thread int samtools_optind = 1, samtools_opterr = 1, samtools_optopt = 0;
+
+// position within a group of short options such as -abc
+static __thread int samtools_optpos = 0;
 
 void samtools_set_optind(int val)
 {
-  // setting this in cython via 
-  // "from posix.unistd cimport optind"
-  // did not work.
-  //
   // setting to 0 forces a complete re-initialization
-  optind = val;
+  samtools_optind = val;
+  samtools_optpos = 0;
 }
 
+static void samtools_getopt_msg(const char *cmd, const char *msg,
+                                const char *opt, size_t l)
+{
+  fprintf(samtools_stderr, "%s%s%.*s\n", cmd, msg, (int)l, opt);
+}
+
+static int samtools_getopt_short(int argc, char * const argv[], const char *optstring)
+{
+  int i;
+  char c, *optchar;
+
+  if (samtools_optind >= argc || !argv[samtools_optind])
+    return -1;
+
+  if (argv[samtools_optind][0] != '-') {
+    if (optstring[0] == '-') {
+      samtools_optarg = argv[samtools_optind++];
+      return 1;
+    }
+    return -1;
+  }
+
+  if (!argv[samtools_optind][1])
+    return -1;
+
+  if (argv[samtools_optind][1] == '-' && !argv[samtools_optind][2])
+    return samtools_optind++, -1;
+
+  if (!samtools_optpos) samtools_optpos++;
+  optchar = argv[samtools_optind] + samtools_optpos;
+  c = *optchar;
+  samtools_optpos++;
 
+  if (!argv[samtools_optind][samtools_optpos]) {
+    samtools_optind++;
+    samtools_optpos = 0;
+  }
 
+  if (optstring[0] == '-' || optstring[0] == '+')
+    optstring++;
+
+  for (i = 0; optstring[i] && optstring[i] != c; i++)
+    ;
+
+  if (optstring[i] != c || c == ':') {
+    samtools_optopt = c;
+    if (optstring[0] != ':' && samtools_opterr)
+      samtools_getopt_msg(argv[0], ": unrecognized option: ", optchar, 1);
+    return '?';
+  }
+  if (optstring[i+1] == ':') {
+    samtools_optarg = NULL;
+    if (optstring[i+2] != ':' || samtools_optpos) {
+      samtools_optarg = argv[samtools_optind++] + samtools_optpos;
+      samtools_optpos = 0;
+    }
+    if (samtools_optind > argc) {
+      samtools_optopt = c;
+      if (optstring[0] == ':') return ':';
+      if (samtools_opterr)
+        samtools_getopt_msg(argv[0], ": option requires an argument: ", optchar, 1);
+      return '?';
+    }
+  }
+  return c;
+}
+
+static int samtools_getopt_long_core(int argc, char * const argv[], const char *optstring,
+                                     const struct option *longopts, int *idx)
+{
+  samtools_optarg = NULL;
+  if (longopts && argv[samtools_optind][0] == '-' &&
+      argv[samtools_optind][1] == '-' && argv[samtools_optind][2]) {
+    int colon = optstring[optstring[0] == '+' || optstring[0] == '-'] == ':';
+    int i, cnt, match = 0;
+    char *arg = NULL, *opt, *start = argv[samtools_optind] + 2;
+    for (cnt = i = 0; longopts[i].name; i++) {
+      const char *name = longopts[i].name;
+      opt = start;
+      while (*opt && *opt != '=' && *opt == *name)
+        name++, opt++;
+      if (*opt && *opt != '=') continue;
+      arg = opt;
+      match = i;
+      if (!*name) {
+        // exact match
+        cnt = 1;
+        break;
+      }
+      cnt++;
+    }
+    if (cnt == 1) {
+      i = match;
+      opt = arg;
+      samtools_optind++;
+      if (*opt == '=') {
+        if (!longopts[i].has_arg) {
+          samtools_optopt = longopts[i].val;
+          if (colon || !samtools_opterr)
+            return '?';
+          samtools_getopt_msg(argv[0], ": option does not take an argument: ",
+                             longopts[i].name, strlen(longopts[i].name));
+          return '?';
+        }
+        samtools_optarg = opt + 1;
+      } else if (longopts[i].has_arg == required_argument) {
+        if (!(samtools_optarg = argv[samtools_optind])) {
+          samtools_optopt = longopts[i].val;
+          if (colon) return ':';
+          if (!samtools_opterr) return '?';
+          samtools_getopt_msg(argv[0], ": option requires an argument: ",
+                             longopts[i].name, strlen(longopts[i].name));
+          return '?';
+        }
+        samtools_optind++;
+      }
+      if (idx) *idx = i;
+      if (longopts[i].flag) {
+        *longopts[i].flag = longopts[i].val;
+        return 0;
+      }
+      return longopts[i].val;
+    }
+    samtools_optopt = 0;
+    if (!colon && samtools_opterr)
+      samtools_getopt_msg(argv[0], cnt ? ": option is ambiguous: " : ": unrecognized option: ",
+                         start, strlen(start));
+    samtools_optind++;
+    return '?';
+  }
+  return samtools_getopt_short(argc, argv, optstring);
+}
+
+static void samtools_permute(char * const argv[], int dest, int src)
+{
+  char **av = (char **)argv;
+  char *tmp = av[src];
+  int i;
+  for (i = src; i > dest; i--)
+    av[i] = av[i-1];
+  av[dest] = tmp;
+}
+
+int samtools_getopt_long(int argc, char * const argv[], const char *optstring,
+                        const struct option *longopts, int *idx)
+{
+  int ret, skipped, resumed;
+  if (!samtools_optind) {
+    samtools_optpos = 0;
+    samtools_optind = 1;
+  }
+  if (samtools_optind >= argc || !argv[samtools_optind]) return -1;
+  skipped = samtools_optind;
+  if (optstring[0] != '+' && optstring[0] != '-') {
+    int i;
+    for (i = samtools_optind; ; i++) {
+      if (i >= argc || !argv[i]) return -1;
+      if (argv[i][0] == '-' && argv[i][1]) break;
+    }
+    samtools_optind = i;
+  }
+  resumed = samtools_optind;
+  ret = samtools_getopt_long_core(argc, argv, optstring, longopts, idx);
+  if (resumed > skipped) {
+    // move the options just read in front of the skipped arguments
+    int i, cnt = samtools_optind - resumed;
+    for (i = 0; i < cnt; i++)
+      samtools_permute(argv, skipped, samtools_optind - 1);
+    samtools_optind = skipped + cnt;
+  }
+  return ret;
+}
+
+int samtools_getopt(int argc, char * const argv[], const char *optstring)
+{
+  return samtools_getopt_long(argc, argv, optstring, NULL, NULL);
+}
@@ -2,12 +2,24 @@
 #define samtools_PYSAM_H
 
 #include <stdio.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
 
-extern FILE * samtools_stderr;
+/* The state of a command is kept per thread, so that commands can
+   run concurrently in different threads.  Threads not started by a
+   command, such as those of an htslib thread pool, have no streams
+   of their own and write to the process stderr and stdout. */
 
-extern FILE * samtools_stdout;
+extern __thread FILE * samtools_thread_stderr;
 
-extern const char * samtools_stdout_fn;
+extern __thread FILE * samtools_thread_stdout;
+
+#define samtools_stderr (samtools_thread_stderr ? samtools_thread_stderr : stderr)
+
+#define samtools_stdout (samtools_thread_stdout ? samtools_thread_stdout : stdout)
+
+extern __thread const char * samtools_stdout_fn;
 
 /*! set pysam standard error to point to file descriptor
 
@@ -42,8 +54,26 @@ int samtools_dispatch(int argc, char *argv[]);
 
 void samtools_exit(int status);
 
+/*! start a thread sharing the standard output and error of the
+  calling command.  The thread must return errors to the command
+  joining it, it cannot call exit().
+ */
+int samtools_pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                           void *(*start_routine)(void *), void *arg);
+
 void samtools_set_optind(int);
 
 extern int samtools_main(int argc, char *argv[]);
-  
+
+/* getopt keeps its state in globals, so commands call a copy
+   keeping it per thread instead. */
+
+extern __thread char * samtools_optarg;
+extern __thread int samtools_optind, samtools_opterr, samtools_optopt;
+
+int samtools_getopt(int argc, char * const argv[], const char *optstring);
+
+int samtools_getopt_long(int argc, char * const argv[], const char *optstring,
+                        const struct option *longopts, int *longindex);
+
 #endif
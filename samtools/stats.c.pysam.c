@@ -52,11 +52,14 @@ DEALINGS IN THE SOFTWARE.  */
 #include <getopt.h>
 #include <errno.h>
 #include <assert.h>
+#include <setjmp.h>
+#include <pthread.h>
 #include <zlib.h>   // for crc32
 #include <htslib/faidx.h>
 #include <htslib/sam.h>
 #include <htslib/hts.h>
 #include <htslib/hts_defs.h>
+#include <htslib/bgzf.h>
 #include <htslib/khash_str2int.h>
 #include "samtools.h"
 #include <htslib/khash.h>
@@ -117,6 +120,17 @@ typedef struct
 }
 regions_t;
 
+// A read behind the GC-depth bins of a parallel window, see replay_gcd()
+typedef struct
+{
+    int32_t tid;
+    int read_len;       // The unclipped length, which sizes the buffers
+    int readlen;        // The reference length, or -1 if not in a bin
+    hts_pos_t pos;
+    float gc;
+}
+gcd_read_t;
+
 typedef struct
 {
     uint64_t a;
@@ -162,6 +176,12 @@ typedef struct
     char *split_prefix;   // Path or string prefix for filenames created when splitting
     int remove_overlaps;
     int cov_threshold;
+
+    // Parallel windows: statistics of the reads starting in [win_beg,
+    // win_end) on win_tid, with the coverage of those positions only
+    int window;
+    int32_t win_tid;
+    hts_pos_t win_beg, win_end;
 }
 stats_info_t;
 
@@ -227,6 +247,12 @@ typedef struct
     int ncov;                       // The number of coverage bins
     uint64_t *cov;                  // The coverage frequencies
     round_buffer_t cov_rbuf;        // Pileup round buffer
+    hts_pos_t cov_beg, cov_end;     // The positions whose coverage is counted
+
+    // Parallel windows: the reads behind the GC-depth bins, in file order
+    gcd_read_t *gcd_reads;
+    size_t ngcd_reads, mgcd_reads;
+    int gcd_max_read_len;           // Longer reads can grow the buffers
 
     // Mismatches by read cycle
     uint8_t *rseq_buf;              // A buffer for reference sequence to check the mismatches against
@@ -368,6 +394,15 @@ static void round_buffer_insert_read(round_buffer_t *rbuf, hts_pos_t from, hts_p
         rbuf->buffer[ibuf]++;
 }
 
+// Adds [from, to) to the coverage, limited to the positions counted by stats
+static void insert_coverage(stats_t *stats, hts_pos_t from, hts_pos_t to)
+{
+    if ( from < stats->cov_beg ) from = stats->cov_beg;
+    if ( to > stats->cov_end ) to = stats->cov_end;
+    if ( from < to )
+        round_buffer_insert_read(&(stats->cov_rbuf), from, to);
+}
+
 // Calculate the number of bases in the read trimmed by BWA
 int bwa_trim_read(int trim_qual, uint8_t *quals, int len, int reverse)
 {
@@ -1027,7 +1062,7 @@ static void remove_overlaps(bam1_t *bam_line, khash_t(qn2pair) *read_pairs, stat
          (llabs(bam_line->core.isize) >= 2*bam_line->core.l_qseq) ||
          (order != READ_ORDER_FIRST && order != READ_ORDER_LAST) ) {
         if ( pmin >= 0 )
-            round_buffer_insert_read(&(stats->cov_rbuf), pmin, pmax);
+            insert_coverage(stats, pmin, pmax);
         return;
     }
 
@@ -1121,7 +1156,7 @@ static void remove_overlaps(bam1_t *bam_line, khash_t(qn2pair) *read_pairs, stat
                     break;
 
                 if ( pmin < pc->chunks[i].beg ) { //overlap at the beginning
-                    round_buffer_insert_read(&(stats->cov_rbuf), pmin, pc->chunks[i].beg);
+                    insert_coverage(stats, pmin, pc->chunks[i].beg);
                     pmin = pc->chunks[i].beg;
                 }
 
@@ -1135,7 +1170,138 @@ static void remove_overlaps(bam1_t *bam_line, khash_t(qn2pair) *read_pairs, stat
             }
         }
     }
-    round_buffer_insert_read(&(stats->cov_rbuf), pmin, pmax);
+    insert_coverage(stats, pmin, pmax);
+}
+
+/*
+ * Mismatches per cycle and GC-depth graph. For simplicity, reads overlapping GCD bins
+ *  are not splitted which results in up to seq_len-1 overlaps. The default bin size is
+ *  20kbp, so the effect is negligible.
+ *
+ * Adds a read at pos on tid, spanning readlen reference bases, to the GC-depth bins.
+ * Without a reference, gc is the GC content of the read.
+ */
+static void collect_gcd(stats_t *stats, int32_t tid, hts_pos_t pos, int readlen, float gc)
+{
+    if ( stats->info->fai )
+    {
+        int inc_ref = 0, inc_gcd = 0;
+        // First pass or new chromosome
+        if ( stats->rseq_pos==-1 || stats->tid != tid ) { inc_ref=1; inc_gcd=1; }
+        // Read goes beyond the end of the rseq buffer
+        else if ( stats->rseq_pos+stats->nrseq_buf < pos+readlen ) { inc_ref=1; inc_gcd=1; }
+        // Read overlaps the next gcd bin
+        else if ( stats->gcd_pos+stats->info->gcd_bin_size < pos+readlen )
+        {
+            inc_gcd = 1;
+            if ( stats->rseq_pos+stats->nrseq_buf < pos+stats->info->gcd_bin_size ) inc_ref = 1;
+        }
+        if ( inc_gcd )
+        {
+            stats->igcd++;
+            if ( stats->igcd >= stats->ngcd )
+                realloc_gcd_buffer(stats, readlen);
+            if ( inc_ref )
+                read_ref_seq(stats,tid,pos);
+            stats->gcd_pos = pos;
+            stats->gcd[ stats->igcd ].gc = fai_gc_content(stats, stats->gcd_pos, stats->info->gcd_bin_size);
+        }
+    }
+    // No reference and first pass, new chromosome or sequence going beyond the end of the gcd bin
+    else if ( stats->gcd_pos==-1 || stats->tid != tid || pos - stats->gcd_pos > stats->info->gcd_bin_size )
+    {
+        // First pass or a new chromosome
+        stats->tid     = tid;
+        stats->gcd_pos = pos;
+        stats->igcd++;
+        if ( stats->igcd >= stats->ngcd )
+            realloc_gcd_buffer(stats, readlen);
+    }
+    stats->gcd[ stats->igcd ].depth++;
+    // When no reference sequence is given, approximate the GC from the read (much shorter window, but otherwise OK)
+    if ( !stats->info->fai )
+        stats->gcd[ stats->igcd ].gc += gc;
+}
+
+// Records a read of a parallel window for replay_gcd()
+static gcd_read_t *log_gcd_read(stats_t *stats, int read_len)
+{
+    gcd_read_t *r;
+    if ( hts_resize(gcd_read_t, stats->ngcd_reads + 1, &stats->mgcd_reads, &stats->gcd_reads, 0) < 0 )
+        error("Could not allocate the GC-depth reads of a window\n");
+    r = &stats->gcd_reads[stats->ngcd_reads++];
+    r->tid = -1;
+    r->read_len = read_len;
+    r->readlen = -1;
+    r->pos = -1;
+    r->gc = 0;
+    if ( stats->gcd_max_read_len < read_len )
+        stats->gcd_max_read_len = read_len;
+    return r;
+}
+
+// Coverage distribution graph
+static void collect_coverage(bam1_t *bam_line, stats_t *stats, khash_t(qn2pair) *read_pairs)
+{
+    int i;
+    round_buffer_flush(stats,bam_line->core.pos);
+    if ( stats->regions ) {
+        hts_pos_t p = bam_line->core.pos, pnew, pmin = 0, pmax = 0;
+        uint32_t j = 0;
+        i = 0;
+        while ( j < bam_line->core.n_cigar && i < stats->nchunks ) {
+            int op = bam_cigar_op(bam_get_cigar(bam_line)[j]);
+            int oplen = bam_cigar_oplen(bam_get_cigar(bam_line)[j]);
+            switch(op) {
+            case BAM_CMATCH:
+            case BAM_CEQUAL:
+            case BAM_CDIFF:
+                pmin = MAX(p, stats->chunks[i].beg-1); // 0 based
+                pmax = MIN(p+oplen, stats->chunks[i].end); // 1 based
+                if ( pmax > pmin ) {
+                    if ( stats->info->remove_overlaps )
+                        remove_overlaps(bam_line, read_pairs, stats, pmin, pmax);
+                    else
+                        insert_coverage(stats, pmin, pmax);
+                }
+                break;
+            case BAM_CDEL:
+                break;
+            }
+            pnew = p + (bam_cigar_type(op)&2 ? oplen : 0); // consumes reference
+
+            if ( pnew >= stats->chunks[i].end ) {
+                // go to the next chunk
+                i++;
+            } else {
+                // go to the next CIGAR op
+                j++;
+                p = pnew;
+            }
+        }
+    } else {
+        hts_pos_t p = bam_line->core.pos;
+        uint32_t j;
+        for (j = 0; j < bam_line->core.n_cigar; j++) {
+            int op = bam_cigar_op(bam_get_cigar(bam_line)[j]);
+            int oplen = bam_cigar_oplen(bam_get_cigar(bam_line)[j]);
+            switch(op) {
+            case BAM_CMATCH:
+            case BAM_CEQUAL:
+            case BAM_CDIFF:
+                if ( stats->info->remove_overlaps )
+                    remove_overlaps(bam_line, read_pairs, stats, p, p+oplen);
+                else
+                    insert_coverage(stats, p, p+oplen);
+                break;
+            case BAM_CDEL:
+                break;
+            }
+            p += bam_cigar_type(op)&2 ? oplen : 0; // consumes reference
+        }
+    }
+    if ( stats->info->remove_overlaps )
+       remove_overlaps(bam_line, read_pairs, stats, -1LL, -1LL); //remove the line from the hash table
 }
 
 void collect_stats(bam1_t *bam_line, stats_t *stats, khash_t(qn2pair) *read_pairs)
@@ -1190,6 +1356,10 @@ void collect_stats(bam1_t *bam_line, stats_t *stats, khash_t(qn2pair) *read_pair
     int read_len = unclipped_length(bam_line);
     if ( read_len >= stats->nbases )
         realloc_buffers(stats,read_len);
+    // A window records the reads that can grow the buffers, see replay_gcd()
+    gcd_read_t *logged = NULL;
+    if ( stats->info->window && read_len > stats->gcd_max_read_len )
+        logged = log_gcd_read(stats, read_len);
     // Update max_len observed
     if ( stats->max_len<read_len )
         stats->max_len = read_len;
@@ -1322,109 +1492,223 @@ void collect_stats(bam1_t *bam_line, stats_t *stats, khash_t(qn2pair) *read_pair
             stats->last_read_flush = 0;
         }
 
-        // Mismatches per cycle and GC-depth graph. For simplicity, reads overlapping GCD bins
-        //  are not splitted which results in up to seq_len-1 overlaps. The default bin size is
-        //  20kbp, so the effect is negligible.
+        collect_gcd(stats, bam_line->core.tid, bam_line->core.pos, readlen, (float) gc_count / seq_len);
         if ( stats->info->fai )
-        {
-            int inc_ref = 0, inc_gcd = 0;
-            // First pass or new chromosome
-            if ( stats->rseq_pos==-1 || stats->tid != bam_line->core.tid ) { inc_ref=1; inc_gcd=1; }
-            // Read goes beyond the end of the rseq buffer
-            else if ( stats->rseq_pos+stats->nrseq_buf < bam_line->core.pos+readlen ) { inc_ref=1; inc_gcd=1; }
-            // Read overlaps the next gcd bin
-            else if ( stats->gcd_pos+stats->info->gcd_bin_size < bam_line->core.pos+readlen )
-            {
-                inc_gcd = 1;
-                if ( stats->rseq_pos+stats->nrseq_buf < bam_line->core.pos+stats->info->gcd_bin_size ) inc_ref = 1;
-            }
-            if ( inc_gcd )
-            {
-                stats->igcd++;
-                if ( stats->igcd >= stats->ngcd )
-                    realloc_gcd_buffer(stats, readlen);
-                if ( inc_ref )
-                    read_ref_seq(stats,bam_line->core.tid,bam_line->core.pos);
-                stats->gcd_pos = bam_line->core.pos;
-                stats->gcd[ stats->igcd ].gc = fai_gc_content(stats, stats->gcd_pos, stats->info->gcd_bin_size);
-            }
-
             count_mismatches_per_cycle(stats,bam_line,read_len);
-        }
-        // No reference and first pass, new chromosome or sequence going beyond the end of the gcd bin
-        else if ( stats->gcd_pos==-1 || stats->tid != bam_line->core.tid || bam_line->core.pos - stats->gcd_pos > stats->info->gcd_bin_size )
+        if ( stats->info->window )
         {
-            // First pass or a new chromosome
-            stats->tid     = bam_line->core.tid;
-            stats->gcd_pos = bam_line->core.pos;
-            stats->igcd++;
-            if ( stats->igcd >= stats->ngcd )
-                realloc_gcd_buffer(stats, readlen);
+            if ( !logged ) logged = log_gcd_read(stats, read_len);
+            logged->tid = bam_line->core.tid;
+            logged->pos = bam_line->core.pos;
+            logged->readlen = readlen;
+            logged->gc = (float) gc_count / seq_len;
         }
-        stats->gcd[ stats->igcd ].depth++;
-        // When no reference sequence is given, approximate the GC from the read (much shorter window, but otherwise OK)
-        if ( !stats->info->fai )
-            stats->gcd[ stats->igcd ].gc += (float) gc_count / seq_len;
-
-        // Coverage distribution graph
-        round_buffer_flush(stats,bam_line->core.pos);
-        if ( stats->regions ) {
-            hts_pos_t p = bam_line->core.pos, pnew, pmin = 0, pmax = 0;
-            uint32_t j = 0;
-            i = 0;
-            while ( j < bam_line->core.n_cigar && i < stats->nchunks ) {
-                int op = bam_cigar_op(bam_get_cigar(bam_line)[j]);
-                int oplen = bam_cigar_oplen(bam_get_cigar(bam_line)[j]);
-                switch(op) {
-                case BAM_CMATCH:
-                case BAM_CEQUAL:
-                case BAM_CDIFF:
-                    pmin = MAX(p, stats->chunks[i].beg-1); // 0 based
-                    pmax = MIN(p+oplen, stats->chunks[i].end); // 1 based
-                    if ( pmax > pmin ) {
-                        if ( stats->info->remove_overlaps )
-                            remove_overlaps(bam_line, read_pairs, stats, pmin, pmax);
-                        else
-                            round_buffer_insert_read(&(stats->cov_rbuf), pmin, pmax);
-                    }
-                    break;
-                case BAM_CDEL:
-                    break;
-                }
-                pnew = p + (bam_cigar_type(op)&2 ? oplen : 0); // consumes reference
 
-                if ( pnew >= stats->chunks[i].end ) {
-                    // go to the next chunk
-                    i++;
-                } else {
-                    // go to the next CIGAR op
-                    j++;
-                    p = pnew;
-                }
-            }
-        } else {
-            hts_pos_t p = bam_line->core.pos;
-            uint32_t j;
-            for (j = 0; j < bam_line->core.n_cigar; j++) {
-                int op = bam_cigar_op(bam_get_cigar(bam_line)[j]);
-                int oplen = bam_cigar_oplen(bam_get_cigar(bam_line)[j]);
-                switch(op) {
-                case BAM_CMATCH:
-                case BAM_CEQUAL:
-                case BAM_CDIFF:
-                    if ( stats->info->remove_overlaps )
-                        remove_overlaps(bam_line, read_pairs, stats, p, p+oplen);
-                    else
-                        round_buffer_insert_read(&(stats->cov_rbuf), p, p+oplen);
-                    break;
-                case BAM_CDEL:
-                    break;
-                }
-                p += bam_cigar_type(op)&2 ? oplen : 0; // consumes reference
-            }
+        collect_coverage(bam_line, stats, read_pairs);
+    }
+}
+
+// Merging of statistics collected from consecutive parts of a file
+static void merge_counts(uint64_t *to, const uint64_t *from, size_t n)
+{
+    size_t i;
+    for (i=0; i<n; i++)
+        to[i] += from[i];
+}
+
+static void merge_acgtno(acgtno_count_t *to, const acgtno_count_t *from, size_t n)
+{
+    size_t i;
+    for (i=0; i<n; i++)
+    {
+        to[i].a += from[i].a;
+        to[i].c += from[i].c;
+        to[i].g += from[i].g;
+        to[i].t += from[i].t;
+        to[i].n += from[i].n;
+        to[i].other += from[i].other;
+    }
+}
+
+static void merge_barcode_stats(stats_t *to, stats_t *from)
+{
+    uint32_t tag, i, nbases;
+
+    for (tag = 0; tag < from->ntags; tag++) {
+        barcode_info_t *to_bc = &to->tags_barcode[tag], *from_bc = &from->tags_barcode[tag];
+        if (!from_bc->nbases)
+            continue;
+
+        if (!to_bc->nbases) { // as in collect_barcode_stats()
+            uint32_t offset = 0;
+            for (i = 0; i < to->ntags; i++)
+                offset += to->tags_barcode[i].nbases;
+
+            to_bc->offset = offset;
+            to_bc->nbases = from_bc->nbases;
+            to->acgtno_barcode = realloc(to->acgtno_barcode, (offset + to_bc->nbases) * sizeof(acgtno_count_t));
+            to->quals_barcode  = realloc(to->quals_barcode, (offset + to_bc->nbases) * to->nquals * sizeof(uint64_t));
+
+            if (!to->acgtno_barcode || !to->quals_barcode)
+                error("Error allocating memory. Aborting!\n");
+
+            memset(to->acgtno_barcode + offset, 0, to_bc->nbases*sizeof(acgtno_count_t));
+            memset(to->quals_barcode + offset*to->nquals, 0, to_bc->nbases*to->nquals*sizeof(uint64_t));
         }
-        if ( stats->info->remove_overlaps )
-           remove_overlaps(bam_line, read_pairs, stats, -1LL, -1LL); //remove the line from the hash table
+
+        // Barcodes longer than the first one seen are not counted
+        nbases = from_bc->nbases < to_bc->nbases ? from_bc->nbases : to_bc->nbases;
+        merge_acgtno(to->acgtno_barcode + to_bc->offset, from->acgtno_barcode + from_bc->offset, nbases);
+        merge_counts(to->quals_barcode + to_bc->offset*to->nquals, from->quals_barcode + from_bc->offset*from->nquals, (size_t)nbases*to->nquals);
+        if (to_bc->tag_sep < 0)
+            to_bc->tag_sep = from_bc->tag_sep;
+        if (to_bc->max_qual < from_bc->max_qual)
+            to_bc->max_qual = from_bc->max_qual;
+    }
+    to->error_number += from->error_number;
+}
+
+/*
+ * Adds the coverage of a read starting before the window of stats, if
+ * collect_stats() would count it, and nothing else.  The overlaps with
+ * its mate are taken off the mapped bases by the window it starts in.
+ */
+static void collect_window_coverage(bam1_t *bam_line, stats_t *stats, khash_t(qn2pair) *read_pairs)
+{
+    if ( !is_in_regions(bam_line,stats) )
+        return;
+    if ( stats->rg_hash )
+    {
+        const uint8_t *rg = bam_aux_get(bam_line, "RG");
+        if ( !rg ) return;
+        if ( !khash_str2int_has_key(stats->rg_hash, (const char*)(rg + 1)) ) return;
+    }
+    if ( stats->info->flag_require && (bam_line->core.flag & stats->info->flag_require)!=stats->info->flag_require )
+        return;
+    if ( stats->info->flag_filter && (bam_line->core.flag & stats->info->flag_filter) )
+        return;
+    if ( stats->info->filter_readlen!=-1 && bam_line->core.l_qseq!=stats->info->filter_readlen )
+        return;
+    if ( (bam_line->core.flag & BAM_FSECONDARY) || !bam_line->core.l_qseq || IS_UNMAPPED(bam_line) )
+        return;
+    if ( !stats->is_sorted )
+        return;
+
+    // The round buffer must hold the read
+    int read_len = unclipped_length(bam_line);
+    if ( read_len >= stats->nbases )
+        realloc_buffers(stats,read_len);
+
+    uint64_t nbases_mapped_cigar = stats->nbases_mapped_cigar;
+    collect_coverage(bam_line, stats, read_pairs);
+    stats->nbases_mapped_cigar = nbases_mapped_cigar;
+}
+
+/*
+ * Adds the statistics of a parallel window in from to those in to.  The
+ * coverage of from is that of its own positions only, so the round
+ * buffer is flushed in full; the GC-depth bins are left to replay_gcd().
+ * Target regions, and thus target_count, are assumed to be the same for
+ * both.
+ */
+static void merge_stats(stats_t *to, stats_t *from)
+{
+    int isize;
+
+    if ( from->nbases > to->nbases )
+        realloc_buffers(to, from->nbases);
+
+    merge_counts(to->quals_1st, from->quals_1st, (size_t)from->nbases*from->nquals);
+    merge_counts(to->quals_2nd, from->quals_2nd, (size_t)from->nbases*from->nquals);
+    if ( to->mpc_buf && from->mpc_buf )
+        merge_counts(to->mpc_buf, from->mpc_buf, (size_t)from->nbases*from->nquals);
+    merge_counts(to->gc_1st, from->gc_1st, from->ngc);
+    merge_counts(to->gc_2nd, from->gc_2nd, from->ngc);
+    merge_acgtno(to->acgtno_cycles_1st, from->acgtno_cycles_1st, from->nbases);
+    merge_acgtno(to->acgtno_cycles_2nd, from->acgtno_cycles_2nd, from->nbases);
+    merge_acgtno(to->acgtno_revcomp, from->acgtno_revcomp, from->nbases);
+    merge_counts(to->read_lengths, from->read_lengths, from->nbases);
+    merge_counts(to->read_lengths_1st, from->read_lengths_1st, from->nbases);
+    merge_counts(to->read_lengths_2nd, from->read_lengths_2nd, from->nbases);
+    merge_counts(to->insertions, from->insertions, from->nbases);
+    merge_counts(to->deletions, from->deletions, from->nbases);
+    merge_counts(to->ins_cycles_1st, from->ins_cycles_1st, from->nbases+1);
+    merge_counts(to->ins_cycles_2nd, from->ins_cycles_2nd, from->nbases+1);
+    merge_counts(to->del_cycles_1st, from->del_cycles_1st, from->nbases+1);
+    merge_counts(to->del_cycles_2nd, from->del_cycles_2nd, from->nbases+1);
+
+    for (isize=0; isize<from->isize->nitems(from->isize->data); isize++)
+    {
+        uint64_t n;
+        if ( (n = from->isize->inward(from->isize->data, isize)) )
+            to->isize->set_inward(to->isize->data, isize, to->isize->inward(to->isize->data, isize) + n);
+        if ( (n = from->isize->outward(from->isize->data, isize)) )
+            to->isize->set_outward(to->isize->data, isize, to->isize->outward(to->isize->data, isize) + n);
+        if ( (n = from->isize->other(from->isize->data, isize)) )
+            to->isize->set_other(to->isize->data, isize, to->isize->other(to->isize->data, isize) + n);
+    }
+
+    if ( to->max_len < from->max_len ) to->max_len = from->max_len;
+    if ( to->max_len_1st < from->max_len_1st ) to->max_len_1st = from->max_len_1st;
+    if ( to->max_len_2nd < from->max_len_2nd ) to->max_len_2nd = from->max_len_2nd;
+    if ( to->max_qual < from->max_qual ) to->max_qual = from->max_qual;
+    to->is_sorted = to->is_sorted && from->is_sorted;
+
+    to->total_len += from->total_len;
+    to->total_len_1st += from->total_len_1st;
+    to->total_len_2nd += from->total_len_2nd;
+    to->total_len_dup += from->total_len_dup;
+    to->nreads_1st += from->nreads_1st;
+    to->nreads_2nd += from->nreads_2nd;
+    to->nreads_other += from->nreads_other;
+    to->nreads_filtered += from->nreads_filtered;
+    to->nreads_dup += from->nreads_dup;
+    to->nreads_unmapped += from->nreads_unmapped;
+    to->nreads_single_mapped += from->nreads_single_mapped;
+    to->nreads_paired_and_mapped += from->nreads_paired_and_mapped;
+    to->nreads_properly_paired += from->nreads_properly_paired;
+    to->nreads_paired_tech += from->nreads_paired_tech;
+    to->nreads_anomalous += from->nreads_anomalous;
+    to->nreads_mq0 += from->nreads_mq0;
+    to->nbases_mapped += from->nbases_mapped;
+    to->nbases_mapped_cigar += from->nbases_mapped_cigar;
+    to->nbases_trimmed += from->nbases_trimmed;
+    to->nmismatches += from->nmismatches;
+    to->nreads_QCfailed += from->nreads_QCfailed;
+    to->nreads_secondary += from->nreads_secondary;
+    to->nreads_supplementary += from->nreads_supplementary;
+    to->sum_qual += from->sum_qual;
+
+    // The checksums are sums of the CRC32 of each read
+    to->checksum.names += from->checksum.names;
+    to->checksum.reads += from->checksum.reads;
+    to->checksum.quals += from->checksum.quals;
+
+    // The GC-depth bins are left to replay_gcd()
+
+    round_buffer_flush(from, -1);
+    merge_counts(to->cov, from->cov, from->ncov);
+
+    merge_barcode_stats(to, from);
+}
+
+/*
+ * A GC-depth bin starts where the bin before it ends, and with a
+ * reference also where the reference buffer, sized by the longest read
+ * so far, runs out.  So the bins of the windows are made again from
+ * their reads, which are replayed into to in file order.  to only holds
+ * the bins, it sees the same reads as the statistics of a single pass.
+ */
+static void replay_gcd(stats_t *to, stats_t *from)
+{
+    size_t i;
+    for (i = 0; i < from->ngcd_reads; i++)
+    {
+        gcd_read_t *r = &from->gcd_reads[i];
+        if ( r->read_len >= to->nbases )
+            realloc_buffers(to, r->read_len);
+        if ( r->readlen >= 0 )
+            collect_gcd(to, r->tid, r->pos, r->readlen, r->gc);
     }
 }
 
@@ -2053,6 +2337,9 @@ void init_group_id(stats_t *stats, const char *id)
 }
 
 
+// Set while stats_window_run() reads a window, error() returns there
+static __thread jmp_buf *part_error_jmp = NULL;
+
 static void HTS_NORETURN error(const char *format, ...)
 {
     if ( !format )
@@ -2090,6 +2377,8 @@ static void HTS_NORETURN error(const char *format, ...)
         va_start(ap, format);
         vfprintf(samtools_stderr, format, ap);
         va_end(ap);
+        if ( part_error_jmp )
+            longjmp(*part_error_jmp, 1);
     }
     samtools_exit(1);
 }
@@ -2108,6 +2397,7 @@ void cleanup_stats(stats_t* stats)
     stats->isize->isize_free(stats->isize->data);
     free(stats->isize);
     free(stats->gcd);
+    free(stats->gcd_reads);
     free(stats->rseq_buf);
     free(stats->mpc_buf);
     free(stats->acgtno_cycles_1st);
@@ -2236,6 +2526,8 @@ stats_t* stats_init()
     stats->last_pair_tid = -2;
     stats->last_read_flush = 0;
     stats->target_count = 0;
+    stats->cov_end = HTS_POS_MAX;
+    stats->gcd_max_read_len = stats->nbases - 1;
 
     return stats;
 }
@@ -2258,6 +2550,14 @@ static void init_stat_structs(stats_t* stats, stats_info_t* info, const char* gr
     // This saves us having to pass the stats_info_t to every function
     stats->info = info;
 
+    // A window starts within a contig, with reads before it for coverage
+    if ( info->window )
+    {
+        stats->tid = stats->last_pair_tid = info->win_tid;
+        stats->cov_beg = info->win_beg;
+        stats->cov_end = info->win_end;
+    }
+
     // Init structures
     //  .. coverage bins and round buffer
     if ( info->cov_step > info->cov_max - info->cov_min + 1 )
@@ -2327,14 +2627,10 @@ static void init_stat_structs(stats_t* stats, stats_info_t* info, const char* gr
     error("Out of memory");
 }
 
-static stats_t* get_curr_split_stats(bam1_t* bam_line, khash_t(c2stats)* split_hash, stats_info_t* info, char* targets)
+static stats_t* get_split_stats(const char* name, khash_t(c2stats)* split_hash, stats_info_t* info, char* targets)
 {
     stats_t *curr_stats = NULL;
-    const uint8_t *tag_val = bam_aux_get(bam_line, info->split_tag);
-    if(tag_val == 0){
-        error("Tag '%s' not found in bam_line.\n", info->split_tag);
-    }
-    char* split_name = strdup(bam_aux2Z(tag_val));
+    char* split_name = strdup(name);
 
     // New stats object, under split
     khiter_t k = kh_get(c2stats, split_hash, split_name);
@@ -2361,12 +2657,369 @@ static stats_t* get_curr_split_stats(bam1_t* bam_line, khash_t(c2stats)* split_h
     return curr_stats;
 }
 
+static stats_t* get_curr_split_stats(bam1_t* bam_line, khash_t(c2stats)* split_hash, stats_info_t* info, char* targets)
+{
+    const uint8_t *tag_val = bam_aux_get(bam_line, info->split_tag);
+    if(tag_val == 0){
+        error("Tag '%s' not found in bam_line.\n", info->split_tag);
+    }
+    return get_split_stats(bam_aux2Z(tag_val), split_hash, info, targets);
+}
+
+/*
+ * Parallel statistics of a coordinate sorted, indexed BAM file.  The
+ * contigs are cut into windows of about the same number of reads, as
+ * depth and coverage do, and the unplaced reads make a window of their
+ * own.  Worker threads collect the statistics of each window on their
+ * own, and the main thread merges them in file order.  A window counts
+ * the reads starting in it, and the coverage of its positions, which
+ * needs the reads starting before it too.  The GC-depth bins are made
+ * again from the reads of the windows, see replay_gcd(), so the result
+ * is the same as reading the whole file in one go.
+ */
+
+// At most this many reads per window, and a few windows per thread
+#define STATS_WINDOW_READS (1 << 20)
+#define STATS_WINDOW_MIN   (1 << 8)
+#define STATS_WINDOWS_PER_THREAD 4
+
+typedef struct {
+    int tid;                // HTS_IDX_NOCOOR for the unplaced reads
+    hts_pos_t beg, end;
+    stats_t *stats;
+    khash_t(c2stats) *split_hash;
+    int status;             // 1 when done, -1 on failure
+} stats_window_t;
+
+typedef struct {
+    stats_info_t *info;
+    const char *fname;
+    const htsFormat *in_fmt;
+    const char *ref_fname;
+    char *targets;
+    hts_idx_t *idx;         // shared, only queried
+    stats_window_t *win;
+    int n_win, next, n_merged, max_ahead, stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} stats_parallel_t;
+
+typedef struct {
+    stats_parallel_t *par;
+    stats_info_t info;      // a copy with a reference of its own
+    samFile *fp;
+    sam_hdr_t *hdr;
+    bam1_t *bam_line;
+} stats_worker_t;
+
+// Collects the statistics of a window into win->stats and win->split_hash
+static int stats_window_run(stats_worker_t *w, stats_window_t *win)
+{
+    stats_parallel_t *par = w->par;
+    khash_t(qn2pair) *read_pairs = NULL;
+    hts_itr_t *iter = NULL;
+    jmp_buf on_error;
+    int ret = -1, r;
+
+    w->info.window = 1;
+    w->info.win_tid = win->tid == HTS_IDX_NOCOOR ? -1 : win->tid;
+    w->info.win_beg = win->beg;
+    w->info.win_end = win->end;
+    if (!(win->stats = stats_init()) || !(win->split_hash = kh_init(c2stats))
+        || !(read_pairs = kh_init(qn2pair))) {
+        print_error("stats", "Out of memory");
+        goto fail;
+    }
+    if (!(iter = sam_itr_queryi(par->idx, win->tid, win->beg, win->end))) {
+        print_error("stats", "failed to query the index of \"%s\"", par->fname);
+        goto fail;
+    }
+
+    // the thread cannot samtools_exit(), errors end the window instead
+    if (setjmp(on_error))
+        goto fail;
+    part_error_jmp = &on_error;
+
+    init_stat_structs(win->stats, &w->info, NULL, par->targets);
+    while ((r = sam_itr_next(w->fp, iter, w->bam_line)) >= 0) {
+        bam1_t *b = w->bam_line;
+        // reads starting before the window only add to its coverage
+        int cov_only = b->core.tid >= 0 && b->core.pos < win->beg;
+        if (w->info.split_tag) {
+            stats_t *curr_stats = get_curr_split_stats(b, win->split_hash, &w->info, par->targets);
+            if (cov_only)
+                collect_window_coverage(b, curr_stats, read_pairs);
+            else
+                collect_stats(b, curr_stats, read_pairs);
+        }
+        if (cov_only)
+            collect_window_coverage(b, win->stats, read_pairs);
+        else
+            collect_stats(b, win->stats, read_pairs);
+    }
+    if (r < -1)
+        goto fail;
+    ret = 0;
+
+ fail:
+    part_error_jmp = NULL;
+    if (read_pairs) cleanup_overlaps(read_pairs, INT64_MAX);
+    if (iter) hts_itr_destroy(iter);
+    return ret;
+}
+
+static void *stats_worker(void *data)
+{
+    stats_worker_t *w = (stats_worker_t *)data;
+    stats_parallel_t *par = w->par;
+    int failed = 0;
+
+    // faidx_t is not thread safe, each worker needs its own
+    w->info = *par->info;
+    w->info.sam = NULL;
+    w->info.fai = NULL;
+    if (par->ref_fname && !(w->info.fai = fai_load(par->ref_fname))) {
+        print_error("stats", "could not load faidx: %s", par->ref_fname);
+        failed = 1;
+    } else if (!(w->fp = sam_open_format(par->fname, "r", par->in_fmt))
+               || !(w->hdr = sam_hdr_read(w->fp))) {
+        print_error_errno("stats", "failed to open \"%s\"", par->fname);
+        failed = 1;
+    } else if (!(w->bam_line = bam_init1())) {
+        print_error("stats", "Out of memory");
+        failed = 1;
+    }
+
+    for (;;) {
+        int k, ret;
+
+        // Keep at most max_ahead windows waiting to be merged
+        pthread_mutex_lock(&par->lock);
+        while (!par->stop && par->next < par->n_win
+               && par->next >= par->n_merged + par->max_ahead)
+            pthread_cond_wait(&par->cond, &par->lock);
+        if (par->stop || par->next >= par->n_win) {
+            pthread_mutex_unlock(&par->lock);
+            break;
+        }
+        k = par->next++;
+        pthread_mutex_unlock(&par->lock);
+
+        ret = failed ? -1 : stats_window_run(w, &par->win[k]);
+
+        pthread_mutex_lock(&par->lock);
+        par->win[k].status = ret < 0 ? -1 : 1;
+        pthread_cond_broadcast(&par->cond);
+        pthread_mutex_unlock(&par->lock);
+    }
+
+    if (w->bam_line) bam_destroy1(w->bam_line);
+    if (w->hdr) sam_hdr_destroy(w->hdr);
+    if (w->fp) sam_close(w->fp);
+    if (w->info.fai) fai_destroy(w->info.fai);
+    return NULL;
+}
+
+static void stats_window_free(stats_window_t *win)
+{
+    if (win->stats) cleanup_stats(win->stats);
+    destroy_split_stats(win->split_hash);
+    win->stats = NULL;
+    win->split_hash = NULL;
+}
+
+static int contig_has_reads(hts_idx_t *idx, int tid)
+{
+    uint64_t mapped, unmapped;
+    return hts_idx_get_stat(idx, tid, &mapped, &unmapped) < 0
+        || mapped + unmapped > 0;
+}
+
+/*
+ * Collects the statistics of the whole file into all_stats and
+ * split_hash in windows on n_threads worker threads, if the file is an
+ * indexed BAM file.  Returns 1 if the file cannot be split, otherwise 0
+ * for success or -1 on errors.
+ */
+static int stats_parallel(stats_t *all_stats, khash_t(c2stats) *split_hash,
+                          stats_info_t *info, const char *bam_fname,
+                          const char *bam_idx_fname, const htsFormat *in_fmt,
+                          const char *ref_fname, char *targets, int n_threads)
+{
+    stats_parallel_t par = { info, bam_fname, in_fmt, ref_fname, targets };
+    int k, t, nref = sam_hdr_nref(info->sam_header), n_started = 0, m_win = 0;
+    int use_len = 1, ret = -1;
+    uint64_t *weight = NULL, total = 0, per_window, mapped, unmapped;
+    stats_t *all_gcd = NULL;
+    khash_t(c2stats) *split_gcd = NULL;
+    stats_worker_t *w = NULL;
+    pthread_t *tids = NULL;
+    khiter_t i;
+
+    if (n_threads < 2 || nref == 0 || strcmp(bam_fname, "-") == 0
+        || hts_get_format(info->sam)->format != bam)
+        return 1;
+    if (!(par.idx = sam_index_load3(info->sam, bam_fname, bam_idx_fname, HTS_IDX_SILENT_FAIL)))
+        return 1;
+
+    // Reads per contig from the index, or lengths if there are no counts.
+    // Contigs without reads have no counts either.
+    if (!(weight = calloc(nref, sizeof(uint64_t))))
+        goto mem_fail;
+    for (t = 0; t < nref; t++) {
+        if (hts_idx_get_stat(par.idx, t, &mapped, &unmapped) == 0) {
+            weight[t] = mapped + unmapped;
+            use_len = 0;
+        }
+    }
+    for (t = 0; t < nref; t++) {
+        if (use_len)
+            weight[t] = sam_hdr_tid2len(info->sam_header, t);
+        total += weight[t];
+    }
+
+    per_window = total / ((uint64_t)n_threads * STATS_WINDOWS_PER_THREAD);
+    if (per_window > STATS_WINDOW_READS && !use_len)
+        per_window = STATS_WINDOW_READS;
+    if (per_window < 1)
+        per_window = 1;
+    for (t = 0; t <= nref; t++) {
+        // the unplaced reads, at t == nref, make a single window
+        hts_pos_t len = 0, width = HTS_POS_MAX, beg;
+        if (t < nref) {
+            uint64_t n = (weight[t] + per_window - 1) / per_window;
+            if (!contig_has_reads(par.idx, t))
+                continue;
+            len = sam_hdr_tid2len(info->sam_header, t);
+            width = (len + n - 1) / (n ? n : 1);
+            if (width < STATS_WINDOW_MIN)
+                width = STATS_WINDOW_MIN;
+        }
+        for (beg = 0; beg == 0 || beg < len; beg += width) {
+            if (hts_resize(stats_window_t, par.n_win + 1, &m_win, &par.win,
+                           HTS_RESIZE_CLEAR) < 0)
+                goto mem_fail;
+            stats_window_t *win = &par.win[par.n_win++];
+            win->tid = t < nref ? t : HTS_IDX_NOCOOR;
+            win->beg = beg;
+            // the last window takes any reads past the end
+            win->end = len - beg > width ? beg + width : HTS_POS_MAX;
+        }
+    }
+
+    // The GC-depth bins as made by a single pass
+    if (!(all_gcd = stats_init()) || !(split_gcd = kh_init(c2stats)))
+        goto mem_fail;
+    init_stat_structs(all_gcd, info, NULL, NULL);
+
+    par.max_ahead = 2 * n_threads;
+    if (pthread_mutex_init(&par.lock, NULL) != 0
+        || pthread_cond_init(&par.cond, NULL) != 0) {
+        print_error("stats", "failed to initialise locks");
+        goto done;
+    }
+
+    w = calloc(n_threads, sizeof(*w));
+    tids = calloc(n_threads, sizeof(*tids));
+    if (!w || !tids) {
+        print_error("stats", "Out of memory");
+        goto stop;
+    }
+    for (k = 0; k < n_threads; k++) {
+        w[k].par = &par;
+        if (samtools_pthread_create(&tids[k], NULL, stats_worker, &w[k]) != 0) {
+            print_error_errno("stats", "failed to start thread");
+            goto stop;
+        }
+        n_started++;
+    }
+
+    // Merge the windows in order as they are done
+    for (k = 0; k < par.n_win; k++) {
+        stats_window_t *win = &par.win[k];
+
+        pthread_mutex_lock(&par.lock);
+        while (!win->status)
+            pthread_cond_wait(&par.cond, &par.lock);
+        pthread_mutex_unlock(&par.lock);
+
+        if (win->status < 0) {
+            if (win->tid == HTS_IDX_NOCOOR)
+                print_error("stats", "failed to read the unplaced reads of \"%s\"", bam_fname);
+            else
+                print_error("stats", "failed to read %s:%"PRIhts_pos"-%"PRIhts_pos" of \"%s\"",
+                            sam_hdr_tid2name(info->sam_header, win->tid),
+                            win->beg + 1, MIN(win->end, sam_hdr_tid2len(info->sam_header, win->tid)),
+                            bam_fname);
+            goto stop;
+        }
+
+        merge_stats(all_stats, win->stats);
+        replay_gcd(all_gcd, win->stats);
+        for (i = kh_begin(win->split_hash); i != kh_end(win->split_hash); ++i) {
+            if (!kh_exist(win->split_hash, i)) continue;
+            stats_t *curr_stats = kh_value(win->split_hash, i);
+            merge_stats(get_split_stats(curr_stats->split_name, split_hash, info, targets), curr_stats);
+            replay_gcd(get_split_stats(curr_stats->split_name, split_gcd, info, NULL), curr_stats);
+        }
+        stats_window_free(win);
+
+        pthread_mutex_lock(&par.lock);
+        par.n_merged++;
+        pthread_cond_broadcast(&par.cond);
+        pthread_mutex_unlock(&par.lock);
+    }
+
+    // Hand over the bins
+#define SWAP_GCD(a, b) do { \
+        gc_depth_t *gcd = (a)->gcd; uint32_t ngcd = (a)->ngcd, igcd = (a)->igcd; \
+        (a)->gcd = (b)->gcd; (a)->ngcd = (b)->ngcd; (a)->igcd = (b)->igcd; \
+        (b)->gcd = gcd; (b)->ngcd = ngcd; (b)->igcd = igcd; \
+    } while (0)
+    SWAP_GCD(all_stats, all_gcd);
+    for (i = kh_begin(split_gcd); i != kh_end(split_gcd); ++i) {
+        if (!kh_exist(split_gcd, i)) continue;
+        stats_t *curr_gcd = kh_value(split_gcd, i);
+        SWAP_GCD(get_split_stats(curr_gcd->split_name, split_hash, info, targets), curr_gcd);
+    }
+#undef SWAP_GCD
+    ret = 0;
+
+ stop:
+    pthread_mutex_lock(&par.lock);
+    par.stop = 1;
+    pthread_cond_broadcast(&par.cond);
+    pthread_mutex_unlock(&par.lock);
+    for (k = 0; k < n_started; k++)
+        pthread_join(tids[k], NULL);
+    pthread_cond_destroy(&par.cond);
+    pthread_mutex_destroy(&par.lock);
+    goto done;
+
+ mem_fail:
+    print_error("stats", "Out of memory");
+    ret = -1;
+
+ done:
+    for (k = 0; k < par.n_win; k++)
+        stats_window_free(&par.win[k]);
+    free(par.win);
+    free(w);
+    free(tids);
+    free(weight);
+    if (all_gcd) cleanup_stats(all_gcd);
+    destroy_split_stats(split_gcd);
+    hts_idx_destroy(par.idx);
+    return ret;
+}
+
 int main_stats(int argc, char *argv[])
 {
     char *targets = NULL;
     char *bam_fname = NULL;
     char *bam_idx_fname = NULL;
     char *group_id = NULL;
+    char *ref_fname = NULL;
     int sparse = 0, has_index_file = 0, ret = 1;
     sam_global_args ga = SAM_GLOBAL_ARGS_INIT;
 
@@ -2403,34 +3056,35 @@ int main_stats(int argc, char *argv[])
     };
     int opt;
 
-    while ( (opt=getopt_long(argc,argv,"?hdsXxpr:c:l:i:t:m:q:f:F:g:I:S:P:@:",loptions,NULL))>0 )
+    while ( (opt=samtools_getopt_long(argc,argv,"?hdsXxpr:c:l:i:t:m:q:f:F:g:I:S:P:@:",loptions,NULL))>0 )
     {
         switch (opt)
         {
-            case 'f': info->flag_require = bam_str2flag(optarg); break;
-            case 'F': info->flag_filter |= bam_str2flag(optarg); break;
+            case 'f': info->flag_require = bam_str2flag(samtools_optarg); break;
+            case 'F': info->flag_filter |= bam_str2flag(samtools_optarg); break;
             case 'd': info->flag_filter |= BAM_FDUP; break;
             case 'X': has_index_file = 1; break;
             case 's': break;
-            case 'r': info->fai = fai_load(optarg);
+            case 'r': info->fai = fai_load(samtools_optarg);
                       if (info->fai==NULL)
-                          error("Could not load faidx: %s\n", optarg);
+                          error("Could not load faidx: %s\n", samtools_optarg);
+                      ref_fname = samtools_optarg;
                       break;
-            case  1 : info->gcd_bin_size = atof(optarg); break;
-            case 'c': if ( sscanf(optarg,"%d,%d,%d",&info->cov_min,&info->cov_max,&info->cov_step)!= 3 )
-                          error("Unable to parse -c %s\n", optarg);
+            case  1 : info->gcd_bin_size = atof(samtools_optarg); break;
+            case 'c': if ( sscanf(samtools_optarg,"%d,%d,%d",&info->cov_min,&info->cov_max,&info->cov_step)!= 3 )
+                          error("Unable to parse -c %s\n", samtools_optarg);
                       break;
-            case 'l': info->filter_readlen = atoi(optarg); break;
-            case 'i': info->nisize = atoi(optarg); break;
-            case 'm': info->isize_main_bulk = atof(optarg); break;
-            case 'q': info->trim_qual = atoi(optarg); break;
-            case 't': targets = optarg; break;
-            case 'I': group_id = optarg; break;
+            case 'l': info->filter_readlen = atoi(samtools_optarg); break;
+            case 'i': info->nisize = atoi(samtools_optarg); break;
+            case 'm': info->isize_main_bulk = atof(samtools_optarg); break;
+            case 'q': info->trim_qual = atoi(samtools_optarg); break;
+            case 't': targets = samtools_optarg; break;
+            case 'I': group_id = samtools_optarg; break;
             case 'x': sparse = 1; break;
-            case 'S': info->split_tag = optarg; break;
-            case 'P': info->split_prefix = optarg; break;
+            case 'S': info->split_tag = samtools_optarg; break;
+            case 'P': info->split_prefix = samtools_optarg; break;
             case 'p': info->remove_overlaps = 1; break;
-            case 'g': info->cov_threshold = atoi(optarg);
+            case 'g': info->cov_threshold = atoi(samtools_optarg);
                       if ( info->cov_threshold < 0 || info->cov_threshold == INT_MAX )
                           error("Unsupported value for coverage threshold %d\n", info->cov_threshold);
                       break;
@@ -2438,13 +3092,13 @@ int main_stats(int argc, char *argv[])
             case 'h': error(NULL);
             /* no break */
             default:
-                if (parse_sam_global_opt(opt, optarg, loptions, &ga) != 0)
-                    error("Unknown argument: %s\n", optarg);
+                if (parse_sam_global_opt(opt, samtools_optarg, loptions, &ga) != 0)
+                    error("Unknown argument: %s\n", samtools_optarg);
                 break;
         }
     }
 
-    bam_fname = argv[optind++];
+    bam_fname = argv[samtools_optind++];
     if ( !bam_fname )
     {
         if ( isatty(STDIN_FILENO) )
@@ -2457,15 +3111,12 @@ int main_stats(int argc, char *argv[])
         return 1;
     }
 
-    if (has_index_file && !(bam_idx_fname = argv[optind++])) {
+    if (has_index_file && !(bam_idx_fname = argv[samtools_optind++])) {
         fprintf(samtools_stderr, "No index file provided\n");
         free(info);
         return 1;
     }
 
-    if (ga.nthreads > 0)
-        hts_set_threads(info->sam, ga.nthreads);
-
     stats_t *all_stats = stats_init();
     if (!all_stats) {
         fprintf(samtools_stderr, "Could not allocate memory for stats.\n");
@@ -2486,7 +3137,7 @@ int main_stats(int argc, char *argv[])
     bam1_t *bam_line = bam_init1();
     if (!bam_line) goto cleanup_read_pairs;
 
-    if (optind < argc) {
+    if (samtools_optind < argc) {
         // Region:interval arguments in the command line
         hts_idx_t *bam_idx = NULL;
         if (has_index_file) {
@@ -2497,10 +3148,12 @@ int main_stats(int argc, char *argv[])
         }
 
         if (bam_idx) {
-            hts_itr_multi_t *iter = sam_itr_regarray(bam_idx, info->sam_header, &argv[optind], argc - optind);
+            if (ga.nthreads > 0)
+                hts_set_threads(info->sam, ga.nthreads);
+            hts_itr_multi_t *iter = sam_itr_regarray(bam_idx, info->sam_header, &argv[samtools_optind], argc - samtools_optind);
             if (iter) {
                 if (!targets) {
-                    all_stats->nchunks = argc-optind;
+                    all_stats->nchunks = argc-samtools_optind;
                     if (replicate_regions(all_stats, iter, info))
                         fprintf(samtools_stderr, "Replications of the regions failed\n");
                 }
@@ -2540,18 +3193,31 @@ int main_stats(int argc, char *argv[])
             goto cleanup;
         }
 
+        // Split an indexed file into parts read by separate threads
+        ret = stats_parallel(all_stats, split_hash, info, bam_fname,
+                             bam_idx_fname, &ga.in, ref_fname, targets,
+                             ga.nthreads);
+        if (ret < 0) {
+            ret = 1;
+            goto cleanup;
+        }
+
         // Stream through the entire BAM ignoring off-target regions if -t is given
-        while ((ret = sam_read1(info->sam, info->sam_header, bam_line)) >= 0) {
-            if (info->split_tag) {
-                curr_stats = get_curr_split_stats(bam_line, split_hash, info, targets);
-                collect_stats(bam_line, curr_stats, read_pairs);
+        if (ret > 0) {
+            if (ga.nthreads > 0)
+                hts_set_threads(info->sam, ga.nthreads);
+            while ((ret = sam_read1(info->sam, info->sam_header, bam_line)) >= 0) {
+                if (info->split_tag) {
+                    curr_stats = get_curr_split_stats(bam_line, split_hash, info, targets);
+                    collect_stats(bam_line, curr_stats, read_pairs);
+                }
+                collect_stats(bam_line, all_stats, read_pairs);
             }
-            collect_stats(bam_line, all_stats, read_pairs);
-        }
 
-        if (ret < -1) {
-            fprintf(samtools_stderr, "Failure while decoding file\n");
-            goto cleanup;
+            if (ret < -1) {
+                fprintf(samtools_stderr, "Failure while decoding file\n");
+                goto cleanup;
+            }
         }
     }
 
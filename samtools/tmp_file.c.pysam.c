@@ -74,6 +74,8 @@ static int tmp_file_init(tmp_file_t *tmp, int verbose) {
     tmp->verbose = verbose;
     tmp->dict = NULL;
     tmp->groups_written = 0;
+    tmp->fd = -1;
+    tmp->fd_offset = 0;
 
     if (!tmp->ring_buffer || !tmp->comp_buffer || !tmp->stream) {
         tmp_print_error(tmp, "[tmp_file] Error: unable to allocate compression buffers.\n");
@@ -85,16 +87,18 @@ static int tmp_file_init(tmp_file_t *tmp, int verbose) {
 
 
 /*
- * Opens the temp file and initialises memory.
- * Verbose mode prints out error messages to samtools_stderr.
+ * Opens the temp file and initialises memory.  Unless named is set, the
+ * file is deleted when it is closed.
  * Returns 0 on success, a negative number on failure.
  */
-int tmp_file_open_write(tmp_file_t *tmp, char *tmp_name, int verbose) {
+static int tmp_file_open(tmp_file_t *tmp, char *tmp_name, int verbose, int named) {
     int ret;
     unsigned int count = 1;
     const unsigned int max_count = 100000; // more tries than this then something else is wrong
     int fd;
 
+    tmp->named = 0;
+
     if ((ret = tmp_file_init(tmp, verbose))) {
         return ret;
     }
@@ -111,7 +115,7 @@ int tmp_file_open_write(tmp_file_t *tmp, char *tmp_name, int verbose) {
 
 
         #ifdef _WIN32
-        if ((fd = _open(tmp->name, O_RDWR|O_CREAT|O_EXCL|O_BINARY|O_TEMPORARY, 0600)) == -1) {
+        if ((fd = _open(tmp->name, O_RDWR|O_CREAT|O_EXCL|O_BINARY|(named ? 0 : O_TEMPORARY), 0600)) == -1) {
         #else
         if ((fd = open(tmp->name, O_RDWR|O_CREAT|O_EXCL, 0600)) == -1) {
         #endif /* _WIN32 */
@@ -133,19 +137,42 @@ int tmp_file_open_write(tmp_file_t *tmp, char *tmp_name, int verbose) {
         return TMP_SAM_FILE_ERROR;
     }
 
+    tmp->named = named; // created, tmp_file_destroy deletes it
+
     if ((tmp->fp = fdopen(fd, "w+b")) == NULL) {
         tmp_print_error(tmp, "[tmp_file] Error: unable to open write file %s.\n", tmp->name);
         return TMP_SAM_FILE_ERROR;
     }
 
     #ifndef _WIN32
-    unlink(tmp->name); // should auto delete when closed on linux
+    if (!named)
+        unlink(tmp->name); // should auto delete when closed on linux
     #endif
 
     return TMP_SAM_OK;
 }
 
 
+/*
+ * Opens the temp file and initialises memory.
+ * Verbose mode prints out error messages to samtools_stderr.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_open_write(tmp_file_t *tmp, char *tmp_name, int verbose) {
+    return tmp_file_open(tmp, tmp_name, verbose, 0);
+}
+
+
+/*
+ * As tmp_file_open_write, but the file keeps its name until
+ * tmp_file_destroy.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_open_write_named(tmp_file_t *tmp, char *tmp_name, int verbose) {
+    return tmp_file_open(tmp, tmp_name, verbose, 1);
+}
+
+
 /*
  * The ring buffer stores precompressionn/post decompression data.  LZ4 requires that
  * previous data (64K worth) be available for efficient compression.  This function grows
@@ -307,6 +334,73 @@ int tmp_file_end_write(tmp_file_t *tmp) {
     fflush(tmp->fp);
 
     LZ4_freeStream(tmp->stream);
+    tmp->stream = NULL;
+
+    return TMP_SAM_OK;
+}
+
+
+/*
+ * Closes a named file after writing and frees the buffers, they are
+ * allocated again when the file is read.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_close_write(tmp_file_t *tmp) {
+    int ret = fclose(tmp->fp);
+
+    tmp->fp = NULL;
+    free(tmp->ring_buffer);
+    free(tmp->comp_buffer);
+    free(tmp->dict);
+    tmp->ring_buffer = NULL;
+    tmp->comp_buffer = NULL;
+    tmp->dict = NULL;
+
+    if (ret) {
+        tmp_print_error(tmp, "[tmp_file] Error: unable to close tmp file %s.\n", tmp->name);
+        return TMP_SAM_FILE_ERROR;
+    }
+
+    return TMP_SAM_OK;
+}
+
+
+/*
+ * Opens a file closed by tmp_file_close_write again, without buffers.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_reopen(tmp_file_t *tmp) {
+    if ((tmp->fp = fopen(tmp->name, "rb")) == NULL) {
+        tmp_print_error(tmp, "[tmp_file] Error: unable to reopen tmp file %s.\n", tmp->name);
+        return TMP_SAM_FILE_ERROR;
+    }
+
+    return TMP_SAM_OK;
+}
+
+
+/*
+ * Ends the current group and resets the compression stream, so that
+ * the following groups can be decompressed without what came before.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_mark(tmp_file_t *tmp, off_t *offset) {
+
+    if (tmp->entry_number) {
+        int ret;
+
+        if ((ret = tmp_file_write_to_file(tmp))) {
+            return ret;
+        }
+    }
+
+    LZ4_resetStream(tmp->stream);
+    tmp->groups_written = 0; // no dictionary to save
+
+    if ((*offset = ftello(tmp->fp)) < 0) {
+        tmp_print_error(tmp, "[tmp_file] Error: unable to get tmp file position.\n");
+        return TMP_SAM_FILE_ERROR;
+    }
 
     return TMP_SAM_OK;
 }
@@ -321,6 +415,17 @@ int tmp_file_begin_read(tmp_file_t *tmp) {
 
     rewind(tmp->fp);
 
+    // a reopened file has no buffers yet
+    if (!tmp->ring_buffer && !(tmp->ring_buffer = malloc(tmp->ring_buffer_size))) {
+        tmp_print_error(tmp, "[tmp_file] Error: unable to allocate decompression buffers.\n");
+        return TMP_SAM_MEM_ERROR;
+    }
+
+    if (!tmp->comp_buffer && !(tmp->comp_buffer = malloc(tmp->comp_buffer_size))) {
+        tmp_print_error(tmp, "[tmp_file] Error: unable to allocate decompression buffers.\n");
+        return TMP_SAM_MEM_ERROR;
+    }
+
     tmp->dstream = LZ4_createStreamDecode();
     tmp->offset  = 0;
     tmp->entry_number = tmp->group_size;
@@ -334,6 +439,63 @@ int tmp_file_begin_read(tmp_file_t *tmp) {
 }
 
 
+/*
+ * Sets up a reader with its own buffers that reads the file of src with
+ * pread() from a marked offset.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_begin_read_at(tmp_file_t *tmp, const tmp_file_t *src,
+                           off_t offset) {
+
+    memset(tmp, 0, sizeof(*tmp));
+    tmp->verbose = src->verbose;
+    tmp->group_size = src->group_size;
+    tmp->max_data_size = src->max_data_size;
+    tmp->ring_buffer_size = src->ring_buffer_size;
+    tmp->comp_buffer_size = src->comp_buffer_size;
+    tmp->entry_number = tmp->group_size;
+    tmp->fd = fileno(src->fp);
+    tmp->fd_offset = offset;
+
+    tmp->ring_buffer = malloc(sizeof(uint8_t) * tmp->ring_buffer_size);
+    tmp->comp_buffer = malloc(tmp->comp_buffer_size);
+    tmp->dstream = LZ4_createStreamDecode();
+
+    if (!tmp->ring_buffer || !tmp->comp_buffer || !tmp->dstream) {
+        tmp_print_error(tmp, "[tmp_file] Error: unable to allocate decompression buffers.\n");
+        return TMP_SAM_MEM_ERROR;
+    }
+
+    return TMP_SAM_OK;
+}
+
+
+/*
+ * Reads from the file position or, for readers set up with
+ * tmp_file_begin_read_at, from their own offset.
+ * Returns the number of bytes read.
+ */
+static size_t tmp_file_fread(tmp_file_t *tmp, void *buf, size_t size) {
+    size_t done = 0;
+
+    if (tmp->fd < 0)
+        return fread(buf, 1, size, tmp->fp);
+
+    while (done < size) {
+        ssize_t n = pread(tmp->fd, (char *)buf + done, size - done,
+                          tmp->fd_offset + done);
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+
+    tmp->fd_offset += done;
+
+    return done;
+}
+
+
 /*
  * Read the next alignment, either from memory or from a file.
  * Returns size of entry on success, 0 on end of file or a negative on error.
@@ -353,7 +515,7 @@ int tmp_file_read(tmp_file_t *tmp, bam1_t *inbam) {
         // read more data
         size_t comp_size;
 
-        if (fread(&comp_size, sizeof(size_t), 1, tmp->fp) == 0 || comp_size == 0) {
+        if (tmp_file_fread(tmp, &comp_size, sizeof(size_t)) < sizeof(size_t) || comp_size == 0) {
             return TMP_SAM_OK;
         }
 
@@ -362,7 +524,8 @@ int tmp_file_read(tmp_file_t *tmp, bam1_t *inbam) {
 
         tmp->ring_index = tmp->ring_buffer + tmp->offset;
 
-        if (fread(tmp->comp_buffer, sizeof(char), comp_size, tmp->fp) > comp_size) {
+        if (comp_size > tmp->comp_buffer_size ||
+            tmp_file_fread(tmp, tmp->comp_buffer, comp_size) < comp_size) {
             tmp_print_error(tmp, "[tmp_file] Error: error reading compressed data.\n");
             return TMP_SAM_FILE_ERROR;
         }
@@ -428,7 +591,11 @@ int tmp_file_read(tmp_file_t *tmp, bam1_t *inbam) {
 int tmp_file_destroy(tmp_file_t *tmp) {
     int ret = 0;
 
-    ret = fclose(tmp->fp);
+    if (tmp->fp)
+        ret = fclose(tmp->fp);
+
+    if (tmp->named && tmp->name)
+        unlink(tmp->name);
 
     LZ4_freeStreamDecode(tmp->dstream);
     free(tmp->ring_buffer);
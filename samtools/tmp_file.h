@@ -28,6 +28,7 @@ DEALINGS IN THE SOFTWARE
 #ifndef _TMP_SAM_FILE_H_
 #define _TMP_SAM_FILE_H_
 
+#include <sys/types.h>
 #include <lz4.h>
 #include "htslib/sam.h"
 
@@ -70,6 +71,9 @@ typedef struct {
     int verbose;
     char *dict;
     size_t groups_written;
+    int fd;             // file read with pread() by tmp_file_begin_read_at()
+    off_t fd_offset;
+    int named;          // the file keeps its name until tmp_file_destroy()
 } tmp_file_t;
 
 
@@ -81,6 +85,15 @@ typedef struct {
 int tmp_file_open_write(tmp_file_t *tmp, char *tmp_name, int verbose);
 
 
+/*
+ * As tmp_file_open_write, but the file keeps its name, so that it can be
+ * closed with tmp_file_close_write and opened again with tmp_file_reopen.
+ * tmp_file_destroy deletes it.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_open_write_named(tmp_file_t *tmp, char *tmp_name, int verbose);
+
+
 /*
  * Stores an in memory bam structure for writing and if enough are gathered together writes
  * it to a file.  Multiple alignments compress better that single ones though after a certain number
@@ -97,6 +110,29 @@ int tmp_file_write(tmp_file_t *tmp, bam1_t *inbam);
  */
 int tmp_file_end_write(tmp_file_t *tmp);
 
+/*
+ * Closes a file opened with tmp_file_open_write_named after
+ * tmp_file_end_write, and frees its buffers.  Until it is reopened, the
+ * file uses neither memory nor a file descriptor.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_close_write(tmp_file_t *tmp);
+
+/*
+ * Opens a file closed by tmp_file_close_write for tmp_file_begin_read or
+ * tmp_file_begin_read_at.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_reopen(tmp_file_t *tmp);
+
+/*
+ * Ends the current group and restarts compression without reference to
+ * earlier data, so that reading can later start here.  The file offset
+ * to pass to tmp_file_begin_read_at is returned in offset.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_mark(tmp_file_t *tmp, off_t *offset);
+
 /*
  * Prepares the file for reading.
  * Companion function to tmp_file_end_write above.
@@ -104,6 +140,15 @@ int tmp_file_end_write(tmp_file_t *tmp);
  */
 int tmp_file_begin_read(tmp_file_t *tmp);
 
+/*
+ * Prepares a second reader for a file written by src, starting at an
+ * offset returned by tmp_file_mark.  Readers do not share a file
+ * position, so several of them can read the same file at once.
+ * Returns 0 on success, a negative number on failure.
+ */
+int tmp_file_begin_read_at(tmp_file_t *tmp, const tmp_file_t *src,
+                           off_t offset);
+
 /*
  * Read the next alignment, either from memory or from a file.
  * Returns size of entry on success, 0 on end of file or a negative on error.
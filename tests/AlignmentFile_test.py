@@ -2031,6 +2031,60 @@ class TestFindIntrons(unittest.TestCase):
         })
         self.assertEqual(should, splice_sites)
 
+    def test_junctions_from_fetch(self):
+        table = self.samfile.find_junctions(self.samfile.fetch())
+        self.assertEqual(list(table.start), [14829, 15038, 15947, 16765, 16765,
+                                             17055, 17055, 17055, 17368])
+        self.assertEqual(list(table.count), [33, 24, 3, 9, 1, 19, 3, 1, 7])
+        # all reads have NH:i:6
+        self.assertEqual(list(table.count), list(table.multi))
+        self.assertEqual(set(table.strand), {0})
+        self.assertEqual(set(table.tid), {0})
+        self.assertEqual(table.motif, None)
+        self.assertEqual(
+            table, self.samfile.find_junctions(list(self.samfile.fetch())))
+        with pysam.AlignmentFile(self.samfilename) as inf:
+            self.assertEqual(
+                table, self.samfile.find_junctions(inf.fetch(until_eof=True)))
+
+    def test_junctions_with_filter(self):
+        table = self.samfile.find_junctions(
+            self.samfile.fetch("1", 15000, 16000, filter="pos > 14900"))
+        self.assertEqual(list(table.start), [15038, 15947])
+        self.assertEqual(list(table.count), [24, 3])
+
+    def test_strand_and_motif(self):
+        fastafile = pysam.FastaFile(os.path.join(BAM_DATADIR, "ex1.fa"))
+        header = {"SQ": [{"SN": "chr1", "LN": 1575}]}
+        filename = get_temp_filename(".bam")
+        reads = [("XS", "+", 0, 1), ("XS", "-", 0, 1),
+                 ("ts", "+", 0, 1), ("ts", "+", 0x10, 1),
+                 (None, None, 0, 2), (None, None, 0x100, 1)]
+        with pysam.AlignmentFile(filename, "wb", header=header) as outf:
+            for i, (tag, value, flag, nh) in enumerate(reads):
+                read = pysam.AlignedSegment(outf.header)
+                read.query_name = "read{}".format(i)
+                read.flag = flag
+                read.reference_id = 0
+                read.reference_start = 100
+                read.cigarstring = "10M50N10M"
+                read.query_sequence = "A" * 20
+                tags = [("NH", nh)]
+                if tag:
+                    tags.append((tag, value, "A"))
+                read.set_tags(tags)
+                outf.write(read)
+        with pysam.AlignmentFile(filename) as inf:
+            table = inf.find_junctions(inf.fetch(until_eof=True),
+                                       fastafile=fastafile)
+        self.assertEqual(list(table.strand), [-1, 0, 1])
+        self.assertEqual(list(table.count), [2, 2, 2])
+        self.assertEqual(list(table.unique), [2, 0, 2])
+        self.assertEqual(list(table.multi), [0, 2, 0])
+        motif = "{}-{}".format(fastafile.fetch("chr1", 110, 112),
+                               fastafile.fetch("chr1", 158, 160))
+        self.assertEqual(table.motif, [motif.upper()] * 3)
+
 
 class TestLogging(unittest.TestCase):
 
@@ -2297,6 +2351,29 @@ class TestExplicitIndex(unittest.TestCase):
             samfile.fetch("chr1")
 
 
+class TestThreadedIndexing(unittest.TestCase):
+
+    '''test that indices built with several threads are unchanged.'''
+
+    def build(self, suffix, threads, *args):
+        tmpfilename = get_temp_filename(suffix=".bam")
+        shutil.copyfile(os.path.join(BAM_DATADIR, "ex1.bam"), tmpfilename)
+        pysam.samtools.index(*args, "-@", str(threads), tmpfilename)
+        with open(tmpfilename + suffix, "rb") as inf:
+            data = inf.read()
+        os.unlink(tmpfilename + suffix)
+        os.unlink(tmpfilename)
+        return data
+
+    def testBAI(self):
+        self.assertEqual(self.build(".bai", 4),
+                         self.build(".bai", 0))
+
+    def testCSI(self):
+        self.assertEqual(self.build(".csi", 4, "-c"),
+                         self.build(".csi", 0, "-c"))
+
+
 class TestVerbosity(unittest.TestCase):
 
     '''test if setting/getting of verbosity works.'''
@@ -2310,6 +2387,598 @@ class TestVerbosity(unittest.TestCase):
         self.assertEqual(pysam.get_verbosity(), 3)
 
 
+class TestBlockCache(unittest.TestCase):
+
+    '''test the process-wide cache of decompressed blocks.'''
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def tearDown(self):
+        pysam.set_block_cache(0)
+
+    def fetch_all(self, threads=1):
+        with pysam.AlignmentFile(self.filename, threads=threads) as inf:
+            return [r.to_string() for r in inf.fetch("chr1", 100, 1500)]
+
+    def testCacheIsDisabledByDefault(self):
+        pysam.get_block_cache_stats(reset=True)
+        self.fetch_all()
+        stats = pysam.get_block_cache_stats()
+        self.assertEqual(stats["capacity"], 0)
+        self.assertEqual(stats["hits"], 0)
+        self.assertEqual(stats["blocks"], 0)
+
+    def testCacheIsSharedBetweenHandles(self):
+        reference = self.fetch_all()
+        pysam.set_block_cache(16 * 1024 * 1024)
+        pysam.get_block_cache_stats(reset=True)
+        self.assertEqual(self.fetch_all(), reference)
+        stats = pysam.get_block_cache_stats()
+        self.assertEqual(stats["hits"], 0)
+        self.assertGreater(stats["misses"], 0)
+        self.assertGreater(stats["blocks"], 0)
+        self.assertEqual(self.fetch_all(), reference)
+        self.assertEqual(self.fetch_all(threads=2), reference)
+        stats = pysam.get_block_cache_stats()
+        self.assertGreater(stats["hits"], 0)
+
+    def testCacheRespectsCapacity(self):
+        pysam.set_block_cache(100 * 1024)
+        pysam.get_block_cache_stats(reset=True)
+        with pysam.AlignmentFile(self.filename) as inf:
+            self.assertEqual(len(list(inf)), 3270)
+        stats = pysam.get_block_cache_stats()
+        self.assertLessEqual(stats["size"], stats["capacity"])
+        self.assertGreater(stats["evictions"], 0)
+
+
+class TestThreadedFetch(unittest.TestCase):
+
+    '''test region iteration with a thread pool prefetching index chunks.'''
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    regions = [("chr1", 100, 200),
+               ("chr2", 1000, 1500),
+               ("chr1", 0, 1575),
+               ("chr2", 0, 1584),
+               ("chr1", 1000, 1001)]
+
+    def fetch_regions(self, threads):
+        with pysam.AlignmentFile(self.filename, threads=threads) as inf:
+            return [[r.to_string() for r in inf.fetch(*region)]
+                    for region in self.regions]
+
+    def testFetchMatchesSingleThreaded(self):
+        self.assertEqual(self.fetch_regions(threads=1),
+                         self.fetch_regions(threads=3))
+
+    def testAbandonedIterator(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            reference = [r.to_string() for r in inf.fetch("chr2")]
+        with pysam.AlignmentFile(self.filename, threads=3) as inf:
+            it = inf.fetch("chr1")
+            next(it)
+            next(it)
+            self.assertEqual([r.to_string() for r in inf.fetch("chr2")],
+                             reference)
+
+    def testReadingContinuesAfterFetch(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            reference = [r.to_string() for r in inf]
+        with pysam.AlignmentFile(self.filename, threads=3) as inf:
+            self.assertGreater(len(list(inf.fetch("chr1", 100, 200))), 0)
+            inf.reset()
+            self.assertEqual([r.to_string() for r in inf], reference)
+
+
+class TestMemoryMappedIO(unittest.TestCase):
+
+    '''test reading through a memory mapping.'''
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def read(self, **kwargs):
+        with pysam.AlignmentFile(self.filename, **kwargs) as inf:
+            whole = [r.to_string() for r in inf]
+            regions = [[r.to_string() for r in inf.fetch(*region)]
+                       for region in (("chr1", 100, 200),
+                                      ("chr2", 1000, 1500),
+                                      ("chr1", 0, 1575))]
+            return whole, regions
+
+    def testMatchesBufferedReads(self):
+        reference = self.read()
+        self.assertEqual(self.read(io="mmap"), reference)
+        self.assertEqual(self.read(io="mmap", threads=2), reference)
+        self.assertEqual(self.read(io="mmap", index_filename=self.filename + ".bai"),
+                         reference)
+
+    def testURLPrefix(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            reference = [r.to_string() for r in inf.fetch("chr2")]
+        with pysam.AlignmentFile("mmap:" + self.filename,
+                                 index_filename=self.filename + ".bai") as inf:
+            self.assertEqual([r.to_string() for r in inf.fetch("chr2")],
+                             reference)
+
+    def testSamFile(self):
+        filename = os.path.join(BAM_DATADIR, "ex2.sam")
+        with pysam.AlignmentFile(filename) as inf:
+            reference = [r.to_string() for r in inf]
+        with pysam.AlignmentFile(filename, io="mmap") as inf:
+            self.assertEqual([r.to_string() for r in inf], reference)
+
+    def testInvalidArguments(self):
+        self.assertRaises(ValueError,
+                          pysam.AlignmentFile, self.filename, io="direct")
+        with pysam.AlignmentFile(self.filename) as inf:
+            header = inf.header
+        self.assertRaises(ValueError,
+                          pysam.AlignmentFile,
+                          get_temp_filename(".bam"), "wb",
+                          header=header, io="mmap")
+
+
+class TestLazyIndex(unittest.TestCase):
+
+    '''test reading the index on demand.'''
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+    regions = (("chr2", 1000, 1500),
+               ("chr1", 100, 200),
+               ("chr1", 0, 1575))
+
+    def read(self, filename, **kwargs):
+        with pysam.AlignmentFile(filename, **kwargs) as inf:
+            regions = [[r.to_string() for r in inf.fetch(*region)]
+                       for region in self.regions]
+            return (regions, inf.mapped, inf.unmapped,
+                    inf.get_index_statistics(),
+                    inf.count("chr2", 1000, 1500))
+
+    def testMatchesEagerIndex(self):
+        self.assertEqual(self.read(self.filename, lazy_index=True),
+                         self.read(self.filename))
+
+    def testCSI(self):
+        filename = get_temp_filename(".bam")
+        shutil.copyfile(self.filename, filename)
+        pysam.samtools.index("-c", filename)
+        try:
+            self.assertEqual(self.read(filename, lazy_index=True),
+                             self.read(self.filename))
+        finally:
+            os.unlink(filename)
+            os.unlink(filename + ".csi")
+
+    def testOpenReadsHeaderOnly(self):
+        # an index cut after the number of references opens, the
+        # entries are only missed when a reference is fetched
+        filename = get_temp_filename(".bam")
+        shutil.copyfile(self.filename, filename)
+        with open(self.filename + ".bai", "rb") as inf:
+            index = inf.read()
+        with open(filename + ".bai", "wb") as outf:
+            outf.write(index[:8])
+        try:
+            with pysam.AlignmentFile(filename, lazy_index=True) as inf:
+                self.assertTrue(inf.has_index())
+                self.assertRaises(IOError, inf.fetch, "chr1")
+        finally:
+            os.unlink(filename)
+            os.unlink(filename + ".bai")
+
+    def testMultipleIterators(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            reference = [r.to_string() for r in inf.fetch("chr2")]
+        with pysam.AlignmentFile(self.filename, lazy_index=True) as inf:
+            iters = [inf.fetch("chr2", multiple_iterators=True)
+                     for _ in range(3)]
+        # the iterators share the index, which outlives the file
+        for it in iters:
+            self.assertEqual([r.to_string() for r in it], reference)
+
+
+class TestClone(unittest.TestCase):
+
+    '''test cloning an open file.'''
+
+    def check(self, filename, **kwargs):
+        with pysam.AlignmentFile(filename, **kwargs) as inf:
+            whole = [r.to_string() for r in inf]
+            region = [r.to_string() for r in inf.fetch("chr2", 1000, 1500)]
+            clones = [inf.clone() for _ in range(2)]
+            self.assertEqual(clones[0].header, inf.header)
+            self.assertEqual(clones[0].mapped, inf.mapped)
+        # clones start at the first record and remain usable after
+        # the original is closed
+        for clone in clones:
+            self.assertEqual([r.to_string() for r in clone], whole)
+            self.assertEqual(
+                [r.to_string() for r in clone.fetch("chr2", 1000, 1500)],
+                region)
+            clone.close()
+
+    def testBAM(self):
+        self.check(os.path.join(BAM_DATADIR, "ex1.bam"))
+
+    def testBAMLazyIndex(self):
+        self.check(os.path.join(BAM_DATADIR, "ex1.bam"), lazy_index=True)
+
+    def testBAMThreads(self):
+        self.check(os.path.join(BAM_DATADIR, "ex1.bam"), threads=2)
+
+    def testCRAM(self):
+        self.check(os.path.join(BAM_DATADIR, "ex1.cram"))
+
+    def testIndexedReads(self):
+        with pysam.AlignmentFile(os.path.join(BAM_DATADIR, "ex1.bam")) as inf:
+            index = pysam.IndexedReads(inf, multiple_iterators=True)
+            index.build()
+            read = next(inf.fetch())
+            found = list(index.find(read.query_name))
+            self.assertIn(read.to_string(), [r.to_string() for r in found])
+
+    def testInvalid(self):
+        filename = os.path.join(BAM_DATADIR, "ex1.bam")
+        with pysam.AlignmentFile(filename) as inf:
+            header = inf.header
+        self.assertRaises(ValueError, inf.clone)
+        with pysam.AlignmentFile(get_temp_filename(".bam"), "wb",
+                                 header=header) as outf:
+            self.assertRaises(ValueError, outf.clone)
+
+    def testSubclass(self):
+        # the file is opened in __cinit__, so subclasses need not call
+        # the base __init__
+        class Subclass(pysam.AlignmentFile):
+            def __init__(self, *args, **kwargs):
+                pass
+
+        filename = os.path.join(BAM_DATADIR, "ex1.bam")
+        with pysam.AlignmentFile(filename) as inf:
+            whole = [r.to_string() for r in inf]
+        with Subclass(filename) as inf:
+            self.assertEqual([r.to_string() for r in inf], whole)
+            clone = inf.clone()
+        self.assertEqual([r.to_string() for r in clone], whole)
+        clone.close()
+
+
+class TestPrefetch(unittest.TestCase):
+
+    '''test reading records ahead in a background thread.'''
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def read(self, prefetch, **kwargs):
+        with pysam.AlignmentFile(self.filename, prefetch=prefetch) as inf:
+            return [r.to_string() for r in inf.fetch(**kwargs)]
+
+    def testIteration(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            reference = [r.to_string() for r in inf]
+        with pysam.AlignmentFile(self.filename, prefetch=4) as inf:
+            self.assertEqual([r.to_string() for r in inf], reference)
+
+    def testFetchRegion(self):
+        self.assertEqual(self.read(4, contig="chr2", start=1000, stop=1500),
+                         self.read(0, contig="chr2", start=1000, stop=1500))
+
+    def testFetchAll(self):
+        self.assertEqual(self.read(4), self.read(0))
+
+    def testFetchUntilEOF(self):
+        self.assertEqual(self.read(4, until_eof=True),
+                         self.read(0, until_eof=True))
+
+    def testFetchOverridesFile(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            self.assertEqual(
+                [r.to_string() for r in inf.fetch("chr1", prefetch=3)],
+                [r.to_string() for r in inf.fetch("chr1")])
+
+    def testTellAfterReadAhead(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            reference = [r.to_string() for r in inf]
+        with pysam.AlignmentFile(self.filename, prefetch=8) as inf:
+            head = [next(inf).to_string() for _ in range(10)]
+            # records read ahead are returned to the file
+            pos = inf.tell()
+            rest = [r.to_string() for r in inf]
+            self.assertEqual(head + rest, reference)
+            inf.seek(pos)
+            self.assertEqual([r.to_string() for r in inf], rest)
+
+    def testSAMStopAfterReadAhead(self):
+        # SAM files cannot be moved back to the records read ahead
+        filename = os.path.join(BAM_DATADIR, "ex2.sam")
+        with pysam.AlignmentFile(filename) as inf:
+            reference = [r.to_string() for r in inf]
+        with pysam.AlignmentFile(filename, prefetch=8) as inf:
+            next(inf)
+            self.assertRaises(IOError, inf.tell)
+        with pysam.AlignmentFile(filename, prefetch=8) as inf:
+            next(inf)
+            self.assertRaises(IOError, inf.fetch, until_eof=True)
+        # nothing is lost once the file has been read
+        with pysam.AlignmentFile(filename, prefetch=8) as inf:
+            self.assertEqual([r.to_string() for r in inf], reference)
+            inf.tell()
+
+    def testInvalid(self):
+        self.assertRaises(ValueError, pysam.AlignmentFile,
+                          self.filename, prefetch=-1)
+
+
+class TestFilterExpression(unittest.TestCase):
+
+    '''test reads being filtered by htslib filter expressions.'''
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+    expression = "mapq >= 50 && !flag.reverse"
+
+    def accept(self, read):
+        return read.mapping_quality >= 50 and not read.is_reverse
+
+    def reference(self, **kwargs):
+        with pysam.AlignmentFile(self.filename) as inf:
+            return [r.to_string() for r in inf.fetch(**kwargs)
+                    if self.accept(r)]
+
+    def testOpenWithFilter(self):
+        with pysam.AlignmentFile(self.filename, filter=self.expression) as inf:
+            self.assertEqual(inf.filter, self.expression)
+            self.assertEqual(
+                [r.to_string() for r in inf.fetch(until_eof=True)],
+                self.reference(until_eof=True))
+            self.assertEqual([r.to_string() for r in inf.fetch()],
+                             self.reference())
+            self.assertEqual(
+                [r.to_string() for r in inf.fetch("chr2", 1000, 1500)],
+                self.reference(contig="chr2", start=1000, stop=1500))
+            self.assertEqual(inf.count("chr1"),
+                             len(self.reference(contig="chr1")))
+
+    def testFetchWithFilter(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            for kwargs in ({"until_eof": True},
+                           {},
+                           {"contig": "chr2", "start": 1000, "stop": 1500},
+                           {"multiple_iterators": True},
+                           {"prefetch": 4}):
+                self.assertEqual(
+                    [r.to_string() for r in
+                     inf.fetch(filter=self.expression, **kwargs)],
+                    self.reference(**{k: v for k, v in kwargs.items()
+                                      if k != "prefetch"}))
+            # the filter applies to a single call only
+            self.assertEqual(len(list(inf.fetch("chr1"))), inf.count("chr1"))
+
+    def testFiltersCombine(self):
+        with pysam.AlignmentFile(self.filename, filter="mapq >= 50") as inf:
+            self.assertEqual(
+                [r.to_string() for r in inf.fetch(filter="!flag.reverse")],
+                self.reference())
+
+    def testCount(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            self.assertEqual(inf.count("chr1", filter=self.expression),
+                             len(self.reference(contig="chr1")))
+
+    def testPileup(self):
+        with pysam.AlignmentFile(self.filename) as inf:
+            filtered = [(c.reference_pos, c.nsegments) for c in
+                        inf.pileup("chr1", 100, 200, stepper="nofilter",
+                                   filter=self.expression)]
+            unfiltered = [(c.reference_pos, c.nsegments) for c in
+                          inf.pileup("chr1", 100, 200, stepper="nofilter")]
+        with pysam.AlignmentFile(self.filename, filter=self.expression) as inf:
+            self.assertEqual(
+                [(c.reference_pos, c.nsegments) for c in
+                 inf.pileup("chr1", 100, 200, stepper="nofilter")],
+                filtered)
+        self.assertLess(sum(n for _, n in filtered),
+                        sum(n for _, n in unfiltered))
+
+    def testClone(self):
+        with pysam.AlignmentFile(self.filename, filter=self.expression) as inf:
+            other = inf.clone()
+        self.assertEqual(other.filter, self.expression)
+        self.assertEqual([r.to_string() for r in other.fetch()],
+                         self.reference())
+        other.close()
+
+    def testInvalid(self):
+        self.assertRaises(ValueError, pysam.AlignmentFile,
+                          self.filename, filter="mapq >=")
+        with pysam.AlignmentFile(self.filename) as inf:
+            self.assertRaises(ValueError, inf.fetch, filter="mapq >=")
+            header = inf.header
+        self.assertRaises(ValueError, pysam.AlignmentFile,
+                          get_temp_filename(".bam"), "wb",
+                          header=header, filter="mapq >= 50")
+
+
+class TestCount(unittest.TestCase):
+
+    '''test counting reads without creating AlignedSegment objects.'''
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def setUp(self):
+        self.samfile = pysam.AlignmentFile(self.filename)
+
+    def tearDown(self):
+        self.samfile.close()
+
+    def count(self, accept, **kwargs):
+        with pysam.AlignmentFile(self.filename) as inf:
+            return sum(1 for r in inf.fetch(**kwargs) if accept(r))
+
+    def testReadCallbacks(self):
+        for kwargs in ({}, {"contig": "chr2", "start": 1000, "stop": 1500},
+                       {"until_eof": True}):
+            for read_callback, accept in (
+                    ("nofilter", lambda r: True),
+                    ("all", lambda r: not (r.flag & 0x704))):
+                # until_eof counts from the current position
+                with pysam.AlignmentFile(self.filename) as inf:
+                    self.assertEqual(
+                        inf.count(read_callback=read_callback, **kwargs),
+                        self.count(accept, **kwargs))
+
+    def testFlagsAndMappingQuality(self):
+        accept = (lambda r: r.is_paired and not r.is_reverse
+                  and r.mapping_quality >= 30)
+        for kwargs in ({}, {"contig": "chr1"}):
+            self.assertEqual(
+                self.samfile.count(flag_require=0x1, flag_filter=0x10,
+                                   min_mapping_quality=30, **kwargs),
+                self.count(accept, **kwargs))
+            # a function sees only reads passing the thresholds
+            self.assertEqual(
+                self.samfile.count(flag_require=0x1, flag_filter=0x10,
+                                   min_mapping_quality=30,
+                                   read_callback=lambda r: True, **kwargs),
+                self.count(accept, **kwargs))
+
+    def testIndex(self):
+        stats = self.samfile.get_index_statistics()
+        for stat in stats:
+            self.assertEqual(self.samfile.count(stat.contig, method="index"),
+                             stat.total)
+            self.assertEqual(self.samfile.count(stat.contig, method="index"),
+                             self.samfile.count(stat.contig))
+        self.assertEqual(self.samfile.count(method="index"),
+                         self.samfile.count())
+        self.assertEqual(self.samfile.count(method="index", until_eof=True),
+                         self.samfile.mapped + self.samfile.unmapped)
+
+    def testIndexInvalid(self):
+        self.assertRaises(ValueError, self.samfile.count,
+                          "chr1", 100, 200, method="index")
+        self.assertRaises(ValueError, self.samfile.count,
+                          "chr1", read_callback="all", method="index")
+        self.assertRaises(ValueError, self.samfile.count,
+                          "chr1", method="unknown")
+        with pysam.AlignmentFile(os.path.join(BAM_DATADIR, "ex1.cram")) as inf:
+            self.assertRaises(ValueError, inf.count, "chr1", method="index")
+
+
+class TestMates(unittest.TestCase):
+
+    '''test batched mate lookup and read pairing.'''
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def setUp(self):
+        self.samfile = pysam.AlignmentFile(self.filename)
+
+    def tearDown(self):
+        self.samfile.close()
+
+    def mate(self, read):
+        try:
+            return self.samfile.mate(read)
+        except ValueError:
+            return None
+
+    def testMatesAsMate(self):
+        reads = list(self.samfile.fetch("chr1", 100, 2000))
+        mates = self.samfile.mates(reads)
+        self.assertEqual(len(mates), len(reads))
+        self.assertTrue(any(mate is None for mate in mates))
+        for read, mate in zip(reads, mates):
+            expected = self.mate(read)
+            if expected is None:
+                self.assertEqual(mate, None)
+            else:
+                self.assertEqual(mate.compare(expected), 0)
+
+    def testMatesWithoutMerging(self):
+        reads = list(self.samfile.fetch("chr2", 1000, 1200))
+        self.assertEqual(
+            [m.to_string() if m else None
+             for m in self.samfile.mates(reads, max_gap=0)],
+            [m.to_string() if m else None
+             for m in self.samfile.mates(reads)])
+
+    def testMatesDoesNotMoveFile(self):
+        it = self.samfile.fetch("chr1")
+        first = [next(it) for x in range(10)]
+        self.samfile.mates(first)
+        self.assertEqual(next(it).compare(
+            list(self.samfile.fetch("chr1", multiple_iterators=True))[10]), 0)
+
+    def pairs(self, reads):
+        buffered, pairs = {}, []
+        for read in reads:
+            if not read.is_paired or read.is_secondary or read.is_supplementary:
+                continue
+            mate = buffered.pop(read.query_name, None)
+            if mate is None:
+                buffered[read.query_name] = read
+            else:
+                pairs.append(
+                    tuple(r.to_string() for r in
+                          sorted((read, mate), key=lambda r: r.is_read2)))
+        return pairs
+
+    def testIterPairs(self):
+        for kwargs in ({}, {"contig": "chr1", "start": 100, "stop": 2000},
+                       {"until_eof": True}):
+            with pysam.AlignmentFile(self.filename) as inf:
+                pairs = list(inf.iter_pairs(**kwargs))
+            for read1, read2 in pairs:
+                self.assertTrue(read1.is_read1)
+                self.assertTrue(read2.is_read2)
+                self.assertEqual(read1.query_name, read2.query_name)
+            with pysam.AlignmentFile(self.filename) as inf:
+                self.assertEqual(
+                    sorted((a.to_string(), b.to_string()) for a, b in pairs),
+                    sorted(self.pairs(inf.fetch(**kwargs))))
+
+
+class TestPartition(unittest.TestCase):
+
+    '''test splitting a file into regions of similar size.'''
+
+    def fetch_starting(self, samfile, partition):
+        # reads overlapping a region boundary are fetched twice
+        reads = []
+        for contig, start, stop in partition:
+            for read in samfile.fetch(contig, start, stop):
+                if contig == "*" or read.reference_start >= start:
+                    reads.append(read.to_string())
+        return reads
+
+    def testCoversAllReads(self):
+        for fn in ("ex1.bam", "ex1.cram"):
+            with pysam.AlignmentFile(os.path.join(BAM_DATADIR, fn)) as samfile:
+                expected = sorted(r.to_string() for r in samfile.fetch(until_eof=True))
+                for n in (1, 2, 5):
+                    partitions = samfile.partition(n)
+                    self.assertGreaterEqual(len(partitions), n)
+                    reads = [r for part in partitions
+                             for r in self.fetch_starting(samfile, part)]
+                    self.assertEqual(sorted(reads), expected)
+
+    def testBalanced(self):
+        with pysam.AlignmentFile(os.path.join(BAM_DATADIR, "ex1.bam")) as samfile:
+            partitions = samfile.partition(2)
+            self.assertEqual(partitions, [[("chr1", 0, 1575)], [("chr2", 0, 1584)]])
+
+    def testReadsWithoutCoordinates(self):
+        with pysam.AlignmentFile(os.path.join(BAM_DATADIR, "ex1.cram")) as samfile:
+            self.assertEqual(samfile.partition(2)[-1], [("*", None, None)])
+
+    def testInvalid(self):
+        with pysam.AlignmentFile(os.path.join(BAM_DATADIR, "ex1.bam")) as samfile:
+            self.assertRaises(ValueError, samfile.partition, 0)
+
+
 class TestSanityCheckingBAM(unittest.TestCase):
 
     mode = "wb"
@@ -462,6 +462,29 @@ class TestIndexFilename(unittest.TestCase):
             with pysam.VariantFile(fn, index_filename=idx_fn) as inf:
                 self.assertEqual(len(list(inf.fetch('20'))), 3)
 
+    def testReopen(self):
+        for fn, idx_fn in self.filenames:
+            fn = os.path.join(CBCF_DATADIR, fn)
+            idx_fn = os.path.join(CBCF_DATADIR, idx_fn)
+
+            with pysam.VariantFile(fn, index_filename=idx_fn) as inf:
+                ref = [str(r) for r in inf.fetch('20')]
+                a = inf.fetch('20', reopen=True)
+                b = inf.fetch('20', reopen=True)
+                self.assertEqual([str(r) for r in a], ref)
+                self.assertEqual([str(r) for r in b], ref)
+                self.assertEqual(len(list(inf.fetch(reopen=True))),
+                                 len(list(inf.fetch())))
+
+    def testCopyStartsAtFirstRecord(self):
+        fn = os.path.join(CBCF_DATADIR, 'example_vcf40.vcf.gz')
+        with pysam.VariantFile(fn) as inf:
+            ref = [str(r) for r in inf]
+            inf.reset()
+            next(inf)
+            with inf.copy() as copy:
+                self.assertEqual([str(r) for r in copy], ref)
+
 
 class TestConstructionVCFWithContigs(unittest.TestCase):
     """construct VariantFile from scratch."""
@@ -637,6 +660,68 @@ class TestMultiThreading(unittest.TestCase):
                               ignore_truncation=True)
 
 
+class TestPrefetch(unittest.TestCase):
+
+    filenames = ["example_vcf42.bcf", "example_vcf42.vcf.gz", "example_vcf42.vcf"]
+
+    def read(self, filename, prefetch, **kwargs):
+        with pysam.VariantFile(os.path.join(CBCF_DATADIR, filename),
+                               prefetch=prefetch) as inf:
+            if kwargs:
+                return [str(r) for r in inf.fetch(**kwargs)]
+            return [str(r) for r in inf]
+
+    def testIteration(self):
+        for fn in self.filenames:
+            self.assertEqual(self.read(fn, 4), self.read(fn, 0))
+
+    def testFetch(self):
+        for fn in self.filenames[:2]:
+            self.assertEqual(self.read(fn, 4, contig="20", start=14000, stop=1200000),
+                             self.read(fn, 0, contig="20", start=14000, stop=1200000))
+
+    def testTellAfterReadAhead(self):
+        fn = os.path.join(CBCF_DATADIR, "example_vcf42.bcf")
+        with pysam.VariantFile(fn, prefetch=4) as inf:
+            head = str(next(inf))
+            pos = inf.tell()
+            rest = [str(r) for r in inf]
+            inf.seek(pos)
+            self.assertEqual([str(r) for r in inf], rest)
+        self.assertEqual([head] + rest, self.read("example_vcf42.bcf", 0))
+
+    def testDropSamples(self):
+        fn = os.path.join(CBCF_DATADIR, "example_vcf42.bcf")
+        records = []
+        for prefetch in (0, 4):
+            with pysam.VariantFile(fn, drop_samples=True,
+                                   prefetch=prefetch) as inf:
+                records.append([str(r) for r in inf])
+        self.assertEqual(records[0], records[1])
+
+
+class TestPartition(unittest.TestCase):
+
+    filenames = ["example_vcf42.bcf", "example_vcf42.vcf.gz"]
+
+    def testCoversAllRecords(self):
+        for fn in self.filenames:
+            with pysam.VariantFile(os.path.join(CBCF_DATADIR, fn)) as inf:
+                expected = sorted(str(r) for r in inf)
+                for n in (1, 2, 4):
+                    partitions = inf.partition(n)
+                    self.assertEqual(len(partitions), n)
+                    records = [str(r) for part in partitions
+                               for contig, start, stop in part
+                               for r in inf.fetch(contig, start, stop)
+                               if r.start >= start]
+                    self.assertEqual(sorted(records), expected)
+
+    def testWithoutIndex(self):
+        with pysam.VariantFile(os.path.join(CBCF_DATADIR, "example_vcf42.vcf")) as inf:
+            self.assertRaises(ValueError, inf.partition, 2)
+
+
 class TestSubsetting(unittest.TestCase):
 
     filename = "example_vcf42.vcf.gz"
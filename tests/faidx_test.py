@@ -220,6 +220,213 @@ class TestFastxFileWithEmptySequence(unittest.TestCase):
         self.assertEqual(ref_num, l)
 
 
+class TestFastxWriter(unittest.TestCase):
+
+    filename = "faidx_ex1.fq"
+
+    def setUp(self):
+        with pysam.FastxFile(os.path.join(BAM_DATADIR, self.filename)) as inf:
+            self.records = list(inf)
+
+    def check_roundtrip(self, outfile, records=None):
+        with pysam.FastxFile(outfile) as inf:
+            written = list(inf)
+        os.unlink(outfile)
+        if records is None:
+            records = self.records
+        self.assertEqual(len(written), len(records))
+        for a, b in zip(written, records):
+            self.assertEqual(str(a), str(b))
+
+    def test_write_records_uncompressed(self):
+        outfile = get_temp_filename(suffix=".fq")
+        with pysam.FastxWriter(outfile) as outf:
+            for record in self.records:
+                outf.write(record)
+        with open(outfile) as inf, \
+                open(os.path.join(BAM_DATADIR, self.filename)) as ref:
+            self.assertEqual(inf.read(), ref.read())
+        self.check_roundtrip(outfile)
+
+    def test_write_proxies_compressed_with_threads(self):
+        outfile = get_temp_filename(suffix=".fq.gz")
+        with pysam.FastxFile(os.path.join(BAM_DATADIR, self.filename),
+                             persist=False) as inf, \
+                pysam.FastxWriter(outfile, threads=2, level=1) as outf:
+            for proxy in inf:
+                outf.write(proxy)
+        with gzip.open(outfile, "rt") as inf:
+            self.assertEqual(len(inf.readlines()), 4 * len(self.records))
+        self.check_roundtrip(outfile)
+
+    def test_write_tuples(self):
+        outfile = get_temp_filename(suffix=".fa")
+        with pysam.FastxWriter(outfile) as outf:
+            outf.writelines([("read1", "ACGT"),
+                             ("read2", "AC", "II", "comment")])
+        records = [pysam.FastxRecord(name="read1", sequence="ACGT"),
+                   pysam.FastxRecord(name="read2", sequence="AC",
+                                     quality="II", comment="comment")]
+        self.check_roundtrip(outfile, records)
+
+    def test_write_invalid_records_raises_error(self):
+        outfile = get_temp_filename(suffix=".fq")
+        with pysam.FastxWriter(outfile) as outf:
+            self.assertRaises(ValueError, outf.write, ("read1", "ACGT", "I"))
+            self.assertRaises(ValueError, outf.write, (None, "ACGT"))
+            self.assertRaises(ValueError, outf.write, ("read1",))
+        os.unlink(outfile)
+
+    def test_write_many(self):
+        outfile = get_temp_filename(suffix=".fq.gz")
+        with pysam.FastxWriter(outfile, threads=2) as outf:
+            outf.write_many([r.name for r in self.records],
+                            [r.sequence for r in self.records],
+                            [r.quality for r in self.records],
+                            [r.comment for r in self.records])
+            outf.write_many([], [])
+        self.check_roundtrip(outfile)
+
+        outfile = get_temp_filename(suffix=".fa")
+        with pysam.FastxWriter(outfile) as outf:
+            outf.write_many(["read1", b"read2"], ["ACGT", b"AC"],
+                            comments=[None, "comment"])
+        records = [pysam.FastxRecord(name="read1", sequence="ACGT"),
+                   pysam.FastxRecord(name="read2", sequence="AC",
+                                     comment="comment")]
+        self.check_roundtrip(outfile, records)
+
+    def test_write_many_invalid_records_raises_error(self):
+        outfile = get_temp_filename(suffix=".fq")
+        with pysam.FastxWriter(outfile) as outf:
+            self.assertRaises(ValueError, outf.write_many,
+                              ["read1"], ["ACGT", "AC"])
+            self.assertRaises(ValueError, outf.write_many,
+                              ["read1"], ["ACGT"], ["I"])
+            self.assertRaises(ValueError, outf.write_many,
+                              [None], ["ACGT"])
+        os.unlink(outfile)
+
+    def test_invalid_level_raises_error(self):
+        outfile = get_temp_filename(suffix=".fq.gz")
+        for level in (-2, 10):
+            self.assertRaises(ValueError, pysam.FastxWriter, outfile,
+                              level=level)
+        os.unlink(outfile)
+
+    def test_write_on_closed_file_raises_error(self):
+        outfile = get_temp_filename(suffix=".fq")
+        outf = pysam.FastxWriter(outfile)
+        outf.close()
+        self.assertTrue(outf.closed)
+        self.assertRaises(ValueError, outf.write, ("read1", "ACGT"))
+        os.unlink(outfile)
+
+
+class TestPairedFastxFile(unittest.TestCase):
+
+    filename = "faidx_ex1.fq"
+
+    def setUp(self):
+        with pysam.FastxFile(os.path.join(BAM_DATADIR, self.filename)) as inf:
+            self.records = list(inf)
+        self.filename1 = get_temp_filename(suffix=".fq")
+        self.filename2 = get_temp_filename(suffix=".fq")
+
+    def tearDown(self):
+        os.unlink(self.filename1)
+        os.unlink(self.filename2)
+
+    def write_pair(self, records1, records2, suffix1="/1", suffix2="/2"):
+        with open(self.filename1, "w") as outf:
+            for r in records1:
+                outf.write("@{}{} comment\n{}\n+\n{}\n".format(
+                    r.name, suffix1, r.sequence, r.quality))
+        with open(self.filename2, "w") as outf:
+            for r in records2:
+                outf.write("@{}{}\n{}\n+\n{}\n".format(
+                    r.name, suffix2, r.sequence, r.quality))
+
+    def test_pairs_are_returned_in_lock_step(self):
+        self.write_pair(self.records, self.records)
+        for threads in (1, 2):
+            with pysam.PairedFastxFile(self.filename1,
+                                       self.filename2,
+                                       threads=threads) as inf:
+                pairs = list(inf)
+            self.assertEqual(len(pairs), len(self.records))
+            for (r1, r2), r in zip(pairs, self.records):
+                self.assertEqual(r1.name, r.name + "/1")
+                self.assertEqual(r2.name, r.name + "/2")
+                self.assertEqual(r1.comment, "comment")
+                self.assertEqual(r2.sequence, r.sequence)
+
+    def test_mismatched_names_raise_error(self):
+        self.write_pair(self.records, self.records, suffix2="x/2")
+        with pysam.PairedFastxFile(self.filename1, self.filename2) as inf:
+            self.assertRaises(ValueError, next, inf)
+
+    def test_mismatched_names_can_be_ignored(self):
+        self.write_pair(self.records, self.records, suffix2="x/2")
+        with pysam.PairedFastxFile(self.filename1, self.filename2,
+                                   check_names=False) as inf:
+            self.assertEqual(len(list(inf)), len(self.records))
+
+    def test_suffixes_other_than_mate_number_are_compared(self):
+        self.write_pair(self.records, self.records, suffix1="/1", suffix2="/3")
+        with pysam.PairedFastxFile(self.filename1, self.filename2) as inf:
+            self.assertRaises(ValueError, next, inf)
+
+    def test_different_number_of_entries_raises_error(self):
+        self.write_pair(self.records, self.records[:-1])
+        with pysam.PairedFastxFile(self.filename1, self.filename2) as inf:
+            self.assertRaises(ValueError, list, inf)
+
+    def test_read_returns_batches_of_pairs(self):
+        self.write_pair(self.records, self.records)
+        with pysam.PairedFastxFile(self.filename1, self.filename2) as inf:
+            expected = [(str(r1), str(r2)) for r1, r2 in inf]
+        for threads in (1, 2):
+            with pysam.PairedFastxFile(self.filename1,
+                                       self.filename2,
+                                       threads=threads) as inf:
+                self.assertEqual(inf.read(0), [])
+                pairs = []
+                while True:
+                    batch = inf.read(7)
+                    if not batch:
+                        break
+                    self.assertLessEqual(len(batch), 7)
+                    pairs.extend(batch)
+                self.assertEqual(inf.read(7), [])
+            self.assertEqual(
+                [(str(r1), str(r2)) for r1, r2 in pairs],
+                expected)
+            self.assertEqual(pairs[0][0].comment, "comment")
+            self.assertEqual(pairs[0][1].comment, None)
+
+    def test_read_raises_errors_like_iteration(self):
+        self.write_pair(self.records, self.records, suffix2="x/2")
+        with pysam.PairedFastxFile(self.filename1, self.filename2,
+                                   threads=2) as inf:
+            self.assertRaises(ValueError, inf.read, 10)
+        self.write_pair(self.records, self.records[:-1])
+        with pysam.PairedFastxFile(self.filename1, self.filename2,
+                                   threads=2) as inf:
+            self.assertRaises(ValueError, inf.read, len(self.records) + 1)
+
+    def test_missing_file_raises_error(self):
+        self.assertRaises(IOError, pysam.PairedFastxFile,
+                          self.filename1, "nothere.fq")
+
+    def test_next_on_closed_file_raises_error(self):
+        self.write_pair(self.records, self.records)
+        with pysam.PairedFastxFile(self.filename1, self.filename2) as inf:
+            pass
+        self.assertTrue(inf.closed)
+        self.assertRaises(ValueError, next, inf)
+
+
 class TestRemoteFileFTP(unittest.TestCase):
     '''test remote access.
     '''
@@ -0,0 +1,87 @@
+import os
+import operator
+import unittest
+
+import pysam
+import pysam.parallel
+
+from TestUtils import BAM_DATADIR, CBCF_DATADIR, TABIX_DATADIR
+
+
+def count_reads(samfile, region):
+    contig, start, stop = region
+    return sum(1 for read in samfile.fetch(contig, start, stop)
+               if contig == "*" or read.reference_start >= start)
+
+
+def count_records(f, region):
+    return sum(1 for record in f.fetch(*region))
+
+
+def gc_content(samfile, fastafile, region):
+    contig, start, stop = region
+    seq = fastafile.fetch(contig, start, stop)
+    return contig, seq.count("G") + seq.count("C")
+
+
+class TestMapRegions(unittest.TestCase):
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def testRegionsInOrder(self):
+        regions = [("chr2", 0, 100), ("chr1", 100, 200), ("chr1", 0, 1575)]
+        with pysam.AlignmentFile(self.filename) as samfile:
+            expected = [count_reads(samfile, r) for r in regions]
+        for processes in (1, 2):
+            self.assertEqual(
+                list(pysam.parallel.map_regions(self.filename, count_reads,
+                                                regions=regions,
+                                                processes=processes)),
+                expected)
+
+    def testPartitionsWithReduce(self):
+        with pysam.AlignmentFile(self.filename) as samfile:
+            expected = samfile.mapped + samfile.unmapped
+        for processes in (1, 2):
+            self.assertEqual(
+                pysam.parallel.map_regions(self.filename, count_reads,
+                                           n_partitions=3,
+                                           processes=processes,
+                                           reduce=operator.add),
+                expected)
+
+    def testFastaFile(self):
+        with pysam.FastaFile(os.path.join(BAM_DATADIR, "ex1.fa")) as fastafile:
+            expected = [(contig, fastafile.fetch(contig).count("G") +
+                         fastafile.fetch(contig).count("C"))
+                        for contig in fastafile.references]
+        self.assertEqual(
+            list(pysam.parallel.map_regions(
+                self.filename, gc_content,
+                regions=[(contig, None, None) for contig, _ in expected],
+                processes=2,
+                fasta_filename=os.path.join(BAM_DATADIR, "ex1.fa"))),
+            expected)
+
+    def testVariantAndTabixFiles(self):
+        for fn in (os.path.join(CBCF_DATADIR, "example_vcf42.bcf"),
+                   os.path.join(TABIX_DATADIR, "example.gtf.gz")):
+            with pysam.parallel.open_file(fn) as f:
+                expected = sum(1 for record in f.fetch())
+            self.assertEqual(
+                pysam.parallel.map_regions(fn, count_records,
+                                           n_partitions=2,
+                                           processes=2,
+                                           reduce=operator.add),
+                expected)
+
+    def testInvalid(self):
+        self.assertRaises(ValueError, pysam.parallel.map_regions,
+                          self.filename, count_reads, processes=0)
+        self.assertRaises(ValueError, pysam.parallel.map_regions,
+                          self.filename, count_reads, regions=[],
+                          n_partitions=2)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -13,12 +13,14 @@ import glob
 import sys
 import subprocess
 import shutil
+import threading
+from concurrent.futures import ThreadPoolExecutor
 import pysam
 import pysam.samtools
 import pysam.bcftools
 from TestUtils import checkBinaryEqual, check_lines_equal, \
     check_samtools_view_equal, get_temp_filename, force_bytes, WORKDIR, \
-    BAM_DATADIR
+    BAM_DATADIR, CBCF_DATADIR
 
 
 IS_PYTHON3 = sys.version_info[0] >= 3
@@ -302,6 +304,509 @@ class EmptyIndexTest(unittest.TestCase):
                           "exdoesntexist.bam")
 
 
+class SortTemporaryFilesTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        # large enough to need several temporary files with -m 1M
+        cls.filename = get_temp_filename(".bam")
+        with pysam.AlignmentFile(os.path.join(BAM_DATADIR, "ex1.bam")) as inf:
+            reads = list(inf)
+            with pysam.AlignmentFile(cls.filename, "wb", template=inf) as outf:
+                for i in range(4):
+                    for read in reversed(reads):
+                        read.query_name = "{}_{}".format(read.query_name, i)
+                        outf.write(read)
+                        read.query_name = read.query_name[:-2]
+
+    @classmethod
+    def tearDownClass(cls):
+        os.unlink(cls.filename)
+
+    def sort(self, *args):
+        outfile = get_temp_filename(".sam")
+        try:
+            pysam.samtools.sort("--no-PG", "-O", "SAM", "-o", outfile,
+                                *(args + (self.filename,)))
+            with open(outfile) as inf:
+                return inf.read()
+        finally:
+            os.unlink(outfile)
+
+    def testFormats(self):
+        for args in ((), ("-n",), ("-t", "NM"), ("-@", "2")):
+            expected = self.sort(*args)
+            for tmp_format in ("lz4", "bam"):
+                self.assertEqual(
+                    self.sort("-m", "1M", "--tmp-format", tmp_format, *args),
+                    expected)
+
+    def testInvalidFormat(self):
+        self.assertRaises(pysam.SamtoolsError, self.sort,
+                          "--tmp-format", "gz")
+
+    def testDefaultFormat(self):
+        # lz4 runs are named PREFIX.nnnn, a directory in place of
+        # PREFIX.0000.bam only gets in the way of bam runs
+        prefix = get_temp_filename(".sort")
+        os.unlink(prefix)
+        os.mkdir(prefix + ".0000.bam")
+        try:
+            self.assertEqual(self.sort("-m", "1M", "-T", prefix),
+                             self.sort())
+            self.assertRaises(pysam.SamtoolsError, self.sort,
+                              "-m", "1M", "-T", prefix, "--tmp-format", "bam")
+        finally:
+            os.rmdir(prefix + ".0000.bam")
+
+    def testTemporaryFilesRemoved(self):
+        prefix = get_temp_filename(".sort")
+        os.unlink(prefix)
+        for tmp_format in ((), ("--tmp-format", "lz4"),
+                           ("--tmp-format", "bam")):
+            for threads in ("1", "4"):
+                self.sort("-m", "1M", "-@", threads, "-T", prefix,
+                          *tmp_format)
+                self.assertEqual(glob.glob(prefix + "*"), [])
+
+    def testParallelMerge(self):
+        # BAM output is merged in key ranges by several threads
+        outfile = get_temp_filename(".bam")
+        try:
+            for args in ((), ("-n",), ("-t", "NM")):
+                expected = self.sort(*args)
+                for tmp_format in ("lz4", "bam"):
+                    pysam.samtools.sort("--no-PG", "-m", "1M", "-@", "4",
+                                        "--tmp-format", tmp_format,
+                                        "-o", outfile, *(args + (self.filename,)))
+                    self.assertEqual(
+                        pysam.samtools.view("--no-PG", "-h", outfile),
+                        expected)
+        finally:
+            os.unlink(outfile)
+
+    def testParallelMergeOfFiles(self):
+        inputs = [get_temp_filename(".bam") for i in range(2)]
+        outfiles = [get_temp_filename(".bam") for i in range(2)]
+        try:
+            for fn in inputs:
+                pysam.samtools.sort("--no-PG", "-o", fn, self.filename)
+                pysam.samtools.index(fn)
+            for fn, threads in zip(outfiles, ("1", "3")):
+                pysam.samtools.merge("--no-PG", "-f", "-r", "-@", threads,
+                                     fn, *inputs)
+            results = []
+            for fn in outfiles:
+                with pysam.AlignmentFile(fn) as inf:
+                    results.append([read.to_string() for read in inf])
+            self.assertEqual(len(results[0]), 2 * 4 * 3270)
+            self.assertEqual(results[1], results[0])
+        finally:
+            for fn in inputs + outfiles:
+                if os.path.exists(fn):
+                    os.unlink(fn)
+            for fn in inputs:
+                if os.path.exists(fn + ".bai"):
+                    os.unlink(fn + ".bai")
+
+
+class MarkDuplicatesTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        # copies of the reads with names that differ in the x coordinate,
+        # enough for several chunks when marking in parallel
+        cls.filename = get_temp_filename(".bam")
+        unsorted = get_temp_filename(".bam")
+        fixed = get_temp_filename(".bam")
+        try:
+            with pysam.AlignmentFile(os.path.join(BAM_DATADIR, "ex1.bam")) as inf:
+                reads = list(inf)
+                with pysam.AlignmentFile(unsorted, "wb", template=inf) as outf:
+                    for i in range(4):
+                        for read in reads:
+                            name = read.query_name
+                            fields = name.split(":")
+                            fields[3] = str(int(fields[3]) + 20 * i)
+                            read.query_name = ":".join(fields)
+                            outf.write(read)
+                            read.query_name = name
+            pysam.samtools.sort("--no-PG", "-n", "-o", fixed, unsorted)
+            pysam.samtools.fixmate("--no-PG", "-m", fixed, unsorted)
+            pysam.samtools.sort("--no-PG", "-o", cls.filename, unsorted)
+        finally:
+            os.unlink(unsorted)
+            os.unlink(fixed)
+
+    @classmethod
+    def tearDownClass(cls):
+        os.unlink(cls.filename)
+
+    def markdup(self, *args):
+        outfile = get_temp_filename(".bam")
+        statsfile = get_temp_filename(".txt")
+        try:
+            pysam.samtools.markdup("--no-PG", "-f", statsfile,
+                                   *(args + (self.filename, outfile)))
+            with open(statsfile) as inf:
+                stats = [line for line in inf if not line.startswith("COMMAND")]
+            return pysam.samtools.view(outfile), stats
+        finally:
+            os.unlink(outfile)
+            os.unlink(statsfile)
+
+    def testParallel(self):
+        for args in ((), ("-d", "100", "-t"), ("-S", "-d", "100"), ("-r",)):
+            expected = self.markdup(*args)
+            self.assertEqual(self.markdup("-@", "3", *args), expected)
+
+    def testParallelWarnings(self):
+        # some names have no coordinates, the jobs warn about them
+        filename = get_temp_filename(".bam")
+        outfile = get_temp_filename(".bam")
+        try:
+            with pysam.AlignmentFile(self.filename) as inf:
+                names = sorted(set(read.query_name for read in inf))
+                renamed = dict((name, "read{}".format(i))
+                               for i, name in enumerate(names) if i % 40 == 0)
+                inf.reset()
+                with pysam.AlignmentFile(filename, "wb", template=inf) as outf:
+                    for read in inf:
+                        read.query_name = renamed.get(read.query_name,
+                                                      read.query_name)
+                        outf.write(read)
+            messages = []
+            for threads in ("1", "3"):
+                pysam.samtools.markdup("--no-PG", "-@", threads, "-d", "100",
+                                       filename, outfile)
+                messages.append(pysam.samtools.markdup.get_messages())
+            self.assertIn("cannot decipher read name", messages[0])
+            self.assertEqual(messages[1], messages[0])
+        finally:
+            os.unlink(filename)
+            os.unlink(outfile)
+
+    def testParallelError(self):
+        # the reads have no MC tags, a job fails on the thread pool
+        outfile = get_temp_filename(".bam")
+        try:
+            with self.assertRaisesRegex(pysam.SamtoolsError, "no MC tag"):
+                pysam.samtools.markdup("-@", "4", os.path.join(BAM_DATADIR, "ex1.bam"),
+                                       outfile)
+        finally:
+            if os.path.exists(outfile):
+                os.unlink(outfile)
+
+
+class StatsTest(unittest.TestCase):
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    @classmethod
+    def setUpClass(cls):
+        # a single contig, which is cut into several windows
+        cls.contig_filename = get_temp_filename(".bam")
+        pysam.samtools.view("-b", "-o", cls.contig_filename,
+                            cls.filename, "chr1", catch_stdout=False)
+        pysam.samtools.index(cls.contig_filename)
+
+    @classmethod
+    def tearDownClass(cls):
+        os.unlink(cls.contig_filename)
+        os.unlink(cls.contig_filename + ".bai")
+
+    def stats(self, *args, filename=None):
+        return [line for line in
+                pysam.samtools.stats(
+                    *(args + (filename or self.filename,))).splitlines()
+                if not line.startswith("# The command line")]
+
+    def testParallel(self):
+        # the indexed file is read in windows within the contigs
+        for filename in (self.filename, self.contig_filename):
+            for args in ((),
+                         ("-r", os.path.join(BAM_DATADIR, "ex1.fa")),
+                         ("-t", os.path.join(BAM_DATADIR, "ex1.bed")),
+                         ("-p", "-c", "1,50,5")):
+                expected = self.stats(*args, filename=filename)
+                for threads in ("2", "3"):
+                    self.assertEqual(
+                        self.stats("-@", threads, *args, filename=filename),
+                        expected)
+
+    def testParallelError(self):
+        # the reads have no RG tag, which is an error in a worker thread
+        for threads in ("1", "3"):
+            with self.assertRaisesRegex(pysam.SamtoolsError, "not found in bam_line"):
+                self.stats("-@", threads, "-S", "RG")
+
+
+class BedcovTest(unittest.TestCase):
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    @classmethod
+    def setUpClass(cls):
+        # overlapping windows, out of order and with a whole contig
+        cls.bedfile = get_temp_filename(".bed")
+        with open(cls.bedfile, "w") as outf:
+            for contig in ("chr2", "chr1"):
+                for start in range(0, 1600, 70):
+                    outf.write("%s\t%d\t%d\n" % (contig, start, start + 150))
+            outf.write("chr1\t0\t1575\n")
+
+    @classmethod
+    def tearDownClass(cls):
+        os.unlink(cls.bedfile)
+
+    def bedcov(self, *args):
+        return pysam.samtools.bedcov(
+            *(args + (self.bedfile, self.filename, self.filename)))
+
+    def testSweep(self):
+        for args in ((), ("-j",), ("-d", "5"), ("-Q", "30", "-G", "REVERSE")):
+            expected = self.bedcov(*args)
+            for threads in ("0", "2"):
+                self.assertEqual(self.bedcov("-S", "-@", threads, *args),
+                                 expected)
+
+
+class ParallelDepthTest(unittest.TestCase):
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def check(self, func, *args):
+        expected = func(*(args + (self.filename, self.filename)))
+        for threads in ("2", "3"):
+            self.assertEqual(
+                func("-@", threads, *(args + (self.filename, self.filename))),
+                expected)
+
+    def testDepth(self):
+        for args in ((), ("-a",), ("-aa", "-H"), ("-s", "-Q", "10")):
+            self.check(pysam.samtools.depth, *args)
+
+    def testCoverage(self):
+        for args in ((), ("-q", "10"), ("-m", "-w", "30")):
+            self.check(pysam.samtools.coverage, *args)
+
+
+class ParallelFlagstatTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        # large enough to be cut into several ranges, and still sorted
+        cls.filename = get_temp_filename(".bam")
+        with pysam.AlignmentFile(os.path.join(BAM_DATADIR, "ex1.bam")) as inf:
+            reads = list(inf)
+            with pysam.AlignmentFile(cls.filename, "wb0",
+                                     template=inf) as outf:
+                for read in reads:
+                    for i in range(4):
+                        outf.write(read)
+        pysam.samtools.index(cls.filename)
+
+    @classmethod
+    def tearDownClass(cls):
+        os.unlink(cls.filename)
+        os.unlink(cls.filename + ".bai")
+
+    def testParallel(self):
+        for args in ((), ("-O", "json")):
+            expected = pysam.samtools.flagstat(*(args + (self.filename,)))
+            for threads in ("2", "3"):
+                self.assertEqual(
+                    pysam.samtools.flagstat("-@", threads,
+                                            *(args + (self.filename,))),
+                    expected)
+
+    def testIndexOnly(self):
+        counts = pysam.samtools.flagstat("-O", "tsv", self.filename)
+        counts = [line.split("\t") for line in counts.splitlines()]
+        total = int(counts[0][0]) + int(counts[0][1])
+        mapped = int(counts[6][0]) + int(counts[6][1])
+        lines = pysam.samtools.flagstat("--index-only", "-O", "tsv",
+                                        self.filename).splitlines()
+        self.assertEqual(lines[0], "%d\ttotal (from the index)" % total)
+        self.assertEqual(lines[1], "%d\tmapped" % mapped)
+        self.assertEqual(lines[3], "%d\tunmapped" % (total - mapped))
+
+    def testIndexOnlyCram(self):
+        # a CRAM index has no read counts
+        cramfile = get_temp_filename(".cram")
+        try:
+            with pysam.AlignmentFile(os.path.join(BAM_DATADIR, "ex1.bam")) as inf:
+                with pysam.AlignmentFile(
+                        cramfile, "wc", template=inf,
+                        reference_filename=os.path.join(BAM_DATADIR, "ex1.fa")) as outf:
+                    for read in inf:
+                        outf.write(read)
+            pysam.samtools.index(cramfile)
+            with self.assertRaisesRegex(pysam.SamtoolsError, "is not BAM"):
+                pysam.samtools.flagstat("--index-only", cramfile)
+        finally:
+            for fn in (cramfile, cramfile + ".crai"):
+                if os.path.exists(fn):
+                    os.unlink(fn)
+
+
+class ParallelFastqTest(unittest.TestCase):
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def testStdout(self):
+        for args in ((), ("-t", "-N"), ("-T", "NM,MD"), ("-O",)):
+            expected = pysam.samtools.fastq(*(args + (self.filename,)))
+            for threads in ("1", "3"):
+                self.assertEqual(
+                    pysam.samtools.fastq("-@", threads,
+                                         *(args + (self.filename,))),
+                    expected)
+
+    def testPairedFiles(self):
+        outputs = {}
+        for threads in ("0", "2"):
+            names = [get_temp_filename(suffix) for suffix in
+                     (".1.fq", ".2.fq.gz", ".s.fq")]
+            pysam.samtools.fastq("-@", threads, "-1", names[0], "-2", names[1],
+                                 "-s", names[2], self.filename)
+            contents = []
+            for name in names:
+                with pysam.FastxFile(name) as inf:
+                    contents.append([str(r) for r in inf])
+                os.unlink(name)
+            outputs[threads] = contents
+        self.assertEqual(outputs["2"], outputs["0"])
+
+
+class StreamTest(unittest.TestCase):
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def testLines(self):
+        self.assertEqual(list(pysam.samtools.view(self.filename, stream=True)),
+                         pysam.samtools.view(self.filename).splitlines(True))
+
+    def testCommandWithoutOutputOption(self):
+        self.assertEqual(list(pysam.samtools.idxstats(self.filename, stream=True)),
+                         pysam.samtools.idxstats(self.filename).splitlines(True))
+
+    def testRead(self):
+        with pysam.samtools.view("-O", "SAM", self.filename, stream=True) as stream:
+            self.assertEqual(stream.read(),
+                             force_bytes(pysam.samtools.view(self.filename)))
+
+    def testAlignmentFile(self):
+        with pysam.samtools.view("-b", self.filename, stream=True) as stream:
+            with pysam.AlignmentFile(stream) as inf:
+                reads = [r.to_string() for r in inf]
+        with pysam.AlignmentFile(self.filename) as inf:
+            self.assertEqual(reads, [r.to_string() for r in inf])
+
+    def testVariantFile(self):
+        fn = os.path.join(CBCF_DATADIR, "example_vcf42.bcf")
+        with pysam.bcftools.view(fn, stream=True) as stream:
+            with pysam.VariantFile(stream) as inf:
+                records = [str(r) for r in inf]
+        with pysam.VariantFile(fn) as inf:
+            self.assertEqual(records, [str(r) for r in inf])
+
+    def testCloseEarly(self):
+        with pysam.samtools.view(self.filename, stream=True) as stream:
+            self.assertTrue(next(iter(stream)).startswith("EAS56_57:6:190:289:82"))
+        self.assertTrue(stream.closed)
+        self.assertEqual(pysam.samtools.view("-c", self.filename).strip(), "3270")
+
+    def testCloseWhileOutputIsOpenElsewhere(self):
+        # AlignmentFile keeps its own descriptor of the output, so
+        # closing the stream does not end the output for the command
+        stream = pysam.samtools.view("-u", self.filename, stream=True)
+        inf = pysam.AlignmentFile(stream)
+        next(inf)
+        closer = threading.Thread(target=stream.close)
+        closer.daemon = True
+        closer.start()
+        closer.join(30)
+        self.assertFalse(closer.is_alive())
+        self.assertTrue(stream.closed)
+        inf.close()
+
+    def testError(self):
+        with self.assertRaises(pysam.SamtoolsError):
+            list(pysam.samtools.view("exdoesntexist.bam", stream=True))
+
+
+class ConcurrentDispatchTest(unittest.TestCase):
+
+    filename = os.path.join(BAM_DATADIR, "ex1.bam")
+
+    def sort_order(self, *args):
+        outfile = get_temp_filename(".sam")
+        try:
+            pysam.samtools.sort("-O", "SAM", "-o", outfile,
+                                *(args + (self.filename,)))
+            with pysam.AlignmentFile(outfile) as inf:
+                return [(r.query_name, r.flag) for r in inf]
+        finally:
+            os.unlink(outfile)
+
+    bcf_filename = os.path.join(CBCF_DATADIR, "example_vcf42.bcf")
+
+    def run_commands(self):
+        return [
+            pysam.samtools.view("-c", "-f", "16", self.filename),
+            pysam.samtools.idxstats(self.filename),
+            pysam.samtools.flagstat(self.filename),
+            self.sort_order("-n", "-@", "2"),
+            self.sort_order("-t", "NM"),
+            self.sort_order(),
+        ]
+
+    def run_bcftools_commands(self):
+        return [
+            pysam.bcftools.view("-H", self.bcf_filename),
+            pysam.bcftools.stats(self.bcf_filename),
+        ]
+
+    def testThreads(self):
+        expected = self.run_commands()
+        with ThreadPoolExecutor(4) as pool:
+            futures = [pool.submit(self.run_commands) for i in range(4)]
+            for future in futures:
+                self.assertEqual(future.result(), expected)
+
+    def testBcftoolsThreads(self):
+        # bcftools commands may be called from several threads, but
+        # run one at a time
+        expected = self.run_bcftools_commands()
+        with ThreadPoolExecutor(4) as pool:
+            futures = [pool.submit(self.run_bcftools_commands)
+                       for i in range(4)]
+            for future in futures:
+                self.assertEqual(future.result(), expected)
+
+    def testBcftoolsRunOneAtATime(self):
+        expected_samtools = pysam.samtools.idxstats(self.filename)
+        expected_bcftools = pysam.bcftools.view("-H", self.bcf_filename)
+        with ThreadPoolExecutor(2) as pool:
+            # hold the lock as a running bcftools command would
+            with pysam.libcutils._dispatch_lock:
+                bcftools = pool.submit(pysam.bcftools.view, "-H",
+                                       self.bcf_filename)
+                samtools = pool.submit(pysam.samtools.idxstats,
+                                       self.filename)
+                self.assertEqual(samtools.result(timeout=60),
+                                 expected_samtools)
+                self.assertFalse(bcftools.done())
+            self.assertEqual(bcftools.result(timeout=60), expected_bcftools)
+
+    def testStreamWhileRunningCommands(self):
+        with pysam.samtools.view(self.filename, stream=True) as stream:
+            self.assertEqual(pysam.samtools.view("-c", self.filename).strip(),
+                             "3270")
+            self.assertEqual(sum(1 for line in stream), 3270)
+
+
 if sys.platform != "darwin":
     # fails with segfault with htslib 1.5 on Osx, an issue with flockfile
     # issue seems to be with repeated calls to interface
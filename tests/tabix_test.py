@@ -87,6 +87,12 @@ class TestIndexing(unittest.TestCase):
         self.assertFalse(checkGZBinaryEqual(
             self.tmpfilename + ".tbi", self.filename_idx))
 
+    def test_indexing_with_threads_works(self):
+        '''test indexing with several threads.'''
+        pysam.tabix_index(self.tmpfilename, preset="gff", threads=4)
+        self.assertTrue(checkGZBinaryEqual(
+            self.tmpfilename + ".tbi", self.filename_idx))
+
     def tearDown(self):
         os.unlink(self.tmpfilename)
         if os.path.exists(self.tmpfilename + ".tbi"):
@@ -381,6 +387,16 @@ class TestIterationWithComments(TestIterationWithoutComments):
         TestIterationWithoutComments.setUp(self)
 
 
+class TestIterationLazyIndex(TestIterationWithoutComments):
+
+    '''test iterating with TabixFile.fetch() when
+    the index is read on demand.'''
+
+    def setUp(self):
+        IterationTest.setUp(self)
+        self.tabix = pysam.TabixFile(self.filename, lazy_index=True)
+
+
 class TestIterators(unittest.TestCase):
     filename = os.path.join(TABIX_DATADIR, "example.gtf.gz")
 
@@ -1213,6 +1229,15 @@ class TestMultipleIterators(unittest.TestCase):
                             f.fetch(multiple_iterators=True)):
                 self.assertEqual(str(a), str(b))
 
+    def testSharedIndex(self):
+        with pysam.TabixFile(self.filename) as f:
+            ref = [str(x) for x in f.fetch("chr2")]
+            iterators = [f.fetch("chr2", multiple_iterators=True)
+                         for _ in range(3)]
+        # the index is shared and stays valid after the file is closed
+        for it in iterators:
+            self.assertEqual([str(x) for x in it], ref)
+
 
 class TestContextManager(unittest.TestCase):
 